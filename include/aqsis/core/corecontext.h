@@ -37,6 +37,26 @@ namespace Aqsis {
 AQSIS_CORE_SHARE
 Ri::RendererServices* cxxRenderContext();
 
+/// Keep loaded shaders and textures in the current context between frames.
+///
+/// Cached shaders and textures are checked against their files before reuse
+/// instead of being flushed at the end of each frame.  Used when rendering
+/// several jobs with one context; see resetRenderContext().
+AQSIS_CORE_SHARE
+void setResidentCaches(bool resident);
+
+/// Return the current context to its state just after RiBegin().
+///
+/// Options, attributes, declarations, lights and retained objects from the
+/// previous job are dropped, while the shaders, textures and archives cached
+/// by the context are kept for the next job.  Filters added to the context
+/// are kept too.
+///
+/// \return false if the context can't be reused because the previous job
+/// ended inside a block; the caller should end it and begin a new one.
+AQSIS_CORE_SHARE
+bool resetRenderContext();
+
 }
 
 #endif // AQSIS_CORECONTEXT_H_INCLUDED
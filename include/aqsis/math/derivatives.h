@@ -49,6 +49,10 @@ namespace Aqsis {
  * For 1D and 0D grids, differences may not be defined in one or both
  * directions; the variables uDiffZero and vDiffZero exist to turn off such
  * derivatives.
+ *
+ * A grid may also be a stack of independent strips of rows, as used when
+ * several curves are diced into one grid.  Differences in the v-direction
+ * are then taken within each strip; see setVStripRes().
  */
 class CqGridDiff
 {
@@ -64,6 +68,13 @@ class CqGridDiff
 		void reset(TqInt uRes, TqInt vRes, bool uDiffZero, bool vDiffZero,
 				   bool useCentred);
 
+		/** \brief Treat the grid as a stack of independent strips along v.
+		 *
+		 * \param vStripRes - number of rows in each strip; vRes must be a
+		 *                    multiple of this.
+		 */
+		void setVStripRes(TqInt vStripRes);
+
 		/** \brief Compute the first difference on the grid in the u-direction.
 		 *
 		 * This function acts on the grid at the given point.
@@ -91,6 +102,8 @@ class CqGridDiff
 		TqInt m_uRes;
 		/// v-resolution of the grid.
 		TqInt m_vRes;
+		/// v-resolution of each independent strip of the grid.
+		TqInt m_vStripRes;
 		/// derivatives in the u-direction are assumed to be zero
 		bool m_uDiffZero;
 		/// derivatives in the v-direction are assumed to be zero
@@ -106,6 +119,7 @@ class CqGridDiff
 inline CqGridDiff::CqGridDiff()
 	: m_uRes(0),
 	m_vRes(0),
+	m_vStripRes(0),
 	m_uDiffZero(false),
 	m_vDiffZero(false),
 	m_useCentred(true)
@@ -115,6 +129,7 @@ inline CqGridDiff::CqGridDiff(TqInt uRes, TqInt vRes, bool uDiffZero, bool vDiff
 					          bool useCentred)
 	: m_uRes(uRes),
 	m_vRes(vRes),
+	m_vStripRes(vRes),
 	m_uDiffZero(uDiffZero),
 	m_vDiffZero(vDiffZero),
 	m_useCentred(useCentred)
@@ -125,11 +140,18 @@ inline void CqGridDiff::reset(TqInt uRes, TqInt vRes, bool uDiffZero, bool vDiff
 {
 	m_uRes = uRes;
 	m_vRes = vRes;
+	m_vStripRes = vRes;
 	m_uDiffZero = uDiffZero;
 	m_vDiffZero = vDiffZero;
 	m_useCentred = useCentred;
 }
 
+inline void CqGridDiff::setVStripRes(TqInt vStripRes)
+{
+	assert(vStripRes > 0 && m_vRes % vStripRes == 0);
+	m_vStripRes = vStripRes;
+}
+
 template<typename T>
 inline T CqGridDiff::diffU(const T* data, TqInt u, TqInt v) const
 {
@@ -150,6 +172,11 @@ inline T CqGridDiff::diffV(const T* data, TqInt u, TqInt v) const
 		return T(0.0f);
 	assert(u >= 0 && u < m_uRes);
 	assert(v >= 0 && v < m_vRes);
+	if(m_vStripRes != m_vRes)
+	{
+		return diff(data + v*m_uRes + u, m_useCentred,
+					m_uRes, v % m_vStripRes, m_vStripRes);
+	}
 	return diff(data + v*m_uRes + u, m_useCentred,
 				m_uRes, v, m_vRes);
 }
@@ -0,0 +1,158 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief In-memory cache of parsed RIB archive files.
+
+#ifndef AQSIS_RIBARCHIVECACHE_H_INCLUDED
+#define AQSIS_RIBARCHIVECACHE_H_INCLUDED
+
+#include <aqsis/config.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+namespace Aqsis
+{
+
+namespace Ri { class Renderer; class RendererServices; }
+
+//------------------------------------------------------------------------------
+/// A RIB archive file parsed into memory.
+class AQSIS_RIUTIL_SHARE ParsedRibArchive
+{
+    public:
+        /// Parse an archive file into memory.
+        ///
+        /// The interface calls are recorded as they pass through to context,
+        /// which may be used to keep track of declarations made inside the
+        /// archive.  Nothing but services and context is touched during the
+        /// parse, so archives may be parsed on a background thread given
+        /// services and a context which are private to that thread.
+        ///
+        /// \param path - resolved path to the archive file
+        /// \param name - name of the archive, for error reporting
+        /// \param services - services used to parse the file
+        /// \param context - destination for the interface calls
+        /// \return the parsed archive, or null if the file couldn't be opened.
+        static boost::shared_ptr<ParsedRibArchive> parse(
+                const std::string& path, const char* name,
+                Ri::RendererServices& services, Ri::Renderer& context);
+        /// Parse RIB from a stream into memory.
+        ///
+        /// As above, but parsing stops at the end of the stream or at the 0377
+        /// byte which ends a RunProgram response.  Archives parsed from a
+        /// stream are never cached.
+        static boost::shared_ptr<ParsedRibArchive> parse(
+                std::istream& stream, const char* name,
+                Ri::RendererServices& services, Ri::Renderer& context);
+
+        /// Send the recorded interface calls to context.
+        virtual void replay(Ri::Renderer& context) const = 0;
+        /// Get the approximate memory held by the recorded calls.
+        virtual size_t bytes() const = 0;
+
+        virtual ~ParsedRibArchive() {}
+};
+
+//------------------------------------------------------------------------------
+/// Cache of parsed RIB archive files.
+///
+/// Archives which are referenced many times, such as set dressing, are parsed
+/// once and the resulting interface calls held in memory.  Later references
+/// replay the cached calls rather than reparsing the file.
+///
+/// Entries are keyed by the resolved path of the archive and are invalidated
+/// when the modification time or size of the file changes.  The memory held by
+/// the cache is bounded by a budget, with the least recently used archives
+/// evicted first.
+class AQSIS_RIUTIL_SHARE RibArchiveCache
+{
+    public:
+        /// Create an archive cache
+        ///
+        /// \param maxBytes - memory budget in bytes.  Archives are parsed
+        ///                   directly without caching while this is zero.
+        static RibArchiveCache* create(size_t maxBytes = 0);
+
+        /// Read an archive file, sending the interface calls to context.
+        ///
+        /// If the file is cached and unchanged on disk, the cached calls are
+        /// replayed.  Otherwise the file is parsed with
+        /// services.parseRibFile(), and the calls are cached on the way
+        /// through if they fit into the budget.
+        ///
+        /// \param path - resolved path to the archive file
+        /// \param name - name of the archive, for error reporting
+        /// \param services - services used to parse the file
+        /// \param context - destination for the interface calls
+        /// \return false if the file couldn't be opened.
+        virtual bool readArchive(const std::string& path, const char* name,
+                                 Ri::RendererServices& services,
+                                 Ri::Renderer& context) = 0;
+
+        /// Replay an archive which was parsed ahead of time.
+        ///
+        /// The archive is added to the cache if it fits into the budget, so
+        /// that later references to the file don't parse it again.
+        ///
+        /// \param path - resolved path to the archive file
+        /// \param archive - archive parsed with ParsedRibArchive::parse()
+        /// \param context - destination for the interface calls
+        virtual void readArchive(const std::string& path,
+                            const boost::shared_ptr<ParsedRibArchive>& archive,
+                            Ri::Renderer& context) = 0;
+
+        /// Set the memory budget, evicting archives as necessary.
+        virtual void setMaxBytes(size_t maxBytes) = 0;
+        /// Get the memory budget.
+        virtual size_t maxBytes() const = 0;
+        /// Get the approximate memory held by cached archives.
+        virtual size_t bytes() const = 0;
+        /// Remove all cached archives.
+        virtual void clear() = 0;
+        /// Release archives which have been replayed.
+        ///
+        /// Procedurals in a replayed archive refer to data owned by the
+        /// archive, so every archive replayed by readArchive() is held in
+        /// memory until this is called, even when it has been evicted or was
+        /// too large to cache.
+        virtual void releaseReplayed() = 0;
+
+        virtual ~RibArchiveCache() {}
+};
+
+} // namespace Aqsis
+
+#endif // AQSIS_RIBARCHIVECACHE_H_INCLUDED
+// vi: set et:
@@ -40,12 +40,53 @@
 #include <aqsis/config.h>
 
 #include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
 
 namespace Aqsis
 {
 
 namespace Ri { class Renderer; class RendererServices; }
 
+//------------------------------------------------------------------------------
+/// Counters for the work done by a RibParser.
+///
+/// Per-request statistics are only gathered when timeRequests is set, since
+/// timing each request has a measurable cost on streams with many small
+/// requests.  Request times include the time taken by the renderer to handle
+/// the request, including any nested ReadArchive parsing.
+struct AQSIS_RIUTIL_SHARE RibParserStats
+{
+    /// Counters for a single request type
+    struct Request
+    {
+        /// Number of requests parsed
+        long count;
+        /// Total time in seconds spent parsing and handling the requests
+        double time;
+
+        Request() : count(0), time(0) {}
+    };
+    typedef std::map<std::string, Request> RequestMap;
+
+    /// Total number of requests parsed
+    long requests;
+    /// Total size of the array and parameter data passed to the renderer
+    boost::uint64_t arrayBytes;
+    /// If true, collect counts and times per request type in requestStats
+    bool timeRequests;
+    /// Counters per request type, keyed by request name
+    RequestMap requestStats;
+
+    RibParserStats();
+
+    /// Zero all counters; timeRequests is left unchanged.
+    void reset();
+};
+
 //------------------------------------------------------------------------------
 /// Parser for standard RIB streams.
 ///
@@ -69,6 +110,44 @@ class AQSIS_RIUTIL_SHARE RibParser
                                  const std::string& streamName,
                                  Ri::Renderer& context) = 0;
 
+        /// Parse a RIB file, sending requests to the callback interface
+        ///
+        /// Where possible the file is memory-mapped and scanned in place,
+        /// which is considerably faster than reading it through a stream.
+        ///
+        /// \param fileName - path to the RIB file.  May be gzipped.
+        /// \param streamName - name of the stream, present in error messages
+        /// \param context - parsed interface function calls will be sent here
+        /// \return false if the file couldn't be opened.
+        virtual bool parseFile(const std::string& fileName,
+                               const std::string& streamName,
+                               Ri::Renderer& context) = 0;
+
+        /// Accumulate statistics for subsequently parsed requests
+        ///
+        /// \param stats - counters to be incremented by the parser, which
+        ///                 must remain valid while in use.  Pass null to
+        ///                 stop collecting statistics.
+        virtual void setStats(RibParserStats* stats) = 0;
+
+        /// Take ownership of a float array read for the current request
+        ///
+        /// Arrays passed to the renderer are owned by the parser and reused
+        /// for later requests, so a renderer which keeps the data normally
+        /// has to copy it.  Instead, the renderer may take the storage of a
+        /// whole float array belonging to the request being dispatched.  The
+        /// array is swapped into dest; the original pointer remains valid for
+        /// as long as dest holds the data.
+        ///
+        /// \param data - start of the array, as passed to the renderer
+        /// \param size - length of the array
+        /// \param dest - destination for the array data
+        /// \return false if data isn't a float array of the current request,
+        ///         in which case dest is unchanged and the data should be
+        ///         copied.
+        virtual bool releaseFloatArray(const float* data, size_t size,
+                                       std::vector<float>& dest) = 0;
+
         virtual ~RibParser() {}
 };
 
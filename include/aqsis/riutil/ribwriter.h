@@ -69,6 +69,15 @@ struct RibWriterOptions
     bool useBinary;
     /// Produce gzipped RIB
     bool useGzip;
+    /// Split gzipped RIB into independent blocks which can be compressed
+    /// and decompressed in parallel.  The result is still valid gzip.
+    bool useGzipBlocks;
+    /// Number of threads compressing gzip blocks; zero means one per
+    /// processor.
+    int compressionThreads;
+    /// Round the primitive variables of binary RIB to half precision
+    /// significands.  This is lossy, but the result compresses much better.
+    bool quantiseFloats;
     /// Number of chars per indent level
     int indentStep;
     /// Character to use for indenting (should be whitespace)
@@ -81,6 +90,9 @@ struct RibWriterOptions
         handleProcedurals(true),
         useBinary(false),
         useGzip(false),
+        useGzipBlocks(false),
+        compressionThreads(0),
+        quantiseFloats(false),
         indentStep(4),
         indentChar(' '),
         archivePath(".")
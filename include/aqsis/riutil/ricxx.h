@@ -640,7 +640,7 @@ class Filter;
 /// Roughly speaking, this class is a collection of the parts of Ri::Renderer
 /// which aren't filterable.  It's also a convenient place to manage filter
 /// chains from.
-class RendererServices
+class AQSIS_RIUTIL_SHARE RendererServices
 {
     public:
         /// Get Error handler.
@@ -704,6 +704,23 @@ class RendererServices
         virtual void parseRib(std::istream& ribStream, const char* name)
             { parseRib(ribStream, name, firstFilter()); }
 
+        /// Parse a RIB file
+        ///
+        /// This is equivalent to opening the file and calling parseRib(), but
+        /// allows implementations to read the file more efficiently, for
+        /// instance by memory-mapping it.
+        ///
+        /// \param fileName - path to the RIB file
+        /// \param name - name of RIB stream (for debugging purposes)
+        /// \param context - sink for parsed commands
+        /// \return false if the file couldn't be opened
+        virtual bool parseRibFile(const char* fileName, const char* name,
+                                  Renderer& context);
+
+        /// Parse a RIB file using the first filter in the chain.
+        virtual bool parseRibFile(const char* fileName, const char* name)
+            { return parseRibFile(fileName, name, firstFilter()); }
+
         virtual ~RendererServices() {}
 };
 
@@ -189,6 +189,13 @@ struct AQSIS_SHADERVM_SHARE IqShaderExecEnv
 
 	/// Get the grid difference computation object.
 	virtual CqGridDiff GridDiff() const = 0;
+	/** Divide the grid into independent strips of rows for derivatives.
+	 *
+	 * Must be called after Initialise(), which resets the grid to a single strip.
+	 *
+	 * \param vStripRes - number of rows of shading points in each strip.
+	 */
+	virtual void SetVStripRes( TqInt vStripRes ) = 0;
 
 	/** Get the pointer to the currently being lit surface
 	 */
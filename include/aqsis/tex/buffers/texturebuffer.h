@@ -66,9 +66,12 @@ class CqTextureBuffer
 		class CqIterator;
 		/// Stochastic pixel iterator class
 		class CqStochasticIterator;
+		/// Pixel row iterator class
+		class CqRowIterator;
 
 		typedef CqIterator TqIterator;
 		typedef CqStochasticIterator TqStochasticIterator;
+		typedef CqRowIterator TqRowIterator;
 		/// Sample vector type returned by operator()
 		typedef CqSampleVector<T> TqSampleVector;
 
@@ -193,6 +196,11 @@ class CqTextureBuffer
 		 */
 		TqStochasticIterator beginStochastic(const SqFilterSupport& support,
 				TqInt numSamples) const;
+		/** \brief Access to rows of contiguous pixels in the given support.
+		 *
+		 * \param support - support to iterate over
+		 */
+		TqRowIterator beginRows(const SqFilterSupport& support) const;
 		//@}
 
 		//--------------------------------------------------
@@ -336,6 +344,49 @@ class CqTextureBuffer<T>::CqStochasticIterator
 		TqInt m_sampleNum;
 };
 
+/** \brief An iterator over rows of contiguous pixels for CqTextureBuffer
+ *
+ * Rather than visiting each pixel in the support separately, this iterator
+ * visits each row of the support, giving direct access to the underlying
+ * channel data.  This allows filters to process a whole row at once.
+ */
+template<typename T>
+class CqTextureBuffer<T>::CqRowIterator
+{
+	public:
+		/// Go to the next row in the support
+		CqRowIterator& operator++();
+		/// Test whether the iterator is still inside the support.
+		bool inSupport() const;
+		/// Return the x-position of the first pixel in the current row
+		TqInt x() const;
+		/// Return the y-position of the current row
+		TqInt y() const;
+		/// Return the number of pixels in the current row
+		TqInt length() const;
+		/** \brief Return the channel data for the first pixel in the row.
+		 *
+		 * Pixels in the row are contiguous, with numChannels() channels each.
+		 */
+		const T* data() const;
+
+		friend class CqTextureBuffer<T>;
+	private:
+		/** \brief Construct a row iterator for a given buffer and region.
+		 *
+		 * \param buf - buffer to iterate over.
+		 * \param support - region of the buffer to iterate over.
+		 */
+		CqRowIterator(const CqTextureBuffer<T>& buf, const SqFilterSupport& support);
+
+		/// Reference to the underlying buffer.
+		const CqTextureBuffer<T>* m_buf;
+		/// Support region to iterate over
+		SqFilterSupport m_support;
+		/// current y-position
+		TqInt m_y;
+};
+
 //==============================================================================
 // Implementation of inline functions and templates
 //==============================================================================
@@ -448,6 +499,14 @@ CqTextureBuffer<T>::beginStochastic(const SqFilterSupport& support,
 			numSamples);
 }
 
+template<typename T>
+inline typename CqTextureBuffer<T>::TqRowIterator CqTextureBuffer<T>::beginRows(
+		const SqFilterSupport& support) const
+{
+	return TqRowIterator(*this, intersect(SqFilterSupport(0, m_width, 0, m_height),
+				support));
+}
+
 template<typename T>
 void CqTextureBuffer<T>::resize(TqInt width, TqInt height, const CqChannelList& channelList)
 {
@@ -641,6 +700,55 @@ CqTextureBuffer<T>::CqStochasticIterator::CqStochasticIterator(
 	++(*this);
 }
 
+//------------------------------------------------------------------------------
+// CqTextureBuffer<T>::CqRowIterator implementation
+
+template<typename T>
+inline typename CqTextureBuffer<T>::CqRowIterator&
+CqTextureBuffer<T>::CqRowIterator::operator++()
+{
+	++m_y;
+	return *this;
+}
+
+template<typename T>
+inline bool CqTextureBuffer<T>::CqRowIterator::inSupport() const
+{
+	return m_y < m_support.sy.end;
+}
+
+template<typename T>
+inline TqInt CqTextureBuffer<T>::CqRowIterator::x() const
+{
+	return m_support.sx.start;
+}
+
+template<typename T>
+inline TqInt CqTextureBuffer<T>::CqRowIterator::y() const
+{
+	return m_y;
+}
+
+template<typename T>
+inline TqInt CqTextureBuffer<T>::CqRowIterator::length() const
+{
+	return m_support.sx.range();
+}
+
+template<typename T>
+inline const T* CqTextureBuffer<T>::CqRowIterator::data() const
+{
+	return m_buf->value(m_support.sx.start, m_y);
+}
+
+template<typename T>
+CqTextureBuffer<T>::CqRowIterator::CqRowIterator(const CqTextureBuffer<T>& buf,
+		const SqFilterSupport& support)
+	: m_buf(&buf),
+	m_support(support),
+	m_y(m_support.sx.isEmpty() ? m_support.sy.end : m_support.sy.start)
+{ }
+
 
 //------------------------------------------------------------------------------
 
@@ -41,8 +41,10 @@
 
 #include <aqsis/aqsis.h>
 
+#include <map>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/scoped_array.hpp>
@@ -51,6 +53,8 @@
 //#include <aqsis/util/memorysentry.h>
 #include <aqsis/tex/io/itiledtexinputfile.h>
 #include <aqsis/tex/buffers/texturebuffer.h>
+#include <aqsis/tex/buffers/tileprefetcher.h>
+#include <aqsis/tex/filtering/texturecachestats.h>
 #include "randomtable.h"
 #include <aqsis/util/smartptr.h>
 
@@ -92,9 +96,11 @@ class CqTileArray : boost::noncopyable //, public CqMemoryMonitored
 	public:
 		class CqIterator;
 		class CqStochasticIterator;
+		class CqRowIterator;
 
 		typedef CqIterator TqIterator;
 		typedef CqStochasticIterator TqStochasticIterator;
+		typedef CqRowIterator TqRowIterator;
 		typedef typename TqTile::TqSampleVector TqSampleVector;
 
 		/** \brief Construct a tiled texture array connected to a file
@@ -105,6 +111,8 @@ class CqTileArray : boost::noncopyable //, public CqMemoryMonitored
 		 */
 		CqTileArray(const boost::shared_ptr<IqTiledTexInputFile>& inFile,
 				TqInt subImageIdx);
+		/// Report the memory of all loaded tiles as released.
+		~CqTileArray();
 
 		//--------------------------------------------------
 		/// \name Access to buffer dimensions & metadata
@@ -153,13 +161,53 @@ class CqTileArray : boost::noncopyable //, public CqMemoryMonitored
 		 */
 		TqStochasticIterator beginStochastic(const SqFilterSupport& support,
 				TqInt numSamples) const;
+		/** \brief Access to rows of contiguous pixels in the given support.
+		 *
+		 * Rows never straddle a tile boundary, so the support is split into
+		 * one set of rows per tile which it overlaps.
+		 *
+		 * \param support - support to iterate over
+		 */
+		TqRowIterator beginRows(const SqFilterSupport& support) const;
 		//@}
+
+		/** \brief Start reading the tiles covering the given support in the
+		 * background.
+		 *
+		 * This is only a hint; it does nothing if CqTilePrefetcher isn't
+		 * enabled.  Any earlier prefetches which have finished are made
+		 * resident at the same time.
+		 *
+		 * \param support - region of pixels which will be needed soon.
+		 */
+		void prefetch(const SqFilterSupport& support) const;
 	private:
 		/** \brief Access to the underlying tiles
 		 *
 		 * \return The tile holding the underlying data at the given indices.
 		 */
 		boost::intrusive_ptr<TqTile> getTile(const TqInt x, const TqInt y) const;
+		/// Read a tile from the underlying file, updating the file statistics.
+		void readTile(TqTile& tile, const TqInt x, const TqInt y) const;
+		/// Size in bytes of the pixel data held by a tile.
+		static TqUlong tileBytes(const TqTile& tile);
+		/** \brief Take over a tile from the pending prefetches.
+		 *
+		 * \return The tile, or null if it wasn't prefetched or the
+		 * background read failed.
+		 */
+		boost::intrusive_ptr<TqTile> takePrefetched(const TqInt x, const TqInt y) const;
+		/// Read a tile on an I/O thread.
+		static void readTileBackground(const IqTiledTexInputFile* file,
+				TqTile* tile, TqInt x, TqInt y, TqInt subImageIdx);
+
+		/// A tile which is being read in the background.
+		struct SqPendingTile
+		{
+			boost::intrusive_ptr<TqTile> tile;
+			CqTilePrefetcher::TqRequestPtr request;
+		};
+		typedef std::map<TqInt, SqPendingTile> TqPendingMap;
 
 		/// Underlying texture file.
 		boost::shared_ptr<IqTiledTexInputFile> m_inFile;
@@ -181,6 +229,12 @@ class CqTileArray : boost::noncopyable //, public CqMemoryMonitored
 		TqInt m_heightInTiles;
 		/// "2D" array of tiles.  Tiles may be founnd in O(1) time using this array.
 		boost::scoped_array<boost::intrusive_ptr<TqTile> > m_tiles;
+		/** \brief Tiles being prefetched, indexed as for m_tiles.
+		 *
+		 * Only the render thread touches this and m_tiles; the I/O threads
+		 * only see the tile being read and the file.
+		 */
+		mutable TqPendingMap m_pending;
 };
 
 
@@ -331,6 +385,71 @@ class CqTileArray<T>::CqStochasticIterator
 //==============================================================================
 // Implementation details
 //==============================================================================
+/** \brief Row iterator for data held by CqTileArray.
+ *
+ * This iterator visits the filter support one tile at a time, in the same
+ * order as CqIterator.  Within each tile it yields the rows of the part of the
+ * support covering that tile; the pixels of each row are contiguous in the
+ * underlying tile buffer.
+ */
+template<typename T>
+class CqTileArray<T>::CqRowIterator
+{
+	public:
+		/// Move to the next row in the support.
+		CqRowIterator& operator++();
+
+		/// Check whether the iterator still lies inside the support region.
+		bool inSupport() const;
+
+		/// x-coordinate of the first pixel in the current row
+		TqInt x() const;
+		/// y-coordinate of the current row
+		TqInt y() const;
+		/// Number of pixels in the current row
+		TqInt length() const;
+		/// Channel data for the first pixel in the current row.
+		const T* data() const;
+
+	private:
+		/** \brief Construct a row iterator with the given underlying array
+		 * and support region.
+		 *
+		 * \param tileArray - array to obtain tiles from
+		 * \param support - region to iterate over
+		 */
+		CqRowIterator(const CqTileArray<T>& tileArray, const SqFilterSupport& support);
+
+		/// Load the current tile and compute the part of the support it covers.
+		void initTile();
+		/// Advance to the next tile in the support.
+		void nextTile();
+
+		/// Support region to iterate over.
+		SqFilterSupport m_support;
+		/// Parent array to obtain tiles from.
+		const CqTileArray<T>* m_tileArray;
+		/// Starting x-coordinate (in tile coordinates with 0 being the top-left)
+		const TqInt m_tileX0;
+		/// One greater than the last valid tile x-coordinate
+		const TqInt m_tileXEnd;
+		/// One greater than the last valid tile y-coordinate
+		const TqInt m_tileYEnd;
+		/// Current tile x-coordinate
+		TqInt m_tileX;
+		/// Current tile y-coordinate
+		TqInt m_tileY;
+		/// Current tile
+		boost::intrusive_ptr<TqTile> m_tile;
+		/// Part of the support which lies inside the current tile
+		SqFilterSupport m_tileSupport;
+		/// Current row
+		TqInt m_y;
+
+		friend class CqTileArray<T>;
+};
+
+
 /** \brief A texture tile buffer to be held by CqTileArray.
  *
  * This class is a lightweight wrapper around an array type, ArrayT which holds
@@ -375,6 +494,10 @@ class CqTextureTile : public CqIntrusivePtrCounted
 		{
 			return *m_pixels;
 		}
+		const ArrayT& pixels() const
+		{
+			return *m_pixels;
+		}
 
 		/** \brief 2D Indexing operator - floating point pixel interface.
 		 *
@@ -487,9 +610,30 @@ CqTileArray<T>::CqTileArray(const boost::shared_ptr<IqTiledTexInputFile>& inFile
 	m_tileHeight(inFile->tileInfo().height),
 	m_widthInTiles((m_width-1)/m_tileWidth + 1), // "ceil(m_width/m_tileWidth)"
 	m_heightInTiles((m_height-1)/m_tileHeight + 1),
-	m_tiles(new boost::intrusive_ptr<TqTile>[m_widthInTiles*m_heightInTiles])
+	m_tiles(new boost::intrusive_ptr<TqTile>[m_widthInTiles*m_heightInTiles]),
+	m_pending()
 { }
 
+template<typename T>
+CqTileArray<T>::~CqTileArray()
+{
+	// The I/O threads may still be writing into pending tiles.
+	for(typename TqPendingMap::iterator i = m_pending.begin();
+			i != m_pending.end(); ++i)
+		CqTilePrefetcher::wait(i->second.request);
+	if(CqTextureFileStats* stats = m_inFile->stats())
+	{
+		TqUlong bytes = 0;
+		for(TqInt i = 0, numTiles = m_widthInTiles*m_heightInTiles;
+				i < numTiles; ++i)
+		{
+			if(m_tiles[i])
+				bytes += tileBytes(*m_tiles[i]);
+		}
+		stats->tilesReleased(bytes);
+	}
+}
+
 template<typename T>
 inline TqInt CqTileArray<T>::width() const
 {
@@ -531,6 +675,14 @@ inline typename CqTileArray<T>::TqStochasticIterator CqTileArray<T>::beginStocha
 				SqFilterSupport(0,m_width, 0,m_height)), numSamples);
 }
 
+template<typename T>
+inline typename CqTileArray<T>::TqRowIterator CqTileArray<T>::beginRows(
+		const SqFilterSupport& support) const
+{
+	return TqRowIterator(*this, intersect(support,
+				SqFilterSupport(0,m_width, 0,m_height)));
+}
+
 template<typename T>
 boost::intrusive_ptr<typename CqTileArray<T>::TqTile> CqTileArray<T>::getTile(
 		const TqInt x, const TqInt y) const
@@ -540,13 +692,129 @@ boost::intrusive_ptr<typename CqTileArray<T>::TqTile> CqTileArray<T>::getTile(
 	boost::intrusive_ptr<TqTile>& tilePtr = m_tiles[y*m_widthInTiles + x];
 	if(!tilePtr)
 	{
-		tilePtr = boost::intrusive_ptr<TqTile>(
-				new TqTile(x*m_tileWidth, y*m_tileHeight));
-		m_inFile->readTile(tilePtr->pixels(), x, y, m_subImageIdx);
+		if(!m_pending.empty())
+			tilePtr = takePrefetched(x, y);
+		if(!tilePtr)
+		{
+			tilePtr = boost::intrusive_ptr<TqTile>(
+					new TqTile(x*m_tileWidth, y*m_tileHeight));
+			readTile(*tilePtr, x, y);
+		}
 	}
+	else if(CqTextureFileStats* stats = m_inFile->stats())
+		stats->tileHit();
 	return tilePtr;
 }
 
+template<typename T>
+void CqTileArray<T>::prefetch(const SqFilterSupport& support) const
+{
+	if(!CqTilePrefetcher::enabled())
+		return;
+	CqTextureFileStats* stats = m_inFile->stats();
+	// Make finished prefetches resident, so that lookups of them count as
+	// hits and their memory is accounted for.
+	for(typename TqPendingMap::iterator i = m_pending.begin();
+			i != m_pending.end();)
+	{
+		if(CqTilePrefetcher::finished(i->second.request))
+		{
+			if(CqTilePrefetcher::wait(i->second.request))
+			{
+				m_tiles[i->first] = i->second.tile;
+				if(stats)
+					stats->tilePrefetched(tileBytes(*i->second.tile));
+			}
+			m_pending.erase(i++);
+		}
+		else
+			++i;
+	}
+	SqFilterSupport s = intersect(support, SqFilterSupport(0,m_width, 0,m_height));
+	if(s.isEmpty())
+		return;
+	for(TqInt y = s.sy.start/m_tileHeight, yEnd = (s.sy.end-1)/m_tileHeight;
+			y <= yEnd; ++y)
+	{
+		for(TqInt x = s.sx.start/m_tileWidth, xEnd = (s.sx.end-1)/m_tileWidth;
+				x <= xEnd; ++x)
+		{
+			TqInt index = y*m_widthInTiles + x;
+			if(m_tiles[index] || m_pending.find(index) != m_pending.end())
+				continue;
+			SqPendingTile& pending = m_pending[index];
+			pending.tile = new TqTile(x*m_tileWidth, y*m_tileHeight);
+			pending.request = CqTilePrefetcher::submit(boost::bind(
+					&CqTileArray<T>::readTileBackground, m_inFile.get(),
+					pending.tile.get(), x, y, m_subImageIdx));
+		}
+	}
+}
+
+template<typename T>
+boost::intrusive_ptr<typename CqTileArray<T>::TqTile>
+CqTileArray<T>::takePrefetched(const TqInt x, const TqInt y) const
+{
+	typename TqPendingMap::iterator i = m_pending.find(y*m_widthInTiles + x);
+	if(i == m_pending.end())
+		return boost::intrusive_ptr<TqTile>();
+	SqPendingTile pending = i->second;
+	m_pending.erase(i);
+	CqTextureFileStats* stats = m_inFile->stats();
+	bool succeeded = false;
+	if(stats)
+	{
+		// Count any time spent waiting for the read as I/O time.
+		CqScopeTimer timer(stats->ioTimer());
+		succeeded = CqTilePrefetcher::wait(pending.request);
+	}
+	else
+		succeeded = CqTilePrefetcher::wait(pending.request);
+	if(!succeeded)
+		return boost::intrusive_ptr<TqTile>();
+	if(stats)
+	{
+		stats->tilePrefetched(tileBytes(*pending.tile));
+		stats->tileHit();
+	}
+	return pending.tile;
+}
+
+template<typename T>
+void CqTileArray<T>::readTileBackground(const IqTiledTexInputFile* file,
+		TqTile* tile, TqInt x, TqInt y, TqInt subImageIdx)
+{
+	CqTilePrefetcher::CqFileLock lock(*file);
+	file->readTile(tile->pixels(), x, y, subImageIdx);
+}
+
+// Kept out of line so that the common tile hit path in getTile() stays small.
+template<typename T>
+void CqTileArray<T>::readTile(TqTile& tile, const TqInt x, const TqInt y) const
+{
+	CqTextureFileStats* stats = m_inFile->stats();
+	if(!stats)
+	{
+		CqTilePrefetcher::CqFileLock lock(*m_inFile);
+		m_inFile->readTile(tile.pixels(), x, y, m_subImageIdx);
+		return;
+	}
+	{
+		CqScopeTimer timer(stats->ioTimer());
+		CqTilePrefetcher::CqFileLock lock(*m_inFile);
+		m_inFile->readTile(tile.pixels(), x, y, m_subImageIdx);
+	}
+	stats->tileRead(tileBytes(tile));
+}
+
+template<typename T>
+inline TqUlong CqTileArray<T>::tileBytes(const TqTile& tile)
+{
+	const CqTextureBuffer<T>& pixels = tile.pixels();
+	return static_cast<TqUlong>(pixels.width())*pixels.height()
+		*pixels.numChannels()*sizeof(T);
+}
+
 
 //------------------------------------------------------------------------------
 // CqTileArray::CqIterator implementation
@@ -628,6 +896,97 @@ CqTileArray<T>::CqIterator::CqIterator(const CqTileArray<T>& tileArray,
 }
 
 
+//------------------------------------------------------------------------------
+// CqTileArray<T>::CqRowIterator implementation
+template<typename T>
+inline typename CqTileArray<T>::CqRowIterator&
+CqTileArray<T>::CqRowIterator::operator++()
+{
+	++m_y;
+	if(m_y >= m_tileSupport.sy.end)
+		nextTile();
+	return *this;
+}
+
+template<typename T>
+void CqTileArray<T>::CqRowIterator::initTile()
+{
+	TqInt tileWidth = m_tileArray->m_tileWidth;
+	TqInt tileHeight = m_tileArray->m_tileHeight;
+	m_tile = m_tileArray->getTile(m_tileX, m_tileY);
+	m_tileSupport = intersect(m_support,
+			SqFilterSupport(m_tileX*tileWidth, (m_tileX+1)*tileWidth,
+				m_tileY*tileHeight, (m_tileY+1)*tileHeight));
+	m_y = m_tileSupport.sy.start;
+}
+
+template<typename T>
+void CqTileArray<T>::CqRowIterator::nextTile()
+{
+	++m_tileX;
+	if(m_tileX >= m_tileXEnd)
+	{
+		m_tileX = m_tileX0;
+		++m_tileY;
+	}
+	if(inSupport())
+		initTile();
+}
+
+template<typename T>
+inline bool CqTileArray<T>::CqRowIterator::inSupport() const
+{
+	return m_tileY < m_tileYEnd;
+}
+
+template<typename T>
+inline TqInt CqTileArray<T>::CqRowIterator::x() const
+{
+	return m_tileSupport.sx.start;
+}
+
+template<typename T>
+inline TqInt CqTileArray<T>::CqRowIterator::y() const
+{
+	return m_y;
+}
+
+template<typename T>
+inline TqInt CqTileArray<T>::CqRowIterator::length() const
+{
+	return m_tileSupport.sx.range();
+}
+
+template<typename T>
+inline const T* CqTileArray<T>::CqRowIterator::data() const
+{
+	return m_tile->pixels().value(
+			m_tileSupport.sx.start - m_tileX*m_tileArray->m_tileWidth,
+			m_y - m_tileY*m_tileArray->m_tileHeight);
+}
+
+template<typename T>
+CqTileArray<T>::CqRowIterator::CqRowIterator(const CqTileArray<T>& tileArray,
+		const SqFilterSupport& support)
+	: m_support(support),
+	m_tileArray(&tileArray),
+	m_tileX0(support.sx.start/tileArray.m_tileWidth),
+	m_tileXEnd((support.sx.end-1)/tileArray.m_tileWidth + 1),
+	m_tileYEnd((support.sy.end-1)/tileArray.m_tileHeight + 1),
+	m_tileX(m_tileX0),
+	m_tileY(support.sy.start/tileArray.m_tileHeight),
+	m_tile(),
+	m_tileSupport(),
+	m_y(0)
+{
+	// Make sure that inSupport() works correctly when the support is empty.
+	if(support.isEmpty())
+		m_tileY = m_tileYEnd;
+	else
+		initTile();
+}
+
+
 //------------------------------------------------------------------------------
 // CqTileArray<T>::CqStochasticIterator implementation
 template<typename T>
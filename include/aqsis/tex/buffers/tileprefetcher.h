@@ -0,0 +1,117 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Background reading of texture tiles.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#ifndef TILEPREFETCHER_H_INCLUDED
+#define TILEPREFETCHER_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Aqsis {
+
+class IqTiledTexInputFile;
+
+//------------------------------------------------------------------------------
+/** \brief A pool of I/O threads for reading texture tiles ahead of use.
+ *
+ * Tile arrays submit reads for tiles which are likely to be needed soon; the
+ * reads run on the I/O threads while the render thread gets on with shading.
+ * When the render thread needs a tile which has been submitted, it waits for
+ * the request.  A request which hasn't started yet is simply run in the
+ * waiting thread, so waiting never costs more than reading the tile directly.
+ *
+ * The pool is shared by all texture files.  It starts with no threads, in
+ * which case enabled() returns false.
+ */
+class AQSIS_TEX_SHARE CqTilePrefetcher
+{
+	public:
+		/// Opaque state for a submitted read.
+		class CqRequest;
+		typedef boost::shared_ptr<CqRequest> TqRequestPtr;
+		/// Type of the functions which do the reading.
+		typedef boost::function<void ()> TqReadFunc;
+
+		/** \brief Set the number of I/O threads.
+		 *
+		 * Outstanding requests are completed before the old threads exit.
+		 *
+		 * \param numThreads - number of threads; zero disables prefetching.
+		 */
+		static void setNumThreads(TqInt numThreads);
+		/// Determine whether there are any I/O threads to service requests.
+		static bool enabled();
+
+		/** \brief Queue a read to be run on one of the I/O threads.
+		 *
+		 * The read function must not touch any state which is shared with
+		 * the render thread, apart from the file it reads from (which should
+		 * be locked with a CqFileLock).
+		 */
+		static TqRequestPtr submit(const TqReadFunc& read);
+		/** \brief Wait for a request to complete.
+		 *
+		 * \return false if the read function threw an exception, in which
+		 * case the caller should redo the read itself to get at the error.
+		 */
+		static bool wait(const TqRequestPtr& request);
+		/// Determine whether a request has completed, without blocking.
+		static bool finished(const TqRequestPtr& request);
+
+		/** \brief Lock serializing reads from a file.
+		 *
+		 * Texture file handles aren't safe to use from multiple threads at
+		 * once, so every read from a file which may be prefetched must hold
+		 * one of these.
+		 */
+		class AQSIS_TEX_SHARE CqFileLock : private boost::noncopyable
+		{
+			public:
+				CqFileLock(const IqTiledTexInputFile& file);
+				~CqFileLock();
+			private:
+				/// Index of the mutex protecting the file.
+				TqInt m_mutexIndex;
+		};
+};
+
+} // namespace Aqsis
+
+#endif // TILEPREFETCHER_H_INCLUDED
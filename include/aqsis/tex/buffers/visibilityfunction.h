@@ -0,0 +1,190 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Piecewise linear visibility functions, as stored in deep shadow maps.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#ifndef VISIBILITYFUNCTION_H_INCLUDED
+#define VISIBILITYFUNCTION_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <vector>
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+/// A vertex of a piecewise linear visibility function.
+struct SqVisibilityNode
+{
+	/// Depth of the node along the light direction.
+	TqFloat depth;
+	/// Fraction of light passing through to this depth.
+	TqFloat visibility;
+
+	SqVisibilityNode(TqFloat depth = 0, TqFloat visibility = 1);
+};
+
+/** \brief A change in visibility at a given depth.
+ *
+ * Visibility functions are built up from the surface hits of the samples in
+ * a pixel.  A hit of opacity o on a sample with filter weight w and
+ * transmittance T in front of the hit reduces the pixel visibility by
+ * w*T*o, which is recorded as a step.
+ */
+struct SqVisibilityStep
+{
+	/// Depth at which the step occurs
+	TqFloat depth;
+	/// Change in visibility (negative for occluding surfaces)
+	TqFloat deltaVisibility;
+
+	SqVisibilityStep(TqFloat depth = 0, TqFloat deltaVisibility = 0);
+	/// Order steps by depth.
+	bool operator<(const SqVisibilityStep& rhs) const;
+};
+
+//------------------------------------------------------------------------------
+/** \brief Visibility as a function of depth for a single deep shadow pixel.
+ *
+ * The function is stored as a list of nodes with nondecreasing depth.
+ * Between nodes the visibility is linearly interpolated; in front of the
+ * first node it's equal to 1 and behind the last node it's equal to the
+ * visibility of the last node.  A discontinuity is stored as a pair of nodes
+ * at the same depth, holding the visibility in front of and behind it; at
+ * the depth itself the function takes the value behind.  An empty function
+ * is fully visible at all depths.
+ *
+ * This is the representation used by Lokovic and Veach in "Deep Shadow
+ * Maps", SIGGRAPH 2000: the exact step functions produced by the hider are
+ * compressed by compress() into a much smaller number of linear segments,
+ * which is what makes deep shadows for fur and volumes affordable.
+ */
+class AQSIS_TEX_SHARE CqVisibilityFunction
+{
+	public:
+		/// Construct a fully visible function.
+		CqVisibilityFunction();
+
+		/** \brief Set the function from a set of visibility steps.
+		 *
+		 * The steps are sorted by depth and accumulated, starting from a
+		 * visibility of 1.  Steps at the same depth are merged, and each
+		 * resulting step is stored as a discontinuity, so the function is
+		 * piecewise constant between hits.
+		 *
+		 * \param steps - list of steps; reordered by this function.
+		 */
+		void setSteps(std::vector<SqVisibilityStep>& steps);
+
+		/** \brief Set the function to a weighted average of other functions.
+		 *
+		 * The nodes of the result lie at the union of the node depths of the
+		 * input functions, with discontinuities wherever an input has one.
+		 * This is used for building the mipmap levels of a
+		 * deep shadow map; compress() should normally be called afterward.
+		 *
+		 * \param funcs - array of numFuncs functions to average.
+		 * \param weights - filter weights for funcs, assumed to sum to 1.
+		 */
+		void setAverage(const CqVisibilityFunction* const* funcs,
+				const TqFloat* weights, TqInt numFuncs);
+
+		/** \brief Reduce the number of nodes within a given error bound.
+		 *
+		 * Nodes are greedily merged into the longest linear segments which
+		 * stay within tolerance of the original function at all of its
+		 * nodes, on both sides of each discontinuity.  Discontinuities
+		 * larger than the tolerance are kept.  The first node and the depth
+		 * of the last node are preserved exactly.
+		 *
+		 * \param tolerance - maximum allowed absolute error in visibility.
+		 */
+		void compress(TqFloat tolerance);
+
+		/// Evaluate the visibility at the given depth.
+		TqFloat visibility(TqFloat depth) const;
+
+		/// Get the nodes making up the function.
+		const std::vector<SqVisibilityNode>& nodes() const;
+		/// Get the nodes making up the function for modification.
+		std::vector<SqVisibilityNode>& nodes();
+
+		/// Exchange the contents of two functions.
+		void swap(CqVisibilityFunction& other);
+	private:
+		std::vector<SqVisibilityNode> m_nodes;
+};
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+inline SqVisibilityNode::SqVisibilityNode(TqFloat depth, TqFloat visibility)
+	: depth(depth),
+	visibility(visibility)
+{ }
+
+inline SqVisibilityStep::SqVisibilityStep(TqFloat depth, TqFloat deltaVisibility)
+	: depth(depth),
+	deltaVisibility(deltaVisibility)
+{ }
+
+inline bool SqVisibilityStep::operator<(const SqVisibilityStep& rhs) const
+{
+	return depth < rhs.depth;
+}
+
+inline CqVisibilityFunction::CqVisibilityFunction()
+	: m_nodes()
+{ }
+
+inline const std::vector<SqVisibilityNode>& CqVisibilityFunction::nodes() const
+{
+	return m_nodes;
+}
+
+inline std::vector<SqVisibilityNode>& CqVisibilityFunction::nodes()
+{
+	return m_nodes;
+}
+
+inline void CqVisibilityFunction::swap(CqVisibilityFunction& other)
+{
+	m_nodes.swap(other.m_nodes);
+}
+
+} // namespace Aqsis
+
+#endif // VISIBILITYFUNCTION_H_INCLUDED
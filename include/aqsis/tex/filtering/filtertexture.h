@@ -79,6 +79,24 @@ template<typename SampleAccumT, typename ArrayT>
 void filterTexture(SampleAccumT& sampleAccum, const ArrayT& buffer,
 		const SqFilterSupport& support, const SqWrapModes wrapModes);
 
+/** \brief Filter a texture buffer over the supplied region, row by row.
+ *
+ * This function gives the same result as filterTexture(), but the part of the
+ * support lying inside the buffer is presented to the accumulator a row of
+ * pixels at a time.  This allows the filter weights and channel sums for the
+ * row to be computed together rather than pixel by pixel.
+ *
+ * SampleAccumT - A model of RowSampleAccumulatorConcept.
+ * ArrayT - As for filterTexture(), but additionally providing a row iterator
+ *          of type ArrayT::TqRowIterator via a beginRows() method.  See
+ *          CqTileArray for a model.
+ *
+ * \see filterTexture() for more details.
+ */
+template<typename SampleAccumT, typename ArrayT>
+void filterTextureRows(SampleAccumT& sampleAccum, const ArrayT& buffer,
+		const SqFilterSupport& support, const SqWrapModes wrapModes);
+
 /** \brief Filter a texture without wrapping at the edges.
  *
  * This function works just like filterTexture(), except that instead of
@@ -217,23 +235,17 @@ void filterWrappedBuffer(SampleAccumT& sampleAccum, const ArrayT& buffer,
 	}
 }
 
-} // namespace detail
-
+/** \brief Accumulate samples from all the parts of the support outside the
+ * buffer.
+ *
+ * The buffer is imagined to tile the plane; each tile which the support
+ * crosses (other than the buffer itself) is filtered with
+ * filterWrappedBuffer().
+ */
 template<typename SampleAccumT, typename ArrayT>
-void filterTexture(SampleAccumT& sampleAccum, const ArrayT& buffer,
+void filterWrappedTiles(SampleAccumT& sampleAccum, const ArrayT& buffer,
 		const SqFilterSupport& support, const SqWrapModes wrapModes)
 {
-	if(!sampleAccum.setSampleVectorLength(buffer.numChannels()))
-		return;
-
-	// First accumulate samples across the part of the support which lies
-	// inside the buffer.  Note that this may be empty; we could check for this
-	// first with support.intersectsRange() if it helps performance...
-	for(typename ArrayT::TqIterator i = buffer.begin(support); i.inSupport(); ++i)
-		sampleAccum.accumulate(i.x(), i.y(), *i);
-
-	// Next, if the support isn't wholly inside the buffer, we need to consider
-	// the wrap modes.
 	if(!support.inRange(0, buffer.width(), 0, buffer.height()))
 	{
 		// The texture buffer tiles the plane; we iterate over the tiles which
@@ -251,18 +263,53 @@ void filterTexture(SampleAccumT& sampleAccum, const ArrayT& buffer,
 			for(TqInt tlY = y0; tlY < support.sy.end; tlY += buffer.height())
 			{
 				// The special case of the non-translated source buffer, where
-				// tlX = tlY == 0 is already dealt with in the first
-				// iteration above.
+				// tlX = tlY == 0 is dealt with separately by the caller.
 				if(tlX == 0 && tlY == 0)
 					continue;
 
-				detail::filterWrappedBuffer(sampleAccum, buffer, support,
+				filterWrappedBuffer(sampleAccum, buffer, support,
 						wrapModes, tlX, tlY);
 			}
 		}
 	}
 }
 
+} // namespace detail
+
+template<typename SampleAccumT, typename ArrayT>
+void filterTexture(SampleAccumT& sampleAccum, const ArrayT& buffer,
+		const SqFilterSupport& support, const SqWrapModes wrapModes)
+{
+	if(!sampleAccum.setSampleVectorLength(buffer.numChannels()))
+		return;
+
+	// First accumulate samples across the part of the support which lies
+	// inside the buffer.  Note that this may be empty; we could check for this
+	// first with support.intersectsRange() if it helps performance...
+	for(typename ArrayT::TqIterator i = buffer.begin(support); i.inSupport(); ++i)
+		sampleAccum.accumulate(i.x(), i.y(), *i);
+
+	// Next, if the support isn't wholly inside the buffer, we need to consider
+	// the wrap modes.
+	detail::filterWrappedTiles(sampleAccum, buffer, support, wrapModes);
+}
+
+template<typename SampleAccumT, typename ArrayT>
+void filterTextureRows(SampleAccumT& sampleAccum, const ArrayT& buffer,
+		const SqFilterSupport& support, const SqWrapModes wrapModes)
+{
+	if(!sampleAccum.setSampleVectorLength(buffer.numChannels()))
+		return;
+
+	for(typename ArrayT::TqRowIterator i = buffer.beginRows(support);
+			i.inSupport(); ++i)
+		sampleAccum.accumulateRow(i.x(), i.y(), i.length(), i.data());
+
+	// Wrapped regions are rare and usually small, so they're handled pixel
+	// by pixel as for filterTexture().
+	detail::filterWrappedTiles(sampleAccum, buffer, support, wrapModes);
+}
+
 template<typename SampleAccumT, typename ArrayT>
 void filterTextureNowrap(SampleAccumT& sampleAccum, const ArrayT& buffer,
 		const SqFilterSupport& support)
@@ -52,6 +52,7 @@ class IqEnvironmentSampler;
 class IqTiledTexInputFile;
 class CqTexFileHeader;
 class CqMatrix;
+class CqTextureCacheStats;
 
 /** \brief A cache interface for managing the various types of texture
  * samplers.
@@ -91,6 +92,15 @@ struct AQSIS_TEX_SHARE IqTextureCache
 	//--------------------------------------------------
 	/// Delete all textures from the cache
 	virtual void flush() = 0;
+	/** \brief Delete the textures which can't be used for another frame.
+	 *
+	 * Plain textures and environment maps are kept unless the current search
+	 * path finds a different file for them, or their file has changed size
+	 * or modification time.  Shadow and occlusion samplers depend on the
+	 * camera of the frame which created them, and their maps are usually
+	 * rendered along with the scene, so they're always deleted.
+	 */
+	virtual void flushStale() = 0;
 
 	/** \brief Return the texture file attributes for the named file.
 	 *
@@ -109,6 +119,47 @@ struct AQSIS_TEX_SHARE IqTextureCache
 	 * \param currToWorld - current -> world transformation.
 	 */
 	virtual void setCurrToWorldMatrix(const CqMatrix& currToWorld) = 0;
+
+	/** \brief Access statistics for the textures used through the cache.
+	 *
+	 * The statistics are kept when the cache is flushed; they should be reset
+	 * explicitly at the start of each frame.
+	 */
+	virtual CqTextureCacheStats& stats() = 0;
+
+	//--------------------------------------------------
+	/// \name Prefetching
+	//@{
+	/** \brief Record that a texture was sampled on behalf of a client.
+	 *
+	 * The cache remembers the textures sampled for each client so that
+	 * prefetchTextures() can guess which textures the client will sample
+	 * next.  Clients are typically shaders.
+	 *
+	 * \param client - opaque key identifying the client.
+	 * \param sampler - a sampler previously obtained from this cache.
+	 */
+	virtual void recordTextureUse(const void* client,
+			const IqTextureSampler& sampler) = 0;
+	/** \brief Prefetch the textures recently used by a client.
+	 *
+	 * This assumes the client will sample the same textures as last time
+	 * over the given region of texture space; any data needed which isn't
+	 * resident is read in the background.
+	 *
+	 * \param client - opaque key identifying the client.
+	 * \param sMin, sMax, tMin, tMax - region in texture coordinates.
+	 * \param filterWidth - expected filter width in texture coordinates.
+	 */
+	virtual void prefetchTextures(const void* client, TqFloat sMin,
+			TqFloat sMax, TqFloat tMin, TqFloat tMax, TqFloat filterWidth) = 0;
+	/** \brief Set the number of threads used for reading texture data in
+	 * the background.
+	 *
+	 * \param numThreads - number of threads; zero disables prefetching.
+	 */
+	virtual void setPrefetchThreads(TqInt numThreads) = 0;
+	//@}
 };
 
 
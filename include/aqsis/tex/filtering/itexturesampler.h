@@ -103,6 +103,20 @@ class AQSIS_TEX_SHARE IqTextureSampler
 		 */
 		virtual const CqTextureSampleOptions& defaultSampleOptions() const;
 
+		/** \brief Hint that a region of the texture will be sampled soon.
+		 *
+		 * Samplers backed by files may use this to start reading the
+		 * relevant texture data in the background.  The default
+		 * implementation does nothing.
+		 *
+		 * \param sMin, sMax, tMin, tMax - bounds of the region in texture
+		 *                                coordinates.
+		 * \param filterWidth - expected width of the filter region for
+		 *                      each sample, used to choose the mipmap level.
+		 */
+		virtual void prefetch(TqFloat sMin, TqFloat sMax, TqFloat tMin,
+				TqFloat tMax, TqFloat filterWidth) const;
+
 		//--------------------------------------------------
 		/// \name Factory functions
 		//@{
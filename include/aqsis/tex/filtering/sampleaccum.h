@@ -41,6 +41,10 @@
 
 #include <aqsis/aqsis.h>
 
+#include <limits>
+
+#include <aqsis/util/autobuffer.h>
+
 namespace Aqsis {
 
 /** \class SampleAccumulatorConcept
@@ -98,6 +102,21 @@ namespace Aqsis {
  * bool setSampleVectorLength(TqInt sampleVectorLength);
  *
  * \endcode
+ *
+ * Accumulators may optionally accept a whole row of contiguous pixels at once,
+ * which allows the filter weights for the row to be computed together.  Such
+ * accumulators model RowSampleAccumulatorConcept by providing the additional
+ * method
+ *
+ * \code
+ *
+ * // Accumulate numPixels pixels starting at (x,y) and extending along the
+ * // x-direction.  rowData points to the raw channel data for the first pixel;
+ * // pixels are spaced by the sample vector length.
+ * template<typename T>
+ * void accumulateRow(TqInt x, TqInt y, TqInt numPixels, const T* rowData);
+ *
+ * \endcode
  */
 
 //------------------------------------------------------------------------------
@@ -153,6 +172,20 @@ class CqSampleAccum
 		template<typename SampleVectorT>
 		inline void accumulate(TqInt x, TqInt y, const SampleVectorT& inSamples);
 
+		/** \brief Accumulate a row of pixels into the output buffer.
+		 *
+		 * This requires that FilterWeightT provides a rowWeights() method
+		 * with the same semantics as CqEwaFilter::rowWeights().
+		 *
+		 * \param x
+		 * \param y - position of the first pixel in the row.
+		 * \param numPixels - number of pixels in the row.
+		 * \param rowData - raw channel data for the row.
+		 */
+		template<typename T>
+		inline void accumulateRow(TqInt x, TqInt y, TqInt numPixels,
+				const T* rowData);
+
 		/// Cleanup; renormalize the accumulated data if necessary.
 		inline ~CqSampleAccum();
 	private:
@@ -172,6 +205,8 @@ class CqSampleAccum
 		TqFloat m_fill;
 		/// Total accumulated weight used to renormalize the samples.
 		TqFloat m_totWeight;
+		/// Length of the sample vectors, used as the pixel stride for rows.
+		TqInt m_sampleVectorLength;
 };
 
 
@@ -268,7 +303,8 @@ inline CqSampleAccum<FilterWeightT>::CqSampleAccum(
 	m_numChansFill(0),
 	m_resultBuf(resultBuf),
 	m_fill(fill),
-	m_totWeight(0)
+	m_totWeight(0),
+	m_sampleVectorLength(0)
 {
 	// Zero the output channel on construction
 	for(TqInt i = 0; i < m_numChans; ++i)
@@ -279,6 +315,7 @@ template<typename FilterWeightT>
 inline bool CqSampleAccum<FilterWeightT>::setSampleVectorLength(TqInt sampleVectorLength)
 {
 	assert(sampleVectorLength > 0);
+	m_sampleVectorLength = sampleVectorLength;
 	TqInt totNumChans = m_numChans + m_numChansFill;
 	if(m_startChan + totNumChans <= sampleVectorLength)
 	{
@@ -320,6 +357,36 @@ inline void CqSampleAccum<FilterWeightT>::accumulate(TqInt x, TqInt y,
 	}
 }
 
+template<typename FilterWeightT>
+template<typename T>
+inline void CqSampleAccum<FilterWeightT>::accumulateRow(TqInt x, TqInt y,
+		TqInt numPixels, const T* rowData)
+{
+	CqAutoBuffer<TqFloat, 64> weights(numPixels);
+	m_filterWeights.rowWeights(x, y, numPixels, weights.get());
+	// Integer channel data is mapped onto [0,1] as for CqSampleVector; the
+	// scaling is applied once to the final sums rather than per pixel.
+	const TqFloat scale = std::numeric_limits<T>::is_integer
+		? 1.0/std::numeric_limits<T>::max() : 1;
+	const T* samples = rowData + m_startChan;
+	TqFloat rowWeight = 0;
+	CqAutoBuffer<TqFloat, 16> rowSum(m_numChans, 0);
+	for(TqInt i = 0; i < numPixels; ++i, samples += m_sampleVectorLength)
+	{
+		TqFloat w = weights[i];
+		if(w != 0)
+		{
+			rowWeight += w;
+			for(TqInt c = 0; c < m_numChans; ++c)
+				rowSum[c] += w*samples[c];
+		}
+	}
+	if(!m_filterWeights.isNormalized())
+		m_totWeight += rowWeight;
+	for(TqInt c = 0; c < m_numChans; ++c)
+		m_resultBuf[c] += scale*rowSum[c];
+}
+
 template<typename FilterWeightT>
 inline CqSampleAccum<FilterWeightT>::~CqSampleAccum()
 {
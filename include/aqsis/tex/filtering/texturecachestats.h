@@ -0,0 +1,262 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Access and memory statistics for the texture cache.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#ifndef TEXTURECACHESTATS_H_INCLUDED
+#define TEXTURECACHESTATS_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/util/timer.h>
+
+namespace Aqsis {
+
+class CqTextureCacheStats;
+
+//------------------------------------------------------------------------------
+/** \brief Access counters for a single texture file.
+ *
+ * One of these is attached to each file opened by the texture cache.  The
+ * counters are updated by the tile arrays reading from the file, so they're
+ * deliberately kept as cheap as possible: a tile hit is a single increment.
+ *
+ * Texture lookups are only made from the main render thread, so the counters
+ * are not protected by any locking.
+ */
+class AQSIS_TEX_SHARE CqTextureFileStats : private boost::noncopyable
+{
+	public:
+		/** \brief Create a set of counters for the given file.
+		 *
+		 * \param fileName - name of the file, used when reporting.
+		 * \param cacheStats - cache-wide statistics which should be updated
+		 *                     along with the per-file counters, or null.
+		 */
+		CqTextureFileStats(const std::string& fileName,
+				CqTextureCacheStats* cacheStats = 0);
+
+		/// Record a lookup of a tile which was already resident.
+		void tileHit();
+		/// Timer which should run while tile data is read from disk.
+		CqTimer& ioTimer();
+		/// Record that a tile of the given size was read from disk.
+		void tileRead(TqUlong bytes);
+		/// Record that a tile read in the background became resident.
+		void tilePrefetched(TqUlong bytes);
+		/// Record that tiles holding the given number of bytes were freed.
+		void tilesReleased(TqUlong bytes);
+
+		/// Reset the access counters, keeping the resident memory count.
+		void reset();
+
+		/// \name Counter access
+		//@{
+		const std::string& fileName() const;
+		TqUlong tileHits() const;
+		TqUlong tileMisses() const;
+		TqUlong tilesPrefetched() const;
+		TqUlong bytesRead() const;
+		TqUlong residentBytes() const;
+		/** \brief Time the render thread spent reading tiles in seconds.
+		 *
+		 * This includes time spent waiting for tiles which were being
+		 * prefetched, but not the time taken by reads which finished in the
+		 * background.
+		 */
+		double ioTime() const;
+		//@}
+
+	private:
+		std::string m_fileName;
+		CqTextureCacheStats* m_cacheStats;
+		TqUlong m_tileHits;
+		TqUlong m_tileMisses;
+		TqUlong m_tilesPrefetched;
+		TqUlong m_bytesRead;
+		TqUlong m_residentBytes;
+		CqTimer m_ioTimer;
+		/// Total time recorded in m_ioTimer at the last reset().
+		double m_ioTimeOffset;
+};
+
+
+//------------------------------------------------------------------------------
+/** \brief Texture statistics accumulated over all files used by a cache.
+ *
+ * Per-file statistics are held by name, so that the numbers for a texture
+ * survive the cache being flushed at the end of a frame and are accumulated
+ * if the texture is opened again.
+ */
+class AQSIS_TEX_SHARE CqTextureCacheStats : private boost::noncopyable
+{
+	public:
+		CqTextureCacheStats();
+
+		/** \brief Get the counters for the named file, creating them if
+		 * necessary.
+		 *
+		 * Each call counts as one file being opened.
+		 */
+		boost::shared_ptr<CqTextureFileStats> fileOpened(
+				const std::string& fileName);
+
+		/** \brief Reset all counters for the start of a new frame.
+		 *
+		 * Counters for files which are no longer open are discarded; the peak
+		 * resident memory is reset to the current resident memory.
+		 */
+		void reset();
+
+		/// \name Totals over all files
+		//@{
+		TqUlong tileHits() const;
+		TqUlong tileMisses() const;
+		TqUlong tilesPrefetched() const;
+		TqUlong bytesRead() const;
+		double ioTime() const;
+		/// Fraction of tile lookups which didn't need to touch the disk.
+		double hitRate() const;
+		/// Number of times a file was opened since the last reset.
+		TqInt filesOpened() const;
+		/// Bytes of tile data currently resident in memory.
+		TqUlong residentBytes() const;
+		/// Maximum of residentBytes() since the last reset.
+		TqUlong peakResidentBytes() const;
+		//@}
+
+		/** \brief Print a human-readable summary.
+		 *
+		 * \param out - stream to print to
+		 * \param topN - number of textures to list, ordered by bytes read.
+		 */
+		void printReport(std::ostream& out, TqInt topN) const;
+		/** \brief Write all statistics to a stream in JSON format.
+		 *
+		 * This is intended for consumption by render management tools; all
+		 * files are listed, ordered by bytes read.
+		 */
+		void writeJson(std::ostream& out) const;
+
+	private:
+		friend class CqTextureFileStats;
+		/// Adjust the resident memory count, tracking the peak.
+		void adjustResident(TqUlong added, TqUlong removed);
+
+		typedef std::map<std::string, boost::shared_ptr<CqTextureFileStats> >
+			TqFileStatsMap;
+		TqFileStatsMap m_fileStats;
+		TqInt m_filesOpened;
+		TqUlong m_residentBytes;
+		TqUlong m_peakResidentBytes;
+};
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+// CqTextureFileStats
+inline void CqTextureFileStats::tileHit()
+{
+	++m_tileHits;
+}
+
+inline CqTimer& CqTextureFileStats::ioTimer()
+{
+	return m_ioTimer;
+}
+
+inline const std::string& CqTextureFileStats::fileName() const
+{
+	return m_fileName;
+}
+
+inline TqUlong CqTextureFileStats::tileHits() const
+{
+	return m_tileHits;
+}
+
+inline TqUlong CqTextureFileStats::tileMisses() const
+{
+	return m_tileMisses;
+}
+
+inline TqUlong CqTextureFileStats::tilesPrefetched() const
+{
+	return m_tilesPrefetched;
+}
+
+inline TqUlong CqTextureFileStats::bytesRead() const
+{
+	return m_bytesRead;
+}
+
+inline TqUlong CqTextureFileStats::residentBytes() const
+{
+	return m_residentBytes;
+}
+
+inline double CqTextureFileStats::ioTime() const
+{
+	return m_ioTimer.totalTime() - m_ioTimeOffset;
+}
+
+//------------------------------------------------------------------------------
+// CqTextureCacheStats
+inline TqInt CqTextureCacheStats::filesOpened() const
+{
+	return m_filesOpened;
+}
+
+inline TqUlong CqTextureCacheStats::residentBytes() const
+{
+	return m_residentBytes;
+}
+
+inline TqUlong CqTextureCacheStats::peakResidentBytes() const
+{
+	return m_peakResidentBytes;
+}
+
+} // namespace Aqsis
+
+#endif // TEXTURECACHESTATS_H_INCLUDED
@@ -0,0 +1,264 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Reading and writing of tiled, mipmapped deep shadow map files.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#ifndef DEEPSHADOWFILE_H_INCLUDED
+#define DEEPSHADOWFILE_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <fstream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <aqsis/math/matrix.h>
+#include <aqsis/tex/buffers/visibilityfunction.h>
+#include <aqsis/util/file.h>
+
+namespace Aqsis {
+
+/** \brief Deep shadow file layout
+ *
+ * Aqsis deep shadow files hold one visibility function per pixel, stored as
+ * a set of mipmap levels each split into square tiles.  All numbers are in
+ * the native byte order, as for aqsis z-files:
+ *
+ *   - the magic number "Aqsis deep shadow" followed by a TqUint32 version,
+ *   - TqInt32 width, height, tile size and number of mipmap levels,
+ *   - world -> screen and world -> camera matrices (16 TqFloat each),
+ *   - a tile table holding an entry for each tile of each level, in order of
+ *     level then row-major tile position: a 64-bit file offset, TqUint32
+ *     compressed size and TqUint32 raw size,
+ *   - the tiles, each compressed with zlib.  A raw tile holds each of its
+ *     pixels in row-major order as a TqUint32 node count followed by the
+ *     (depth, visibility) nodes as pairs of TqFloat.
+ *
+ * Each mipmap level is half the size of the previous one, rounded up, and
+ * each of its pixels is the average of the corresponding 2x2 block of the
+ * previous level.
+ */
+namespace deepshadow {
+	/// Magic number at the start of every deep shadow file
+	extern AQSIS_TEX_SHARE const char magicNumber[];
+	/// Length of the magic number, excluding the terminating null.
+	const TqInt magicNumberSize = 17;
+	/// Current file format version.
+	const TqUint32 version = 1;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Write a deep shadow map to file.
+ *
+ * Pixels may be set in any order, so this class can be fed directly from
+ * rendered buckets.  The full resolution level is held in memory until
+ * close() is called, at which point the coarser mipmap levels are built and
+ * all levels are written out.
+ */
+class AQSIS_TEX_SHARE CqDeepShadowOutputFile : private boost::noncopyable
+{
+	public:
+		/** \brief Prepare to write a deep shadow map.
+		 *
+		 * The file itself is opened when close() is called.
+		 *
+		 * \param fileName - name of the file to write.
+		 * \param width - width of the map in pixels.
+		 * \param height - height of the map in pixels.
+		 * \param worldToScreen - world -> light screen space transformation.
+		 * \param worldToCamera - world -> light camera space transformation.
+		 * \param tolerance - error tolerance for compressing the visibility
+		 *                    functions of the mipmap levels.
+		 * \param tileSize - width and height of tiles in the file.
+		 */
+		CqDeepShadowOutputFile(const boostfs::path& fileName, TqInt width,
+				TqInt height, const CqMatrix& worldToScreen,
+				const CqMatrix& worldToCamera, TqFloat tolerance = 0.005f,
+				TqInt tileSize = 32);
+		/// Write the file if close() hasn't already been called.
+		~CqDeepShadowOutputFile();
+
+		/** \brief Set the visibility function for a pixel.
+		 *
+		 * The contents of func are taken by swapping, to avoid copying.
+		 */
+		void setPixel(TqInt x, TqInt y, CqVisibilityFunction& func);
+
+		/** \brief Build the mipmap levels and write everything to disk.
+		 *
+		 * Throws XqInvalidFile if the file can't be written.
+		 */
+		void close();
+
+	private:
+		typedef std::vector<CqVisibilityFunction> TqLevel;
+
+		/// Location of a tile within the file
+		struct SqTileEntry
+		{
+			boost::uint64_t offset;
+			TqUint32 compressedSize;
+			TqUint32 rawSize;
+		};
+
+		/// Compress and write the tiles of a level, recording their locations.
+		void writeLevel(std::ostream& out, const TqLevel& level, TqInt width,
+				TqInt height, std::vector<SqTileEntry>& entries) const;
+
+		/// File name to write to
+		boostfs::path m_fileName;
+		/// Width of level 0
+		TqInt m_width;
+		/// Height of level 0
+		TqInt m_height;
+		/// Transformations for the light view
+		CqMatrix m_worldToScreen;
+		CqMatrix m_worldToCamera;
+		/// Compression tolerance for visibility functions
+		TqFloat m_tolerance;
+		/// Tile width and height
+		TqInt m_tileSize;
+		/// Visibility functions for level 0
+		TqLevel m_pixels;
+		/// True once close() has been called.
+		bool m_closed;
+};
+
+//------------------------------------------------------------------------------
+/** \brief Read access to a deep shadow map file.
+ *
+ * Tiles are decompressed on demand the first time a pixel inside them is
+ * requested, and kept in memory thereafter.
+ */
+class AQSIS_TEX_SHARE CqDeepShadowInputFile : private boost::noncopyable
+{
+	public:
+		/** \brief Open a deep shadow file and read its header.
+		 *
+		 * Throws XqInvalidFile if the file can't be opened, or XqBadTexture
+		 * if it's not a valid deep shadow file.
+		 */
+		CqDeepShadowInputFile(const boostfs::path& fileName);
+
+		/// Get the name of the underlying file.
+		const boostfs::path& fileName() const;
+		/// Get the number of mipmap levels in the file.
+		TqInt numLevels() const;
+		/// Get the width of the given mipmap level.
+		TqInt width(TqInt level = 0) const;
+		/// Get the height of the given mipmap level.
+		TqInt height(TqInt level = 0) const;
+		/// Get the world -> light screen transformation.
+		const CqMatrix& worldToScreen() const;
+		/// Get the world -> light camera transformation.
+		const CqMatrix& worldToCamera() const;
+
+		/** \brief Get the visibility function for a pixel of a mipmap level.
+		 *
+		 * x and y must lie inside the level.
+		 */
+		const CqVisibilityFunction& pixel(TqInt x, TqInt y, TqInt level = 0) const;
+
+	private:
+		typedef std::vector<CqVisibilityFunction> TqTile;
+		/// Location of a tile within the file.
+		struct SqTileEntry
+		{
+			boost::uint64_t offset;
+			TqUint32 compressedSize;
+			TqUint32 rawSize;
+			/// Decompressed tile, or null if not read yet.
+			boost::shared_ptr<TqTile> tile;
+		};
+		/// Information about a mipmap level.
+		struct SqLevel
+		{
+			TqInt width;
+			TqInt height;
+			TqInt tilesPerRow;
+			std::vector<SqTileEntry> tiles;
+		};
+
+		/// Read and decompress a tile.
+		void readTile(SqTileEntry& entry, TqInt tileWidth, TqInt tileHeight) const;
+
+		boostfs::path m_fileName;
+		mutable std::ifstream m_fileStream;
+		TqInt m_tileSize;
+		CqMatrix m_worldToScreen;
+		CqMatrix m_worldToCamera;
+		mutable std::vector<SqLevel> m_levels;
+};
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+inline const boostfs::path& CqDeepShadowInputFile::fileName() const
+{
+	return m_fileName;
+}
+
+inline TqInt CqDeepShadowInputFile::numLevels() const
+{
+	return m_levels.size();
+}
+
+inline TqInt CqDeepShadowInputFile::width(TqInt level) const
+{
+	return m_levels[level].width;
+}
+
+inline TqInt CqDeepShadowInputFile::height(TqInt level) const
+{
+	return m_levels[level].height;
+}
+
+inline const CqMatrix& CqDeepShadowInputFile::worldToScreen() const
+{
+	return m_worldToScreen;
+}
+
+inline const CqMatrix& CqDeepShadowInputFile::worldToCamera() const
+{
+	return m_worldToCamera;
+}
+
+} // namespace Aqsis
+
+#endif // DEEPSHADOWFILE_H_INCLUDED
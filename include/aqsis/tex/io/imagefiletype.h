@@ -52,6 +52,7 @@ enum EqImageFileType
 	ImageFile_Png,
 	ImageFile_AqsisBake,
 	ImageFile_AqsisZfile,
+	ImageFile_AqsisDeepShadow,
 
 	ImageFile_Unknown
 };
@@ -63,6 +64,7 @@ AQSIS_ENUM_INFO_BEGIN(EqImageFileType, ImageFile_Unknown)
 	"png",
 	"bake",
 	"aqsis_zfile",
+	"aqsis_deepshadow",
 	"unknown"
 AQSIS_ENUM_INFO_END
 
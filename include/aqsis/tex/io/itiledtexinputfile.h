@@ -48,6 +48,8 @@
 
 namespace Aqsis {
 
+class CqTextureFileStats;
+
 //------------------------------------------------------------------------------
 /** \brief Image data input interface for tiled image files.
  *
@@ -172,6 +174,21 @@ class AQSIS_TEX_SHARE IqTiledTexInputFile
 		 */
 		static boost::shared_ptr<IqTiledTexInputFile> openAny(const boostfs::path& fileName);
 
+		//--------------------------------------------------
+		/// \name Access statistics
+		//@{
+		/** \brief Get the access counters attached to the file.
+		 *
+		 * The counters are updated by the users of readTile() rather than by
+		 * readTile() itself, since only they know about tile reuse.
+		 *
+		 * \return The counters, or null if none are attached.
+		 */
+		CqTextureFileStats* stats() const;
+		/// Attach a set of access counters to the file.
+		void setStats(const boost::shared_ptr<CqTextureFileStats>& stats);
+		//@}
+
 	protected:
 		/** \brief Low-level readTile() function to be overridden by child classes
 		 *
@@ -189,6 +206,10 @@ class AQSIS_TEX_SHARE IqTiledTexInputFile
 		 */
 		virtual void readTileImpl(TqUint8* buffer, TqInt tileX, TqInt tileY,
 				TqInt subImageIdx, const SqTileInfo tileSize) const = 0;
+
+	private:
+		/// Access counters for the file.
+		boost::shared_ptr<CqTextureFileStats> m_stats;
 };
 
 
@@ -213,6 +234,17 @@ void IqTiledTexInputFile::readTile(ArrayT& buffer, TqInt tileX, TqInt tileY,
 	readTileImpl(buffer.rawData(), tileX, tileY, subImageIdx, tInfo);
 }
 
+inline CqTextureFileStats* IqTiledTexInputFile::stats() const
+{
+	return m_stats.get();
+}
+
+inline void IqTiledTexInputFile::setStats(
+		const boost::shared_ptr<CqTextureFileStats>& stats)
+{
+	m_stats = stats;
+}
+
 } // namespace Aqsis
 
 #endif // ITILEDTEXINPUTFILE_H_INCLUDED
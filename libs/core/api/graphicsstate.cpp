@@ -146,7 +146,12 @@ void CqWorldModeBlock::AddContextLightSource( const CqLightsourcePtr& pLS )
 CqAttributeModeBlock::CqAttributeModeBlock( const boost::shared_ptr<CqModeBlock>& pconParent ) : CqModeBlock( pconParent, Attribute )
 {
 	// Create new Attributes as they must be pushed/popped by the state change.
-	m_pattrCurrent.reset(new CqAttributes( *pconParent->m_pattrCurrent ));
+	// Inside an object definition they are shared until written instead, so
+	// that unchanged attributes can be recognised when instancing.
+	if ( QGetRenderContext()->pObjectPrototype() )
+		m_pattrCurrent = pconParent->m_pattrCurrent;
+	else
+		m_pattrCurrent.reset(new CqAttributes( *pconParent->m_pattrCurrent ));
 	m_ptransCurrent.reset( new CqTransform(*pconParent->m_ptransCurrent.get() ) );
 	m_poptCurrent.reset( new CqOptions(*pconParent->m_poptCurrent.get() ) );
 }
@@ -235,9 +240,13 @@ CqSolidModeBlock::~CqSolidModeBlock()
 
 CqObjectModeBlock::CqObjectModeBlock( const boost::shared_ptr<CqModeBlock>& pconParent ) : CqModeBlock( pconParent, Object )
 {
-	// Create new Attributes as they must be pushed/popped by the state change.
-	m_pattrCurrent.reset(new CqAttributes());
-	m_ptransCurrent.reset( new CqTransform(*pconParent->m_ptransCurrent.get() ) );
+	// Share the attributes of the parent until they are written, so that
+	// primitives which don't change them can take on those of each instance.
+	m_pattrCurrent = pconParent->m_pattrCurrent;
+	// Primitives are defined in the coordinate system of the object, which
+	// is placed by the transform of each instance.
+	m_ptransCurrent.reset( new CqTransform() );
+	m_ptransCurrent->ResetTransform( CqMatrix(), pconParent->m_ptransCurrent->GetHandedness( QGetRenderContext()->Time() ) );
 	m_poptCurrent.reset( new CqOptions(*pconParent->m_poptCurrent.get() ) );
 }
 
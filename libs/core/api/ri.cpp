@@ -49,11 +49,13 @@
 #include	"points.h"
 #include	"curves.h"
 #include	"procedural.h"
+#include	"instance.h"
 #include	<aqsis/core/corecontext.h>
 #include	<aqsis/riutil/ri2ricxx.h>
 #include	<aqsis/riutil/ricxxutil.h>
 #include	<aqsis/riutil/ricxx_filter.h>
 #include	<aqsis/riutil/ribparser.h>
+#include	<aqsis/riutil/ribarchivecache.h>
 #include	<aqsis/riutil/risyms.h>
 #include	<aqsis/riutil/ribwriter.h>
 #include	<aqsis/util/file.h>
@@ -61,6 +63,7 @@
 #include	<aqsis/util/logging_streambufs.h>
 #include	<aqsis/util/smartptr.h>
 #include	<aqsis/tex/maketexture.h>
+#include	<aqsis/tex/filtering/texturecachestats.h>
 #include	"stats.h"
 #include	<aqsis/math/random.h>
 #include	"../../riutil/errorhandlerimpl.h"
@@ -98,6 +101,7 @@ namespace Aqsis {
 
 static RtBoolean ProcessPrimitiveVariables(CqSurface * pSurface,
 										   const Ri::ParamList& pList);
+static bool ReleaseParsedFloats(const Ri::Param& param, std::vector<TqFloat>& dest);
 RtVoid	CreateGPrim( const boost::shared_ptr<CqSurface>& pSurface );
 
 
@@ -108,9 +112,18 @@ class RiCxxCore : public Ri::Renderer
 	public:
 		RiCxxCore(Ri::RendererServices& apiServices)
 			: m_apiServices(apiServices),
-			m_archiveCallback(0)
+			m_archiveCallback(0),
+			m_archiveCache(RibArchiveCache::create()),
+			m_objects()
 		{ }
 
+		/// Drop the retained objects of the last job.
+		void resetObjects()
+		{
+			m_archiveCallback = 0;
+			m_objects.clear();
+		}
+
         virtual RtVoid ArchiveRecord(RtConstToken type, const char* string)
 		{
 			if(m_archiveCallback)
@@ -318,6 +331,11 @@ class RiCxxCore : public Ri::Renderer
 
 		Ri::RendererServices& m_apiServices;
 		RtArchiveCallback m_archiveCallback;
+		/// Parsed archives, kept across frames for repeated ReadArchive.
+		boost::shared_ptr<RibArchiveCache> m_archiveCache;
+		/// Retained objects, by name.
+		typedef std::map<std::string, boost::shared_ptr<const CqObjectPrototype> > TqObjectMap;
+		TqObjectMap m_objects;
 };
 
 //------------------------------------------------------------------------------
@@ -582,6 +600,44 @@ RtVoid RiCxxCore::WorldBegin()
 	AQSIS_TIMER_START(Frame);
 	AQSIS_TIMER_START(Parse);
 
+	// Texture statistics cover the world block, since that's also how long
+	// textures are held in the cache.
+	QGetRenderContext()->textureCache().stats().reset();
+	// Likewise the RIB parser counters, which cover the range of the Parse
+	// timer.  Timing each request is only worth its cost at the higher
+	// statistics levels.
+	{
+		RibParserStats& parseStats = QGetRenderContext()->Stats().parseStats();
+		parseStats.reset();
+		const TqInt* poptEndofframe = QGetRenderContext()->poptCurrent()->
+			GetIntegerOption("statistics", "endofframe");
+		parseStats.timeRequests = poptEndofframe && poptEndofframe[0] >= 2;
+	}
+	// Resident textures are checked against their files now that the search
+	// path for the frame is known.
+	if(QGetRenderContext()->ResidentCaches())
+		QGetRenderContext()->textureCache().flushStale();
+	// Number of threads used to read texture tiles ahead of use.
+	TqInt textureThreads = 2;
+	if(const TqInt* threads = QGetRenderContext()->poptCurrent()->
+			GetIntegerOption("limits", "texturethreads"))
+		textureThreads = threads[0];
+	QGetRenderContext()->textureCache().setPrefetchThreads(textureThreads);
+	// Number of threads used to parse DelayedReadArchive archives ahead of
+	// their buckets.
+	TqInt archiveThreads = 2;
+	if(const TqInt* threads = QGetRenderContext()->poptCurrent()->
+			GetIntegerOption("limits", "archivethreads"))
+		archiveThreads = threads[0];
+	QGetRenderContext()->archivePrefetcher().setNumThreads(archiveThreads);
+	// Number of processes started for each RunProgram command, which are
+	// sent requests ahead of their buckets.
+	TqInt runProgramProcesses = 1;
+	if(const TqInt* processes = QGetRenderContext()->poptCurrent()->
+			GetIntegerOption("limits", "runprogramprocesses"))
+		runProgramProcesses = processes[0];
+	QGetRenderContext()->runProgramPool().setNumProcesses(runProgramProcesses);
+
 	// Now that the options have all been set, setup any undefined camera parameters.
 	const TqInt* pCameraOpts = QGetRenderContext()->poptCurrent()->GetIntegerOption("System", "CameraFlags");
 	TqInt cameraOpts = 0;
@@ -696,8 +752,15 @@ RtVoid RiCxxCore::WorldEnd()
 		fFailed = true;
 	}
 
-	// Remove all cached textures.
-	QGetRenderContext()->textureCache().flush();
+	// Remove all cached textures, unless they're kept for the next frame.
+	if(!QGetRenderContext()->ResidentCaches())
+		QGetRenderContext()->textureCache().flush();
+
+	// Drop archives parsed for procedurals which were never split, and those
+	// kept alive for the procedurals created from them.
+	QGetRenderContext()->archivePrefetcher().clear();
+	m_archiveCache->releaseReplayed();
+	QGetRenderContext()->runProgramPool().clear();
 
 	// Clear out point cloud caches, etc.
 	clearShaderSystemCaches();
@@ -964,8 +1027,17 @@ RtVoid RiCxxCore::Display(RtConstToken name, RtConstToken type, RtConstToken mod
 		index += strlen( RI_Z );
 	}
 
-	// Special case test.
-	if(strncmp(&mode[index], "depth", strlen("depth") ) == 0 )
+	// Special case tests.
+	if(eValue == 0 && strcmp(mode, "deepopacity") == 0)
+	{
+		// Deep shadow maps are built from the opacities of the individual
+		// hits at each sample rather than from filtered pixel data, so the
+		// data offset here just marks the request as valid.
+		dataSize = 3;
+		/// \todo This shouldn't be a constant.
+		dataOffset = 3;
+	}
+	else if(strncmp(&mode[index], "depth", strlen("depth") ) == 0 )
 	{
 		dataSize = 1;
 		/// \todo This shouldn't be a constant.
@@ -3129,18 +3201,52 @@ RtVoid RiCxxCore::SolidEnd()
 
 //----------------------------------------------------------------------
 // Object retention and instancing.
+//
+// Primitives between ObjectBegin and ObjectEnd are created once and retained
+// in a prototype.  Each ObjectInstance creates a lightweight primitive
+// referring to the prototype, which copies the prototype geometry only when
+// split in the bucket where it's needed.
 RtVoid RiCxxCore::ObjectBegin(RtConstToken name)
 {
-	errorHandler().error(EqE_Bug, "ObjectBegin should be handled by a filter");
+	if(!QGetRenderContext()->BeginObjectModeBlock())
+	{
+		errorHandler().error(EqE_Nesting,
+							 "Cannot begin object \"%s\" here", name);
+		return;
+	}
+	// A new definition replaces any old one with the same name; existing
+	// instances keep the old prototype alive.
+	m_objects[name] = QGetRenderContext()->pObjectPrototype();
 }
 RtVoid RiCxxCore::ObjectEnd()
 {
-	errorHandler().error(EqE_Bug, "ObjectEnd should be handled by a filter");
+	QGetRenderContext()->EndObjectModeBlock();
 }
 RtVoid RiCxxCore::ObjectInstance(RtConstToken name)
 {
-	errorHandler().error(EqE_Bug,
-						 "ObjectInstance should be handled by a filter");
+	TqObjectMap::const_iterator obj = m_objects.find(name);
+	if(obj == m_objects.end())
+	{
+		errorHandler().error(EqE_BadHandle, "Bad object name \"%s\"", name);
+		return;
+	}
+	if(obj->second == QGetRenderContext()->pObjectPrototype())
+	{
+		errorHandler().error(EqE_Nesting,
+				"Cannot instance object \"%s\" inside its own definition", name);
+		return;
+	}
+	if(obj->second->isEmpty())
+		return;
+	boost::shared_ptr<CqObjectInstance> pInstance(
+			new CqObjectInstance(obj->second));
+	TqFloat time = QGetRenderContext()->Time();
+	CqMatrix matOtoW, matNOtoW, matVOtoW;
+	QGetRenderContext()->matSpaceToSpace( "object", "world", NULL, pInstance->pTransform().get(), time, matOtoW );
+	QGetRenderContext()->matNSpaceToSpace( "object", "world", NULL, pInstance->pTransform().get(), time, matNOtoW );
+	QGetRenderContext()->matVSpaceToSpace( "object", "world", NULL, pInstance->pTransform().get(), time, matVOtoW );
+	pInstance->Transform( matOtoW, matNOtoW, matVOtoW);
+	CreateGPrim( pInstance );
 }
 
 
@@ -3323,6 +3429,7 @@ RtVoid RiCxxCore::SubdivisionMesh(RtConstToken scheme, const IntArray& nvertices
 
 			boost::shared_ptr<CqSubdivision2> pSubd2( new CqSubdivision2( pPointsClass ) );
 			pSubd2->Prepare( cVerts );
+			pSubd2->ReserveLaths( sumnVerts );
 
 			boost::shared_ptr<CqSurfaceSubdivisionMesh> pMesh( new CqSurfaceSubdivisionMesh(pSubd2, nfaces ) );
 
@@ -3424,14 +3531,27 @@ RtVoid RiCxxCore::SubdivisionMesh(RtConstToken scheme, const IntArray& nvertices
 
 RtVoid RiCxxCore::ReadArchive(RtConstToken name, RtArchiveCallback callback, const ParamList& pList)
 {
-	// Open the archive file
-	boost::filesystem::ifstream archiveFile(
-			QGetRenderContext()->poptCurrent()->findRiFile(name, "archive"),
-			std::ios::binary);
-	// Parse the archive
+	boost::filesystem::path archivePath =
+		QGetRenderContext()->poptCurrent()->findRiFile(name, "archive");
+	// Parsed archives are only cached when a memory budget (in kB) is given.
+	TqInt archiveMemory = 0;
+	if(const TqInt* memory = QGetRenderContext()->poptCurrent()->
+			GetIntegerOption("limits", "archivememory"))
+		archiveMemory = std::max(memory[0], 0);
+	m_archiveCache->setMaxBytes(size_t(archiveMemory)*1024);
+	// Parse the archive, unless it has already been parsed in the background
+	// for a procedural.
 	RtArchiveCallback savedCallback = m_archiveCallback;
 	m_archiveCallback = callback;
-	m_apiServices.parseRib(archiveFile, name);
+	std::string path = native(archivePath);
+	boost::shared_ptr<ParsedRibArchive> prefetched =
+		QGetRenderContext()->archivePrefetcher().take(path);
+	if(prefetched)
+		m_archiveCache->readArchive(path, prefetched,
+									m_apiServices.firstFilter());
+	else
+		m_archiveCache->readArchive(path, name, m_apiServices,
+									m_apiServices.firstFilter());
 	m_archiveCallback = savedCallback;
 }
 
@@ -3688,6 +3808,23 @@ static RtBoolean ProcessPrimitiveVariables(CqSurface * pSurface,
 				default:
 					break;
 			}
+			// Float values read by the RIB parser are taken over by the
+			// parameter, rather than copied.
+			std::vector<TqFloat> parsedValues;
+			if ( tok.type() == type_float && tok.Class() != class_uniform
+				&& tok.Class() != class_constant
+				&& static_cast<TqInt>( param.size() ) == cValues * tok.count()
+				&& ReleaseParsedFloats( param, parsedValues ) )
+			{
+				CqParameterTyped<TqFloat, TqFloat>* pFloatParam = static_cast<CqParameterTyped<TqFloat, TqFloat>*>( pNewParam );
+				if ( !pFloatParam->AdoptValues( parsedValues, cValues ) )
+				{
+					pNewParam->SetSize( cValues );
+					std::copy( parsedValues.begin(), parsedValues.end(), pFloatParam->pValue( 0 ) );
+				}
+				pSurface->AddPrimitiveVariable( pNewParam );
+				continue;
+			}
 			pNewParam->SetSize( cValues );
 
 			const void* value = param.data();
@@ -3830,7 +3967,7 @@ RtVoid	CreateGPrim( const boost::shared_ptr<CqSurface>& pSurface )
 		STATS_INC( GPR_created );
 
 		// Add to the raytracer database also
-		if(QGetRenderContext()->pRaytracer())
+		if(QGetRenderContext()->pRaytracer() && !QGetRenderContext()->pObjectPrototype())
 			QGetRenderContext()->pRaytracer()->AddPrimitive(pSurface);
 	}
 }
@@ -3852,7 +3989,7 @@ class CoreRendererServices : public Ri::RendererServices
 			// Add renderer utility filter.  We do this here rather than in
 			// addFilter() because this is a special filter which should only
 			// be added once.
-			Ri::Filter* utilFilter = createRenderUtilFilter(TestCondition);
+			Ri::Filter* utilFilter = createRenderUtilFilter(TestCondition, false);
 			utilFilter->setNextFilter(*m_api);
 			utilFilter->setRendererServices(*this);
 			m_filterChain.push_back(boost::shared_ptr<Ri::Renderer>(utilFilter));
@@ -3865,6 +4002,11 @@ class CoreRendererServices : public Ri::RendererServices
 			return *m_renderContext;
 		}
 
+		RiCxxCore& api()
+		{
+			return *m_api;
+		}
+
 		//--------------------------------------------------
 		// from Ri::RenderServices
 		virtual Ri::ErrorHandler& errorHandler()
@@ -3951,10 +4093,33 @@ class CoreRendererServices : public Ri::RendererServices
                               Ri::Renderer& context)
         {
             if(!m_parser)
+            {
                 m_parser.reset(RibParser::create(*this));
+                m_parser->setStats(&m_renderContext->Stats().parseStats());
+            }
             m_parser->parseStream(ribStream, name, context);
         }
 
+        virtual bool parseRibFile(const char* fileName, const char* name,
+                                  Ri::Renderer& context)
+        {
+            if(!m_parser)
+            {
+                m_parser.reset(RibParser::create(*this));
+                m_parser->setStats(&m_renderContext->Stats().parseStats());
+            }
+            return m_parser->parseFile(fileName, name, context);
+        }
+
+        /// Take over a float array of the request being parsed.
+        ///
+        /// \see RibParser::releaseFloatArray
+        bool releaseFloatArray(const RtFloat* data, size_t size,
+                               std::vector<TqFloat>& dest)
+        {
+            return m_parser && m_parser->releaseFloatArray(data, size, dest);
+        }
+
     private:
         /// Core render context
         boost::shared_ptr<CqRenderer> m_renderContext;
@@ -4026,6 +4191,25 @@ static CoreContext* g_context = 0;
 typedef std::vector<CoreContext*> ContextList;
 static ContextList g_validContexts;
 
+/// Set up the core renderer state at the start of the main block.
+static void initialiseRenderContext()
+{
+	QGetRenderContext() ->BeginMainModeBlock();
+	QGetRenderContext() ->ptransSetTime( CqMatrix() );
+	QGetRenderContext() ->SetCameraTransform( QGetRenderContext() ->ptransCurrent() );
+
+	SetDefaultRiOptions();
+
+	// Setup a default surface shader
+	boost::shared_ptr<IqShader> pDefaultSurfaceShader =
+		QGetRenderContext()->getDefaultSurfaceShader();
+	QGetRenderContext() ->pattrWriteCurrent() ->SetpshadSurface( pDefaultSurfaceShader, QGetRenderContext() ->Time() );
+
+	// Setup the initial transformation.
+	//	QGetRenderContext()->ptransWriteCurrent() ->SetHandedness( false );
+	QGetRenderContext() ->pattrWriteCurrent() ->GetIntegerAttributeWrite( "System", "Orientation" ) [ 0 ] = 0;
+}
+
 RtVoid RiBegin(RtToken name)
 {
 	// Make a context
@@ -4037,20 +4221,7 @@ RtVoid RiBegin(RtToken name)
 	if(QGetRenderContext())
 	{
 		QGetRenderContext() ->Initialise();
-		QGetRenderContext() ->BeginMainModeBlock();
-		QGetRenderContext() ->ptransSetTime( CqMatrix() );
-		QGetRenderContext() ->SetCameraTransform( QGetRenderContext() ->ptransCurrent() );
-
-		SetDefaultRiOptions();
-
-		// Setup a default surface shader
-		boost::shared_ptr<IqShader> pDefaultSurfaceShader =
-			QGetRenderContext()->getDefaultSurfaceShader();
-		QGetRenderContext() ->pattrWriteCurrent() ->SetpshadSurface( pDefaultSurfaceShader, QGetRenderContext() ->Time() );
-
-		// Setup the initial transformation.
-		//	QGetRenderContext()->ptransWriteCurrent() ->SetHandedness( false );
-		QGetRenderContext() ->pattrWriteCurrent() ->GetIntegerAttributeWrite( "System", "Orientation" ) [ 0 ] = 0;
+		initialiseRenderContext();
 	}
 }
 
@@ -4093,8 +4264,50 @@ Ri::RendererServices* cxxRenderContext()
 {
 	return g_context->apiServices.get();
 }
+
+void setResidentCaches(bool resident)
+{
+	if(QGetRenderContext())
+		QGetRenderContext()->SetResidentCaches(resident);
+}
+
+bool resetRenderContext()
+{
+	CqRenderer* renderContext = QGetRenderContext();
+	if(!renderContext)
+		return false;
+	// Only a context which is back at the top level can be reused; anything
+	// else means the last job ended inside a block.
+	boost::shared_ptr<CqModeBlock> pcon = renderContext->pconCurrent();
+	if(!pcon || pcon->Type() != BeginEnd || pcon->pconParent())
+		return false;
+	renderContext->EndMainModeBlock();
+	renderContext->Reset();
+	static_cast<CoreRendererServices*>(g_context->apiServices.get())
+		->api().resetObjects();
+	initialiseRenderContext();
+	RiLastError = RIE_NOERROR;
+	return true;
 }
 
+//----------------------------------------------------------------------
+/** Take over a float array of the request being parsed by the current
+ * context, rather than copying it.
+ *
+ * \return false if the array doesn't belong to the RIB parser, for instance
+ * because it came through the C API or a filter which made its own copy.
+ */
+static bool ReleaseParsedFloats(const Ri::Param& param, std::vector<TqFloat>& dest)
+{
+	if(!g_context || !g_context->renderContext)
+		return false;
+	CoreRendererServices* services =
+		static_cast<CoreRendererServices*>(g_context->apiServices.get());
+	return services->releaseFloatArray(param.floatData().begin(), param.size(), dest);
+}
+}
+
+
 //----------------------------------------------------------------------
 // Standard Error Handlers
 
@@ -0,0 +1,257 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Implements a pool of threads for parsing RIB archives ahead of use.
+ */
+
+#include "archiveprefetcher.h"
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <aqsis/riutil/ribarchivecache.h>
+
+#include "prefetchservices.h"
+
+namespace Aqsis {
+
+//----------------------------------------------------------------------
+/** \brief State for a submitted archive.
+ */
+class CqArchivePrefetcher::CqRequest
+{
+	public:
+		enum EqState
+		{
+			State_Queued,
+			State_Running,
+			State_Done
+		};
+
+		CqRequest( const std::string& path, const TokenDict& tokenDict )
+			: m_path( path ),
+			m_tokenDict( tokenDict ),
+			m_state( State_Queued ),
+			m_archive()
+		{}
+
+		/// Parse the archive, keeping the result only if it parsed cleanly.
+		void run()
+		{
+			try
+			{
+				CqPrefetchServices services( m_tokenDict );
+				m_archive = ParsedRibArchive::parse( m_path, m_path.c_str(),
+				                                     services,
+				                                     services.firstFilter() );
+				if( services.failed() )
+					m_archive.reset();
+			}
+			catch(...)
+			{
+				// The error will be reported when the archive is read on the
+				// render thread.
+				m_archive.reset();
+			}
+		}
+
+		std::string m_path;
+		TokenDict m_tokenDict;
+		EqState m_state;
+		boost::shared_ptr<ParsedRibArchive> m_archive;
+};
+
+
+//----------------------------------------------------------------------
+/** \brief The threads behind CqArchivePrefetcher.
+ */
+class CqArchivePrefetcher::CqThreadPool : private boost::noncopyable
+{
+	public:
+		CqThreadPool()
+			: m_threads(),
+			m_queue(),
+			m_numThreads(0),
+			m_stopping(false)
+		{}
+
+		~CqThreadPool()
+		{
+			cancelQueued();
+			setNumThreads(0);
+		}
+
+		void setNumThreads( TqInt numThreads )
+		{
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+				if(numThreads == m_numThreads)
+					return;
+				m_stopping = true;
+			}
+			// Let the current threads drain the queue and exit.
+			m_workAvailable.notify_all();
+			if(m_threads)
+				m_threads->join_all();
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_stopping = false;
+			m_numThreads = numThreads;
+			m_threads.reset(new boost::thread_group());
+			for(TqInt i = 0; i < numThreads; ++i)
+				m_threads->create_thread(boost::bind(&CqThreadPool::work, this));
+		}
+
+		bool enabled()
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			return m_numThreads > 0;
+		}
+
+		void submit( const TqRequestPtr& request )
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_queue.push_back(request);
+			m_workAvailable.notify_one();
+		}
+
+		/// Wait for a request to finish, withdrawing it if it hasn't started.
+		void wait( const TqRequestPtr& request )
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			if(request->m_state == CqRequest::State_Queued)
+				request->m_state = CqRequest::State_Done;
+			while(request->m_state != CqRequest::State_Done)
+				m_requestDone.wait(lock);
+		}
+
+		/// Withdraw all requests which haven't started.
+		void cancelQueued()
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			std::deque<TqRequestPtr>::iterator i;
+			for(i = m_queue.begin(); i != m_queue.end(); ++i)
+			{
+				if((*i)->m_state == CqRequest::State_Queued)
+					(*i)->m_state = CqRequest::State_Done;
+			}
+			m_queue.clear();
+		}
+
+	private:
+		/// Main loop for the parsing threads.
+		void work()
+		{
+			while(true)
+			{
+				TqRequestPtr request;
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+					while(m_queue.empty() && !m_stopping)
+						m_workAvailable.wait(lock);
+					if(m_queue.empty())
+						return;
+					request = m_queue.front();
+					m_queue.pop_front();
+					// Skip requests which were withdrawn.
+					if(request->m_state != CqRequest::State_Queued)
+						continue;
+					request->m_state = CqRequest::State_Running;
+				}
+				request->run();
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+					request->m_state = CqRequest::State_Done;
+				}
+				m_requestDone.notify_all();
+			}
+		}
+
+		boost::scoped_ptr<boost::thread_group> m_threads;
+		std::deque<TqRequestPtr> m_queue;
+		TqInt m_numThreads;
+		/// Set while the current threads are being asked to exit.
+		bool m_stopping;
+		/// Protects all the state above, along with request states.
+		boost::mutex m_mutex;
+		boost::condition m_workAvailable;
+		boost::condition m_requestDone;
+};
+
+
+//----------------------------------------------------------------------
+CqArchivePrefetcher::CqArchivePrefetcher()
+	: m_requests(),
+	m_pool()
+{
+	m_pool.reset( new CqThreadPool() );
+}
+
+
+CqArchivePrefetcher::~CqArchivePrefetcher()
+{}
+
+
+void CqArchivePrefetcher::setNumThreads( TqInt numThreads )
+{
+	m_pool->setNumThreads( numThreads );
+}
+
+
+bool CqArchivePrefetcher::enabled() const
+{
+	return m_pool->enabled();
+}
+
+
+void CqArchivePrefetcher::submit( const std::string& path, const TokenDict& tokenDict )
+{
+	if( !m_pool->enabled() || m_requests.find( path ) != m_requests.end() )
+		return;
+	TqRequestPtr request( new CqRequest( path, tokenDict ) );
+	m_requests.insert( std::make_pair( path, request ) );
+	m_pool->submit( request );
+}
+
+
+boost::shared_ptr<ParsedRibArchive> CqArchivePrefetcher::take( const std::string& path )
+{
+	TqRequestMap::iterator i = m_requests.find( path );
+	if( i == m_requests.end() )
+		return boost::shared_ptr<ParsedRibArchive>();
+	TqRequestPtr request = i->second;
+	m_requests.erase( i );
+	m_pool->wait( request );
+	return request->m_archive;
+}
+
+
+void CqArchivePrefetcher::clear()
+{
+	m_pool->cancelQueued();
+	m_requests.clear();
+}
+
+} // namespace Aqsis
@@ -0,0 +1,113 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Declares a pool of threads for parsing RIB archives ahead of use.
+ */
+
+#ifndef ARCHIVEPREFETCHER_H_INCLUDED
+#define ARCHIVEPREFETCHER_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Aqsis {
+
+class ParsedRibArchive;
+class TokenDict;
+
+//----------------------------------------------------------------------
+/** \brief Background parsing of the archives read by procedurals.
+ *
+ * Scenes built from DelayedReadArchive procedurals can spend much of the
+ * render parsing archives when their buckets are reached.  The prefetcher
+ * parses archives into memory on a pool of threads, so that when the
+ * procedural is split its archive only has to be replayed into the renderer.
+ *
+ * Only the parse happens in the background, with a private copy of the
+ * token dictionary; creating the geometry always happens on the render
+ * thread.  The pool starts with no threads, in which case enabled() returns
+ * false and submit() does nothing.
+ */
+class CqArchivePrefetcher : private boost::noncopyable
+{
+	public:
+		CqArchivePrefetcher();
+		~CqArchivePrefetcher();
+
+		/** \brief Set the number of parsing threads.
+		 *
+		 * Outstanding requests are completed before the old threads exit.
+		 *
+		 * \param numThreads - number of threads; zero disables prefetching.
+		 */
+		void	setNumThreads( TqInt numThreads );
+		/// Determine whether there are any threads to service requests.
+		bool	enabled() const;
+
+		/** \brief Queue an archive to be parsed in the background.
+		 *
+		 * Does nothing if the archive is already queued or prefetching is
+		 * disabled.
+		 *
+		 * \param path - resolved path to the archive file.
+		 * \param tokenDict - declarations in effect for the archive; a copy
+		 * is taken for the parsing thread.
+		 */
+		void	submit( const std::string& path, const TokenDict& tokenDict );
+		/** \brief Take the result of parsing an archive.
+		 *
+		 * If the archive is being parsed, this waits for the parse to
+		 * complete.  An archive which is still queued is withdrawn; it's
+		 * quicker for the caller to parse it directly than to wait for the
+		 * archive to be recorded and then replay it.
+		 *
+		 * \param path - resolved path to the archive file.
+		 * \return The parsed archive, or null if it wasn't submitted, hadn't
+		 * started, or couldn't be parsed cleanly.  In the last case the
+		 * caller should read the archive itself to report the errors.
+		 */
+		boost::shared_ptr<ParsedRibArchive>	take( const std::string& path );
+		/// Discard all outstanding requests.
+		void	clear();
+
+		/// Opaque state for a submitted archive.
+		class CqRequest;
+		typedef boost::shared_ptr<CqRequest> TqRequestPtr;
+		/// Pool of parsing threads.
+		class CqThreadPool;
+
+	private:
+		typedef std::map<std::string, TqRequestPtr> TqRequestMap;
+
+		/// Outstanding requests, by path.  Only touched by the render thread.
+		TqRequestMap	m_requests;
+		/// Threads servicing the requests.
+		boost::shared_ptr<CqThreadPool>	m_pool;
+};
+
+} // namespace Aqsis
+
+#endif // ARCHIVEPREFETCHER_H_INCLUDED
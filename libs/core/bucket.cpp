@@ -114,6 +114,16 @@ bool CqBucket::hasPendingSurfaces() const
 	return ! m_gPrims.empty();
 }
 
+//----------------------------------------------------------------------
+/** Start preparing the surfaces waiting in this bucket, ahead of the
+ * bucket being processed.
+ */
+void CqBucket::prefetchSurfaces() const
+{
+	for(TqSurfaceQueue::const_iterator i = m_gPrims.begin(); i != m_gPrims.end(); ++i)
+		(*i)->Prefetch();
+}
+
 
 //----------------------------------------------------------------------
 /** Add an MP to the list of deferred MPs.
@@ -118,6 +118,9 @@ class CqBucket
 			return ( m_gPrims.size() );
 		}
 		bool hasPendingSurfaces() const;
+		/** Start preparing the waiting GPrims for splitting, see CqSurface::Prefetch().
+		 */
+		void prefetchSurfaces() const;
 		/** Get the flag that indicates if the bucket has been processed yet.
 		 */
 		bool IsProcessed() const
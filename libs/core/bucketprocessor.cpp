@@ -25,6 +25,11 @@
 #include	"imagebuffer.h"
 #include	<aqsis/util/timer.h>
 
+#ifdef __SSE__
+#	include <xmmintrin.h>
+#	define AQSIS_POINTS_USE_SSE
+#endif
+
 
 namespace Aqsis {
 
@@ -46,7 +51,9 @@ CqBucketProcessor::CqBucketProcessor(CqImageBuffer& imageBuf,
 	m_SampleRegion(),
 	m_DisplayRegion(),
 	m_hasValidSamples(false),
-	m_channelBuffer()
+	m_needsVisibility(QGetRenderContext()->pDDmanager()->fDisplayNeeds("deepopacity")),
+	m_channelBuffer(),
+	m_pointHitMasks()
 {
 	setupCacheInformation();
 }
@@ -247,6 +254,10 @@ void CqBucketProcessor::postProcess()
 	// micropolygons rendered to that pixel.
 	{
 		AQSIS_TIME_SCOPE(Combine_samples);
+		// Deep displays need the individual hits, which are overwritten
+		// when combining.
+		if(m_needsVisibility)
+			BuildVisibilityFunctions();
 		CombineElements();
 	}
 
@@ -358,6 +369,27 @@ void CqBucketProcessor::postProcess()
 	m_bucket->SetProcessed();
 }
 
+//----------------------------------------------------------------------
+/** Build the deep visibility function for each pixel in the display region.
+ */
+
+void CqBucketProcessor::BuildVisibilityFunctions()
+{
+	m_channelBuffer.allocateVisibility(DisplayRegion().width(), DisplayRegion().height());
+	std::vector<SqVisibilityStep> steps;
+	CqImagePixelPtr* pie;
+	for(TqInt y = DisplayRegion().yMin(); y < DisplayRegion().yMax(); ++y)
+	{
+		for(TqInt x = DisplayRegion().xMin(); x < DisplayRegion().xMax(); ++x)
+		{
+			ImageElement(x, y, pie);
+			(*pie)->visibilitySteps(steps);
+			m_channelBuffer.visibility(x - DisplayRegion().xMin(),
+					y - DisplayRegion().yMin()).setSteps(steps);
+		}
+	}
+}
+
 //----------------------------------------------------------------------
 /** Combine the subsamples into single pixel samples and coverage information.
  */
@@ -961,55 +993,63 @@ void CqBucketProcessor::RenderSurface( boost::shared_ptr<CqSurface>& surface )
 	bool fDiceable = false;
 	{
 		AQSIS_TIME_SCOPE(Dicable_check);
-		CqMatrix diceCoords;
-		QGetRenderContext()->matSpaceToSpace("camera", "raster", NULL, NULL,
-											 QGetRenderContextI()->Time(),
-											 diceCoords);
-		const TqInt* rasterOrient = surface->pAttributes()->
-								GetIntegerAttribute("dice", "rasterorient");
-		if(rasterOrient && *rasterOrient == 0)
+		// Split products whose estimated size is still far too large skip
+		// the test and are split again.
+		if ( surface->SplitFromDiceEstimate() )
+			STATS_GPC_INC( surface->StatsClass(), GPC_split_estimated );
+		else
 		{
-			// Non raster-oriented dicing: dice the object as if all parts of
-			// the surface face the camera.  When dicing in raster space, the
-			// object dimension along the view direction is neglected from the
-			// calculation.  In contrast, here we measure the dice size in a
-			// scaled version of camera space, so the dimension along the view
-			// direction is equally important.
-			//
-			// Assuming the standard camera model (TODO: What about nonstandard
-			// projections?), xscale and yscale are the scaling factors for
-			// raster space, before projection.
-			TqFloat xscale = diceCoords[0][0];
-			TqFloat yscale = diceCoords[1][1];
-			if(m_optCache.projectionType == ProjectionPerspective)
+			CqMatrix diceCoords;
+			QGetRenderContext()->matSpaceToSpace("camera", "raster", NULL, NULL,
+												 QGetRenderContextI()->Time(),
+												 diceCoords);
+			const TqInt* rasterOrient = surface->pAttributes()->
+									GetIntegerAttribute("dice", "rasterorient");
+			if(rasterOrient && *rasterOrient == 0)
 			{
-				// For perspective projections, the amount of scaling depends
-				// on the distance of the object from the origin in camera
-				// space, just as for dicing in raster space.  To approximate
-				// extra scaling due to projection, we use the z coordinate at
-				// the centre of the object's bounding box.
+				// Non raster-oriented dicing: dice the object as if all parts of
+				// the surface face the camera.  When dicing in raster space, the
+				// object dimension along the view direction is neglected from the
+				// calculation.  In contrast, here we measure the dice size in a
+				// scaled version of camera space, so the dimension along the view
+				// direction is equally important.
 				//
-				// TODO: It's not nice recomputing the bound here.  Perhaps it
-				// would be better to cache it (along with the cached raster
-				// bound?)
-				CqBound bound;
-				surface->Bound(&bound);
-				TqFloat midz = 0.5f*(bound.vecMin().z() + bound.vecMax().z());
-				xscale /= midz;
-				yscale /= midz;
+				// Assuming the standard camera model (TODO: What about nonstandard
+				// projections?), xscale and yscale are the scaling factors for
+				// raster space, before projection.
+				TqFloat xscale = diceCoords[0][0];
+				TqFloat yscale = diceCoords[1][1];
+				if(m_optCache.projectionType == ProjectionPerspective)
+				{
+					// For perspective projections, the amount of scaling depends
+					// on the distance of the object from the origin in camera
+					// space, just as for dicing in raster space.  To approximate
+					// extra scaling due to projection, we use the z coordinate at
+					// the centre of the object's bounding box.  The cached raster
+					// bound keeps its camera space z range, which the
+					// displacement bound widens evenly, so the centre is the same.
+					CqBound bound;
+					if(surface->fCachedBound())
+						bound = surface->GetCachedRasterBound();
+					else
+						surface->Bound(&bound);
+					TqFloat midz = 0.5f*(bound.vecMin().z() + bound.vecMax().z());
+					xscale /= midz;
+					yscale /= midz;
+				}
+				TqFloat zscale = std::max(fabs(xscale), fabs(yscale));
+				diceCoords = CqMatrix(xscale, yscale, zscale);
 			}
-			TqFloat zscale = std::max(fabs(xscale), fabs(yscale));
-			diceCoords = CqMatrix(xscale, yscale, zscale);
-		}
-		else
-		{
-			// Else dice happens in raster space: Zero out z-components of
-			// the transformation, since we don't want it to effect the dice
-			// resolution.
-			diceCoords[0][2] = diceCoords[1][2] = 0;
-			diceCoords[2][2] = diceCoords[3][2] = 0;
+			else
+			{
+				// Else dice happens in raster space: Zero out z-components of
+				// the transformation, since we don't want it to effect the dice
+				// resolution.
+				diceCoords[0][2] = diceCoords[1][2] = 0;
+				diceCoords[2][2] = diceCoords[3][2] = 0;
+			}
+			fDiceable = surface->Diceable(diceCoords);
 		}
-		fDiceable = surface->Diceable(diceCoords);
 	}
 
 	// Dice & shade the surface if it's small enough...
@@ -1023,6 +1063,7 @@ void CqBucketProcessor::RenderSurface( boost::shared_ptr<CqSurface>& surface )
 
 		if ( NULL != pGrid )
 		{
+			STATS_GPC_INC( surface->StatsClass(), GPC_diced );
 			ADDREF( pGrid );
 			// Only shade in all cases since the Displacement could be called in the shadow map creation too.
 			// \note Timings for shading are broken down into component parts within this function.
@@ -1044,6 +1085,7 @@ void CqBucketProcessor::RenderSurface( boost::shared_ptr<CqSurface>& surface )
 	{
 		// Decrease the total gprim count since this gprim is replaced by other gprims
 		STATS_DEC( GPR_created_total );
+		STATS_GPC_INC( surface->StatsClass(), GPC_split );
 
 		// Split it
 		{
@@ -1080,6 +1122,13 @@ void CqBucketProcessor::RenderMicroPoly( CqMicroPolygon* pMP )
 	                     (m_optCache.depthFilter == Filter_Max ||
 	                      m_optCache.depthFilter == Filter_Average) );
 
+	// Batches of points cache their outputs point by point.
+	if(pMP->IsPointsBatch())
+	{
+		RenderMPG_Points( static_cast<CqMicroPolygonPointsBatch*>(pMP) );
+		return;
+	}
+
 	// Cache output sample info for this mpg so we don't have to keep fetching
 	// it for each sample.
 	pMP->CacheOutputInterpCoeffs(m_CurrentMpgSampleInfo);
@@ -1468,6 +1517,156 @@ void CqBucketProcessor::RenderMPG_MBOrDof( CqMicroPolygon* pMPG, bool IsMoving,
     }
 }
 
+// this function renders a batch of static points, which are neither moving nor
+// using dof.  The points are taken in groups of four: the samples under the
+// bound of a group are tested against the disks of all four points at once,
+// then the hits of each point are stored in turn, just as if the points had
+// been sampled one by one.
+void CqBucketProcessor::RenderMPG_Points( CqMicroPolygonPointsBatch* pBatch )
+{
+	const SqGridInfo& currentGridInfo = pBatch->pGrid()->GetCachedGridInfo();
+	const TqFloat* LodBounds = currentGridInfo.lodBounds;
+	bool UsingLevelOfDetail = LodBounds[ 0 ] >= 0.0f;
+	bool isCullable = m_CurrentMpgSampleInfo.isCullable;
+
+	const TqInt numSamples = m_optCache.xSamps * m_optCache.ySamps;
+	const TqInt nextx = DataRegion().width();
+
+	const TqFloat* px = pBatch->x();
+	const TqFloat* py = pBatch->y();
+	const TqFloat* pz = pBatch->z();
+	const TqFloat* pr = pBatch->radius();
+	for(TqInt first = 0, end = pBatch->cPoints(); first < end; first += 4)
+	{
+		const TqInt groupSize = min<TqInt>(end - first, 4);
+
+		// Pixels touched by the bound of each point, and by the group.  The
+		// lanes of missing points get a negative squared radius, so that
+		// they cover no samples.
+		TqInt sX[4], sY[4], eX[4], eY[4];
+		TqInt gsX = SampleRegion().xMax();
+		TqInt gsY = SampleRegion().yMax();
+		TqInt geX = SampleRegion().xMin();
+		TqInt geY = SampleRegion().yMin();
+		TqFloat laneX[4] = { 0, 0, 0, 0 };
+		TqFloat laneY[4] = { 0, 0, 0, 0 };
+		TqFloat laneR2[4] = { -1, -1, -1, -1 };
+		for(TqInt j = 0; j < groupSize; ++j)
+		{
+			const TqInt i = first + j;
+			sX[j] = max<TqInt>(lfloor( px[i] - pr[i] ), SampleRegion().xMin());
+			sY[j] = max<TqInt>(lfloor( py[i] - pr[i] ), SampleRegion().yMin());
+			eX[j] = min<TqInt>(lceil( px[i] + pr[i] ), SampleRegion().xMax());
+			eY[j] = min<TqInt>(lceil( py[i] + pr[i] ), SampleRegion().yMax());
+			if(sX[j] >= eX[j] || sY[j] >= eY[j])
+				continue;
+			gsX = min(gsX, sX[j]);
+			gsY = min(gsY, sY[j]);
+			geX = max(geX, eX[j]);
+			geY = max(geY, eY[j]);
+			laneX[j] = px[i];
+			laneY[j] = py[i];
+			laneR2[j] = pr[i]*pr[i];
+		}
+		if(gsX >= geX || gsY >= geY)
+			continue;
+
+		// Find which points of the group cover each sample, as a bit mask.
+		const TqInt groupWidth = geX - gsX;
+		m_pointHitMasks.resize(groupWidth * (geY - gsY) * numSamples);
+		TqUchar* mask = &m_pointHitMasks[0];
+#		ifdef AQSIS_POINTS_USE_SSE
+		const __m128 x4 = _mm_loadu_ps(laneX);
+		const __m128 y4 = _mm_loadu_ps(laneY);
+		const __m128 r24 = _mm_loadu_ps(laneR2);
+#		endif
+		CqImagePixelPtr* pie, *pie2;
+		ImageElement( gsX, gsY, pie );
+		for( TqInt iY = gsY; iY < geY; ++iY)
+		{
+			pie2 = pie;
+			pie += nextx;
+			for( TqInt iX = gsX; iX < geX; ++iX, ++pie2)
+			{
+				for( TqInt index = 0; index < numSamples; ++index )
+				{
+					const CqVector2D& pos = (*pie2)->SampleData( index ).position;
+#					ifdef AQSIS_POINTS_USE_SSE
+					const __m128 dx = _mm_sub_ps(_mm_set1_ps(pos.x()), x4);
+					const __m128 dy = _mm_sub_ps(_mm_set1_ps(pos.y()), y4);
+					*mask++ = _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(
+								_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), r24));
+#					else
+					TqUchar bits = 0;
+					for(TqInt j = 0; j < 4; ++j)
+					{
+						const TqFloat dx = pos.x() - laneX[j];
+						const TqFloat dy = pos.y() - laneY[j];
+						if(dx*dx + dy*dy < laneR2[j])
+							bits |= 1 << j;
+					}
+					*mask++ = bits;
+#					endif
+				}
+			}
+		}
+
+		// Store the hits of each point.
+		for(TqInt j = 0; j < groupSize; ++j)
+		{
+			if(sX[j] >= eX[j] || sY[j] >= eY[j])
+				continue;
+			const TqInt i = first + j;
+			const TqFloat D = pz[i];
+			const TqUchar bit = 1 << j;
+
+			bool outputsCached = false;
+			ImageElement( sX[j], sY[j], pie );
+			for( TqInt iY = sY[j]; iY < eY[j]; ++iY)
+			{
+				pie2 = pie;
+				pie += nextx;
+				const TqUchar* pixelMask = &m_pointHitMasks[
+					((iY - gsY) * groupWidth + sX[j] - gsX) * numSamples];
+				for( TqInt iX = sX[j]; iX < eX[j]; ++iX, ++pie2, pixelMask += numSamples)
+				{
+					for( TqInt index = 0; index < numSamples; ++index )
+					{
+						SqSampleData const& sampleData = (*pie2)->SampleData( index );
+
+						CqStats::IncI( CqStats::SPL_count );
+
+						if(!(pixelMask[index] & bit))
+							continue;
+
+						// Occlusion cull the point against the current opaque
+						// sample hit.
+						if(isCullable && D > sampleData.occlZ)
+							continue;
+
+						// Check to see if the sample is within the sample's level of detail
+						if ( UsingLevelOfDetail)
+						{
+							TqFloat LevelOfDetail = sampleData.detailLevel;
+							if ( LodBounds[ 0 ] > LevelOfDetail || LevelOfDetail >= LodBounds[ 1 ] )
+								continue;
+						}
+
+						CqStats::IncI( CqStats::SPL_bound_hits );
+
+						if(!outputsCached)
+						{
+							pBatch->CachePointOutputs( i, m_CurrentMpgSampleInfo );
+							outputsCached = true;
+						}
+						StoreSample( pBatch, pie2->get(), index, D, CqVector2D(0, 0) );
+					}
+				}
+			}
+		}
+	}
+}
+
 void CqBucketProcessor::StoreSample( CqMicroPolygon* pMPG, CqImagePixel* pie2, TqInt index, TqFloat D, const CqVector2D& uv )
 {
 	bool isCullable = m_CurrentMpgSampleInfo.isCullable;
@@ -1585,7 +1784,7 @@ void CqBucketProcessor::StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData)
 					case type_integer:
 					{
 						TqFloat f;
-						pData->GetFloat( f, pMPG->GetIndex() );
+						pData->GetFloat( f, m_CurrentMpgSampleInfo.gridIndex );
 						hitData[ entry->second.m_Offset ] = f;
 						break;
 					}
@@ -1595,7 +1794,7 @@ void CqBucketProcessor::StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData)
 					case type_hpoint:
 					{
 						CqVector3D v;
-						pData->GetPoint( v, pMPG->GetIndex() );
+						pData->GetPoint( v, m_CurrentMpgSampleInfo.gridIndex );
 						hitData[ entry->second.m_Offset ] = v.x();
 						hitData[ entry->second.m_Offset + 1 ] = v.y();
 						hitData[ entry->second.m_Offset + 2 ] = v.z();
@@ -1604,7 +1803,7 @@ void CqBucketProcessor::StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData)
 					case type_color:
 					{
 						CqColor c;
-						pData->GetColor( c, pMPG->GetIndex() );
+						pData->GetColor( c, m_CurrentMpgSampleInfo.gridIndex );
 						hitData[ entry->second.m_Offset ] = c.r();
 						hitData[ entry->second.m_Offset + 1 ] = c.g();
 						hitData[ entry->second.m_Offset + 2 ] = c.b();
@@ -1613,7 +1812,7 @@ void CqBucketProcessor::StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData)
 					case type_matrix:
 					{
 						CqMatrix m;
-						pData->GetMatrix( m, pMPG->GetIndex() );
+						pData->GetMatrix( m, m_CurrentMpgSampleInfo.gridIndex );
 						TqFloat* pElements = m.pElements();
 						hitData[ entry->second.m_Offset ] = pElements[ 0 ];
 						hitData[ entry->second.m_Offset + 1 ] = pElements[ 1 ];
@@ -104,6 +104,7 @@ class CqBucketProcessor
 
 		void	InitialiseFilterValues();
 		void	CalculateDofBounds();
+		void	BuildVisibilityFunctions();
 		void	CombineElements();
 		void	FilterBucket();
 		void	ExposeBucket();
@@ -133,6 +134,9 @@ class CqBucketProcessor
 		 * being used. It is much simpler than the general
 		 * case dealt with above. */
 		void	RenderMPG_Static( CqMicroPolygon* pMPG);
+		/** Sample each point of a batch of static points, which are
+		 * neither moving nor using dof. */
+		void	RenderMPG_Points( CqMicroPolygonPointsBatch* pBatch );
 		void	StoreSample(CqMicroPolygon* pMPG, CqImagePixel* pie2, TqInt index,
 							TqFloat D, const CqVector2D& uv);
 		void	StoreExtraData( CqMicroPolygon* pMPG, TqFloat* hitData);
@@ -175,8 +179,13 @@ class CqBucketProcessor
 		CqRegion	m_DisplayRegion;
 
 		bool	m_hasValidSamples;
+		/// True if a deep display needs per-pixel visibility functions.
+		bool	m_needsVisibility;
 
 		CqChannelBuffer	m_channelBuffer;
+		/// Scratch space for RenderMPG_Points(): which points of a group of
+		/// four cover each sample, one bit per point.
+		std::vector<TqUchar>	m_pointHitMasks;
 
 		boost::array<CqRegion, SqBucketCacheSegment::last> m_cacheRegions;
 };
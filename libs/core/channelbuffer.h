@@ -37,6 +37,8 @@
 #include <stdexcept>
 #include <iostream>
 
+#include <aqsis/tex/buffers/visibilityfunction.h>
+
 #include "iddmanager.h"
 
 namespace Aqsis {
@@ -55,14 +57,22 @@ class CqChannelBuffer : public IqChannelBuffer
 		void clearChannels();
 		TqInt addChannel(const std::string& name, TqInt size);
 		void allocate(TqInt width, TqInt height);
+		/** Allocate storage for per-pixel deep visibility functions.  This
+		 * is independent of the channel storage, and is only needed for
+		 * deep displays.  The dimensions must match those passed to
+		 * allocate().
+		 */
+		void allocateVisibility(TqInt width, TqInt height);
 
 		TqChannelPtr operator()(TqInt x, TqInt y, TqInt index);
+		CqVisibilityFunction& visibility(TqInt x, TqInt y);
 
 		// Overidden from IqChannelBuffer
 		virtual TqInt width() const;
 		virtual TqInt height() const;
 		virtual TqInt getChannelIndex(const std::string& name) const;
 		virtual TqConstChannelPtr operator()(TqInt x, TqInt y, TqInt index) const;
+		virtual const CqVisibilityFunction* visibility(TqInt x, TqInt y) const;
 	
 	private:
 		TqInt indexOffset(TqInt x, TqInt y, TqInt index) const;
@@ -72,6 +82,8 @@ class CqChannelBuffer : public IqChannelBuffer
 		TqInt m_elementSize;
 		std::map<std::string, std::pair<TqInt, TqInt> >	m_channels;
 		TqChannelValues	*m_data;
+		TqInt	m_visibilityWidth;
+		std::vector<CqVisibilityFunction> m_visibility;
 };
 
 
@@ -90,7 +102,9 @@ inline void CqChannelBuffer::clearChannels()
 
 inline CqChannelBuffer::CqChannelBuffer()
 : m_elementSize(0),
-  m_data(NULL)
+  m_data(NULL),
+  m_visibilityWidth(0),
+  m_visibility()
 {
 }
 
@@ -145,6 +159,26 @@ inline IqChannelBuffer::TqConstChannelPtr CqChannelBuffer::operator()(TqInt x, T
 	return m_data + indexOffset(x, y, index);
 }
 
+inline void CqChannelBuffer::allocateVisibility(TqInt width, TqInt height)
+{
+	m_visibilityWidth = width;
+	m_visibility.resize(width*height);
+}
+
+inline CqVisibilityFunction& CqChannelBuffer::visibility(TqInt x, TqInt y)
+{
+	assert(x >= 0 && x < m_visibilityWidth);
+	return m_visibility[y*m_visibilityWidth + x];
+}
+
+inline const CqVisibilityFunction* CqChannelBuffer::visibility(TqInt x, TqInt y) const
+{
+	if(m_visibility.empty())
+		return NULL;
+	assert(x >= 0 && x < m_visibilityWidth);
+	return &m_visibility[y*m_visibilityWidth + x];
+}
+
 inline TqInt CqChannelBuffer::width() const
 {
 	return m_width;
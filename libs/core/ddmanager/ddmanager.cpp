@@ -35,6 +35,7 @@
 #include	<boost/static_assert.hpp>
 #include	<boost/format.hpp>
 
+#include	<aqsis/util/exception.h>
 #include	<aqsis/util/sstring.h>
 #include	"ddmanager.h"
 #include	"imagebuffer.h"
@@ -68,8 +69,7 @@ TqInt CqDDManager::AddDisplay( const TqChar* name, const TqChar* type, const TqC
 	/// \todo The shared_ptr should be declared before the if-else block and initialized inside,
 	// then the last 2 lines in the if-else blocks should follow afterward. I couldn't figure out
 	// how to declare the boost pointer separately from its initialization.
-	//if (std::string(type) == "dsm")
-	if (false)  // Removed until DSM is integrated after aqsis-1.4
+	if (std::string(type) == "deepshad")
 	{
 		boost::shared_ptr<CqDisplayRequest> req(new CqDeepDisplayRequest(false, name, type, mode, CqString::hash( mode ), modeID,
 		                                        dataOffset,	dataSize, 0.0f, 255.0f, 0.0f, 0.0f, 0.0f, false, false));
@@ -1123,6 +1123,78 @@ void CqDeepDisplayRequest::FormatBucketForDisplay( const CqRegion& DRegion, cons
 
 }
 
+void CqDeepDisplayRequest::LoadDisplayLibrary( SqDDMemberData& ddMemberData, CqSimplePlugin& dspyPlugin, TqInt dspNo, TqInt width, TqInt height )
+{
+	m_width = width;
+	m_height = height;
+
+	CqMatrix matWorldToScreen;
+	QGetRenderContext() ->matSpaceToSpace( "world", "screen", NULL, NULL, QGetRenderContextI()->Time(), matWorldToScreen );
+	CqMatrix matWorldToCamera;
+	QGetRenderContext() ->matSpaceToSpace( "world", "camera", NULL, NULL, QGetRenderContextI()->Time(), matWorldToCamera );
+
+	// The error allowed when compressing visibility functions can be set with
+	// a "float tolerance" display parameter.
+	TqFloat tolerance = 0.005f;
+	for (std::vector<UserParameter>::iterator iup = m_customParams.begin(); iup != m_customParams.end(); ++iup )
+	{
+		if ( iup->vtype == 'f' && iup->vcount == 1 && std::strcmp(iup->name, "tolerance") == 0 )
+			tolerance = *reinterpret_cast<const RtFloat*>(iup->value);
+	}
+
+	m_deepFile.reset(new CqDeepShadowOutputFile(m_name, width, height,
+		matWorldToScreen, matWorldToCamera, tolerance));
+	m_valid = true;
+	m_isLoaded = true;
+}
+
+void CqDeepDisplayRequest::CloseDisplayLibrary()
+{
+	if ( !m_deepFile )
+		return;
+	try
+	{
+		m_deepFile->close();
+	}
+	catch ( XqException& e )
+	{
+		Aqsis::log() << error << e.what() << std::endl;
+	}
+	m_deepFile.reset();
+}
+
+bool CqDeepDisplayRequest::ThisDisplayNeeds( const TqUlong& htoken, const TqUlong& rgb, const TqUlong& rgba,
+        const TqUlong& Ci, const TqUlong& Oi, const TqUlong& Cs, const TqUlong& Os )
+{
+	return htoken == Oi || htoken == Os || htoken == m_modeHash;
+}
+
+void CqDeepDisplayRequest::ThisDisplayUses( TqInt& Uses )
+{
+	Uses |= 1 << EnvVars_Oi;
+}
+
+void CqDeepDisplayRequest::DisplayBucket( const CqRegion& DRegion, const IqChannelBuffer* pBuffer )
+{
+	if ( !m_deepFile )
+		return;
+	TqInt xOrigin = QGetRenderContext()->cropWindowXMin();
+	TqInt yOrigin = QGetRenderContext()->cropWindowYMin();
+	for ( TqInt y = 0, endy = pBuffer->height(); y < endy; ++y )
+	{
+		TqInt yOut = y + DRegion.yMin() - yOrigin;
+		for ( TqInt x = 0, endx = pBuffer->width(); x < endx; ++x )
+		{
+			TqInt xOut = x + DRegion.xMin() - xOrigin;
+			const CqVisibilityFunction* func = pBuffer->visibility(x, y);
+			if ( !func || xOut < 0 || xOut >= m_width || yOut < 0 || yOut >= m_height )
+				continue;
+			CqVisibilityFunction outFunc(*func);
+			m_deepFile->setPixel(xOut, yOut, outFunc);
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Return true if a scanline of buckets has been accumulated, false otherwise.
 //-----------------------------------------------------------------------------
@@ -29,9 +29,12 @@
 
 #include	<vector>
 
+#include	<boost/scoped_ptr.hpp>
+
 #include	<aqsis/aqsis.h>
 #include	<aqsis/math/matrix.h>
 #include	<aqsis/ri/ri.h>
+#include	<aqsis/tex/io/deepshadowfile.h>
 #include	"iddmanager.h"
 #include	<aqsis/util/plugins.h>
 #define		DSPY_INTERNAL
@@ -115,8 +118,8 @@ class CqDisplayRequest : public IqDisplayRequest
 		 */
 		virtual	void ThisDisplayUses( TqInt& Uses );
 
-		void LoadDisplayLibrary( SqDDMemberData& ddMemberData, CqSimplePlugin& dspyPlugin, TqInt dspNo, TqInt width, TqInt height );
-		void CloseDisplayLibrary();
+		virtual void LoadDisplayLibrary( SqDDMemberData& ddMemberData, CqSimplePlugin& dspyPlugin, TqInt dspNo, TqInt width, TqInt height );
+		virtual void CloseDisplayLibrary();
 		void ConstructStringsParameter(const char* name, const char** strings, TqInt count, UserParameter& parameter);
 		void ConstructIntsParameter(const char* name, const TqInt* ints, TqInt count, UserParameter& parameter);
 		void ConstructFloatsParameter(const char* name, const TqFloat* floats, TqInt count, UserParameter& parameter);
@@ -211,6 +214,20 @@ class CqDeepDisplayRequest : virtual public CqDisplayRequest
 				                 quantizeMinVal, quantizeMaxVal, quantizeDitherVal, quantizeSpecified, quantizeDitherSpecified)
 		{}
 
+		/* Deep shadow maps are written directly to file rather than via a
+		 * display driver, so these open and close the output file.
+		 */
+		virtual void LoadDisplayLibrary( SqDDMemberData& ddMemberData, CqSimplePlugin& dspyPlugin, TqInt dspNo, TqInt width, TqInt height );
+		virtual void CloseDisplayLibrary();
+		/* Deep displays need the opacity of all surfaces.
+		 */
+		virtual bool ThisDisplayNeeds( const TqUlong& htoken, const TqUlong& rgb, const TqUlong& rgba,
+		                               const TqUlong& Ci, const TqUlong& Oi, const TqUlong& Cs, const TqUlong& Os );
+		virtual	void ThisDisplayUses( TqInt& Uses );
+		/* Hands the visibility functions for the bucket to the output file.
+		 */
+		virtual void DisplayBucket( const CqRegion& DRegion, const IqChannelBuffer* pBuffer);
+
 		/* Does quantization, or in the case of DSM does the compression.
 		 */
 		virtual void FormatBucketForDisplay( const CqRegion& DRegion, const IqChannelBuffer* pBuffer);
@@ -226,7 +243,8 @@ class CqDeepDisplayRequest : virtual public CqDisplayRequest
 		virtual void SendToDisplay(TqInt ymin, TqInt ymaxplus1);
 
 	private:
-
+		/// Output file, open between LoadDisplayLibrary() and CloseDisplayLibrary().
+		boost::scoped_ptr<CqDeepShadowOutputFile> m_deepFile;
 };
 
 //---------------------------------------------------------------------
@@ -39,6 +39,7 @@ struct SqImageSample;
 class IqRenderer;
 class CqRegion;
 class CqParameter;
+class CqVisibilityFunction;
 
 class IqChannelBuffer
 {
@@ -54,6 +55,10 @@ class IqChannelBuffer
 		typedef TqFloat* TqConstChannelPtr;
 
 		virtual TqConstChannelPtr operator()(TqInt x, TqInt y, TqInt index) const = 0;
+		/** Get the deep visibility function for a pixel, or NULL if no deep
+		 * display needs visibility functions.
+		 */
+		virtual const CqVisibilityFunction* visibility(TqInt x, TqInt y) const = 0;
 };
 
 
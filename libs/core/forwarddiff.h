@@ -29,6 +29,13 @@
 
 #include	<aqsis/aqsis.h>
 
+#include	<vector>
+
+#ifdef __SSE__
+#	include <xmmintrin.h>
+#	define AQSIS_FORWARDDIFF_USE_SSE
+#endif
+
 namespace Aqsis {
 
 
@@ -103,6 +110,114 @@ class CqForwardDiffBezier
 };
 
 
+//-----------------------------------------------------------------------
+/** \brief Forward differencing of many cubic Bezier curves in lockstep.
+ *
+ * Each lane holds one float component of one curve, so that several
+ * variables (for instance P and its derivatives, or the columns of a patch)
+ * are stepped along together.  The lanes are stored as arrays of each
+ * forward difference term, padded to a multiple of four, so the step is a
+ * few straight vector additions.
+ */
+class CqForwardDiffBezierLanes
+{
+	public:
+		/** Create a set of lanes.
+		 * \param dt - parametric step size.
+		 * \param numLanes - number of float lanes.
+		 */
+		CqForwardDiffBezierLanes( TqFloat dt, TqInt numLanes )
+			: m_numLanes( numLanes ),
+			m_terms( 4 * paddedLanes( numLanes ), 0.0f )
+		{
+			InitPreCalcMatrix( dt );
+		}
+
+		/** Initialise the matrix taking control points to forward differences,
+		 * as for CqForwardDiffBezier.
+		 */
+		void InitPreCalcMatrix( TqFloat dt )
+		{
+			TqFloat dt2 = dt * dt, dt3 = dt2 * dt;
+			M00 = -6 * dt3;
+			M01 = 18 * dt3;
+			M02 = -18 * dt3;
+			M03 = 6 * dt3;
+			M10 = 6 * dt2 - 6 * dt3;
+			M11 = 18 * dt3 - 12 * dt2;
+			M12 = 6 * dt2 - 18 * dt3;
+			M13 = 6 * dt3;
+			M20 = 3 * dt2 - 3 * dt - dt3;
+			M21 = 3 * dt3 - 6 * dt2 + 3 * dt;
+			M22 = 3 * dt2 - 3 * dt3;
+			M23 = dt3;
+		}
+
+		/** Set the control points of one lane, starting it at the beginning
+		 * of the curve.
+		 */
+		void SetLane( TqInt lane, TqFloat A, TqFloat B, TqFloat C, TqFloat D )
+		{
+			assert( lane < m_numLanes );
+			TqInt stride = m_terms.size() / 4;
+			m_terms[ lane ] = A;
+			m_terms[ stride + lane ] = A * M20 + B * M21 + C * M22 + D * M23;
+			m_terms[ 2 * stride + lane ] = A * M10 + B * M11 + C * M12 + D * M13;
+			m_terms[ 3 * stride + lane ] = A * M00 + B * M01 + C * M02 + D * M03;
+		}
+
+		/** Get the current values of all the lanes.
+		 */
+		const TqFloat* Values() const
+		{
+			return ( &m_terms[ 0 ] );
+		}
+
+		/** Advance every lane by one step.
+		 */
+		void Step()
+		{
+			TqInt stride = m_terms.size() / 4;
+			TqFloat* f = &m_terms[ 0 ];
+			TqFloat* df = f + stride;
+			TqFloat* ddf = df + stride;
+			const TqFloat* dddf = ddf + stride;
+			TqInt i = 0;
+#			ifdef AQSIS_FORWARDDIFF_USE_SSE
+			for ( ; i < stride; i += 4 )
+			{
+				__m128 df4 = _mm_loadu_ps( df + i );
+				__m128 ddf4 = _mm_loadu_ps( ddf + i );
+				_mm_storeu_ps( f + i, _mm_add_ps( _mm_loadu_ps( f + i ), df4 ) );
+				_mm_storeu_ps( df + i, _mm_add_ps( df4, ddf4 ) );
+				_mm_storeu_ps( ddf + i, _mm_add_ps( ddf4, _mm_loadu_ps( dddf + i ) ) );
+			}
+#			endif
+			for ( ; i < stride; ++i )
+			{
+				f[ i ] += df[ i ];
+				df[ i ] += ddf[ i ];
+				ddf[ i ] += dddf[ i ];
+			}
+		}
+
+	private:
+		/// Round a number of lanes up to a whole number of vectors.
+		static TqInt paddedLanes( TqInt numLanes )
+		{
+			return ( ( numLanes + 3 ) & ~3 );
+		}
+
+		TqFloat M00, M01, M02, M03,
+		M10, M11, M12, M13,
+		M20, M21, M22, M23;
+
+		TqInt	m_numLanes;		///< Number of lanes in use.
+		/// Value and forward differences of each lane, one term after another.
+		std::vector<TqFloat>	m_terms;
+};
+
+
 //-----------------------------------------------------------------------
 
 } // namespace Aqsis
@@ -0,0 +1,89 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file Unit tests for Bezier forward differencing.
+ */
+
+#include "forwarddiff.h"
+
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(forwarddiff_tests)
+
+using namespace Aqsis;
+
+namespace {
+
+// Evaluate a cubic Bezier curve directly from the Bernstein polynomials.
+TqFloat bezier(TqFloat A, TqFloat B, TqFloat C, TqFloat D, TqFloat t)
+{
+	TqFloat s = 1 - t;
+	return s*s*s*A + 3*s*s*t*B + 3*s*t*t*C + t*t*t*D;
+}
+
+// Control point j of lane i of the test curves.
+TqFloat controlPoint(TqInt i, TqInt j)
+{
+	return ((7*i + 3*j*j + 5) % 11) - 4.5f;
+}
+
+// Step numLanes lanes along their curves, checking each step against
+// CqForwardDiffBezier and against direct evaluation.
+void checkLanes(TqInt numLanes)
+{
+	const TqInt numSteps = 16;
+	const TqFloat dt = 1.0f/numSteps;
+	CqForwardDiffBezierLanes lanes(dt, numLanes);
+	std::vector<CqForwardDiffBezier<TqFloat> > scalars(numLanes,
+			CqForwardDiffBezier<TqFloat>(dt));
+	for(TqInt i = 0; i < numLanes; ++i)
+	{
+		TqFloat A = controlPoint(i,0), B = controlPoint(i,1),
+				C = controlPoint(i,2), D = controlPoint(i,3);
+		lanes.SetLane(i, A, B, C, D);
+		scalars[i].CalcForwardDiff(A, B, C, D);
+	}
+	for(TqInt step = 0; step <= numSteps; ++step)
+	{
+		const TqFloat* values = lanes.Values();
+		for(TqInt i = 0; i < numLanes; ++i)
+		{
+			TqFloat expected = bezier(controlPoint(i,0), controlPoint(i,1),
+					controlPoint(i,2), controlPoint(i,3), step*dt);
+			BOOST_CHECK_SMALL(values[i] - scalars[i].GetValue(), 1e-5f);
+			BOOST_CHECK_SMALL(values[i] - expected, 1e-4f);
+		}
+		lanes.Step();
+	}
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_CASE(CqForwardDiffBezierLanes_test)
+{
+	// Lane counts which do and don't fill a whole number of vectors.
+	checkLanes(1);
+	checkLanes(7);
+	checkLanes(8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
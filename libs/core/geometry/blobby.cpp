@@ -30,12 +30,16 @@
 
 #include "blobby.h"
 
+#include <algorithm>
 #include <cstring>
 #include <math.h>
 #include <vector>
 #include <list>
 #include <limits>
 
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
 #include <aqsis/util/file.h>
 #include "itexturemap_old.h"
 #include "marchingcubes.h"
@@ -554,6 +558,7 @@ class blobby_vm_assembler
 CqBlobby::CqBlobby(TqInt nleaf, TqInt ncode, TqInt* code, TqInt nfloats, TqFloat* floats, TqInt nstrings, char** strings) : m_nleaf(nleaf), m_ncode(ncode), m_code(code), m_nfloats(nfloats), m_floats(floats), m_nstrings(nstrings), m_strings(strings)
 {
 	blobby_vm_assembler(nleaf, ncode, code, nfloats, floats, nstrings, strings, m_instructions, m_bbox);
+	compile();
 }
 
 //---------------------------------------------------------------------
@@ -579,445 +584,652 @@ TqInt CqBlobby::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
 }
 
 //---------------------------------------------------------------------
-/** Return the float value based on each operands. In particular Add will
- *  accumulate the result of each opcode together. Now this function is
- *  particulary important since it is used to weight each operand and deduce
- *  how well will be split the parent blobby' parameters (via ri.cpp).
- *  Not particular intelligent since it is redoing what the next method is
- *  computing however more keen eyes could combine both methods together to
- *  raise the performance significantly.
+/** Compile the instruction stream into a flat postfix program over an
+ *  array of leaf primitives, and index the leaves with finite support in a
+ *  bounding volume hierarchy.
+ *
+ *  Every leaf joined to the root through ADD operators alone (the usual
+ *  case for particle and fluid data) is summed straight from the hierarchy,
+ *  so evaluating the field only visits the leaves near the point.  The rest
+ *  of the program is kept as terms evaluated with a small stack.
  */
-/** Blobby virtual machine program execution - calculates the value of an implicit surface at a given 3D point */
-TqFloat CqBlobby::implicit_value( const CqVector3D& Point, TqInt n, std::vector <TqFloat> &splits )
+void CqBlobby::compile()
 {
-	register TqFloat sum = 0.0f;
-	register TqFloat result;
-	std::stack<TqFloat> stack;
-	TqInt int_index = 0;
-	stack.push(0);
-
-	register unsigned long pc;
-
-	for(pc = 0; pc < m_instructions.size(); )
+	m_leaves.clear();
+	m_program.clear();
+	m_terms.clear();
+	m_bvh.clear();
+	m_bvhLeaves.clear();
+	m_maxStack = 1;
+	m_bounded = true;
+	m_threadSafe = true;
+
+	// starts[i] is the first operation of the subtree ending at i.
+	std::vector<TqInt> starts;
+	std::vector<TqInt> operands;
+
+	for(unsigned long pc = 0; pc < m_instructions.size(); )
 	{
-		switch(m_instructions[pc++].opcode)
+		SqOp op;
+		op.opcode = m_instructions[pc++].opcode;
+		op.arg = 0;
+		TqInt nOperands = 0;
+
+		switch(op.opcode)
 		{
 				case NEGATE:
 				case IDEMPOTENTATE:
-					break;
-				case CONSTANT:
-				{
-					result = m_instructions[pc++].value;
-					sum += result;
-					splits[int_index++] = result;
-				}
+				continue;
+
+				case ADD:
+				case MULTIPLY:
+				case MIN:
+				case MAX:
+				op.arg = nOperands = m_instructions[pc++].count;
 				break;
 
-				case ELLIPSOID:
-				{
-					const TqFloat r2 = (m_instructions[pc++].get_matrix() * Point).Magnitude2();
-					result = r2 <= 1 ? 1 - 3*r2 + 3*r2*r2 - r2*r2*r2 : 0;
-					sum += result;
-					splits[int_index++] = result;
-				}
+				case SUBTRACT:
+				case DIVIDE:
+				nOperands = 2;
 				break;
 
-				case PLANE:
+				default:
 				{
-					TqInt which = (TqInt) m_instructions[pc++].value;
-					TqInt n = (TqInt) m_instructions[pc++].value;
-
-					CqString depthname = m_strings[which];
-					/** \todo Fix to use the new-style texture maps.  Using
-					 * GetOcclusionMap happens to access the old texture
-					 * sampling machinary through GetShadowMap()
-					 */
-					IqTextureMapOld* pMap = QGetRenderContextI() ->GetOcclusionMap( depthname );
-
-					TqFloat A, B, C, D;
-					std::valarray<TqFloat> fv;
-					TqFloat avg, depth;
+					SqLeaf leaf;
+					leaf.type = op.opcode;
+					leaf.value = 0.0f;
+					leaf.index = leaf.floatIndex = 0;
+					leaf.bounded = false;
+					leaf.additive = false;
+					switch(op.opcode)
+					{
+							case CONSTANT:
+							leaf.value = m_instructions[pc++].value;
+							break;
 
-					depth = -Point.z();
+							case ELLIPSOID:
+							{
+								// The field is zero outside the unit sphere in blob space.
+								leaf.transform = m_instructions[pc++].get_matrix();
+								leaf.bound = CqBound(-1, -1, -1, 1, 1, 1);
+								leaf.bound.Transform(leaf.transform.Inverse());
+								leaf.bounded = true;
+							}
+							break;
 
-					fv.resize(1);
-					fv[0]= 0.0f;
+							case SEGMENT:
+							{
+								const CqMatrix m = m_instructions[pc++].get_matrix();
+								leaf.start = m_instructions[pc++].get_vector();
+								leaf.end = m_instructions[pc++].get_vector();
+								leaf.value = m_instructions[pc++].value;
+								leaf.transform = m.Inverse();
+
+								// The field is zero outside the segment swept by
+								// the radius-scaled unit sphere in blob space.
+								CqBound sphere;
+								for(TqInt c = 0; c < 8; ++c)
+								{
+									const CqVector3D corner((c & 1) ? 1 : -1, (c & 2) ? 1 : -1, (c & 4) ? 1 : -1);
+									sphere.Encapsulate(leaf.value * (m * corner));
+								}
+								CqBound segment(leaf.start, leaf.start);
+								segment.Encapsulate(leaf.end);
+								leaf.bound = CqBound(segment.vecMin() + sphere.vecMin(), segment.vecMax() + sphere.vecMax());
+								leaf.bounded = true;
+							}
+							break;
 
+							case PLANE:
+							{
+								leaf.index = static_cast<TqInt>(m_instructions[pc++].value);
+								leaf.floatIndex = static_cast<TqInt>(m_instructions[pc++].value);
+								// Depth map lookups go through the shared texture cache.
+								m_threadSafe = false;
+							}
+							break;
 
-					A = m_floats[n];
-					B = m_floats[n+1];
-					C = m_floats[n+2];
-					D = m_floats[n+3];
+							case AIR:
+							{
+								leaf.index = m_instructions[pc++].count;
+								leaf.transform = m_instructions[pc++].get_matrix();
+								pc++; // Centre of the DBO bound
+								leaf.end = m_instructions[pc++].get_vector();
+								leaf.start = m_instructions[pc++].get_vector();
+								// DBO plugins keep their own state.
+								m_threadSafe = false;
+							}
+							break;
 
-					if ( pMap != 0 && pMap->IsValid() )
-					{
-						CqVector3D swidth(0.0f);
-						CqVector3D twidth(0.0f);
-						CqVector3D aq_P = Point;
-						pMap->SampleMap( aq_P, swidth, twidth, fv, 0, &avg, &depth );
+							default:
+							break;
 					}
-
-
-					result = repulsion(depth, A, B, C, D);
-					sum += result;
-					splits[int_index++] = result;
+					m_bounded &= leaf.bounded;
+					op.arg = m_leaves.size();
+					m_leaves.push_back(leaf);
 				}
 				break;
+		}
 
-				case AIR:
-				{
-					/*
-					A dynamic blob op can be used like any other primitive blob in a Blobby object.  DBOs have two required parameters and can have an arbitrary number of float, string, or integer parameters that arepassed to the DBO functions.
-
-					9000 2 nameix transformix
-					9000 4 nameix transformix nfloat floatix
-					9000 6 nameix transformix nfloat floatix nstring stringix 
-					9000 (7+nint) nameix transformix nfloat floatix nstring stringix nintint_1...int_nint 
-
-					nameix is an index into the string array for the name of the DBO.  
-					AIR will search the proceduresearch path for a DLL or shared object with the corresponding name. 
-					transformix is an index into the float array for a matrix giving the blob-to-object space transformation.
-					floatix (if present) is the index in the float array of the first of the nfloat float parameters. 
-					stringix (if present) is the index in the string array of the first of the nstring string parameters.
-
-					 on the stack you will find
-
-					m_instructions.push_back(CqBlobby::instruction(CqBlobby::AIR));
-					m_instructions.push_back(CqBlobby::instruction(op.index)); // idx to Count
-					m_instructions.push_back(transformation.Inverse()); // Push the inverse matrix
-					m_instructions.push_back(mid); // Push the center  of this blobby according to its bbox
-					m_instructions.push_back(mx); // Push the max  of this blobby according to its bbox
-					m_instructions.push_back(mn); // Push the min  of this blobby according to its bbox
+		if(nOperands > static_cast<TqInt>(operands.size()))
+		{
+			Aqsis::log() << error << "Malformed Blobby program, missing operands." << std::endl;
+			break;
+		}
+		const TqInt start = nOperands > 0 ? operands[operands.size() - nOperands] : m_program.size();
+		operands.resize(operands.size() - nOperands);
+		operands.push_back(start);
+		m_maxStack = max<TqInt>(m_maxStack, operands.size());
+		starts.push_back(start);
+		m_program.push_back(op);
+	}
 
-					*/
+	if(!m_program.empty())
+		collectTerms(m_program.size() - 1, starts);
 
-					TqInt count, e, f, g, h, i, j;
+	std::vector<CqVector3D> centres(m_leaves.size());
+	for(TqInt i = 0, n = m_leaves.size(); i < n; ++i)
+	{
+		if(!m_leaves[i].bounded)
+			continue;
+		m_bvhLeaves.push_back(i);
+		centres[i] = ( m_leaves[i].bound.vecMin() + m_leaves[i].bound.vecMax() ) / 2.0;
+	}
+	if(!m_bvhLeaves.empty())
+		buildBvh(0, m_bvhLeaves.size(), centres);
+}
 
-					e = f = g = h = i = j = 0;
-					count = m_instructions[pc++].count;
+//---------------------------------------------------------------------
+/** Split the subtree ending at root into the bounded leaves summed by ADD
+ *  operators and the remaining terms of that sum.
+ */
+void CqBlobby::collectTerms(TqInt root, const std::vector<TqInt>& starts)
+{
+	const SqOp& op = m_program[root];
+	if(op.opcode == ADD)
+	{
+		// The operands are the consecutive subtrees just before the operator.
+		TqInt end = root;
+		for(TqInt i = 0; i < op.arg; ++i)
+		{
+			collectTerms(end - 1, starts);
+			end = starts[end - 1];
+		}
+	}
+	else if(starts[root] == root && m_leaves[op.arg].bounded)
+		m_leaves[op.arg].additive = true;
+	else
+		m_terms.push_back(std::make_pair(starts[root], root + 1));
+}
 
-					if (m_code[count] >= 7)
-					{
-						e = 7 - m_code[count]; // How many strings
-						f = count + 7;
-					}
-					if (m_code[count] >= 4)
-					{
-						g = m_code[count + 3]; // How many floats
-						h = m_code[count + 4]; // Idx to the floats
-					}
-					if (m_code[count] >= 6)
-					{
-						i = m_code[count + 5]; // How many strings
-						j = m_code[count + 6]; // Idx to the strings
-					}
+namespace {
 
+/// Order leaves by the centre of their bound along one axis.
+class CqLeafCentreLess
+{
+	public:
+		CqLeafCentreLess(const std::vector<CqVector3D>& centres, TqInt axis)
+			: m_centres(centres), m_axis(axis)
+		{}
+		bool operator()(TqInt a, TqInt b) const
+		{
+			return m_centres[a][m_axis] < m_centres[b][m_axis];
+		}
+	private:
+		const std::vector<CqVector3D>& m_centres;
+		TqInt m_axis;
+};
 
+/// Test whether two bounds overlap.
+inline bool boundsOverlap(const CqBound& a, const CqBound& b)
+{
+	return a.vecMin().x() <= b.vecMax().x() && a.vecMax().x() >= b.vecMin().x()
+		&& a.vecMin().y() <= b.vecMax().y() && a.vecMax().y() >= b.vecMin().y()
+		&& a.vecMin().z() <= b.vecMax().z() && a.vecMax().z() >= b.vecMin().z();
+}
 
-					TqFloat point[3];
-					const CqMatrix transformation = m_instructions[pc++].get_matrix();
-					const CqVector3D mid = m_instructions[pc++].get_vector();
-					const CqVector3D mx = m_instructions[pc++].get_vector();
-					const CqVector3D mn = m_instructions[pc++].get_vector();
-					const CqBound bound(mn, mx);
+/// Most leaves held by a single node of the blobby hierarchy.
+const TqInt bvhNodeLeaves = 4;
+/// Deepest blobby hierarchy traversal; median splits keep well within this.
+const TqInt bvhMaxDepth = 64;
 
-					TqState s;
-					CqVector3D tmp = transformation * Point;
-					point[0] = tmp.x();
-					point[1] = tmp.y();
-					point[2] = tmp.z();
+} // unnamed namespace
 
-					if ((point[2]>= 0.0) && bound.Contains3D(tmp) && pImplicitValue )
-					{
-						(*pImplicitValue)(&s, &result, point,
-							             e, &m_code[f],
-							             g, &m_floats[h],
-							             i, &m_strings[j]);
-						result = 1.0 - result;
-					}
+//---------------------------------------------------------------------
+/** Build the hierarchy over m_bvhLeaves[begin, end), splitting at the
+ *  median leaf centre along the longest axis.
+ *  \return The index of the new node.
+ */
+TqInt CqBlobby::buildBvh(TqInt begin, TqInt end, const std::vector<CqVector3D>& centres)
+{
+	const TqInt node = m_bvh.size();
+	m_bvh.push_back(SqBvhNode());
 
-					sum += result;
-					splits[int_index++] = result;
-				}
-				break;
+	CqBound bound;
+	CqBound centreBound;
+	for(TqInt i = begin; i < end; ++i)
+	{
+		bound.Encapsulate(&m_leaves[m_bvhLeaves[i]].bound);
+		centreBound.Encapsulate(centres[m_bvhLeaves[i]]);
+	}
+	m_bvh[node].bound = bound;
 
-				case SEGMENT:
-				{
-					const CqMatrix m = m_instructions[pc++].get_matrix();
-					const CqVector3D start = m_instructions[pc++].get_vector();
-					const CqVector3D end = m_instructions[pc++].get_vector();
-					const TqFloat radius = m_instructions[pc++].value;
-
-					// Nearest segment point
-					const CqVector3D segment_point = nearest_segment_point(Point, start, end);
-					// Translation( segment_point ) * Scaling ( radius ) * m
-					const CqMatrix transformation = CqMatrix( segment_point ) * CqMatrix( radius, radius, radius ) * m;
-					// Distance
-					const TqFloat r2 = (transformation.Inverse() * Point).Magnitude2();
-					// Value
-					const TqFloat result = (r2 <= 1) ? (1 - 3*r2 + 3*r2*r2 - r2*r2*r2) : 0;
-
-					sum += result;
-					splits[int_index++] = result;
-				}
-				break;
+	if(end - begin <= bvhNodeLeaves)
+	{
+		m_bvh[node].first = begin;
+		m_bvh[node].count = end - begin;
+		return node;
+	}
 
-				case CqBlobby::SUBTRACT:
-				case CqBlobby::DIVIDE:
-				case CqBlobby::ADD:
-				case CqBlobby::MULTIPLY:
-				case CqBlobby::MIN:
-				case CqBlobby::MAX:
-				break;
+	const CqVector3D extent = centreBound.vecMax() - centreBound.vecMin();
+	TqInt axis = 0;
+	if(extent.y() > extent[axis])
+		axis = 1;
+	if(extent.z() > extent[axis])
+		axis = 2;
+
+	const TqInt mid = (begin + end) / 2;
+	std::nth_element(m_bvhLeaves.begin() + begin, m_bvhLeaves.begin() + mid,
+	                 m_bvhLeaves.begin() + end, CqLeafCentreLess(centres, axis));
+	buildBvh(begin, mid, centres);
+	const TqInt right = buildBvh(mid, end, centres);
+	m_bvh[node].first = right;
+	m_bvh[node].count = 0;
+	return node;
+}
 
+//---------------------------------------------------------------------
+/** Sum the bounded leaves whose support contains a point.
+ *  \param additiveOnly Only sum the leaves joined to the root by ADD operators.
+ *  \param n Ignore leaves from this index on.
+ *  \param splits If not null, receives the value of each leaf summed.
+ */
+TqFloat CqBlobby::sumLeaves(const CqVector3D& Point, bool additiveOnly, TqInt n, std::vector<TqFloat>* splits) const
+{
+	TqFloat sum = 0.0f;
+	if(m_bvh.empty())
+		return sum;
+
+	TqInt stack[bvhMaxDepth];
+	TqInt top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		const SqBvhNode& node = m_bvh[stack[--top]];
+		if(!node.bound.Contains3D(Point))
+			continue;
+		if(node.count == 0)
+		{
+			stack[top++] = node.first;
+			stack[top++] = &node - &m_bvh[0] + 1;
+			continue;
+		}
+		for(TqInt i = node.first; i < node.first + node.count; ++i)
+		{
+			const TqInt l = m_bvhLeaves[i];
+			const SqLeaf& leaf = m_leaves[l];
+			if(l >= n || (additiveOnly && !leaf.additive) || !leaf.bound.Contains3D(Point))
+				continue;
+			const TqFloat result = leafValue(leaf, Point);
+			sum += result;
+			if(splits)
+				(*splits)[l] = result;
 		}
-		if (int_index >= n)
-			break;
 	}
-
 	return sum;
 }
 
 //---------------------------------------------------------------------
-/** Return the float value based on each opcodes.
- *  This is the most important method it is used by MarchingCubes.cpp to
- *  polygonize the primitives
+/** Determine whether the implicit value may be non-zero inside a region.
+ *  A field built only from leaves with finite support is zero away from
+ *  them, whatever the operators joining them.
  */
-TqFloat CqBlobby::implicit_value( const CqVector3D& Point )
+bool CqBlobby::mayContainField(const CqBound& bound) const
 {
-	std::stack<TqFloat> stack;
-	stack.push(0);
-	register TqFloat result;
-	register unsigned long pc;
-
-	for(pc = 0; pc < m_instructions.size(); )
+	if(!m_bounded)
+		return true;
+	if(m_bvh.empty())
+		return false;
+
+	TqInt stack[bvhMaxDepth];
+	TqInt top = 0;
+	stack[top++] = 0;
+	while(top > 0)
 	{
-		switch(m_instructions[pc++].opcode)
+		const SqBvhNode& node = m_bvh[stack[--top]];
+		if(!boundsOverlap(node.bound, bound))
+			continue;
+		if(node.count == 0)
 		{
-				case NEGATE:
-				case IDEMPOTENTATE:
-					break;
-				case CONSTANT:
-				{
-					stack.push(m_instructions[pc++].value);
-				}
-				break;
-
-				case ELLIPSOID:
-				{
-					const TqFloat r2 = (m_instructions[pc++].get_matrix() * Point).Magnitude2();
-					result = r2 <= 1 ? 1 - 3*r2 + 3*r2*r2 - r2*r2*r2 : 0;
-
-					//Aqsis::log() << info << "Ellipsoid: result " << result << std::endl;
-					stack.push(result);
-				}
-				break;
-
-				case PLANE:
-				{
-					TqInt which = (TqInt) m_instructions[pc++].value;
-					TqInt n = (TqInt) m_instructions[pc++].value;
+			stack[top++] = node.first;
+			stack[top++] = &node - &m_bvh[0] + 1;
+			continue;
+		}
+		for(TqInt i = node.first; i < node.first + node.count; ++i)
+		{
+			if(boundsOverlap(m_leaves[m_bvhLeaves[i]].bound, bound))
+				return true;
+		}
+	}
+	return false;
+}
 
-					CqString depthname = m_strings[which];
-					/** \todo Fix to use the new-style texture maps.  Using
-					 * GetOcclusionMap happens to access the old texture
-					 * sampling machinary through GetShadowMap()
-					 */
-					IqTextureMapOld* pMap = QGetRenderContextI() ->GetOcclusionMap( depthname );
+//---------------------------------------------------------------------
+/** Calculate the value of a single leaf primitive at a point.
+ */
+TqFloat CqBlobby::leafValue(const SqLeaf& leaf, const CqVector3D& Point) const
+{
+	switch(leaf.type)
+	{
+			case CONSTANT:
+			return leaf.value;
 
-					TqFloat A, B, C, D;
-					std::valarray<TqFloat> fv;
-					TqFloat avg, depth;
-					depth = -Point.z();
+			case ELLIPSOID:
+			{
+				const TqFloat r2 = (leaf.transform * Point).Magnitude2();
+				return r2 <= 1 ? 1 - 3*r2 + 3*r2*r2 - r2*r2*r2 : 0;
+			}
 
-					fv.resize(1);
-					fv[0]= 0.0f;
+			case SEGMENT:
+			{
+				// Nearest segment point
+				const CqVector3D segment_point = nearest_segment_point(Point, leaf.start, leaf.end);
+				// Inverse of Translation( segment_point ) * Scaling ( radius ) * m
+				const TqFloat r2 = (leaf.transform * ((Point - segment_point) / leaf.value)).Magnitude2();
+				return r2 <= 1 ? 1 - 3*r2 + 3*r2*r2 - r2*r2*r2 : 0;
+			}
 
+			case PLANE:
+			{
+				CqString depthname = m_strings[leaf.index];
+				/** \todo Fix to use the new-style texture maps.  Using
+				 * GetOcclusionMap happens to access the old texture
+				 * sampling machinary through GetShadowMap()
+				 */
+				IqTextureMapOld* pMap = QGetRenderContextI() ->GetOcclusionMap( depthname );
+
+				const TqInt n = leaf.floatIndex;
+				std::valarray<TqFloat> fv;
+				TqFloat avg;
+				TqFloat depth = -Point.z();
+
+				fv.resize(1);
+				fv[0]= 0.0f;
+
+				if ( pMap != 0 && pMap->IsValid() )
+				{
+					CqVector3D swidth(0.0f);
+					CqVector3D twidth(0.0f);
+					CqVector3D aq_P = Point;
+					pMap->SampleMap( aq_P, swidth, twidth, fv, 0, &avg, &depth );
+				}
 
-					A = m_floats[n];
-					B = m_floats[n+1];
-					C = m_floats[n+2];
-					D = m_floats[n+3];
+				return repulsion(depth, m_floats[n], m_floats[n+1], m_floats[n+2], m_floats[n+3]);
+			}
 
-					if ( pMap != 0 && pMap->IsValid() )
-					{
-						CqVector3D swidth(0.0f);
-						CqVector3D twidth(0.0f);
-						CqVector3D aq_P = Point;
-						pMap->SampleMap( aq_P, swidth, twidth, fv, 0, &avg, &depth);
-					}
+			case AIR:
+			{
+				TqInt count, e, f, g, h, i, j;
 
-					//Aqsis::log() << info << "A " << A << " B " << B << " C " << C << " D " << D << std::endl;
-					result = repulsion(depth, A, B, C, D);
+				e = f = g = h = i = j = 0;
+				count = leaf.index;
 
-					//Aqsis::log() << info << "Plane: result " << result << std::endl;
-					stack.push(result);
+				if (m_code[count] >= 7)
+				{
+					e = 7 - m_code[count]; // How many strings
+					f = count + 7;
 				}
-				break;
-
-				case AIR:
+				if (m_code[count] >= 4)
 				{
-					TqInt count, e, f, g, h, i, j;
-
-					e = f = g = h = i = j = 0;
-					count = m_instructions[pc++].count;
-
-					if (m_code[count] >= 7)
-					{
-						e = 7 - m_code[count]; // How many strings
-						f = count + 7;
-					}
-					if (m_code[count] >= 4)
-					{
-						g = m_code[count + 3]; // How many floats
-						h = m_code[count + 4]; // Idx to the floats
-					}
-					if (m_code[count] >= 6)
-					{
-						i = m_code[count + 5]; // How many strings
-						j = m_code[count + 6]; // Idx to the strings
-					}
+					g = m_code[count + 3]; // How many floats
+					h = m_code[count + 4]; // Idx to the floats
+				}
+				if (m_code[count] >= 6)
+				{
+					i = m_code[count + 5]; // How many strings
+					j = m_code[count + 6]; // Idx to the strings
+				}
 
+				TqFloat result = 0.0f;
+				TqFloat point[3];
+				const CqBound bound(leaf.start, leaf.end);
 
-					TqFloat point[3];
-					const CqMatrix transformation = m_instructions[pc++].get_matrix();
-					const CqVector3D mid = m_instructions[pc++].get_vector();
-					const CqVector3D mx = m_instructions[pc++].get_vector();
-					const CqVector3D mn = m_instructions[pc++].get_vector();
-					const CqBound bound(mn, mx);
+				TqState s;
+				CqVector3D tmp = leaf.transform * Point;
+				point[0] = tmp.x();
+				point[1] = tmp.y();
+				point[2] = tmp.z();
 
-					TqState s;
-					CqVector3D tmp = transformation * Point;
-					point[0] = tmp.x();
-					point[1] = tmp.y();
-					point[2] = tmp.z();
+				if ((point[2]>= 0.0) && bound.Contains3D(tmp) && pImplicitValue )
+				{
+					(*pImplicitValue)(&s, &result, point,
+					                  e, &m_code[f],
+					                  g, &m_floats[h],
+					                  i, &m_strings[j]);
+					result = 1.0 - result;
+				}
+				return result;
+			}
 
-					if ((point[2]>= 0.0) && bound.Contains3D(tmp) && pImplicitValue )
-					{
-						(*pImplicitValue)(&s, &result, point,
-							          e, &m_code[f],
-							          g, &m_floats[h],
-							         i, &m_strings[j]);
-						result = 1.0 - result;
-					}
+			default:
+			return 0.0f;
+	}
+}
 
-					//Aqsis::log() << info << " Result " << result << std::endl;
+//---------------------------------------------------------------------
+/** Run the postfix program m_program[begin, end) at a point.
+ */
+TqFloat CqBlobby::evaluate(TqInt begin, TqInt end, const CqVector3D& Point) const
+{
+	TqFloat buffer[32];
+	std::vector<TqFloat> heap;
+	TqFloat* stack = buffer;
+	if(m_maxStack > 32)
+	{
+		heap.resize(m_maxStack);
+		stack = &heap[0];
+	}
+	TqInt top = 0;
 
-					stack.push(result);
+	for(TqInt pc = begin; pc < end; ++pc)
+	{
+		const SqOp& op = m_program[pc];
+		switch(op.opcode)
+		{
+				case ADD:
+				{
+					TqFloat result = 0.0f;
+					for(TqInt i = 0; i < op.arg; ++i)
+						result += stack[--top];
+					stack[top++] = result;
 				}
 				break;
 
-				case SEGMENT:
+				case MULTIPLY:
 				{
-					const CqMatrix m = m_instructions[pc++].get_matrix();
-					const CqVector3D start = m_instructions[pc++].get_vector();
-					const CqVector3D end = m_instructions[pc++].get_vector();
-					const TqFloat radius = m_instructions[pc++].value;
-
-					// Nearest segment point
-					const CqVector3D segment_point = nearest_segment_point(Point, start, end);
-					// Translation( segment_point ) * Scaling ( radius ) * m
-					const CqMatrix transformation = CqMatrix( segment_point ) * CqMatrix( radius, radius, radius ) * m;
-					// Distance
-					const TqFloat r2 = (transformation.Inverse() * Point).Magnitude2();
-
-					// Value
-					result = (r2 <= 1) ? (1 - 3*r2 + 3*r2*r2 - r2*r2*r2) : 0;
-
-					//Aqsis::log() << info << "Segment: result " << result << std::endl;
-					stack.push(result);
+					TqFloat result = op.arg > 0 ? stack[--top] : 0.0f;
+					for(TqInt i = 1; i < op.arg; ++i)
+						result *= stack[--top];
+					stack[top++] = result;
 				}
 				break;
 
-				case SUBTRACT:
+				case MIN:
 				{
-					TqFloat a = stack.top();
-					stack.pop();
-					TqFloat b = stack.top();
-					stack.pop();
-					//Aqsis::log() << info << "idex a " << a << " idex b " << b << std::endl;
-					result = 0.0;
-					if (a != 0.0)
-						result = b/a;
-
-					stack.push(result);
+					TqFloat result = op.arg > 0 ? stack[--top] : 0.0f;
+					for(TqInt i = 1; i < op.arg; ++i)
+						result = min(result, stack[--top]);
+					stack[top++] = result;
 				}
 				break;
 
-				case DIVIDE:
+				case MAX:
 				{
-					TqFloat a = stack.top();
-					stack.pop();
-					TqFloat b = stack.top();
-					stack.pop();
-
-					result = b - a;
-					stack.push(result);
+					TqFloat result = op.arg > 0 ? stack[--top] : 0.0f;
+					for(TqInt i = 1; i < op.arg; ++i)
+						result = max(result, stack[--top]);
+					stack[top++] = result;
 				}
 				break;
 
-				case ADD:
+				// The assembler decodes RiBlobby code 4 (subtract) as DIVIDE
+				// and code 5 (divide) as SUBTRACT, so the two are evaluated
+				// the other way round here.
+				case SUBTRACT:
 				{
-					const TqInt count = m_instructions[pc++].count;
-					result = 0.0;
-					for(TqInt i = 0; i != count; ++i)
-					{
-						result += stack.top();
-						stack.pop();
-					}
-					stack.push(result);
+					const TqFloat a = stack[--top];
+					const TqFloat b = stack[--top];
+					stack[top++] = a != 0.0f ? b/a : 0.0f;
 				}
 				break;
 
-				case MULTIPLY:
+				case DIVIDE:
 				{
-					const TqInt count = m_instructions[pc++].count;
-					result = stack.top();
-					stack.pop();
-					for(TqInt i = 1; i != count; ++i)
-					{
-						result *= stack.top();
-						stack.pop();
-					}
-					stack.push(result);
+					const TqFloat a = stack[--top];
+					const TqFloat b = stack[--top];
+					stack[top++] = b - a;
 				}
 				break;
 
-				case MIN:
+				default:
 				{
-					const TqInt count = m_instructions[pc++].count;
-					result = stack.top();
-					stack.pop();
-					for(TqInt i = 1; i != count; ++i)
-					{
-						result = min(result, stack.top());
-						stack.pop();
-					}
-					stack.push(result);
+					const SqLeaf& leaf = m_leaves[op.arg];
+					stack[top++] = leaf.bounded && !leaf.bound.Contains3D(Point) ? 0.0f : leafValue(leaf, Point);
 				}
 				break;
-				case MAX:
+		}
+	}
+
+	return top > 0 ? stack[top - 1] : 0.0f;
+}
+
+//---------------------------------------------------------------------
+/** Return the sum of the first n leaves, storing each leaf value in
+ *  splits.  This is used to weight the parameters of each leaf when
+ *  shading the polygonized blobby (via ri.cpp).
+ */
+TqFloat CqBlobby::implicit_value( const CqVector3D& Point, TqInt n, std::vector <TqFloat> &splits ) const
+{
+	std::fill(splits.begin(), splits.begin() + n, 0.0f);
+	n = min<TqInt>(n, m_leaves.size());
+
+	TqFloat sum = sumLeaves(Point, false, n, &splits);
+	if(!m_bounded)
+	{
+		for(TqInt i = 0; i < n; ++i)
+		{
+			if(m_leaves[i].bounded)
+				continue;
+			splits[i] = leafValue(m_leaves[i], Point);
+			sum += splits[i];
+		}
+	}
+
+	return sum;
+}
+
+//---------------------------------------------------------------------
+/** Return the implicit value at a point.
+ *  This is the most important method it is used by MarchingCubes.cpp to
+ *  polygonize the primitives
+ */
+TqFloat CqBlobby::implicit_value( const CqVector3D& Point ) const
+{
+	TqFloat result = sumLeaves(Point, true, m_leaves.size(), 0);
+	for(std::vector<std::pair<TqInt, TqInt> >::const_iterator term = m_terms.begin();
+	        term != m_terms.end(); ++term)
+		result += evaluate(term->first, term->second, Point);
+	return result;
+}
+
+namespace {
+
+/// Sampling lattice of a blobby polygonization.
+struct SqPolygonizeGrid
+{
+	CqVector3D start;		///< Position of the first lattice point.
+	CqVector3D voxel;		///< Lattice spacing along each axis.
+	TqInt divX;				///< Number of blocks along x.
+	TqInt divY;				///< Number of blocks along y.
+};
+
+/// Mesh produced by marching cubes over one block of the lattice.
+struct SqPolygonizeBlock
+{
+	std::vector<Vertex> vertices;
+	std::vector<Triangle> triangles;
+};
+
+/** Polygonize every step'th block of the lattice, starting from first.
+ *  Each block of OPTIMUM_GRID_SIZE cubes is sampled and run through
+ *  marching cubes on its own, so blocks may be shared between threads.
+ */
+void polygonizeBlocks(const CqBlobby& blobby, const SqPolygonizeGrid& grid,
+                      std::vector<SqPolygonizeBlock>& blocks, TqInt first, TqInt step)
+{
+	for(TqInt b = first, nblocks = blocks.size(); b < nblocks; b += step)
+	{
+		// First lattice point of the block
+		const TqInt i0 = OPTIMUM_GRID_SIZE * (b % grid.divX);
+		const TqInt j0 = OPTIMUM_GRID_SIZE * ((b / grid.divX) % grid.divY);
+		const TqInt k0 = OPTIMUM_GRID_SIZE * (b / (grid.divX * grid.divY));
+
+		const CqVector3D origin(grid.start.x() + i0 * grid.voxel.x(),
+		                        grid.start.y() + j0 * grid.voxel.y(),
+		                        grid.start.z() + k0 * grid.voxel.z());
+		if(!blobby.mayContainField(CqBound(origin, origin + OPTIMUM_GRID_SIZE * grid.voxel)))
+			continue;
+
+		// Initialize Marching Cubes algorithm
+		MarchingCubes mc(OPTIMUM_GRID_SIZE+1, OPTIMUM_GRID_SIZE+1, OPTIMUM_GRID_SIZE+1);
+		mc.init_all();
+
+		bool isrequired = false;
+		for(TqInt k = 0; k < OPTIMUM_GRID_SIZE+1; ++k)
+		{
+			const TqFloat z = grid.start.z() + (k0 + k) * grid.voxel.z();
+			for(TqInt j = 0; j < OPTIMUM_GRID_SIZE+1; ++j)
+			{
+				const TqFloat y = grid.start.y() + (j0 + j) * grid.voxel.y();
+				for(TqInt i = 0; i < OPTIMUM_GRID_SIZE+1; ++i)
 				{
-					const TqInt count = m_instructions[pc++].count;
-					result = stack.top();
-					stack.pop();
-					for(TqInt i = 1; i != count; ++i)
-					{
-						result = max(result, stack.top());
-						stack.pop();
-					}
-					stack.push(result);
+					const TqFloat x = grid.start.x() + (i0 + i) * grid.voxel.x();
+					const TqFloat iv = blobby.implicit_value( CqVector3D( x, y, z ) );
+					isrequired |= (iv != 0.0);
+					mc.set_data( static_cast<TqFloat>( iv - 0.421875 ), i, j, k );
 				}
-				break;
+			}
 		}
-	}
 
-	return stack.top();
+		// Run Marching Cubes when we are sure it is required.
+		if(!isrequired)
+			continue;
+		mc.run();
+		if(mc.ntrigs() == 0 || mc.nverts() == 0)
+			continue;
+
+		// Compute vertex positions in the blobbies world (they were returned in grid coordinates)
+		SqPolygonizeBlock& block = blocks[b];
+		block.vertices.resize(mc.nverts());
+		for(TqInt v = 0; v < mc.nverts(); ++v)
+		{
+			block.vertices[v].x = origin.x() + grid.voxel.x() * mc.vertices()[v].x;
+			block.vertices[v].y = origin.y() + grid.voxel.y() * mc.vertices()[v].y;
+			block.vertices[v].z = origin.z() + grid.voxel.z() * mc.vertices()[v].z;
+		}
+		block.triangles.assign(mc.triangles(), mc.triangles() + mc.ntrigs());
+	}
 }
 
+} // unnamed namespace
+
 
 /** \fn TqInt polygonize( TqInt& NPoints, TqInt& NPolys, TqInt*& NVertices, TqInt*& Vertices, TqFloat*& Points, TqFloat PixelsWidth, TqFloat PixelsHeight )
     \brief Polygonizes RiBlobby and outputs RiPointsPolygons data.
+
+    The bounding-box is cut into blocks which are polygonized separately,
+    on several threads when the field allows it.
+
     \param PixelWidth Blobby's bounding-box width in pixels.
     \param PixelHeight Blobby's bounding-box height in pixels.
     \param NPoints Resulting point count.
@@ -1028,8 +1240,6 @@ TqFloat CqBlobby::implicit_value( const CqVector3D& Point )
  */
 TqInt CqBlobby::polygonize( TqInt PixelsWidth, TqInt PixelsHeight, TqInt& NPoints, TqInt& NPolys, TqInt*& NVertices, TqInt*& Vertices, TqFloat*& Points )
 {
-	register TqInt i,j,k;
-
 	// Make sure the blobby is big enough to show
 	if(PixelsWidth <= 0 || PixelsHeight <= 0)
 		return 0;
@@ -1051,137 +1261,46 @@ TqInt CqBlobby::polygonize( TqInt PixelsWidth, TqInt PixelsHeight, TqInt& NPoint
 	const TqInt y_resolution = PixelsHeight;
 	const TqInt z_resolution = static_cast<TqInt>( ceil( length.z() / z_voxel_size) );
 
-
-	const TqFloat x_start = center.x() - length.x()/2.0;
-	const TqFloat y_start = center.y() - length.y()/2.0;
-	const TqFloat z_start = center.z() - length.z()/2.0;
-
 	const TqInt div_z = z_resolution/OPTIMUM_GRID_SIZE + 1;
 	const TqInt div_y = y_resolution/OPTIMUM_GRID_SIZE + 1;
 	const TqInt div_x = x_resolution/OPTIMUM_GRID_SIZE + 1;
 
-	int nverts = 0;
-	int ntrigs = 0;
-	Vertex* vertices = 0;
-	Triangle* triangles = 0;
+	SqPolygonizeGrid grid;
+	grid.start = center - length/2.0;
+	grid.voxel = CqVector3D(x_voxel_size, y_voxel_size, z_voxel_size);
+	grid.divX = div_x;
+	grid.divY = div_y;
 
-	Aqsis::log() << info << "We will need to call mc " << div_x  * div_y * div_z << std::endl;
-	TqInt cnt = 1;
+	std::vector<SqPolygonizeBlock> blocks(div_x * div_y * div_z);
 
-	for (TqInt k1=0; k1 < div_z; k1 ++)
+	TqInt numThreads = 1;
+	if(m_threadSafe)
+		numThreads = min<TqInt>(max<TqInt>(boost::thread::hardware_concurrency(), 1), blocks.size());
+	if(numThreads > 1)
 	{
-		for (TqInt y1=0; y1 < div_y; y1++)
+		boost::thread_group threads;
+		for(TqInt t = 0; t < numThreads; ++t)
 		{
-			for (TqInt x1=0; x1 < div_x; x1++)
-			{
-
-				TqFloat x,y,z;
-
-				z = z_start + (TqFloat) k1 * (TqFloat) OPTIMUM_GRID_SIZE * z_voxel_size;
-				bool isrequired = false;
-
-				// Initialize Marching Cubes algorithm
-				MarchingCubes mc(OPTIMUM_GRID_SIZE+1, OPTIMUM_GRID_SIZE+1, OPTIMUM_GRID_SIZE+1);
-
-				mc.init_all();
-
-				for( k = 0 ; k < OPTIMUM_GRID_SIZE+1; k++, z += z_voxel_size )
-				{
-					y = y_start + (TqFloat) y1 * (TqFloat)OPTIMUM_GRID_SIZE * y_voxel_size;
-					for( j = 0 ; j < OPTIMUM_GRID_SIZE+1; j++, y += y_voxel_size )
-					{
-
-						x = x_start + (TqFloat) x1 * (TqFloat)OPTIMUM_GRID_SIZE * x_voxel_size;
-						for( i = 0 ; i < OPTIMUM_GRID_SIZE+1; i++, x += x_voxel_size )
-						{
-							const TqFloat iv = implicit_value( CqVector3D( x, y, z ) );
-							isrequired |= (iv != 0.0);
-							//Aqsis::log() << info << iv << std::endl;
-							mc.set_data( static_cast<TqFloat>( iv - 0.421875 ), i, j, k );
-						}
-					}
-				}
-
-				z = z_start + (TqFloat) k1 * (TqFloat)OPTIMUM_GRID_SIZE * z_voxel_size;
-				y = y_start + (TqFloat) y1 * (TqFloat)OPTIMUM_GRID_SIZE * y_voxel_size;
-				x = x_start + (TqFloat) x1 * (TqFloat)OPTIMUM_GRID_SIZE * x_voxel_size;
-
-
-				if (!isrequired)
-				{
-					Aqsis::log() << info << "Don't need to call mc " << cnt++ << std::endl;
-					continue;
-				}
-
-				// Run Marching Cubes
-				// when we are sure it is required.
-
-
-				{
-					// Inform the status class how far we have got, and update UI.
-					float Complete = ( float ) ( cnt++ );
-					Complete /= (div_x  * div_y * div_z);
-					Complete *= 100.0f;
-					Aqsis::log() << info << "Polygonize a blobby " << Complete << "% complete" << std::endl;
-				}
-
-				mc.run() ;
-
-				if ((mc.ntrigs() == 0) || mc.nverts() == 0)
-				{
-					Aqsis::log() << info << "Don't merge the vertices they are empty " << cnt-1 << std::endl;
-					continue;
-				}
-
-				TqInt overts = nverts;
-				if (nverts == 0)
-				{
-					nverts = mc.nverts();
-					vertices = (Vertex*) malloc(nverts * sizeof(Vertex));
-
-				}
-				else
-				{
-					nverts += mc.nverts();
-					vertices = (Vertex*) realloc(vertices, nverts * sizeof(Vertex));
-
-				}
-
-				// Compute vertex positions in the blobbies world (they were returned in grid coordinates)
-				for (TqInt tmp = 0; tmp < mc.nverts(); tmp++)
-				{
-					vertices[overts+tmp].x = x + x_voxel_size * mc.vertices()[tmp].x;
-					vertices[overts+tmp].y = y + y_voxel_size * mc.vertices()[tmp].y;
-					vertices[overts+tmp].z = z + z_voxel_size * mc.vertices()[tmp].z;
-				}
-
-				TqInt otrigs = ntrigs;
-
-				if (ntrigs == 0)
-				{
-					ntrigs = mc.ntrigs();
-					triangles = (Triangle *) malloc(ntrigs * sizeof(Triangle));
-					memcpy(triangles, mc.triangles(), ntrigs * sizeof(Triangle));
-				}
-				else
-				{
-
-					ntrigs += mc.ntrigs();
-					triangles = (Triangle *) realloc(triangles,  ntrigs * sizeof(Triangle));
-					for (TqInt tmp = 0; tmp < mc.ntrigs(); tmp++)
-					{
-						triangles[otrigs+tmp].v1 = mc.triangles()[tmp].v1 + overts;
-						triangles[otrigs+tmp].v2 = mc.triangles()[tmp].v2 + overts;
-						triangles[otrigs+tmp].v3 = mc.triangles()[tmp].v3 + overts;
-					}
-				}
-
-
-
-			}
+			threads.create_thread(boost::bind(&polygonizeBlocks, boost::cref(*this),
+			                      boost::cref(grid), boost::ref(blocks), t, numThreads));
 		}
+		threads.join_all();
 	}
+	else
+		polygonizeBlocks(*this, grid, blocks, 0, 1);
 
+	Aqsis::log() << info << "Polygonized a blobby in " << blocks.size() << " blocks on "
+		<< numThreads << " threads" << std::endl;
+
+	// Join the blocks in order, so the mesh doesn't depend on the threading.
+	TqInt nverts = 0;
+	TqInt ntrigs = 0;
+	std::vector<SqPolygonizeBlock>::const_iterator block;
+	for(block = blocks.begin(); block != blocks.end(); ++block)
+	{
+		nverts += block->vertices.size();
+		ntrigs += block->triangles.size();
+	}
 
 	NPoints = nverts;
 	NPolys = ntrigs;
@@ -1189,28 +1308,31 @@ TqInt CqBlobby::polygonize( TqInt PixelsWidth, TqInt PixelsHeight, TqInt& NPoint
 	Vertices = new TqInt[3 * NPolys];
 	Points = new TqFloat[3 * NPoints];
 
-	// Set vertex indices
 	TqInt* nvert = NVertices;
 	TqInt* vert = Vertices;
-	for ( i = 0; i < ntrigs; ++i )
-	{
-		*nvert++ = 3;
-		*vert++ = triangles[i].v1;
-		*vert++ = triangles[i].v2;
-		*vert++ = triangles[i].v3;
-	}
-
-
 	TqFloat* point = Points;
-	for ( i = 0; i < nverts; i++ )
+	TqInt overts = 0;
+	for(block = blocks.begin(); block != blocks.end(); ++block)
 	{
-		*point++ = vertices[i].x;
-		*point++ = vertices[i].y;
-		*point++ = vertices[i].z;
-	}
+		// Set vertex indices
+		std::vector<Triangle>::const_iterator tri;
+		for(tri = block->triangles.begin(); tri != block->triangles.end(); ++tri)
+		{
+			*nvert++ = 3;
+			*vert++ = tri->v1 + overts;
+			*vert++ = tri->v2 + overts;
+			*vert++ = tri->v3 + overts;
+		}
 
-	free(vertices);
-	free(triangles);
+		std::vector<Vertex>::const_iterator v;
+		for(v = block->vertices.begin(); v != block->vertices.end(); ++v)
+		{
+			*point++ = v->x;
+			*point++ = v->y;
+			*point++ = v->z;
+		}
+		overts += block->vertices.size();
+	}
 
 	// Cleanup the DBO i/f
 	if (DBO_handle)
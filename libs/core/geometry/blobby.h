@@ -39,6 +39,9 @@
 #include <aqsis/ri/ri.h>
 #include <aqsis/math/vector3d.h>
 
+#include <utility>
+#include <vector>
+
 namespace Aqsis {
 
 // CqBlobby
@@ -55,6 +58,10 @@ class CqBlobby : public CqSurface
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Blobby );
+		}
 		/** \todo Find out the correct values for the 4 following functions */
 		virtual	TqUint	cUniform() const
 		{
@@ -85,12 +92,22 @@ class CqBlobby : public CqSurface
 			bound->vecMax() = m_bbox.vecMax();
 		}
 
+		/** Return CqBlobby's implicit value, as the sum of the first n leaves.
+		 * \param Point World position to compute implicit value from.
+		 * \param n Number of leaves to evaluate.
+		 * \param splits Receives the value of each of the first n leaves.
+		 */
+		TqFloat implicit_value(const CqVector3D& Point, TqInt n, std::vector <TqFloat>& splits) const;
+
 		/** Return CqBlobby's implicit value.
-		 * \param World position to compute implicit value from.
+		 * \param Point World position to compute implicit value from.
 		 */
-		TqFloat implicit_value(const CqVector3D& Point, TqInt n, std::vector <TqFloat>& splits);
+		TqFloat implicit_value(const CqVector3D& Point) const;
 
-		TqFloat implicit_value(const CqVector3D& Point);
+		/** Determine whether the implicit value may be non-zero somewhere
+		 * inside a region.
+		 */
+		bool mayContainField(const CqBound& bound) const;
 
 		TqInt polygonize(TqInt PixelsWidth, TqInt PixelsHeight, TqInt& NPoints, TqInt& NPolys, TqInt*& NVertices, TqInt*& Vertices, TqFloat*& Points);
 
@@ -175,9 +192,62 @@ class CqBlobby : public CqSurface
 		typedef std::vector<instruction> instructions_t;
 
 	private:
+		/** \brief A primitive field of the compiled blobby program.
+		 */
+		struct SqLeaf
+		{
+			EqOpcodeName type;		///< CONSTANT, ELLIPSOID, SEGMENT, PLANE or AIR.
+			CqMatrix transform;		///< Inverse of the leaf transformation.
+			CqVector3D start;		///< Segment start, or minimum of the DBO bound.
+			CqVector3D end;			///< Segment end, or maximum of the DBO bound.
+			TqFloat value;			///< Constant value, or segment radius.
+			TqInt index;			///< String index of a PLANE, or code index of an AIR leaf.
+			TqInt floatIndex;		///< Float index of the PLANE parameters.
+			CqBound bound;			///< Region outside which the leaf field is zero.
+			bool bounded;			///< Whether bound is valid.
+			bool additive;			///< Whether only ADD operators join the leaf to the root.
+		};
+
+		/** \brief An operation of the flattened postfix program.
+		 */
+		struct SqOp
+		{
+			EqOpcodeName opcode;
+			TqInt arg;				///< Leaf index, or operand count of an n-ary operator.
+		};
+
+		/** \brief A node of the bounding volume hierarchy over the bounded leaves.
+		 */
+		struct SqBvhNode
+		{
+			CqBound bound;
+			TqInt first;			///< Right child of an interior node, or first entry in m_bvhLeaves.
+			TqInt count;			///< Number of leaves, zero for an interior node.
+		};
+
+		void compile();
+		void collectTerms(TqInt root, const std::vector<TqInt>& starts);
+		TqInt buildBvh(TqInt begin, TqInt end, const std::vector<CqVector3D>& centres);
+		TqFloat leafValue(const SqLeaf& leaf, const CqVector3D& Point) const;
+		TqFloat sumLeaves(const CqVector3D& Point, bool additiveOnly, TqInt n, std::vector<TqFloat>* splits) const;
+		TqFloat evaluate(TqInt begin, TqInt end, const CqVector3D& Point) const;
+
 		// Program (list of instructions) that computes implicit values
 		instructions_t m_instructions;
 
+		// Compiled form of m_instructions
+		std::vector<SqLeaf> m_leaves;
+		std::vector<SqOp> m_program;
+		/// Ranges of m_program added to the additive leaves to give the field.
+		std::vector<std::pair<TqInt, TqInt> > m_terms;
+		std::vector<SqBvhNode> m_bvh;
+		std::vector<TqInt> m_bvhLeaves;
+		TqInt m_maxStack;
+		/// Whether every leaf has a finite support.
+		bool m_bounded;
+		/// Whether the field may be evaluated on several threads at once.
+		bool m_threadSafe;
+
 		// Bounding-box
 		CqBound m_bbox;
 
@@ -351,15 +351,14 @@ CqVector3D chooseEndpointTangent(const CqVector3D& tangent1, const CqVector3D& t
 		return tangent3;
 }
 
-} // unnamed namespace
-
-CqVector3D	CqCubicCurveSegment::CalculateTangent(TqFloat u)
+/** \brief Calculate the tangent of a bezier curve segment.
+ *
+ * \param pg - the four bezier control points of the segment.
+ * \param u - curve parameter
+ * \return the tangent vector at u.
+ */
+CqVector3D bezierTangent(const CqVector3D pg[4], TqFloat u)
 {
-	// Read 3D vertices into the array pg.
-	CqVector3D pg[4];
-	for(TqInt i=0; i <= 3; i++)
-		pg[i] = vectorCast<CqVector3D>(*P()->pValue(i));
-
 	if(u == 0.0f)
 		return chooseEndpointTangent(pg[1] - pg[0], pg[2] - pg[0], pg[3] - pg[0]);
 	else if(u == 1.0f)
@@ -377,6 +376,18 @@ CqVector3D	CqCubicCurveSegment::CalculateTangent(TqFloat u)
 	}
 }
 
+} // unnamed namespace
+
+CqVector3D	CqCubicCurveSegment::CalculateTangent(TqFloat u)
+{
+	// Read 3D vertices into the array pg.
+	CqVector3D pg[4];
+	for(TqInt i=0; i <= 3; i++)
+		pg[i] = vectorCast<CqVector3D>(*P()->pValue(i));
+
+	return bezierTangent(pg, u);
+}
+
 
 
 /**
@@ -603,6 +614,142 @@ inline TqInt segmentsPerCurve(TqInt numVerts, TqInt step, bool isPeriodic)
 		return (numVerts - 4)/step + 1;
 }
 
+/** \brief Position of one row of a diced curve group within the curve
+ * parameters.
+ */
+struct SqCurveSample
+{
+	TqInt vertex;		///< Index of the first bezier vertex of the segment.
+	TqFloat bezier[4];	///< Bezier basis weights for vertex parameters.
+	TqInt varying[2];	///< Indices of the varying values at the segment ends.
+	TqFloat t;			///< Position within the segment.
+	TqInt uniform;		///< Index of the curve.
+	TqFloat v;			///< Curve parameter along the whole curve.
+};
+
+/** \brief Evaluate one array element of a curve parameter at a sample.
+ *
+ * \param values - parameter values.
+ * \param arraySize - array length of the parameter.
+ * \param j - array element to evaluate.
+ * \param paramClass - storage class of the parameter.
+ * \param sample - position on the curve group.
+ */
+template<typename T>
+T sampleCurveParam(const T* values, TqInt arraySize, TqInt j,
+		EqVariableClass paramClass, const SqCurveSample& sample)
+{
+	switch(paramClass)
+	{
+		case class_vertex:
+			{
+				const T* p = values + arraySize*sample.vertex + j;
+				return sample.bezier[0]*p[0] + sample.bezier[1]*p[arraySize]
+					+ sample.bezier[2]*p[2*arraySize] + sample.bezier[3]*p[3*arraySize];
+			}
+		case class_varying:
+			return (1 - sample.t)*values[arraySize*sample.varying[0] + j]
+				+ sample.t*values[arraySize*sample.varying[1] + j];
+		case class_uniform:
+			return values[arraySize*sample.uniform + j];
+		default:
+			return values[j];
+	}
+}
+
+/** \brief Dice a parameter of a curve group onto a ribbon grid.
+ *
+ * The grid has two columns, holding the two edges of the ribbon, which
+ * receive the same value.
+ *
+ * \param pParam - parameter to dice.
+ * \param samples - position on the curves of each row of the grid.
+ * \param pData - destination shader data.
+ * \param arrayIndex - if non-negative, dice only this array element of
+ *                     pParam into the non-array pData.
+ */
+template<typename T, typename SLT>
+void curvesGroupDice(CqParameter* pParam, const std::vector<SqCurveSample>& samples,
+		IqShaderData* pData, TqInt arrayIndex = -1)
+{
+	if(pData->Class() != class_varying)
+	{
+		Aqsis::log() << error << "\"" << "Attempt to assign a varying value to uniform variable \"" <<
+			pData->strName() << "\"" << std::endl;
+		return;
+	}
+
+	CqParameterTyped<T, SLT>* pTParam = static_cast<CqParameterTyped<T, SLT>*>(pParam);
+	const T* src = pTParam->pValue();
+	const TqInt arraySize = pTParam->Count();
+	const EqVariableClass paramClass = pParam->Class();
+	const TqInt firstEntry = arrayIndex < 0 ? 0 : arrayIndex;
+	const TqInt lastEntry = arrayIndex < 0 ? arraySize : arrayIndex + 1;
+	for(TqInt j = firstEntry; j < lastEntry; j++)
+	{
+		SLT* dest = 0;
+		if(arrayIndex < 0)
+			pData->ArrayEntry(j)->GetValuePtr(dest);
+		else
+			pData->GetValuePtr(dest);
+		for(TqInt i = 0, numSamples = samples.size(); i < numSamples; i++)
+		{
+			SLT value = paramToShaderType<SLT,T>(
+					sampleCurveParam(src, arraySize, j, paramClass, samples[i]) );
+			dest[2*i] = value;
+			dest[2*i + 1] = value;
+		}
+	}
+}
+
+/** \brief Determine whether a parameter type can be diced by curvesGroupDice().
+ */
+inline bool curvesGroupDiceableType(EqVariableType type)
+{
+	switch(type)
+	{
+		case type_float:
+		case type_point:
+		case type_vector:
+		case type_normal:
+		case type_hpoint:
+		case type_color:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/** \brief Dice a parameter of a curve group onto a ribbon grid.
+ *
+ * Dispatches to curvesGroupDice() based on the type of the parameter; the
+ * type must be one for which curvesGroupDiceableType() is true.
+ */
+void curvesGroupDiceParam(CqParameter* pParam, const std::vector<SqCurveSample>& samples,
+		IqShaderData* pData, TqInt arrayIndex = -1)
+{
+	switch(pParam->Type())
+	{
+		case type_float:
+			curvesGroupDice<TqFloat, TqFloat>(pParam, samples, pData, arrayIndex);
+			break;
+		case type_point:
+		case type_vector:
+		case type_normal:
+			curvesGroupDice<CqVector3D, CqVector3D>(pParam, samples, pData, arrayIndex);
+			break;
+		case type_hpoint:
+			curvesGroupDice<CqVector4D, CqVector3D>(pParam, samples, pData, arrayIndex);
+			break;
+		case type_color:
+			curvesGroupDice<CqColor, CqColor>(pParam, samples, pData, arrayIndex);
+			break;
+		default:
+			assert(0 && "Unsupported type for curve group dicing");
+			break;
+	}
+}
+
 } // unnamed namespace
 
 
@@ -843,6 +990,10 @@ TqInt CqCubicCurvesGroup::Split(
     std::vector<boost::shared_ptr<CqSurface> >& aSplits
 )
 {
+	// Groups which are only too big to dice are halved, so the halves may be
+	// diced as single grids.
+	if ( m_splitDecision == Split_Curve && m_ncurves > 1 )
+		return SplitCurves( aSplits );
 
 	// number of points to skip between curves
 	TqInt vStep =
@@ -1010,6 +1161,377 @@ TqInt CqCubicCurvesGroup::Split(
 }
 
 
+/**
+ * Splits the group into two groups, each holding half of the curves.
+ *
+ * @param aSplits       Vector to contain the two new groups.
+ *
+ * @return  The number of groups created.
+ */
+TqInt CqCubicCurvesGroup::SplitCurves(
+    std::vector<boost::shared_ptr<CqSurface> >& aSplits
+)
+{
+	const TqInt vStep =
+	    pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 1 ];
+
+	TqInt firstCurve = 0;
+	TqInt vertexBezierStart = 0;
+	TqInt varyingStart = 0;
+	for ( TqInt half = 0; half < 2; half++ )
+	{
+		const TqInt ncurves = half == 0 ? m_ncurves / 2 : m_ncurves - m_ncurves / 2;
+
+		boost::shared_ptr<CqCubicCurvesGroup> pGroup( new CqCubicCurvesGroup() );
+		pGroup->SetSurfaceParameters( *this );
+		pGroup->m_ncurves = ncurves;
+		pGroup->m_periodic = m_periodic;
+		pGroup->m_basisTrans = m_basisTrans;
+		pGroup->m_nTotalVerts = 0;
+		pGroup->m_nVertsBezier = 0;
+		pGroup->m_nvertices.assign( m_nvertices.begin() + firstCurve,
+		                            m_nvertices.begin() + firstCurve + ncurves );
+		for ( TqInt i = 0; i < ncurves; i++ )
+		{
+			pGroup->m_nTotalVerts += pGroup->m_nvertices[ i ];
+			pGroup->m_nVertsBezier += 4*segmentsPerCurve( pGroup->m_nvertices[ i ], vStep, m_periodic );
+		}
+		const TqInt nVarying = pGroup->cVarying();
+
+		std::vector<CqParameter*>::iterator iUP;
+		for ( iUP = aUserParams().begin(); iUP != aUserParams().end(); iUP++ )
+		{
+			TqInt start = 0;
+			TqInt size = 1;
+			switch ( ( *iUP ) ->Class() )
+			{
+				case class_vertex:
+					// vertex parameters are stored in the bezier basis.
+					start = vertexBezierStart;
+					size = pGroup->m_nVertsBezier;
+					break;
+				case class_varying:
+					start = varyingStart;
+					size = nVarying;
+					break;
+				case class_uniform:
+					start = firstCurve;
+					size = ncurves;
+					break;
+				case class_constant:
+					break;
+				default:
+					// ignore any other interpolation classes
+					continue;
+			}
+			CqParameter * pNewUP =
+			    ( *iUP ) ->CloneType( ( *iUP ) ->strName().c_str(), ( *iUP ) ->Count() );
+			pNewUP->SetSize( size );
+			for ( TqInt i = 0; i < size; i++ )
+				pNewUP->SetValue( ( *iUP ), i, start + i );
+			// Bypass the basis conversion in AddPrimitiveVariable().
+			pGroup->CqCurvesGroup::AddPrimitiveVariable( pNewUP );
+		}
+
+		firstCurve += ncurves;
+		vertexBezierStart += pGroup->m_nVertsBezier;
+		varyingStart += nVarying;
+
+		aSplits.push_back( pGroup );
+	}
+
+	return 2;
+}
+
+
+/**
+ * Determine whether the group can be diced into a single grid.
+ *
+ * The curves are diced as ribbons, one micropolygon wide, stacked along v
+ * into one grid.  This is only possible if all curves have the same number
+ * of segments, the ribbons are narrow compared to the shading rate, and all
+ * parameters can be interpolated along the ribbons.  Groups which fail only
+ * because they are too large for a grid are halved by Split(), others are
+ * split into curve segments.
+ */
+bool CqCubicCurvesGroup::Diceable(const CqMatrix& matCtoR)
+{
+	m_splitDecision = Split_Patch;
+	if ( !m_fDiceable )
+		return false;
+
+	const TqInt vStep =
+	    pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 1 ];
+	const TqInt nSegs = segmentsPerCurve( m_nvertices[ 0 ], vStep, m_periodic );
+	for ( TqInt i = 1; i < m_ncurves; i++ )
+	{
+		if ( segmentsPerCurve( m_nvertices[ i ], vStep, m_periodic ) != nSegs )
+			return false;
+	}
+
+	std::vector<boost::shared_ptr<IqShader> > shaders;
+	boost::shared_ptr<IqShader> pShader;
+	if ( pShader = pAttributes() ->pshadSurface( QGetRenderContext() ->Time() ) )
+		shaders.push_back( pShader );
+	if ( pShader = pAttributes() ->pshadDisplacement( QGetRenderContext() ->Time() ) )
+		shaders.push_back( pShader );
+	if ( pShader = pAttributes() ->pshadAtmosphere( QGetRenderContext() ->Time() ) )
+		shaders.push_back( pShader );
+
+	std::vector<CqParameter*>::iterator iUP;
+	for ( iUP = aUserParams().begin(); iUP != aUserParams().end(); iUP++ )
+	{
+		switch ( ( *iUP ) ->Class() )
+		{
+			case class_vertex:
+			case class_varying:
+			case class_uniform:
+				if ( !curvesGroupDiceableType( ( *iUP ) ->Type() ) )
+					return false;
+				break;
+			case class_constant:
+				break;
+			default:
+				return false;
+		}
+		// A uniform shader argument can only take the value of one curve.
+		if ( ( *iUP ) ->Class() == class_uniform && m_ncurves > 1 )
+		{
+			for ( std::vector<boost::shared_ptr<IqShader> >::iterator shader = shaders.begin();
+			        shader != shaders.end(); ++shader )
+			{
+				IqShaderData* pArg = ( *shader ) ->FindArgument( ( *iUP ) ->strName() );
+				if ( pArg && pArg->Class() != class_varying )
+					return false;
+			}
+		}
+	}
+
+	// Find the longest control hull edge and the widest point of the curves
+	// in raster space.
+	const TqInt nVarying = m_periodic ? nSegs : nSegs + 1;
+	TqFloat maxLen2 = 0;
+	TqFloat maxWidth2 = 0;
+	for ( TqInt curve = 0; curve < m_ncurves; curve++ )
+	{
+		for ( TqInt seg = 0; seg < nSegs; seg++ )
+		{
+			CqVector3D hull[ 4 ];
+			for ( TqInt i = 0; i < 4; i++ )
+				hull[ i ] = vectorCast<CqVector3D>( matCtoR * P() ->pValue( 4*( curve*nSegs + seg ) + i )[ 0 ] );
+			for ( TqInt i = 0; i < 3; i++ )
+				maxLen2 = max( maxLen2, ( hull[ i + 1 ] - hull[ i ] ).Magnitude2() );
+			for ( TqInt end = 0; end < 2; end++ )
+			{
+				CqVector3D pCamera = vectorCast<CqVector3D>( P() ->pValue( 4*( curve*nSegs + seg ) + 3*end )[ 0 ] );
+				TqFloat w = width() ->pValue( curve*nVarying + ( seg + end ) % nVarying )[ 0 ];
+				CqVector3D pEdge = matCtoR * ( pCamera + CqVector3D( w, 0, 0 ) );
+				maxWidth2 = max( maxWidth2, ( pEdge - hull[ 3*end ] ).Magnitude2() );
+			}
+		}
+	}
+
+	// Ribbons are one micropolygon wide, so must be narrow enough that a
+	// patch would also be diced to one micropolygon across.
+	TqFloat shadingRate = AdjustedShadingRate();
+	if ( lround( sqrt( maxWidth2/shadingRate ) ) > 1 )
+		return false;
+
+	m_uDiceSize = 1;
+	m_vDiceSize = max<TqInt>( lround( 3*sqrt( maxLen2/shadingRate ) ), 1 );
+	const TqInt *binary = pAttributes() ->GetIntegerAttribute( "dice", "binary" );
+	if ( binary && *binary )
+		m_vDiceSize = ceilPow2( m_vDiceSize );
+
+	TqFloat gs = 16.0f;
+	const TqFloat* poptGridSize = QGetRenderContext() ->poptCurrent()->GetFloatOption( "System", "SqrtGridSize" );
+	if( NULL != poptGridSize )
+		gs = poptGridSize[0];
+	if ( m_ncurves*nSegs*m_vDiceSize > gs*gs )
+	{
+		if ( m_ncurves > 1 )
+			m_splitDecision = Split_Curve;
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Dice the group into a grid of ribbons.
+ *
+ * The grid is two vertices wide, the edges of the ribbons at u = 0 and 1.
+ * Each curve forms a strip of rows running along v, with m_vDiceSize
+ * micropolygons per segment; the strips are stacked in one grid, and are
+ * not joined to each other.
+ */
+CqMicroPolyGridBase* CqCubicCurvesGroup::Dice()
+{
+	const TqInt vStep =
+	    pAttributes() ->GetIntegerAttribute( "System", "BasisStep" ) [ 1 ];
+	const TqInt nSegs = segmentsPerCurve( m_nvertices[ 0 ], vStep, m_periodic );
+	const TqInt nVarying = m_periodic ? nSegs : nSegs + 1;
+	const TqInt vDice = m_vDiceSize;
+	const TqInt stripRes = nSegs*vDice + 1;
+
+	// Find where each row of the grid lies on the curves.
+	std::vector<SqCurveSample> samples( m_ncurves*stripRes );
+	for ( TqInt curve = 0, i = 0; curve < m_ncurves; curve++ )
+	{
+		for ( TqInt row = 0; row < stripRes; row++, i++ )
+		{
+			SqCurveSample& sample = samples[ i ];
+			const TqInt seg = min( row / vDice, nSegs - 1 );
+			const TqFloat t = static_cast<TqFloat>( row - seg*vDice ) / vDice;
+			const TqFloat t1 = 1 - t;
+			sample.vertex = 4*( curve*nSegs + seg );
+			sample.bezier[ 0 ] = t1*t1*t1;
+			sample.bezier[ 1 ] = 3*t*t1*t1;
+			sample.bezier[ 2 ] = 3*t*t*t1;
+			sample.bezier[ 3 ] = t*t*t;
+			sample.varying[ 0 ] = curve*nVarying + seg % nVarying;
+			sample.varying[ 1 ] = curve*nVarying + ( seg + 1 ) % nVarying;
+			sample.t = t;
+			sample.uniform = curve;
+			sample.v = ( seg + t ) / nSegs;
+		}
+	}
+
+	CqMicroPolyGrid* pGrid = new CqMicroPolyGrid();
+	pGrid->Initialise( 1, m_ncurves*stripRes - 1, shared_from_this() );
+	pGrid->SetVStripRes( stripRes );
+
+	TqInt lUses = Uses();
+
+	// Offset the curves by half their width either side, perpendicular to
+	// the normal, as done by CqCubicCurveSegment::SplitToPatch().
+	IqShaderData* pP = pGrid->pVar( EnvVars_P );
+	for ( TqInt i = 0, numSamples = samples.size(); i < numSamples; i++ )
+	{
+		const SqCurveSample& sample = samples[ i ];
+		CqVector3D pg[ 4 ];
+		for ( TqInt k = 0; k < 4; k++ )
+			pg[ k ] = vectorCast<CqVector3D>( P() ->pValue( sample.vertex + k )[ 0 ] );
+		CqVector3D point = vectorCast<CqVector3D>(
+		                       sampleCurveParam( P() ->pValue(), 1, 0, class_vertex, sample ) );
+		CqVector3D normal0, normal1;
+		GetNormal( sample.varying[ 0 ], normal0 );
+		GetNormal( sample.varying[ 1 ], normal1 );
+		CqVector3D normal = ( 1 - sample.t )*normal0 + sample.t*normal1;
+		TqFloat w = sampleCurveParam( width() ->pValue(), 1, 0, class_varying, sample );
+		CqVector3D widthOffset = ( normal % bezierTangent( pg, sample.t ) ).Unit() * ( w/2 );
+		pP->SetPoint( point + widthOffset, 2*i );
+		pP->SetPoint( point - widthOffset, 2*i + 1 );
+	}
+
+	for ( TqInt uv = 0; uv < 2; uv++ )
+	{
+		const TqInt varID = uv == 0 ? EnvVars_u : EnvVars_v;
+		if ( USES( lUses, varID ) && ( NULL != pGrid->pVar( varID ) ) )
+		{
+			for ( TqInt i = 0, numSamples = samples.size(); i < numSamples; i++ )
+			{
+				pGrid->pVar( varID ) ->SetFloat( uv == 0 ? 0.0f : samples[ i ].v, 2*i );
+				pGrid->pVar( varID ) ->SetFloat( uv == 0 ? 1.0f : samples[ i ].v, 2*i + 1 );
+			}
+		}
+	}
+
+	// Special cases for s and t if "st" exists, it should override s and t.
+	TqInt lDone = 0;
+	DONE( lDone, EnvVars_P );
+	DONE( lDone, EnvVars_N );
+	DONE( lDone, EnvVars_u );
+	DONE( lDone, EnvVars_v );
+	CqParameter* pParam;
+	if( ( pParam = FindUserParam( "st" ) ) != NULL )
+	{
+		if ( USES( lUses, EnvVars_s ) && ( NULL != pGrid->pVar( EnvVars_s ) ) )
+			curvesGroupDiceParam( pParam, samples, pGrid->pVar( EnvVars_s ), 0 );
+		if ( USES( lUses, EnvVars_t ) && ( NULL != pGrid->pVar( EnvVars_t ) ) )
+			curvesGroupDiceParam( pParam, samples, pGrid->pVar( EnvVars_t ), 1 );
+		DONE( lDone, EnvVars_s );
+		DONE( lDone, EnvVars_t );
+	}
+
+	TqInt varID;
+	for( varID = EnvVars_Cs; varID != EnvVars_Last; varID++ )
+	{
+		if ( !isDONE( lDone, varID ) && USES( lUses, varID ) && ( NULL != pGrid->pVar( varID ) )
+		        && bHasVar( varID ) )
+		{
+			curvesGroupDiceParam( pVar( varID ), samples, pGrid->pVar( varID ) );
+			DONE( lDone, varID );
+		}
+	}
+
+	// s and t default to u and v for curves.
+	if ( !isDONE( lDone, EnvVars_s ) && USES( lUses, EnvVars_s ) && ( NULL != pGrid->pVar( EnvVars_s ) ) )
+	{
+		for ( TqInt i = 0, numSamples = samples.size(); i < numSamples; i++ )
+		{
+			pGrid->pVar( EnvVars_s ) ->SetFloat( 0.0f, 2*i );
+			pGrid->pVar( EnvVars_s ) ->SetFloat( 1.0f, 2*i + 1 );
+		}
+	}
+	if ( !isDONE( lDone, EnvVars_t ) && USES( lUses, EnvVars_t ) && ( NULL != pGrid->pVar( EnvVars_t ) ) )
+	{
+		for ( TqInt i = 0, numSamples = samples.size(); i < numSamples; i++ )
+		{
+			pGrid->pVar( EnvVars_t ) ->SetFloat( samples[ i ].v, 2*i );
+			pGrid->pVar( EnvVars_t ) ->SetFloat( samples[ i ].v, 2*i + 1 );
+		}
+	}
+
+	if ( !isDONE( lDone, EnvVars_Cs ) && USES( lUses, EnvVars_Cs ) && ( NULL != pGrid->pVar( EnvVars_Cs ) ) )
+	{
+		if ( NULL != pAttributes() ->GetColorAttribute( "System", "Color" ) )
+			pGrid->pVar( EnvVars_Cs ) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
+		else
+			pGrid->pVar( EnvVars_Cs ) ->SetColor( CqColor( 1, 1, 1 ) );
+	}
+
+	if ( !isDONE( lDone, EnvVars_Os ) && USES( lUses, EnvVars_Os ) && ( NULL != pGrid->pVar( EnvVars_Os ) ) )
+	{
+		if ( NULL != pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
+			pGrid->pVar( EnvVars_Os ) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
+		else
+			pGrid->pVar( EnvVars_Os ) ->SetColor( CqColor( 1, 1, 1 ) );
+	}
+
+	// Now we need to dice the user specified parameters as appropriate.
+	std::vector<boost::shared_ptr<IqShader> > shaders;
+	boost::shared_ptr<IqShader> pShader;
+	if(NULL != (pShader = pGrid->pAttributes()->pshadSurface(QGetRenderContext()->Time())))
+		shaders.push_back(pShader);
+	if(NULL != (pShader = pGrid->pAttributes()->pshadDisplacement(QGetRenderContext()->Time())))
+		shaders.push_back(pShader);
+	if(NULL != (pShader = pGrid->pAttributes()->pshadAtmosphere(QGetRenderContext()->Time())))
+		shaders.push_back(pShader);
+
+	std::vector<CqParameter*>::iterator iUP;
+	for ( iUP = m_aUserParams.begin(); iUP != m_aUserParams.end(); iUP++ )
+	{
+		for( std::vector<boost::shared_ptr<IqShader> >::iterator shader = shaders.begin(), last = shaders.end(); shader != last; ++shader )
+		{
+			// Uniform shader arguments are only allowed by Diceable() for a
+			// single curve, so the standard mechanism applies.
+			IqShaderData* pArg = ( *shader ) ->FindArgument( ( *iUP ) ->strName() );
+			if ( NULL == pArg )
+				continue;
+			if( ( ( *iUP ) ->Class() == class_uniform || ( *iUP ) ->Class() == class_constant )
+			        && pArg->Class() != class_varying )
+				( *shader ) ->SetArgument( ( *iUP ), this );
+			else
+				curvesGroupDiceParam( ( *iUP ), samples, pArg );
+		}
+	}
+
+	return ( pGrid );
+}
+
+
 /** \brief Calculate bounds for a set of cubic curves.
  *
  * The curves are bounded by finding the minimum and maximum coordinates of the
@@ -84,8 +84,9 @@ class CqCurve : public CqSurface
 		}
 		/** \brief Returns whether the curve is diceable
 		 *
-		 * At the moment, no Curves are directly diceable since they're
-		 * converted to patches just prior to rendering.
+		 * Curve segments are never directly diceable since they're
+		 * converted to patches just prior to rendering; groups of cubic
+		 * curves may be diced directly, see CqCubicCurvesGroup::Diceable().
 		 */
 		virtual bool Diceable(const CqMatrix& matCtoR);
 
@@ -110,6 +111,10 @@ class CqCurve : public CqSurface
 		/** Returns a normal to the curve. */
 		bool GetNormal( TqInt index, CqVector3D& normal ) const;
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Curve );
+		}
 		/** Returns a string name of the class. */
 		virtual CqString strName() const
 		{
@@ -444,6 +449,8 @@ class CqCubicCurvesGroup : public CqCurvesGroup
 		virtual	TqUint cVarying() const;
 		virtual TqInt Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
 		virtual	void Bound(CqBound* bound) const;
+		virtual bool Diceable(const CqMatrix& matCtoR);
+		virtual CqMicroPolyGridBase* Dice();
 		//---------------------------------------------- Inlined Public Methods
 	public:
 #ifdef _DEBUG
@@ -482,6 +489,12 @@ class CqCubicCurvesGroup : public CqCurvesGroup
 		 */
 		template<typename DataT, typename SLDataT>
 		CqParameter* convertToBezierBasis(CqParameter* param);
+		/** \brief Split the group into two groups of half the curves each.
+		 *
+		 * \param aSplits - destination for the new groups.
+		 * \return the number of groups created.
+		 */
+		TqInt SplitCurves( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
 
 		/// Total number of verts for vertex data after Bezier basis transform.
 		TqInt m_nVertsBezier;
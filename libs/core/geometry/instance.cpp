@@ -0,0 +1,183 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Implements the classes for retained objects defined with
+ * RiObjectBegin and instanced with RiObjectInstance.
+ */
+
+#include "instance.h"
+
+#include "renderer.h"
+
+namespace Aqsis {
+
+//---------------------------------------------------------------------
+/** Constructor.
+ */
+
+CqObjectPrototype::CqObjectPrototype( const CqAttributesPtr& pAttributes,
+                                      const CqTransformPtr& pTransform )
+	: m_aPrims(),
+	m_Bound(),
+	m_pAttributes( pAttributes ),
+	m_pTransform( pTransform )
+{}
+
+
+//---------------------------------------------------------------------
+/** Add a primitive to the object definition.
+ */
+
+void CqObjectPrototype::AddPrimitive( const boost::shared_ptr<CqSurface>& pSurface )
+{
+	CqBound bound;
+	pSurface->Bound( &bound );
+	m_Bound.Encapsulate( &bound );
+	m_aPrims.push_back( pSurface );
+}
+
+
+//---------------------------------------------------------------------
+/** Create the primitives for an instance of the object.
+ */
+
+void CqObjectPrototype::Instantiate( const CqAttributesPtr& pAttributes,
+                                     const CqTransformPtr& pTransform,
+                                     std::vector<boost::shared_ptr<CqSurface> >& aPrims ) const
+{
+	std::vector<boost::shared_ptr<CqSurface> >::const_iterator iPrim;
+	for ( iPrim = m_aPrims.begin(); iPrim != m_aPrims.end(); ++iPrim )
+	{
+		boost::shared_ptr<CqSurface> pPrim( ( *iPrim )->Clone() );
+		if ( !pPrim )
+		{
+			Aqsis::log() << warning << "Cannot instance primitive of type \""
+				<< ( *iPrim )->strName() << "\"" << std::endl;
+			continue;
+		}
+
+		// Attributes set inside the definition stay with the primitive,
+		// otherwise it picks up those of the instance.
+		CqAttributesPtr pPrimAttributes = pAttributes;
+		if ( ( *iPrim )->pAttributes() != m_pAttributes )
+			pPrimAttributes = boost::static_pointer_cast<CqAttributes>( ( *iPrim )->pAttributes() );
+
+		// Transformations inside the definition are relative to the
+		// transform of the instance.  Motion inside the definition isn't
+		// tracked; the shutter open position is used.
+		CqTransformPtr pPrimTransform = pTransform;
+		IqTransformPtr pDefTransform = ( *iPrim )->pTransform();
+		if ( pDefTransform != m_pTransform )
+		{
+			const CqMatrix& matLocal = pDefTransform->matObjectToWorld( pDefTransform->Time( 0 ) );
+			if ( !matLocal.fIdentity() )
+				pPrimTransform = CqTransformPtr( new CqTransform( pTransform,
+				                 QGetRenderContext()->Time(), matLocal,
+				                 CqTransform::ConcatCurrent() ) );
+		}
+
+		pPrim->SetInstanceParameters( pPrimAttributes, pPrimTransform );
+		aPrims.push_back( pPrim );
+	}
+}
+
+
+//---------------------------------------------------------------------
+/** Constructor.
+ */
+
+CqObjectInstance::CqObjectInstance( const boost::shared_ptr<const CqObjectPrototype>& pPrototype )
+	: CqSurface(),
+	m_pPrototype( pPrototype ),
+	m_matTx(),
+	m_matITTx(),
+	m_matRTx()
+{}
+
+
+//---------------------------------------------------------------------
+/** Destructor.
+ */
+
+CqObjectInstance::~CqObjectInstance()
+{}
+
+
+//---------------------------------------------------------------------
+/** Get the bound of the instance, the object bound in the current space.
+ */
+
+void CqObjectInstance::Bound( CqBound* bound ) const
+{
+	*bound = m_pPrototype->Bound();
+	bound->Transform( m_matTx );
+	AdjustBoundForTransformationMotion( bound );
+}
+
+
+//---------------------------------------------------------------------
+/** Post copies of the object primitives, transformed to camera space.
+ */
+
+TqInt CqObjectInstance::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
+{
+	std::vector<boost::shared_ptr<CqSurface> > aPrims;
+	m_pPrototype->Instantiate( boost::static_pointer_cast<CqAttributes>( pAttributes() ),
+	                           m_pTransform, aPrims );
+	std::vector<boost::shared_ptr<CqSurface> >::iterator iPrim;
+	for ( iPrim = aPrims.begin(); iPrim != aPrims.end(); ++iPrim )
+	{
+		( *iPrim )->Transform( m_matTx, m_matITTx, m_matRTx );
+		( *iPrim )->PrepareTrimCurve();
+		QGetRenderContext()->PostSurface( *iPrim );
+		STATS_INC( GPR_created );
+	}
+	return ( 0 );
+}
+
+
+//---------------------------------------------------------------------
+/** Accumulate the transformation, to be applied to the primitives on split.
+ */
+
+void CqObjectInstance::Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime )
+{
+	m_matTx = matTx * m_matTx;
+	m_matITTx = matITTx * m_matITTx;
+	m_matRTx = matRTx * m_matRTx;
+}
+
+
+//---------------------------------------------------------------------
+/** Clone the instance; the prototype remains shared.
+ */
+
+CqSurface* CqObjectInstance::Clone() const
+{
+	CqObjectInstance* clone = new CqObjectInstance( m_pPrototype );
+	CloneData( clone );
+	clone->m_matTx = m_matTx;
+	clone->m_matITTx = m_matITTx;
+	clone->m_matRTx = m_matRTx;
+	return ( clone );
+}
+
+} // namespace Aqsis
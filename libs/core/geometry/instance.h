@@ -0,0 +1,165 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Declares the classes for retained objects defined with
+ * RiObjectBegin and instanced with RiObjectInstance.
+ */
+
+#ifndef INSTANCE_H_INCLUDED
+#define INSTANCE_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/math/matrix.h>
+#include "surface.h"
+
+namespace Aqsis {
+
+//----------------------------------------------------------------------
+/** \brief The shared geometry of a retained object.
+ *
+ * The primitives between RiObjectBegin and RiObjectEnd are created once, in
+ * the coordinate system of the object, and stored here.  The prototype is
+ * never modified after the definition is complete; each instance takes a
+ * private copy of a primitive only when its bucket needs it.
+ */
+class CqObjectPrototype
+{
+	public:
+		/** Construct an empty prototype.
+		 *
+		 * \param pAttributes - attributes in effect at RiObjectBegin.
+		 * \param pTransform - transform in effect at RiObjectBegin.
+		 */
+		CqObjectPrototype( const CqAttributesPtr& pAttributes,
+		                   const CqTransformPtr& pTransform );
+
+		/** Add a primitive to the object definition.
+		 *
+		 * The primitive should already be transformed into the coordinate
+		 * system of the object.
+		 */
+		void	AddPrimitive( const boost::shared_ptr<CqSurface>& pSurface );
+
+		/** Create the primitives for an instance of the object.
+		 *
+		 * Each primitive is cloned from the prototype and given the
+		 * attributes and transform of the instance, unless these were changed
+		 * inside the object definition, in which case the definition takes
+		 * precedence.
+		 *
+		 * \param pAttributes - attributes of the instance.
+		 * \param pTransform - object to world transform of the instance.
+		 * \param aPrims - destination for the new primitives.
+		 */
+		void	Instantiate( const CqAttributesPtr& pAttributes,
+		                     const CqTransformPtr& pTransform,
+		                     std::vector<boost::shared_ptr<CqSurface> >& aPrims ) const;
+
+		/** Get the bound of the object in object space.
+		 */
+		const CqBound&	Bound() const
+		{
+			return ( m_Bound );
+		}
+		/** Determine whether the object contains no primitives.
+		 */
+		bool	isEmpty() const
+		{
+			return ( m_aPrims.empty() );
+		}
+
+	private:
+		std::vector<boost::shared_ptr<CqSurface> >	m_aPrims;	///< The primitives making up the object.
+		CqBound	m_Bound;					///< Bound of all the primitives.
+		CqAttributesPtr	m_pAttributes;		///< Attributes at the start of the definition.
+		CqTransformPtr	m_pTransform;		///< Transform at the start of the definition.
+};
+
+
+//----------------------------------------------------------------------
+/** \brief A single instance of a retained object.
+ *
+ * The instance holds only its transformation and attributes, plus a
+ * reference to the shared prototype.  Like a procedural, it is never diced;
+ * when split, it posts private copies of the prototype primitives,
+ * transformed by the instance transformation.
+ */
+class CqObjectInstance : public CqSurface
+{
+	public:
+		CqObjectInstance( const boost::shared_ptr<const CqObjectPrototype>& pPrototype );
+		virtual ~CqObjectInstance();
+
+		virtual	void	Bound( CqBound* bound ) const;
+		virtual	TqInt	Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
+		virtual void	Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime = 0 );
+
+		/*  We have no actual geometry to dice.
+		 */
+		virtual bool	Diceable( const CqMatrix& /*matCtoR*/ )
+		{
+			return ( false );
+		}
+		virtual CqMicroPolyGridBase* Dice()
+		{
+			return ( NULL );
+		}
+		virtual bool	IsMotionBlurMatch( CqSurface* pSurf )
+		{
+			return ( false );
+		}
+		virtual CqString strName() const
+		{
+			return ( "CqObjectInstance" );
+		}
+		virtual TqUint	cUniform() const
+		{
+			return ( 0 );
+		}
+		virtual TqUint	cVarying() const
+		{
+			return ( 0 );
+		}
+		virtual TqUint	cVertex() const
+		{
+			return ( 0 );
+		}
+		virtual TqUint	cFaceVarying() const
+		{
+			return ( 0 );
+		}
+		virtual CqSurface*	Clone() const;
+
+	private:
+		boost::shared_ptr<const CqObjectPrototype>	m_pPrototype;	///< The shared object definition.
+		CqMatrix	m_matTx;		///< Accumulated transformation for points.
+		CqMatrix	m_matITTx;		///< Accumulated transformation for normals.
+		CqMatrix	m_matRTx;		///< Accumulated transformation for vectors.
+};
+
+} // namespace Aqsis
+
+#endif // INSTANCE_H_INCLUDED
@@ -0,0 +1,147 @@
+// Aqsis
+// Copyright (C) 1997 - 2007, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Unit tests for object instancing
+ */
+
+#include "instance.h"
+
+#include <aqsis/ri/ri.h>
+#include "polygon.h"
+#include "renderer.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace Aqsis;
+
+BOOST_AUTO_TEST_CASE(CqObjectPrototype_instantiate_test)
+{
+	RiBegin(RI_NULL);
+	RiWorldBegin();
+	{
+		TqFloat time = QGetRenderContext()->Time();
+		// The first sphere takes the attributes and transform of each
+		// instance; the second has its own colour, and a translation
+		// relative to the instance.
+		RtObjectHandle object = RiObjectBegin();
+		boost::shared_ptr<CqObjectPrototype> pPrototype
+			= QGetRenderContext()->pObjectPrototype();
+		BOOST_REQUIRE(pPrototype);
+		RiSphere(1, -1, 1, 360, RI_NULL);
+		RtColor red = {1, 0, 0};
+		RiColor(red);
+		RiTranslate(0, 0, 5);
+		RiSphere(1, -1, 1, 360, RI_NULL);
+		RiObjectEnd();
+		BOOST_CHECK(!QGetRenderContext()->pObjectPrototype());
+		BOOST_CHECK_GE(pPrototype->Bound().vecMax().z(), 6);
+
+		// Instance the object inside a second object, so that the instance
+		// is retained rather than rendered.
+		RiObjectBegin();
+		boost::shared_ptr<CqObjectPrototype> pOuter
+			= QGetRenderContext()->pObjectPrototype();
+		RiTranslate(1, 0, 0);
+		RtColor green = {0, 1, 0};
+		RiColor(green);
+		RiObjectInstance(object);
+		CqAttributesPtr pAttributes = QGetRenderContext()->pattrCurrent();
+		RiObjectEnd();
+
+		// The instance bound is the object bound, placed by the instance
+		// transformation.
+		CqVector3D offset(1, 0, 0);
+		BOOST_CHECK(isClose(pOuter->Bound().vecMin(), pPrototype->Bound().vecMin() + offset));
+		BOOST_CHECK(isClose(pOuter->Bound().vecMax(), pPrototype->Bound().vecMax() + offset));
+
+		// Split the instance as the bucket does, by instantiating the object
+		// with the instance attributes and transform.
+		std::vector<boost::shared_ptr<CqSurface> > aInstances;
+		pOuter->Instantiate(QGetRenderContext()->pattrCurrent(),
+				QGetRenderContext()->ptransCurrent(), aInstances);
+		BOOST_REQUIRE_EQUAL(aInstances.size(), 1U);
+		BOOST_CHECK(aInstances[0]->pAttributes() == pAttributes);
+		CqMatrix matInstance = QGetRenderContext()->ptransCurrent()->matObjectToWorld(time)
+			* CqMatrix(offset);
+		CqTransformPtr pTransform = boost::static_pointer_cast<CqTransform>(
+				aInstances[0]->pTransform());
+		BOOST_CHECK(isClose(pTransform->matObjectToWorld(time), matInstance));
+
+		std::vector<boost::shared_ptr<CqSurface> > aPrims;
+		pPrototype->Instantiate(pAttributes, pTransform, aPrims);
+		BOOST_REQUIRE_EQUAL(aPrims.size(), 2U);
+
+		BOOST_CHECK(aPrims[0]->pAttributes() == pAttributes);
+		BOOST_CHECK(isClose(aPrims[0]->pTransform()->matObjectToWorld(time),
+					matInstance));
+
+		const CqColor* Cs = aPrims[1]->pAttributes()->GetColorAttribute("System", "Color");
+		BOOST_REQUIRE(Cs);
+		BOOST_CHECK_EQUAL(Cs[0], CqColor(1, 0, 0));
+		BOOST_CHECK(isClose(aPrims[1]->pTransform()->matObjectToWorld(time),
+					matInstance * CqMatrix(CqVector3D(0, 0, 5))));
+	}
+	RiWorldEnd();
+	RiEnd();
+}
+
+BOOST_AUTO_TEST_CASE(CqObjectPrototype_clone_polygon_test)
+{
+	RiBegin(RI_NULL);
+	RiWorldBegin();
+	{
+		// A single polygon of a mesh, which is cloned with a private copy of
+		// the mesh points.
+		boost::shared_ptr<CqPolygonPoints> pPoints(new CqPolygonPoints(3, 1, 3));
+		CqParameterTypedVertex<CqVector4D, type_hpoint, CqVector3D>* P
+			= new CqParameterTypedVertex<CqVector4D, type_hpoint, CqVector3D>("P", 1);
+		P->SetSize(3);
+		P->pValue(0)[0] = CqVector4D(0, 0, 0);
+		P->pValue(1)[0] = CqVector4D(1, 0, 0);
+		P->pValue(2)[0] = CqVector4D(0, 1, 0);
+		pPoints->AddPrimitiveVariable(P);
+		boost::shared_ptr<CqSurfacePointsPolygon> pPoly(
+				new CqSurfacePointsPolygon(pPoints, 0, 0));
+		for(TqInt i = 0; i < 3; ++i)
+			pPoly->aIndices().push_back(i);
+
+		CqObjectPrototype prototype(QGetRenderContext()->pattrCurrent(),
+				QGetRenderContext()->ptransCurrent());
+		prototype.AddPrimitive(pPoly);
+		std::vector<boost::shared_ptr<CqSurface> > aPrims;
+		prototype.Instantiate(QGetRenderContext()->pattrCurrent(),
+				QGetRenderContext()->ptransCurrent(), aPrims);
+		BOOST_REQUIRE_EQUAL(aPrims.size(), 1U);
+
+		// Transforming the clone leaves the prototype alone.
+		aPrims[0]->Transform(CqMatrix(CqVector3D(0, 0, 2)), CqMatrix(), CqMatrix());
+		CqBound bound;
+		aPrims[0]->Bound(&bound);
+		BOOST_CHECK(isClose(bound.vecMin(), CqVector3D(0, 0, 2)));
+		BOOST_CHECK(isClose(bound.vecMax(), CqVector3D(1, 1, 2)));
+		BOOST_CHECK(isClose(prototype.Bound().vecMax(), CqVector3D(1, 1, 0)));
+		pPoly->Bound(&bound);
+		BOOST_CHECK(isClose(bound.vecMax(), CqVector3D(1, 1, 0)));
+	}
+	RiWorldEnd();
+	RiEnd();
+}
@@ -29,8 +29,6 @@
 
 namespace Aqsis {
 
-CqObjectPool<CqLath>	CqLath::m_thePool;
-
 //------------------------------------------------------------------------------
 /**
  *	Get the lath counter clockwise about the facet.
@@ -28,7 +28,6 @@
 #define	LATH_H_LOADED
 
 #include	<aqsis/aqsis.h>
-#include	<aqsis/util/pool.h>
 #include	<vector>
 #include	<cstddef>
 
@@ -107,34 +106,24 @@ namespace Aqsis {
  * To manage parameters attached to the mesh, the lath keeps an index into the
  * parameter arrays for both data stored on vertices (class vertex/varying) and
  * per-face data stored on vertices (class facevertex/facevarying).
+ *
+ * Laths are not allocated individually; the owning topology creates them in
+ * contiguous blocks and releases the blocks together, so a lath must never be
+ * deleted on its own.
  */
 class CqLath
 {
 	public:
 		///	Constructor.
-		CqLath()	 : m_pClockwiseVertex(NULL), m_pClockwiseFacet(NULL),  m_pParentFacet(NULL), m_pChildVertex(NULL), m_pMidVertex(NULL), m_pFaceVertex(NULL), m_VertexIndex(0), m_FaceVertexIndex(0)
+		CqLath()	 : m_pClockwiseVertex(NULL), m_pClockwiseFacet(NULL),  m_pParentFacet(NULL), m_pChildVertex(NULL), m_pMidVertex(NULL), m_pFaceVertex(NULL), m_pNextVertexLath(NULL), m_VertexIndex(0), m_FaceVertexIndex(0)
 		{}
-		CqLath( TqInt iV, TqInt iFV ) : m_pClockwiseVertex(NULL), m_pClockwiseFacet(NULL),m_pParentFacet(NULL), m_pChildVertex(NULL), m_pMidVertex(NULL), m_pFaceVertex(NULL), m_VertexIndex( iV ), m_FaceVertexIndex( iFV )
+		CqLath( TqInt iV, TqInt iFV ) : m_pClockwiseVertex(NULL), m_pClockwiseFacet(NULL),m_pParentFacet(NULL), m_pChildVertex(NULL), m_pMidVertex(NULL), m_pFaceVertex(NULL), m_pNextVertexLath(NULL), m_VertexIndex( iV ), m_FaceVertexIndex( iFV )
 		{}
 
 		///	Destructor.
 		~CqLath()
 		{}
 
-		/** Overridden operator new to allocate micropolys from a pool.
-		 */
-		void* operator new( size_t size )
-		{
-			return( m_thePool.alloc() );
-		}
-
-		/** Overridden operator delete to allocate micropolys from a pool.
-		 */
-		void operator delete( void* p )
-		{
-			m_thePool.free( p );
-		}
-
 		/// Get a pointer to the lath representing the facet that this one was created from.
 		CqLath*	pParentFacet() const
 		{
@@ -155,6 +144,11 @@ class CqLath
 		{
 			return(m_pFaceVertex);
 		}
+		/// Get a pointer to the next lath in the list of those referencing the same vertex.
+		CqLath*	pNextVertexLath() const
+		{
+			return(m_pNextVertexLath);
+		}
 
 		/// Get the index of the vertex this lath references.
 		TqInt	VertexIndex() const
@@ -197,6 +191,11 @@ class CqLath
 		{
 			m_pFaceVertex=pLath;
 		}
+		/// Set the pointer to the next lath in the list of those referencing the same vertex.
+		void		SetpNextVertexLath(CqLath* pLath)
+		{
+			m_pNextVertexLath=pLath;
+		}
 
 		/// Set the index of the vertex this lath refers to.
 		void		SetVertexIndex(TqInt iV)
@@ -299,10 +298,103 @@ class CqLath
 		CqLath*	m_pMidVertex;		///< Pointer to the point that represents the midpoint of this edge at the next level.
 		CqLath*	m_pFaceVertex;		///< Pointer to the point that represents the midpoint of this face at the next level.
 
+		CqLath*	m_pNextVertexLath;	///< Next lath referencing the same vertex, used to build the topology.
+
 		TqInt	m_VertexIndex;
 		TqInt	m_FaceVertexIndex;
+};
 
-		static	CqObjectPool<CqLath>	m_thePool;
+
+//------------------------------------------------------------------------------
+/** \brief Iterate over the laths about a vertex without building a list.
+ *
+ * Visits the same laths in the same order as CqLath::Qvf(), or as
+ * CqLath::Qve() if the boundary edge is requested.  Neighbourhood queries are
+ * made for every new vertex during subdivision, so this avoids the heap
+ * traffic of filling a temporary array for each one.
+ *
+ * \code
+ * for(CqVertexLathIterator iE(pVertex, true); !iE.atEnd(); ++iE)
+ *     doSomething(*iE);
+ * \endcode
+ */
+class CqVertexLathIterator
+{
+	public:
+		/** \brief Start iterating about the vertex of pVertex.
+		 *
+		 * \param pVertex - lath referencing the vertex, visited first.
+		 * \param withBoundaryEdge - if the vertex is on a boundary, finish
+		 *                 with the far edge as CqLath::Qve() does; this lath
+		 *                 references a different vertex.
+		 */
+		CqVertexLathIterator(CqLath* pVertex, bool withBoundaryEdge = false)
+			: m_pStart(pVertex),
+			m_pCurrent(pVertex),
+			m_phase(Phase_Clockwise),
+			m_withBoundaryEdge(withBoundaryEdge)
+		{}
+
+		/// Determine whether all the laths have been visited.
+		bool atEnd() const
+		{
+			return(NULL == m_pCurrent);
+		}
+		/// Get the current lath.
+		CqLath* operator*() const
+		{
+			return(m_pCurrent);
+		}
+		/// Move to the next lath about the vertex.
+		CqVertexLathIterator& operator++()
+		{
+			if(m_phase == Phase_Clockwise)
+			{
+				CqLath* pNext = m_pCurrent->cv();
+				if(pNext == m_pStart)
+				{
+					m_pCurrent = NULL;
+					return(*this);
+				}
+				else if(NULL != pNext)
+				{
+					m_pCurrent = pNext;
+					return(*this);
+				}
+				// We hit a boundary, so start again going backwards.
+				m_phase = Phase_CounterClockwise;
+				m_pCurrent = m_pStart;
+			}
+			if(m_phase == Phase_CounterClockwise)
+			{
+				CqLath* pNext = m_pCurrent->ccv();
+				if(NULL != pNext)
+					m_pCurrent = pNext;
+				else if(m_withBoundaryEdge)
+				{
+					m_phase = Phase_BoundaryEdge;
+					m_pCurrent = m_pCurrent->cf();
+				}
+				else
+					m_pCurrent = NULL;
+			}
+			else
+				m_pCurrent = NULL;
+			return(*this);
+		}
+
+	private:
+		enum EqPhase
+		{
+			Phase_Clockwise,
+			Phase_CounterClockwise,
+			Phase_BoundaryEdge
+		};
+
+		CqLath*	m_pStart;			///< The lath the iteration began from.
+		CqLath*	m_pCurrent;			///< Current lath, NULL at the end.
+		EqPhase	m_phase;			///< Direction of travel about the vertex.
+		bool	m_withBoundaryEdge;	///< Whether to finish with the far boundary edge.
 };
 
 
@@ -187,11 +187,11 @@ TqUint CqSurfaceNURBS::FindSpanV( TqFloat v ) const
 /** Return the basis functions for the specified parameter value.
  */
 
-void CqSurfaceNURBS::BasisFunctions( TqFloat u, TqUint i, std::vector<TqFloat>& U, TqInt k, std::vector<TqFloat>& N )
+void CqSurfaceNURBS::BasisFunctions( TqFloat u, TqUint i, const std::vector<TqFloat>& U, TqInt k, TqFloat* N ) const
 {
 	register TqInt j, r;
 	register TqFloat saved, temp;
-	std::vector<TqFloat> left( k ), right( k );
+	CqBasisBuffer left( k ), right( k );
 
 	N[ 0 ] = 1.0f;
 	for ( j = 1; j <= k - 1; j++ )
@@ -212,26 +212,23 @@ void CqSurfaceNURBS::BasisFunctions( TqFloat u, TqUint i, std::vector<TqFloat>&
 
 
 //---------------------------------------------------------------------
-/** Return the basis functions for the specified parameter value.
+/** Return the basis functions and their derivatives for the specified
+ * parameter value.
+ * \param ders Receives n + 1 rows of k values, the basis functions followed
+ * by each of their derivatives in turn.
  */
 
-void CqSurfaceNURBS::DersBasisFunctions( TqFloat u, TqUint i, std::vector<TqFloat>& U, TqInt k, TqInt n, std::vector<std::vector<TqFloat> >& ders )
+void CqSurfaceNURBS::DersBasisFunctions( TqFloat u, TqUint i, const std::vector<TqFloat>& U, TqInt k, TqInt n, TqFloat* ders ) const
 {
 	register TqInt j, r;
 	register TqFloat saved, temp;
-	std::vector<TqFloat> left( k ), right( k );
-	std::vector<std::vector<TqFloat> > ndu( k ), a( 2 );
-	for ( j = 0; j < k; j++ )
-		ndu[ j ].resize( k );
-	ders.resize( n + 1 );
-	for ( j = 0; j < n + 1; j++ )
-		ders[ j ].resize( k );
-	a[ 0 ].resize( k );
-	a[ 1 ].resize( k );
+	CqBasisBuffer left( k ), right( k );
+	// ndu[ j ][ r ] is at ndu[ j * k + r ], and a[ s ][ j ] at a[ s * k + j ].
+	CqBasisBuffer ndu( k * k ), a( 2 * k );
 
 	TqInt p = k - 1;
 
-	ndu[ 0 ][ 0 ] = 1.0f;
+	ndu[ 0 ] = 1.0f;
 	for ( j = 1; j <= p; j++ )
 	{
 		left[ j ] = u - U[ i + 1 - j ];
@@ -239,60 +236,61 @@ void CqSurfaceNURBS::DersBasisFunctions( TqFloat u, TqUint i, std::vector<TqFloa
 		saved = 0.0f;
 		for ( r = 0; r < j; r++ )
 		{
-			ndu[ j ][ r ] = right[ r + 1 ] + left[ j - r ];
-			temp = ndu[ r ][ j - 1 ] / ndu[ j ][ r ];
+			ndu[ j * k + r ] = right[ r + 1 ] + left[ j - r ];
+			temp = ndu[ r * k + j - 1 ] / ndu[ j * k + r ];
 
-			ndu[ r ][ j ] = saved + right[ r + 1 ] * temp;
+			ndu[ r * k + j ] = saved + right[ r + 1 ] * temp;
 			saved = left[ j - r ] * temp;
 		}
-		ndu[ j ][ j ] = saved;
+		ndu[ j * k + j ] = saved;
 	}
 
 	// Load the basis functions
 	for ( j = 0; j <= p; j++ )
-		ders[ 0 ][ j ] = ndu[ j ][ p ];
+		ders[ j ] = ndu[ j * k + p ];
 
 	// Compute the derivatives.
+	TqInt d;
 	for ( r = 0; r <= p; r ++ )
 	{
 		// Alternate rows in array a.
 		TqInt s1 = 0;
-		TqInt s2 = 1;
-		a[ 0 ][ 0 ] = 1.0f;
+		TqInt s2 = k;
+		a[ 0 ] = 1.0f;
 		TqInt j1, j2;
 
-		// Loop to compute the kth derivative
-		for ( k = 1; k <= n; k++ )
+		// Loop to compute the dth derivative
+		for ( d = 1; d <= n; d++ )
 		{
-			TqFloat d = 0.0f;
-			TqInt rk = r - k;
-			TqInt pk = p - k;
-			if ( r >= k )
+			TqFloat der = 0.0f;
+			TqInt rd = r - d;
+			TqInt pd = p - d;
+			if ( r >= d )
 			{
-				a[ s2 ][ 0 ] = a[ s1 ][ 0 ] / ndu[ pk + 1 ][ rk ];
-				d = a[ s2 ][ 0 ] * ndu[ rk ][ pk ];
+				a[ s2 ] = a[ s1 ] / ndu[ ( pd + 1 ) * k + rd ];
+				der = a[ s2 ] * ndu[ rd * k + pd ];
 			}
-			if ( rk >= -1 )
+			if ( rd >= -1 )
 				j1 = 1;
 			else
-				j1 = -rk;
+				j1 = -rd;
 
-			if ( r - 1 <= pk )
-				j2 = k - 1;
+			if ( r - 1 <= pd )
+				j2 = d - 1;
 			else
 				j2 = p - r;
 
 			for ( j = j1; j <= j2; j++ )
 			{
-				a[ s2 ][ j ] = ( a[ s1 ][ j ] - a[ s1 ][ j - 1 ] ) / ndu[ pk + 1 ][ rk + j ];
-				d += a[ s2 ][ j ] * ndu[ rk + j ][ pk ];
+				a[ s2 + j ] = ( a[ s1 + j ] - a[ s1 + j - 1 ] ) / ndu[ ( pd + 1 ) * k + rd + j ];
+				der += a[ s2 + j ] * ndu[ ( rd + j ) * k + pd ];
 			}
-			if ( r <= pk )
+			if ( r <= pd )
 			{
-				a[ s2 ][ k ] = -a[ s1 ][ k - 1 ] / ndu[ pk + 1 ][ r ];
-				d += a[ s2 ][ k ] * ndu[ r ][ pk ];
+				a[ s2 + d ] = -a[ s1 + d - 1 ] / ndu[ ( pd + 1 ) * k + r ];
+				der += a[ s2 + d ] * ndu[ r * k + pd ];
 			}
-			ders[ k ][ r ] = d;
+			ders[ d * k + r ] = der;
 
 			// Switch rows.
 			j = s1;
@@ -302,11 +300,11 @@ void CqSurfaceNURBS::DersBasisFunctions( TqFloat u, TqUint i, std::vector<TqFloa
 	}
 	// Multiply through the correct factors.
 	r = p;
-	for ( k = 1; k <= n; k++ )
+	for ( d = 1; d <= n; d++ )
 	{
 		for ( j = 0; j <= p; j++ )
-			ders[ k ][ j ] *= r;
-		r *= ( p - k );
+			ders[ d * k + j ] *= r;
+		r *= ( p - d );
 	}
 }
 
@@ -320,16 +318,13 @@ void CqSurfaceNURBS::DersBasisFunctions( TqFloat u, TqUint i, std::vector<TqFloa
 CqVector4D	CqSurfaceNURBS::EvaluateWithNormal( TqFloat u, TqFloat v, CqVector4D& P )
 {
 	CqVector4D N;
-	TqInt d = 1;	// Default to 1st order derivatives.
+	const TqInt d = 1;	// Default to 1st order derivatives.
 	TqInt k, l, s, r;
 	TqInt p = uDegree();
 	TqInt q = vDegree();
 
-	std::vector<std::vector<CqVector4D> > SKL( d + 1 );
-	for ( k = 0; k <= d; k++ )
-		SKL[ k ].resize( d + 1 );
-	std::vector<std::vector<TqFloat> > Nu, Nv;
-	std::vector<CqVector4D> temp( q + 1 );
+	CqVector4D SKL[ d + 1 ][ d + 1 ];
+	CqBasisBuffer Nu( ( d + 1 ) * m_uOrder ), Nv( ( d + 1 ) * m_vOrder );
 
 	TqInt du = min( d, p );
 	for ( k = p + 1; k <= d; k++ )
@@ -348,18 +343,18 @@ CqVector4D	CqSurfaceNURBS::EvaluateWithNormal( TqFloat u, TqFloat v, CqVector4D&
 
 	for ( k = 0; k <= du; k++ )
 	{
-		for ( s = 0; s <= q; s++ )
-		{
-			temp[ s ] = CqVector4D( 0.0f, 0.0f, 0.0f, 1.0f );
-			for ( r = 0; r <= p; r++ )
-				temp[ s ] = temp[ s ] + Nu[ k ][ r ] * CP( uspan - p + r, vspan - q + s );
-		}
 		TqInt dd = min( d - k, dv );
 		for ( l = 0; l <= dd; l++ )
-		{
 			SKL[ k ][ l ] = CqVector4D( 0.0f, 0.0f, 0.0f, 1.0f );
-			for ( s = 0; s <= q; s++ )
-				SKL[ k ][ l ] = SKL[ k ][ l ] + Nv[ l ][ s ] * temp[ s ];
+		// Each row of control points is blended in u, then accumulated into
+		// the v derivatives straight away.
+		for ( s = 0; s <= q; s++ )
+		{
+			CqVector4D temp( 0.0f, 0.0f, 0.0f, 1.0f );
+			for ( r = 0; r <= p; r++ )
+				temp = temp + Nu[ k * m_uOrder + r ] * CP( uspan - p + r, vspan - q + s );
+			for ( l = 0; l <= dd; l++ )
+				SKL[ k ][ l ] = SKL[ k ][ l ] + Nv[ l * m_vOrder + s ] * temp;
 		}
 	}
 	N = SKL[ 1 ][ 0 ] % SKL[ 0 ][ 1 ];
@@ -371,6 +366,45 @@ CqVector4D	CqSurfaceNURBS::EvaluateWithNormal( TqFloat u, TqFloat v, CqVector4D&
 }
 
 
+//---------------------------------------------------------------------
+/** Cache the knot spans and basis values for each vertex of the grid
+ * about to be diced, so that each vertex parameter only has to blend the
+ * control points.  The cache is kept until the dice sizes or the knot
+ * vectors change.
+ */
+
+void CqSurfaceNURBS::CacheBasisRows( TqInt uDiceSize, TqInt vDiceSize )
+{
+	CacheBasisRow( m_uBasisRow, uDiceSize, m_auKnots, m_cuVerts, m_uOrder, true );
+	CacheBasisRow( m_vBasisRow, vDiceSize, m_avKnots, m_cvVerts, m_vOrder, false );
+}
+
+
+//---------------------------------------------------------------------
+/** Fill in the basis values at diceSize + 1 evenly spaced parameter values
+ * in one direction.
+ */
+
+void CqSurfaceNURBS::CacheBasisRow( SqBasisRow& row, TqInt diceSize, const std::vector<TqFloat>& aKnots, TqUint cVerts, TqUint order, bool uDir ) const
+{
+	if ( row.diceSize == diceSize )
+		return;
+
+	row.spans.resize( diceSize + 1 );
+	row.basis.resize( ( diceSize + 1 ) * order );
+	TqInt i;
+	for ( i = 0; i <= diceSize; i++ )
+	{
+		TqFloat s = ( static_cast<TqFloat>( i ) / static_cast<TqFloat>( diceSize ) )
+		            * ( aKnots[ cVerts ] - aKnots[ order - 1 ] )
+		            + aKnots[ order - 1 ];
+		row.spans[ i ] = ( uDir ) ? FindSpanU( s ) : FindSpanV( s );
+		BasisFunctions( s, row.spans[ i ], aKnots, order, &row.basis[ i * order ] );
+	}
+	row.diceSize = diceSize;
+}
+
+
 //---------------------------------------------------------------------
 /** Insert the specified knot into the U knot vector, and refine the control points accordingly.
  * \return The number of new knots created.
@@ -427,8 +461,8 @@ TqUint CqSurfaceNURBS::InsertKnotU( TqFloat u, TqInt r )
 	m_cuVerts += r;
 	m_auKnots.reserve( m_cuVerts + m_uOrder );
 	// Insert r new knots.
-	std::vector<TqFloat> newKnots(r, u);
-	m_auKnots.insert(m_auKnots.begin()+(k+1), newKnots.begin(), newKnots.end());
+	m_auKnots.insert(m_auKnots.begin()+(k+1), r, u);
+	InvalidateBasisRows();
 
 	// Now process all the 'vertex' class variables.
 	std::vector<CqParameter*>::iterator iUP;
@@ -437,7 +471,11 @@ TqUint CqSurfaceNURBS::InsertKnotU( TqFloat u, TqInt r )
 	{
 		if ( ( *iUP ) ->Class() == class_vertex )
 		{
-			CqParameter * pHold = ( *iUP ) ->Clone();
+			// Every new control point is written before it's read, so the
+			// refined values go into fresh storage, and the old storage is
+			// kept for reading rather than copied.
+			CqParameter * pHold = ( *iUP );
+			( *iUP ) = pHold ->CloneType( pHold ->strName().c_str(), pHold ->Count() );
 			( *iUP ) ->SetSize( m_cuVerts * m_cvVerts );
 
 			// Save unaltered control points
@@ -607,8 +645,8 @@ TqUint CqSurfaceNURBS::InsertKnotV( TqFloat v, TqInt r )
 	m_cvVerts += r;
 	m_avKnots.reserve( m_cvVerts + m_vOrder );
 	// Insert r new knots
-	std::vector<TqFloat> newKnots(r, v);
-	m_avKnots.insert(m_avKnots.begin()+(k+1), newKnots.begin(), newKnots.end());
+	m_avKnots.insert(m_avKnots.begin()+(k+1), r, v);
+	InvalidateBasisRows();
 
 	// Now process all the 'vertex' class variables.
 	std::vector<CqParameter*>::iterator iUP;
@@ -617,7 +655,11 @@ TqUint CqSurfaceNURBS::InsertKnotV( TqFloat v, TqInt r )
 	{
 		if ( ( *iUP ) ->Class() == class_vertex )
 		{
-			CqParameter * pHold = ( *iUP ) ->Clone();
+			// Every new control point is written before it's read, so the
+			// refined values go into fresh storage, and the old storage is
+			// kept for reading rather than copied.
+			CqParameter * pHold = ( *iUP );
+			( *iUP ) = pHold ->CloneType( pHold ->strName().c_str(), pHold ->Count() );
 			( *iUP ) ->SetSize( m_cuVerts * m_cvVerts );
 
 			// Save unaltered control points
@@ -763,6 +805,7 @@ void CqSurfaceNURBS::RefineKnotU( const std::vector<TqFloat>& X )
 	m_cuVerts = r + 1 + n + 1;
 	std::vector<TqFloat>	auHold( m_auKnots );
 	m_auKnots.resize( m_cuVerts + m_uOrder );
+	InvalidateBasisRows();
 
 	// Copy the knot values up to the first insertion point.
 	for ( j = 0; j <= a; j++ )
@@ -793,7 +836,11 @@ void CqSurfaceNURBS::RefineKnotU( const std::vector<TqFloat>& X )
 			i = b + p - 1;
 			k = b + p + r;
 
-			CqParameter* pHold = ( *iUP ) ->Clone();
+			// Every new control point is written before it's read, so the
+			// refined values go into fresh storage, and the old storage is
+			// kept for reading rather than copied.
+			CqParameter * pHold = ( *iUP );
+			( *iUP ) = pHold ->CloneType( pHold ->strName().c_str(), pHold ->Count() );
 			( *iUP ) ->SetSize( m_cuVerts * m_cvVerts );
 
 			// Copy the control points from the original
@@ -946,6 +993,7 @@ void CqSurfaceNURBS::RefineKnotV( const std::vector<TqFloat>& X )
 	m_cvVerts = r + 1 + n + 1;
 	std::vector<TqFloat>	avHold( m_avKnots );
 	m_avKnots.resize( m_cvVerts + m_vOrder );
+	InvalidateBasisRows();
 
 	for ( j = 0; j <= a; j++ )
 		m_avKnots[ j ] = avHold[ j ];
@@ -973,7 +1021,11 @@ void CqSurfaceNURBS::RefineKnotV( const std::vector<TqFloat>& X )
 			i = b + p - 1;
 			k = b + p + r;
 
-			CqParameter* pHold = ( *iUP ) ->Clone();
+			// Every new control point is written before it's read, so the
+			// refined values go into fresh storage, and the old storage is
+			// kept for reading rather than copied.
+			CqParameter * pHold = ( *iUP );
+			( *iUP ) = pHold ->CloneType( pHold ->strName().c_str(), pHold ->Count() );
 			( *iUP ) ->SetSize( m_cuVerts * m_cvVerts );
 
 			for ( col = 0; col < static_cast<TqInt>( m_cuVerts ); col++ )
@@ -1109,12 +1161,9 @@ void CqSurfaceNURBS::ClampU()
 	// Now trim unnecessary knots and control points
 	if ( n1 || n2 )
 	{
-		std::vector<TqFloat> auHold( m_auKnots );
-		m_auKnots.resize( m_auKnots.size() - n1 - n2 );
-
-		TqUint i;
-		for ( i = n1; i < auHold.size() - n2; i++ )
-			m_auKnots[ i - n1 ] = auHold[ i ];
+		m_auKnots.erase( m_auKnots.end() - n2, m_auKnots.end() );
+		m_auKnots.erase( m_auKnots.begin(), m_auKnots.begin() + n1 );
+		InvalidateBasisRows();
 
 		TqInt n = m_cuVerts;
 		m_cuVerts -= n1 + n2;
@@ -1126,17 +1175,16 @@ void CqSurfaceNURBS::ClampU()
 		{
 			if ( ( *iUP ) ->Class() == class_vertex )
 			{
-				CqParameter * pHold = ( *iUP ) ->Clone();
-				( *iUP ) ->SetSize( ( m_cuVerts ) * m_cvVerts );
-
+				// Each control point moves towards the start of the array,
+				// so the surviving ones can be packed in place.
 				TqUint row;
 				for ( row = 0; row < m_cvVerts; row++ )
 				{
 					TqUint i;
 					for ( i = n1; i < n - n2; i++ )
-						( *iUP ) ->SetValue( pHold, ( row * m_cuVerts ) + i - n1, ( row * n ) + i );
+						( *iUP ) ->SetValue( ( *iUP ), ( row * m_cuVerts ) + i - n1, ( row * n ) + i );
 				}
-				delete( pHold );
+				( *iUP ) ->SetSize( ( m_cuVerts ) * m_cvVerts );
 			}
 		}
 	}
@@ -1158,12 +1206,9 @@ void CqSurfaceNURBS::ClampV()
 	// Now trim unnecessary knots and control points
 	if ( n1 || n2 )
 	{
-		std::vector<TqFloat> avHold( m_avKnots );
-		m_avKnots.resize( m_avKnots.size() - n1 - n2 );
-
-		TqUint i;
-		for ( i = n1; i < avHold.size() - n2; i++ )
-			m_avKnots[ i - n1 ] = avHold[ i ];
+		m_avKnots.erase( m_avKnots.end() - n2, m_avKnots.end() );
+		m_avKnots.erase( m_avKnots.begin(), m_avKnots.begin() + n1 );
+		InvalidateBasisRows();
 
 		TqInt n = m_cvVerts;
 		m_cvVerts -= n1 + n2;
@@ -1175,17 +1220,16 @@ void CqSurfaceNURBS::ClampV()
 		{
 			if ( ( *iUP ) ->Class() == class_vertex )
 			{
-				CqParameter * pHold = ( *iUP ) ->Clone();
-				( *iUP ) ->SetSize( ( m_cvVerts ) * m_cuVerts );
-
+				// Each control point moves towards the start of the array,
+				// so the surviving ones can be packed in place.
 				TqUint col;
 				for ( col = 0; col < m_cuVerts; col++ )
 				{
 					TqUint i;
 					for ( i = n1; i < n - n2; i++ )
-						( *iUP ) ->SetValue( pHold, ( ( i - n1 ) * m_cuVerts ) + col, ( i * m_cuVerts ) + col );
+						( *iUP ) ->SetValue( ( *iUP ), ( ( i - n1 ) * m_cuVerts ) + col, ( i * m_cuVerts ) + col );
 				}
-				delete( pHold );
+				( *iUP ) ->SetSize( ( m_cvVerts ) * m_cuVerts );
 			}
 		}
 	}
@@ -1375,6 +1419,29 @@ void CqSurfaceNURBS::Bound(CqBound* bound) const
 }
 
 
+//---------------------------------------------------------------------
+/** Dice a vertex parameter over the grid, from the cached basis values.
+ */
+
+template <class T, class SLT>
+void CqSurfaceNURBS::DiceVertexParameter( CqParameterTyped<T, SLT>* pParam, TqInt uDiceSize, TqInt vDiceSize, IqShaderData* pData ) const
+{
+	TqInt i;
+	for ( i = 0; i < pParam->Count(); i++ )
+	{
+		IqShaderData* arrayValue = pData->ArrayEntry( i );
+		TqInt igrid = 0;
+		TqInt iv;
+		for ( iv = 0; iv <= vDiceSize; iv++ )
+		{
+			TqInt iu;
+			for ( iu = 0; iu <= uDiceSize; iu++ )
+				arrayValue->SetValue( EvaluateCached( iu, iv, pParam, i ), igrid++ );
+		}
+	}
+}
+
+
 //---------------------------------------------------------------------
 /** Dice the patch into a mesh of micropolygons.
  */
@@ -1382,123 +1449,62 @@ void CqSurfaceNURBS::Bound(CqBound* bound) const
 void CqSurfaceNURBS::NaturalDice( CqParameter* pParameter, TqInt uDiceSize, TqInt vDiceSize, IqShaderData* pData )
 {
 	assert(pParameter->Count() == pData->ArrayLength());
-	CqVector4D vec1;
-	TqInt iv;
-	for ( iv = 0; iv <= vDiceSize; iv++ )
-	{
-		TqFloat sv = ( static_cast<TqFloat>( iv ) / static_cast<TqFloat>( vDiceSize ) )
-		             * ( m_avKnots[ m_cvVerts ] - m_avKnots[ m_vOrder - 1 ] )
-		             + m_avKnots[ m_vOrder - 1 ];
-		TqInt iu;
-		for ( iu = 0; iu <= uDiceSize; iu++ )
-		{
-			TqInt igrid = ( iv * ( uDiceSize + 1 ) ) + iu;
-			TqFloat su = ( static_cast<TqFloat>( iu ) / static_cast<TqFloat>( uDiceSize ) )
-			             * ( m_auKnots[ m_cuVerts ] - m_auKnots[ m_uOrder - 1 ] )
-			             + m_auKnots[ m_uOrder - 1 ];
 
-			switch ( pParameter->Type() )
-			{
-					case type_float:
-					{
-						CqParameterTyped<TqFloat, TqFloat>* pTParam = static_cast<CqParameterTyped<TqFloat, TqFloat>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue( Evaluate(su, sv, pTParam, i), igrid);
-						}
-						break;
-					}
+	// The basis values are shared by all the parameters of the grid.
+	CacheBasisRows( uDiceSize, vDiceSize );
 
-					case type_integer:
-					{
-						CqParameterTyped<TqInt, TqFloat>* pTParam = static_cast<CqParameterTyped<TqInt, TqFloat>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue( Evaluate(su, sv, pTParam, i), igrid);
-						}
-						break;
-					}
+	switch ( pParameter->Type() )
+	{
+			case type_float:
+			DiceVertexParameter( static_cast<CqParameterTyped<TqFloat, TqFloat>*>( pParameter ), uDiceSize, vDiceSize, pData );
+			break;
 
-					case type_point:
-					case type_normal:
-					case type_vector:
-					{
-						CqParameterTyped<CqVector3D, CqVector3D>* pTParam = static_cast<CqParameterTyped<CqVector3D, CqVector3D>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue( Evaluate(su, sv, pTParam, i), igrid);
-						}
-						break;
-					}
+			case type_integer:
+			DiceVertexParameter( static_cast<CqParameterTyped<TqInt, TqFloat>*>( pParameter ), uDiceSize, vDiceSize, pData );
+			break;
 
-					case type_hpoint:
-					{
-						CqParameterTyped<CqVector4D, CqVector3D>* pTParam = static_cast<CqParameterTyped<CqVector4D, CqVector3D>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue(vectorCast<CqVector3D>(Evaluate(su, sv, pTParam)), igrid);
-						}
-						break;
-					}
+			case type_point:
+			case type_normal:
+			case type_vector:
+			DiceVertexParameter( static_cast<CqParameterTyped<CqVector3D, CqVector3D>*>( pParameter ), uDiceSize, vDiceSize, pData );
+			break;
 
-					case type_color:
+			case type_hpoint:
+			{
+				CqParameterTyped<CqVector4D, CqVector3D>* pTParam = static_cast<CqParameterTyped<CqVector4D, CqVector3D>*>( pParameter );
+				TqInt i;
+				for ( i = 0; i < pParameter->Count(); i++ )
+				{
+					IqShaderData* arrayValue = pData->ArrayEntry( i );
+					TqInt igrid = 0;
+					TqInt iv;
+					for ( iv = 0; iv <= vDiceSize; iv++ )
 					{
-						CqParameterTyped<CqColor, CqColor>* pTParam = static_cast<CqParameterTyped<CqColor, CqColor>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue( Evaluate(su, sv, pTParam, i), igrid);
-						}
-						break;
+						TqInt iu;
+						for ( iu = 0; iu <= uDiceSize; iu++ )
+							arrayValue->SetValue( vectorCast<CqVector3D>( EvaluateCached( iu, iv, pTParam ) ), igrid++ );
 					}
+				}
+				break;
+			}
 
-					case type_string:
-					{
-						CqParameterTyped<CqString, CqString>* pTParam = static_cast<CqParameterTyped<CqString, CqString>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue( Evaluate(su, sv, pTParam, i), igrid);
-						}
-						break;
-					}
+			case type_color:
+			DiceVertexParameter( static_cast<CqParameterTyped<CqColor, CqColor>*>( pParameter ), uDiceSize, vDiceSize, pData );
+			break;
 
-					case type_matrix:
-					{
-						CqParameterTyped<CqMatrix, CqMatrix>* pTParam = static_cast<CqParameterTyped<CqMatrix, CqMatrix>*>( pParameter );
-						IqShaderData* arrayValue;
-						TqInt i;
-						for(i = 0; i<pParameter->Count(); i++)
-						{
-							arrayValue = pData->ArrayEntry(i);
-							arrayValue->SetValue( Evaluate(su, sv, pTParam, i), igrid);
-						}
-						break;
-					}
+			case type_string:
+			DiceVertexParameter( static_cast<CqParameterTyped<CqString, CqString>*>( pParameter ), uDiceSize, vDiceSize, pData );
+			break;
 
-					default:
-					{
-						// left blank to avoid compiler warnings about unhandled types
-						break;
-					}
+			case type_matrix:
+			DiceVertexParameter( static_cast<CqParameterTyped<CqMatrix, CqMatrix>*>( pParameter ), uDiceSize, vDiceSize, pData );
+			break;
+
+			default:
+			{
+				// left blank to avoid compiler warnings about unhandled types
+				break;
 			}
-		}
 	}
 }
 
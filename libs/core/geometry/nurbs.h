@@ -39,6 +39,39 @@
 
 namespace Aqsis {
 
+//----------------------------------------------------------------------
+/** \class CqBasisBuffer
+ * Scratch storage for NURBS basis function values.  This lives on the stack
+ * for the orders met in practice, and is only allocated for higher ones.
+ */
+
+class CqBasisBuffer
+{
+	public:
+		CqBasisBuffer( TqInt size ) : m_heap(), m_values( m_local )
+		{
+			if ( size > LocalSize )
+			{
+				m_heap.resize( size );
+				m_values = &m_heap[ 0 ];
+			}
+		}
+		operator TqFloat*()
+		{
+			return ( m_values );
+		}
+
+	private:
+		CqBasisBuffer( const CqBasisBuffer& );
+		CqBasisBuffer& operator=( const CqBasisBuffer& );
+
+		enum { LocalSize = 64 };
+		TqFloat	m_local[ LocalSize ];
+		std::vector<TqFloat>	m_heap;
+		TqFloat*	m_values;
+};
+
+
 //----------------------------------------------------------------------
 /** \class CqSurfaceNURBS
  * RenderMan NURBS surface.
@@ -232,17 +265,18 @@ class CqSurfaceNURBS : public CqSurface
 			m_vOrder = vOrder;
 			m_cuVerts = cuVerts;
 			m_cvVerts = cvVerts;
+			InvalidateBasisRows();
 		}
 		TqUint	FindSpanU( TqFloat u ) const;
 		TqUint	FindSpanV( TqFloat v ) const;
-		void	BasisFunctions( TqFloat u, TqUint span, std::vector<TqFloat>& aKnots, TqInt k, std::vector<TqFloat>& BasisVals );
-		void	DersBasisFunctions( TqFloat u, TqUint i, std::vector<TqFloat>& U, TqInt k, TqInt n, std::vector<std::vector<TqFloat> >& ders );
+		void	BasisFunctions( TqFloat u, TqUint span, const std::vector<TqFloat>& aKnots, TqInt k, TqFloat* BasisVals ) const;
+		void	DersBasisFunctions( TqFloat u, TqUint i, const std::vector<TqFloat>& U, TqInt k, TqInt n, TqFloat* ders ) const;
 
 		template <class T, class SLT>
 		T	Evaluate( TqFloat u, TqFloat v, CqParameterTyped<T, SLT>* pParam, TqInt arrayIndex = 0 )
 		{
-			std::vector<TqFloat> Nu( m_uOrder );
-			std::vector<TqFloat> Nv( m_vOrder );
+			CqBasisBuffer Nu( m_uOrder );
+			CqBasisBuffer Nv( m_vOrder );
 
 			/* Evaluate non-uniform basis functions (and derivatives) */
 
@@ -265,6 +299,41 @@ class CqSurfaceNURBS : public CqSurface
 			return ( S );
 		}
 
+		/** Evaluate a vertex parameter at a vertex of the grid being diced,
+		 * from the basis values cached by CacheBasisRows().
+		 * \param iu Index of the grid vertex in the u direction.
+		 * \param iv Index of the grid vertex in the v direction.
+		 */
+		template <class T, class SLT>
+		T	EvaluateCached( TqInt iu, TqInt iv, CqParameterTyped<T, SLT>* pParam, TqInt arrayIndex = 0 ) const
+		{
+			const TqFloat* Nu = &m_uBasisRow.basis[ iu * m_uOrder ];
+			const TqFloat* Nv = &m_vBasisRow.basis[ iv * m_vOrder ];
+			TqUint uind = m_uBasisRow.spans[ iu ] - uDegree();
+			TqUint vind = m_vBasisRow.spans[ iv ] - vDegree();
+
+			T S = T();
+			TqUint l, k;
+			for ( l = 0; l <= vDegree(); l++ )
+			{
+				T temp = T();
+				TqUint rowoff = ( ( vind + l ) * m_cuVerts ) + uind;
+				for ( k = 0; k <= uDegree(); k++ )
+					temp = static_cast<T>( temp + Nu[ k ] * ( pParam->pValue( rowoff + k )[arrayIndex] ) );
+				S = static_cast<T>( S + Nv[ l ] * temp );
+			}
+			return ( S );
+		}
+
+		void	CacheBasisRows( TqInt uDiceSize, TqInt vDiceSize );
+		/** Discard the cached basis values, after the knot vectors change.
+		 */
+		void	InvalidateBasisRows()
+		{
+			m_uBasisRow.diceSize = -1;
+			m_vBasisRow.diceSize = -1;
+		}
+
 		CqVector4D	EvaluateWithNormal( TqFloat u, TqFloat v, CqVector4D& P );
 		void	SplitNURBS( CqSurfaceNURBS& nrbA, CqSurfaceNURBS& nrbB, bool dirflag );
 		void	SubdivideSegments( std::vector<boost::shared_ptr<CqSurfaceNURBS> >& Array );
@@ -314,6 +383,10 @@ class CqSurfaceNURBS : public CqSurface
 
 		virtual	void	SetDefaultPrimitiveVariables( bool bUseDef_st = true );
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_NURBS );
+		}
 		/** Get the number of uniform variables for a NURBS surface.
 		 */
 		virtual	TqUint cUniform() const
@@ -364,6 +437,22 @@ class CqSurfaceNURBS : public CqSurface
 
 
 	protected:
+		/** \brief Basis values at each vertex of a row of the diced grid, in
+		 * one parametric direction.
+		 */
+		struct SqBasisRow
+		{
+			SqBasisRow() : diceSize( -1 )
+			{}
+			TqInt	diceSize;				///< Number of intervals along the row, -1 if not cached.
+			std::vector<TqUint>	spans;		///< Knot span containing each vertex.
+			std::vector<TqFloat>	basis;	///< The order non-zero basis values at each vertex.
+		};
+
+		void	CacheBasisRow( SqBasisRow& row, TqInt diceSize, const std::vector<TqFloat>& aKnots, TqUint cVerts, TqUint order, bool uDir ) const;
+		template <class T, class SLT>
+		void	DiceVertexParameter( CqParameterTyped<T, SLT>* pParam, TqInt uDiceSize, TqInt vDiceSize, IqShaderData* pData ) const;
+
 		std::vector<TqFloat>	m_auKnots;	///< Knot vector for the u direction.
 		std::vector<TqFloat>	m_avKnots;	///< Knot vector for the v direction.
 		TqUint	m_uOrder;	///< Surface order in the u direction.
@@ -376,6 +465,8 @@ class CqSurfaceNURBS : public CqSurface
 		TqFloat m_vmax;		///< Maximum value of v over surface.
 		CqTrimLoopArray	m_TrimLoops;	///< Local trim curves, prepared for this surface.
 		bool	m_fPatchMesh;	///< Flag indicating this is an unsubdivided mesh.
+		SqBasisRow	m_uBasisRow;	///< Cached u basis values for the grid being diced.
+		SqBasisRow	m_vBasisRow;	///< Cached v basis values for the grid being diced.
 }
 ;
 
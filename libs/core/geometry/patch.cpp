@@ -242,8 +242,186 @@ void bicubicPatchNatDice(TqFloat uSize, TqFloat vSize, CqParameter* pParam,
 	}
 }
 
+/** \brief Get the control points of the derivative of a cubic Bezier curve,
+ * raised to a cubic so that it can be forward differenced with the curve.
+ */
+inline void bezierDerivative( TqFloat A, TqFloat B, TqFloat C, TqFloat D, TqFloat dA[4] )
+{
+	TqFloat q0 = 3 * ( B - A );
+	TqFloat q1 = 3 * ( C - B );
+	TqFloat q2 = 3 * ( D - C );
+	dA[ 0 ] = q0;
+	dA[ 1 ] = ( q0 + 2 * q1 ) / 3;
+	dA[ 2 ] = ( 2 * q1 + q2 ) / 3;
+	dA[ 3 ] = q2;
+}
+
+/** \brief Dice P of a Bezier patch along with its analytic derivatives.
+ *
+ * The four columns of the control net are forward differenced down v
+ * together, six lanes each for the position and its v derivative.  Each
+ * row they give is then forward differenced along u, nine lanes for the
+ * position and both derivatives, which are written straight into the grid.
+ *
+ * \param cp - control points, row by row with u along the rows.
+ * \param uSize, vSize - dice sizes.
+ * \param pP - destination for the positions.
+ * \param pdPdu, pdPdv - destinations for the derivatives, or NULL.
+ * \param pNg - destination for the normals, or NULL.
+ * \param invURange, invVRange - reciprocal of the parametric range of the
+ *                   patch, to take the derivatives to u and v.
+ * \param flipNormals - whether to reverse the normals, as for
+ *                   CqMicroPolyGrid::CalcNormals().
+ * \return false if a normal was degenerate, in which case pNg holds no
+ *         useful values.
+ */
+bool bezierPatchDicePositions( const CqVector3D cp[ 16 ], TqInt uSize, TqInt vSize,
+		CqVector3D* pP, CqVector3D* pdPdu, CqVector3D* pdPdv, CqVector3D* pNg,
+		TqFloat invURange, TqFloat invVRange, bool flipNormals )
+{
+	CqForwardDiffBezierLanes columns( 1.0f / vSize, 24 );
+	for ( TqInt col = 0; col < 4; col++ )
+	{
+		for ( TqInt c = 0; c < 3; c++ )
+		{
+			TqFloat A = cp[ col ][ c ];
+			TqFloat B = cp[ 4 + col ][ c ];
+			TqFloat C = cp[ 8 + col ][ c ];
+			TqFloat D = cp[ 12 + col ][ c ];
+			TqFloat dA[ 4 ];
+			bezierDerivative( A, B, C, D, dA );
+			columns.SetLane( col * 6 + c, A, B, C, D );
+			columns.SetLane( col * 6 + 3 + c, dA[ 0 ], dA[ 1 ], dA[ 2 ], dA[ 3 ] );
+		}
+	}
+
+	// Normals shorter than this fraction of the product of the tangent
+	// lengths are taken as degenerate.
+	const TqFloat eps2 = ( 100 * FLT_EPSILON ) * ( 100 * FLT_EPSILON );
+	bool validNormals = true;
+
+	CqForwardDiffBezierLanes row( 1.0f / uSize, 9 );
+	TqInt igrid = 0;
+	for ( TqInt iv = 0; iv <= vSize; iv++, columns.Step() )
+	{
+		const TqFloat* c = columns.Values();
+		for ( TqInt i = 0; i < 3; i++ )
+		{
+			TqFloat dA[ 4 ];
+			bezierDerivative( c[ i ], c[ 6 + i ], c[ 12 + i ], c[ 18 + i ], dA );
+			row.SetLane( i, c[ i ], c[ 6 + i ], c[ 12 + i ], c[ 18 + i ] );
+			row.SetLane( 3 + i, dA[ 0 ], dA[ 1 ], dA[ 2 ], dA[ 3 ] );
+			row.SetLane( 6 + i, c[ 3 + i ], c[ 9 + i ], c[ 15 + i ], c[ 21 + i ] );
+		}
+		for ( TqInt iu = 0; iu <= uSize; iu++, igrid++, row.Step() )
+		{
+			const TqFloat* r = row.Values();
+			pP[ igrid ] = CqVector3D( r[ 0 ], r[ 1 ], r[ 2 ] );
+			CqVector3D dPds( r[ 3 ], r[ 4 ], r[ 5 ] );
+			CqVector3D dPdt( r[ 6 ], r[ 7 ], r[ 8 ] );
+			if ( pdPdu )
+				pdPdu[ igrid ] = dPds * invURange;
+			if ( pdPdv )
+				pdPdv[ igrid ] = dPdt * invVRange;
+			if ( pNg && validNormals )
+			{
+				CqVector3D N = dPds % dPdt;
+				if ( N.Magnitude2() <= eps2 * dPds.Magnitude2() * dPdt.Magnitude2() )
+					validNormals = false;
+				if ( flipNormals )
+					N = -N;
+				N.Unit();
+				pNg[ igrid ] = N;
+			}
+		}
+	}
+	return ( validNormals );
+}
+
+/** \brief Dice P, dPdu, dPdv and Ng of a patch in one pass.
+ *
+ * Derivatives are only provided when the surface has u and v to give their
+ * scale, and normals only when none is degenerate; otherwise they are left
+ * to the grid to work out from P.
+ *
+ * \param surface - the patch being diced.
+ * \param cp - Bezier control points of the patch.
+ * \param pGrid - grid to fill in.
+ * \return Bitvector of the variables filled in.
+ */
+TqInt patchDicePositions( CqSurface& surface, const CqVector3D cp[ 16 ], CqMicroPolyGrid* pGrid )
+{
+	TqInt lUses = surface.Uses();
+	TqInt lDone = 0;
+
+	CqVector3D* pP = 0;
+	pGrid->pVar(EnvVars_P)->GetPointPtr( pP );
+
+	CqVector3D* pdPdu = 0;
+	CqVector3D* pdPdv = 0;
+	TqFloat invURange = 1;
+	TqFloat invVRange = 1;
+	bool needDerivs = ( USES( lUses, EnvVars_dPdu ) && NULL != pGrid->pVar(EnvVars_dPdu) ) ||
+					  ( USES( lUses, EnvVars_dPdv ) && NULL != pGrid->pVar(EnvVars_dPdv) );
+	if ( needDerivs && surface.bHasVar(EnvVars_u) && surface.bHasVar(EnvVars_v) )
+	{
+		TqFloat uRange = surface.u()->pValue( 1 )[ 0 ] - surface.u()->pValue( 0 )[ 0 ];
+		TqFloat vRange = surface.v()->pValue( 2 )[ 0 ] - surface.v()->pValue( 0 )[ 0 ];
+		if ( uRange != 0 && vRange != 0 )
+		{
+			invURange = 1 / uRange;
+			invVRange = 1 / vRange;
+			if ( USES( lUses, EnvVars_dPdu ) )
+				pGrid->pVar(EnvVars_dPdu)->GetVectorPtr( pdPdu );
+			if ( USES( lUses, EnvVars_dPdv ) )
+				pGrid->pVar(EnvVars_dPdv)->GetVectorPtr( pdPdv );
+			DONE( lDone, EnvVars_dPdu );
+			DONE( lDone, EnvVars_dPdv );
+		}
+	}
+
+	CqVector3D* pNg = 0;
+	bool flipNormals = false;
+	if ( USES( lUses, EnvVars_Ng ) && NULL != pGrid->pVar(EnvVars_Ng) )
+	{
+		pGrid->pVar(EnvVars_Ng)->GetNormalPtr( pNg );
+		// See CqMicroPolyGrid::CalcNormals() for the choice of direction.
+		bool CSO = surface.pTransform()->GetHandedness( surface.pTransform()->Time( 0 ) );
+		bool O = surface.pAttributes()->GetIntegerAttribute( "System", "Orientation" ) [ 0 ] != 0;
+		flipNormals = O ^ CSO;
+	}
+
+	if ( bezierPatchDicePositions( cp, surface.uDiceSize(), surface.vDiceSize(),
+				pP, pdPdu, pdPdv, pNg, invURange, invVRange, flipNormals ) && pNg )
+		DONE( lDone, EnvVars_Ng );
+	DONE( lDone, EnvVars_P );
+
+	return ( lDone );
+}
+
 } // unnamed namespace
 
+/** Dice P and its derivatives together, for patches which aren't rational.
+ */
+TqInt CqSurfacePatchBicubic::DiceAll( CqMicroPolyGrid* pGrid )
+{
+	if ( NULL == P() || NULL == pGrid->pVar(EnvVars_P) )
+		return ( 0 );
+
+	CqVector3D cp[ 16 ];
+	TqFloat w = P()->pValue( 0 )[ 0 ].h();
+	if ( w == 0 )
+		return ( 0 );
+	for ( TqInt i = 0; i < 16; i++ )
+	{
+		const CqVector4D& Pw = P()->pValue( i )[ 0 ];
+		if ( Pw.h() != w )
+			return ( 0 );
+		cp[ i ] = CqVector3D( Pw.x() / w, Pw.y() / w, Pw.z() / w );
+	}
+	return ( patchDicePositions( *this, cp, pGrid ) );
+}
+
 /** Dice the patch into a mesh of micropolygons.
  */
 void CqSurfacePatchBicubic::NaturalDice(CqParameter* pParam, TqInt uDiceSize,
@@ -806,6 +984,10 @@ TqInt CqSurfacePatchBilinear::Split( std::vector<boost::shared_ptr<CqSurface> >&
 		}
 	}
 
+	if ( m_fDiceable )
+		PassDiceEstimate( aSplits, direction || m_fHasPhantomFourthVertex,
+		                  opposite || m_fHasPhantomFourthVertex );
+
 	if ( m_fHasPhantomFourthVertex )
 	{
 		// If phantom, we can discard the new patch at the phantom vertex.
@@ -828,6 +1010,33 @@ TqInt CqSurfacePatchBilinear::Split( std::vector<boost::shared_ptr<CqSurface> >&
 	}
 }
 
+/** Dice P and its derivatives together, through the bicubic dicer.
+ * The corners are raised to the equivalent bicubic control net.
+ */
+TqInt CqSurfacePatchBilinear::DiceAll( CqMicroPolyGrid* pGrid )
+{
+	if ( NULL == P() || NULL == pGrid->pVar(EnvVars_P) )
+		return ( 0 );
+
+	CqVector3D corners[ 4 ];
+	TqFloat w = P()->pValue( 0 )[ 0 ].h();
+	if ( w == 0 )
+		return ( 0 );
+	for ( TqInt i = 0; i < 4; i++ )
+	{
+		const CqVector4D& Pw = P()->pValue( i )[ 0 ];
+		if ( Pw.h() != w )
+			return ( 0 );
+		corners[ i ] = CqVector3D( Pw.x() / w, Pw.y() / w, Pw.z() / w );
+	}
+	CqVector3D cp[ 16 ];
+	for ( TqInt row = 0; row < 4; row++ )
+		for ( TqInt col = 0; col < 4; col++ )
+			cp[ row * 4 + col ] = BilinearEvaluate( corners[ 0 ], corners[ 1 ],
+					corners[ 2 ], corners[ 3 ], col / 3.0f, row / 3.0f );
+	return ( patchDicePositions( *this, cp, pGrid ) );
+}
+
 void CqSurfacePatchBilinear::PostDice(CqMicroPolyGrid * pGrid)
 {
 	if(m_fHasPhantomFourthVertex)
@@ -87,6 +87,10 @@ class CqSurfacePatchBicubic : public CqSurface
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Patch );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( 1 );
@@ -104,6 +108,7 @@ class CqSurfacePatchBicubic : public CqSurface
 			return ( cVarying() );
 		}
 
+		virtual TqInt DiceAll( CqMicroPolyGrid* pGrid );
 		virtual void NaturalDice( CqParameter* pParameter, TqInt uDiceSize, TqInt vDiceSize, IqShaderData* pData );
 		virtual	TqInt PreSubdivide( std::vector<boost::shared_ptr<CqSurface> >& aSplits, bool u );
 		virtual void NaturalSubdivide( CqParameter* pParam, CqParameter* pParam1, CqParameter* pParam2, bool u );
@@ -157,6 +162,10 @@ class CqSurfacePatchBilinear : public CqSurface
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Patch );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( 1 );
@@ -177,6 +186,7 @@ class CqSurfacePatchBilinear : public CqSurface
 
 		virtual	TqInt	Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
 		virtual	TqInt	PreSubdivide( std::vector<boost::shared_ptr<CqSurface> >& aSplits, bool u );
+		virtual TqInt	DiceAll( CqMicroPolyGrid* pGrid );
 		virtual void	PostDice(CqMicroPolyGrid * pGrid);
 
 	protected:
@@ -245,6 +255,10 @@ class CqSurfacePatchMeshBicubic : public CqSurface
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Patch );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( m_uPatches * m_vPatches );
@@ -355,6 +369,10 @@ class CqSurfacePatchMeshBilinear : public CqSurface
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Patch );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( m_uPatches * m_vPatches );
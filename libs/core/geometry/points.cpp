@@ -31,6 +31,7 @@
 
 #include	<cmath>
 #include	<cfloat>
+#include	<map>
 
 #include	"points.h"
 #include	"imagebuffer.h"
@@ -595,6 +596,13 @@ void CqMicroPolyGridPoints::Split( long xmin, long xmax, long ymin, long ymax )
 		CqMatrix matNObjectToCameraT;
 		QGetRenderContext() ->matNSpaceToSpace( "object", "camera", NULL, &objTrans, 0, matNObjectToCameraT );
 
+		// Without depth of field, the points are binned into one batch per
+		// bucket rather than each becoming a micropolygon.
+		CqImageBuffer* pImage = QGetRenderContext()->pImage();
+		const bool useBatches = !QGetRenderContext()->UsingDepthOfField();
+		typedef std::map<std::pair<TqInt, TqInt>, boost::shared_ptr<CqMicroPolygonPointsBatch> > TqBatchMap;
+		TqBatchMap batches;
+
 		for ( TqInt iu = 0; iu < cu; iu++ )
 		{
 			// Get point in camera space.
@@ -638,11 +646,37 @@ void CqMicroPolyGridPoints::Split( long xmin, long xmax, long ymin, long ymax )
 			TqFloat ras_radius = ( vecRasP2 - Point ).Magnitude();
 			radius = ras_radius * 0.5f;
 
-			CqMicroPolygonPoints* pNew = new CqMicroPolygonPoints(this, iu);
-			pNew->Initialise( radius );
+			if( useBatches )
+			{
+				CqBound B( Point - CqVector3D( radius, radius, 0 ), Point + CqVector3D( radius, radius, 0 ) );
+				TqInt iXBa, iYBa, iXBb, iYBb;
+				if( !pImage->BucketRange( B, iXBa, iYBa, iXBb, iYBb ) )
+					continue;
+				for ( TqInt i = iXBa; i <= iXBb; i++ )
+				{
+					for ( TqInt j = iYBa; j <= iYBb; j++ )
+					{
+						boost::shared_ptr<CqMicroPolygonPointsBatch>& pBatch = batches[ std::make_pair( i, j ) ];
+						if( !pBatch )
+							pBatch.reset( new CqMicroPolygonPointsBatch( this ) );
+						pBatch->AppendPoint( Point, radius, iu );
+					}
+				}
+			}
+			else
+			{
+				CqMicroPolygonPoints* pNew = new CqMicroPolygonPoints(this, iu);
+				pNew->Initialise( radius );
 
-			boost::shared_ptr<CqMicroPolygon> pMP( pNew );
-			QGetRenderContext()->pImage()->AddMPG( pMP );
+				boost::shared_ptr<CqMicroPolygon> pMP( pNew );
+				pImage->AddMPG( pMP );
+			}
+		}
+
+		for ( TqBatchMap::iterator batch = batches.begin(); batch != batches.end(); ++batch )
+		{
+			boost::shared_ptr<CqMicroPolygon> pMP( batch->second );
+			pImage->AddMPG( pMP, batch->first.first, batch->first.second );
 		}
 	}
 
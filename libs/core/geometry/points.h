@@ -106,6 +106,10 @@ class CqPoints : public CqSurface
 		}
 #endif
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Points );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( 1 );
@@ -517,6 +521,17 @@ class CqDeformingPointsSurface : public CqDeformingSurface
 		virtual	~CqDeformingPointsSurface()
 		{}
 
+		virtual CqSurface* Clone() const
+		{
+			CqDeformingPointsSurface* clone = new CqDeformingPointsSurface( boost::shared_ptr<CqSurface>() );
+			if ( !CloneData( clone ) )
+			{
+				delete clone;
+				return ( NULL );
+			}
+			return ( clone );
+		}
+
 		/** Dice this GPrim, creating a CqMotionMicroPolyGrid with all times in.
 		 */
 		virtual	CqMicroPolyGridBase* Dice()
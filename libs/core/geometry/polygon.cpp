@@ -23,6 +23,8 @@
 		\author Paul C. Gregory (pgregory@aqsis.org)
 */
 
+#include	<algorithm>
+
 #include	"polygon.h"
 #include	"patch.h"
 
@@ -453,6 +455,20 @@ CqSurface* CqSurfacePolygon::Clone() const
 }
 
 
+//---------------------------------------------------------------------
+/** Create a copy of this polygon, with its own copy of the points.
+ */
+
+CqSurface* CqSurfacePointsPolygon::Clone() const
+{
+	boost::shared_ptr<CqPolygonPoints> clone_points( static_cast<CqPolygonPoints*>( m_pPoints->Clone() ) );
+	CqSurfacePointsPolygon* clone = new CqSurfacePointsPolygon( clone_points, m_Index, m_FaceVaryingIndex );
+	CqSurface::CloneData( clone );
+	clone->m_aIndices = m_aIndices;
+	return ( clone );
+}
+
+
 //---------------------------------------------------------------------
 /** Copy constructor.
  */
@@ -516,32 +532,686 @@ CqSurface* CqPolygonPoints::Clone() const
 }
 
 
+namespace {
+
+/** \brief Corners of one face of a polygon mesh, diced as a bilinear patch.
+ *
+ * The corners are in the order taken by BilinearEvaluate().  The fourth
+ * corner of a triangle repeats the third, collapsing the v = 1 edge of the
+ * patch to a point; the micropolygons along that edge are degenerate quads,
+ * which the hider already treats as triangles.
+ */
+struct SqMeshFace
+{
+	TqInt vertex[ 4 ];		///< Indices of the corners in the vertex and varying values.
+	TqInt faceVarying[ 4 ];	///< Indices of the corners in the facevarying values.
+	TqInt uniform;			///< Index of the face in the whole mesh.
+};
+
+/** \brief Evaluate one array element of a mesh parameter on a face.
+ *
+ * \param values - parameter values.
+ * \param arraySize - array length of the parameter.
+ * \param j - array element to evaluate.
+ * \param paramClass - storage class of the parameter.
+ * \param face - the face to evaluate on.
+ * \param u, v - position within the face.
+ */
+template<typename T>
+T sampleMeshParam( const T* values, TqInt arraySize, TqInt j,
+		EqVariableClass paramClass, const SqMeshFace& face, TqFloat u, TqFloat v )
+{
+	const TqInt* corners = face.vertex;
+	switch ( paramClass )
+	{
+		case class_vertex:
+		case class_varying:
+			break;
+		case class_facevarying:
+		case class_facevertex:
+			corners = face.faceVarying;
+			break;
+		case class_uniform:
+			return ( values[ arraySize*face.uniform + j ] );
+		default:
+			return ( values[ j ] );
+	}
+	return ( BilinearEvaluate<T>( values[ arraySize*corners[ 0 ] + j ],
+	                              values[ arraySize*corners[ 1 ] + j ],
+	                              values[ arraySize*corners[ 2 ] + j ],
+	                              values[ arraySize*corners[ 3 ] + j ], u, v ) );
+}
+
+/** \brief Dice a parameter of a polygon mesh onto a grid of face strips.
+ *
+ * Each face occupies ( vDice + 1 ) rows of ( uDice + 1 ) grid points.
+ *
+ * \param pParam - parameter to dice.
+ * \param faces - the faces making up the grid.
+ * \param uDice, vDice - number of micropolygons across each face.
+ * \param pData - destination shader data.
+ * \param arrayIndex - if non-negative, dice only this array element of
+ *                     pParam into the non-array pData.
+ */
+template<typename T, typename SLT>
+void meshDice( CqParameter* pParam, const std::vector<SqMeshFace>& faces,
+		TqInt uDice, TqInt vDice, IqShaderData* pData, TqInt arrayIndex = -1 )
+{
+	if ( pData->Class() != class_varying )
+	{
+		Aqsis::log() << error << "\"" << "Attempt to assign a varying value to uniform variable \"" <<
+			pData->strName() << "\"" << std::endl;
+		return;
+	}
+
+	CqParameterTyped<T, SLT>* pTParam = static_cast<CqParameterTyped<T, SLT>*>( pParam );
+	const T* src = pTParam->pValue();
+	const TqInt arraySize = pTParam->Count();
+	const EqVariableClass paramClass = pParam->Class();
+	const TqInt firstEntry = arrayIndex < 0 ? 0 : arrayIndex;
+	const TqInt lastEntry = arrayIndex < 0 ? arraySize : arrayIndex + 1;
+	for ( TqInt j = firstEntry; j < lastEntry; j++ )
+	{
+		SLT* dest = 0;
+		if ( arrayIndex < 0 )
+			pData->ArrayEntry( j ) ->GetValuePtr( dest );
+		else
+			pData->GetValuePtr( dest );
+		std::vector<SqMeshFace>::const_iterator face;
+		for ( face = faces.begin(); face != faces.end(); ++face )
+		{
+			for ( TqInt iv = 0; iv <= vDice; iv++ )
+			{
+				const TqFloat v = static_cast<TqFloat>( iv ) / vDice;
+				for ( TqInt iu = 0; iu <= uDice; iu++ )
+					*dest++ = paramToShaderType<SLT, T>( sampleMeshParam( src, arraySize, j,
+					              paramClass, *face, static_cast<TqFloat>( iu ) / uDice, v ) );
+			}
+		}
+	}
+}
+
+/** \brief Determine whether a parameter type can be diced by meshDice().
+ */
+inline bool meshDiceableType( EqVariableType type )
+{
+	switch ( type )
+	{
+		case type_float:
+		case type_point:
+		case type_vector:
+		case type_normal:
+		case type_hpoint:
+		case type_color:
+			return ( true );
+		default:
+			return ( false );
+	}
+}
+
+/** \brief Dice a parameter of a polygon mesh onto a grid of face strips.
+ *
+ * Dispatches to meshDice() based on the type of the parameter; the type must
+ * be one for which meshDiceableType() is true.
+ */
+void meshDiceParam( CqParameter* pParam, const std::vector<SqMeshFace>& faces,
+		TqInt uDice, TqInt vDice, IqShaderData* pData, TqInt arrayIndex = -1 )
+{
+	switch ( pParam->Type() )
+	{
+		case type_float:
+			meshDice<TqFloat, TqFloat>( pParam, faces, uDice, vDice, pData, arrayIndex );
+			break;
+		case type_point:
+		case type_vector:
+		case type_normal:
+			meshDice<CqVector3D, CqVector3D>( pParam, faces, uDice, vDice, pData, arrayIndex );
+			break;
+		case type_hpoint:
+			meshDice<CqVector4D, CqVector3D>( pParam, faces, uDice, vDice, pData, arrayIndex );
+			break;
+		case type_color:
+			meshDice<CqColor, CqColor>( pParam, faces, uDice, vDice, pData, arrayIndex );
+			break;
+		default:
+			assert( 0 && "Unsupported type for polygon mesh dicing" );
+			break;
+	}
+}
+
+/** \brief Calculate the unnormalised facet normal of a polygon.
+ *
+ * As in CqPolygonBase::Split(), the normal is found from the first two
+ * distinct edges leaving the first vertex.
+ */
+CqVector3D meshFacetNormal( const CqVector3D* points, TqInt numPoints )
+{
+	CqVector3D vecN0, vecN1;
+	TqInt i = 1;
+	while ( i < numPoints )
+	{
+		vecN0 = points[ i ] - points[ 0 ];
+		if ( vecN0.Magnitude() > FLT_EPSILON )
+			break;
+		i++;
+	}
+	i++;
+	while ( i < numPoints )
+	{
+		vecN1 = points[ i ] - points[ 0 ];
+		if ( vecN1.Magnitude() > FLT_EPSILON && vecN1 != vecN0 )
+			break;
+		i++;
+	}
+	return ( vecN0 % vecN1 );
+}
+
+/// Order faces by their centre along one axis.
+class CqFaceCentreLess
+{
+	public:
+		CqFaceCentreLess( const std::vector<CqVector3D>& centres, TqInt axis )
+			: m_centres( centres ), m_axis( axis )
+		{}
+		bool operator()( TqInt a, TqInt b ) const
+		{
+			return ( m_centres[ a ][ m_axis ] < m_centres[ b ][ m_axis ] );
+		}
+	private:
+		const std::vector<CqVector3D>& m_centres;
+		TqInt m_axis;
+};
+
+} // unnamed namespace
+
+
+//---------------------------------------------------------------------
+/** Return the boundary extents in camera space of the faces.
+ */
+
 void	CqSurfacePointsPolygons::Bound(CqBound* bound) const
 {
 	if( m_pPoints && m_pPoints->P() )
 	{
-		TqInt PointIndex;
-		for( PointIndex = m_pPoints->P()->Size()-1; PointIndex >= 0; PointIndex-- )
-			bound->Encapsulate( vectorCast<CqVector3D>(m_pPoints->P()->pValue()[PointIndex]) );
+		const CqParameterTyped<CqVector4D, CqVector3D>* pP = m_pPoints->P();
+		if( static_cast<TqUint>( m_NumPolys ) == m_pPoints->cUniform() )
+		{
+			TqInt PointIndex;
+			for( PointIndex = pP->Size()-1; PointIndex >= 0; PointIndex-- )
+				bound->Encapsulate( vectorCast<CqVector3D>(pP->pValue()[PointIndex]) );
+		}
+		else
+		{
+			// A cluster shares the points of the whole mesh, so only
+			// bound those used by its faces.
+			const TqUint numPoints = pP->Size();
+			std::vector<TqInt>::const_iterator index;
+			for( index = m_PointIndices.begin(); index != m_PointIndices.end(); ++index )
+			{
+				if( static_cast<TqUint>( *index ) < numPoints )
+					bound->Encapsulate( vectorCast<CqVector3D>(pP->pValue()[*index]) );
+			}
+		}
 	}
 	AdjustBoundForTransformationMotion( bound );
 }
 
+
+//---------------------------------------------------------------------
+/** Determine whether the faces can be diced into a grid of strips.
+ *  Each face must be a triangle or quad with valid indices, and each
+ *  primitive variable must be one which can be interpolated over the faces.
+ */
+
+bool CqSurfacePointsPolygons::CanDiceFaces() const
+{
+	if( !m_pPoints || !m_pPoints->P() )
+		return( false );
+
+	const TqUint numPoints = m_pPoints->P()->Size();
+	TqInt iP = 0, poly;
+	for ( poly = 0; poly < m_NumPolys; poly++ )
+	{
+		const TqInt n = m_PointCounts[ poly ];
+		if ( n < 3 || n > 4 )
+			return( false );
+		TqInt i;
+		for ( i = 0; i < n; i++, iP++ )
+		{
+			if ( static_cast<TqUint>( m_PointIndices[ iP ] ) >= numPoints )
+				return( false );
+		}
+	}
+
+	std::vector<boost::shared_ptr<IqShader> > shaders;
+	boost::shared_ptr<IqShader> pShader;
+	if ( pShader = pAttributes() ->pshadSurface( QGetRenderContext() ->Time() ) )
+		shaders.push_back( pShader );
+	if ( pShader = pAttributes() ->pshadDisplacement( QGetRenderContext() ->Time() ) )
+		shaders.push_back( pShader );
+	if ( pShader = pAttributes() ->pshadAtmosphere( QGetRenderContext() ->Time() ) )
+		shaders.push_back( pShader );
+
+	std::vector<CqParameter*>::const_iterator iUP;
+	for ( iUP = m_pPoints->aUserParams().begin(); iUP != m_pPoints->aUserParams().end(); iUP++ )
+	{
+		switch ( ( *iUP ) ->Class() )
+		{
+			case class_vertex:
+			case class_varying:
+			case class_facevarying:
+			case class_facevertex:
+				if ( !meshDiceableType( ( *iUP ) ->Type() ) )
+					return( false );
+				break;
+			case class_uniform:
+			{
+				if ( !meshDiceableType( ( *iUP ) ->Type() ) )
+					return( false );
+				// A uniform shader argument can only take the value of one face.
+				std::vector<boost::shared_ptr<IqShader> >::const_iterator shader;
+				for ( shader = shaders.begin(); shader != shaders.end(); ++shader )
+				{
+					IqShaderData* pArg = ( *shader ) ->FindArgument( ( *iUP ) ->strName() );
+					if ( pArg && pArg->Class() != class_varying )
+						return( false );
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	return( true );
+}
+
+
+//---------------------------------------------------------------------
+/** Determine whether the faces can be diced together into one grid.
+ *  Every face is diced at the same rate, enough for the largest face, as a
+ *  strip of the grid.  If this needs too many micropolygons for one grid
+ *  the faces are split into clusters instead.
+ */
+
+bool CqSurfacePointsPolygons::Diceable(const CqMatrix& matCtoR)
+{
+	m_SplitToPolygons = true;
+	m_SplitOrder.clear();
+	if ( !CanDiceFaces() )
+		return( false );
+
+	// A mesh spanning the eye plane can't be measured in raster space, but
+	// the parts of it which don't can still be diced as clusters.
+	if ( !m_fDiceable )
+	{
+		if ( m_NumPolys > 1 )
+		{
+			m_SplitToPolygons = false;
+			ChooseSplitOrder();
+		}
+		return( false );
+	}
+
+	// Find the longest edges in u and v of the faces as bilinear patches, in
+	// raster space.
+	const CqParameterTyped<CqVector4D, CqVector3D>* pP = m_pPoints->P();
+	TqFloat uLen = 0;
+	TqFloat vLen = 0;
+	TqInt iP = 0, poly;
+	for ( poly = 0; poly < m_NumPolys; poly++ )
+	{
+		const TqInt n = m_PointCounts[ poly ];
+		const TqInt* indices = &m_PointIndices[ iP ];
+		iP += n;
+
+		CqVector3D avecHull[ 4 ];
+		avecHull[ 0 ] = vectorCast<CqVector3D>( matCtoR * pP->pValue( indices[ 0 ] )[ 0 ] );
+		avecHull[ 1 ] = vectorCast<CqVector3D>( matCtoR * pP->pValue( indices[ 1 ] )[ 0 ] );
+		avecHull[ 2 ] = vectorCast<CqVector3D>( matCtoR * pP->pValue( indices[ n - 1 ] )[ 0 ] );
+		avecHull[ 3 ] = vectorCast<CqVector3D>( matCtoR * pP->pValue( indices[ 2 ] )[ 0 ] );
+
+		uLen = max( uLen, max( ( avecHull[ 1 ] - avecHull[ 0 ] ).Magnitude2(),
+		                       ( avecHull[ 3 ] - avecHull[ 2 ] ).Magnitude2() ) );
+		vLen = max( vLen, max( ( avecHull[ 2 ] - avecHull[ 0 ] ).Magnitude2(),
+		                       ( avecHull[ 3 ] - avecHull[ 1 ] ).Magnitude2() ) );
+	}
+
+	TqFloat shadingRate = AdjustedShadingRate();
+	m_uDiceSize = max<TqInt>( lround( sqrt( uLen/shadingRate ) ), 1 );
+	m_vDiceSize = max<TqInt>( lround( sqrt( vLen/shadingRate ) ), 1 );
+
+	// Ensure power of 2 to avoid cracking
+	const TqInt *binary = pAttributes() ->GetIntegerAttribute( "dice", "binary" );
+	if ( binary && *binary )
+	{
+		m_uDiceSize = ceilPow2( m_uDiceSize );
+		m_vDiceSize = ceilPow2( m_vDiceSize );
+	}
+
+	TqFloat gs = 16.0f;
+	const TqFloat* poptGridSize = QGetRenderContext() ->poptCurrent()->GetFloatOption( "System", "SqrtGridSize" );
+	if( NULL != poptGridSize )
+		gs = poptGridSize[0];
+
+	if ( static_cast<TqFloat>( m_NumPolys ) * m_uDiceSize * m_vDiceSize > gs*gs )
+	{
+		// A single face too big for a grid is left to the bilinear patches.
+		if ( m_NumPolys > 1 )
+		{
+			m_SplitToPolygons = false;
+			ChooseSplitOrder();
+		}
+		return( false );
+	}
+
+	return( true );
+}
+
+
+//---------------------------------------------------------------------
+/** Order the faces so that each half forms a compact cluster, by
+ *  partitioning the face centres about their median along the longest axis
+ *  of their bound.  The order is worked out here rather than in Split(), so
+ *  that it can be copied to the other time slots of a deforming mesh.
+ */
+
+void CqSurfacePointsPolygons::ChooseSplitOrder()
+{
+	const CqParameterTyped<CqVector4D, CqVector3D>* pP = m_pPoints->P();
+	std::vector<CqVector3D> centres( m_NumPolys );
+	CqBound centreBound;
+	TqInt iP = 0, poly;
+	for ( poly = 0; poly < m_NumPolys; poly++ )
+	{
+		const TqInt n = m_PointCounts[ poly ];
+		CqVector3D centre( 0, 0, 0 );
+		TqInt i;
+		for ( i = 0; i < n; i++, iP++ )
+			centre += vectorCast<CqVector3D>( pP->pValue( m_PointIndices[ iP ] )[ 0 ] );
+		centres[ poly ] = centre / static_cast<TqFloat>( n );
+		centreBound.Encapsulate( centres[ poly ] );
+	}
+
+	const CqVector3D extent = centreBound.vecMax() - centreBound.vecMin();
+	TqInt axis = 0;
+	if ( extent.y() > extent[ axis ] )
+		axis = 1;
+	if ( extent.z() > extent[ axis ] )
+		axis = 2;
+
+	m_SplitOrder.resize( m_NumPolys );
+	for ( poly = 0; poly < m_NumPolys; poly++ )
+		m_SplitOrder[ poly ] = poly;
+	std::nth_element( m_SplitOrder.begin(), m_SplitOrder.begin() + m_NumPolys / 2,
+	                  m_SplitOrder.end(), CqFaceCentreLess( centres, axis ) );
+}
+
+
+//---------------------------------------------------------------------
+/** Dice the faces into a single grid.
+ *  Each face is diced as a bilinear patch with m_uDiceSize by m_vDiceSize
+ *  micropolygons, forming an independent strip of the grid.  Standard
+ *  variables not given on the mesh take the same defaults as the patches
+ *  made by CqPolygonBase::Split().
+ */
+
+CqMicroPolyGridBase* CqSurfacePointsPolygons::Dice()
+{
+	const TqInt uDice = m_uDiceSize;
+	const TqInt vDice = m_vDiceSize;
+	const TqInt stripRes = vDice + 1;
+	const TqInt facePoints = ( uDice + 1 ) * stripRes;
+	const TqInt numPoints = m_NumPolys * facePoints;
+
+	std::vector<SqMeshFace> faces( m_NumPolys );
+	TqInt iP = 0, poly;
+	for ( poly = 0; poly < m_NumPolys; poly++ )
+	{
+		const TqInt n = m_PointCounts[ poly ];
+		const TqInt corners[ 4 ] = { 0, 1, n - 1, 2 };
+		SqMeshFace& face = faces[ poly ];
+		TqInt i;
+		for ( i = 0; i < 4; i++ )
+		{
+			face.vertex[ i ] = m_PointIndices[ iP + corners[ i ] ];
+			face.faceVarying[ i ] = m_FaceVaryingIndices[ poly ] + corners[ i ];
+		}
+		face.uniform = m_MeshIndices[ poly ];
+		iP += n;
+	}
+
+	CqMicroPolyGrid* pGrid = new CqMicroPolyGrid();
+	pGrid->Initialise( uDice, m_NumPolys * stripRes - 1, shared_from_this() );
+	pGrid->SetVStripRes( stripRes );
+
+	TqInt lUses = Uses();
+	TqInt lDone = 0;
+
+	meshDiceParam( m_pPoints->P(), faces, uDice, vDice, pGrid->pVar( EnvVars_P ) );
+	DONE( lDone, EnvVars_P );
+
+	// Special cases for s and t if "st" exists, it should override s and t.
+	CqParameter* pParam;
+	if( ( pParam = m_pPoints->FindUserParam( "st" ) ) != NULL )
+	{
+		if ( USES( lUses, EnvVars_s ) && ( NULL != pGrid->pVar( EnvVars_s ) ) )
+			meshDiceParam( pParam, faces, uDice, vDice, pGrid->pVar( EnvVars_s ), 0 );
+		if ( USES( lUses, EnvVars_t ) && ( NULL != pGrid->pVar( EnvVars_t ) ) )
+			meshDiceParam( pParam, faces, uDice, vDice, pGrid->pVar( EnvVars_t ), 1 );
+		DONE( lDone, EnvVars_s );
+		DONE( lDone, EnvVars_t );
+	}
+
+	TqInt varID;
+	for( varID = EnvVars_Cs; varID != EnvVars_Last; varID++ )
+	{
+		if ( !isDONE( lDone, varID ) && USES( lUses, varID ) && ( NULL != pGrid->pVar( varID ) )
+		        && m_pPoints->bHasVar( varID ) )
+		{
+			meshDiceParam( m_pPoints->pVar( varID ), faces, uDice, vDice, pGrid->pVar( varID ) );
+			DONE( lDone, varID );
+		}
+	}
+
+	// If there are no smooth normals specified, then fill in the facet normal
+	// of each face, taking into account orientation as CqPolygonBase::Split()
+	// does.
+	if ( !isDONE( lDone, EnvVars_N ) && USES( lUses, EnvVars_N ) && ( NULL != pGrid->pVar( EnvVars_N ) ) )
+	{
+		bool CSO = pTransform()->GetHandedness(pTransform()->Time(0));
+		bool O = pAttributes() ->GetIntegerAttribute( "System", "Orientation" ) [ 0 ] != 0;
+		IqShaderData* pN = pGrid->pVar( EnvVars_N );
+		TqInt i = 0;
+		for ( poly = 0, iP = 0; poly < m_NumPolys; poly++ )
+		{
+			const TqInt n = m_PointCounts[ poly ];
+			CqVector3D points[ 4 ];
+			TqInt j;
+			for ( j = 0; j < n; j++ )
+				points[ j ] = vectorCast<CqVector3D>( m_pPoints->P()->pValue( m_PointIndices[ iP + j ] )[ 0 ] );
+			iP += n;
+
+			CqVector3D vecN = meshFacetNormal( points, n );
+			vecN = ( (O && CSO) || (!O && !CSO) ) ? vecN : -vecN;
+			vecN.Unit();
+			for ( j = 0; j < facePoints; j++ )
+				pN->SetNormal( vecN, i++ );
+		}
+		DONE( lDone, EnvVars_N );
+	}
+	if ( isDONE( lDone, EnvVars_N ) )
+		pGrid->SetbShadingNormals( true );
+
+	// u and v run across each face, rather than taking the object space x,y
+	// coordinates required by the RISpec; see CqPolygonBase::Split().
+	for ( TqInt uv = 0; uv < 2; uv++ )
+	{
+		const TqInt uvID = uv == 0 ? EnvVars_u : EnvVars_v;
+		if ( !isDONE( lDone, uvID ) && USES( lUses, uvID ) && ( NULL != pGrid->pVar( uvID ) ) )
+		{
+			TqInt i = 0;
+			for ( TqInt row = 0; row < m_NumPolys * stripRes; row++ )
+			{
+				for ( TqInt iu = 0; iu <= uDice; iu++, i++ )
+					pGrid->pVar( uvID ) ->SetFloat( uv == 0 ? static_cast<TqFloat>( iu ) / uDice :
+					                                static_cast<TqFloat>( row % stripRes ) / vDice, i );
+			}
+			DONE( lDone, uvID );
+		}
+	}
+
+	// s and t default to the object space x,y coordinates.
+	bool needS = !isDONE( lDone, EnvVars_s ) && USES( lUses, EnvVars_s ) && ( NULL != pGrid->pVar( EnvVars_s ) );
+	bool needT = !isDONE( lDone, EnvVars_t ) && USES( lUses, EnvVars_t ) && ( NULL != pGrid->pVar( EnvVars_t ) );
+	if ( needS || needT )
+	{
+		CqMatrix matCurrentToObject;
+		QGetRenderContext() ->matSpaceToSpace( "current", "object", NULL, pTransform().get(), pTransform() ->Time(0), matCurrentToObject );
+		const CqVector3D* pPoints = 0;
+		pGrid->pVar( EnvVars_P ) ->GetPointPtr( pPoints );
+		TqInt i;
+		for ( i = 0; i < numPoints; i++ )
+		{
+			CqVector3D vecP = matCurrentToObject * pPoints[ i ];
+			if ( needS )
+				pGrid->pVar( EnvVars_s ) ->SetFloat( vecP.x(), i );
+			if ( needT )
+				pGrid->pVar( EnvVars_t ) ->SetFloat( vecP.y(), i );
+		}
+		DONE( lDone, EnvVars_s );
+		DONE( lDone, EnvVars_t );
+	}
+
+	if ( !isDONE( lDone, EnvVars_Cs ) && USES( lUses, EnvVars_Cs ) && ( NULL != pGrid->pVar( EnvVars_Cs ) ) )
+	{
+		if ( NULL != pAttributes() ->GetColorAttribute( "System", "Color" ) )
+			pGrid->pVar( EnvVars_Cs ) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
+		else
+			pGrid->pVar( EnvVars_Cs ) ->SetColor( CqColor( 1, 1, 1 ) );
+	}
+
+	if ( !isDONE( lDone, EnvVars_Os ) && USES( lUses, EnvVars_Os ) && ( NULL != pGrid->pVar( EnvVars_Os ) ) )
+	{
+		if ( NULL != pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
+			pGrid->pVar( EnvVars_Os ) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
+		else
+			pGrid->pVar( EnvVars_Os ) ->SetColor( CqColor( 1, 1, 1 ) );
+	}
+
+	// Now we need to dice the user specified parameters as appropriate.
+	std::vector<boost::shared_ptr<IqShader> > shaders;
+	boost::shared_ptr<IqShader> pShader;
+	if ( NULL != ( pShader = pGrid->pAttributes() ->pshadSurface( QGetRenderContext() ->Time() ) ) )
+		shaders.push_back( pShader );
+	if ( NULL != ( pShader = pGrid->pAttributes() ->pshadDisplacement( QGetRenderContext() ->Time() ) ) )
+		shaders.push_back( pShader );
+	if ( NULL != ( pShader = pGrid->pAttributes() ->pshadAtmosphere( QGetRenderContext() ->Time() ) ) )
+		shaders.push_back( pShader );
+
+	std::vector<CqParameter*>::iterator iUP;
+	for ( iUP = m_pPoints->aUserParams().begin(); iUP != m_pPoints->aUserParams().end(); iUP++ )
+	{
+		std::vector<boost::shared_ptr<IqShader> >::iterator shader;
+		for ( shader = shaders.begin(); shader != shaders.end(); ++shader )
+		{
+			IqShaderData* pArg = ( *shader ) ->FindArgument( ( *iUP ) ->strName() );
+			if ( NULL == pArg || pArg->Type() != ( *iUP ) ->Type() )
+				continue;
+			// Uniform values feeding uniform arguments are excluded by
+			// CanDiceFaces(), so the standard mechanism applies to constants.
+			if ( ( *iUP ) ->Class() == class_constant &&
+			        ( pArg->Class() != class_varying || !meshDiceableType( ( *iUP ) ->Type() ) ) )
+				( *shader ) ->SetArgument( ( *iUP ), this );
+			else
+				meshDiceParam( ( *iUP ), faces, uDice, vDice, pArg );
+		}
+	}
+
+	return ( pGrid );
+}
+
+
+//---------------------------------------------------------------------
+/** Split the mesh into two clusters of faces, or into individual polygons
+ *  if the faces can't be diced together.
+ */
+
 TqInt CqSurfacePointsPolygons::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
+{
+	if ( m_SplitToPolygons || m_NumPolys < 2 )
+		return( SplitToPolygons( aSplits ) );
+
+	std::vector<TqInt> starts( m_NumPolys );
+	TqInt iP = 0, poly;
+	for ( poly = 0; poly < m_NumPolys; poly++ )
+	{
+		starts[ poly ] = iP;
+		iP += m_PointCounts[ poly ];
+	}
+
+	// Without a spatial order, as when the mesh spans the eye plane, split
+	// it in mesh order.
+	std::vector<TqInt> order( m_SplitOrder );
+	if ( order.empty() )
+	{
+		order.resize( m_NumPolys );
+		for ( poly = 0; poly < m_NumPolys; poly++ )
+			order[ poly ] = poly;
+	}
+	// Keep the faces of each cluster in mesh order.
+	std::vector<TqInt>::iterator mid = order.begin() + m_NumPolys / 2;
+	std::sort( order.begin(), mid );
+	std::sort( mid, order.end() );
+
+	TqInt cluster;
+	for ( cluster = 0; cluster < 2; cluster++ )
+	{
+		std::vector<TqInt>::const_iterator first = cluster == 0 ? order.begin() : mid;
+		std::vector<TqInt>::const_iterator last = cluster == 0 ? mid : order.end();
+
+		boost::shared_ptr<CqSurfacePointsPolygons> pCluster( new CqSurfacePointsPolygons() );
+		pCluster->SetSurfaceParameters( *this );
+		// Clustering doesn't count as an eye split.
+		pCluster->SetSplitCount( SplitCount() );
+		pCluster->m_pPoints = m_pPoints;
+		pCluster->m_NumPolys = last - first;
+		pCluster->m_PointCounts.reserve( pCluster->m_NumPolys );
+		pCluster->m_MeshIndices.reserve( pCluster->m_NumPolys );
+		pCluster->m_FaceVaryingIndices.reserve( pCluster->m_NumPolys );
+		for ( ; first != last; ++first )
+		{
+			pCluster->m_PointCounts.push_back( m_PointCounts[ *first ] );
+			pCluster->m_MeshIndices.push_back( m_MeshIndices[ *first ] );
+			pCluster->m_FaceVaryingIndices.push_back( m_FaceVaryingIndices[ *first ] );
+			pCluster->m_PointIndices.insert( pCluster->m_PointIndices.end(),
+			                                 m_PointIndices.begin() + starts[ *first ],
+			                                 m_PointIndices.begin() + starts[ *first ] + m_PointCounts[ *first ] );
+		}
+		aSplits.push_back( pCluster );
+	}
+	return( 2 );
+}
+
+
+//---------------------------------------------------------------------
+/** Split the mesh into individual polygons.
+ */
+
+TqInt CqSurfacePointsPolygons::SplitToPolygons( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
 {
 	TqInt	CreatedPolys = 0;
 	TqInt	iP = 0, poly;
 	for ( poly = 0; poly < m_NumPolys; poly++ )
 	{
 		// Create a surface polygon
-		boost::shared_ptr<CqSurfacePointsPolygon> pSurface( new CqSurfacePointsPolygon( m_pPoints, poly, iP ) );
+		boost::shared_ptr<CqSurfacePointsPolygon> pSurface( new CqSurfacePointsPolygon( m_pPoints, m_MeshIndices[ poly ], m_FaceVaryingIndices[ poly ] ) );
 		RtBoolean fValid = RI_TRUE;
 
 		pSurface->aIndices().resize( m_PointCounts[ poly ] );
 		TqUint i;
 		for ( i = 0; i < (TqUint)m_PointCounts[ poly ]; i++ )          	// Fill in the points
 		{
-			if ( (TqUint) m_PointIndices[ iP ] >= m_pPoints->P()->Size() )
+			if ( (TqUint) m_PointIndices[ iP + i ] >= m_pPoints->P()->Size() )
 			{
 				fValid = RI_FALSE;
 				//CqAttributeError( 1, Severity_Normal, "Invalid PointsPolygon index", pSurface->pAttributes() );
@@ -553,9 +1223,9 @@ TqInt CqSurfacePointsPolygons::Split( std::vector<boost::shared_ptr<CqSurface> >
 
 				break;
 			}
-			pSurface->aIndices() [ i ] = m_PointIndices[ iP ];
-			iP++;
+			pSurface->aIndices() [ i ] = m_PointIndices[ iP + i ];
 		}
+		iP += m_PointCounts[ poly ];
 		if ( fValid )
 		{
 			aSplits.push_back( pSurface );
@@ -575,6 +1245,8 @@ CqSurface* CqSurfacePointsPolygons::Clone() const
 	clone->m_NumPolys = m_NumPolys;
 	clone->m_PointCounts = m_PointCounts;
 	clone->m_PointIndices = m_PointIndices;
+	clone->m_MeshIndices = m_MeshIndices;
+	clone->m_FaceVaryingIndices = m_FaceVaryingIndices;
 	clone->m_pPoints = boost::shared_ptr<CqPolygonPoints>(clone_points);
 	return(clone);
 }
@@ -176,6 +176,10 @@ class CqSurfacePolygon : public CqSurface, public CqPolygonBase
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Polygon );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( 1 );
@@ -328,6 +332,10 @@ class CqPolygonPoints : public CqSurface
 
 		virtual void	Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime = 0 );
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Polygon );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( m_cFaces );
@@ -422,11 +430,24 @@ class CqSurfacePointsPolygon : public CqSurface, public CqPolygonBase
 
 		virtual void	Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime = 0 )
 		{
-			// \attention It is invalid to call Transform on a polygon, as the rendering process has begun so the transformation is fixed.
-			// The individual polygons cannot be transformed as they all refer to the same points class, if one polygon transforms
-			// those points, then another polygon receives the same transform, the points will be transformed twice.
-			Aqsis::log() << error << "Transform called on CqSurfacePointsPolygon" << std::endl;
-			//m_pPoints->Transform( matTx, matITTx, matRTx );
+			// \attention The polygons of a mesh cannot be transformed individually as they all refer to the same points class,
+			// if one polygon transforms those points, then another polygon receives the same transform, the points will be
+			// transformed twice.  A clone has a private copy of the points, so can be transformed.
+			if ( m_pPoints.unique() )
+				m_pPoints->Transform( matTx, matITTx, matRTx, iTime );
+			else
+				Aqsis::log() << error << "Transform called on CqSurfacePointsPolygon" << std::endl;
+		}
+		/** Set the instance parameters of this and the points.
+		 */
+		virtual	void	SetInstanceParameters( const CqAttributesPtr& pAttributes, const CqTransformPtr& pTransform )
+		{
+			CqSurface::SetInstanceParameters( pAttributes, pTransform );
+			m_pPoints->SetInstanceParameters( pAttributes, pTransform );
+		}
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Polygon );
 		}
 		// NOTE: These should never be called.
 		virtual	TqUint	cUniform() const
@@ -532,10 +553,7 @@ class CqSurfacePointsPolygon : public CqSurface, public CqPolygonBase
 			return( m_FaceVaryingIndex );
 		}
 
-		virtual CqSurface* Clone() const
-		{
-			return(NULL);
-		}
+		virtual CqSurface* Clone() const;
 
 	protected:
 		std::vector<TqInt>	m_aIndices;		///< Array of indices into the associated vertex list.
@@ -547,22 +565,34 @@ class CqSurfacePointsPolygon : public CqSurface, public CqPolygonBase
 //----------------------------------------------------------------------
 /** \class CqSurfacePointsPolygons
  * Container surface to store the polygons making up a RiPointsPolygons surface.
+ *
+ * Meshes made only of triangles and quads are diced directly: each face is
+ * diced as a bilinear patch forming one strip of a shared grid, so the whole
+ * mesh, or a cluster of its faces, is shaded in one batch.  Meshes which are
+ * too big for one grid are split into spatially compact clusters sharing the
+ * same points; only meshes which can't be diced this way are split into
+ * individual CqSurfacePointsPolygon objects.
  */
 
 class CqSurfacePointsPolygons : public CqSurface
 {
 	public:
-		CqSurfacePointsPolygons() : m_NumPolys(0)
+		CqSurfacePointsPolygons() : m_NumPolys(0), m_SplitToPolygons(false)
 		{}
 		CqSurfacePointsPolygons(const boost::shared_ptr<CqPolygonPoints>& pPoints, TqInt NumPolys, TqInt nverts[], TqInt verts[]) :
 				m_NumPolys(NumPolys),
-				m_pPoints( pPoints )
+				m_pPoints( pPoints ),
+				m_SplitToPolygons( false )
 		{
 			m_PointCounts.resize( NumPolys );
+			m_MeshIndices.resize( NumPolys );
+			m_FaceVaryingIndices.resize( NumPolys );
 			TqInt i,vindex=0;
 			for( i = 0; i < NumPolys; i++ )
 			{
 				m_PointCounts[i] = nverts[i];
+				m_MeshIndices[i] = i;
+				m_FaceVaryingIndices[i] = vindex;
 				TqInt polyvertex;
 				for( polyvertex = 0; polyvertex < nverts[i]; polyvertex++ )
 					m_PointIndices.push_back( verts[vindex++] );
@@ -575,13 +605,10 @@ class CqSurfacePointsPolygons : public CqSurface
 		/** Get the gemoetric bound of this GPrim.
 		 */
 		virtual	void	Bound(CqBound* bound) const;
-		/** Dice this GPrim.
+		/** Dice the faces as strips of a single grid.
 		 * \return A pointer to a new micropolygrid..
 		 */
-		virtual	CqMicroPolyGridBase* Dice()
-		{
-			return(NULL);
-		}
+		virtual	CqMicroPolyGridBase* Dice();
 		/** Split this GPrim into a number of other GPrims.
 		 * \param aSplits A reference to a CqSurface array to fill in with the new GPrim pointers.
 		 * \return Integer count of new GPrims created.
@@ -589,9 +616,16 @@ class CqSurfacePointsPolygons : public CqSurface
 		virtual	TqInt	Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
 		/** Determine whether this GPrim is diceable at its current size.
 		 */
-		virtual bool	Diceable(const CqMatrix& /*matCtoR*/)
+		virtual bool	Diceable(const CqMatrix& matCtoR);
+		/** Copy the split decision, so that each time slot of a deforming
+		 * mesh splits into the same clusters.
+		 */
+		virtual void	CopySplitInfo( const CqSurface* From )
 		{
-			return( false );
+			CqSurface::CopySplitInfo( From );
+			const CqSurfacePointsPolygons* pFrom = static_cast<const CqSurfacePointsPolygons*>( From );
+			m_SplitToPolygons = pFrom->m_SplitToPolygons;
+			m_SplitOrder = pFrom->m_SplitOrder;
 		}
 
 		virtual void	Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime = 0 )
@@ -599,12 +633,23 @@ class CqSurfacePointsPolygons : public CqSurface
 			assert( m_pPoints );
 			m_pPoints->Transform( matTx, matITTx, matRTx, iTime );
 		}
+		/** Set the instance parameters of this and the shared points.
+		 */
+		virtual	void	SetInstanceParameters( const CqAttributesPtr& pAttributes, const CqTransformPtr& pTransform )
+		{
+			CqSurface::SetInstanceParameters( pAttributes, pTransform );
+			m_pPoints->SetInstanceParameters( pAttributes, pTransform );
+		}
 
 		virtual bool	IsMotionBlurMatch( CqSurface* pSurf )
 		{
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Polygon );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( m_NumPolys );
@@ -627,10 +672,18 @@ class CqSurfacePointsPolygons : public CqSurface
 		virtual CqSurface* Clone() const;
 
 	private:
+		TqInt	SplitToPolygons( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
+		bool	CanDiceFaces() const;
+		void	ChooseSplitOrder();
+
 		TqInt	m_NumPolys;
 		boost::shared_ptr<CqPolygonPoints>	m_pPoints;		///< Pointer to the associated CqPolygonPoints class.
 		std::vector<TqInt>	m_PointCounts;
 		std::vector<TqInt>	m_PointIndices;
+		std::vector<TqInt>	m_MeshIndices;			///< Index of each face in the whole mesh, for uniform values.
+		std::vector<TqInt>	m_FaceVaryingIndices;	///< Start of each face in the facevarying values.
+		bool	m_SplitToPolygons;			///< Split into individual polygons rather than clusters of faces.
+		std::vector<TqInt>	m_SplitOrder;	///< Faces ordered so that each half forms a cluster, empty to split in mesh order.
 };
 
 //-----------------------------------------------------------------------
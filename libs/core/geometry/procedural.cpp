@@ -34,9 +34,8 @@
 #include <cstring>
 #include <list>
 
-#include <boost/tokenizer.hpp>
-
 #include "renderer.h"
+#include <aqsis/riutil/ribarchivecache.h>
 #include <aqsis/util/file.h>
 #include <aqsis/util/plugins.h>
 #include <aqsis/core/corecontext.h>
@@ -44,10 +43,28 @@
 namespace Aqsis {
 
 
+namespace {
+
+/// Deleter calling the free function of a procedural on its data.
+class CqProcFreeData
+{
+	public:
+		CqProcFreeData(RtProcFreeFunc freefunc) : m_pFreeFunc(freefunc) {}
+		void operator()(RtPointer data) const
+		{
+			if( m_pFreeFunc )
+				m_pFreeFunc( data );
+		}
+	private:
+		RtProcFreeFunc m_pFreeFunc;
+};
+
+} // anon. namespace
+
 /**
  * CqProcedural constructor.
  */
-CqProcedural::CqProcedural() : CqSurface()
+CqProcedural::CqProcedural() : CqSurface(), m_pSubdivFunc(0), m_fPrefetched(false)
 {
 	STATS_INC( GEO_prc_created );
 }
@@ -57,10 +74,10 @@ CqProcedural::CqProcedural() : CqSurface()
  */
 CqProcedural::CqProcedural(RtPointer data, CqBound &B, RtProcSubdivFunc subfunc, RtProcFreeFunc freefunc ) : CqSurface()
 {
-	m_pData = data;
+	m_pData = boost::shared_ptr<void>(data, CqProcFreeData(freefunc));
 	m_Bound = B;
 	m_pSubdivFunc = subfunc;
-	m_pFreeFunc = freefunc;
+	m_fPrefetched = false;
 
 	m_pconStored = QGetRenderContext()->pconCurrent();
 
@@ -79,18 +96,22 @@ TqInt CqProcedural::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
 
 	m_pconStored->m_ptransCurrent = m_pTransform;
 
-	/// \note: The bound is in "raster" coordinates by now, as during posting to the imagebuffer
-	/// the the Culling routines do the job for us, see CqSurface::CacheRasterBound.
-	CqBound bound = m_Bound;
-	//    bound.Transform(QGetRenderContext()->matSpaceToSpace("camera", "raster"));
-	float detail = ( bound.vecMax().x() - bound.vecMin().x() ) * ( bound.vecMax().y() - bound.vecMin().y() );
-	//std::cout << "detail: " << detail << std::endl;
-
 	// Call the procedural secific Split()
 	RiAttributeBegin();
 
-	if(m_pSubdivFunc)
-		m_pSubdivFunc(m_pData, detail);
+	boost::shared_ptr<ParsedRibArchive> response;
+	if( m_pRunProgramRequest )
+	{
+		response = QGetRenderContext()->runProgramPool().wait( m_pRunProgramRequest );
+		m_pRunProgramRequest.reset();
+	}
+	if( response )
+	{
+		response->replay( cxxRenderContext()->firstFilter() );
+		STATS_INC( GEO_prc_created_prp );
+	}
+	else if(m_pSubdivFunc)
+		m_pSubdivFunc(m_pData.get(), Detail());
 
 	RiAttributeEnd();
 
@@ -103,6 +124,55 @@ TqInt CqProcedural::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
 }
 
 
+/**
+ * Get the level of detail passed to the procedural, the raster area of its
+ * bound.
+ */
+TqFloat CqProcedural::Detail() const
+{
+	/// \note: The bound is in "raster" coordinates by now, as during posting to the imagebuffer
+	/// the the Culling routines do the job for us, see CqSurface::CacheRasterBound.
+	return ( m_Bound.vecMax().x() - m_Bound.vecMin().x() ) * ( m_Bound.vecMax().y() - m_Bound.vecMin().y() );
+}
+
+
+/**
+ * Start expanding the procedural in the background, ready for Split().  The
+ * archive of a DelayedReadArchive procedural is queued to be parsed, and the
+ * request of a RunProgram procedural is queued for one of the program's
+ * processes.  Other procedurals call back into the renderer as they run, so
+ * can't be expanded ahead of time.
+ */
+void CqProcedural::Prefetch()
+{
+	if( m_fPrefetched )
+		return;
+	m_fPrefetched = true;
+
+	if( m_pSubdivFunc == RiProcRunProgram )
+	{
+		CqRunProgramPool& pool = QGetRenderContext()->runProgramPool();
+		if( !pool.enabled() )
+			return;
+		char** args = static_cast<char**>( m_pData.get() );
+		m_pRunProgramRequest = pool.submit( args[0], args[1], Detail(),
+		                                    QGetRenderContext()->tokenDict() );
+		return;
+	}
+	if( m_pSubdivFunc != RiProcDelayedReadArchive )
+		return;
+
+	CqArchivePrefetcher& prefetcher = QGetRenderContext()->archivePrefetcher();
+	if( !prefetcher.enabled() )
+		return;
+	const char* name = static_cast<char**>( m_pData.get() )[0];
+	boost::filesystem::path path = QGetRenderContext()->poptCurrent()
+		->findRiFileNothrow( name, "archive" );
+	if( !path.empty() )
+		prefetcher.submit( native(path), QGetRenderContext()->tokenDict() );
+}
+
+
 //---------------------------------------------------------------------
 /** Transform the quadric primitive by the specified matrix.
  */
@@ -113,13 +183,27 @@ void    CqProcedural::Transform( const CqMatrix& matTx, const CqMatrix& matITTx,
 }
 
 
+/**
+ * Clone the procedural.  The clone shares the procedural data, so the
+ * procedure may be run once for each clone.
+ */
+CqSurface* CqProcedural::Clone() const
+{
+	CqProcedural* clone = new CqProcedural();
+	CloneData( clone );
+	clone->m_Bound = m_Bound;
+	clone->m_pconStored = m_pconStored;
+	clone->m_pData = m_pData;
+	clone->m_pSubdivFunc = m_pSubdivFunc;
+	return ( clone );
+}
+
+
 /**
  * CqProcedural destructor.
  */
 CqProcedural::~CqProcedural()
 {
-	if( m_pFreeFunc )
-		m_pFreeFunc( m_pData );
 }
 
 
@@ -297,41 +381,15 @@ std::iostream* CqRunProgramRepository::find(const std::string& command)
 	}
 }
 
-/** \brief Split the given command line up into a set of tokens seperated with
- * white space.
- *
- * The splitting isn't very sophisticated, so whitespace cannot currently be
- * escaped.
- */
-void CqRunProgramRepository::splitCommandLine(const std::string& command,
-		std::vector<std::string>& argv)
-{
-	typedef boost::tokenizer<boost::char_separator<char> > TqTokenizer;
-	TqTokenizer tokens(command, boost::char_separator<char>(" \t\n"));
-	for(TqTokenizer::iterator i = tokens.begin(); i != tokens.end(); ++i)
-		argv.push_back(*i);
-}
-
 /** \brief Start a new child process for the given RunProgram command
  */
 TqPopenStream* CqRunProgramRepository::startNewRunProgram(
 		const std::string& command)
 {
 	// Get the program name and command line arguments.
+	std::string progName;
 	std::vector<std::string> argv;
-	splitCommandLine(command, argv);
-	if(argv.empty())
-		AQSIS_THROW_XQERROR(XqValidation, EqE_BadToken, "program name not present");
-	// Attempt to find the program in the procedural path
-	std::string progName = native(QGetRenderContext()->poptCurrent()
-		->findRiFileNothrow(argv[0], "procedural"));
-	if(progName.empty())
-	{
-		progName = argv[0];
-		Aqsis::log() << info
-			<< "RiProcRunProgram: Could not find \"" << progName
-			<< "\" in \"procedural\" searchpath, will rely on system path.\n";
-	}
+	findRunProgram(command, progName, argv);
 	try
 	{
 		// Attempt to open a pipe to the new procedural.
@@ -35,6 +35,7 @@
 
 #include <aqsis/math/matrix.h>
 #include <aqsis/util/popen.h>
+#include "runprogrampool.h"
 #include "surface.h"
 
 namespace Aqsis {
@@ -54,6 +55,11 @@ class CqProcedural : public CqSurface
 		 * \return Integer count of new GPrims created.
 		 */
 		virtual	TqInt	Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
+		/** Queue the archive of a DelayedReadArchive procedural to be parsed
+		 * in the background, or the request of a RunProgram procedural to be
+		 * sent to its program.
+		 */
+		virtual	void	Prefetch();
 		virtual ~CqProcedural();
 
 		//---------------------------------------------- Inlined Public Methods
@@ -106,20 +112,24 @@ class CqProcedural : public CqSurface
 		{
 			return ( 0 );
 		}
-		virtual CqSurface* Clone() const
-		{
-			//return(new CqProcedural(*this));
-			return(NULL);
-		}
+		virtual CqSurface* Clone() const;
 		//------------------------------------------------------ Protexted
 	protected:
 		/* Contexy saved when the Procedural was declared */
 		boost::shared_ptr<CqModeBlock> m_pconStored;
 
-		/* The RIB request data */
-		RtPointer m_pData;
+		/* The RIB request data, shared between clones and freed with the
+		 * last of them. */
+		boost::shared_ptr<void> m_pData;
 		RtProcSubdivFunc m_pSubdivFunc;
-		RtProcFreeFunc m_pFreeFunc;
+		/* Whether Prefetch() has been called already */
+		bool m_fPrefetched;
+		/* Request queued with the RunProgram pool by Prefetch(); not shared
+		 * with clones. */
+		CqRunProgramPool::TqRequestPtr m_pRunProgramRequest;
+
+	private:
+		TqFloat	Detail() const;
 
 };
 
@@ -160,9 +170,6 @@ class CqRunProgramRepository
 		typedef boost::shared_ptr<TqPopenStream> TqPopenStreamPtr;
 		typedef std::map<std::string, TqPopenStreamPtr> TqRunProgramMap;
 
-		static void splitCommandLine(const std::string& command,
-				std::vector<std::string>& argv);
-
 		TqPopenStream* startNewRunProgram(const std::string& command);
 
 		/// Set of active pipes for child processes.
@@ -3,6 +3,7 @@ set(geometry_srcs
 	bunny.cpp
 	cubiccurves.cpp
 	curves.cpp
+	instance.cpp
 	jules_bloomenthal.cpp
 	lath.cpp
 	linearcurves.cpp
@@ -14,6 +15,7 @@ set(geometry_srcs
 	procedural.cpp
 	quadrics.cpp
 	subdivision2.cpp
+	subdivstencils.cpp
 	surface.cpp
 	teapot.cpp
 	trimcurve.cpp
@@ -24,6 +26,7 @@ set(geometry_hdrs
 	blobby.h
 	bunny.h
 	curves.h
+	instance.h
 	jules_bloomenthal.h
 	kdtree.h
 	lath.h
@@ -36,6 +39,7 @@ set(geometry_hdrs
 	procedural.h
 	quadrics.h
 	subdivision2.h
+	subdivstencils.h
 	surface.h
 	teapot.h
 	trimcurve.h
@@ -44,3 +48,9 @@ make_absolute(geometry_hdrs ${geometry_SOURCE_DIR})
 
 include_directories(${geometry_SOURCE_DIR})
 
+set(geometry_test_srcs
+	instance_test.cpp
+	subdivstencils_test.cpp
+)
+make_absolute(geometry_test_srcs ${geometry_SOURCE_DIR})
+
@@ -51,6 +51,10 @@ class CqQuadric : public CqSurface
 
 		CqBound	MotionBound(CqBound&	B) const;
 		virtual void	Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime = 0 );
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Quadric );
+		}
 		/** Get the number of uniform values for this GPrim.
 		 */
 		virtual	TqUint	cUniform() const
@@ -25,6 +25,7 @@
 
 #include	"subdivision2.h"
 
+#include	<algorithm>
 #include	<fstream>
 #include	<vector>
 
@@ -42,6 +43,9 @@ namespace Aqsis {
 
 CqSubdivision2::CqSubdivision2( )
 		: CqMotionSpec<boost::shared_ptr<CqPolygonPoints> >( boost::shared_ptr<CqPolygonPoints>() ),
+		m_cLaths(0),
+		m_cLastBlockUsed(0),
+		m_nextBlockSize(256),
 		m_bInterpolateBoundary( false ),
 		m_faceVertexParams(),
 		m_fFinalised(false)
@@ -55,6 +59,9 @@ CqSubdivision2::CqSubdivision2( )
 
 CqSubdivision2::CqSubdivision2( const boost::shared_ptr<CqPolygonPoints>& pPoints )
 	:  CqMotionSpec<boost::shared_ptr<CqPolygonPoints> >(pPoints),
+	m_cLaths(0),
+	m_cLastBlockUsed(0),
+	m_nextBlockSize(256),
 	m_bInterpolateBoundary( false ),
 	m_faceVertexParams(),
 	m_fFinalised(false)
@@ -81,10 +88,97 @@ CqSubdivision2::CqSubdivision2( const boost::shared_ptr<CqPolygonPoints>& pPoint
 
 CqSubdivision2::~CqSubdivision2()
 {
-	// Delete the array of laths generated during the facet adding phase.
-	for(std::vector<CqLath*>::const_iterator iLath=apLaths().begin(); iLath!=apLaths().end(); iLath++)
-		if(*iLath)
-			delete(*iLath);
+	// Release the blocks of laths generated during the facet adding and
+	// subdivision phases.
+	for(std::vector<SqLathBlock>::const_iterator iBlock = m_lathBlocks.begin();
+			iBlock != m_lathBlocks.end(); ++iBlock)
+		delete[] iBlock->laths;
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Get a pointer to the lath with the specified index.
+ *	Laths are numbered in the order they were created.  Asserts if the index
+ *	is invalid.
+ *
+ *	@param	iIndex	Index of the lath.
+ *
+ *	@return			Pointer to the lath.
+ */
+CqLath* CqSubdivision2::pLath(TqInt iIndex)
+{
+	assert(iIndex >= 0 && iIndex < m_cLaths);
+	std::vector<SqLathBlock>::const_iterator iBlock = m_lathBlocks.begin();
+	while(iIndex >= iBlock->size)
+	{
+		iIndex -= iBlock->size;
+		++iBlock;
+	}
+	return(iBlock->laths + iIndex);
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Prepare the lath arena to receive a number of new laths.
+ *	Making sure the next block is large enough for the whole control hull
+ *	avoids growing the arena a piece at a time for large meshes.
+ *
+ *	@param	cLaths	The number of laths which will be added.
+ */
+void CqSubdivision2::ReserveLaths(TqInt cLaths)
+{
+	TqInt cFree = m_lathBlocks.empty() ? 0 : m_lathBlocks.back().size - m_cLastBlockUsed;
+	if(cLaths - cFree > m_nextBlockSize)
+		m_nextBlockSize = cLaths - cFree;
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Create a new lath in the lath arena.
+ *	Laths are never moved or freed individually, so the returned pointer is
+ *	valid for the lifetime of the topology.
+ *
+ *	@param	iV		Index of the vertex the lath references.
+ *	@param	iFV		Index of the face vertex the lath references.
+ *
+ *	@return			Pointer to the new lath.
+ */
+CqLath* CqSubdivision2::NewLath(TqInt iV, TqInt iFV)
+{
+	if(m_lathBlocks.empty() || m_cLastBlockUsed == m_lathBlocks.back().size)
+	{
+		SqLathBlock block;
+		block.laths = new CqLath[m_nextBlockSize];
+		block.size = m_nextBlockSize;
+		m_lathBlocks.push_back(block);
+		m_cLastBlockUsed = 0;
+		// Grow the blocks geometrically, while limiting the waste at the end
+		// of the last one.
+		m_nextBlockSize = min(2*m_nextBlockSize, 65536);
+	}
+	CqLath* pLath = m_lathBlocks.back().laths + m_cLastBlockUsed;
+	++m_cLastBlockUsed;
+	++m_cLaths;
+	pLath->SetVertexIndex(iV);
+	pLath->SetFaceVertexIndex(iFV);
+	return(pLath);
+}
+
+
+//------------------------------------------------------------------------------
+/**
+ *	Add a lath to the list of those referencing its vertex.
+ *
+ *	@param	pLath	The lath, which must already have its vertex index set.
+ */
+void CqSubdivision2::AddVertexLath(CqLath* pLath)
+{
+	CqLath*& pHead = m_apVertexLaths[pLath->VertexIndex()];
+	pLath->SetpNextVertexLath(pHead);
+	pHead = pLath;
 }
 
 
@@ -116,8 +210,8 @@ CqLath* CqSubdivision2::pFacet(TqInt iIndex)
  */
 CqLath* CqSubdivision2::pVertex(TqInt iIndex)
 {
-	assert(iIndex < static_cast<TqInt>(m_aapVertices.size()) && m_aapVertices[iIndex].size() >= 1);
-	return(m_aapVertices[iIndex][0]);
+	assert(iIndex < static_cast<TqInt>(m_apVertexLaths.size()) && m_apVertexLaths[iIndex]);
+	return(m_apVertexLaths[iIndex]);
 }
 
 //------------------------------------------------------------------------------
@@ -148,8 +242,8 @@ const CqLath* CqSubdivision2::pFacet(TqInt iIndex) const
  */
 const CqLath* CqSubdivision2::pVertex(TqInt iIndex) const
 {
-	assert(iIndex < static_cast<TqInt>(m_aapVertices.size()) && m_aapVertices[iIndex].size() >= 1);
-	return(m_aapVertices[iIndex][0]);
+	assert(iIndex < static_cast<TqInt>(m_apVertexLaths.size()) && m_apVertexLaths[iIndex]);
+	return(m_apVertexLaths[iIndex]);
 }
 
 
@@ -164,12 +258,13 @@ const CqLath* CqSubdivision2::pVertex(TqInt iIndex) const
 void CqSubdivision2::Prepare(TqInt cVerts)
 {
 	// Initialise the array of vertex indexes to the appropriate size.
-	m_aapVertices.resize(cVerts);
+	m_apVertexLaths.resize(cVerts, NULL);
 
 	m_fFinalised=false;
 }
 
-CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
+template<typename MaskT>
+void CqSubdivision2::limitMask(CqLath* vert, MaskT& mask)
 {
 	// To compute the limit point, we make use of a limit mask for
 	// Catmull-Clark subdivision.  For the standard Catmull-Clark scheme this
@@ -196,12 +291,14 @@ CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
 	// * For sharp corners the vertex is stationary under subdivision so this
 	//   case is trivial.
 
-	const CqVector3D vPos = vectorCast<CqVector3D>(
-			pPoints()->P()->pValue()[vert->VertexIndex()]);
+	const TqInt iV = vert->VertexIndex();
 
 	// Sharp corners don't move under subdivision; just return them.
 	if(CornerSharpness(vert) > 0.0f)
-		return vPos;
+	{
+		mask(iV, 1.0f);
+		return;
+	}
 
 	// We need to make sure that all parent faces of vert are subdivided, since
 	// we need the positions as input to the limit point calculation.
@@ -216,10 +313,8 @@ CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
 			v = v->cf();
 		} while(v != v0);
 	}
-	// Grab a pointer to the positions.  It's very important that we do this
-	// *after* the possible subdivision steps above, or the array may have been
-	// reallocated.
-	const CqVector4D* P = pPoints()->P()->pValue();
+	// Note that the subdivision above may have added vertices, so the mask
+	// must not hold on to pointers into the vertex data from before it.
 
 	if(vert->isBoundaryVertex())
 	{
@@ -275,7 +370,8 @@ CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
 		{
 			// Special case for corner vertices - these don't move under
 			// subdivision
-			return vPos;
+			mask(iV, 1.0f);
+			return;
 		}
 
 		// Now we know we're on a boundary with more than two edges
@@ -284,15 +380,15 @@ CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
 		const CqLath* v = vert;
 		while(v->cv())
 			v = v->cv();
-		CqVector3D edgeSum = vectorCast<CqVector3D>(P[v->ccf()->VertexIndex()]);
+		mask(v->ccf()->VertexIndex(), 1.0f/6);
 
 		// get anticlocwise edge vertex, e2
 		v = vert;
 		while(v->ccv())
 			v = v->ccv();
-		edgeSum += vectorCast<CqVector3D>(P[v->cf()->VertexIndex()]);
+		mask(v->cf()->VertexIndex(), 1.0f/6);
 
-		return (4.0/6)*vPos + (1.0/6)*edgeSum;
+		mask(iV, 4.0f/6);
 	}
 	else
 	{
@@ -345,50 +441,71 @@ CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
 		//   Technical Report TR02-001, UNC-Chapel Hill.
 		//
 
+		const TqInt numEdges = vert->cQvf();
+		const TqFloat scale = 1.0f/(numEdges*(numEdges+5));
+		mask(iV, numEdges*numEdges*scale);
 		const CqLath* faceVert = vert;
-		CqVector3D eSum;
-		CqVector3D fSum;
-		TqInt numEdges = 0;
 		do
 		{
 			// Add edge onto edge sum.
 			const CqLath* const e = faceVert->cf();
-			eSum += vectorCast<CqVector3D>(P[e->VertexIndex()]);
+			mask(e->VertexIndex(), 4*scale);
 			// Add up remaining face verts.  For a quad mesh there will only be
 			// one of these.
 			// Add face vert to face sum.
 			const CqLath* f = e->cf();
 			if(f->cf()->cf() == faceVert)
 			{
-				fSum += vectorCast<CqVector3D>(P[f->VertexIndex()]);
+				mask(f->VertexIndex(), scale);
 			}
 			else
 			{
 				// This is the special case of a non-quadrilateral face.  As
 				// described abeove, we need to compute the sum of the
 				// additional vertices.
-				CqVector3D gSum;
-				TqInt numVerts = 3;
 				const CqLath* const eNext = faceVert->ccf();
-				while(f != eNext)
-				{
-					gSum += vectorCast<CqVector3D>(P[f->VertexIndex()]);
+				TqInt numVerts = 3;
+				for(const CqLath* g = f; g != eNext; g = g->cf())
 					++numVerts;
-					f = f->cf();
-				}
-				fSum += (4.0/numVerts - 1) * ( vPos
-						+ vectorCast<CqVector3D>(P[e->VertexIndex()])
-						+ vectorCast<CqVector3D>(P[eNext->VertexIndex()]) )
-					+ 4.0/numVerts*gSum;
+				const TqFloat cornerWeight = (4.0f/numVerts - 1)*scale;
+				mask(iV, cornerWeight);
+				mask(e->VertexIndex(), cornerWeight);
+				mask(eNext->VertexIndex(), cornerWeight);
+				for(; f != eNext; f = f->cf())
+					mask(f->VertexIndex(), 4.0f/numVerts*scale);
 			}
 
 			faceVert = faceVert->cv();
-			++numEdges;
 		}
 		while(faceVert != vert);
+	}
+}
+
+//------------------------------------------------------------------------------
+namespace {
 
-		return 1.0/(numEdges*(numEdges+5)) * (numEdges*numEdges*vPos + 4*eSum + fSum);
+/// Limit mask functor which sums the positions of the masked vertices.
+struct SqLimitPointSum
+{
+	SqLimitPointSum(const CqParameterTyped<CqVector4D, CqVector3D>* pP)
+		: pP(pP),
+		sum()
+	{}
+	void operator()(TqInt iVertex, TqFloat weight)
+	{
+		sum += weight*vectorCast<CqVector3D>(pP->pValue(iVertex)[0]);
 	}
+	const CqParameterTyped<CqVector4D, CqVector3D>* pP;
+	CqVector3D sum;
+};
+
+} // unnamed namespace
+
+CqVector3D CqSubdivision2::limitPoint(CqLath* vert)
+{
+	SqLimitPointSum limitSum(pPoints()->P());
+	limitMask(vert, limitSum);
+	return limitSum.sum;
 }
 
 //------------------------------------------------------------------------------
@@ -412,10 +529,7 @@ inline bool isDiscontinuousFaceVertex(const CqParameterTyped<TypeA, TypeB>* pPar
 {
 	TypeA currVertVal = pParam->pValue(pVert->FaceVertexIndex())[arrayIndex];
 	// Get the facets which share this vertex.
-	std::vector<CqLath*> aQvf;
-	pVert->Qvf(aQvf);
-	for(std::vector<CqLath*>::const_iterator iVf = aQvf.begin();
-			iVf != aQvf.end(); ++iVf)
+	for(CqVertexLathIterator iVf(pVert); !iVf.atEnd(); ++iVf)
 	{
 		if(!isClose(currVertVal, pParam->pValue((*iVf)->FaceVertexIndex())[arrayIndex]))
 			return true;
@@ -500,10 +614,8 @@ void CqSubdivision2::CreateVertex(CqParameter* pParamToModify,
 				// The vertex is on a boundary.
 				/// \note If "interpolateboundary" is not specified, we will never see this as
 				/// the boundary facets aren't rendered. So we don't need to check for "interpolateboundary" here.
-				std::vector<CqLath*> apQve;
-				pVertex->Qve(apQve);
 				// Is the valence == 2 ?
-				if( apQve.size() == 2 )
+				if( pVertex->cQve() == 2 )
 				{
 					// Yes, boundary with valence 2 is corner.
 					pParam->pValue( iIndex )[arrayindex] = pParam->pValue( (pVertex->*IndexFunction)() )[arrayindex];
@@ -512,12 +624,8 @@ void CqSubdivision2::CreateVertex(CqParameter* pParamToModify,
 				{
 					// No, boundary is average of two adjacent boundary edges, and original point.
 					// Get the midpoints of the adjacent boundary edges
-					std::vector<CqLath*> aQve;
-					pVertex->Qve( aQve );
-
 					TqInt cBoundaryEdges = 0;
-					std::vector<CqLath*>::iterator iE;
-					for( iE = aQve.begin(); iE != aQve.end(); iE++ )
+					for( CqVertexLathIterator iE( pVertex, true ); !iE.atEnd(); ++iE )
 					{
 						// Only consider the boundary edges.
 						if( NULL == (*iE)->ec() )
@@ -547,15 +655,12 @@ void CqSubdivision2::CreateVertex(CqParameter* pParamToModify,
 				else
 				{
 					// Check if crease vertex.
-					std::vector<CqLath*> aQve;
-					pVertex->Qve( aQve );
-
 					CqLath* hardEdge1 = NULL;
 					CqLath* hardEdge2 = NULL;
 					CqLath* hardEdge3 = NULL;
 					TqInt se = 0;
-					std::vector<CqLath*>::iterator iEdge;
-					for( iEdge = aQve.begin(); iEdge != aQve.end(); iEdge++ )
+					n = 0;
+					for( CqVertexLathIterator iEdge( pVertex, true ); !iEdge.atEnd(); ++iEdge, ++n )
 					{
 						float h = EdgeSharpness( (*iEdge) );
 						if( hardEdge1 == NULL || h > EdgeSharpness(hardEdge1) )
@@ -595,31 +700,30 @@ void CqSubdivision2::CreateVertex(CqParameter* pParamToModify,
 					// S = old vertex
 					// n = number of edges sharing the old vertex.
 
-					n = aQve.size();
-
 					// Get the face points of the surrounding faces
-					std::vector<CqLath*> aQvf;
-					pVertex->Qvf( aQvf );
-					std::vector<CqLath*>::iterator iF;
-					for( iF = aQvf.begin(); iF != aQvf.end(); iF++ )
+					TqInt cFaces = 0;
+					for( CqVertexLathIterator iF( pVertex ); !iF.atEnd(); ++iF, ++cFaces )
 					{
-						std::vector<CqLath*> aQfv;
-						(*iF)->Qfv(aQfv);
-						std::vector<CqLath*>::iterator iV;
 						TypeA Val = TypeA(0.0f);
-						for( iV = aQfv.begin(); iV != aQfv.end(); iV++ )
-							Val += pParam->pValue( ((*iV)->*IndexFunction)() )[arrayindex];
-						Val = static_cast<TypeA>( Val / static_cast<TqFloat>( aQfv.size() ) );
+						TqInt cFaceVerts = 0;
+						CqLath* pV = *iF;
+						do
+						{
+							Val += pParam->pValue( (pV->*IndexFunction)() )[arrayindex];
+							pV = pV->cf();
+							++cFaceVerts;
+						}
+						while( pV != *iF );
+						Val = static_cast<TypeA>( Val / static_cast<TqFloat>( cFaceVerts ) );
 						Q += Val;
 					}
-					Q /= aQvf.size();
+					Q /= cFaces;
 					Q /= n;
 
 					// Get the midpoints of the surrounding edges
 					TypeA A = pParam->pValue( (pVertex->*IndexFunction)() )[arrayindex];
 					TypeA B = TypeA(0.0f);
-					std::vector<CqLath*>::iterator iE;
-					for( iE = aQve.begin(); iE != aQve.end(); iE++ )
+					for( CqVertexLathIterator iE( pVertex, true ); !iE.atEnd(); ++iE )
 					{
 						B = pParam->pValue( ((*iE)->ccf()->*IndexFunction)() )[arrayindex];
 						R += static_cast<TypeA>( (A+B)/2.0f );
@@ -743,7 +847,7 @@ void CqSubdivision2::AddVertex(CqLath* pVertex, TqInt& iVIndex, TqInt& iFVIndex)
 					iVIndex = iIndex;
 					( *iUP )->SetSize( iIndex+1 );
 					// Resize the vertex lath
-					m_aapVertices.resize(iVIndex+1);
+					m_apVertexLaths.resize(iVIndex+1, NULL);
 				}
 				else
 					continue;
@@ -822,7 +926,7 @@ void CqSubdivision2::DuplicateVertex(CqLath* pVertex, TqInt& iVIndex, TqInt& iFV
 					iVIndex = iIndex;
 					( *iUP )->SetSize( iIndex+1 );
 					// Resize the vertex lath
-					m_aapVertices.resize(iVIndex+1);
+					m_apVertexLaths.resize(iVIndex+1, NULL);
 				}
 				else
 					continue;
@@ -906,21 +1010,25 @@ void CqSubdivision2::CreateEdgeVertex(CqParameter* pParamToModify,
 			{
 				// Edge point is the average of the centrepoint of the original edge and the
 				// average of the two new face points of the adjacent faces.
-				std::vector<CqLath*> aQef;
-				pEdge->Qef( aQef );
-				std::vector<CqLath*>::iterator iF;
-				for( iF = aQef.begin(); iF != aQef.end(); iF++ )
+				// The edge isn't a boundary, so the faces are given by the edge
+				// and its companion, as in Qef.
+				CqLath* const aEdgeFaces[2] = { pEdge, pEdge->ec() };
+				for( TqInt iF = 0; iF < 2; iF++ )
 				{
-					std::vector<CqLath*> aQfv;
-					(*iF)->Qfv(aQfv);
-					std::vector<CqLath*>::iterator iV;
 					TypeA Val = TypeA(0.0f);
-					for( iV = aQfv.begin(); iV != aQfv.end(); iV++ )
-						Val += pParam->pValue( ((*iV)->*IndexFunction)() )[arrayindex];
-					Val = static_cast<TypeA>( Val / static_cast<TqFloat>( aQfv.size() ) );
+					TqInt cFaceVerts = 0;
+					CqLath* pV = aEdgeFaces[iF];
+					do
+					{
+						Val += pParam->pValue( (pV->*IndexFunction)() )[arrayindex];
+						pV = pV->cf();
+						++cFaceVerts;
+					}
+					while( pV != aEdgeFaces[iF] );
+					Val = static_cast<TypeA>( Val / static_cast<TqFloat>( cFaceVerts ) );
 					C += Val;
 				}
-				C = static_cast<TypeA>( C / static_cast<TqFloat>(aQef.size()) );
+				C = static_cast<TypeA>( C / 2.0f );
 
 				A = pParam->pValue( (pEdge->*IndexFunction)() )[arrayindex];
 				B = pParam->pValue( (pEdge->ccf()->*IndexFunction)() )[arrayindex];
@@ -987,7 +1095,7 @@ void CqSubdivision2::AddEdgeVertex(CqLath* pVertex, TqInt& iVIndex, TqInt& iFVIn
 					iVIndex=iIndex;
 					( *iUP )->SetSize( iIndex+1 );
 					// Resize the vertex lath
-					m_aapVertices.resize(iVIndex+1);
+					m_apVertexLaths.resize(iVIndex+1, NULL);
 				}
 				else
 					continue;
@@ -1049,20 +1157,22 @@ void CqSubdivision2::CreateFaceVertex(CqParameter* pParamToModify,
 	else
 		IndexFunction = &CqLath::FaceVertexIndex;
 	// Face point is just the average of the original faces vertices.
-	std::vector<CqLath*> aQfv;
-	pFace->Qfv(aQfv);
 	for(TqInt arrayindex = 0, arraysize = pParam->Count();
 			arrayindex < arraysize; arrayindex++ )
 	{
-		std::vector<CqLath*>::iterator iV;
 		TypeA Val = TypeA(0.0f);
-		for( iV = aQfv.begin(); iV != aQfv.end(); iV++ )
+		TqInt cFaceVerts = 0;
+		CqLath* pV = pFace;
+		do
 		{
-			assert( ((*iV)->*IndexFunction)() >= 0 &&
-					((*iV)->*IndexFunction)() < static_cast<TqInt>(pParam->Size()) );
-			Val += pParam->pValue( ((*iV)->*IndexFunction)() )[arrayindex];
+			assert( (pV->*IndexFunction)() >= 0 &&
+					(pV->*IndexFunction)() < static_cast<TqInt>(pParam->Size()) );
+			Val += pParam->pValue( (pV->*IndexFunction)() )[arrayindex];
+			pV = pV->cf();
+			++cFaceVerts;
 		}
-		Val = static_cast<TypeA>( Val / static_cast<TqFloat>( aQfv.size() ) );
+		while( pV != pFace );
+		Val = static_cast<TypeA>( Val / static_cast<TqFloat>( cFaceVerts ) );
 		pParam->pValue( iIndex )[arrayindex] = Val;
 	}
 }
@@ -1138,7 +1248,7 @@ void CqSubdivision2::AddFaceVertex(CqLath* pVertex, TqInt& iVIndex, TqInt& iFVIn
 	}
 
 	// Resize the vertex lath
-	m_aapVertices.resize(iVIndex+1);
+	m_apVertexLaths.resize(iVIndex+1, NULL);
 }
 
 
@@ -1164,21 +1274,18 @@ CqLath* CqSubdivision2::AddFacet(TqInt cVerts, TqInt* pIndices, TqInt iFVIndex)
 	// Add the laths for this facet, referencing the appropriate vertexes as we go.
 	for(TqInt iVert = 0; iVert < cVerts; iVert++)
 	{
-		CqLath* pNewLath = new CqLath();
-		pNewLath->SetVertexIndex(pIndices[iVert]);
-		pNewLath->SetFaceVertexIndex(iFVIndex+iVert);
+		CqLath* pNewLath = NewLath(pIndices[iVert], iFVIndex+iVert);
 
 		if(pLastLath)
 			pNewLath->SetpClockwiseFacet(pLastLath);
 
-		m_apLaths.push_back(pNewLath);
 		pLastLath = pNewLath;
 		if(iVert == 0)
 			pFirstLath = pLastLath;
 
 		// We also need to keep up to date a complete list of which laths refer to which
 		// vertices to aid us in finalising the topology structure later.
-		m_aapVertices[pIndices[iVert]].push_back(pLastLath);
+		AddVertexLath(pLastLath);
 	}
 	// complete the chain by linking the last one as the next clockwise one to the first.
 	pFirstLath->SetpClockwiseFacet(pLastLath);
@@ -1212,21 +1319,18 @@ CqLath* CqSubdivision2::AddFacet(TqInt cVerts, TqInt* pIndices, TqInt* pFVIndice
 	// Add the laths for this facet, referencing the appropriate vertexes as we go.
 	for(TqInt iVert = 0; iVert < cVerts; iVert++)
 	{
-		CqLath* pNewLath = new CqLath();
-		pNewLath->SetVertexIndex(pIndices[iVert]);
-		pNewLath->SetFaceVertexIndex(pFVIndices[iVert]);
+		CqLath* pNewLath = NewLath(pIndices[iVert], pFVIndices[iVert]);
 
 		if(pLastLath)
 			pNewLath->SetpClockwiseFacet(pLastLath);
 
-		m_apLaths.push_back(pNewLath);
 		pLastLath = pNewLath;
 		if(iVert == 0)
 			pFirstLath = pLastLath;
 
 		// We also need to keep up to date a complete list of which laths refer to which
 		// vertices to aid us in finalising the topology structure later.
-		m_aapVertices[pIndices[iVert]].push_back(pLastLath);
+		AddVertexLath(pLastLath);
 	}
 	// complete the chain by linking the last one as the next clockwise one to the first.
 	pFirstLath->SetpClockwiseFacet(pLastLath);
@@ -1251,25 +1355,25 @@ CqSubdivision2* CqSubdivision2::Clone() const
 	clone->m_mapHoles = m_mapHoles;
 
 	// Create the faces in the new surface.
+	clone->ReserveLaths(cLaths());
+	std::vector<TqInt> aV;
+	std::vector<TqInt> aFV;
 	TqInt i;
 	for(i=0; i<cFacets(); i++)
 	{
 		// Read the facet indices.
 		const CqLath* faceLath = pFacet(i);
-		std::vector<const CqLath*> Qfv;
-		faceLath->Qfv(Qfv);
-		TqInt* pV = new TqInt[Qfv.size()];
-		TqInt* pFV = new TqInt[Qfv.size()];
-		std::vector<const CqLath*>::iterator j;
-		TqInt index = 0;
-		for(j=Qfv.begin(); j!=Qfv.end(); j++, index++)
+		const CqLath* pV = faceLath;
+		aV.clear();
+		aFV.clear();
+		do
 		{
-			pV[index] = (*j)->VertexIndex();
-			pFV[index] = (*j)->FaceVertexIndex();
+			aV.push_back(pV->VertexIndex());
+			aFV.push_back(pV->FaceVertexIndex());
+			pV = pV->cf();
 		}
-		clone->AddFacet(Qfv.size(), pV, pFV);
-		delete[](pV);
-		delete[](pFV);
+		while(pV != faceLath);
+		clone->AddFacet(aV.size(), &aV[0], &aFV[0]);
 	}
 	clone->Finalise();
 
@@ -1292,25 +1396,30 @@ bool CqSubdivision2::Finalise()
 	const CqString* pattrName = pPoints()->pAttributes()->GetStringAttribute( "identifier", "name" );
 	if ( pattrName != 0 )
 		objname = pattrName[ 0 ];
-	std::vector<std::vector<CqLath*> >::iterator ivert;
-	for(TqInt i = 0; i < static_cast<TqInt>(m_aapVertices.size()); ++i)
+	// Scratch list of the laths on each vertex, reused to avoid allocating
+	// for every vertex of the mesh.
+	std::vector<CqLath*> aVertLaths;
+	std::vector<bool>  aVisited;
+	for(TqInt i = 0; i < static_cast<TqInt>(m_apVertexLaths.size()); ++i)
 	{
-		ivert = m_aapVertices.begin() + i;
-		TqInt cLaths = (*ivert).size();
+		// Gather the laths on this vertex in the order they were added.
+		aVertLaths.clear();
+		for(CqLath* pLath = m_apVertexLaths[i]; pLath; pLath = pLath->pNextVertexLath())
+			aVertLaths.push_back(pLath);
+		std::reverse(aVertLaths.begin(), aVertLaths.end());
+		TqInt cLaths = aVertLaths.size();
 
 		// If there is only one lath, it can't be connected to anything.
 		if(cLaths<=1)
 			continue;
 
 		// Create an array for the laths on this vertex that have been visited.
-		std::vector<bool>  aVisited;
-		aVisited.resize(cLaths);
 		TqInt cVisited = 0;
 
 		// Initialise it to all false.
 		aVisited.assign(cLaths, false);
 
-		CqLath* pCurrent = (*ivert)[0];
+		CqLath* pCurrent = aVertLaths[0];
 		CqLath* pStart = pCurrent;
 		TqInt iCurrent = 0;
 		TqInt iStart = 0;
@@ -1324,10 +1433,10 @@ bool CqSubdivision2::Finalise()
 			for(iLath = 0; iLath < cLaths; iLath++)
 			{
 				// Only check non-visited laths.
-				if(!aVisited[iLath] && (*ivert)[iLath]->cf()->VertexIndex() == ccwVertex)
+				if(!aVisited[iLath] && aVertLaths[iLath]->cf()->VertexIndex() == ccwVertex)
 				{
-					pCurrent->SetpClockwiseVertex((*ivert)[iLath]);
-					pCurrent = (*ivert)[iLath];
+					pCurrent->SetpClockwiseVertex(aVertLaths[iLath]);
+					pCurrent = aVertLaths[iLath];
 					iCurrent = iLath;
 					// Mark the linked to lath as visited.
 					aVisited[iLath] = true;
@@ -1353,14 +1462,14 @@ bool CqSubdivision2::Finalise()
 				for(iLath = 0; iLath < cLaths; iLath++)
 				{
 					// Only check non-visited laths.
-					if(!aVisited[iLath] && (*ivert)[iLath]->ccf()->VertexIndex() == cwVertex)
+					if(!aVisited[iLath] && aVertLaths[iLath]->ccf()->VertexIndex() == cwVertex)
 					{
 						// Link the current to the match.
-						(*ivert)[iLath]->SetpClockwiseVertex(pStart);
+						aVertLaths[iLath]->SetpClockwiseVertex(pStart);
 						// Mark the linked to lath as visited.
 						aVisited[iStart] = true;
 						cVisited++;
-						pStart = (*ivert)[iLath];
+						pStart = aVertLaths[iLath];
 						iStart = iLath;
 
 						break;
@@ -1381,18 +1490,18 @@ bool CqSubdivision2::Finalise()
 			TqInt iNewVert=-1, iNewFVert;
 			DuplicateVertex(pCurrent, iNewVert, iNewFVert);
 			
-			for(TqInt iLath = 0; iLath < static_cast<TqInt>(m_aapVertices[i].size()); ++iLath)
+			// Rebuild the lath lists of both vertices; the new vertex will
+			// be linked up when the loop reaches it.
+			m_apVertexLaths[i] = NULL;
+			for(TqInt iLath = cLaths-1; iLath >= 0; --iLath)
 			{
+				CqLath* pLath = aVertLaths[iLath];
 				if(!aVisited[iLath])
 				{
-					std::vector<CqLath*>::iterator lath = m_aapVertices[i].begin() + iLath;
-					(*lath)->SetVertexIndex(iNewVert);
-					(*lath)->SetFaceVertexIndex(iNewFVert);
-					m_aapVertices[iNewVert].push_back((*lath));
-					m_aapVertices[i].erase(lath);
-					aVisited.erase(aVisited.begin() + iLath);
-					--iLath;
+					pLath->SetVertexIndex(iNewVert);
+					pLath->SetFaceVertexIndex(iNewFVert);
 				}
+				AddVertexLath(pLath);
 			}
 		}
 	}
@@ -1416,16 +1525,13 @@ void CqSubdivision2::SubdivideFace(CqLath* pFace, std::vector<CqLath*>& apSubFac
 	if( pFace->pFaceVertex() )
 	{
 		apSubFaces.clear();
-		std::vector<CqLath*> aQvf;
-		pFace->pFaceVertex()->Qvf(aQvf);
 		// Fill in the lath references for the starting points of the faces.
 		// Reorder them so that they are all in the same orientaion as their parent, if possible.
 		// This is due to the fact that the subdivision algorithm results in 4 quads with the '2' vertex
 		// in the middle point, we need to rotate them to restore the original orientation by choosing the
 		// next one round for each subsequent quad.
-		std::vector<CqLath*>::iterator iVF;
 		TqInt i = 0;
-		for( iVF = aQvf.begin(); iVF != aQvf.end(); iVF++, i++ )
+		for( CqVertexLathIterator iVF( pFace->pFaceVertex() ); !iVF.atEnd(); ++iVF, i++ )
 		{
 			CqLath* pLathF = (*iVF)->ccf()->ccf();
 			TqInt r = i;
@@ -1442,13 +1548,14 @@ void CqSubdivision2::SubdivideFace(CqLath* pFace, std::vector<CqLath*>& apSubFac
 		// loop through all our neighbour faces.
 		// we don't use Qff here because we can handle multiple copies
 		// of each face faster than it can.
-		std::vector<CqLath*> parentVertices;
-		pFace->pParentFacet()->Qfv( parentVertices );
-
-		std::vector<CqLath*>::iterator vertexIt;
-		std::vector<CqLath*>::iterator vertexEnd = parentVertices.end();
-		for( vertexIt = parentVertices.begin(); vertexIt != vertexEnd; ++vertexIt )
-			subdivideNeighbourFaces(*vertexIt);
+		CqLath* const pParent = pFace->pParentFacet();
+		CqLath* pParentVertex = pParent;
+		do
+		{
+			subdivideNeighbourFaces(pParentVertex);
+			pParentVertex = pParentVertex->cf();
+		}
+		while( pParentVertex != pParent );
 	}
 
 	std::vector<CqLath*> aQfv;
@@ -1515,14 +1622,10 @@ void CqSubdivision2::SubdivideFace(CqLath* pFace, std::vector<CqLath*>& apSubFac
 	for( i = 0; i < n; i++ )
 	{
 		// For each facet, create 4 laths and join them in the order of the facet
-		CqLath* pLathA = apFaceLaths[i].pA = new CqLath( aVertices[i], aFVertices[i] );
-		m_apLaths.push_back(pLathA);
-		CqLath* pLathB = apFaceLaths[i].pB = new CqLath( aVertices[(modulo((i+1),n))+n], aFVertices[(modulo((i+1),n))+n] );
-		m_apLaths.push_back(pLathB);
-		CqLath* pLathC = apFaceLaths[i].pC = new CqLath( aVertices[2*n], aFVertices[2*n] );
-		m_apLaths.push_back(pLathC);
-		CqLath* pLathD = apFaceLaths[i].pD = new CqLath( aVertices[i+n], aFVertices[i+n] );
-		m_apLaths.push_back(pLathD);
+		CqLath* pLathA = apFaceLaths[i].pA = NewLath( aVertices[i], aFVertices[i] );
+		CqLath* pLathB = apFaceLaths[i].pB = NewLath( aVertices[(modulo((i+1),n))+n], aFVertices[(modulo((i+1),n))+n] );
+		CqLath* pLathC = apFaceLaths[i].pC = NewLath( aVertices[2*n], aFVertices[2*n] );
+		CqLath* pLathD = apFaceLaths[i].pD = NewLath( aVertices[i+n], aFVertices[i+n] );
 		pLathA->SetpClockwiseFacet(pLathB);
 		pLathB->SetpClockwiseFacet(pLathC);
 		pLathC->SetpClockwiseFacet(pLathD);
@@ -1535,10 +1638,10 @@ void CqSubdivision2::SubdivideFace(CqLath* pFace, std::vector<CqLath*>& apSubFac
 		pLathD->SetpParentFacet(aQfv[i]);
 
 		// Fill in the vertex references table for these vertices.
-		m_aapVertices[pLathA->VertexIndex()].push_back(pLathA);
-		m_aapVertices[pLathB->VertexIndex()].push_back(pLathB);
-		m_aapVertices[pLathC->VertexIndex()].push_back(pLathC);
-		m_aapVertices[pLathD->VertexIndex()].push_back(pLathD);
+		AddVertexLath(pLathA);
+		AddVertexLath(pLathB);
+		AddVertexLath(pLathC);
+		AddVertexLath(pLathD);
 
 		// Set the child vertex pointer for all laths which reference the A vertex of this facet
 		// so that we can use them when subdividing other faces.
@@ -1607,13 +1710,13 @@ void CqSubdivision2::SubdivideFace(CqLath* pFace, std::vector<CqLath*>& apSubFac
 
 		// Connect the new corner vertices, this is only possible if neighbouring facets have previously been
 		// subdivided.
-		std::vector<CqLath*>::iterator iVertLath;
-		for( iVertLath = m_aapVertices[apFaceLaths[i].pA->VertexIndex()].begin(); iVertLath != m_aapVertices[apFaceLaths[i].pA->VertexIndex()].end(); iVertLath++ )
+		CqLath* pVertLath;
+		for( pVertLath = m_apVertexLaths[apFaceLaths[i].pA->VertexIndex()]; pVertLath; pVertLath = pVertLath->pNextVertexLath() )
 		{
-			if( (*iVertLath)->cf()->VertexIndex() == apFaceLaths[i].pD->VertexIndex() )
-				apFaceLaths[i].pA->SetpClockwiseVertex( (*iVertLath ) );
-			if( (*iVertLath)->ccf()->VertexIndex() == apFaceLaths[i].pB->VertexIndex() )
-				(*iVertLath)->SetpClockwiseVertex( apFaceLaths[i].pA );
+			if( pVertLath->cf()->VertexIndex() == apFaceLaths[i].pD->VertexIndex() )
+				apFaceLaths[i].pA->SetpClockwiseVertex( pVertLath );
+			if( pVertLath->ccf()->VertexIndex() == apFaceLaths[i].pB->VertexIndex() )
+				pVertLath->SetpClockwiseVertex( apFaceLaths[i].pA );
 		}
 	}
 
@@ -1621,16 +1724,16 @@ void CqSubdivision2::SubdivideFace(CqLath* pFace, std::vector<CqLath*>& apSubFac
 	{
 		// Connect the new edge midpoint vertices to any neighbours, this is only possible if neighbouring facets have previously been
 		// subdivided.
-		std::vector<CqLath*>::iterator iVertLath;
-		for( iVertLath = m_aapVertices[apFaceLaths[i].pB->VertexIndex()].begin(); iVertLath != m_aapVertices[apFaceLaths[i].pB->VertexIndex()].end(); iVertLath++ )
+		CqLath* pVertLath;
+		for( pVertLath = m_apVertexLaths[apFaceLaths[i].pB->VertexIndex()]; pVertLath; pVertLath = pVertLath->pNextVertexLath() )
 		{
-			if( (*iVertLath)->cf()->VertexIndex() == apFaceLaths[i].pA->VertexIndex() )
-				apFaceLaths[i].pB->SetpClockwiseVertex( (*iVertLath ) );
+			if( pVertLath->cf()->VertexIndex() == apFaceLaths[i].pA->VertexIndex() )
+				apFaceLaths[i].pB->SetpClockwiseVertex( pVertLath );
 		}
-		for( iVertLath = m_aapVertices[apFaceLaths[i].pD->VertexIndex()].begin(); iVertLath != m_aapVertices[apFaceLaths[i].pD->VertexIndex()].end(); iVertLath++ )
+		for( pVertLath = m_apVertexLaths[apFaceLaths[i].pD->VertexIndex()]; pVertLath; pVertLath = pVertLath->pNextVertexLath() )
 		{
-			if( (*iVertLath)->ccf()->VertexIndex() == apFaceLaths[i].pA->VertexIndex() )
-				(*iVertLath )->SetpClockwiseVertex( apFaceLaths[i].pD );
+			if( pVertLath->ccf()->VertexIndex() == apFaceLaths[i].pA->VertexIndex() )
+				pVertLath->SetpClockwiseVertex( apFaceLaths[i].pD );
 		}
 	}
 	//OutputInfo("out.dat");
@@ -1715,19 +1818,12 @@ void CqSubdivision2::OutputInfo(const char* fname, std::vector<CqLath*>* paFaces
 	std::ofstream file(fname);
 	std::vector<CqLath*> aQfv;
 
-	std::vector<CqLath*>* paLaths = paFaces;
-
-	if( NULL == paLaths )
-		paLaths = &m_apFacets;
-
-	paLaths = &m_apLaths;
-
 	CqMatrix matCameraToObject0;
 	QGetRenderContext() ->matSpaceToSpace( "camera", "object", NULL, pPoints()->pTransform().get(), pPoints()->pTransform()->Time(0), matCameraToObject0 );
 
-	for(TqUint i = 0; i < paLaths->size(); i++)
+	for(TqInt i = 0; i < cLaths(); i++)
 	{
-		CqLath* pL = (*paLaths)[i];
+		CqLath* pL = pLath(i);
 		file << i << " - " << pL << " - "	<<
 		pL->VertexIndex() << " - " <<
 		pL->FaceVertexIndex() << " - (cf) ";
@@ -1799,17 +1895,242 @@ void	CqSurfaceSubdivisionPatch::Bound(CqBound* bound) const
 }
 
 
+namespace {
+
+/** \brief Determine the number of subdivision steps needed to dice a patch.
+ *
+ * \param diceSize - largest dice size of the patch.
+ */
+TqInt diceSubdivisions(TqInt diceSize)
+{
+	// Dice rate table                  0  1  2  3  4  5  6  7  8  9  10 11 12 13 14 15 16
+	static const TqInt aDiceSizes[] = { 0, 0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+	return aDiceSizes[ min(diceSize, 16) ];
+}
+
+/** \brief Determine whether a patch on the given hull can be diced with
+ * stencils.
+ *
+ * Refinement is linear for all classes except facevertex, which depends on
+ * whether the values agree at a vertex.  Only parameters which are
+ * interpolated in floating point are supported.
+ */
+bool canDiceWithStencils(const CqPolygonPoints& points)
+{
+	std::vector<CqParameter*>::const_iterator iUP;
+	for ( iUP = points.aUserParams().begin(); iUP != points.aUserParams().end(); iUP++ )
+	{
+		switch( ( *iUP )->Class() )
+		{
+			case class_constant:
+			case class_uniform:
+				break;
+			case class_vertex:
+			case class_varying:
+			case class_facevarying:
+				switch( ( *iUP )->Type() )
+				{
+					case type_float:
+					case type_point:
+					case type_vector:
+					case type_normal:
+					case type_hpoint:
+					case type_color:
+						break;
+					default:
+						return false;
+				}
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+/** \brief Apply a stencil table to a primitive variable of any supported type.
+ */
+void applyStencils(const CqSubdivisionStencils& stencils,
+		CqSubdivisionStencils::EqStencilTable table, const CqParameter* pSrc,
+		const std::vector<TqInt>& srcIndices, CqParameter* pDest)
+{
+	switch( pSrc->Type() )
+	{
+		case type_float:
+			stencils.Apply( table, static_cast<const CqParameterTyped<TqFloat, TqFloat>*>( pSrc ),
+					srcIndices, static_cast<CqParameterTyped<TqFloat, TqFloat>*>( pDest ) );
+			break;
+		case type_point:
+		case type_vector:
+		case type_normal:
+			stencils.Apply( table, static_cast<const CqParameterTyped<CqVector3D, CqVector3D>*>( pSrc ),
+					srcIndices, static_cast<CqParameterTyped<CqVector3D, CqVector3D>*>( pDest ) );
+			break;
+		case type_hpoint:
+			stencils.Apply( table, static_cast<const CqParameterTyped<CqVector4D, CqVector3D>*>( pSrc ),
+					srcIndices, static_cast<CqParameterTyped<CqVector4D, CqVector3D>*>( pDest ) );
+			break;
+		case type_color:
+			stencils.Apply( table, static_cast<const CqParameterTyped<CqColor, CqColor>*>( pSrc ),
+					srcIndices, static_cast<CqParameterTyped<CqColor, CqColor>*>( pDest ) );
+			break;
+		default:
+			assert(0 && "unsupported type for subdivision stencils");
+			break;
+	}
+}
+
+/// Limit mask functor which sums rows of stencil weights.
+struct SqLimitStencilSum
+{
+	SqLimitStencilSum(const CqParameterTyped<TqFloat, TqFloat>* pRows, std::vector<TqFloat>& sum)
+		: pRows(pRows),
+		sum(sum)
+	{}
+	void operator()(TqInt iVertex, TqFloat weight)
+	{
+		const TqFloat* row = pRows->pValue(iVertex);
+		for(TqInt i = 0, size = sum.size(); i < size; ++i)
+			sum[i] += weight*row[i];
+	}
+	const CqParameterTyped<TqFloat, TqFloat>* pRows;
+	std::vector<TqFloat>& sum;
+};
+
+/** \brief Create a primitive variable holding an identity matrix.
+ *
+ * Refining such a variable along with the hull gives the stencil weights on
+ * each control value directly.
+ */
+template<typename ParamT>
+ParamT* identityParam(const char* name, TqInt size)
+{
+	ParamT* pParam = new ParamT(name, size);
+	pParam->SetSize(size);
+	for(TqInt i = 0; i < size; ++i)
+	{
+		TqFloat* row = pParam->pValue(i);
+		for(TqInt j = 0; j < size; ++j)
+			row[j] = i == j ? 1.0f : 0.0f;
+	}
+	return pParam;
+}
+
+} // unnamed namespace
+
+
 CqMicroPolyGridBase* CqSurfaceSubdivisionPatch::Dice()
 {
-	boost::shared_ptr<CqSubdivision2> pSurface;
-	std::vector<CqMicroPolyGridBase*> apGrids;
+	TqInt sdcount = diceSubdivisions( max(m_uDiceSize, m_vDiceSize) );
 
-	pSurface = Extract(0);
+	if( canDiceWithStencils( *pTopology()->pPoints( 0 ) ) )
+	{
+		std::vector<TqInt> vertices;
+		std::vector<TqInt> faceVertices;
+		TqStencilKey key;
+		key.push_back( sdcount );
+		GatherNeighbourhood( vertices, faceVertices, key );
+
+		boost::shared_ptr<const CqSubdivisionStencils> stencils = findSubdivisionStencils( key );
+		if( !stencils )
+		{
+			boost::shared_ptr<CqSubdivision2> pSurface = Extract( 0 );
+			boost::shared_ptr<CqSurfaceSubdivisionPatch> pPatch( new CqSurfaceSubdivisionPatch(pSurface, pSurface->pFacet(0), 0) );
+			stencils = pPatch->CreateStencils( sdcount, faceVertices.size() );
+			cacheSubdivisionStencils( key, stencils );
+		}
+		return DiceStencils( *stencils, vertices, faceVertices, 1 << sdcount );
+	}
+
+	// Facevertex and non-float variables aren't linear in the control
+	// values; refine the hull directly.
+	boost::shared_ptr<CqSubdivision2> pSurface = Extract(0);
 	boost::shared_ptr<CqSurfaceSubdivisionPatch> pPatch( new CqSurfaceSubdivisionPatch(pSurface, pSurface->pFacet(0), 0) );
 	pPatch->m_uDiceSize = m_uDiceSize;
 	pPatch->m_vDiceSize = m_vDiceSize;
-	CqMicroPolyGridBase* pGrid = pPatch->DiceExtract();
-	return pGrid;
+	return( pPatch->DiceExtract() );
+}
+
+
+/** Refine the patch for dicing.
+ * Subdivide the face recursively the given number of times, and find the
+ * lath for each vertex of the grid, in grid order.
+ */
+
+void CqSurfaceSubdivisionPatch::RefineForDice( TqInt sdcount, std::vector<CqLath*>& apGridLaths )
+{
+	TqInt isd;
+	std::vector<CqLath*> apSubFace1, apSubFace2;
+	apSubFace1.push_back(pFace());
+
+	for( isd = 0; isd < sdcount; isd++ )
+	{
+		apSubFace2.clear();
+		std::vector<CqLath*>::iterator iSF;
+		for( iSF = apSubFace1.begin(); iSF != apSubFace1.end(); iSF++ )
+		{
+			// Subdivide this face, storing the resulting new face indices.
+			std::vector<CqLath*> apSubFaceTemp;
+			pTopology()->SubdivideFace( (*iSF), apSubFaceTemp );
+			// Now combine these into the new face indices for this subdivision level.
+			apSubFace2.insert(apSubFace2.end(), apSubFaceTemp.begin(), apSubFaceTemp.end());
+		}
+		// Now swap the new level's indices for the old before repeating at the next level, if appropriate.
+		apSubFace1.swap(apSubFace2);
+	}
+
+	// Now we use the first face index to start our extraction
+	TqInt nc, nr, c, r;
+	nc = nr = 1 << sdcount;
+	r = 0;
+	apGridLaths.resize( ( nr + 1 ) * ( nc + 1 ) );
+
+	CqLath* pLath, *pTemp;
+	pLath = apSubFace1[0];
+	pTemp = pLath;
+
+	// Get data from pLath
+	TqInt indexA = 0;
+	apGridLaths[indexA] = pLath;
+
+	indexA++;
+	pLath = pLath->ccf();
+	c = 0;
+	while( c < nc )
+	{
+		apGridLaths[indexA] = pLath;
+		if( c < ( nc - 1 ) )
+			pLath = pLath->cv()->ccf();
+
+		indexA++;
+		c++;
+	}
+	r++;
+
+	while( r <= nr )
+	{
+		pLath = pTemp->cf();
+		if( r < nr )
+			pTemp = pLath->ccv();
+
+		// Get data from pLath
+		TqInt indexA = ( r * ( nc + 1 ) );
+		apGridLaths[indexA] = pLath;
+		indexA++;
+		pLath = pLath->cf();
+		c = 0;
+		while( c < nc )
+		{
+			apGridLaths[indexA] = pLath;
+			if( c < ( nc - 1 ) )
+				pLath = pLath->ccv()->cf();
+
+			indexA++;
+			c++;
+		}
+
+		r++;
+	}
 }
 
 
@@ -1820,20 +2141,21 @@ CqMicroPolyGridBase* CqSurfaceSubdivisionPatch::Dice()
 
 CqMicroPolyGridBase* CqSurfaceSubdivisionPatch::DiceExtract()
 {
-	// Dice rate table                  0  1  2  3  4  5  6  7  8  9  10 11 12 13 14 15 16
-	static const TqInt aDiceSizes[] = { 0, 0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
-	                                  
 	assert( pTopology() );
 	assert( pTopology()->pPoints() );
 	assert( pFace() );
 
-	TqInt dicesize = min(max(m_uDiceSize, m_vDiceSize), 16);
+	TqInt sdcount = diceSubdivisions( max(m_uDiceSize, m_vDiceSize) );
+	TqInt dicesize = 1 << sdcount;
 
-	TqInt sdcount = aDiceSizes[ dicesize ];
-	dicesize = 1 << sdcount;
-	TqInt lUses = Uses();
+	std::vector<CqLath*> apGridLaths;
+	RefineForDice( sdcount, apGridLaths );
 
-	std::vector<CqMicroPolyGrid*> apGrids;
+	// With motion, each key is added to the motion grid as it's diced, which
+	// keeps only the positions of all but the first.
+	CqMotionMicroPolyGrid* pMotionGrid = NULL;
+	if( pTopology()->cTimes() > 1 )
+		pMotionGrid = new CqMotionMicroPolyGrid;
 
 	TqInt iTime;
 	for( iTime = 0; iTime < pTopology()->cTimes(); iTime++ )
@@ -1843,154 +2165,215 @@ CqMicroPolyGridBase* CqSurfaceSubdivisionPatch::DiceExtract()
 
 		boost::shared_ptr<CqPolygonPoints> pMotionPoints = pTopology()->pPoints( iTime );
 
-		TqInt isd;
-		std::vector<CqLath*> apSubFace1, apSubFace2;
-		apSubFace1.push_back(pFace());
+		for( TqInt indexA = 0, cGridVerts = apGridLaths.size(); indexA < cGridVerts; indexA++ )
+			StoreDice( pGrid, pMotionPoints, apGridLaths[indexA], indexA );
 
-		for( isd = 0; isd < sdcount; isd++ )
-		{
-			apSubFace2.clear();
-			std::vector<CqLath*>::iterator iSF;
-			for( iSF = apSubFace1.begin(); iSF != apSubFace1.end(); iSF++ )
-			{
-				// Subdivide this face, storing the resulting new face indices.
-				std::vector<CqLath*> apSubFaceTemp;
-				pTopology()->SubdivideFace( (*iSF), apSubFaceTemp );
-				// Now combine these into the new face indices for this subdivision level.
-				apSubFace2.insert(apSubFace2.end(), apSubFaceTemp.begin(), apSubFaceTemp.end());
-			}
-			// Now swap the new level's indices for the old before repeating at the next level, if appropriate.
-			apSubFace1.swap(apSubFace2);
-		}
+		StoreDiceDefaults( pGrid, pTopology()->pPoints(), dicesize );
+		if( !pMotionGrid )
+			return( pGrid );
+		pMotionGrid->AddKey( pTopology()->Time( iTime ), pGrid );
+	}
 
-		// Now we use the first face index to start our extraction
-		TqInt nc, nr, c, r;
-		nc = nr = dicesize;
-		r = 0;
+	pMotionGrid->Initialise(dicesize, dicesize, pTopology()->pPoints() );
+	return( pMotionGrid );
+}
 
-		CqLath* pLath, *pTemp;
-		pLath = apSubFace1[0];
-		pTemp = pLath;
 
-		// Get data from pLath
-		TqInt indexA = 0;
-		StoreDice( pGrid, pMotionPoints, pLath, indexA );
+/** Create the stencils for dicing this patch.
+ * The patch should be the only face of a surface created by Extract().  The
+ * control values are replaced by the rows of an identity matrix, so refining
+ * them gives the weights which make up each row of the stencils.
+ */
 
-		indexA++;
-		pLath = pLath->ccf();
-		c = 0;
-		while( c < nc )
-		{
-			StoreDice(pGrid, pMotionPoints, pLath, indexA);
-			if( c < ( nc - 1 ) )
-				pLath = pLath->cv()->ccf();
+boost::shared_ptr<CqSubdivisionStencils> CqSurfaceSubdivisionPatch::CreateStencils( TqInt sdcount, TqInt cFaceVerts )
+{
+	assert( pTopology() );
+	assert( pTopology()->pPoints() );
+	assert( pFace() );
 
-			indexA++;
-			c++;
-		}
-		r++;
+	typedef CqParameterTypedVertexArray<TqFloat, type_float, TqFloat> TqVertexRows;
+	typedef CqParameterTypedVaryingArray<TqFloat, type_float, TqFloat> TqVaryingRows;
+	typedef CqParameterTypedFaceVaryingArray<TqFloat, type_float, TqFloat> TqFaceVaryingRows;
+
+	TqInt cVerts = pTopology()->cVertices();
+	TqVertexRows* pVertexRows = identityParam<TqVertexRows>( "__stencil_vertex", cVerts );
+	TqVaryingRows* pVaryingRows = identityParam<TqVaryingRows>( "__stencil_varying", cVerts );
+	TqFaceVaryingRows* pFaceVaryingRows = identityParam<TqFaceVaryingRows>( "__stencil_facevarying", cFaceVerts );
+	pTopology()->pPoints()->AddPrimitiveVariable( pVertexRows );
+	pTopology()->pPoints()->AddPrimitiveVariable( pVaryingRows );
+	pTopology()->pPoints()->AddPrimitiveVariable( pFaceVaryingRows );
+
+	std::vector<CqLath*> apGridLaths;
+	RefineForDice( sdcount, apGridLaths );
+
+	TqInt cGridVerts = apGridLaths.size();
+	boost::shared_ptr<CqSubdivisionStencils> stencils( new CqSubdivisionStencils( cGridVerts ) );
+
+	// Finding the limit masks may subdivide further, so the refined rows
+	// are only read once all the limit rows are known.
+	std::vector<TqFloat> limitRow( cVerts );
+	TqInt iGrid;
+	for( iGrid = 0; iGrid < cGridVerts; iGrid++ )
+	{
+		std::fill( limitRow.begin(), limitRow.end(), 0.0f );
+		SqLimitStencilSum sum( pVertexRows, limitRow );
+		pTopology()->limitMask( apGridLaths[iGrid], sum );
+		stencils->AddRow( CqSubdivisionStencils::Stencil_Limit, &limitRow[0], cVerts );
+	}
+	for( iGrid = 0; iGrid < cGridVerts; iGrid++ )
+	{
+		CqLath* vert = apGridLaths[iGrid];
+		stencils->AddRow( CqSubdivisionStencils::Stencil_Vertex,
+				pVertexRows->pValue( vert->VertexIndex() ), cVerts );
+		stencils->AddRow( CqSubdivisionStencils::Stencil_Varying,
+				pVaryingRows->pValue( vert->VertexIndex() ), cVerts );
+		stencils->AddRow( CqSubdivisionStencils::Stencil_FaceVarying,
+				pFaceVaryingRows->pValue( vert->FaceVertexIndex() ), cFaceVerts );
+	}
+	return( stencils );
+}
 
-		while( r <= nr )
-		{
-			pLath = pTemp->cf();
-			if( r < nr )
-				pTemp = pLath->ccv();
 
-			// Get data from pLath
-			TqInt indexA = ( r * ( nc + 1 ) );
-			StoreDice( pGrid, pMotionPoints, pLath, indexA );
-			indexA++;
-			pLath = pLath->cf();
-			c = 0;
-			while( c < nc )
-			{
-				StoreDice( pGrid, pMotionPoints, pLath, indexA );
-				if( c < ( nc - 1 ) )
-					pLath = pLath->ccv()->cf();
+/** Dice the patch using precomputed stencils.
+ * The primitive variables on the grid are computed directly from the control
+ * values of the neighbourhood, without refining the control hull.
+ *
+ * \param stencils - stencils for the neighbourhood of this patch.
+ * \param vertices - mesh vertex index of each local vertex, as found by GatherNeighbourhood().
+ * \param faceVertices - mesh facevertex index of each local facevertex.
+ * \param dicesize - number of micropolygons along each side of the grid.
+ */
 
-				indexA++;
-				c++;
-			}
+CqMicroPolyGridBase* CqSurfaceSubdivisionPatch::DiceStencils( const CqSubdivisionStencils& stencils,
+		const std::vector<TqInt>& vertices, const std::vector<TqInt>& faceVertices, TqInt dicesize )
+{
+	TqInt cGridVerts = stencils.cGridVerts();
+	std::vector<CqVector3D> limitP( cGridVerts );
 
-			r++;
-		}
-		// If the color and opacity are not defined, use the system values.
-		if ( USES( lUses, EnvVars_Cs ) && !pTopology()->pPoints()->bHasVar(EnvVars_Cs) )
-		{
-			if ( pAttributes() ->GetColorAttribute( "System", "Color" ) )
-				pGrid->pVar(EnvVars_Cs) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
-			else
-				pGrid->pVar(EnvVars_Cs) ->SetColor( CqColor( 1, 1, 1 ) );
-		}
+	// As for Extract(), only the first time slot is diced.
+	boost::shared_ptr<CqPolygonPoints> pPoints = pTopology()->pPoints( 0 );
+
+	// Gather the values at the grid vertices into a points class, so
+	// that they can be stored in the same way as refined values.
+	boost::shared_ptr<CqPolygonPoints> pGridPoints( new CqPolygonPoints( cGridVerts, 1, cGridVerts ) );
+	pGridPoints->SetSurfaceParameters( *pPoints );
 
-		if ( USES( lUses, EnvVars_Os ) && !pTopology()->pPoints()->bHasVar(EnvVars_Os) )
+	std::vector<CqParameter*>::iterator iUP;
+	std::vector<CqParameter*>::iterator end = pPoints->aUserParams().end();
+	for ( iUP = pPoints->aUserParams().begin(); iUP != end; iUP++ )
+	{
+		CqParameter * pNewUP = ( *iUP ) ->CloneType( ( *iUP ) ->strName().c_str(), ( *iUP ) ->Count() );
+		switch( ( *iUP )->Class() )
 		{
-			if ( pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
-				pGrid->pVar(EnvVars_Os) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
-			else
-				pGrid->pVar(EnvVars_Os) ->SetColor( CqColor( 1, 1, 1 ) );
+			case class_vertex:
+				pNewUP->SetSize( cGridVerts );
+				applyStencils( stencils, CqSubdivisionStencils::Stencil_Vertex, *iUP, vertices, pNewUP );
+				break;
+			case class_varying:
+				pNewUP->SetSize( cGridVerts );
+				applyStencils( stencils, CqSubdivisionStencils::Stencil_Varying, *iUP, vertices, pNewUP );
+				break;
+			case class_facevarying:
+				pNewUP->SetSize( cGridVerts );
+				applyStencils( stencils, CqSubdivisionStencils::Stencil_FaceVarying, *iUP, faceVertices, pNewUP );
+				break;
+			case class_uniform:
+				pNewUP->SetSize( 1 );
+				pNewUP->SetValue( ( *iUP ), 0, m_FaceIndex );
+				break;
+			default:
+				pNewUP->SetSize( 1 );
+				pNewUP->SetValue( ( *iUP ), 0, 0 );
+				break;
 		}
-		apGrids.push_back( pGrid );
+		pGridPoints->AddPrimitiveVariable( pNewUP );
+	}
+
+	CqMicroPolyGrid* pGrid = new CqMicroPolyGrid();
+	pGrid->Initialise( dicesize, dicesize, pGridPoints );
+
+	stencils.ApplyLimit( pPoints->P(), vertices, &limitP[0] );
+	for( TqInt iData = 0; iData < cGridVerts; iData++ )
+	{
+		pGrid->pVar(EnvVars_P)->SetPoint( limitP[iData], iData );
+		StoreDiceVars( pGrid, pGridPoints, iData, iData, 0, iData );
+	}
 
-		// Fill in u/v if required.
-		if ( USES( lUses, EnvVars_u ) && !pTopology()->pPoints()->bHasVar(EnvVars_u) )
+	StoreDiceDefaults( pGrid, pGridPoints, dicesize );
+	return( pGrid );
+}
+
+
+/** Fill in the standard variables which aren't given on the hull.
+ */
+
+void CqSurfaceSubdivisionPatch::StoreDiceDefaults( CqMicroPolyGrid* pGrid, const boost::shared_ptr<CqPolygonPoints>& pPoints, TqInt dicesize )
+{
+	TqInt lUses = Uses();
+
+	// If the color and opacity are not defined, use the system values.
+	if ( USES( lUses, EnvVars_Cs ) && !pPoints->bHasVar(EnvVars_Cs) )
+	{
+		if ( pAttributes() ->GetColorAttribute( "System", "Color" ) )
+			pGrid->pVar(EnvVars_Cs) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Color" ) [ 0 ] );
+		else
+			pGrid->pVar(EnvVars_Cs) ->SetColor( CqColor( 1, 1, 1 ) );
+	}
+
+	if ( USES( lUses, EnvVars_Os ) && !pPoints->bHasVar(EnvVars_Os) )
+	{
+		if ( pAttributes() ->GetColorAttribute( "System", "Opacity" ) )
+			pGrid->pVar(EnvVars_Os) ->SetColor( pAttributes() ->GetColorAttribute( "System", "Opacity" ) [ 0 ] );
+		else
+			pGrid->pVar(EnvVars_Os) ->SetColor( CqColor( 1, 1, 1 ) );
+	}
+
+	// Fill in u/v if required.
+	if ( USES( lUses, EnvVars_u ) && !pPoints->bHasVar(EnvVars_u) )
+	{
+		TqInt iv, iu;
+		for ( iv = 0; iv <= dicesize; iv++ )
 		{
-			TqInt iv, iu;
-			for ( iv = 0; iv <= dicesize; iv++ )
+			TqFloat v = ( 1.0f / ( dicesize + 1 ) ) * iv;
+			for ( iu = 0; iu <= dicesize; iu++ )
 			{
-				TqFloat v = ( 1.0f / ( dicesize + 1 ) ) * iv;
-				for ( iu = 0; iu <= dicesize; iu++ )
-				{
-					TqFloat u = ( 1.0f / ( dicesize + 1 ) ) * iu;
-					TqInt igrid = ( iv * ( dicesize + 1 ) ) + iu;
-					pGrid->pVar(EnvVars_u)->SetFloat( BilinearEvaluate( 0.0f, 1.0f, 0.0f, 1.0f, u, v ), igrid );
-				}
+				TqFloat u = ( 1.0f / ( dicesize + 1 ) ) * iu;
+				TqInt igrid = ( iv * ( dicesize + 1 ) ) + iu;
+				pGrid->pVar(EnvVars_u)->SetFloat( BilinearEvaluate( 0.0f, 1.0f, 0.0f, 1.0f, u, v ), igrid );
 			}
 		}
+	}
 
-		if ( USES( lUses, EnvVars_v ) && !pTopology()->pPoints()->bHasVar(EnvVars_v) )
+	if ( USES( lUses, EnvVars_v ) && !pPoints->bHasVar(EnvVars_v) )
+	{
+		TqInt iv, iu;
+		for ( iv = 0; iv <= dicesize; iv++ )
 		{
-			TqInt iv, iu;
-			for ( iv = 0; iv <= dicesize; iv++ )
+			TqFloat v = ( 1.0f / ( dicesize + 1 ) ) * iv;
+			for ( iu = 0; iu <= dicesize; iu++ )
 			{
-				TqFloat v = ( 1.0f / ( dicesize + 1 ) ) * iv;
-				for ( iu = 0; iu <= dicesize; iu++ )
-				{
-					TqFloat u = ( 1.0f / ( dicesize + 1 ) ) * iu;
-					TqInt igrid = ( iv * ( dicesize + 1 ) ) + iu;
-					pGrid->pVar(EnvVars_v)->SetFloat( BilinearEvaluate( 0.0f, 0.0f, 1.0f, 1.0f, u, v ), igrid );
-				}
+				TqFloat u = ( 1.0f / ( dicesize + 1 ) ) * iu;
+				TqInt igrid = ( iv * ( dicesize + 1 ) ) + iu;
+				pGrid->pVar(EnvVars_v)->SetFloat( BilinearEvaluate( 0.0f, 0.0f, 1.0f, 1.0f, u, v ), igrid );
 			}
 		}
+	}
 
-		// Fill in s/t if required.
-		if ( USES( lUses, EnvVars_s ) && !pTopology()->pPoints()->bHasVar(EnvVars_s) )
-		{
-			pGrid->pVar(EnvVars_s)->SetValueFromVariable( pGrid->pVar(EnvVars_u) );
-		}
-
-		if ( USES( lUses, EnvVars_t ) && !pTopology()->pPoints()->bHasVar(EnvVars_t) )
-		{
-			pGrid->pVar(EnvVars_t)->SetValueFromVariable( pGrid->pVar(EnvVars_v) );
-		}
+	// Fill in s/t if required.
+	if ( USES( lUses, EnvVars_s ) && !pPoints->bHasVar(EnvVars_s) )
+	{
+		pGrid->pVar(EnvVars_s)->SetValueFromVariable( pGrid->pVar(EnvVars_u) );
 	}
 
-	if( apGrids.size() == 1 )
-		return( apGrids[ 0 ] );
-	else
+	if ( USES( lUses, EnvVars_t ) && !pPoints->bHasVar(EnvVars_t) )
 	{
-		CqMotionMicroPolyGrid * pGrid = new CqMotionMicroPolyGrid;
-		TqInt i;
-		for ( i = 0; i < pTopology()->cTimes(); i++ )
-			pGrid->AddTimeSlot( pTopology()->Time( i ), apGrids[ i ] );
-		pGrid->Initialise(dicesize, dicesize, pTopology()->pPoints() );
-		return( pGrid );
+		pGrid->pVar(EnvVars_t)->SetValueFromVariable( pGrid->pVar(EnvVars_v) );
 	}
 }
 
 void CqSurfaceSubdivisionPatch::StoreDiceAPVar(
 		const boost::shared_ptr<IqShader>& pShader, CqParameter* pParam,
-		TqUint ivA, TqInt ifvA, TqUint indexA)
+		TqUint ivA, TqInt ifvA, TqInt iuA, TqUint indexA)
 {
 	// Find the argument
 	IqShaderData * pArg = pShader->FindArgument( pParam->strName() );
@@ -2002,7 +2385,7 @@ void CqSurfaceSubdivisionPatch::StoreDiceAPVar(
 			case class_constant:
 				break;
 			case class_uniform:
-				index = m_FaceIndex;
+				index = iuA;
 				break;
 			case class_varying:
 			case class_vertex:
@@ -2082,13 +2465,16 @@ void CqSurfaceSubdivisionPatch::StoreDiceAPVar(
 
 void CqSurfaceSubdivisionPatch::StoreDice( CqMicroPolyGrid* pGrid, const boost::shared_ptr<CqPolygonPoints>& pPoints, CqLath* vert, TqInt iData)
 {
-	TqInt lUses = m_Uses;
-	TqInt lDone = 0;
+	pGrid->pVar(EnvVars_P)->SetPoint(m_pTopology->limitPoint(vert), iData);
+	StoreDiceVars( pGrid, pPoints, vert->VertexIndex(), vert->FaceVertexIndex(), m_FaceIndex, iData );
+}
 
-	TqInt iParam = vert->VertexIndex();
-	TqInt iFVParam = vert->FaceVertexIndex();
 
-	pGrid->pVar(EnvVars_P)->SetPoint(m_pTopology->limitPoint(vert), iData);
+void CqSurfaceSubdivisionPatch::StoreDiceVars( CqMicroPolyGrid* pGrid, const boost::shared_ptr<CqPolygonPoints>& pPoints,
+		TqInt iParam, TqInt iFVParam, TqInt iUniform, TqInt iData )
+{
+	TqInt lUses = m_Uses;
+	TqInt lDone = 0;
 
 	// Special cases for s and t if "st" exists, it should override s and t.
 	CqParameter* pParam;
@@ -2153,13 +2539,13 @@ void CqSurfaceSubdivisionPatch::StoreDice( CqMicroPolyGrid* pGrid, const boost::
 		/// \todo: Must transform point/vector/normal/matrix parameter variables from 'object' space to current before setting.
 		boost::shared_ptr<IqShader> pShader;
 		if ( pShader=pGrid->pAttributes() ->pshadSurface(m_Time) )
-			StoreDiceAPVar( pShader, ( *iUP ), iParam, iFVParam, iData );
+			StoreDiceAPVar( pShader, ( *iUP ), iParam, iFVParam, iUniform, iData );
 
 		if ( pShader=pGrid->pAttributes() ->pshadDisplacement(m_Time) )
-			StoreDiceAPVar( pShader, ( *iUP ), iParam, iFVParam, iData );
+			StoreDiceAPVar( pShader, ( *iUP ), iParam, iFVParam, iUniform, iData );
 
 		if ( pShader=pGrid->pAttributes() ->pshadAtmosphere(m_Time) )
-			StoreDiceAPVar( pShader, ( *iUP ), iParam, iFVParam, iData );
+			StoreDiceAPVar( pShader, ( *iUP ), iParam, iFVParam, iUniform, iData );
 	}
 }
 
@@ -2773,40 +3159,58 @@ TqInt CqSurfaceSubdivisionMesh::Split( std::vector<boost::shared_ptr<CqSurface>
 }
 
 
-boost::shared_ptr<CqSubdivision2> CqSurfaceSubdivisionPatch::Extract( TqInt iTime )
+void CqSurfaceSubdivisionPatch::GatherNeighbourhood( std::vector<TqInt>& vertices,
+		std::vector<TqInt>& faceVertices, std::vector<TqInt>& facets ) const
 {
 	assert( pTopology() );
-	assert( pTopology()->pPoints() );
 	assert( pFace() );
 
 	// Find the point indices for the polygons surrounding this one.
 	// Use a map to ensure that shared vertices are only counted once.
-	std::map<TqInt, TqInt> Vertices;
-	TqUint cVerts=0;
-	std::vector<TqInt>	FVertices;
+	std::map<TqInt, TqInt> localIndices;
 
 	std::vector<CqLath*> aQff;
-	std::vector<CqLath*> apSubFaces2;
 	pFace()->Qff( aQff );
 	std::vector<CqLath*>::iterator iF;
 	for( iF = aQff.begin(); iF != aQff.end(); iF++ )
 	{
 		std::vector<CqLath*> aQfv;
 		(*iF)->Qfv( aQfv );
+		facets.push_back( aQfv.size() );
 		std::vector<CqLath*>::reverse_iterator iV;
 		for( iV = aQfv.rbegin(); iV != aQfv.rend(); iV++ )
 		{
-			if( Vertices.find((*iV)->VertexIndex()) == Vertices.end() )
+			TqInt iVertex = (*iV)->VertexIndex();
+			std::map<TqInt, TqInt>::iterator pos = localIndices.find( iVertex );
+			if( pos == localIndices.end() )
 			{
-				Vertices[(*iV)->VertexIndex()] = cVerts;
-				cVerts++;
+				pos = localIndices.insert( std::make_pair( iVertex, TqInt( vertices.size() ) ) ).first;
+				vertices.push_back( iVertex );
 			}
-			FVertices.push_back( (*iV)->FaceVertexIndex() );
+			facets.push_back( pos->second );
+			faceVertices.push_back( (*iV)->FaceVertexIndex() );
 		}
 	}
+}
+
+
+boost::shared_ptr<CqSubdivision2> CqSurfaceSubdivisionPatch::Extract( TqInt iTime ) const
+{
+	assert( pTopology() );
+	assert( pTopology()->pPoints() );
+	assert( pFace() );
+
+	std::vector<TqInt> Vertices;
+	std::vector<TqInt> FVertices;
+	std::vector<TqInt> Facets;
+	GatherNeighbourhood( Vertices, FVertices, Facets );
+	TqUint cVerts = Vertices.size();
+	TqInt cFacets = 0;
+	for( TqUint iFacet = 0; iFacet < Facets.size(); iFacet += Facets[iFacet] + 1 )
+		cFacets++;
 
 	// Create a storage class for all the points.
-	boost::shared_ptr<CqPolygonPoints> pPointsClass( new CqPolygonPoints( cVerts, aQff.size(), FVertices.size() ) );
+	boost::shared_ptr<CqPolygonPoints> pPointsClass( new CqPolygonPoints( cVerts, cFacets, FVertices.size() ) );
 	// Fill in default values for all primitive variables not explicitly specified.
 	pPointsClass->SetSurfaceParameters( *pTopology()->pPoints( iTime ) );
 
@@ -2822,9 +3226,8 @@ boost::shared_ptr<CqSubdivision2> CqSurfaceSubdivisionPatch::Extract( TqInt iTim
 			// Copy any 'vertex' or 'varying' class primitive variables.
 			CqParameter * pNewUP = ( *iUP ) ->CloneType( ( *iUP ) ->strName().c_str(), ( *iUP ) ->Count() );
 			pNewUP->SetSize( cVerts );
-			std::map<TqInt, TqInt>::iterator i;
-			for( i = Vertices.begin(); i != Vertices.end(); i++ )
-				pNewUP->SetValue( ( *iUP ), (*i).second, (*i).first );
+			for( TqUint i = 0; i < cVerts; i++ )
+				pNewUP->SetValue( ( *iUP ), i, Vertices[i] );
 			pSurface->pPoints()->AddPrimitiveVariable( pNewUP );
 		}
 		else if ( ( *iUP ) ->Class() == class_facevarying || ( *iUP )->Class() == class_facevertex )
@@ -2862,22 +3265,31 @@ boost::shared_ptr<CqSubdivision2> CqSurfaceSubdivisionPatch::Extract( TqInt iTim
 		pSurface->pPoints()->P()->pValue(i)[0].Homogenize();
 
 	TqInt iP = 0;
-	for( iF = aQff.begin(); iF != aQff.end(); iF++ )
+	for( TqUint iFacet = 0; iFacet < Facets.size(); iFacet += Facets[iFacet] + 1 )
 	{
-		std::vector<TqInt> vertices;
-		std::vector<CqLath*> aQfv;
-		(*iF)->Qfv( aQfv );
-		std::vector<CqLath*>::reverse_iterator iV;
-		for( iV = aQfv.rbegin(); iV != aQfv.rend(); ++iV )
-			vertices.push_back( Vertices[(*iV)->VertexIndex()] );
-		pSurface->AddFacet( vertices.size(), &vertices[ 0 ], iP );
-		iP += vertices.size();
+		pSurface->AddFacet( Facets[iFacet], &Facets[ iFacet + 1 ], iP );
+		iP += Facets[iFacet];
 	}
 	pSurface->Finalise();
 	return(pSurface);
 }
 
 
+/** Clone the patch.
+ * The clone refers to a private copy of the neighbourhood of the face, as
+ * used for dicing, rather than the shared hull.
+ */
+CqSurface* CqSurfaceSubdivisionPatch::Clone() const
+{
+	boost::shared_ptr<CqSubdivision2> pSurface = Extract( 0 );
+	CqSurfaceSubdivisionPatch* clone = new CqSurfaceSubdivisionPatch( pSurface, pSurface->pFacet(0), 0 );
+	CqSurface::CloneData( clone );
+	clone->m_Uses = m_Uses;
+	clone->m_Time = m_Time;
+	return ( clone );
+}
+
+
 CqSurface* CqSurfaceSubdivisionMesh::Clone() const
 {
 	boost::shared_ptr<CqSubdivision2> clone_subd(m_pTopology->Clone());
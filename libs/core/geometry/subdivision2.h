@@ -32,6 +32,7 @@
 #include <aqsis/math/vector3d.h>
 #include "surface.h"
 #include "polygon.h"
+#include "subdivstencils.h"
 
 namespace Aqsis {
 
@@ -75,19 +76,16 @@ class CqSubdivision2 : public CqMotionSpec<boost::shared_ptr<CqPolygonPoints> >
 		/// Get the number of laths representing this topology.
 		TqInt	cLaths() const
 		{
-			return(m_apLaths.size());
+			return(m_cLaths);
 		}
 		/// Get the number of faces representing this topology.
 		TqInt	cVertices() const
 		{
-			return(m_aapVertices.size());
+			return(m_apVertexLaths.size());
 		}
 
-		/// Get a refrence to the array of autoatically generated laths.
-		const std::vector<CqLath*>& apLaths() const
-		{
-			return(m_apLaths);
-		}
+		CqLath*	pLath(TqInt iIndex);
+		void	ReserveLaths(TqInt cLaths);
 
 		/// Get pointer to the vertex storage class
 		boost::shared_ptr<CqPolygonPoints> pPoints( TqInt TimeIndex = 0 ) const
@@ -129,10 +127,7 @@ class CqSubdivision2 : public CqMotionSpec<boost::shared_ptr<CqPolygonPoints> >
 		}
 		void		AddSharpCorner( CqLath* pLath, TqFloat Sharpness )
 		{
-			std::vector<CqLath*> aQve;
-			pLath->Qve( aQve );
-			std::vector<CqLath*>::iterator iVE;
-			for( iVE = aQve.begin(); iVE != aQve.end(); iVE++ )
+			for( CqVertexLathIterator iVE( pLath, true ); !iVE.atEnd(); ++iVE )
 				m_mapSharpCorners[(*iVE)] = Sharpness;
 		}
 		TqFloat		CornerSharpness(const CqLath* pLath) const
@@ -162,6 +157,20 @@ class CqSubdivision2 : public CqMotionSpec<boost::shared_ptr<CqPolygonPoints> >
 		 */
 		CqVector3D limitPoint(CqLath* vert);
 
+		/** \brief Compute the limit mask of a vertex
+		 *
+		 * The limit point of a vertex is a weighted sum of the positions of
+		 * nearby vertices.  This calls mask(vertexIndex, weight) for each
+		 * term of the sum used by limitPoint(); a vertex may appear more
+		 * than once.  Any subdivision needed is performed before mask is
+		 * first called.
+		 *
+		 * \param vert - Lath connected to the vertex.
+		 * \param mask - functor receiving the weights.
+		 */
+		template<typename MaskT>
+		void limitMask(CqLath* vert, MaskT& mask);
+
 		void AddVertex(CqLath* pVertex, TqInt& iVIndex, TqInt& iFVIndex);
 		void AddEdgeVertex(CqLath* pEdge, TqInt& iVIndex, TqInt& iFVIndex);
 		void AddFaceVertex(CqLath* pFace, TqInt& iVIndex, TqInt& iFVIndex);
@@ -202,14 +211,30 @@ class CqSubdivision2 : public CqMotionSpec<boost::shared_ptr<CqPolygonPoints> >
 
 		void subdivideNeighbourFaces(CqLath* vert);
 
+		CqLath* NewLath(TqInt iV, TqInt iFV);
+		void AddVertexLath(CqLath* pLath);
+
 		typedef std::map<const CqLath*, TqFloat> TqSharpnessMap;
 
 		/// Array of pointers to laths, one each representing each facet.
 		std::vector<CqLath*>				m_apFacets;
-		/// Array of arrays of pointers to laths each array representing the total laths referencing a single vertex.
-		std::vector<std::vector<CqLath*> >	m_aapVertices;
-		/// Array of lath pointers, one for each lath generated.
-		std::vector<CqLath*>				m_apLaths;
+		/// Array of pointers to laths, one for each vertex, heading the list
+		/// of all laths referencing that vertex (linked by pNextVertexLath()).
+		std::vector<CqLath*>				m_apVertexLaths;
+		/// A contiguous block of laths in the lath arena.
+		struct SqLathBlock
+		{
+			CqLath*	laths;
+			TqInt	size;
+		};
+		/// Blocks of laths, all laths for the topology are created in these.
+		std::vector<SqLathBlock>			m_lathBlocks;
+		/// Total number of laths in use.
+		TqInt								m_cLaths;
+		/// Number of laths in use in the last block.
+		TqInt								m_cLastBlockUsed;
+		/// Number of laths to allocate in the next block.
+		TqInt								m_nextBlockSize;
 		/// Map of face indices which are to be treated as holes in the surface, i.e. not rendered.
 		std::map<TqInt, bool>				m_mapHoles;
 		/// Flag indicating whether this surface interpolates it's boundaries or not.
@@ -276,7 +301,21 @@ class CqSurfaceSubdivisionPatch : public CqSurface
 		// Required implementations from IqSurface
 		virtual void	Transform( const CqMatrix& matTx, const CqMatrix& matITTx, const CqMatrix& matRTx, TqInt iTime = 0 )
 		{
-			//pTopology()->pPoints( iTime )->Transform( matTx, matITTx, matRTx );
+			// The patches of a mesh share the hull, which has already been
+			// transformed; only a clone has a private hull to transform.
+			if ( m_pTopology.unique() )
+				m_pTopology->pPoints( iTime )->Transform( matTx, matITTx, matRTx, iTime );
+		}
+		/** Set the instance parameters of this and the hull points.
+		 */
+		virtual	void	SetInstanceParameters( const CqAttributesPtr& pAttributes, const CqTransformPtr& pTransform )
+		{
+			CqSurface::SetInstanceParameters( pAttributes, pTransform );
+			m_pTopology->pPoints()->SetInstanceParameters( pAttributes, pTransform );
+		}
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Subdivision );
 		}
 		// NOTE: These should never be called.
 		virtual	TqUint	cUniform() const
@@ -310,26 +349,37 @@ class CqSurfaceSubdivisionPatch : public CqSurface
 			return( false );
 		}
 
-		boost::shared_ptr<CqSubdivision2> Extract( TqInt iTime );
+		boost::shared_ptr<CqSubdivision2> Extract( TqInt iTime ) const;
 
-		virtual CqSurface* Clone() const
-		{
-			// \warning: Should never ever be cloning one of these surfaces.
-			assert(false);
-			return(NULL);
-		}
+		virtual CqSurface* Clone() const;
 
 	private:
+		/** Find the faces around this patch, as copied by Extract().
+		 *
+		 * \param vertices - appended with the mesh vertex index of each local vertex.
+		 * \param faceVertices - appended with the mesh facevertex index of each local facevertex.
+		 * \param facets - appended with the vertex count and local vertex indices of each face.
+		 */
+		void GatherNeighbourhood( std::vector<TqInt>& vertices, std::vector<TqInt>& faceVertices, std::vector<TqInt>& facets ) const;
+		void RefineForDice( TqInt sdcount, std::vector<CqLath*>& apGridLaths );
 		CqMicroPolyGridBase* DiceExtract();
+		boost::shared_ptr<CqSubdivisionStencils> CreateStencils( TqInt sdcount, TqInt cFaceVerts );
+		CqMicroPolyGridBase* DiceStencils( const CqSubdivisionStencils& stencils,
+				const std::vector<TqInt>& vertices, const std::vector<TqInt>& faceVertices, TqInt dicesize );
 
 		void StoreDice( CqMicroPolyGrid* pGrid, const boost::shared_ptr<CqPolygonPoints>& pPoints, CqLath* vert, TqInt iVData);
-		void StoreDiceAPVar( const boost::shared_ptr<IqShader>& pShader, CqParameter* pParam, TqUint ivA, TqInt ifvA, TqUint indexA );
+		void StoreDiceVars( CqMicroPolyGrid* pGrid, const boost::shared_ptr<CqPolygonPoints>& pPoints, TqInt iParam, TqInt iFVParam, TqInt iUniform, TqInt iData );
+		void StoreDiceDefaults( CqMicroPolyGrid* pGrid, const boost::shared_ptr<CqPolygonPoints>& pPoints, TqInt dicesize );
+		void StoreDiceAPVar( const boost::shared_ptr<IqShader>& pShader, CqParameter* pParam, TqUint ivA, TqInt ifvA, TqInt iuA, TqUint indexA );
 
 		boost::shared_ptr<CqSubdivision2>	m_pTopology;
 		CqLath*			m_pFace;
 		TqInt			m_Uses;
 		TqFloat			m_Time;
 		TqInt			m_FaceIndex;
+	public:
+		/// Class to expose private functions for testing.
+		struct Test;
 };
 
 //----------------------------------------------------------------------
@@ -382,12 +432,23 @@ class CqSurfaceSubdivisionMesh : public CqSurface
 			assert( m_pTopology );
 			m_pTopology->pPoints()->Transform( matTx, matITTx, matRTx, iTime );
 		}
+		/** Set the instance parameters of this and the shared points.
+		 */
+		virtual	void	SetInstanceParameters( const CqAttributesPtr& pAttributes, const CqTransformPtr& pTransform )
+		{
+			CqSurface::SetInstanceParameters( pAttributes, pTransform );
+			m_pTopology->pPoints()->SetInstanceParameters( pAttributes, pTransform );
+		}
 
 		virtual bool	IsMotionBlurMatch( CqSurface* pSurf )
 		{
 			return( false );
 		}
 
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Subdivision );
+		}
 		virtual	TqUint	cUniform() const
 		{
 			return ( m_NumFaces );
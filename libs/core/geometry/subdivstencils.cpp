@@ -0,0 +1,143 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+ *
+ * \brief Implements the stencil tables used to dice subdivision patches.
+ */
+
+#include "subdivstencils.h"
+
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+namespace Aqsis {
+
+//---------------------------------------------------------------------
+/** Constructor.
+ */
+
+CqSubdivisionStencils::CqSubdivisionStencils( TqInt cGridVerts )
+	: m_cGridVerts( cGridVerts )
+{
+	for ( TqInt table = 0; table < Stencil_Last; ++table )
+	{
+		m_tables[table].rowStart.reserve( cGridVerts + 1 );
+		m_tables[table].rowStart.push_back( 0 );
+	}
+}
+
+
+//---------------------------------------------------------------------
+/** Append the weights for the next grid vertex to a table.
+ */
+
+void CqSubdivisionStencils::AddRow( EqStencilTable table, const TqFloat* weights, TqInt cWeights )
+{
+	SqTable& t = m_tables[table];
+	assert( static_cast<TqInt>( t.rowStart.size() ) <= m_cGridVerts );
+	for ( TqInt i = 0; i < cWeights; ++i )
+	{
+		if ( weights[i] != 0.0f )
+		{
+			t.indices.push_back( i );
+			t.weights.push_back( weights[i] );
+		}
+	}
+	t.rowStart.push_back( t.weights.size() );
+}
+
+
+//---------------------------------------------------------------------
+/** Get the number of nonzero weights held in all tables.
+ */
+
+TqInt CqSubdivisionStencils::cWeights() const
+{
+	TqInt cWeights = 0;
+	for ( TqInt table = 0; table < Stencil_Last; ++table )
+		cWeights += m_tables[table].weights.size();
+	return ( cWeights );
+}
+
+
+//---------------------------------------------------------------------
+/** Compute the limit positions of the grid vertices.
+ */
+
+void CqSubdivisionStencils::ApplyLimit( const CqParameterTyped<CqVector4D, CqVector3D>* pSrcP,
+                                        const std::vector<TqInt>& srcIndices, CqVector3D* limitP ) const
+{
+	const SqTable& t = m_tables[Stencil_Limit];
+	for ( TqInt row = 0; row < m_cGridVerts; ++row )
+	{
+		CqVector3D P;
+		for ( TqInt i = t.rowStart[row]; i < t.rowStart[row+1]; ++i )
+			P += t.weights[i] * vectorCast<CqVector3D>( pSrcP->pValue( srcIndices[t.indices[i]] )[0] );
+		limitP[row] = P;
+	}
+}
+
+
+//---------------------------------------------------------------------
+namespace {
+
+typedef std::map<TqStencilKey, boost::shared_ptr<const CqSubdivisionStencils> > TqStencilCache;
+
+/// The cached stencils.
+TqStencilCache g_stencilCache;
+/// Total number of weights held in the cache.
+TqInt g_cCachedWeights = 0;
+/// Number of weights above which the cache is emptied (about 64MB).
+const TqInt g_maxCachedWeights = 8 * 1024 * 1024;
+/// Protects the cache, which is shared by all threads dicing patches.
+boost::mutex g_stencilCacheMutex;
+
+} // anonymous namespace
+
+
+boost::shared_ptr<const CqSubdivisionStencils> findSubdivisionStencils( const TqStencilKey& key )
+{
+	boost::mutex::scoped_lock lock( g_stencilCacheMutex );
+	TqStencilCache::const_iterator pos = g_stencilCache.find( key );
+	if ( pos != g_stencilCache.end() )
+		return ( pos->second );
+	return ( boost::shared_ptr<const CqSubdivisionStencils>() );
+}
+
+
+void cacheSubdivisionStencils( const TqStencilKey& key,
+                               const boost::shared_ptr<const CqSubdivisionStencils>& stencils )
+{
+	// Neighbourhoods on a mesh are mostly alike, so a full cache is simply
+	// emptied rather than tracking the use of each entry.  Stencils taken
+	// from it before then are kept alive by their shared pointers.
+	boost::mutex::scoped_lock lock( g_stencilCacheMutex );
+	if ( g_cCachedWeights > g_maxCachedWeights )
+	{
+		g_stencilCache.clear();
+		g_cCachedWeights = 0;
+	}
+	g_stencilCache[key] = stencils;
+	g_cCachedWeights += stencils->cWeights();
+}
+
+} // namespace Aqsis
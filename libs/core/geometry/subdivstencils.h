@@ -0,0 +1,180 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+ *
+ * \brief Declares the stencil tables used to dice subdivision patches
+ * without refining the control hull.
+ */
+
+#ifndef SUBDIVSTENCILS_H_INCLUDED
+#define SUBDIVSTENCILS_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/math/vector3d.h>
+#include <aqsis/math/vectorcast.h>
+#include "parameters.h"
+
+namespace Aqsis {
+
+//----------------------------------------------------------------------
+/** \brief Sparse linear maps from the neighbourhood of a subdivision patch
+ * to the vertices of its diced grid.
+ *
+ * A patch is diced by extracting the faces around it, refining them a fixed
+ * number of times and reading off the new vertices.  Each refined value, and
+ * each limit position, is a fixed linear combination of the control values
+ * which depends only on the connectivity of the neighbourhood and the number
+ * of refinement steps.  The stencils hold those combinations, so a patch
+ * with a neighbourhood which has been seen before - in an earlier frame of a
+ * deforming mesh, or elsewhere on the same mesh - is diced by a sparse
+ * matrix multiply.
+ *
+ * Each table has one row per grid vertex, in grid order, holding weights on
+ * the local control values of the neighbourhood.
+ */
+class CqSubdivisionStencils
+{
+	public:
+		/// The stencil tables held for each neighbourhood.
+		enum EqStencilTable
+		{
+			Stencil_Limit,			///< Limit positions from "vertex" class values.
+			Stencil_Vertex,			///< Refined "vertex" class values.
+			Stencil_Varying,		///< Refined "varying" class values.
+			Stencil_FaceVarying,	///< Refined "facevarying" class values.
+			Stencil_Last
+		};
+
+		/** \brief Construct empty tables.
+		 *
+		 * \param cGridVerts - number of vertices in the diced grid.
+		 */
+		CqSubdivisionStencils( TqInt cGridVerts );
+
+		/** \brief Append the weights for the next grid vertex to a table.
+		 *
+		 * Zero weights are dropped.
+		 *
+		 * \param table - table to add to.
+		 * \param weights - weight for each local control value.
+		 * \param cWeights - length of weights.
+		 */
+		void	AddRow( EqStencilTable table, const TqFloat* weights, TqInt cWeights );
+
+		/// Get the number of grid vertices.
+		TqInt	cGridVerts() const
+		{
+			return ( m_cGridVerts );
+		}
+		/// Get the number of nonzero weights held in all tables.
+		TqInt	cWeights() const;
+
+		/** \brief Apply a table to a primitive variable.
+		 *
+		 * \param table - table to apply.
+		 * \param pSrc - primitive variable holding the control values.
+		 * \param srcIndices - index into pSrc of each local control value.
+		 * \param pDest - destination with one value per grid vertex.
+		 */
+		template<class TypeA, class TypeB>
+		void	Apply( EqStencilTable table, const CqParameterTyped<TypeA, TypeB>* pSrc,
+		               const std::vector<TqInt>& srcIndices,
+		               CqParameterTyped<TypeA, TypeB>* pDest ) const;
+
+		/** \brief Compute the limit positions of the grid vertices.
+		 *
+		 * \param pSrcP - "vertex" class positions of the control hull.
+		 * \param srcIndices - index into pSrcP of each local control vertex.
+		 * \param limitP - destination, with one position per grid vertex.
+		 */
+		void	ApplyLimit( const CqParameterTyped<CqVector4D, CqVector3D>* pSrcP,
+		                    const std::vector<TqInt>& srcIndices, CqVector3D* limitP ) const;
+
+	private:
+		/// Compressed sparse rows of weights.
+		struct SqTable
+		{
+			std::vector<TqInt>		rowStart;	///< Start of each row in indices/weights.
+			std::vector<TqInt>		indices;	///< Local control index of each weight.
+			std::vector<TqFloat>	weights;	///< Nonzero weights.
+		};
+
+		TqInt	m_cGridVerts;					///< Number of grid vertices.
+		SqTable	m_tables[Stencil_Last];			///< The tables, indexed by EqStencilTable.
+};
+
+
+/** \brief Key identifying stencils: the number of refinement steps followed
+ * by the vertex count and local vertex indices of each face of the
+ * neighbourhood.
+ */
+typedef std::vector<TqInt> TqStencilKey;
+
+/** \brief Find stencils in the stencil cache.
+ *
+ * \return The stencils, or a null pointer if the key hasn't been cached.
+ */
+boost::shared_ptr<const CqSubdivisionStencils> findSubdivisionStencils( const TqStencilKey& key );
+
+/** \brief Add stencils to the stencil cache.
+ *
+ * The cache lives for the duration of the process so that stencils are
+ * shared between frames.  It is emptied if it grows too large.  Both this
+ * and findSubdivisionStencils() may be called from several threads.
+ */
+void cacheSubdivisionStencils( const TqStencilKey& key,
+                               const boost::shared_ptr<const CqSubdivisionStencils>& stencils );
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+template<class TypeA, class TypeB>
+void CqSubdivisionStencils::Apply( EqStencilTable table, const CqParameterTyped<TypeA, TypeB>* pSrc,
+                                   const std::vector<TqInt>& srcIndices,
+                                   CqParameterTyped<TypeA, TypeB>* pDest ) const
+{
+	const SqTable& t = m_tables[table];
+	const TqInt arraysize = pSrc->Count();
+	for ( TqInt row = 0; row < m_cGridVerts; ++row )
+	{
+		TypeA* dest = pDest->pValue( row );
+		for ( TqInt arrayindex = 0; arrayindex < arraysize; ++arrayindex )
+			dest[arrayindex] = TypeA( 0.0f );
+		for ( TqInt i = t.rowStart[row]; i < t.rowStart[row+1]; ++i )
+		{
+			const TypeA* src = pSrc->pValue( srcIndices[t.indices[i]] );
+			const TqFloat w = t.weights[i];
+			for ( TqInt arrayindex = 0; arrayindex < arraysize; ++arrayindex )
+				dest[arrayindex] += static_cast<TypeA>( w * src[arrayindex] );
+		}
+	}
+}
+
+} // namespace Aqsis
+
+#endif // SUBDIVSTENCILS_H_INCLUDED
@@ -0,0 +1,157 @@
+// Aqsis
+// Copyright (C) 1997 - 2007, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Unit tests for the subdivision stencils
+ */
+
+#include "subdivstencils.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <aqsis/ri/ri.h>
+#include "subdivision2.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+namespace Aqsis
+{
+// Expose private methods of CqSurfaceSubdivisionPatch for testing.
+struct CqSurfaceSubdivisionPatch::Test
+{
+	/// Create the stencils for a patch, as Dice() does on a cache miss.
+	static boost::shared_ptr<CqSubdivisionStencils> createStencils(
+			CqSurfaceSubdivisionPatch& patch, TqInt sdcount,
+			std::vector<TqInt>& vertices)
+	{
+		std::vector<TqInt> faceVertices;
+		std::vector<TqInt> facets;
+		patch.GatherNeighbourhood(vertices, faceVertices, facets);
+		boost::shared_ptr<CqSubdivision2> pSurface = patch.Extract(0);
+		boost::shared_ptr<CqSurfaceSubdivisionPatch> pPatch(
+			new CqSurfaceSubdivisionPatch(pSurface, pSurface->pFacet(0), 0));
+		return pPatch->CreateStencils(sdcount, faceVertices.size());
+	}
+	static void refineForDice(CqSurfaceSubdivisionPatch& patch,
+			TqInt sdcount, std::vector<CqLath*>& gridLaths)
+	{
+		patch.RefineForDice(sdcount, gridLaths);
+	}
+};
+}
+
+using namespace Aqsis;
+
+namespace {
+
+// Build a Catmull-Clark hull for a cube, with one corner pulled out so that
+// the limit surface isn't symmetric.
+boost::shared_ptr<CqSubdivision2> cubeHull()
+{
+	static const TqFloat points[8][3] = {
+		{-1, -1, -1}, {1, -1, -1}, {-1, 1, -1}, {1, 1, -1},
+		{-1, -1, 1}, {1, -1, 1}, {-1, 1, 1}, {2, 1.5, 1.2}
+	};
+	static TqInt faces[6][4] = {
+		{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+		{2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}
+	};
+	boost::shared_ptr<CqPolygonPoints> pPoints(new CqPolygonPoints(8, 6, 24));
+	CqParameterTypedVertex<CqVector4D, type_hpoint, CqVector3D>* P
+		= new CqParameterTypedVertex<CqVector4D, type_hpoint, CqVector3D>("P", 1);
+	P->SetSize(8);
+	for(TqInt i = 0; i < 8; ++i)
+		P->pValue(i)[0] = CqVector4D(points[i][0], points[i][1], points[i][2]);
+	pPoints->AddPrimitiveVariable(P);
+
+	boost::shared_ptr<CqSubdivision2> pSubd2(new CqSubdivision2(pPoints));
+	pSubd2->Prepare(8);
+	pSubd2->ReserveLaths(24);
+	for(TqInt face = 0; face < 6; ++face)
+		pSubd2->AddFacet(4, faces[face], 4*face);
+	pSubd2->Finalise();
+	return pSubd2;
+}
+
+// Cache and find stencils under a range of keys.
+void cacheStencils(TqInt first, bool* found)
+{
+	for(TqInt i = first; i < first + 1000; ++i)
+	{
+		TqStencilKey key(1, -1);
+		key.push_back(i);
+		boost::shared_ptr<const CqSubdivisionStencils> stencils(
+				new CqSubdivisionStencils(1));
+		cacheSubdivisionStencils(key, stencils);
+		if(findSubdivisionStencils(key) != stencils)
+			*found = false;
+	}
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_CASE(CqSubdivisionStencils_limit_test)
+{
+	RiBegin(RI_NULL);
+	RiWorldBegin();
+	{
+		boost::shared_ptr<CqSubdivision2> pSubd2 = cubeHull();
+		boost::shared_ptr<CqSurfaceSubdivisionPatch> pPatch(
+			new CqSurfaceSubdivisionPatch(pSubd2, pSubd2->pFacet(1), 1));
+		typedef CqSurfaceSubdivisionPatch::Test Test;
+		const TqInt sdcount = 2;
+
+		std::vector<TqInt> vertices;
+		boost::shared_ptr<CqSubdivisionStencils> stencils
+			= Test::createStencils(*pPatch, sdcount, vertices);
+		std::vector<CqVector3D> stencilP(stencils->cGridVerts());
+		stencils->ApplyLimit(pSubd2->pPoints()->P(), vertices, &stencilP[0]);
+
+		// The stencils must give the limit points found by refining the hull
+		// itself.
+		std::vector<CqLath*> gridLaths;
+		Test::refineForDice(*pPatch, sdcount, gridLaths);
+		BOOST_REQUIRE_EQUAL(gridLaths.size(), stencilP.size());
+		for(TqUint i = 0; i < gridLaths.size(); ++i)
+		{
+			CqVector3D limitP = pSubd2->limitPoint(gridLaths[i]);
+			BOOST_CHECK_SMALL((limitP - stencilP[i]).Magnitude(), 1e-5f);
+		}
+	}
+	RiWorldEnd();
+	RiEnd();
+}
+
+BOOST_AUTO_TEST_CASE(CqSubdivisionStencils_cache_threads_test)
+{
+	const TqInt numThreads = 4;
+	bool found[numThreads];
+	boost::thread_group threads;
+	for(TqInt t = 0; t < numThreads; ++t)
+	{
+		found[t] = true;
+		threads.create_thread(boost::bind(&cacheStencils, 1000*t, &found[t]));
+	}
+	threads.join_all();
+	for(TqInt t = 0; t < numThreads; ++t)
+		BOOST_CHECK(found[t]);
+}
@@ -156,6 +156,8 @@ CqSurface::CqSurface()
 	m_pTransform(QGetRenderContext()->ptransCurrent()),
 	m_uDiceSize(1),
 	m_vDiceSize(1),
+	m_uDiceEstimate(0),
+	m_vDiceEstimate(0),
 	m_SplitDir(SplitDir_U),
 	m_CachedBound(false),
 	m_Bound(),
@@ -216,6 +218,28 @@ void CqSurface::CloneData( CqSurface* clone ) const
 	clone->ClonePrimitiveVariables(*this);
 }
 
+//---------------------------------------------------------------------
+/** Clone the data of a deforming surface, including each motion stage.
+ */
+
+bool CqDeformingSurface::CloneData( CqDeformingSurface* clone ) const
+{
+	clone->m_fDiceable = m_fDiceable;
+	clone->m_SplitCount = m_SplitCount;
+	clone->m_fDiscard = m_fDiscard;
+	clone->CqSurface::SetSurfaceParameters( *this );
+
+	TqInt i;
+	for ( i = 0; i < cTimes(); i++ )
+	{
+		boost::shared_ptr<CqSurface> pStage( GetMotionObject( Time( i ) ) ->Clone() );
+		if ( !pStage )
+			return ( false );
+		clone->AddTimeSlot( Time( i ), pStage );
+	}
+	return ( true );
+}
+
 //---------------------------------------------------------------------
 /** Copy all the primitive variables from the donor to this.
  */
@@ -504,6 +528,9 @@ CqMicroPolyGridBase* CqSurface::Dice()
 	if ( isDONE( lDone, EnvVars_Ng ) )
 		pGrid->SetbGeometricNormals( true );
 
+	if ( isDONE( lDone, EnvVars_dPdu ) && isDONE( lDone, EnvVars_dPdv ) )
+		pGrid->SetbSurfaceDerivatives( true );
+
 	// Now we need to dice the user specified parameters as appropriate.
 	std::vector<CqParameter*>::iterator iUP;
 	std::vector<CqParameter*>::iterator end = m_aUserParams.end();
@@ -558,7 +585,9 @@ TqInt CqSurface::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
 		static_cast<CqSurface*>( aSplits[ 1 ].get() ) ->AddPrimitiveVariable( pNewB );
 	}
 
-	if ( !m_fDiceable )
+	if ( m_fDiceable )
+		PassDiceEstimate( aSplits, direction, !direction );
+	else
 	{
 		std::vector<boost::shared_ptr<CqSurface> > aSplits0;
 		std::vector<boost::shared_ptr<CqSurface> > aSplits1;
@@ -577,6 +606,60 @@ TqInt CqSurface::Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits )
 }
 
 
+//---------------------------------------------------------------------
+/** Pass the dice size found by Diceable() on to the split GPrims.
+ * \param aSplits The GPrims split from this one.
+ * \param uSplit Whether the split was made in u.
+ * \param vSplit Whether the split was made in v.
+ */
+
+void CqSurface::PassDiceEstimate( std::vector<boost::shared_ptr<CqSurface> >& aSplits,
+                                  bool uSplit, bool vSplit ) const
+{
+	TqFloat uEstimate = uSplit ? 0.5f * m_uDiceSize : m_uDiceSize;
+	TqFloat vEstimate = vSplit ? 0.5f * m_vDiceSize : m_vDiceSize;
+	std::vector<boost::shared_ptr<CqSurface> >::iterator iSplit;
+	for ( iSplit = aSplits.begin(); iSplit != aSplits.end(); ++iSplit )
+	{
+		( *iSplit ) ->m_uDiceEstimate = uEstimate;
+		( *iSplit ) ->m_vDiceEstimate = vEstimate;
+	}
+}
+
+
+//---------------------------------------------------------------------
+/** Decide from the estimated dice size whether to split again without
+ * testing the GPrim.
+ *
+ * The estimate is only trusted when it is many times over the grid size
+ * limit, so that GPrims whose size isn't halved evenly by the split, such
+ * as patches with uneven parameterisation, still get a Diceable() test
+ * well before they are small enough to dice.
+ */
+
+bool CqSurface::SplitFromDiceEstimate()
+{
+	if ( !m_fDiceable || m_uDiceEstimate <= 0 || m_vDiceEstimate <= 0 )
+		return ( false );
+
+	TqFloat gs = 16.0f;
+	const TqFloat* poptGridSize = QGetRenderContext() ->poptCurrent()->GetFloatOption( "System", "SqrtGridSize" );
+	if( NULL != poptGridSize )
+		gs = poptGridSize[0];
+
+	// Split without testing only if the estimated grid is more than sixteen
+	// times the largest allowed.
+	const TqFloat margin = 16.0f;
+	if ( m_uDiceEstimate * m_vDiceEstimate <= margin * gs * gs )
+		return ( false );
+
+	m_uDiceSize = max<TqInt>( lround( m_uDiceEstimate ), 1 );
+	m_vDiceSize = max<TqInt>( lround( m_vDiceEstimate ), 1 );
+	m_SplitDir = ( m_uDiceEstimate > m_vDiceEstimate ) ? SplitDir_U : SplitDir_V;
+	return ( true );
+}
+
+
 //---------------------------------------------------------------------
 /** uSubdivide any user defined parameter variables.
  */
@@ -139,6 +139,16 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 			return ( boost::static_pointer_cast<IqTransform>( m_pTransform ) );
 		}
 		virtual	void	SetSurfaceParameters( const CqSurface& From );
+		/** Replace the attributes and transformation state associated with this GPrim.
+		 * Used when instancing a retained object.
+		 * \param pAttributes Attributes of the instance.
+		 * \param pTransform Transformation of the instance.
+		 */
+		virtual	void	SetInstanceParameters( const CqAttributesPtr& pAttributes, const CqTransformPtr& pTransform )
+		{
+			m_pAttributes = pAttributes;
+			m_pTransform = pTransform;
+		}
 		/** Force this GPrim to be undiceable, usually if it crosses the epsilon and eye plane.
 		 */
 		virtual	void	ForceUndiceable()
@@ -166,6 +176,19 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 			m_vDiceSize = From->m_vDiceSize;
 			m_SplitDir = From->m_SplitDir;
 		}
+		/** Decide from the dice size estimated when the parent GPrim was
+		 * split whether this GPrim is still so far over the grid size limit
+		 * that it must be split again, without running the Diceable() test.
+		 * If so, the dice size and split direction are taken from the
+		 * estimate, ready for Split().
+		 */
+		virtual bool	SplitFromDiceEstimate();
+		/** Get the class of GPrim to count tessellation statistics against.
+		 */
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( CqStats::GPrimClass_Other );
+		}
 
 		/** Determine whether this GPrim is to be discardrd.
 		 */
@@ -548,6 +571,14 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 
 		virtual	CqMicroPolyGridBase* Dice();
 		virtual	TqInt	Split( std::vector<boost::shared_ptr<CqSurface> >& aSplits );
+		/** Start any slow preparation for Split() in the background.
+		 *
+		 * Called on the render thread for surfaces in buckets which will be
+		 * rendered soon, so that work such as reading files can overlap the
+		 * rendering of earlier buckets.  May be called more than once.
+		 */
+		virtual	void	Prefetch()
+		{}
 
 		virtual bool isMoving() const
 		{
@@ -596,6 +627,11 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 		 *  on the derived classes.
 		 */
 		void CloneData(CqSurface* clone) const;
+		/** Pass the dice size found by Diceable() on to the GPrims split
+		 * from this one, halved in each direction the split was made in.
+		 */
+		void PassDiceEstimate( std::vector<boost::shared_ptr<CqSurface> >& aSplits,
+		                       bool uSplit, bool vSplit ) const;
 		std::vector<CqParameter*>	m_aUserParams;			///< Storage for user defined paramter variables.
 		TqInt	m_aiStdPrimitiveVars[ EnvVars_Last ];		///< Quick lookup index into the primitive variables table for standard variables.
 
@@ -604,6 +640,8 @@ class CqSurface : public IqSurface, private boost::noncopyable, public boost::en
 
 		TqInt	m_uDiceSize;		///< Calculated dice size to achieve an appropriate shading rate.
 		TqInt	m_vDiceSize;		///< Calculated dice size to achieve an appropriate shading rate.
+		TqFloat	m_uDiceEstimate;	///< Dice size in u estimated from the parent GPrim, 0 if none.
+		TqFloat	m_vDiceEstimate;	///< Dice size in v estimated from the parent GPrim, 0 if none.
 		EqSplitDir	m_SplitDir;			///< The direction to split this GPrim to achieve best results.
 		bool	m_CachedBound;		///< Whether or not the bound has been cached
 		CqBound	m_Bound;			///< The cached object bound
@@ -642,18 +680,15 @@ class CqDeformingSurface : public CqSurface, public CqMotionSpec<boost::shared_p
 			}
 		}
 		/** Dice this GPrim, creating a CqMotionMicroPolyGrid with all times in.
+		 * Each key is handed over as soon as it's diced, so only the
+		 * positions of the later keys are held at once.
 		 */
 		virtual	CqMicroPolyGridBase* Dice()
 		{
 			CqMotionMicroPolyGrid* pGrid = new CqMotionMicroPolyGrid;
 			TqInt i;
 			for ( i = 0; i < cTimes(); i++ )
-			{
-				CqMicroPolyGridBase* pGrid2 = GetMotionObject( Time( i ) ) ->Dice();
-				pGrid->AddTimeSlot( Time( i ), pGrid2 );
-				ADDREF(pGrid2);
-				pGrid->SetfTriangular( pGrid2->fTriangular() );
-			}
+				pGrid->AddKey( Time( i ), GetMotionObject( Time( i ) ) ->Dice() );
 			pGrid->Initialise(m_uDiceSize, m_vDiceSize, shared_from_this());
 			return ( pGrid );
 		}
@@ -705,14 +740,34 @@ class CqDeformingSurface : public CqSurface, public CqMotionSpec<boost::shared_p
 				GetMotionObject( Time( i ) ) ->CopySplitInfo( GetMotionObject( Time( 0 ) ).get() );
 			return ( f );
 		}
+		/** Use the dice size estimate of the primary time slot, copying the
+		 * split info to the other times as for Diceable().
+		 */
+		virtual bool	SplitFromDiceEstimate()
+		{
+			bool f = GetMotionObject( Time( 0 ) ) ->SplitFromDiceEstimate();
+			if ( f )
+			{
+				TqInt i;
+				for ( i = 1; i < cTimes(); i++ )
+					GetMotionObject( Time( i ) ) ->CopySplitInfo( GetMotionObject( Time( 0 ) ).get() );
+			}
+			return ( f );
+		}
+		virtual CqStats::EqGPrimClass	StatsClass() const
+		{
+			return ( GetMotionObject( Time( 0 ) ) ->StatsClass() );
+		}
 
 		virtual CqSurface* Clone() const
 		{
-/* 			CqDeformingSurface* clone = new CqDeformingSurface(GetDefaultObject());
- * 			clone->CqMotionSpec<boost::shared_ptr<CqSurface> >::operator=(*this);
- * 			return(clone);
- */
-			return(NULL);
+			CqDeformingSurface* clone = new CqDeformingSurface( boost::shared_ptr<CqSurface>() );
+			if ( !CloneData( clone ) )
+			{
+				delete clone;
+				return ( NULL );
+			}
+			return ( clone );
 		}
 
 
@@ -749,6 +804,15 @@ class CqDeformingSurface : public CqSurface, public CqMotionSpec<boost::shared_p
 			for ( i = 0; i < cTimes(); i++ )
 				GetMotionObject( Time( i ) ) ->SetSurfaceParameters( From );
 		}
+		/** Set the instance parameters of this and all GPrims.
+		 */
+		virtual	void	SetInstanceParameters( const CqAttributesPtr& pAttributes, const CqTransformPtr& pTransform )
+		{
+			CqSurface::SetInstanceParameters( pAttributes, pTransform );
+			TqInt i;
+			for ( i = 0; i < cTimes(); i++ )
+				GetMotionObject( Time( i ) ) ->SetInstanceParameters( pAttributes, pTransform );
+		}
 		/** Force all GPrims to be undiceable.
 		 */
 		virtual	void	ForceUndiceable()
@@ -800,8 +864,9 @@ class CqDeformingSurface : public CqSurface, public CqMotionSpec<boost::shared_p
 	protected:
 		/** Protected member function to clone the data, used by the Clone() functions
 		 *  on the derived classes.
+		 * \return false if any of the motion stages can't be cloned.
 		 */
-		void CloneData(CqDeformingSurface* clone) const;
+		bool CloneData(CqDeformingSurface* clone) const;
 
 };
 
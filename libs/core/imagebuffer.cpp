@@ -507,14 +507,19 @@ void CqImageBuffer::RepostSurface(const CqBucket& oldBucket,
 }
 
 //----------------------------------------------------------------------
-/** Add a new micro polygon to the list of waiting ones.
- * \param pmpgNew Pointer to a CqMicroPolygon derived class.
+/** Find the range of buckets touched by a micropolygon bound.
+ * \param bound Raster space bound of the micropolygon.
+ * \param iXBa Returns the first bucket column touched.
+ * \param iYBa Returns the first bucket row touched.
+ * \param iXBb Returns the last bucket column touched.
+ * \param iYBb Returns the last bucket row touched.
+ * \return false if the bound touches no bucket.
  */
 
-void CqImageBuffer::AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew )
+bool CqImageBuffer::BucketRange( const CqBound& bound, TqInt& iXBa, TqInt& iYBa, TqInt& iXBb, TqInt& iYBb ) const
 {
 	CqRenderer* renderContext = QGetRenderContext();
-	CqBound B = pmpgNew->GetBound();
+	CqBound B = bound;
 
 	// Expand the micropolygon bound for DoF if necessary.
 	if(renderContext->UsingDepthOfField())
@@ -535,17 +540,9 @@ void CqImageBuffer::AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew )
 	     B.vecMin().x() > renderContext->cropWindowXMax() + m_optCache.xFiltSize / 2.0f ||
 	     B.vecMin().y() > renderContext->cropWindowYMax() + m_optCache.yFiltSize / 2.0f )
 	{
-		return;
+		return false;
 	}
 
-	////////// Dump the micro polygon into a dump file //////////
-#if ENABLE_MPDUMP
-	if(m_mpdump.IsOpen())
-		m_mpdump.dump(*pmpgNew);
-#endif
-	/////////////////////////////////////////////////////////////
-
-
 	// Find out the minimum bucket touched by the micropoly bound.
 
 	B.vecMin().x( B.vecMin().x() - (lfloor(m_optCache.xFiltSize / 2.0f)) );
@@ -553,15 +550,15 @@ void CqImageBuffer::AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew )
 	B.vecMax().x( B.vecMax().x() + (lfloor(m_optCache.xFiltSize / 2.0f)) );
 	B.vecMax().y( B.vecMax().y() + (lfloor(m_optCache.yFiltSize / 2.0f)) );
 
-	TqInt iXBa = static_cast<TqInt>( B.vecMin().x() / m_optCache.xBucketSize );
-	TqInt iYBa = static_cast<TqInt>( B.vecMin().y() / m_optCache.yBucketSize );
-	TqInt iXBb = static_cast<TqInt>( B.vecMax().x() / m_optCache.xBucketSize );
-	TqInt iYBb = static_cast<TqInt>( B.vecMax().y() / m_optCache.yBucketSize );
+	iXBa = static_cast<TqInt>( B.vecMin().x() / m_optCache.xBucketSize );
+	iYBa = static_cast<TqInt>( B.vecMin().y() / m_optCache.yBucketSize );
+	iXBb = static_cast<TqInt>( B.vecMax().x() / m_optCache.xBucketSize );
+	iYBb = static_cast<TqInt>( B.vecMax().y() / m_optCache.yBucketSize );
 
 	if ( ( iXBb < m_bucketRegion.xMin() ) || ( iYBb < m_bucketRegion.yMin() ) ||
 	        ( iXBa >= m_bucketRegion.xMax() ) || ( iYBa >= m_bucketRegion.yMax() ) )
 	{
-		return ;
+		return false;
 	}
 
 	// Use sane values -- otherwise sometimes crashes, probably
@@ -571,22 +568,53 @@ void CqImageBuffer::AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew )
 	if ( iXBb >= m_bucketRegion.xMax() )  iXBb = m_bucketRegion.xMax() - 1;
 	if ( iYBb >= m_bucketRegion.yMax() )  iYBb = m_bucketRegion.yMax() - 1;
 
+	return true;
+}
+
+//----------------------------------------------------------------------
+/** Add a new micro polygon to the list of waiting ones.
+ * \param pmpgNew Pointer to a CqMicroPolygon derived class.
+ */
+
+void CqImageBuffer::AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew )
+{
+	TqInt iXBa, iYBa, iXBb, iYBb;
+	if ( !BucketRange( pmpgNew->GetBound(), iXBa, iYBa, iXBb, iYBb ) )
+		return;
+
+	////////// Dump the micro polygon into a dump file //////////
+#if ENABLE_MPDUMP
+	if(m_mpdump.IsOpen())
+		m_mpdump.dump(*pmpgNew);
+#endif
+	/////////////////////////////////////////////////////////////
+
 	// Add the MP to all the Buckets that it touches
 	for ( TqInt i = iXBa; i <= iXBb; i++ )
 	{
 		for ( TqInt j = iYBa; j <= iYBb; j++ )
-		{
-			CqBucket* bucket = &Bucket( i, j );
-			// Only add the MPG if the bucket isn't processed.
-			// \note It is possible for this to happen validly, if a primitive is occlusion culled in a 
-			// previous bucket, and not in a subsequent one. When it gets processed in the later bucket
-			// the MPGs can leak into the previous one, shouldn't be a problem, as the occlusion culling 
-			// means the MPGs shouldn't be rendered in that bucket anyway.
-			if ( !bucket->IsProcessed() )
-			{
-				bucket->AddMP( pmpgNew );
-			}
-		}
+			AddMPG( pmpgNew, i, j );
+	}
+}
+
+//----------------------------------------------------------------------
+/** Add a new micro polygon to the list of waiting ones of a single bucket.
+ * \param pmpgNew Pointer to a CqMicroPolygon derived class.
+ * \param iXB Column of the bucket.
+ * \param iYB Row of the bucket.
+ */
+
+void CqImageBuffer::AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew, TqInt iXB, TqInt iYB )
+{
+	CqBucket* bucket = &Bucket( iXB, iYB );
+	// Only add the MPG if the bucket isn't processed.
+	// \note It is possible for this to happen validly, if a primitive is occlusion culled in a 
+	// previous bucket, and not in a subsequent one. When it gets processed in the later bucket
+	// the MPGs can leak into the previous one, shouldn't be a problem, as the occlusion culling 
+	// means the MPGs shouldn't be rendered in that bucket anyway.
+	if ( !bucket->IsProcessed() )
+	{
+		bucket->AddMP( pmpgNew );
 	}
 }
 
@@ -703,6 +731,18 @@ void CqImageBuffer::RenderImage()
 			sampler = &gridSampler;
 	}
 
+	// Archives read by procedurals are parsed in the background while the
+	// buckets before them are rendered, looking one row of buckets ahead.
+	// Each bucket is scanned as it enters the window, and again when it's
+	// about to be processed to pick up any surfaces posted to it since.
+	const bool prefetch = QGetRenderContext()->archivePrefetcher().enabled();
+	const TqInt prefetchDistance = m_bucketRegion.width();
+	if(prefetch)
+	{
+		for(TqInt i = 1; i < prefetchDistance; ++i)
+			PrefetchBucket(i);
+	}
+
 	// Iterate over all buckets...
 	bool pendingBuckets = true;
 	while ( pendingBuckets && !m_fQuit )
@@ -712,6 +752,12 @@ void CqImageBuffer::RenderImage()
 
 		for (int i = 0; pendingBuckets && i < numConcurrentBuckets; ++i)
 		{
+			if(prefetch)
+			{
+				PrefetchBucket(0);
+				PrefetchBucket(prefetchDistance);
+			}
+
 			bucketProcessors[i]->setBucket(&CurrentBucket());
 
 			// Prepare the bucket processor
@@ -781,6 +827,21 @@ void CqImageBuffer::Quit()
 	m_fQuit = true;
 }
 
+//----------------------------------------------------------------------
+/** Start preparing the surfaces in a bucket which will be processed soon.
+
+  Only the horizontal order of NextBucket() is supported.
+ */
+void CqImageBuffer::PrefetchBucket(TqInt offset)
+{
+	TqInt index = ( m_CurrentBucketRow - m_bucketRegion.yMin() ) * m_bucketRegion.width()
+		+ m_CurrentBucketCol - m_bucketRegion.xMin() + offset;
+	if( index >= m_bucketRegion.area() )
+		return;
+	Bucket( m_bucketRegion.xMin() + index % m_bucketRegion.width(),
+			m_bucketRegion.yMin() + index / m_bucketRegion.width() ).prefetchSurfaces();
+}
+
 //----------------------------------------------------------------------
 /** Move to the next bucket to process.
 
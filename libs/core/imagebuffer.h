@@ -89,6 +89,8 @@ class CqImageBuffer
 		~CqImageBuffer();
 
 		void AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew );
+		void AddMPG( boost::shared_ptr<CqMicroPolygon>& pmpgNew, TqInt iXB, TqInt iYB );
+		bool BucketRange( const CqBound& bound, TqInt& iXBa, TqInt& iYBa, TqInt& iXBb, TqInt& iYBb ) const;
 		void PostSurface( const boost::shared_ptr<CqSurface>& pSurface );
 		/** \brief Repost a previously posted surface into the next unfinished bucket.
 		 *
@@ -154,6 +156,13 @@ class CqImageBuffer
 		/** Move to the next bucket to process.
 		 */
 		bool NextBucket(EqBucketOrder order);
+		/** Start preparing the surfaces in a bucket which will be processed
+		 * soon, see CqSurface::Prefetch().
+		 *
+		 * \param offset - position of the bucket after the current one, in
+		 * the order of NextBucket().
+		 */
+		void PrefetchBucket(TqInt offset);
 
 		/** Get a pointer to the current bucket
 		 */
@@ -331,6 +331,44 @@ void CqImagePixel::Combine( enum EqDepthFilter depthfilter, CqColor zThreshold )
 	}
 }
 
+//----------------------------------------------------------------------
+/** Get the steps in the pixel visibility function for deep shadow output.
+ */
+void CqImagePixel::visibilitySteps( std::vector<SqVisibilityStep>& steps ) const
+{
+	steps.clear();
+	TqInt nSamples = numSamples();
+	TqFloat weight = 1.0f/nSamples;
+	// (depth, opacity) pairs for the hits at a sample.
+	std::vector<std::pair<TqFloat, TqFloat> > hits;
+	for(TqInt sampIdx = 0; sampIdx < nSamples; ++sampIdx)
+	{
+		const SqSampleData& sampleData = m_samples[sampIdx];
+		hits.clear();
+		for ( std::vector<SqImageSample>::const_iterator sample = sampleData.data.begin();
+		        sample != sampleData.data.end(); ++sample )
+		{
+			const TqFloat* sample_data = sampleHitData(*sample);
+			hits.push_back(std::make_pair(sample_data[Sample_Depth],
+				( clamp(sample_data[Sample_ORed], 0.0f, 1.0f)
+				+ clamp(sample_data[Sample_OGreen], 0.0f, 1.0f)
+				+ clamp(sample_data[Sample_OBlue], 0.0f, 1.0f) ) / 3));
+		}
+		if(sampleData.occludingHit.flags & SqImageSample::Flag_Valid)
+			hits.push_back(std::make_pair(sampleHitData(sampleData.occludingHit)[Sample_Depth], 1.0f));
+		std::sort(hits.begin(), hits.end());
+
+		// Attenuate the contribution of this sample through the hits.
+		TqFloat transmittance = weight;
+		for ( std::vector<std::pair<TqFloat, TqFloat> >::const_iterator hit = hits.begin();
+		        hit != hits.end() && transmittance > 0; ++hit )
+		{
+			steps.push_back(SqVisibilityStep(hit->first, -transmittance*hit->second));
+			transmittance *= 1 - hit->second;
+		}
+	}
+}
+
 void CqImagePixel::setSamples(IqSampler* sampler, CqVector2D& offset)
 {
 	TqInt nSamps = numSamples();
@@ -37,6 +37,7 @@
 
 #include	<aqsis/math/color.h>
 #include	<aqsis/math/vector2d.h>
+#include	<aqsis/tex/buffers/visibilityfunction.h>
 #include	"csgtree.h"
 #include	"optioncache.h"
 #include	"isampler.h"
@@ -252,6 +253,17 @@ class CqImagePixel : private boost::noncopyable
 		 */
 		void	Combine( EqDepthFilter eDepthFilter, CqColor zThreshold );
 
+		/** \brief Get the changes in visibility through this pixel with depth.
+		 *
+		 *  Each hit at a sample point reduces the visibility of the pixel
+		 *  by the opacity of the hit times the transmittance of the hits in
+		 *  front of it, with all samples weighted equally.  This must be
+		 *  called before Combine(), which overwrites the hit data.
+		 *
+		 *  \param steps - returns the list of visibility steps, unsorted.
+		 */
+		void	visibilitySteps( std::vector<SqVisibilityStep>& steps ) const;
+
 		/** \brief Get the sample data for the specified sample index.
 		 *
 		 * \param The index of the required sample point.
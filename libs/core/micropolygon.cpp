@@ -33,6 +33,7 @@
 #include	"shaders.h"
 #include	"trimcurve.h"
 #include	<aqsis/math/derivatives.h>
+#include	<aqsis/tex/filtering/itexturecache.h>
 #include	"bucketprocessor.h"
 
 #include	"mpdump.h"
@@ -41,7 +42,6 @@ namespace Aqsis {
 
 
 CqObjectPool<CqMicroPolygon> CqMicroPolygon::m_thePool;
-CqObjectPool<CqMovingMicroPolygonKey>	CqMovingMicroPolygonKey::m_thePool;
 
 void CqMicroPolyGridBase::CacheGridInfo(const boost::shared_ptr<const CqSurface>& surface)
 {
@@ -73,6 +73,8 @@ void CqMicroPolyGridBase::CacheGridInfo(const boost::shared_ptr<const CqSurface>
 CqMicroPolyGrid::CqMicroPolyGrid() : CqMicroPolyGridBase(),
 		m_bShadingNormals( false ),
 		m_bGeometricNormals( false ), 
+		m_bSurfaceDerivatives( false ),
+		m_vStripRes( 0 ),
 		m_pShaderExecEnv(IqShaderExecEnv::create(QGetRenderContextI()))
 {
 	STATS_INC( GRD_allocated );
@@ -147,6 +149,19 @@ void CqMicroPolyGrid::Initialise( TqInt cu, TqInt cv, const boost::shared_ptr<Cq
 	CacheGridInfo(pSurface);
 
 	STATS_INC( GRD_size_4 + clamp<TqInt>(CqStats::stats_log2(size) - 2, 0, 7) );
+	STATS_GPC_INC( pSurface->StatsClass(),
+			GPC_grid_size_4 + clamp<TqInt>(CqStats::stats_log2(size) - 2, 0, 7) );
+}
+
+//---------------------------------------------------------------------
+/** Divide the grid into independent strips of rows along v.
+ */
+
+void CqMicroPolyGrid::SetVStripRes( TqInt vStripRes )
+{
+	assert( ( vGridRes() + 1 ) % vStripRes == 0 );
+	m_vStripRes = vStripRes;
+	m_pShaderExecEnv->SetVStripRes( vStripRes );
 }
 
 //---------------------------------------------------------------------
@@ -338,6 +353,47 @@ void CqMicroPolyGrid::ExpandGridBoundaries(TqFloat amount)
 }
 
 
+//---------------------------------------------------------------------
+void CqMicroPolyGrid::PrefetchTextures(TqInt lUses)
+{
+	if ( !USES( lUses, EnvVars_s ) || !USES( lUses, EnvVars_t )
+		|| NULL == pVar(EnvVars_s) || NULL == pVar(EnvVars_t) )
+		return;
+	IqTextureCache& texCache = QGetRenderContext()->textureCache();
+	TqFloat time = QGetRenderContext()->Time();
+	const IqShader* shaders[] = {
+		pAttributes()->pshadDisplacement(time).get(),
+		pAttributes()->pshadSurface(time).get()
+	};
+	if ( !shaders[0] && !shaders[1] )
+		return;
+
+	// Bound the texture coordinates over the grid.
+	TqFloat* pS = NULL;
+	TqFloat* pT = NULL;
+	pVar(EnvVars_s)->GetFloatPtr( pS );
+	pVar(EnvVars_t)->GetFloatPtr( pT );
+	TqInt gs = m_pShaderExecEnv->shadingPointCount();
+	TqFloat sMin = FLT_MAX, sMax = -FLT_MAX;
+	TqFloat tMin = FLT_MAX, tMax = -FLT_MAX;
+	for ( TqInt i = 0; i < gs; ++i )
+	{
+		sMin = min( sMin, pS[i] );
+		sMax = max( sMax, pS[i] );
+		tMin = min( tMin, pT[i] );
+		tMax = max( tMax, pT[i] );
+	}
+	// Estimate the size of a micropolygon in texture space, which is
+	// roughly the filter width used by texture() with default options.
+	TqFloat filterWidth = max( ( sMax - sMin ) / max( m_pShaderExecEnv->uGridRes(), 1 ),
+	                           ( tMax - tMin ) / max( m_pShaderExecEnv->vGridRes(), 1 ) );
+	for ( TqInt i = 0; i < 2; ++i )
+	{
+		if ( shaders[i] )
+			texCache.prefetchTextures( shaders[i], sMin, sMax, tMin, tMax, filterWidth );
+	}
+}
+
 //---------------------------------------------------------------------
 /** Shade the grid using the surface parameters of the surface passed and store the color values for each micropolygon.
  */
@@ -403,8 +459,8 @@ void CqMicroPolyGrid::Shade( bool canCullGrid )
 			break;
 	}
 
-	// Calculate surface derivatives if necessary.
-	if ( USES( lUses, EnvVars_dPdu ) || USES( lUses, EnvVars_dPdv ) )
+	// Calculate surface derivatives if necessary, and not specified by the surface.
+	if ( !bSurfaceDerivatives() && ( USES( lUses, EnvVars_dPdu ) || USES( lUses, EnvVars_dPdv ) ) )
 		CalcSurfaceDerivatives();
 
 	// Initialize surface color Ci to black
@@ -414,6 +470,10 @@ void CqMicroPolyGrid::Shade( bool canCullGrid )
 	if ( USES( lUses, EnvVars_Oi ) )
 		pVar(EnvVars_Oi) ->SetColor( gColWhite );
 
+	// Get texture reads going in the background while displacement and
+	// surface shading proceed.
+	PrefetchTextures(lUses);
+
 	boost::shared_ptr<IqShader> pshadDisplacement = pSurface()->pAttributes()->pshadDisplacement(QGetRenderContext()->Time());
 	if ( pshadDisplacement )
 	{
@@ -468,6 +528,7 @@ void CqMicroPolyGrid::Shade( bool canCullGrid )
 		{
 			m_fCulled = true;
 			STATS_INC( GRD_culled );
+			STATS_GPC_INC( pSurface()->StatsClass(), GPC_grid_culled );
 			DeleteVariables( true );
 			return ;
 		}
@@ -516,6 +577,7 @@ void CqMicroPolyGrid::Shade( bool canCullGrid )
 		{
 			m_fCulled = true;
 			STATS_INC( GRD_culled );
+			STATS_GPC_INC( pSurface()->StatsClass(), GPC_grid_culled );
 			DeleteVariables( true );
 			return ;
 		}
@@ -673,39 +735,75 @@ void CqMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 			keyframeTimes[cameraTransform->Time(iTime)] = iTime;
 
 	TqInt tTime = keyframeTimes.size();
-	std::vector<std::vector<CqVector3D> > aaPtimes;
-	aaPtimes.resize( tTime );
 
 	CqMatrix matObjectToCameraT;
 	register TqInt i;
 	TqInt gsmin1;
 	gsmin1 = m_pShaderExecEnv->shadingPointCount() - 1;
 
-	std::map<TqFloat, TqInt>::iterator keyFrame;
-	for ( keyFrame = keyframeTimes.begin(); keyFrame!=keyframeTimes.end(); keyFrame++ )
+	// The moving micropolygons read their positions at each keyframe from
+	// the grid, so they're only stored once.
+	if ( tTime > 1 )
 	{
-		QGetRenderContext() ->matSpaceToSpace( "object", "camera", NULL, pSurface() ->pTransform().get(), keyFrame->first, matObjectToCameraT );
-		aaPtimes[ keyFrame->second ].resize( gsmin1 + 1 );
-
-		for ( i = gsmin1; i >= 0; i-- )
+		m_keyPointCount = gsmin1 + 1;
+		m_keyPositions.resize( tTime * m_keyPointCount );
+		m_keyTimes.clear();
+		std::map<TqFloat, TqInt>::iterator keyFrame;
+		for ( keyFrame = keyframeTimes.begin(); keyFrame!=keyframeTimes.end(); keyFrame++ )
 		{
-			CqVector3D Point( pP[ i ] );
+			QGetRenderContext() ->matSpaceToSpace( "object", "camera", NULL, pSurface() ->pTransform().get(), keyFrame->first, matObjectToCameraT );
+			CqVector3D* pKeyP = &m_keyPositions[ m_keyTimes.size() * m_keyPointCount ];
+			m_keyTimes.push_back( keyFrame->first );
 
-			// Only do the complex transform if motion blurred.
-			//Point = matObjectToCameraT * matCameraToObject0 * Point;
-			Point = matCameraToObject0 * Point;
-			Point = matObjectToCameraT * Point;
+			for ( i = gsmin1; i >= 0; i-- )
+			{
+				CqVector3D Point( pP[ i ] );
 
-			// Make sure to retain camera space 'z' coordinate.
-			TqFloat zdepth = Point.z();
-			aaPtimes[ keyFrame->second ][ i ] = matCameraToRaster * Point;
-			aaPtimes[ keyFrame->second ][ i ].z( zdepth );
+				// Only do the complex transform if motion blurred.
+				//Point = matObjectToCameraT * matCameraToObject0 * Point;
+				Point = matCameraToObject0 * Point;
+				Point = matObjectToCameraT * Point;
+
+				// Make sure to retain camera space 'z' coordinate.
+				TqFloat zdepth = Point.z();
+				pKeyP[ i ] = matCameraToRaster * Point;
+				pKeyP[ i ].z( zdepth );
+			}
+			SqTriangleSplitLine sl;
+			CqVector3D v0, v1, v2;
+			v0 = pKeyP[ 0 ];
+			v1 = pKeyP[ cu ];
+			v2 = pKeyP[ cv * ( cu + 1 ) ];
+			// Check for clockwise, swap if not.
+			if( ( ( v1.x() - v0.x() ) * ( v2.y() - v0.y() ) - ( v1.y() - v0.y() ) * ( v2.x() - v0.x() ) ) >= 0 )
+			{
+				sl.m_TriangleSplitPoint1 = v1;
+				sl.m_TriangleSplitPoint2 = v2;
+			}
+			else
+			{
+				sl.m_TriangleSplitPoint1 = v2;
+				sl.m_TriangleSplitPoint2 = v1;
+			}
+			m_TriangleSplitLine.AddTimeSlot(keyFrame->first, sl );
 		}
+	}
+
+	for ( i = gsmin1; i >= 0; i-- )
+	{
+		// Make sure to retain camera space 'z' coordinate.
+		TqFloat zdepth = pP[ i ].z();
+		pP[ i ] = matCameraToRaster * pP[ i ];
+		pP[ i ].z( zdepth );
+	}
+
+	if ( tTime == 1 )
+	{
 		SqTriangleSplitLine sl;
 		CqVector3D v0, v1, v2;
-		v0 = aaPtimes[ keyFrame->second ][ 0 ];
-		v1 = aaPtimes[ keyFrame->second ][ cu ];
-		v2 = aaPtimes[ keyFrame->second ][ cv * ( cu + 1 ) ];
+		v0 = pP[ 0 ];
+		v1 = pP[ cu ];
+		v2 = pP[ cv * ( cu + 1 ) ];
 		// Check for clockwise, swap if not.
 		if( ( ( v1.x() - v0.x() ) * ( v2.y() - v0.y() ) - ( v1.y() - v0.y() ) * ( v2.x() - v0.x() ) ) >= 0 )
 		{
@@ -717,37 +815,9 @@ void CqMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 			sl.m_TriangleSplitPoint1 = v2;
 			sl.m_TriangleSplitPoint2 = v1;
 		}
-		m_TriangleSplitLine.AddTimeSlot(keyFrame->first, sl );
-	}
-
-	for ( i = gsmin1; i >= 0; i-- )
-	{
-		aaPtimes[ 0 ].resize( gsmin1 + 1 );
-		// Make sure to retain camera space 'z' coordinate.
-		TqFloat zdepth = pP[ i ].z();
-		aaPtimes[ 0 ][ i ] = matCameraToRaster * pP[ i ];
-		aaPtimes[ 0 ][ i ].z( zdepth );
-		pP[ i ] = aaPtimes[ 0 ][ i ];
+		m_TriangleSplitLine.AddTimeSlot(keyframeTimes.begin()->first, sl );
 	}
 
-	SqTriangleSplitLine sl;
-	CqVector3D v0, v1, v2;
-	v0 = aaPtimes[ 0 ][ 0 ];
-	v1 = aaPtimes[ 0 ][ cu ];
-	v2 = aaPtimes[ 0 ][ cv * ( cu + 1 ) ];
-	// Check for clockwise, swap if not.
-	if( ( ( v1.x() - v0.x() ) * ( v2.y() - v0.y() ) - ( v1.y() - v0.y() ) * ( v2.x() - v0.x() ) ) >= 0 )
-	{
-		sl.m_TriangleSplitPoint1 = v1;
-		sl.m_TriangleSplitPoint2 = v2;
-	}
-	else
-	{
-		sl.m_TriangleSplitPoint1 = v2;
-		sl.m_TriangleSplitPoint2 = v1;
-	}
-	m_TriangleSplitLine.AddTimeSlot(keyframeTimes.begin()->first, sl );
-
 	AQSIS_TIMER_STOP(Project_points);
 
 	AQSIS_TIMER_START(Bust_grids);
@@ -769,6 +839,10 @@ void CqMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 //	TqFloat bigArea = 0.0;
 	for ( iv = 0; iv < cv; iv++ )
 	{
+		// Rows in different strips aren't joined.
+		if ( m_vStripRes > 0 && ( iv + 1 ) % m_vStripRes == 0 )
+			continue;
+
 		TqInt iu;
 		for ( iu = 0; iu < cu; iu++ )
 		{
@@ -839,9 +913,6 @@ void CqMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 				boost::shared_ptr<CqMicroPolygonMotion> pNew(new CqMicroPolygonMotion(this, iIndex));
 				if ( fTrimmed )
 					pNew->MarkTrimmed();
-				std::map<TqFloat, TqInt>::iterator keyFrame;
-				for ( keyFrame = keyframeTimes.begin(); keyFrame!=keyframeTimes.end(); keyFrame++ )
-					pNew->AppendKey( aaPtimes[ keyFrame->second ][ iIndex ], aaPtimes[ keyFrame->second ][ iIndex + 1 ], aaPtimes[ keyFrame->second ][ iIndex + cu + 1 ], aaPtimes[ keyFrame->second ][ iIndex + cu + 2 ],  keyFrame->first);
 				pNew->Initialise();
 				boost::shared_ptr<CqMicroPolygon> pTemp(pNew);
 				QGetRenderContext()->pImage()->AddMPG( pTemp );
@@ -857,10 +928,10 @@ void CqMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 
 			// Calculate MPG area
 			TqFloat area = 0.0f;
-			area += ( aaPtimes[ 0 ][ iIndex ].x() * aaPtimes[ 0 ][iIndex + 1 ].y() ) - ( aaPtimes[ 0 ][ iIndex ].y() * aaPtimes[ 0 ][ iIndex + 1 ].x() );
-			area += ( aaPtimes[ 0 ][ iIndex + 1].x() * aaPtimes[ 0 ][iIndex + cu + 2 ].y() ) - ( aaPtimes[ 0 ][ iIndex + 1].y() * aaPtimes[ 0 ][ iIndex + cu + 2 ].x() );
-			area += ( aaPtimes[ 0 ][ iIndex + cu + 2].x() * aaPtimes[ 0 ][iIndex + cu + 1 ].y() ) - ( aaPtimes[ 0 ][ iIndex + cu + 2 ].y() * aaPtimes[ 0 ][ iIndex + cu + 1 ].x() );
-			area += ( aaPtimes[ 0 ][ iIndex + cu + 1].x() * aaPtimes[ 0 ][iIndex ].y() ) - ( aaPtimes[ 0 ][ iIndex + cu + 1 ].y() * aaPtimes[ 0 ][ iIndex ].x() );
+			area += ( pP[ iIndex ].x() * pP[iIndex + 1 ].y() ) - ( pP[ iIndex ].y() * pP[ iIndex + 1 ].x() );
+			area += ( pP[ iIndex + 1].x() * pP[iIndex + cu + 2 ].y() ) - ( pP[ iIndex + 1].y() * pP[ iIndex + cu + 2 ].x() );
+			area += ( pP[ iIndex + cu + 2].x() * pP[iIndex + cu + 1 ].y() ) - ( pP[ iIndex + cu + 2 ].y() * pP[ iIndex + cu + 1 ].x() );
+			area += ( pP[ iIndex + cu + 1].x() * pP[iIndex ].y() ) - ( pP[ iIndex + cu + 1 ].y() * pP[ iIndex ].x() );
 			area *= 0.5f;
 			area = fabs(area);
 
@@ -913,6 +984,74 @@ CqMotionMicroPolyGrid::~CqMotionMicroPolyGrid()
 }
 
 
+//---------------------------------------------------------------------
+/** Determine whether the micropolygons of a grid may be backface culled.
+ */
+
+static bool canBackfaceCull( CqMicroPolyGridBase* pGrid )
+{
+	return ( pGrid->pAttributes() ->GetIntegerAttribute( "System", "Sides" ) [ 0 ] == 1 ) && !pGrid->usesCSG() &&
+		   ( pGrid->pAttributes() ->GetIntegerAttributeDef( "cull", "backfacing", 1 ) == 1 );
+}
+
+
+//---------------------------------------------------------------------
+/** Add a motion key, keeping only the positions of all but the first.
+ */
+
+void CqMotionMicroPolyGrid::AddKey( TqFloat time, CqMicroPolyGridBase* pGrid )
+{
+	ADDREF( pGrid );
+	SetfTriangular( pGrid->fTriangular() );
+	m_keyTimes.push_back( time );
+	if ( cTimes() == 0 )
+	{
+		// The primary grid may yet be displaced, so its positions are only
+		// filled in when split.
+		AddTimeSlot( time, pGrid );
+		m_keyPointCount = pGrid->pShaderExecEnv()->shadingPointCount();
+		m_keyPositions.resize( m_keyPointCount );
+		return;
+	}
+	assert( time > Time( cTimes() - 1 ) );
+
+	CqMicroPolyGrid* pg = static_cast<CqMicroPolyGrid*>( pGrid );
+	TqInt cPoints = m_keyPointCount;
+	assert( cPoints == static_cast<TqInt>( pg->pShaderExecEnv()->shadingPointCount() ) );
+
+	CqVector3D* pP;
+	pg->pVar(EnvVars_P) ->GetPointPtr( pP );
+	m_keyPositions.insert( m_keyPositions.end(), pP, pP + cPoints );
+
+	// The backface test is made in camera space, so it must happen now,
+	// while the normals of the key can still be computed.  See Split() for
+	// the treatment of N.
+	if ( canBackfaceCull( pg ) )
+	{
+		AQSIS_TIME_SCOPE(Backface_culling);
+		pg->CalcNormals();
+		CqVector3D* pNg;
+		pg->pVar(EnvVars_Ng)->GetNormalPtr(pNg);
+		CqVector3D* pN = NULL;
+		if ( USES( pg->pSurface() ->Uses(), EnvVars_N ) )
+			pg->pVar(EnvVars_N)->GetNormalPtr(pN);
+		if ( m_keyBFCulled.empty() )
+			m_keyBFCulled.assign( cPoints, 0 );
+		for ( TqInt i = 0; i < cPoints; i++ )
+		{
+			TqFloat s = 1.0f;
+			if(pN)
+				s = (pN[i] * pNg[i] < 0.0f) ? -1.0f : 1.0f;
+			if(s * pNg[i] * pP[i] >= 0)
+				m_keyBFCulled[i]++;
+		}
+	}
+
+	AddTimeSlot( time, static_cast<CqMicroPolyGridBase*>( NULL ) );
+	RELEASEREF( pg );
+}
+
+
 //---------------------------------------------------------------------
 /** Shade the primary grid.
  */
@@ -956,87 +1095,79 @@ void CqMotionMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 	CqMatrix matCameraToRaster;
 	QGetRenderContext() ->matSpaceToSpace( "camera", "raster", NULL, NULL, QGetRenderContext()->Time(), matCameraToRaster );
 	// Check to see if this surface is single sided, if so, we can do backface culling.
-	bool canBeBFCulled = ( pAttributes() ->GetIntegerAttribute( "System", "Sides" ) [ 0 ] == 1 ) && !pGridA->usesCSG() &&
-						 ( pAttributes() ->GetIntegerAttributeDef( "cull", "backfacing", 1 ) == 1 );
+	bool canBeBFCulled = canBackfaceCull( pGridA );
 
 	ADDREF( pGridA );
 
-	// Get an array of P's for all time positions.
-	std::vector<std::vector<CqVector3D> > aaPtimes;
-	aaPtimes.resize( cTimes() );
-	
 	TqInt tTime = cTimes();
-	CqMatrix matObjectToCameraT;
 	register TqInt i;
 	TqInt gsmin1;
 	gsmin1 = pGridA->pShaderExecEnv()->shadingPointCount() - 1;
+	assert( gsmin1 + 1 == m_keyPointCount );
+	assert( static_cast<TqInt>( m_keyPositions.size() ) == tTime * m_keyPointCount );
 
-	// Store a count of backface culling for each MP, if it equals the number of timeslots, then
-	// the MP can be culled.
+	// Store a count of backface culling for each MP, if it equals the number
+	// of timeslots, then the MP can be culled.  The later keys were counted
+	// as they were added.
 	std::vector<TqInt> totalBFCulled;
-	totalBFCulled.assign( gsmin1 + 1, 0 );
+	totalBFCulled.swap( m_keyBFCulled );
+	if ( totalBFCulled.empty() )
+		totalBFCulled.assign( gsmin1 + 1, 0 );
 
-	for ( iTime = 0; iTime < tTime; iTime++ )
-	{
-		QGetRenderContext() ->matSpaceToSpace( "object", "camera", NULL, pSurface() ->pTransform().get(), pSurface()->pTransform()->Time(iTime), matObjectToCameraT  );
-		aaPtimes[ iTime ].resize( gsmin1 + 1 );
+	CqVector3D* pP;
+	pGridA->pVar(EnvVars_P) ->GetPointPtr( pP );
 
-		CqMicroPolyGrid* pg = static_cast<CqMicroPolyGrid*>( GetMotionObject( Time( iTime ) ) );
-		CqVector3D* pP;
-		pg->pVar(EnvVars_P) ->GetPointPtr( pP );
+	// Cull any hidden MPs if Sides==1.  Note that this has to happen
+	// *before* the transformation into hybrid camera/raster space below.
+	if ( canBeBFCulled )
+	{
+		AQSIS_TIME_SCOPE(Backface_culling);
 		CqVector3D* pNg;
-		pg->pVar(EnvVars_Ng)->GetNormalPtr(pNg);
+		pGridA->pVar(EnvVars_Ng)->GetNormalPtr(pNg);
 		CqVector3D* pN = NULL;
 		if ( USES( lUses, EnvVars_N ) )
-			pg->pVar(EnvVars_N)->GetNormalPtr(pN);
-
-		// Cull any hidden MPs if Sides==1.  Note that this has to happen
-		// *before* the transformation into hybrid camera/raster space below.
-		if ( canBeBFCulled )
+			pGridA->pVar(EnvVars_N)->GetNormalPtr(pN);
+		for ( i = gsmin1; i >= 0; i-- )
 		{
-			AQSIS_TIME_SCOPE(Backface_culling);
-			if(iTime > 0)
-			{
-				// The primary grid already has geometric normals computed
-				// during shading, but additional grid keys don't so we need
-				// to compute them here.
-				pg->CalcNormals();
-			}
-			for ( i = gsmin1; i >= 0; i-- )
-			{
-				// When backface culling, we must use the geometric normal (Ng)
-				// as this is the normal that properly represents the actual
-				// micropolygon geometry. However, if the primitive specifies
-				// custom normals as primitive variables, the direction of
-				// those should be honored, in case the user has intentionally
-				// switched the surface direction.  Therefore, we compare the
-				// direction of Ng with that of N and flip Ng if they don't
-				// match.
-				TqFloat s = 1.0f;
-				if(pN)
-					s = (pN[i] * pNg[i] < 0.0f) ? -1.0f : 1.0f;
-				if(s * pNg[i] * pP[i] >= 0)
-					totalBFCulled[i]++;
-			}
+			// When backface culling, we must use the geometric normal (Ng)
+			// as this is the normal that properly represents the actual
+			// micropolygon geometry. However, if the primitive specifies
+			// custom normals as primitive variables, the direction of
+			// those should be honored, in case the user has intentionally
+			// switched the surface direction.  Therefore, we compare the
+			// direction of Ng with that of N and flip Ng if they don't
+			// match.
+			TqFloat s = 1.0f;
+			if(pN)
+				s = (pN[i] * pNg[i] < 0.0f) ? -1.0f : 1.0f;
+			if(s * pNg[i] * pP[i] >= 0)
+				totalBFCulled[i]++;
 		}
+	}
 
-		// Transform the whole grid to hybrid camera/raster space
+	// Transform the positions at each key to hybrid camera/raster space.  The
+	// primary grid is transformed in place too, as its P is used for the
+	// vertex ordering.
+	for ( iTime = 0; iTime < tTime; iTime++ )
+	{
+		CqVector3D* pKeyP = &m_keyPositions[ iTime * m_keyPointCount ];
 		for ( i = gsmin1; i >= 0; i-- )
 		{
-			CqVector3D Point( pP[ i ] );
+			CqVector3D Point( iTime == 0 ? pP[ i ] : pKeyP[ i ] );
 
 			// Make sure to retain camera space 'z' coordinate.
 			TqFloat zdepth = Point.z();
-			aaPtimes[ iTime ][ i ] = matCameraToRaster * Point;
-			aaPtimes[ iTime ][ i ].z( zdepth );
-			pP[ i ] = aaPtimes[ iTime ][ i ];
+			pKeyP[ i ] = matCameraToRaster * Point;
+			pKeyP[ i ].z( zdepth );
+			if ( iTime == 0 )
+				pP[ i ] = pKeyP[ i ];
 		}
 
 		SqTriangleSplitLine sl;
 		CqVector3D v0, v1, v2;
-		v0 = aaPtimes[ iTime ][ 0 ];
-		v1 = aaPtimes[ iTime ][ cu ];
-		v2 = aaPtimes[ iTime ][ cv * ( cu + 1 ) ];
+		v0 = pKeyP[ 0 ];
+		v1 = pKeyP[ cu ];
+		v2 = pKeyP[ cv * ( cu + 1 ) ];
 		// Check for clockwise, swap if not.
 		if( ( ( v1.x() - v0.x() ) * ( v2.y() - v0.y() ) - ( v1.y() - v0.y() ) * ( v2.x() - v0.x() ) ) >= 0 )
 		{
@@ -1065,8 +1196,13 @@ void CqMotionMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 
 	TqInt iv;
 	TqInt totalTimes = cTimes();
+	TqInt vStripRes = pGridA->vStripRes();
 	for ( iv = 0; iv < cv; iv++ )
 	{
+		// Rows in different strips aren't joined.
+		if ( vStripRes > 0 && ( iv + 1 ) % vStripRes == 0 )
+			continue;
+
 		TqInt iu;
 		for ( iu = 0; iu < cu; iu++ )
 		{
@@ -1133,8 +1269,6 @@ void CqMotionMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 			}
 
 			boost::shared_ptr<CqMicroPolygonMotion> pNew( new CqMicroPolygonMotion( this, iIndex ) );
-			for ( iTime = 0; iTime < cTimes(); iTime++ )
-				pNew->AppendKey( aaPtimes[ iTime ][ iIndex ], aaPtimes[ iTime ][ iIndex + 1 ], aaPtimes[ iTime ][ iIndex + cu + 1 ], aaPtimes[ iTime ][ iIndex + cu + 2 ], Time( iTime ) );
 			pNew->Initialise();
 			boost::shared_ptr<CqMicroPolygon> pTemp( pNew );
 			QGetRenderContext()->pImage()->AddMPG( pTemp );
@@ -1143,16 +1277,6 @@ void CqMotionMicroPolyGrid::Split( long xmin, long xmax, long ymin, long ymax )
 	AQSIS_TIMER_STOP(Bust_grids);
 
 	RELEASEREF( pGridA );
-
-	// Delete the donor motion grids, as their work is done.
-	/*    for ( iTime = 1; iTime < cTimes(); iTime++ )
-	    {
-	        CqMicroPolyGrid* pg = static_cast<CqMicroPolyGrid*>( GetMotionObject( Time( iTime ) ) );
-	        if ( NULL != pg )
-	            RELEASEREF( pg );
-	    }
-	    //		delete( GetMotionObject( Time( iTime ) ) );
-	*/
 }
 
 
@@ -1463,6 +1587,7 @@ void CqMicroPolygon::InterpolateOutputs(const SqMpgSampleInfo& cache,
 
 void CqMicroPolygon::CacheOutputInterpCoeffsConstant(SqMpgSampleInfo& cache) const
 {
+	cache.gridIndex = m_Index;
 	if(IqShaderData* Ci = m_pGrid->pVar(EnvVars_Ci))
 	{
 		const CqColor* col = 0;
@@ -1490,6 +1615,7 @@ void CqMicroPolygon::CacheOutputInterpCoeffsConstant(SqMpgSampleInfo& cache) con
 
 void CqMicroPolygon::CacheOutputInterpCoeffsSmooth(SqMpgSampleInfo& cache) const
 {
+	cache.gridIndex = m_Index;
 	TqInt indices[4] = {m_Index, m_Index+1, m_Index + pGrid()->uGridRes() + 1,
 						m_Index + pGrid()->uGridRes() + 2};
 	if(IqShaderData* Ci = m_pGrid->pVar(EnvVars_Ci))
@@ -1681,6 +1807,37 @@ void CqMicroPolygon::CalculateBound()
 void CqMicroPolygonMotion::Initialise()
 {
 	ComputeVertexOrder();
+	m_Bound = KeyBound( 0 );
+	for ( TqInt iKey = 1, numKeys = m_pGrid->cKeys(); iKey < numKeys; iKey++ )
+	{
+		CqBound B( KeyBound( iKey ) );
+		m_Bound.Encapsulate( &B );
+	}
+}
+
+//---------------------------------------------------------------------
+/** Get the vertices of the micropolygon at the given key, in the same order
+ * as CqMicroPolygon::GetVertices().
+ */
+void CqMicroPolygonMotion::KeyVertices( TqInt iKey, CqVector3D P[4] ) const
+{
+	const CqVector3D* pP = m_pGrid->KeyPositions( iKey );
+	TqInt cu = m_pGrid->uGridRes();
+	P[0] = pP[ m_Index ];
+	P[1] = pP[ m_Index + 1 ];
+	P[2] = pP[ m_Index + cu + 1 ];
+	P[3] = pP[ m_Index + cu + 2 ];
+}
+
+//---------------------------------------------------------------------
+/** Calculate the bound of the micropolygon at the given key.
+ */
+CqBound CqMicroPolygonMotion::KeyBound( TqInt iKey ) const
+{
+	CqVector3D P[4];
+	KeyVertices( iKey, P );
+	return ( CqBound( min( min( P[0], P[1] ), min( P[2], P[3] ) ),
+					  max( max( P[0], P[1] ), max( P[2], P[3] ) ) ) );
 }
 
 //---------------------------------------------------------------------
@@ -1690,17 +1847,22 @@ void CqMicroPolygonMotion::BuildBoundList(TqUint timeRanges)
 {
 	TqFloat opentime = QGetRenderContext() ->poptCurrent()->GetFloatOption( "System", "Shutter" ) [ 0 ];
 	TqFloat closetime = QGetRenderContext() ->poptCurrent()->GetFloatOption( "System", "Shutter" ) [ 1 ];
+	TqInt numKeys = m_pGrid->cKeys();
 
 	m_BoundList.Clear();
 
-	assert( NULL != m_Keys[ 0 ] );
+	// The key bounds are cheap to find from the grid, but are needed
+	// several times over below.
+	std::vector<CqBound> keyBounds( numKeys );
+	for ( TqInt iKey = 0; iKey < numKeys; iKey++ )
+		keyBounds[ iKey ] = KeyBound( iKey );
 
 	// Compute an approximation of the number of micropolygon lengths moved in
 	// raster space.  We use this to guide how many sub-bounds to calcuate.
-	TqFloat polyLen2 = vectorCast<CqVector2D>(m_Keys.front()->GetBound().vecCross())
+	TqFloat polyLen2 = vectorCast<CqVector2D>(keyBounds.front().vecCross())
 						.Magnitude2();
-	TqFloat moveDist2 = (vectorCast<CqVector2D>(m_Keys.front()->m_Point0)
-						- vectorCast<CqVector2D>(m_Keys.back()->m_Point0))
+	TqFloat moveDist2 = (vectorCast<CqVector2D>(m_pGrid->KeyPositions( 0 )[ m_Index ])
+						- vectorCast<CqVector2D>(m_pGrid->KeyPositions( numKeys - 1 )[ m_Index ]))
 						.Magnitude2();
 	TqInt polyLengthsMoved = max<TqInt>(1, lfloor(std::sqrt(moveDist2/polyLen2)));
 
@@ -1708,8 +1870,8 @@ void CqMicroPolygonMotion::BuildBoundList(TqUint timeRanges)
 	TqFloat dt = (closetime - opentime) / divisions;
 	TqFloat time = opentime + dt;
 	TqInt startKey = 0;
-	TqUint endKey = 1;
-	CqBound bound = m_Keys[startKey]->GetBound();
+	TqInt endKey = 1;
+	CqBound bound = keyBounds[startKey];
 
 	m_BoundList.SetSize( divisions );
 
@@ -1717,16 +1879,16 @@ void CqMicroPolygonMotion::BuildBoundList(TqUint timeRanges)
 	for(TqUint i = 0; i < divisions; i++)
 	{
 		// find the fist key with a time greater than our end time.
-		while(time > m_Times[endKey] && endKey < m_Keys.size() - 1)
+		while(time > m_pGrid->KeyTime(endKey) && endKey < numKeys - 1)
 			++endKey;
 
 		// interpolate between this key and the previous to get the
 		// bound at our end time.
 		TqInt endKey_1 = endKey - 1;
-		const CqBound& end0 = m_Keys[endKey_1]->GetBound();
-		TqFloat end0Time = m_Times[endKey_1];
-		const CqBound& end1 = m_Keys[endKey]->GetBound();
-		TqFloat end1Time = m_Times[endKey];
+		const CqBound& end0 = keyBounds[endKey_1];
+		TqFloat end0Time = m_pGrid->KeyTime(endKey_1);
+		const CqBound& end1 = keyBounds[endKey];
+		TqFloat end1Time = m_pGrid->KeyTime(endKey);
 
 		TqFloat mix = (time - end0Time) / (end1Time - end0Time);
 		CqBound mid(end0);
@@ -1741,8 +1903,7 @@ void CqMicroPolygonMotion::BuildBoundList(TqUint timeRanges)
 		while(startKey < endKey_1)
 		{
 			startKey++;
-			CqBound B(m_Keys[startKey]->GetBound());
-			bound.Encapsulate(&B);
+			bound.Encapsulate(&keyBounds[startKey]);
 		}
 
 		m_BoundList.Set( i, bound, time - dt );
@@ -1771,36 +1932,44 @@ bool CqMicroPolygonMotion::Sample( CqHitTestCache& hitTestCache, SqSampleData co
 	CqVector3D points[4];
 
 	// Calculate the position in time of the MP.
+	TqInt numKeys = m_pGrid->cKeys();
 	TqInt iIndex = 0;
 	TqFloat Fraction = 0.0f;
 	bool Exact = true;
 
-	if ( time > m_Times.front() )
+	if ( time > m_pGrid->KeyTime( 0 ) )
 	{
-		if ( time >= m_Times.back() )
-			iIndex = m_Times.size() - 1;
+		if ( time >= m_pGrid->KeyTime( numKeys - 1 ) )
+			iIndex = numKeys - 1;
 		else
 		{
 			// Find the appropriate time span.
 			iIndex = 0;
-			while ( time >= m_Times[ iIndex + 1 ] )
+			while ( time >= m_pGrid->KeyTime( iIndex + 1 ) )
 				iIndex += 1;
-			Fraction = ( time - m_Times[ iIndex ] ) / ( m_Times[ iIndex + 1 ] - m_Times[ iIndex ] );
-			Exact = ( m_Times[ iIndex ] == time );
+			Fraction = ( time - m_pGrid->KeyTime( iIndex ) ) / ( m_pGrid->KeyTime( iIndex + 1 ) - m_pGrid->KeyTime( iIndex ) );
+			Exact = ( m_pGrid->KeyTime( iIndex ) == time );
 		}
 	}
 
 	// Interpolate the bounding box along the motion segment to get the
 	// bounding box at the appropriate sample time.
+	CqVector3D points1[4];
+	CqVector3D points2[4];
+	KeyVertices( iIndex, points1 );
 	CqBound tightBound;
 	if(Exact)
 	{
-		tightBound = m_Keys[iIndex]->GetBound();
+		tightBound = CqBound( min( min( points1[0], points1[1] ), min( points1[2], points1[3] ) ),
+							  max( max( points1[0], points1[1] ), max( points1[2], points1[3] ) ) );
 	}
 	else
 	{
-		const CqBound& bound1 = m_Keys[iIndex]->GetBound();
-		const CqBound& bound2 = m_Keys[iIndex+1]->GetBound();
+		KeyVertices( iIndex + 1, points2 );
+		const CqBound bound1( min( min( points1[0], points1[1] ), min( points1[2], points1[3] ) ),
+							  max( max( points1[0], points1[1] ), max( points1[2], points1[3] ) ) );
+		const CqBound bound2( min( min( points2[0], points2[1] ), min( points2[2], points2[3] ) ),
+							  max( max( points2[0], points2[1] ), max( points2[2], points2[3] ) ) );
 		tightBound = CqBound(
 			(1-Fraction)*bound1.vecMin() + Fraction*bound2.vecMin(),
 			(1-Fraction)*bound1.vecMax() + Fraction*bound2.vecMax()
@@ -1838,21 +2007,18 @@ bool CqMicroPolygonMotion::Sample( CqHitTestCache& hitTestCache, SqSampleData co
 	// Interpolate the polygon vertices along the motion segment.
 	if ( Exact )
 	{
-		CqMovingMicroPolygonKey * pMP1 = m_Keys[ iIndex ];
-		points[0] = pMP1->m_Point0;
-		points[1] = pMP1->m_Point1;
-		points[2] = pMP1->m_Point2;
-		points[3] = pMP1->m_Point3;
+		points[0] = points1[0];
+		points[1] = points1[1];
+		points[2] = points1[2];
+		points[3] = points1[3];
 	}
 	else
 	{
 		TqFloat F1 = 1.0f - Fraction;
-		CqMovingMicroPolygonKey* pMP1 = m_Keys[ iIndex ];
-		CqMovingMicroPolygonKey* pMP2 = m_Keys[ iIndex + 1 ];
-		points[0] = ( F1 * pMP1->m_Point0 ) + ( Fraction * pMP2->m_Point0 );
-		points[1] = ( F1 * pMP1->m_Point1 ) + ( Fraction * pMP2->m_Point1 );
-		points[2] = ( F1 * pMP1->m_Point2 ) + ( Fraction * pMP2->m_Point2 );
-		points[3] = ( F1 * pMP1->m_Point3 ) + ( Fraction * pMP2->m_Point3 );
+		points[0] = ( F1 * points1[0] ) + ( Fraction * points2[0] );
+		points[1] = ( F1 * points1[1] ) + ( Fraction * points2[1] );
+		points[2] = ( F1 * points1[2] ) + ( Fraction * points2[2] );
+		points[3] = ( F1 * points1[3] ) + ( Fraction * points2[3] );
 	}
 
 	if(UsingDof)
@@ -1941,51 +2107,78 @@ void CqMicroPolygonMotion::CacheHitTestValues(CqHitTestCache& cache,
 }
 
 //---------------------------------------------------------------------
-/** Store the vectors of the micropolygon at the specified shutter time.
- * \param vA 3D Vector.
- * \param vB 3D Vector.
- * \param vC 3D Vector.
- * \param vD 3D Vector.
- * \param time Float shutter time that this MPG represents.
+/** Add a point to the batch, expanding the bound to contain it.
  */
 
-void CqMicroPolygonMotion::AppendKey( const CqVector3D& vA, const CqVector3D& vB, const CqVector3D& vC, const CqVector3D& vD, TqFloat time )
+void CqMicroPolygonPointsBatch::AppendPoint( const CqVector3D& pos, TqFloat radius, TqInt index )
 {
-	//	assert( time >= m_Times.back() );
-
-	// Add a new planeset at the specified time.
-	CqMovingMicroPolygonKey * pMP = new CqMovingMicroPolygonKey( vA, vB, vC, vD );
-	m_Times.push_back( time );
-	m_Keys.push_back( pMP );
-	if ( m_Times.size() == 1 )
-		m_Bound = pMP->GetBound();
+	m_x.push_back( pos.x() );
+	m_y.push_back( pos.y() );
+	m_z.push_back( pos.z() );
+	m_radius.push_back( radius );
+	m_index.push_back( index );
+
+	m_Bound.Encapsulate( pos - CqVector3D( radius, radius, 0 ) );
+	m_Bound.Encapsulate( pos + CqVector3D( radius, radius, 0 ) );
+}
+
+void CqMicroPolygonPointsBatch::CachePointOutputs( TqInt i, SqMpgSampleInfo& cache ) const
+{
+	const TqInt index = m_index[i];
+	cache.gridIndex = index;
+	if(IqShaderData* Ci = pGrid()->pVar(EnvVars_Ci))
+	{
+		const CqColor* col = 0;
+		Ci->GetColorPtr(col);
+		cache.col[0] = col[index];
+	}
 	else
 	{
-		CqBound B(pMP->GetBound());
-		m_Bound.Encapsulate( &B );
+		cache.col[0] = CqColor(1.0);
 	}
-}
 
+	if(IqShaderData* Oi = pGrid()->pVar(EnvVars_Oi))
+	{
+		const CqColor* opa = 0;
+		Oi->GetColorPtr(opa);
+		cache.opa[0] = opa[index];
+		cache.isOpaque = cache.opa[0] >= CqColor(1.0);
+	}
+	else
+	{
+		cache.opa[0] = CqColor(1.0);
+		cache.isOpaque = true;
+	}
+}
 
 //---------------------------------------------------------------------
-/** Calculate the 2D boundary of this micropolygon,
+/** Batches can't be sampled as a whole.
+ *
+ * The outputs are cached point by point, so a hit on the batch couldn't say
+ * which point's colour to store.  The bucket processor samples each point
+ * in CqBucketProcessor::RenderMPG_Points() instead.
  */
 
-const CqBound& CqMovingMicroPolygonKey::GetBound()
+bool CqMicroPolygonPointsBatch::Sample( CqHitTestCache& hitTestCache, SqSampleData const& sample, TqFloat& D, CqVector2D& uv, TqFloat time, bool UsingDof ) const
 {
-	if(m_BoundReady)
-		return m_Bound;
+	AQSIS_THROW_XQERROR(XqInternal, EqE_Bug,
+		"points batches must be sampled with CqBucketProcessor::RenderMPG_Points()");
+	return false;
+}
 
-	// Calculate the boundary, and store the indexes in the cache.
-	m_Bound.vecMin().x( min( m_Point0.x(), min( m_Point1.x(), min( m_Point2.x(), m_Point3.x() ) ) ) );
-	m_Bound.vecMin().y( min( m_Point0.y(), min( m_Point1.y(), min( m_Point2.y(), m_Point3.y() ) ) ) );
-	m_Bound.vecMin().z( min( m_Point0.z(), min( m_Point1.z(), min( m_Point2.z(), m_Point3.z() ) ) ) );
-	m_Bound.vecMax().x( max( m_Point0.x(), max( m_Point1.x(), max( m_Point2.x(), m_Point3.x() ) ) ) );
-	m_Bound.vecMax().y( max( m_Point0.y(), max( m_Point1.y(), max( m_Point2.y(), m_Point3.y() ) ) ) );
-	m_Bound.vecMax().z( max( m_Point0.z(), max( m_Point1.z(), max( m_Point2.z(), m_Point3.z() ) ) ) );
+/** Batches have no outputs as a whole; see CachePointOutputs().
+ */
+void CqMicroPolygonPointsBatch::CacheOutputInterpCoeffs(SqMpgSampleInfo& cache) const
+{
+	AQSIS_THROW_XQERROR(XqInternal, EqE_Bug,
+		"points batches must cache their outputs with CachePointOutputs()");
+}
 
-	m_BoundReady = true;
-	return ( m_Bound );
+void CqMicroPolygonPointsBatch::InterpolateOutputs(const SqMpgSampleInfo& cache,
+		const CqVector2D& uv, CqColor& outCol, CqColor& outOpac) const
+{
+	outCol = cache.col[0];
+	outOpac = cache.opa[0];
 }
 
 
@@ -93,6 +93,8 @@ struct SqMpgSampleInfo
 	bool isCullable;
 	/// True when the micropolygon is fully opaque
 	bool isOpaque;
+	/// Grid index of the shading point supplying arbitrary output data
+	TqInt gridIndex;
 };
 
 
@@ -104,7 +106,7 @@ struct SqMpgSampleInfo
 class CqMicroPolyGridBase : public CqRefCount
 {
 	public:
-		CqMicroPolyGridBase() : m_fCulled( false ), m_fTriangular( false )
+		CqMicroPolyGridBase() : m_fCulled( false ), m_fTriangular( false ), m_keyPointCount( 0 )
 		{}
 		virtual	~CqMicroPolyGridBase()
 		{}
@@ -195,11 +197,40 @@ class CqMicroPolyGridBase : public CqRefCount
 			return m_CurrentGridInfo;
 		}
 
+		/** Get the number of motion keys of the moving micropolygons made
+		 * from this grid.
+		 */
+		TqInt	cKeys() const
+		{
+			return ( m_keyTimes.size() );
+		}
+		/** Get the shutter time of a motion key.
+		 */
+		TqFloat	KeyTime( TqInt iKey ) const
+		{
+			assert( iKey < cKeys() );
+			return ( m_keyTimes[ iKey ] );
+		}
+		/** Get the hybrid raster space positions of the grid at a motion key.
+		 * Only valid once the grid has been split into moving micropolygons.
+		 */
+		const CqVector3D*	KeyPositions( TqInt iKey ) const
+		{
+			assert( iKey < cKeys() );
+			return ( &m_keyPositions[ iKey * m_keyPointCount ] );
+		}
+
 	protected:
 		bool m_fCulled; ///< Boolean indicating the entire grid is culled.
 		CqTriangleSplitLine	m_TriangleSplitLine;	///< Two endpoints of the line that is used to turn the quad into a triangle at sample time.
 		bool	m_fTriangular;			///< Flag indicating that this grid should be rendered as a triangular grid with a phantom fourth corner.
 
+		/** Positions of the grid at each motion key, shared by all its moving
+		 * micropolygons, one key after another. */
+		std::vector<CqVector3D>	m_keyPositions;
+		std::vector<TqFloat>	m_keyTimes;		///< Shutter time of each motion key.
+		TqInt	m_keyPointCount;			///< Number of positions per motion key.
+
 		/** Cached info about the given grid so it can be
 		 * referenced by multiple mpgs. */
 		SqGridInfo m_CurrentGridInfo;
@@ -243,6 +274,17 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 		 *                 outward by.
 		 */
 		void ExpandGridBoundaries(TqFloat amount);
+		/** \brief Start reading textures which the grid's shaders will probably
+		 * sample.
+		 *
+		 * The textures are guessed from the ones the same shaders sampled on
+		 * previous grids, and the region from the range of the s and t
+		 * shading variables over the grid.  This is only a hint to the
+		 * texture cache, so a bad guess merely wastes some I/O.
+		 *
+		 * \param lUses - variables used by the surface
+		 */
+		void PrefetchTextures(TqInt lUses);
 		/** Set the shading normals flag, indicating this grid has shading (N) normals already specified.
 		 * \param f The new state of the flag.
 		 */
@@ -257,6 +299,13 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 		{
 			m_bGeometricNormals = f;
 		}
+		/** Set the surface derivatives flag, indicating this grid has dPdu and dPdv already specified.
+		 * \param f The new state of the flag.
+		 */
+		void	SetbSurfaceDerivatives( bool f )
+		{
+			m_bSurfaceDerivatives = f;
+		}
 		/** Query whether shading (N) normals have been filled in by the surface at dice time.
 		 */
 		bool bShadingNormals() const
@@ -270,6 +319,13 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 			return ( m_bGeometricNormals );
 		}
 
+		/** Query whether dPdu and dPdv have been filled in by the surface at dice time.
+		 */
+		bool bSurfaceDerivatives() const
+		{
+			return ( m_bSurfaceDerivatives );
+		}
+
 		/** Get a reference to the bitvector representing the culled status of each u-poly in this grid.
 		 */
 		CqBitVector& CulledPolys()
@@ -284,6 +340,21 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 		}
 
 		void	Initialise( TqInt cu, TqInt cv, const boost::shared_ptr<CqSurface>& pSurface );
+		/** Divide the grid into independent strips of rows along v.
+		 *
+		 * Used to dice several curves into one grid; micropolygons are only
+		 * formed between rows within a strip, and derivatives in v are taken
+		 * within each strip.  Must be called after Initialise().
+		 *
+		 * \param vStripRes - number of rows of vertices in each strip.
+		 */
+		void	SetVStripRes( TqInt vStripRes );
+		/** Get the number of rows of vertices in each strip, or 0 if the grid is a single strip.
+		 */
+		TqInt	vStripRes() const
+		{
+			return ( m_vStripRes );
+		}
 
 		void DeleteVariables( bool all );
 
@@ -382,9 +453,11 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 	private:
 		bool	m_bShadingNormals;		///< Flag indicating shading normals have been filled in and don't need to be calculated during shading.
 		bool	m_bGeometricNormals;	///< Flag indicating geometric normals have been filled in and don't need to be calculated during shading.
+		bool	m_bSurfaceDerivatives;	///< Flag indicating dPdu and dPdv have been filled in and don't need to be calculated during shading.
 		boost::shared_ptr<CqSurface> m_pSurface;	///< Pointer to the surface for this grid.
 		boost::shared_ptr<CqCSGTreeNode> m_pCSGNode;	///< Pointer to the CSG tree node this grid belongs to, NULL if not part of a solid.
 		CqBitVector	m_CulledPolys;		///< Bitvector indicating whether the individual micro polygons are culled.
+		TqInt	m_vStripRes;			///< Rows of vertices in each independent strip, 0 if the grid is one strip.
 		std::vector<IqShaderData*>	m_apShaderOutputVariables;	///< Vector of pointers to shader output variables.
 	protected:
 		boost::shared_ptr<IqShaderExecEnv> m_pShaderExecEnv;	///< Pointer to the shader execution environment for this grid.
@@ -396,6 +469,10 @@ class CqMicroPolyGrid : public CqMicroPolyGridBase
 //----------------------------------------------------------------------
 /** \class CqMotionMicroPolyGrid
  * Class which stores info about motion blurred micropolygrids.
+ *
+ * Only the grid at the first key is kept whole, as it's the only one that is
+ * shaded.  The later keys keep nothing but their positions, in one compact
+ * array, see AddKey().
  */
 
 class CqMotionMicroPolyGrid : public CqMicroPolyGridBase, public CqMotionSpec<CqMicroPolyGridBase*>
@@ -417,6 +494,18 @@ class CqMotionMicroPolyGrid : public CqMicroPolyGridBase, public CqMotionSpec<Cq
 		void DeleteVariables( bool all )
 		{}
 
+		/** \brief Add a motion key, in increasing order of time.
+		 *
+		 * The first key is kept as the primary grid.  For later keys the
+		 * positions are copied into the compact key array, the backface test
+		 * is made while the normals are still to hand, and the grid is then
+		 * released.
+		 *
+		 * \param time - shutter time of the key.
+		 * \param pGrid - grid diced at that time.
+		 */
+		void	AddKey( TqFloat time, CqMicroPolyGridBase* pGrid );
+
 		// Redirect acces via IqShaderExecEnv
 		virtual	TqInt	uGridRes() const
 		{
@@ -510,6 +599,7 @@ class CqMotionMicroPolyGrid : public CqMicroPolyGridBase, public CqMotionSpec<Cq
 		}
 
 	private:
+		std::vector<TqInt>	m_keyBFCulled;		///< Per point count of the later keys which are backfacing.
 };
 
 //----------------------------------------------------------------------
@@ -695,6 +785,13 @@ class CqMicroPolygon : boost::noncopyable
 		{
 			return false;
 		}
+		/** Determine whether this is a CqMicroPolygonPointsBatch, which
+		 * is sampled per point rather than with Sample().
+		 */
+		virtual bool IsPointsBatch() const
+		{
+			return false;
+		}
 
 		/** Check if the sample point is within the micropoly.
 		 * \param vecSample 2D sample point.
@@ -818,77 +915,28 @@ class CqMicroPolygon : boost::noncopyable
 
 
 
-//----------------------------------------------------------------------
-/** \class CqMovingMicroPolygonKey
- * Base lass for static micropolygons. Stores point information about the geometry of the micropoly.
- */
-
-class CqMovingMicroPolygonKey
-{
-	public:
-		CqMovingMicroPolygonKey( const CqVector3D& vA, const CqVector3D& vB, const CqVector3D& vC, const CqVector3D& vD )
-			: m_Point0(vA),
-			m_Point1(vB),
-			m_Point2(vC),
-			m_Point3(vD),
-			m_Bound(),
-			m_BoundReady(false)
-		{ }
-
-		/** Overridden operator new to allocate micropolys from a pool.
-		 * \todo Review: Unused parameter size
-		 */
-		void* operator new( size_t size )
-		{
-			return( m_thePool.alloc() );
-		}
-
-		/** Overridden operator delete to allocate micropolys from a pool.
-		 */
-		void operator delete( void* p )
-		{
-			m_thePool.free( reinterpret_cast<CqMovingMicroPolygonKey*>(p) );
-		}
-
-
-	public:
-		const CqBound&	GetBound();
-
-		CqVector3D	m_Point0;
-		CqVector3D	m_Point1;
-		CqVector3D	m_Point2;
-		CqVector3D	m_Point3;
-
-	protected:
-		CqBound m_Bound;
-		bool	m_BoundReady;
-
-		static	CqObjectPool<CqMovingMicroPolygonKey>	m_thePool;
-}
-;
-
-
 //----------------------------------------------------------------------
 /** \class CqMicroPolygonMotion
  * Class which stores a single moving micropolygon.
+ *
+ * The positions at each key are read from the grid, so the
+ * micropolygon itself holds only its index, its bound over the whole shutter
+ * interval and, once a bucket asks for them, the bounds of its time ranges.
  */
 
 class CqMicroPolygonMotion : public CqMicroPolygon
 {
 	public:
 		CqMicroPolygonMotion( CqMicroPolyGridBase* pGrid, TqInt Index ) :
-			CqMicroPolygon( pGrid, Index ), m_BoundReady( false )
+			CqMicroPolygon( pGrid, Index ), m_BoundReady( false ), m_fTrimmed( false )
 		{ }
 		virtual	~CqMicroPolygonMotion()
-		{
-			std::vector<CqMovingMicroPolygonKey*>::iterator	ikey;
-			for ( ikey = m_Keys.begin(); ikey != m_Keys.end(); ikey++ )
-				delete( ( *ikey ) );
-		}
+		{ }
 
 		/** \brief Initialise some micropolygon member data.
 		 *
-		 * Initialise the vertex ordering based on the primary (first) key frame.
+		 * Initialise the vertex ordering based on the primary (first) key
+		 * frame, and the bound over all keys.
 		 */
 		virtual void Initialise();
 
@@ -908,8 +956,6 @@ class CqMicroPolygonMotion : public CqMicroPolygon
 
 
 	public:
-		void	AppendKey( const CqVector3D& vA, const CqVector3D& vB, const CqVector3D& vC, const CqVector3D& vD, TqFloat time );
-
 		// Overrides from CqMicroPolygon
 		virtual	TqInt	cSubBounds( TqUint timeRanges )
 		{
@@ -943,30 +989,123 @@ class CqMicroPolygonMotion : public CqMicroPolygon
 
 		virtual TqInt cKeys() const
 		{
-			return(m_Keys.size());
+			return( m_pGrid->cKeys() );
 		}
 
 		virtual TqFloat Time(TqUint index) const
 		{
-			assert( index < m_Times.size() );
-			return(m_Times[index]);
-		}
-
-		virtual CqMovingMicroPolygonKey* Key(TqUint index) const
-		{
-			assert( index < m_Keys.size() );
-			return(m_Keys[index]);
+			return( m_pGrid->KeyTime( index ) );
 		}
 
 	protected:
+		/** Get the vertices of the micropolygon at a key.
+		 */
+		void	KeyVertices( TqInt iKey, CqVector3D P[4] ) const;
+		/** Calculate the bound of the micropolygon at a key.
+		 */
+		CqBound	KeyBound( TqInt iKey ) const;
+
 		CqBoundList	m_BoundList;			///< List of bounds to get a tighter fit.
 		bool	m_BoundReady;				///< Flag indicating the boundary has been initialised.
-		std::vector<TqFloat> m_Times;
-		std::vector<CqMovingMicroPolygonKey*>	m_Keys;
 		bool	m_fTrimmed;		///< Flag indicating that the MPG spans a trim curve.
 }
 ;
 
+
+//----------------------------------------------------------------------
+/** \class CqMicroPolygonPointsBatch
+ * Class which stores the static points of a grid which touch one bucket.
+ *
+ * Rather than one micropolygon object per point, the raster space position
+ * and radius of each point are held in parallel arrays, with the grid index
+ * of the point for fetching its shaded outputs.  The bucket processor
+ * samples the points directly, see CqBucketProcessor::RenderMPG_Points().
+ */
+
+class CqMicroPolygonPointsBatch : public CqMicroPolygon
+{
+	public:
+		CqMicroPolygonPointsBatch( CqMicroPolyGridBase* pGrid ) : CqMicroPolygon( pGrid, 0 )
+		{ }
+		virtual	~CqMicroPolygonPointsBatch()
+		{ }
+
+		/** Overridden operator new to avoid the pool allocator from CqMicroPolygon.
+		 */
+		void* operator new( size_t size )
+		{
+			return( malloc(size) );
+		}
+
+		/** Overridden operator delete to match the above operator new.
+		 */
+		void operator delete( void* p )
+		{
+			free( p );
+		}
+
+	public:
+		/** Add a point to the batch.
+		 * \param pos Raster space position, with camera space depth.
+		 * \param radius Raster space radius.
+		 * \param index Index of the point in the grid.
+		 */
+		void	AppendPoint( const CqVector3D& pos, TqFloat radius, TqInt index );
+		/** Get the number of points in the batch.
+		 */
+		TqInt	cPoints() const
+		{
+			return ( m_index.size() );
+		}
+		/// Get the array of raster x coordinates.
+		const TqFloat*	x() const
+		{
+			return ( &m_x[0] );
+		}
+		/// Get the array of raster y coordinates.
+		const TqFloat*	y() const
+		{
+			return ( &m_y[0] );
+		}
+		/// Get the array of depths.
+		const TqFloat*	z() const
+		{
+			return ( &m_z[0] );
+		}
+		/// Get the array of raster radii.
+		const TqFloat*	radius() const
+		{
+			return ( &m_radius[0] );
+		}
+		/** Cache the colour and opacity of one point of the batch.
+		 * \param i Index of the point within the batch.
+		 * \param cache Destination for the outputs.
+		 */
+		void	CachePointOutputs( TqInt i, SqMpgSampleInfo& cache ) const;
+
+		// Overrides from CqMicroPolygon
+		virtual bool IsPointsBatch() const
+		{
+			return true;
+		}
+		// Sample() and CacheOutputInterpCoeffs() can't pick a point, so
+		// they throw; batches are only sampled point by point.
+		virtual	bool	Sample( CqHitTestCache& hitTestCache, SqSampleData const& sample, TqFloat& D, CqVector2D& uv, TqFloat time, bool UsingDof = false ) const;
+		virtual void CacheHitTestValues(CqHitTestCache& cache, bool usingDof) const
+		{ }
+		virtual void CacheOutputInterpCoeffs(SqMpgSampleInfo& cache) const;
+		virtual void InterpolateOutputs(const SqMpgSampleInfo& cache,
+				const CqVector2D& uv, CqColor& outCol, CqColor& outOpac) const;
+
+	private:
+		std::vector<TqFloat>	m_x;		///< Raster x coordinates of the points.
+		std::vector<TqFloat>	m_y;		///< Raster y coordinates of the points.
+		std::vector<TqFloat>	m_z;		///< Camera space depths of the points.
+		std::vector<TqFloat>	m_radius;	///< Raster radii of the points.
+		std::vector<TqInt>	m_index;	///< Grid indices of the points.
+}
+;
+
 //==============================================================================
 // Implementation details
 //==============================================================================
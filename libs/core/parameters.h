@@ -211,6 +211,19 @@ class CqParameterTyped : public CqParameter
 			*pValue( idxTarget ) = *pFromTyped->pValue( idxSource );
 		}
 
+		/** Take over a flat array of values by swapping storage, rather than copying.
+		 *
+		 * \param values - Count() values for each element.  On success this
+		 * receives the previous storage of the parameter.
+		 * \param size - number of elements.
+		 * \return false if the values can't be adopted, in which case neither
+		 * the parameter nor values is changed.
+		 */
+		virtual	bool	AdoptValues( std::vector<T>& values, TqInt size )
+		{
+			return ( false );
+		}
+
 	protected:
 };
 
@@ -269,6 +282,13 @@ class CqParameterTypedVarying : public CqParameterTyped<T, SLT>
 		{
 			m_aValues.clear();
 		}
+		virtual	bool	AdoptValues( std::vector<T>& values, TqInt size )
+		{
+			if ( this->m_Count != 1 || static_cast<TqInt>( values.size() ) != size )
+				return ( false );
+			m_aValues.swap( values );
+			return ( true );
+		}
 		virtual void	Subdivide( CqParameter* pResult1, CqParameter* pResult2, bool u, IqSurface* pSurface = 0 )
 		{
 			assert( pResult1->Type() == this->Type() && pResult1->Type() == this->Type() &&
@@ -840,6 +860,14 @@ class CqParameterTypedVaryingArray : public CqParameterTyped<T, SLT>
 		{
 			m_aValues.clear();
 		}
+		virtual	bool	AdoptValues( std::vector<T>& values, TqInt size )
+		{
+			if ( static_cast<TqInt>( values.size() ) != size*this->m_Count )
+				return ( false );
+			m_aValues.swap( values );
+			m_size = size;
+			return ( true );
+		}
 		virtual void	Subdivide( CqParameter* pResult1, CqParameter* pResult2, bool u, IqSurface* pSurface = 0 )
 		{
 			assert( pResult1->Type() == this->Type() && pResult1->Type() == this->Type() &&
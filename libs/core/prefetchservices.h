@@ -0,0 +1,164 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Declares the services used to parse RIB away from the render thread.
+ */
+
+#ifndef PREFETCHSERVICES_H_INCLUDED
+#define PREFETCHSERVICES_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/riutil/errorhandler.h>
+#include <aqsis/riutil/ribparser.h>
+#include <aqsis/riutil/ricxxutil.h>
+#include <aqsis/riutil/risyms.h>
+#include <aqsis/riutil/tokendictionary.h>
+
+namespace Aqsis {
+
+/** \brief Error handler noting whether anything went wrong during a parse.
+ *
+ * Messages from the parsing threads are dropped; RIB which produces any is
+ * read again on the render thread so that they're reported in the usual way.
+ */
+class CqPrefetchErrorHandler : public Ri::ErrorHandler
+{
+	public:
+		CqPrefetchErrorHandler()
+			: ErrorHandler(Warning),
+			m_failed(false)
+		{}
+		bool failed() const
+		{
+			return m_failed;
+		}
+	protected:
+		virtual void dispatch(int /*code*/, const std::string& /*message*/)
+		{
+			m_failed = true;
+		}
+	private:
+		bool m_failed;
+};
+
+/** \brief Sink for the calls of RIB being parsed away from the render thread.
+ *
+ * The only calls which matter while parsing are declarations, which change
+ * the types of later parameters.
+ */
+class CqPrefetchContext : public StubRenderer
+{
+	public:
+		CqPrefetchContext( const TokenDict& tokenDict )
+			: m_tokenDict( tokenDict )
+		{}
+		virtual RtVoid Declare( RtConstString name, RtConstString declaration )
+		{
+			m_tokenDict.declare( name, declaration );
+		}
+		const TokenDict& tokenDict() const
+		{
+			return m_tokenDict;
+		}
+	private:
+		TokenDict m_tokenDict;
+};
+
+/** \brief Services for parsing RIB away from the render thread.
+ */
+class CqPrefetchServices : public Ri::RendererServices
+{
+	public:
+		CqPrefetchServices( const TokenDict& tokenDict )
+			: m_context( tokenDict ),
+			m_errorHandler(),
+			m_parser()
+		{}
+
+		bool failed() const
+		{
+			return m_errorHandler.failed();
+		}
+
+		virtual Ri::ErrorHandler& errorHandler()
+		{
+			return m_errorHandler;
+		}
+		virtual RtFilterFunc getFilterFunc( RtConstToken name ) const
+		{
+			return getFilterFuncByName( name );
+		}
+		virtual RtConstBasis* getBasis( RtConstToken name ) const
+		{
+			return getBasisByName( name );
+		}
+		virtual RtErrorFunc getErrorFunc( RtConstToken name ) const
+		{
+			return getErrorFuncByName( name );
+		}
+		virtual RtProcSubdivFunc getProcSubdivFunc( RtConstToken name ) const
+		{
+			return getProcSubdivFuncByName( name );
+		}
+		virtual Ri::TypeSpec getDeclaration( RtConstToken token,
+		                                     const char** nameBegin = 0,
+		                                     const char** nameEnd = 0 ) const
+		{
+			return m_context.tokenDict().lookup( token, nameBegin, nameEnd );
+		}
+		virtual Ri::Renderer& firstFilter()
+		{
+			return m_context;
+		}
+		virtual void addFilter( const char* /*name*/,
+		                        const Ri::ParamList& /*filterParams*/ )
+		{}
+		virtual void addFilter( Ri::Filter& /*filter*/ )
+		{}
+		virtual void parseRib( std::istream& ribStream, const char* name,
+		                       Ri::Renderer& context )
+		{
+			if( !m_parser )
+				m_parser.reset( RibParser::create( *this ) );
+			m_parser->parseStream( ribStream, name, context );
+		}
+		virtual bool parseRibFile( const char* fileName, const char* name,
+		                           Ri::Renderer& context )
+		{
+			if( !m_parser )
+				m_parser.reset( RibParser::create( *this ) );
+			return m_parser->parseFile( fileName, name, context );
+		}
+		using Ri::RendererServices::parseRib;
+		using Ri::RendererServices::parseRibFile;
+
+	private:
+		CqPrefetchContext m_context;
+		CqPrefetchErrorHandler m_errorHandler;
+		boost::shared_ptr<RibParser> m_parser;
+};
+
+} // namespace Aqsis
+
+#endif // PREFETCHSERVICES_H_INCLUDED
@@ -26,11 +26,14 @@
 #include	<aqsis/aqsis.h>
 
 #include	<cstring> // for memcmp, strcmp
+#include	<sstream>
 #include	<time.h>
 #include	<boost/bind.hpp>
 #include	<boost/filesystem/fstream.hpp>
+#include	<boost/functional/hash.hpp>
 
 #include	"imagebuffer.h"
+#include	"instance.h"
 #include	"lights.h"
 #include	"renderer.h"
 #include	"shaders.h"
@@ -66,6 +69,20 @@ static const TqUlong cuhash = CqString::hash( "current" ); //< == "current"
 static CqMatrix oldkey[2];  //< to eliminate Inverse(), Transpose() matrix ops.
 static CqMatrix oldresult[2];
 
+/// Read a whole compiled shader file into a string.
+static bool readShaderFile( const boost::filesystem::path& path, std::string& contents )
+{
+	if( path.empty() )
+		return false;
+	boost::filesystem::ifstream file( path, std::ios::binary );
+	if( !file )
+		return false;
+	std::ostringstream buffer;
+	buffer << file.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
 //---------------------------------------------------------------------
 /** Default constructor for the main renderer class. Initialises current state.
  */
@@ -80,13 +97,17 @@ CqRenderer::CqRenderer()
 	m_pDDManager(CreateDisplayDriverManager()),
 	m_Mode(RenderMode_Image),
 	m_Shaders(),
+	m_ShaderSources(),
 	m_InstancedShaders(),
 	m_lights(),
 	m_textureCache(),
+	m_archivePrefetcher(),
+	m_runProgramPool(),
 	m_fSaveGPrims(false),
 	m_pTransCamera(new CqTransform()),
 	m_pTransDefObj(new CqTransform()),
 	m_fWorldBegin(false),
+	m_fResidentCaches(false),
 	m_tokenDict(),
 	m_DofMultiplier(0),
 	m_OneOverFocalDistance(FLT_MAX),
@@ -101,6 +122,7 @@ CqRenderer::CqRenderer()
 	m_pRaytracer(CreateRaytracer()),
 	m_clippingVolume(),
 	m_aWorld(),
+	m_pObjectPrototype(),
 	m_cropWindowXMin(0),
 	m_cropWindowXMax(0),
 	m_cropWindowYMin(0),
@@ -316,6 +338,7 @@ boost::shared_ptr<CqModeBlock>	CqRenderer::BeginObjectModeBlock()
 		if ( pconNew )
 		{
 			m_pconCurrent = pconNew;
+			m_pObjectPrototype.reset( new CqObjectPrototype( pconNew->pattrCurrent(), pconNew->ptransCurrent() ) );
 			return ( pconNew );
 		}
 		else
@@ -467,6 +490,7 @@ void	CqRenderer::EndObjectModeBlock()
 	{
 		m_pconCurrent->EndObjectModeBlock();
 		m_pconCurrent = m_pconCurrent->pconParent();
+		m_pObjectPrototype.reset();
 	}
 }
 
@@ -817,7 +841,58 @@ void CqRenderer::Quit()
 void CqRenderer::Initialise()
 {
 	FlushShaders();
+	ResetSceneState();
+}
+
+
+//----------------------------------------------------------------------
+/** Return the renderer to its initial state between jobs rendered by the same
+ * context.  Options, declarations, lights and displays from the last job are
+ * dropped.  Shaders loaded from file are kept, to be checked against their
+ * files when first used again; the texture cache checks its own files.
+ */
+
+void CqRenderer::Reset()
+{
+	m_pconCurrent.reset();
+	m_Mode = RenderMode_Image;
+	m_InstancedShaders.clear();
+	TqShaderMap::iterator i = m_Shaders.begin();
+	while( i != m_Shaders.end() )
+	{
+		// Built in shaders and failed loads are made again on demand.
+		TqShaderSourceMap::iterator source = m_ShaderSources.find( i->first );
+		if( source == m_ShaderSources.end() )
+			m_Shaders.erase( i++ );
+		else
+		{
+			source->second.checked = false;
+			++i;
+		}
+	}
+	m_lights.clear();
+	ClearDisplayRequests();
+	m_pTransCamera = CqTransformPtr( new CqTransform() );
+	m_pTransDefObj = CqTransformPtr( new CqTransform() );
+	m_preProjectionTransform.reset();
+	m_fWorldBegin = false;
+	m_tokenDict = TokenDict();
+	m_FrameNo = 0;
+	m_pErrorHandler = &RiErrorPrint;
+	m_pProgressHandler = 0;
+	m_aWorld.clear();
+	m_pObjectPrototype.reset();
+	ResetSceneState();
+}
 
+
+//----------------------------------------------------------------------
+/** Drop the coordinate systems, output variables and clipping planes
+ * declared by the scene.
+ */
+
+void CqRenderer::ResetSceneState()
+{
 	// Truncate the array of named coordinate systems to just the standard ones.
 	m_aCoordSystems.resize( CoordSystem_Last );
 
@@ -1145,6 +1220,35 @@ boost::shared_ptr<IqShader> CqRenderer::getDefaultSurfaceShader()
 
 }
 
+//---------------------------------------------------------------------
+/** Check whether a shader loaded during an earlier job has changed on disk,
+ * removing it if so.  Each shader is only checked on its first use in a job:
+ * it's stale if the shader searchpath now finds a different file, or the
+ * contents of the file have changed.
+ */
+bool CqRenderer::ShaderTemplateStale( const CqShaderKey& key, const char* strName )
+{
+	TqShaderSourceMap::iterator source = m_ShaderSources.find(key);
+	if(source == m_ShaderSources.end() || source->second.checked)
+		return false;
+	source->second.checked = true;
+	std::string fileName(strName);
+	fileName += RI_SHADER_EXTENSION;
+	boost::filesystem::path shaderPath
+		= poptCurrent()->findRiFileNothrow(fileName, "shader");
+	std::string shaderSource;
+	if(shaderPath.string() == source->second.path
+		&& readShaderFile(shaderPath, shaderSource)
+		&& boost::hash_range(shaderSource.begin(), shaderSource.end())
+			== source->second.hash)
+		return false;
+	Aqsis::log() << info << "Shader \"" << strName
+		<< "\" has changed, reloading" << std::endl;
+	m_Shaders.erase(key);
+	m_ShaderSources.erase(source);
+	return true;
+}
+
 //---------------------------------------------------------------------
 /** Find a shader of the specified type with the specified name.
  * If not found, try to load one.
@@ -1158,7 +1262,7 @@ boost::shared_ptr<IqShader> CqRenderer::CreateShader(
 	// first, look for the shader of the appropriate type and name in the
 	//  map of shader "templates"
 	TqShaderMap::const_iterator shadLocation = m_Shaders.find(key);
-	if(shadLocation != m_Shaders.end())
+	if(shadLocation != m_Shaders.end() && !ShaderTemplateStale(key, strName))
 	{
 		if(!shadLocation->second)
 			return boost::shared_ptr<IqShader>();
@@ -1176,8 +1280,8 @@ boost::shared_ptr<IqShader> CqRenderer::CreateShader(
 	fileName += RI_SHADER_EXTENSION;
 	boost::filesystem::path shaderPath
 		= poptCurrent()->findRiFileNothrow(fileName, "shader");
-	boost::filesystem::ifstream shaderFile(shaderPath);
-	if(shaderFile)
+	std::string shaderSource;
+	if(readShaderFile(shaderPath, shaderSource))
 	{
 		Aqsis::log() << info << "Loading shader \"" << strName
 			<< "\" from file \"" << native(shaderPath)
@@ -1196,6 +1300,7 @@ boost::shared_ptr<IqShader> CqRenderer::CreateShader(
 		boost::shared_ptr<IqShader> pShader;
 		try
 		{
+			std::istringstream shaderFile(shaderSource);
 			pShader = createShaderVM(this, shaderFile, dsoPath);
 		}
 		catch(XqBadShader& e)
@@ -1211,6 +1316,10 @@ boost::shared_ptr<IqShader> CqRenderer::CreateShader(
 		pShader->SetstrName( strName );
 		// add the shader to the map as a template and return its clone
 		m_Shaders[key] = pShader;
+		SqShaderSource& source = m_ShaderSources[key];
+		source.path = shaderPath.string();
+		source.hash = boost::hash_range(shaderSource.begin(), shaderSource.end());
+		source.checked = true;
 		boost::shared_ptr<IqShader> newShader(pShader->Clone());
 		newShader->SetType( type );
 		m_InstancedShaders.push_back(newShader);
@@ -1258,6 +1367,12 @@ boost::shared_ptr<IqShader> CqRenderer::CreateShader(
 
 void CqRenderer::StorePrimitive( const boost::shared_ptr<CqSurface>& pSurface )
 {
+	// Primitives inside an object definition are retained for instancing.
+	if( m_pObjectPrototype )
+	{
+		m_pObjectPrototype->AddPrimitive( pSurface );
+		return;
+	}
 	// If we are not in a mode that allows 'extra' passes, then fasttrack the primitive directly into the pipeline.
 	const TqInt* pMultipass = GetIntegerOption("Render", "multipass");
 	if(pMultipass && pMultipass[0])
@@ -47,6 +47,8 @@
 #include	"iraytrace.h"
 #include	<aqsis/tex/filtering/itexturecache.h>
 #include	"lights.h"
+#include	"archiveprefetcher.h"
+#include	"runprogrampool.h"
 
 #include	"clippingvolume.h"
 
@@ -54,6 +56,7 @@ namespace Aqsis {
 
 class CqImageBuffer;
 class CqModeBlock;
+class CqObjectPrototype;
 
 struct SqCoordSys
 {
@@ -134,6 +137,14 @@ class CqRenderer : public IqRenderer
 		virtual	void	EndMotionModeBlock();
 		virtual	void	EndResourceModeBlock();
 
+		/** Get the retained object currently being defined.
+		 * \return The prototype receiving new primitives, or null outside RiObjectBegin/RiObjectEnd.
+		 */
+		const boost::shared_ptr<CqObjectPrototype>& pObjectPrototype() const
+		{
+			return ( m_pObjectPrototype );
+		}
+
 		virtual	const IqOptionsPtr	poptCurrent() const;
 		virtual	IqOptionsPtr	poptWriteCurrent();
 		virtual IqOptionsPtr	pushOptions();
@@ -203,6 +214,18 @@ class CqRenderer : public IqRenderer
 		}
 
 		virtual	IqTextureCache& textureCache();
+		/** Get the prefetcher used to parse procedural archives ahead of use.
+		 */
+		CqArchivePrefetcher&	archivePrefetcher()
+		{
+			return ( m_archivePrefetcher );
+		}
+		/** Get the pool of processes used to expand RunProgram procedurals.
+		 */
+		CqRunProgramPool&	runProgramPool()
+		{
+			return ( m_runProgramPool );
+		}
 		virtual	IqTextureMapOld* GetEnvironmentMap( const CqString& strFileName );
 		virtual	IqTextureMapOld* GetOcclusionMap(const CqString& fileName);
 		virtual	IqTextureMapOld* GetLatLongMap( const CqString& strFileName );
@@ -230,6 +253,21 @@ class CqRenderer : public IqRenderer
 
 		// Function which can be overridden by the derived class.
 		virtual	void	Initialise();
+		/** Return the renderer to its initial state between jobs rendered
+		 * by the same context, keeping the resident caches.
+		 */
+		void	Reset();
+		/** Keep shaders and textures loaded between frames and jobs,
+		 * discarding them only when their files change.
+		 */
+		void	SetResidentCaches( bool resident )
+		{
+			m_fResidentCaches = resident;
+		}
+		bool	ResidentCaches() const
+		{
+			return ( m_fResidentCaches );
+		}
 		virtual	void	RenderWorld(bool clone = false);
 		virtual void	RenderAutoShadows();
 
@@ -266,6 +304,7 @@ class CqRenderer : public IqRenderer
 		virtual	void	FlushShaders()
 		{
 			m_Shaders.clear();
+			m_ShaderSources.clear();
 			m_InstancedShaders.clear();
 		}
 
@@ -522,9 +561,19 @@ class CqRenderer : public IqRenderer
 
 	private:
 		const SqOutputDataEntry* FindOutputDataEntry(const char* name);
+		void	ResetSceneState();
+		bool	ShaderTemplateStale( const CqShaderKey& key, const char* strName );
 
 		/// Map type to hold loaded reference shaders.
 		typedef std::map< CqShaderKey, boost::shared_ptr<IqShader> > TqShaderMap;
+		/// File a reference shader was loaded from.
+		struct SqShaderSource
+		{
+			std::string	path;		///< Full path to the compiled shader.
+			std::size_t	hash;		///< Hash of the file contents.
+			bool	checked;		///< Whether the file has been checked this job.
+		};
+		typedef std::map< CqShaderKey, SqShaderSource > TqShaderSourceMap;
 
 		boost::shared_ptr<CqModeBlock>	m_pconCurrent;					///< Pointer to the current context.
 		CqStats	m_Stats;						///< Global statistics.
@@ -537,12 +586,15 @@ class CqRenderer : public IqRenderer
 
 		EqRenderMode	m_Mode;
 		TqShaderMap m_Shaders;
+		TqShaderSourceMap m_ShaderSources;	///< Files of the reference shaders loaded from file.
 		std::vector< boost::shared_ptr<IqShader> >  m_InstancedShaders;
 
 		typedef std::map<std::string, CqLightsourcePtr> TqLightMap;
 		TqLightMap m_lights;
 
 		boost::shared_ptr<IqTextureCache> m_textureCache; ///< Cache for aqsistex texture access.
+		CqArchivePrefetcher	m_archivePrefetcher;	///< Background parsing of procedural archives.
+		CqRunProgramPool	m_runProgramPool;	///< Background expansion of RunProgram procedurals.
 		 
 
 		bool	m_fSaveGPrims;
@@ -550,6 +602,7 @@ class CqRenderer : public IqRenderer
 		CqTransformPtr	m_pTransDefObj;				///< The initial transformation for objects.
 		CqTransformPtr	m_preProjectionTransform;	///< The transformation that was applied prior to projection.
 		bool			m_fWorldBegin;
+		bool			m_fResidentCaches;			///< Keep shaders and textures between jobs.
 		/// Renderman symbol table
 		TokenDict m_tokenDict;
 
@@ -580,6 +633,7 @@ class CqRenderer : public IqRenderer
 		CqClippingVolume	m_clippingVolume;
 
 		std::deque<boost::shared_ptr<CqSurface> >	m_aWorld;
+		boost::shared_ptr<CqObjectPrototype>	m_pObjectPrototype;	///< Retained object being defined.
 
 		// Cached calculated cropwindow coordinates in raster space.
 		TqInt				m_cropWindowXMin;
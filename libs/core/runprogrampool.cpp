@@ -0,0 +1,345 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Implements a pool of child processes for RunProgram procedurals.
+ */
+
+#include "runprogrampool.h"
+
+#include <deque>
+
+#include <boost/tokenizer.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <aqsis/riutil/ribarchivecache.h>
+#include <aqsis/util/popen.h>
+
+#include "prefetchservices.h"
+#include "renderer.h"
+
+namespace Aqsis {
+
+void findRunProgram( const std::string& command, std::string& progName,
+                     std::vector<std::string>& argv )
+{
+	typedef boost::tokenizer<boost::char_separator<char> > TqTokenizer;
+	TqTokenizer tokens(command, boost::char_separator<char>(" \t\n"));
+	for(TqTokenizer::iterator i = tokens.begin(); i != tokens.end(); ++i)
+		argv.push_back(*i);
+	if(argv.empty())
+		AQSIS_THROW_XQERROR(XqValidation, EqE_BadToken, "program name not present");
+	// Attempt to find the program in the procedural path
+	progName = native(QGetRenderContext()->poptCurrent()
+		->findRiFileNothrow(argv[0], "procedural"));
+	if(progName.empty())
+	{
+		progName = argv[0];
+		Aqsis::log() << info
+			<< "RiProcRunProgram: Could not find \"" << progName
+			<< "\" in \"procedural\" searchpath, will rely on system path.\n";
+	}
+}
+
+
+//----------------------------------------------------------------------
+/** \brief State for a submitted request.
+ */
+class CqRunProgramPool::CqRequest
+{
+	public:
+		enum EqState
+		{
+			State_Queued,
+			State_Running,
+			State_Done
+		};
+
+		CqRequest( const std::string& args, TqFloat detail,
+		           const TokenDict& tokenDict )
+			: m_args( args ),
+			m_detail( detail ),
+			m_tokenDict( tokenDict ),
+			m_state( State_Queued ),
+			m_response(),
+			m_command( 0 )
+		{}
+
+		/** \brief Send the request to a child and parse its response.
+		 *
+		 * The response is kept only if it parsed cleanly.
+		 *
+		 * \return false if the child can't be used again.
+		 */
+		bool run( std::iostream& pipe, const std::string& name )
+		{
+			try
+			{
+				pipe << m_detail << " " << m_args << "\n" << std::flush;
+				CqPrefetchServices services( m_tokenDict );
+				m_response = ParsedRibArchive::parse( pipe, name.c_str(),
+				                                      services,
+				                                      services.firstFilter() );
+				if( services.failed() )
+					m_response.reset();
+				return true;
+			}
+			catch(...)
+			{
+				// A broken pipe, or an error which may have left the rest of
+				// the response unread.  Either way the child is out of step
+				// with its requests.
+				m_response.reset();
+				return false;
+			}
+		}
+
+		std::string m_args;
+		TqFloat m_detail;
+		TokenDict m_tokenDict;
+		EqState m_state;
+		boost::shared_ptr<ParsedRibArchive> m_response;
+		/// Command serving the request; owned by the pool.
+		CqCommand* m_command;
+};
+
+
+//----------------------------------------------------------------------
+/** \brief The child processes and threads for a single command.
+ */
+class CqRunProgramPool::CqCommand : private boost::noncopyable
+{
+	public:
+		/** \brief Start the children for a command.
+		 *
+		 * Throws XqEnvironment if none of the children could be started.
+		 */
+		CqCommand( const std::string& command, TqInt numProcesses )
+			: m_name( "[" + command + "]" ),
+			m_threads(),
+			m_queue(),
+			m_liveProcesses( 0 ),
+			m_stopping( false )
+		{
+			std::string progName;
+			std::vector<std::string> argv;
+			findRunProgram( command, progName, argv );
+			for(TqInt i = 0; i < numProcesses; ++i)
+			{
+				TqPopenStreamPtr pipe;
+				try
+				{
+					pipe.reset( new TqPopenStream( progName, argv ) );
+				}
+				catch(XqEnvironment&)
+				{
+					if(m_liveProcesses == 0)
+						throw;
+					break;
+				}
+				pipe->exceptions( std::ios::badbit | std::ios::failbit
+				                  | std::ios::eofbit );
+				++m_liveProcesses;
+				m_threads.create_thread( boost::bind( &CqCommand::work, this, pipe ) );
+			}
+		}
+
+		~CqCommand()
+		{
+			cancelQueued();
+			{
+				boost::mutex::scoped_lock lock( m_mutex );
+				m_stopping = true;
+			}
+			m_workAvailable.notify_all();
+			m_threads.join_all();
+		}
+
+		/// Queue a request, returning false if all the children have died.
+		bool submit( const TqRequestPtr& request )
+		{
+			boost::mutex::scoped_lock lock( m_mutex );
+			if(m_liveProcesses == 0)
+				return false;
+			m_queue.push_back( request );
+			m_workAvailable.notify_one();
+			return true;
+		}
+
+		/// Wait for a request to finish, withdrawing it if it hasn't started.
+		void wait( const TqRequestPtr& request )
+		{
+			boost::mutex::scoped_lock lock( m_mutex );
+			if(request->m_state == CqRequest::State_Queued)
+				request->m_state = CqRequest::State_Done;
+			while(request->m_state != CqRequest::State_Done)
+				m_requestDone.wait( lock );
+		}
+
+		/// Withdraw all requests which haven't started.
+		void cancelQueued()
+		{
+			boost::mutex::scoped_lock lock( m_mutex );
+			cancelQueuedLocked();
+		}
+
+	private:
+		typedef boost::shared_ptr<TqPopenStream> TqPopenStreamPtr;
+
+		void cancelQueuedLocked()
+		{
+			std::deque<TqRequestPtr>::iterator i;
+			for(i = m_queue.begin(); i != m_queue.end(); ++i)
+			{
+				if((*i)->m_state == CqRequest::State_Queued)
+					(*i)->m_state = CqRequest::State_Done;
+			}
+			m_queue.clear();
+		}
+
+		/// Main loop for the thread serving a single child.
+		void work( TqPopenStreamPtr pipe )
+		{
+			while(true)
+			{
+				TqRequestPtr request;
+				{
+					boost::mutex::scoped_lock lock( m_mutex );
+					while(m_queue.empty() && !m_stopping)
+						m_workAvailable.wait( lock );
+					if(m_queue.empty())
+						return;
+					request = m_queue.front();
+					m_queue.pop_front();
+					// Skip requests which were withdrawn.
+					if(request->m_state != CqRequest::State_Queued)
+						continue;
+					request->m_state = CqRequest::State_Running;
+				}
+				bool alive = request->run( *pipe, m_name );
+				{
+					boost::mutex::scoped_lock lock( m_mutex );
+					request->m_state = CqRequest::State_Done;
+					// Nobody is left to serve the queue once the last child
+					// is gone; its requests fall back to the render thread.
+					if(!alive && --m_liveProcesses == 0)
+						cancelQueuedLocked();
+				}
+				m_requestDone.notify_all();
+				if(!alive)
+					return;
+			}
+		}
+
+		/// Name of the command, for parse errors.
+		std::string m_name;
+		boost::thread_group m_threads;
+		std::deque<TqRequestPtr> m_queue;
+		/// Number of children still accepting requests.
+		TqInt m_liveProcesses;
+		/// Set while the threads are being asked to exit.
+		bool m_stopping;
+		/// Protects all the state above, along with request states.
+		boost::mutex m_mutex;
+		boost::condition m_workAvailable;
+		boost::condition m_requestDone;
+};
+
+
+//----------------------------------------------------------------------
+CqRunProgramPool::CqRunProgramPool()
+	: m_commands(),
+	m_replayed(),
+	m_numProcesses( 0 )
+{}
+
+
+CqRunProgramPool::~CqRunProgramPool()
+{
+	clear();
+}
+
+
+void CqRunProgramPool::setNumProcesses( TqInt numProcesses )
+{
+	m_numProcesses = numProcesses;
+}
+
+
+bool CqRunProgramPool::enabled() const
+{
+	return m_numProcesses > 0;
+}
+
+
+CqRunProgramPool::TqRequestPtr CqRunProgramPool::submit(
+		const std::string& command, const std::string& args,
+		TqFloat detail, const TokenDict& tokenDict )
+{
+	if( !enabled() )
+		return TqRequestPtr();
+	TqCommandMap::iterator i = m_commands.find( command );
+	if( i == m_commands.end() )
+	{
+		boost::shared_ptr<CqCommand> newCommand;
+		try
+		{
+			newCommand.reset( new CqCommand( command, m_numProcesses ) );
+		}
+		catch(XqException&)
+		{
+			// Leave the error to be reported by the procedural itself.
+		}
+		i = m_commands.insert( std::make_pair( command, newCommand ) ).first;
+	}
+	if( !i->second )
+		return TqRequestPtr();
+	TqRequestPtr request( new CqRequest( args, detail, tokenDict ) );
+	request->m_command = i->second.get();
+	if( !i->second->submit( request ) )
+		return TqRequestPtr();
+	return request;
+}
+
+
+boost::shared_ptr<ParsedRibArchive> CqRunProgramPool::wait( const TqRequestPtr& request )
+{
+	request->m_command->wait( request );
+	if( request->m_response )
+		m_replayed.push_back( request->m_response );
+	return request->m_response;
+}
+
+
+void CqRunProgramPool::clear()
+{
+	TqCommandMap::iterator i;
+	for( i = m_commands.begin(); i != m_commands.end(); ++i )
+	{
+		if( i->second )
+			i->second->cancelQueued();
+	}
+	m_replayed.clear();
+}
+
+} // namespace Aqsis
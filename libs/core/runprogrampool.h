@@ -0,0 +1,138 @@
+// Aqsis
+// Copyright (C) 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+/** \file
+ *
+ * \brief Declares a pool of child processes for RunProgram procedurals.
+ */
+
+#ifndef RUNPROGRAMPOOL_H_INCLUDED
+#define RUNPROGRAMPOOL_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Aqsis {
+
+class ParsedRibArchive;
+class TokenDict;
+
+/** \brief Find the program and arguments for a RunProgram command line.
+ *
+ * The command line is split into arguments at whitespace, with the first
+ * argument naming the program.  No escaping mechanism for whitespace is
+ * supported.  The program is searched for in the procedural searchpath, with
+ * the system path as a fallback.
+ *
+ * Throws XqValidation if the command line is empty.
+ *
+ * \param command - command line of the RunProgram procedural.
+ * \param progName - returns the path to the program.
+ * \param argv - returns the arguments, starting with the program name.
+ */
+void findRunProgram( const std::string& command, std::string& progName,
+                     std::vector<std::string>& argv );
+
+//----------------------------------------------------------------------
+/** \brief Asynchronous expansion of RunProgram procedurals.
+ *
+ * For each distinct command the pool starts a number of child processes,
+ * each served by a thread.  Requests are queued per command and taken by the
+ * first idle child; the thread writes the request, then parses the RIB
+ * response (ascii or binary) into memory.  When the procedural is split, its
+ * response only has to be replayed into the renderer.
+ *
+ * A child's requests aren't overlapped: the end of a binary response can't be
+ * found without parsing it, so the next request is only written once the
+ * previous response has been read.  Concurrency comes from running several
+ * children for each command instead.
+ */
+class CqRunProgramPool : private boost::noncopyable
+{
+	public:
+		/// Opaque state for a submitted request.
+		class CqRequest;
+		typedef boost::shared_ptr<CqRequest> TqRequestPtr;
+		/// Child processes and threads for a single command.
+		class CqCommand;
+
+		CqRunProgramPool();
+		~CqRunProgramPool();
+
+		/** \brief Set the number of child processes started for each command.
+		 *
+		 * Commands which are already running keep their processes.
+		 *
+		 * \param numProcesses - number of processes; zero disables the pool.
+		 */
+		void	setNumProcesses( TqInt numProcesses );
+		/// Determine whether requests can be submitted to the pool.
+		bool	enabled() const;
+
+		/** \brief Queue a request for one of the children running a command.
+		 *
+		 * The children are started the first time a command is seen.
+		 *
+		 * \param command - command line of the RunProgram procedural.
+		 * \param args - argument string of the procedural.
+		 * \param detail - level of detail passed to the program.
+		 * \param tokenDict - declarations in effect for the response; a copy
+		 * is taken for the parsing thread.
+		 * \return The request, or null if the pool is disabled or the
+		 * children for the command couldn't be started.
+		 */
+		TqRequestPtr	submit( const std::string& command, const std::string& args,
+		                        TqFloat detail, const TokenDict& tokenDict );
+		/** \brief Wait for the response to a request.
+		 *
+		 * A request which is still queued is withdrawn rather than waited
+		 * for.  The response is kept alive until clear(), since procedurals
+		 * replayed from it share its data.
+		 *
+		 * \return The parsed response, or null if the request hadn't
+		 * started, the child process failed or the response didn't parse
+		 * cleanly.  In that case the caller should run the request itself,
+		 * which also reports any errors.
+		 */
+		boost::shared_ptr<ParsedRibArchive>	wait( const TqRequestPtr& request );
+		/** \brief Discard all requests which haven't been started, and
+		 * release the responses handed out by wait().
+		 */
+		void	clear();
+
+	private:
+		typedef std::map<std::string, boost::shared_ptr<CqCommand> > TqCommandMap;
+
+		/// Running commands, null for those which failed to start.
+		TqCommandMap	m_commands;
+		/// Responses which have been replayed since the last clear().
+		std::vector<boost::shared_ptr<ParsedRibArchive> >	m_replayed;
+		/// Number of processes to start for each new command.
+		TqInt	m_numProcesses;
+};
+
+} // namespace Aqsis
+
+#endif // RUNPROGRAMPOOL_H_INCLUDED
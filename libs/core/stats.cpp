@@ -23,16 +23,23 @@
 
 #include "stats.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <cstring>
+#include <fstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "attributes.h"
 #include "imagebuffer.h"
 #include "renderer.h"
 #include "transform.h"
 #include <aqsis/math/math.h>
+#include <aqsis/tex/filtering/itexturecache.h>
+#include <aqsis/tex/filtering/texturecachestats.h>
+#include <aqsis/util/logging.h>
 
 namespace Aqsis {
 
@@ -69,8 +76,83 @@ void gStats_setF( TqInt index, TqFloat value )
 {
 	CqStats::setF( index, value );
 }
+void gStats_IncGPrimClassI( TqInt gprimClass, TqInt index )
+{
+	CqStats::IncGPrimClassI( gprimClass, index );
+}
+namespace {
+
+typedef std::pair<double, RibParserStats::RequestMap::const_iterator> TqTimedRequest;
+
+bool timeGreater( const TqTimedRequest& a, const TqTimedRequest& b )
+{
+	return a.first > b.first;
+}
+
+/** Print the RIB parser counters, with the request types which took the most
+ * time, if they were timed.
+ */
+void printParseStats( std::ostream& MSG, const RibParserStats& stats )
+{
+	MSG << "Parsing:\n\t" << stats.requests << " requests\n\t"
+		<< std::setprecision( 2 ) << stats.arrayBytes / ( 1024.0 * 1024.0 )
+		<< " MB of array data\n";
+	if ( !stats.requestStats.empty() )
+	{
+		std::vector<TqTimedRequest> requests;
+		for ( RibParserStats::RequestMap::const_iterator i = stats.requestStats.begin();
+		      i != stats.requestStats.end(); ++i )
+			requests.push_back( TqTimedRequest( i->second.time, i ) );
+		std::sort( requests.begin(), requests.end(), timeGreater );
+		const TqInt maxRequests = 10;
+		MSG << "\n\tSlowest requests (including time spent handling them):\n";
+		for ( TqInt i = 0; i < std::min<TqInt>( maxRequests, requests.size() ); ++i )
+		{
+			const RibParserStats::Request& req = requests[ i ].second->second;
+			MSG << "\t\t" << std::setw( 24 ) << std::setiosflags( std::ios::left )
+				<< requests[ i ].second->first << std::resetiosflags( std::ios::left )
+				<< std::setw( 10 ) << req.count << " requests "
+				<< std::setw( 10 ) << std::setprecision( 3 ) << req.time << "s\n";
+		}
+	}
+	MSG << std::setprecision( 6 ) << std::endl;
+}
+
+/** Print the tessellation counters for each class of gprim which was split
+ * or diced, to show which geometry types spend their time splitting.
+ */
+void printGPrimClassStats( std::ostream& MSG )
+{
+	static const char* const classNames[ CqStats::GPrimClass_Last ] =
+	{
+		"NURBS", "blobbies", "polygons", "subdivision", "curves",
+		"points", "quadrics", "patches", "other"
+	};
+	MSG << "\tTessellation by gprim type (grid count/size for diced grids):\n"
+		<< "\t+------------+--------+--------+--------+--------+------+------+------+------+------+------+------+------+\n"
+		<< "\t|            | splits | est.spl|  diced | culled |<=  4 |<=  8 |<= 16 |<= 32 |<= 64 |<=128 |<=256 | >256 |\n"
+		<< "\t+------------+--------+--------+--------+--------+------+------+------+------+------+------+------+------+\n";
+	for ( TqInt gprimClass = 0; gprimClass < CqStats::GPrimClass_Last; ++gprimClass )
+	{
+		if ( CqStats::getGPrimClassI( gprimClass, CqStats::GPC_split ) == 0 &&
+		     CqStats::getGPrimClassI( gprimClass, CqStats::GPC_diced ) == 0 )
+			continue;
+		MSG << "\t|" << std::setw( 12 ) << std::setiosflags( std::ios::left )
+			<< classNames[ gprimClass ] << std::resetiosflags( std::ios::left ) << "|";
+		for ( TqInt i = CqStats::GPC_split; i <= CqStats::GPC_grid_culled; ++i )
+			MSG << std::setw( 8 ) << CqStats::getGPrimClassI( gprimClass, i ) << "|";
+		for ( TqInt i = CqStats::GPC_grid_size_4; i <= CqStats::GPC_grid_size_g256; ++i )
+			MSG << std::setw( 6 ) << CqStats::getGPrimClassI( gprimClass, i ) << "|";
+		MSG << "\n";
+	}
+	MSG << "\t+------------+--------+--------+--------+--------+------+------+------+------+------+------+------+------+\n\n";
+}
+
+} // anonymous namespace
+
 TqFloat	 CqStats::m_floatVars[ CqStats::_Last_float ];		///< Float variables
 TqInt	 CqStats::m_intVars[ CqStats::_Last_int ];			///< Int variables
+TqInt	 CqStats::m_gprimClassVars[ CqStats::GPrimClass_Last ][ CqStats::GPC_Last ];	///< Int variables per gprim class
 /**
    Initialise every variable.
  
@@ -89,6 +171,7 @@ void CqStats::Initialise()
 		m_intVars[i] = 0;
 	for (i = _First_float; i < _Last_float; i++)
 		m_floatVars[i] = 0.0f;
+	memset( m_gprimClassVars, '\0', sizeof( m_gprimClassVars ) );
 	//	m_timeTotal = 0;
 	InitialiseFrame();
 }
@@ -129,12 +212,27 @@ void CqStats::PrintStats( TqInt level ) const
 		g_timerSet.printTimes(MSG);
 #	endif // USE_TIMERS
 
+	// The machine-readable texture report is written regardless of the
+	// verbosity, since it's meant for render management tools.
+	if(const CqString* texStatsFile = QGetRenderContext()->poptCurrent()->
+			GetStringOption( "statistics", "texturefile" ))
+	{
+		std::ofstream texStatsOut(texStatsFile->c_str());
+		if(texStatsOut)
+			QGetRenderContext()->textureCache().stats().writeJson(texStatsOut);
+		else
+			Aqsis::log() << error << "Could not open texture statistics file \""
+				<< *texStatsFile << "\"\n";
+	}
+
 	MSG << std::setiosflags(std::ios_base::fixed)
 		<< std::setfill(' ') << std::setprecision(6);
 
 	//! Most important informations
 	if ( level == 2 || level == 3 )
 	{
+		printParseStats( MSG, m_parseStats );
+
 		/*
 			-------------------------------------------------------------------
 			GPrim stats
@@ -292,8 +390,9 @@ void CqStats::PrintStats( TqInt level ) const
 		<< std::setw(5) << std::setprecision( 1 )<< std::setiosflags( std::ios::right ) << _grd_shd_128 << "%|"
 		<< std::setw(5) << std::setprecision( 1 )<< std::setiosflags( std::ios::right ) << _grd_shd_256 << "%|"
 		<< std::setw(5) << std::setprecision( 1 )<< std::setiosflags( std::ios::right ) << _grd_shd_g256 << "%|\n"
-		<< "\t+------+------+------+------+------+------+------+------+\n\n"
-		<< std::endl;
+		<< "\t+------+------+------+------+------+------+------+------+\n\n";
+		printGPrimClassStats( MSG );
+		MSG << std::endl;
 		/*
 			Grid stats - End
 			-------------------------------------------------------------------
@@ -411,6 +510,16 @@ void CqStats::PrintStats( TqInt level ) const
 		// MSG << "Transforms:\n\t";
 		// MSG << ( TqInt ) Transform_stack.size() << " created\n" << std::endl;
 		MSG << "Parameters:\n\t" << STATS_INT_GETI( PRM_created ) << " created, " << STATS_INT_GETI( PRM_peak ) << " peak\n" << std::endl;
+		/*
+			Texture stats
+			-------------------------------------------------------------------
+		*/
+		TqInt _tex_top = 10;
+		if(const TqInt* texTop = QGetRenderContext()->poptCurrent()->
+				GetIntegerOption( "statistics", "texturetop" ))
+			_tex_top = texTop[0];
+		QGetRenderContext()->textureCache().stats().printReport(MSG, _tex_top);
+		MSG << std::setprecision(6);
 	}
 	if ( level == 3 )
 	{
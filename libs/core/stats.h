@@ -34,6 +34,7 @@
 
 #include <aqsis/util/timer.h>
 #include <aqsis/ri/ri.h>
+#include <aqsis/riutil/ribparser.h>
 #include <aqsis/util/enum.h>
 
 namespace Aqsis {
@@ -44,6 +45,7 @@ extern TqInt gStats_getI( TqInt index );
 extern void gStats_setI( TqInt index, TqInt value );
 extern TqFloat gStats_getF( TqInt index );
 extern void gStats_setF( TqInt index, TqFloat value );
+extern void gStats_IncGPrimClassI( TqInt gprimClass, TqInt index );
 
 #define STATS_INC( index )				gStats_IncI( CqStats::index )
 #define STATS_DEC( index )				gStats_DecI( CqStats::index )
@@ -51,6 +53,7 @@ extern void gStats_setF( TqInt index, TqFloat value );
 #define	STATS_SETI( index , value )		gStats_setI( CqStats::index , value )
 #define	STATS_GETF( index )				gStats_getF( CqStats::index )
 #define	STATS_SETF( index , value )		gStats_setF( CqStats::index , value )
+#define STATS_GPC_INC( gprimClass, index )	gStats_IncGPrimClassI( gprimClass, CqStats::index )
 
 
 //----------------------------------------------------------------------
@@ -232,6 +235,18 @@ class CqStats
 			return m_floatVars[ index ];
 		}
 
+		//! Increase a per gprim class integer specified by an EqGPrimClassIndex value by one
+		static void IncGPrimClassI( const TqInt gprimClass, const TqInt index )
+		{
+			m_gprimClassVars[ gprimClass ][ index ]++;
+		}
+
+		//! Get a per gprim class integer specified by an EqGPrimClassIndex value
+		static TqInt getGPrimClassI( const TqInt gprimClass, const TqInt index )
+		{
+			return m_gprimClassVars[ gprimClass ][ index ];
+		}
+
 		/**
 			\param	value	This has to be a 32-bit integer!
 		 */
@@ -388,6 +403,43 @@ class CqStats
 
 		       _Last_int } EqIntIndex;
 
+		//! Classes of gprim for which tessellation is counted separately
+		enum EqGPrimClass
+		{
+		    GPrimClass_NURBS,
+		    GPrimClass_Blobby,
+		    GPrimClass_Polygon,
+		    GPrimClass_Subdivision,
+		    GPrimClass_Curve,
+		    GPrimClass_Points,
+		    GPrimClass_Quadric,
+		    GPrimClass_Patch,
+		    GPrimClass_Other,
+
+		    GPrimClass_Last
+		};
+
+		//! Enum to index the per gprim class integer array
+		enum EqGPrimClassIndex
+		{
+		    GPC_split,
+		    GPC_split_estimated,	// Split without a Diceable() test
+		    GPC_diced,
+		    GPC_grid_culled,
+
+		    //Unshaded grids
+		    GPC_grid_size_4,
+		    GPC_grid_size_8,
+		    GPC_grid_size_16,
+		    GPC_grid_size_32,
+		    GPC_grid_size_64,
+		    GPC_grid_size_128,
+		    GPC_grid_size_256,
+		    GPC_grid_size_g256,
+
+		    GPC_Last
+		};
+
 
 		/// \name Increasing counters
 		//@{
@@ -418,6 +470,13 @@ class CqStats
 
 		//@}
 
+		/** Get the counters for the RIB parser, covering the current world block.
+		 */
+		RibParserStats& parseStats()
+		{
+			return m_parseStats;
+		}
+
 		void PrintStats( TqInt level ) const;
 		void PrintInfo() const;
 
@@ -428,10 +487,12 @@ class CqStats
 
 		static TqFloat	 m_floatVars[ _Last_float ];		///< Float variables
 		static TqInt		m_intVars[ _Last_int ];			///< Int variables
+		static TqInt		m_gprimClassVars[ GPrimClass_Last ][ GPC_Last ];	///< Int variables per gprim class
 
 		TqInt m_cTextureMemory;     ///< Count of the memory used by texturemap.cpp
 		TqInt m_cTextureHits[ 2 ][ 5 ];     ///< Count of the hits encountered used by texturemap.cpp
 		TqInt m_cTextureMisses[ 5 ];     ///< Count of the hits encountered used by texturemap.cpp
+		RibParserStats m_parseStats;	///< Counters for the RIB parser.
 };
 
 
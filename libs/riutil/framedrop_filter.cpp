@@ -46,19 +46,46 @@
 namespace Aqsis {
 
 //------------------------------------------------------------------------------
+/// Filter passing through only the desired frames.
+///
+/// The desired frames may additionally be shared out between several jobs
+/// rendering the same stream, in which case the filter passes every
+/// numJobs'th desired frame, starting from the job'th.  A world block outside
+/// any frame is passed only to job 0, so that it's rendered once.
 class FrameDropFilter : public OnOffFilter
 {
     private:
         std::set<int> m_desiredFrames;
+        /// If true, all frames are desired.
+        bool m_allFrames;
+        /// Number of jobs the desired frames are shared between.
+        int m_numJobs;
+        /// Index of the job whose frames are passed.
+        int m_job;
+        /// Number of desired frames encountered so far.
+        int m_frameCount;
+        /// True between FrameBegin and FrameEnd.
+        bool m_inFrame;
 
     public:
-        FrameDropFilter(const std::vector<int>& desiredFrames)
-            : m_desiredFrames(desiredFrames.begin(), desiredFrames.end())
+        FrameDropFilter(const std::vector<int>& desiredFrames, bool allFrames,
+                        int numJobs, int job)
+            : m_desiredFrames(desiredFrames.begin(), desiredFrames.end()),
+            m_allFrames(allFrames),
+            m_numJobs(numJobs),
+            m_job(job),
+            m_frameCount(0),
+            m_inFrame(false)
         { }
 
         RtVoid FrameBegin(RtInt number)
         {
-            setActive(m_desiredFrames.find(number) != m_desiredFrames.end());
+            bool desired = m_allFrames ||
+                m_desiredFrames.find(number) != m_desiredFrames.end();
+            if(desired)
+                desired = m_frameCount++ % m_numJobs == m_job;
+            setActive(desired);
+            m_inFrame = true;
             if(isActive())
                 return nextFilter().FrameBegin(number);
         }
@@ -68,6 +95,23 @@ class FrameDropFilter : public OnOffFilter
             if(isActive())
                 nextFilter().FrameEnd();
             setActive(true);
+            m_inFrame = false;
+        }
+
+        RtVoid WorldBegin()
+        {
+            if(!m_inFrame && m_job != 0)
+                setActive(false);
+            if(isActive())
+                nextFilter().WorldBegin();
+        }
+
+        RtVoid WorldEnd()
+        {
+            if(isActive())
+                nextFilter().WorldEnd();
+            if(!m_inFrame)
+                setActive(true);
         }
 };
 
@@ -76,7 +120,7 @@ static void parseFrames(const Ri::ParamList& pList,
                         std::vector<int>& desiredFrames)
 {
     desiredFrames.clear();
-    // search for the "frames" parameter; if it's an integer array, just use
+    // Search for the "frames" parameter; if it's an integer array, just use
     // those frames.
     int idx = pList.find(Ri::TypeSpec(Ri::TypeSpec::Integer), "frames");
     if(idx >= 0)
@@ -130,11 +174,31 @@ static void parseFrames(const Ri::ParamList& pList,
     }
 }
 
+/// Get an optional integer parameter
+static int intParam(const Ri::ParamList& pList, const char* name, int defaultVal)
+{
+    int idx = pList.find(Ri::TypeSpec(Ri::TypeSpec::Integer), name);
+    if(idx < 0 || pList[idx].size() == 0)
+        return defaultVal;
+    return pList[idx].intData()[0];
+}
+
 Ri::Filter* createFrameDropFilter(const Ri::ParamList& pList)
 {
+    // The frames may be shared between several jobs, given by the "jobs"
+    // parameter, with "job" being the index of this job.
+    int numJobs = intParam(pList, "jobs", 1);
+    int job = intParam(pList, "job", 0);
+    if(numJobs < 1 || job < 0 || job >= numJobs)
+        AQSIS_THROW_XQERROR(XqValidation, EqE_BadToken,
+                "bad frame job " << job << " of " << numJobs);
     std::vector<int> desiredFrames;
-    parseFrames(pList, desiredFrames);
-    return new FrameDropFilter(desiredFrames);
+    bool allFrames = numJobs > 1
+        && pList.find(Ri::TypeSpec(Ri::TypeSpec::Integer), "frames") < 0
+        && pList.find(Ri::TypeSpec(Ri::TypeSpec::String), "frames") < 0;
+    if(!allFrames)
+        parseFrames(pList, desiredFrames);
+    return new FrameDropFilter(desiredFrames, allFrames, numJobs, job);
 }
 
 } // namespace Aqsis
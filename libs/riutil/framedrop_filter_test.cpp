@@ -0,0 +1,133 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+///
+/// \brief Frame dropping filter tests
+///
+
+#include <aqsis/aqsis.h>
+
+#define BOOST_TEST_DYN_LINK
+
+#include <aqsis/riutil/ricxx_filter.h>
+
+#include <string>
+#include <sstream>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <aqsis/riutil/ricxxutil.h>
+#include <aqsis/util/exception.h>
+
+using namespace Aqsis;
+
+namespace {
+
+/// Renderer recording the frames and the spheres inside them.
+class FrameRecorder : public StubRenderer
+{
+    public:
+        std::ostringstream calls;
+
+        virtual RtVoid FrameBegin(RtInt number) { calls << "[" << number; }
+        virtual RtVoid FrameEnd() { calls << "]"; }
+        virtual RtVoid WorldBegin() { calls << "<"; }
+        virtual RtVoid WorldEnd() { calls << ">"; }
+        virtual RtVoid Sphere(RtFloat radius, RtFloat zmin, RtFloat zmax,
+                              RtFloat thetamax, const ParamList& pList)
+        {
+            calls << "s";
+        }
+};
+
+/// Send frames 1 to 6 through the filter, each containing a sphere, with a
+/// sphere outside the frames at the end.
+std::string filterFrames(const Ri::ParamList& pList)
+{
+    FrameRecorder recorder;
+    boost::scoped_ptr<Ri::Filter> filter(createFilter("framedrop", pList));
+    filter->setNextFilter(recorder);
+    for(int i = 1; i <= 6; ++i)
+    {
+        filter->FrameBegin(i);
+        filter->Sphere(1, -1, 1, 360, Ri::ParamList());
+        filter->FrameEnd();
+    }
+    filter->Sphere(1, -1, 1, 360, Ri::ParamList());
+    return recorder.calls.str();
+}
+
+/// Send a world block outside any frame through the filter.
+std::string filterFramelessWorld(const Ri::ParamList& pList)
+{
+    FrameRecorder recorder;
+    boost::scoped_ptr<Ri::Filter> filter(createFilter("framedrop", pList));
+    filter->setNextFilter(recorder);
+    filter->WorldBegin();
+    filter->Sphere(1, -1, 1, 360, Ri::ParamList());
+    filter->WorldEnd();
+    filter->Sphere(1, -1, 1, 360, Ri::ParamList());
+    return recorder.calls.str();
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_CASE(framedrop_frame_list_test)
+{
+    BOOST_CHECK_EQUAL(filterFrames(ParamListBuilder()("frames", "2,4-5")),
+                      "[2s][4s][5s]s");
+}
+
+BOOST_AUTO_TEST_CASE(framedrop_jobs_test)
+{
+    // All frames shared between jobs
+    BOOST_CHECK_EQUAL(filterFrames(ParamListBuilder()("jobs", 2)("job", 0)),
+                      "[1s][3s][5s]s");
+    BOOST_CHECK_EQUAL(filterFrames(ParamListBuilder()("jobs", 2)("job", 1)),
+                      "[2s][4s][6s]s");
+    // Only the listed frames are shared between jobs
+    BOOST_CHECK_EQUAL(filterFrames(ParamListBuilder()("frames", "2-5")
+                                   ("jobs", 3)("job", 1)), "[3s]s");
+    BOOST_CHECK_EQUAL(filterFrames(ParamListBuilder()("frames", "2-5")
+                                   ("jobs", 3)("job", 0)), "[2s][5s]s");
+    // A world outside any frame is rendered by the first job only
+    BOOST_CHECK_EQUAL(filterFramelessWorld(ParamListBuilder()("jobs", 2)("job", 0)),
+                      "<s>s");
+    BOOST_CHECK_EQUAL(filterFramelessWorld(ParamListBuilder()("jobs", 2)("job", 1)),
+                      "s");
+    // Bad job indices are rejected
+    BOOST_CHECK_THROW(filterFrames(ParamListBuilder()("jobs", 2)("job", 2)),
+                      XqValidation);
+    BOOST_CHECK_THROW(filterFrames(ParamListBuilder()("jobs", 1)), XqValidation);
+}
+
+// vi: set et:
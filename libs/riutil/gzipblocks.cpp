@@ -0,0 +1,541 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief Block-structured gzip streams which can be compressed and
+/// decompressed on several threads.
+
+#include "gzipblocks.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/iostreams/categories.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <zlib.h>
+
+#include <aqsis/util/exception.h>
+
+namespace Aqsis {
+
+namespace {
+
+// Fixed part of the header of a block member: magic number, deflate
+// compression, FEXTRA flag, zero modification time, unknown OS and a single
+// six byte "BC" extra subfield.
+const unsigned char blockHeader[] = {
+    0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0
+};
+const size_t blockHeaderSize = sizeof(blockHeader) + 2;
+const size_t blockTrailerSize = 8;
+// Members must fit in the 16 bit size field of the header.
+const size_t maxMemberSize = 0x10000;
+// Number of blocks in each batch per thread.
+const int blocksPerThread = 8;
+
+inline void putLE16(unsigned char* c, TqUint32 i)
+{
+    c[0] = i & 0xFF;
+    c[1] = (i >> 8) & 0xFF;
+}
+
+inline void putLE32(unsigned char* c, TqUint32 i)
+{
+    putLE16(c, i);
+    putLE16(c + 2, i >> 16);
+}
+
+inline TqUint32 getLE16(const unsigned char* c)
+{
+    return c[0] | (c[1] << 8);
+}
+
+inline TqUint32 getLE32(const unsigned char* c)
+{
+    return getLE16(c) | (getLE16(c + 2) << 16);
+}
+
+int defaultNumThreads(int numThreads)
+{
+    if(numThreads > 0)
+        return numThreads;
+    return std::max<int>(boost::thread::hardware_concurrency(), 1);
+}
+
+// Deflate the input into a complete gzip member, returning false if the
+// member is too large for the size field.
+bool deflateMember(const std::vector<char>& in, std::vector<char>& out,
+                   int level)
+{
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if(deflateInit2(&z, level, Z_DEFLATED, -MAX_WBITS, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    out.resize(blockHeaderSize + deflateBound(&z, in.size())
+               + blockTrailerSize);
+    unsigned char* outBuf = reinterpret_cast<unsigned char*>(&out[0]);
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(
+                    in.empty() ? 0 : &in[0]));
+    z.avail_in = in.size();
+    z.next_out = outBuf + blockHeaderSize;
+    z.avail_out = out.size() - blockHeaderSize - blockTrailerSize;
+    int err = deflate(&z, Z_FINISH);
+    size_t size = blockHeaderSize + z.total_out + blockTrailerSize;
+    deflateEnd(&z);
+    if(err != Z_STREAM_END || size > maxMemberSize)
+        return false;
+    out.resize(size);
+    std::memcpy(outBuf, blockHeader, sizeof(blockHeader));
+    putLE16(outBuf + sizeof(blockHeader), size - 1);
+    TqUint32 crc = crc32(0, reinterpret_cast<const Bytef*>(
+                         in.empty() ? 0 : &in[0]), in.size());
+    putLE32(outBuf + size - 8, crc);
+    putLE32(outBuf + size - 4, in.size());
+    return true;
+}
+
+// Inflate a complete gzip member as read by GzipBlockInBuf.
+void inflateMember(const std::vector<char>& in, std::vector<char>& out)
+{
+    if(in.size() < blockHeaderSize + blockTrailerSize)
+        AQSIS_THROW_XQERROR(XqParseError, EqE_BadFile,
+            "truncated gzip block in compressed stream");
+    const unsigned char* inBuf = reinterpret_cast<const unsigned char*>(&in[0]);
+    size_t inSize = in.size() - blockTrailerSize;
+    TqUint32 isize = getLE32(inBuf + inSize + 4);
+    // The output is normally allocated from the size in the trailer.  A size
+    // larger than a block can hold isn't trusted for that; the member is
+    // inflated in pieces instead, and checked against the trailer after.
+    bool streaming = isize > maxMemberSize;
+    out.resize(streaming ? maxMemberSize : isize);
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if(inflateInit2(&z, -MAX_WBITS) != Z_OK)
+        AQSIS_THROW_XQERROR(XqInternal, EqE_NoMem,
+            "could not initialise gzip decompressor");
+    z.next_in = const_cast<Bytef*>(inBuf + blockHeaderSize);
+    z.avail_in = inSize - blockHeaderSize;
+    // zlib needs somewhere to write, even for empty blocks.
+    Bytef dummy = 0;
+    int err = Z_OK;
+    do
+    {
+        if(streaming && z.total_out == out.size())
+            out.resize(2*out.size());
+        z.next_out = out.empty() ? &dummy
+                     : reinterpret_cast<Bytef*>(&out[0]) + z.total_out;
+        z.avail_out = out.size() - z.total_out;
+        err = inflate(&z, streaming ? Z_NO_FLUSH : Z_FINISH);
+    }
+    while(streaming && err == Z_OK);
+    size_t outSize = z.total_out;
+    inflateEnd(&z);
+    out.resize(outSize);
+    // The trailer holds the size modulo 2^32.
+    if(err != Z_STREAM_END || static_cast<TqUint32>(outSize) != isize
+       || crc32(0, reinterpret_cast<const Bytef*>(out.empty() ? 0 : &out[0]),
+                out.size()) != getLE32(inBuf + inSize))
+        AQSIS_THROW_XQERROR(XqParseError, EqE_BadFile,
+            "corrupt gzip block in compressed stream");
+}
+
+/// Input device which returns a prefix string followed by the contents of a
+/// stream.
+class PrefixedSource
+{
+    public:
+        typedef char char_type;
+        typedef boost::iostreams::source_tag category;
+
+        PrefixedSource(const std::string& prefix, std::istream& in)
+            : m_prefix(prefix), m_pos(0), m_in(&in) {}
+
+        std::streamsize read(char* s, std::streamsize n)
+        {
+            if(m_pos < m_prefix.size())
+            {
+                n = std::min<std::streamsize>(n, m_prefix.size() - m_pos);
+                m_prefix.copy(s, n, m_pos);
+                m_pos += n;
+                return n;
+            }
+            m_in->read(s, n);
+            return m_in->gcount() > 0 ? m_in->gcount() : -1;
+        }
+
+    private:
+        std::string m_prefix;
+        size_t m_pos;
+        std::istream* m_in;
+};
+
+/// Input stream owning a GzipBlockInBuf.
+class GzipBlockIStream : public std::istream
+{
+    public:
+        GzipBlockIStream(std::istream& in, const std::string& header)
+            : std::istream(0),
+            m_buf(in, header)
+        {
+            rdbuf(&m_buf);
+            // Let errors from the buffer reach the parser, rather than
+            // appearing as a premature end of file.
+            exceptions(std::ios::badbit);
+        }
+    private:
+        GzipBlockInBuf m_buf;
+};
+
+/// Output stream owning a GzipBlockOutBuf.
+class GzipBlockOStream : public std::ostream
+{
+    public:
+        GzipBlockOStream(std::ostream& out, int numThreads)
+            : std::ostream(0),
+            m_buf(out, numThreads)
+        {
+            rdbuf(&m_buf);
+        }
+    private:
+        GzipBlockOutBuf m_buf;
+};
+
+} // anon. namespace
+
+
+//------------------------------------------------------------------------------
+// GzipBlockOutBuf implementation
+
+struct GzipBlockOutBuf::Block
+{
+    std::vector<char> input;
+    std::vector<char> output;
+
+    void compress()
+    {
+        // Data which doesn't compress is stored, which always fits.
+        if(!deflateMember(input, output, Z_DEFAULT_COMPRESSION))
+            deflateMember(input, output, 0);
+    }
+};
+
+GzipBlockOutBuf::GzipBlockOutBuf(std::ostream& out, int numThreads)
+    : m_out(out),
+    m_numThreads(defaultNumThreads(numThreads)),
+    m_batch(),
+    m_closed(false)
+{ }
+
+GzipBlockOutBuf::~GzipBlockOutBuf()
+{
+    close();
+}
+
+void GzipBlockOutBuf::close()
+{
+    if(m_closed)
+        return;
+    endBlock();
+    // An empty member marks the end of the stream.
+    m_batch.push_back(new Block());
+    writeBatch();
+    m_out.flush();
+    m_closed = true;
+}
+
+size_t GzipBlockOutBuf::maxBlockInput()
+{
+    // Leaves room for the header, trailer and stored block overhead.
+    return 0xff00;
+}
+
+GzipBlockOutBuf::int_type GzipBlockOutBuf::overflow(int_type c)
+{
+    endBlock();
+    if(static_cast<int>(m_batch.size()) >= m_numThreads*blocksPerThread)
+        writeBatch();
+    Block* block = new Block();
+    m_batch.push_back(block);
+    block->input.resize(maxBlockInput());
+    setp(&block->input[0], &block->input[0] + block->input.size());
+    if(!traits_type::eq_int_type(c, traits_type::eof()))
+        sputc(traits_type::to_char_type(c));
+    return traits_type::not_eof(c);
+}
+
+int GzipBlockOutBuf::sync()
+{
+    endBlock();
+    writeBatch();
+    m_out.flush();
+    return m_out ? 0 : -1;
+}
+
+/// Trim the block being filled to the characters written into it.
+void GzipBlockOutBuf::endBlock()
+{
+    if(!m_batch.empty() && pbase())
+    {
+        std::vector<char>& input = m_batch.back()->input;
+        input.resize(pptr() - pbase());
+        if(input.empty())
+        {
+            delete m_batch.back();
+            m_batch.pop_back();
+        }
+    }
+    setp(0, 0);
+}
+
+/// Compress the blocks of the current batch and write them out in order.
+void GzipBlockOutBuf::writeBatch()
+{
+    int numThreads = std::min<int>(m_numThreads, m_batch.size());
+    if(numThreads > 1)
+    {
+        boost::thread_group threads;
+        for(int t = 0; t < numThreads; ++t)
+        {
+            threads.create_thread(boost::bind(&compressBlocks,
+                                  boost::cref(m_batch), t, numThreads));
+        }
+        threads.join_all();
+    }
+    else
+        compressBlocks(m_batch, 0, 1);
+    for(size_t i = 0; i < m_batch.size(); ++i)
+    {
+        std::vector<char>& output = m_batch[i]->output;
+        m_out.write(&output[0], output.size());
+        delete m_batch[i];
+    }
+    m_batch.clear();
+}
+
+void GzipBlockOutBuf::compressBlocks(const std::vector<Block*>& blocks,
+                                     int first, int step)
+{
+    for(size_t i = first; i < blocks.size(); i += step)
+        blocks[i]->compress();
+}
+
+
+//------------------------------------------------------------------------------
+// GzipBlockInBuf implementation
+
+struct GzipBlockInBuf::Batch
+{
+    struct Block
+    {
+        std::vector<char> member;
+        std::vector<char> data;
+        /// Error message from inflating the block.
+        std::string error;
+    };
+    std::vector<Block> blocks;
+    /// Number of blocks in use.
+    size_t numBlocks;
+    /// Threads inflating the blocks.
+    boost::scoped_ptr<boost::thread_group> threads;
+
+    Batch() : blocks(), numBlocks(0) {}
+
+    void inflate(int first, int step)
+    {
+        for(size_t i = first; i < numBlocks; i += step)
+        {
+            try
+            {
+                inflateMember(blocks[i].member, blocks[i].data);
+            }
+            catch(XqException& e)
+            {
+                blocks[i].error = e.what();
+            }
+        }
+    }
+};
+
+GzipBlockInBuf::GzipBlockInBuf(std::istream& in, const std::string& header,
+                               int numThreads)
+    : m_in(in),
+    m_numThreads(defaultNumThreads(numThreads)),
+    m_header(header),
+    m_curr(new Batch()),
+    m_next(new Batch()),
+    m_currBlock(0)
+{
+    setg(0, 0, 0);
+    readBatch(*m_next);
+}
+
+GzipBlockInBuf::~GzipBlockInBuf()
+{
+    if(m_next->threads)
+        m_next->threads->join_all();
+}
+
+GzipBlockInBuf::int_type GzipBlockInBuf::underflow()
+{
+    while(gptr() == egptr())
+    {
+        if(m_currBlock < m_curr->numBlocks)
+        {
+            std::vector<char>& data = m_curr->blocks[m_currBlock++].data;
+            if(!data.empty())
+                setg(&data[0], &data[0], &data[0] + data.size());
+        }
+        else if(m_next->numBlocks > 0)
+        {
+            waitBatch(*m_next);
+            m_curr.swap(m_next);
+            m_currBlock = 0;
+            readBatch(*m_next);
+        }
+        else
+            return traits_type::eof();
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+/// Read the next complete gzip member from the input.
+///
+/// \return false at the end of the input.
+bool GzipBlockInBuf::readBlock(std::vector<char>& member)
+{
+    size_t size = 0;
+    if(m_header.empty())
+    {
+        size = readGzipHeader(m_in, m_header);
+        if(m_header.empty())
+            return false;
+    }
+    else
+    {
+        size = getLE16(reinterpret_cast<const unsigned char*>(
+                       m_header.data() + blockHeaderSize - 2)) + 1;
+    }
+    if(size < blockHeaderSize + blockTrailerSize)
+        AQSIS_THROW_XQERROR(XqParseError, EqE_BadFile,
+            "unexpected gzip member in block compressed stream");
+    member.resize(size);
+    std::copy(m_header.begin(), m_header.end(), member.begin());
+    m_in.read(&member[blockHeaderSize], size - blockHeaderSize);
+    m_header.clear();
+    if(static_cast<size_t>(m_in.gcount()) != size - blockHeaderSize)
+        AQSIS_THROW_XQERROR(XqParseError, EqE_BadFile,
+            "unexpected end of block compressed stream");
+    return true;
+}
+
+/// Read the members of a batch and start inflating them.
+void GzipBlockInBuf::readBatch(Batch& batch)
+{
+    batch.numBlocks = 0;
+    batch.blocks.resize(m_numThreads*blocksPerThread);
+    while(batch.numBlocks < batch.blocks.size()
+          && readBlock(batch.blocks[batch.numBlocks].member))
+        ++batch.numBlocks;
+    int numThreads = std::min<int>(m_numThreads, batch.numBlocks);
+    batch.threads.reset(new boost::thread_group());
+    for(int t = 0; t < numThreads; ++t)
+    {
+        batch.threads->create_thread(boost::bind(&Batch::inflate, &batch,
+                                                 t, numThreads));
+    }
+}
+
+/// Wait until all the blocks of a batch are inflated.
+void GzipBlockInBuf::waitBatch(Batch& batch)
+{
+    if(batch.threads)
+        batch.threads->join_all();
+    batch.threads.reset();
+    for(size_t i = 0; i < batch.numBlocks; ++i)
+    {
+        if(!batch.blocks[i].error.empty())
+            AQSIS_THROW_XQERROR(XqParseError, EqE_BadFile,
+                                batch.blocks[i].error);
+    }
+}
+
+
+//------------------------------------------------------------------------------
+size_t readGzipHeader(std::istream& in, std::string& header)
+{
+    char c[10];
+    in.read(c, 10);
+    header.assign(c, in.gcount());
+    if(header.size() < 10 || static_cast<unsigned char>(c[0]) != 0x1f
+       || static_cast<unsigned char>(c[1]) != 0x8b || c[3] != 4)
+        return 0;
+    // The member has an extra field and no other optional header fields;
+    // look for a "BC" subfield holding the member size.
+    in.read(c, 2);
+    header.append(c, in.gcount());
+    if(in.gcount() < 2)
+        return 0;
+    TqUint32 xlen = getLE16(reinterpret_cast<unsigned char*>(c));
+    std::string extra(xlen, '\0');
+    in.read(&extra[0], xlen);
+    header.append(extra, 0, in.gcount());
+    if(static_cast<TqUint32>(in.gcount()) != xlen
+       || header.size() != blockHeaderSize)
+        return 0;
+    const unsigned char* x = reinterpret_cast<const unsigned char*>(
+                                 extra.data());
+    if(x[0] != 'B' || x[1] != 'C' || getLE16(x + 2) != 2)
+        return 0;
+    return getLE16(x + 4) + 1;
+}
+
+std::ostream* createGzipBlockStream(std::ostream& out, int numThreads)
+{
+    return new GzipBlockOStream(out, numThreads);
+}
+
+std::istream* createGunzipStream(std::istream& in)
+{
+    std::string header;
+    if(readGzipHeader(in, header))
+        return new GzipBlockIStream(in, header);
+    namespace io = boost::iostreams;
+    io::filtering_stream<io::input>* zipStream =
+        new io::filtering_stream<io::input>();
+    zipStream->push(io::gzip_decompressor());
+    zipStream->push(PrefixedSource(header, in));
+    return zipStream;
+}
+
+} // namespace Aqsis
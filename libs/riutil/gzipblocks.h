@@ -0,0 +1,161 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief Block-structured gzip streams which can be compressed and
+/// decompressed on several threads.
+
+#ifndef AQSIS_GZIPBLOCKS_H_INCLUDED
+#define AQSIS_GZIPBLOCKS_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace Aqsis {
+
+/// Stream buffer which writes a block-structured gzip stream.
+///
+/// The output is split into independent gzip members, each holding at most
+/// maxBlockInput() bytes of uncompressed data.  Every member carries its
+/// compressed size in a "BC" extra subfield, using the same layout as the
+/// BGZF format, so that a reader can locate the members without inflating
+/// them.  The concatenation of members is a valid gzip stream which any gzip
+/// tool can decompress.
+///
+/// Blocks are collected into batches which are compressed in parallel before
+/// being written to the underlying stream in order.
+class GzipBlockOutBuf : public std::streambuf, boost::noncopyable
+{
+    public:
+        /// Create a buffer writing compressed data to out.
+        ///
+        /// \param numThreads - number of threads used for compression; zero
+        ///                     means one per processor.
+        GzipBlockOutBuf(std::ostream& out, int numThreads = 0);
+        virtual ~GzipBlockOutBuf();
+
+        /// Compress all pending data and write the end of stream marker.
+        ///
+        /// Called automatically on destruction; no output may follow.
+        void close();
+
+        /// Maximum number of uncompressed bytes in a single block.
+        static size_t maxBlockInput();
+
+    protected:
+        virtual int_type overflow(int_type c);
+        virtual int sync();
+
+    private:
+        struct Block;
+        void endBlock();
+        void writeBatch();
+        static void compressBlocks(const std::vector<Block*>& blocks,
+                                   int first, int step);
+
+        std::ostream& m_out;
+        int m_numThreads;
+        /// Blocks of the current batch; the last is being filled.
+        std::vector<Block*> m_batch;
+        bool m_closed;
+};
+
+
+/// Stream buffer which decompresses a block-structured gzip stream.
+///
+/// The stream consists of the gzip members written by GzipBlockOutBuf.
+/// Members are read in batches; while the characters of one batch are
+/// consumed the next is inflated in the background.
+class GzipBlockInBuf : public std::streambuf, boost::noncopyable
+{
+    public:
+        /// Create a buffer reading compressed data from in.
+        ///
+        /// \param in - compressed input stream
+        /// \param header - bytes of the first member header which have
+        ///                 already been read from in, as returned by
+        ///                 readGzipHeader().
+        /// \param numThreads - number of threads used for decompression;
+        ///                     zero means one per processor.
+        GzipBlockInBuf(std::istream& in, const std::string& header,
+                       int numThreads = 0);
+        virtual ~GzipBlockInBuf();
+
+    protected:
+        virtual int_type underflow();
+
+    private:
+        struct Batch;
+        bool readBlock(std::vector<char>& member);
+        void readBatch(Batch& batch);
+        void waitBatch(Batch& batch);
+
+        std::istream& m_in;
+        int m_numThreads;
+        /// Header of the next member, read ahead of its data.
+        std::string m_header;
+        /// Batch currently being read by the consumer.
+        boost::scoped_ptr<Batch> m_curr;
+        /// Batch being inflated in the background.
+        boost::scoped_ptr<Batch> m_next;
+        /// Index of the current block in m_curr.
+        size_t m_currBlock;
+};
+
+
+/// Read the header of a gzip member from the start of a stream.
+///
+/// \param in - stream positioned at the start of a gzip member.
+/// \param header - destination for the header bytes read.
+/// \return the compressed size of the member if it is part of a block
+/// structured stream, or zero otherwise.
+size_t readGzipHeader(std::istream& in, std::string& header);
+
+/// Create a stream which writes a block-structured gzip stream to out.
+///
+/// \param numThreads - number of threads used for compression; zero means
+///                     one per processor.
+std::ostream* createGzipBlockStream(std::ostream& out, int numThreads = 0);
+
+/// Create a stream which decompresses the gzipped data read from in.
+///
+/// Block-structured streams are inflated in parallel with GzipBlockInBuf;
+/// other gzip streams are decompressed serially.
+std::istream* createGunzipStream(std::istream& in);
+
+} // namespace Aqsis
+
+#endif // AQSIS_GZIPBLOCKS_H_INCLUDED
@@ -0,0 +1,199 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+///
+/// \brief Block-structured gzip stream tests
+///
+
+#include <aqsis/aqsis.h>
+
+#define BOOST_TEST_DYN_LINK
+
+#include "gzipblocks.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include <zlib.h>
+
+#include <aqsis/util/exception.h>
+
+using namespace Aqsis;
+
+namespace {
+
+// Generate some compressible text spanning many blocks.
+std::string testText(int numLines)
+{
+    std::ostringstream out;
+    for(int i = 0; i < numLines; ++i)
+        out << "PointsPolygons [3] [0 1 2] \"P\" [" << i << " " << i*i % 97
+            << " " << i*31 % 101 << "]\n";
+    return out.str();
+}
+
+std::string blockCompress(const std::string& text, int numThreads)
+{
+    std::ostringstream out;
+    {
+        boost::scoped_ptr<std::ostream> zipStream(
+            createGzipBlockStream(out, numThreads));
+        // Write in several pieces to exercise the block boundaries.
+        size_t pieceSize = text.size()/3;
+        zipStream->write(text.data(), pieceSize);
+        zipStream->flush();
+        zipStream->write(text.data() + pieceSize, text.size() - pieceSize);
+    }
+    return out.str();
+}
+
+void putLE32(std::string& s, size_t pos, TqUint32 i)
+{
+    for(int b = 0; b < 4; ++b)
+        s[pos + b] = static_cast<char>((i >> 8*b) & 0xFF);
+}
+
+// Compress text into a single gzip member with a "BC" size subfield,
+// regardless of how large the text is.
+std::string singleMember(const std::string& text)
+{
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                 Z_DEFAULT_STRATEGY);
+    std::string data(deflateBound(&z, text.size()), '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    z.avail_in = text.size();
+    z.next_out = reinterpret_cast<Bytef*>(&data[0]);
+    z.avail_out = data.size();
+    deflate(&z, Z_FINISH);
+    data.resize(z.total_out);
+    deflateEnd(&z);
+    const char header[] = {
+        '\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, '\xff', 6, 0, 'B', 'C', 2, 0, 0, 0
+    };
+    std::string member(header, sizeof(header));
+    member += data;
+    member.append(8, '\0');
+    size_t size = member.size() - 1;
+    member[16] = static_cast<char>(size & 0xFF);
+    member[17] = static_cast<char>(size >> 8);
+    putLE32(member, member.size() - 8, crc32(0,
+            reinterpret_cast<const Bytef*>(text.data()), text.size()));
+    putLE32(member, member.size() - 4, text.size());
+    return member;
+}
+
+std::string gunzip(const std::string& zipped)
+{
+    std::istringstream in(zipped);
+    boost::scoped_ptr<std::istream> zipStream(createGunzipStream(in));
+    std::string text;
+    char buf[1000];
+    while(zipStream->read(buf, sizeof(buf)) || zipStream->gcount() > 0)
+        text.append(buf, zipStream->gcount());
+    return text;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(GzipBlocks_roundtrip_test)
+{
+    std::string text = testText(100000);
+    BOOST_REQUIRE_GT(text.size(), 40*GzipBlockOutBuf::maxBlockInput());
+    for(int numThreads = 1; numThreads <= 3; ++numThreads)
+    {
+        std::string zipped = blockCompress(text, numThreads);
+        BOOST_CHECK_LT(zipped.size(), text.size()/4);
+        BOOST_CHECK(gunzip(zipped) == text);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GzipBlocks_standard_gzip_test)
+{
+    std::string text = testText(10000);
+    // Block compressed streams are ordinary multi-member gzip streams.
+    {
+        namespace io = boost::iostreams;
+        std::istringstream in(blockCompress(text, 2));
+        io::filtering_stream<io::input> zipStream;
+        zipStream.push(io::gzip_decompressor());
+        zipStream.push(in);
+        std::ostringstream out;
+        out << zipStream.rdbuf();
+        BOOST_CHECK(out.str() == text);
+    }
+    // Plain gzip streams are decompressed by createGunzipStream() too.
+    {
+        namespace io = boost::iostreams;
+        std::ostringstream out;
+        {
+            io::filtering_stream<io::output> zipStream;
+            zipStream.push(io::gzip_compressor());
+            zipStream.push(out);
+            zipStream << text;
+        }
+        BOOST_CHECK(gunzip(out.str()) == text);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GzipBlocks_corrupt_test)
+{
+    std::string zipped = blockCompress(testText(10000), 2);
+    // Damage the compressed data in the first block.
+    zipped[100] ^= 0x55;
+    BOOST_CHECK_THROW(gunzip(zipped), XqParseError);
+    // Truncated streams are also detected.
+    zipped = blockCompress(testText(10000), 2);
+    BOOST_CHECK_THROW(gunzip(zipped.substr(0, zipped.size() - 40)),
+                      XqParseError);
+}
+
+BOOST_AUTO_TEST_CASE(GzipBlocks_size_field_test)
+{
+    // Members from other writers may inflate to more than a block holds.
+    std::string text(300000, 'x');
+    std::string member = singleMember(text);
+    BOOST_REQUIRE_LT(member.size(), 0x10000U);
+    BOOST_CHECK(gunzip(member + singleMember("")) == text);
+    // A size field which doesn't match the data is rejected, rather than
+    // being used to allocate the output.
+    putLE32(member, member.size() - 4, 0xffffffff);
+    BOOST_CHECK_THROW(gunzip(member + singleMember("")), XqParseError);
+    member = singleMember("short");
+    putLE32(member, member.size() - 4, 0x10000);
+    BOOST_CHECK_THROW(gunzip(member + singleMember("")), XqParseError);
+}
@@ -0,0 +1,1237 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+/// \brief In-memory cache of parsed RIB archive files.
+
+#include <aqsis/riutil/ribarchivecache.h>
+
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/riutil/ricxx_filter.h>
+#include "ricxx_cache.h"
+
+namespace Aqsis {
+
+namespace {
+
+// Approximate memory held by cached copies of interface call arguments.
+//
+// Value-type arguments are stored inline in the cached requests, so they're
+// covered by the sizeof() the request itself.
+inline size_t argBytes(RtConstString str)
+{
+    return std::strlen(str) + 1;
+}
+
+template<typename T>
+inline size_t argBytes(const Ri::Array<T>& a)
+{
+    return a.size()*sizeof(T);
+}
+
+inline size_t argBytes(const Ri::StringArray& a)
+{
+    size_t bytes = a.size()*sizeof(RtConstString);
+    for(size_t i = 0; i < a.size(); ++i)
+        bytes += argBytes(a[i]);
+    return bytes;
+}
+
+inline size_t argBytes(const Ri::ParamList& pList)
+{
+    size_t bytes = 0;
+    for(size_t i = 0; i < pList.size(); ++i)
+    {
+        const Ri::Param& param = pList[i];
+        bytes += sizeof(Ri::Param) + argBytes(param.name());
+        switch(param.spec().storageType())
+        {
+            case Ri::TypeSpec::Integer:
+                bytes += argBytes(param.intData());
+                break;
+            case Ri::TypeSpec::Float:
+                bytes += argBytes(param.floatData());
+                break;
+            case Ri::TypeSpec::String:
+                bytes += argBytes(param.stringData());
+                break;
+            case Ri::TypeSpec::Pointer:
+                bytes += argBytes(param.ptrData());
+                break;
+            default:
+                break;
+        }
+    }
+    return bytes;
+}
+
+/// Cached ArchiveRecord call, so that comments reach any archive callback
+/// when the archive is replayed.
+class CachedArchiveRecord : public CachedRequest
+{
+    private:
+        std::string m_type;
+        std::string m_string;
+    public:
+        CachedArchiveRecord(RtConstToken type, const char* string)
+            : m_type(type),
+            m_string(string)
+        { }
+
+        virtual void reCall(Ri::Renderer& context) const
+        {
+            context.ArchiveRecord(m_type.c_str(), m_string.c_str());
+        }
+};
+
+/// Filter which records all interface calls into a CachedRiStream as they
+/// pass through to the next filter.
+class CachingFilter : public Ri::Filter
+{
+    private:
+        CachedRiStream* m_stream;
+        size_t m_bytes;
+
+    public:
+        CachingFilter(CachedRiStream& stream)
+            : m_stream(&stream),
+            m_bytes(0)
+        { }
+
+        /// Approximate memory used by the recorded calls.
+        size_t bytes() const { return m_bytes; }
+
+        virtual RtVoid ArchiveRecord(RtConstToken type, const char* string)
+        {
+            m_stream->push_back(new CachedArchiveRecord(type, string));
+            m_bytes += sizeof(CachedArchiveRecord) + argBytes(type)
+                       + argBytes(string);
+            nextFilter().ArchiveRecord(type, string);
+        }
+
+        virtual RtVoid Procedural(RtPointer data, RtConstBound bound,
+                            RtProcSubdivFunc refineproc,
+                            RtProcFreeFunc freeproc)
+        {
+            // The recorded call owns data, and frees it when the archive is
+            // destroyed.  The next filter gets the recorded call, which
+            // doesn't free data, so that later replays can still use it.
+            RiCache::Procedural* request =
+                new RiCache::Procedural(data, bound, refineproc, freeproc);
+            m_stream->push_back(request);
+            m_bytes += sizeof(RiCache::Procedural);
+            request->reCall(nextFilter());
+        }
+
+        // Code generator for autogenerated method declarations
+        /*[[[cog
+        from codegenutils import *
+        riXml = parseXml(riXmlPath)
+        from Cheetah.Template import Template
+
+        methodTemplate = r'''
+        virtual $wrapDecl($riCxxMethodDecl($proc), 72, wrapIndent=20)
+        {
+            m_stream->push_back(new RiCache::${procName}($callArgs));
+            m_bytes += $bytesExpr;
+            nextFilter().${procName}($callArgs);
+        }
+        '''
+
+        customImplementations = set(['Procedural'])
+
+        for proc in riXml.findall('Procedures/Procedure'):
+            if proc.findall('Rib'):
+                procName = proc.findtext('Name')
+                if procName in customImplementations:
+                    continue
+                callArgs = ', '.join(wrapperCallArgList(proc))
+                # Arguments which aren't stored inline in the cached request
+                sizedArgs = [a.findtext('Name') for a in ribArgs(proc)
+                             if re.search(r'Array|String|Token', formalArg(a))]
+                if proc.findall('Arguments/ParamList'):
+                    sizedArgs += ['pList']
+                bytesExpr = ' + '.join(['sizeof(RiCache::%s)' % (procName,)] +
+                                       ['argBytes(%s)' % (a,) for a in sizedArgs])
+                cog.out(str(Template(methodTemplate, searchList=locals())));
+
+        ]]]*/
+
+        virtual RtVoid Declare(RtConstString name, RtConstString declaration)
+        {
+            m_stream->push_back(new RiCache::Declare(name, declaration));
+            m_bytes += sizeof(RiCache::Declare) + argBytes(name) + argBytes(declaration);
+            nextFilter().Declare(name, declaration);
+        }
+
+        virtual RtVoid FrameBegin(RtInt number)
+        {
+            m_stream->push_back(new RiCache::FrameBegin(number));
+            m_bytes += sizeof(RiCache::FrameBegin);
+            nextFilter().FrameBegin(number);
+        }
+
+        virtual RtVoid FrameEnd()
+        {
+            m_stream->push_back(new RiCache::FrameEnd());
+            m_bytes += sizeof(RiCache::FrameEnd);
+            nextFilter().FrameEnd();
+        }
+
+        virtual RtVoid WorldBegin()
+        {
+            m_stream->push_back(new RiCache::WorldBegin());
+            m_bytes += sizeof(RiCache::WorldBegin);
+            nextFilter().WorldBegin();
+        }
+
+        virtual RtVoid WorldEnd()
+        {
+            m_stream->push_back(new RiCache::WorldEnd());
+            m_bytes += sizeof(RiCache::WorldEnd);
+            nextFilter().WorldEnd();
+        }
+
+        virtual RtVoid IfBegin(RtConstString condition)
+        {
+            m_stream->push_back(new RiCache::IfBegin(condition));
+            m_bytes += sizeof(RiCache::IfBegin) + argBytes(condition);
+            nextFilter().IfBegin(condition);
+        }
+
+        virtual RtVoid ElseIf(RtConstString condition)
+        {
+            m_stream->push_back(new RiCache::ElseIf(condition));
+            m_bytes += sizeof(RiCache::ElseIf) + argBytes(condition);
+            nextFilter().ElseIf(condition);
+        }
+
+        virtual RtVoid Else()
+        {
+            m_stream->push_back(new RiCache::Else());
+            m_bytes += sizeof(RiCache::Else);
+            nextFilter().Else();
+        }
+
+        virtual RtVoid IfEnd()
+        {
+            m_stream->push_back(new RiCache::IfEnd());
+            m_bytes += sizeof(RiCache::IfEnd);
+            nextFilter().IfEnd();
+        }
+
+        virtual RtVoid Format(RtInt xresolution, RtInt yresolution,
+                            RtFloat pixelaspectratio)
+        {
+            m_stream->push_back(new RiCache::Format(xresolution, yresolution, pixelaspectratio));
+            m_bytes += sizeof(RiCache::Format);
+            nextFilter().Format(xresolution, yresolution, pixelaspectratio);
+        }
+
+        virtual RtVoid FrameAspectRatio(RtFloat frameratio)
+        {
+            m_stream->push_back(new RiCache::FrameAspectRatio(frameratio));
+            m_bytes += sizeof(RiCache::FrameAspectRatio);
+            nextFilter().FrameAspectRatio(frameratio);
+        }
+
+        virtual RtVoid ScreenWindow(RtFloat left, RtFloat right, RtFloat bottom,
+                            RtFloat top)
+        {
+            m_stream->push_back(new RiCache::ScreenWindow(left, right, bottom, top));
+            m_bytes += sizeof(RiCache::ScreenWindow);
+            nextFilter().ScreenWindow(left, right, bottom, top);
+        }
+
+        virtual RtVoid CropWindow(RtFloat xmin, RtFloat xmax, RtFloat ymin,
+                            RtFloat ymax)
+        {
+            m_stream->push_back(new RiCache::CropWindow(xmin, xmax, ymin, ymax));
+            m_bytes += sizeof(RiCache::CropWindow);
+            nextFilter().CropWindow(xmin, xmax, ymin, ymax);
+        }
+
+        virtual RtVoid Projection(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Projection(name, pList));
+            m_bytes += sizeof(RiCache::Projection) + argBytes(name) + argBytes(pList);
+            nextFilter().Projection(name, pList);
+        }
+
+        virtual RtVoid Clipping(RtFloat cnear, RtFloat cfar)
+        {
+            m_stream->push_back(new RiCache::Clipping(cnear, cfar));
+            m_bytes += sizeof(RiCache::Clipping);
+            nextFilter().Clipping(cnear, cfar);
+        }
+
+        virtual RtVoid ClippingPlane(RtFloat x, RtFloat y, RtFloat z, RtFloat nx,
+                            RtFloat ny, RtFloat nz)
+        {
+            m_stream->push_back(new RiCache::ClippingPlane(x, y, z, nx, ny, nz));
+            m_bytes += sizeof(RiCache::ClippingPlane);
+            nextFilter().ClippingPlane(x, y, z, nx, ny, nz);
+        }
+
+        virtual RtVoid DepthOfField(RtFloat fstop, RtFloat focallength,
+                            RtFloat focaldistance)
+        {
+            m_stream->push_back(new RiCache::DepthOfField(fstop, focallength, focaldistance));
+            m_bytes += sizeof(RiCache::DepthOfField);
+            nextFilter().DepthOfField(fstop, focallength, focaldistance);
+        }
+
+        virtual RtVoid Shutter(RtFloat opentime, RtFloat closetime)
+        {
+            m_stream->push_back(new RiCache::Shutter(opentime, closetime));
+            m_bytes += sizeof(RiCache::Shutter);
+            nextFilter().Shutter(opentime, closetime);
+        }
+
+        virtual RtVoid PixelVariance(RtFloat variance)
+        {
+            m_stream->push_back(new RiCache::PixelVariance(variance));
+            m_bytes += sizeof(RiCache::PixelVariance);
+            nextFilter().PixelVariance(variance);
+        }
+
+        virtual RtVoid PixelSamples(RtFloat xsamples, RtFloat ysamples)
+        {
+            m_stream->push_back(new RiCache::PixelSamples(xsamples, ysamples));
+            m_bytes += sizeof(RiCache::PixelSamples);
+            nextFilter().PixelSamples(xsamples, ysamples);
+        }
+
+        virtual RtVoid PixelFilter(RtFilterFunc function, RtFloat xwidth,
+                            RtFloat ywidth)
+        {
+            m_stream->push_back(new RiCache::PixelFilter(function, xwidth, ywidth));
+            m_bytes += sizeof(RiCache::PixelFilter);
+            nextFilter().PixelFilter(function, xwidth, ywidth);
+        }
+
+        virtual RtVoid Exposure(RtFloat gain, RtFloat gamma)
+        {
+            m_stream->push_back(new RiCache::Exposure(gain, gamma));
+            m_bytes += sizeof(RiCache::Exposure);
+            nextFilter().Exposure(gain, gamma);
+        }
+
+        virtual RtVoid Imager(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Imager(name, pList));
+            m_bytes += sizeof(RiCache::Imager) + argBytes(name) + argBytes(pList);
+            nextFilter().Imager(name, pList);
+        }
+
+        virtual RtVoid Quantize(RtConstToken type, RtInt one, RtInt min, RtInt max,
+                            RtFloat ditheramplitude)
+        {
+            m_stream->push_back(new RiCache::Quantize(type, one, min, max, ditheramplitude));
+            m_bytes += sizeof(RiCache::Quantize) + argBytes(type);
+            nextFilter().Quantize(type, one, min, max, ditheramplitude);
+        }
+
+        virtual RtVoid Display(RtConstToken name, RtConstToken type, RtConstToken mode,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Display(name, type, mode, pList));
+            m_bytes += sizeof(RiCache::Display) + argBytes(name) + argBytes(type) + argBytes(mode) + argBytes(pList);
+            nextFilter().Display(name, type, mode, pList);
+        }
+
+        virtual RtVoid Hider(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Hider(name, pList));
+            m_bytes += sizeof(RiCache::Hider) + argBytes(name) + argBytes(pList);
+            nextFilter().Hider(name, pList);
+        }
+
+        virtual RtVoid ColorSamples(const FloatArray& nRGB, const FloatArray& RGBn)
+        {
+            m_stream->push_back(new RiCache::ColorSamples(nRGB, RGBn));
+            m_bytes += sizeof(RiCache::ColorSamples) + argBytes(nRGB) + argBytes(RGBn);
+            nextFilter().ColorSamples(nRGB, RGBn);
+        }
+
+        virtual RtVoid RelativeDetail(RtFloat relativedetail)
+        {
+            m_stream->push_back(new RiCache::RelativeDetail(relativedetail));
+            m_bytes += sizeof(RiCache::RelativeDetail);
+            nextFilter().RelativeDetail(relativedetail);
+        }
+
+        virtual RtVoid Option(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Option(name, pList));
+            m_bytes += sizeof(RiCache::Option) + argBytes(name) + argBytes(pList);
+            nextFilter().Option(name, pList);
+        }
+
+        virtual RtVoid AttributeBegin()
+        {
+            m_stream->push_back(new RiCache::AttributeBegin());
+            m_bytes += sizeof(RiCache::AttributeBegin);
+            nextFilter().AttributeBegin();
+        }
+
+        virtual RtVoid AttributeEnd()
+        {
+            m_stream->push_back(new RiCache::AttributeEnd());
+            m_bytes += sizeof(RiCache::AttributeEnd);
+            nextFilter().AttributeEnd();
+        }
+
+        virtual RtVoid Color(RtConstColor Cq)
+        {
+            m_stream->push_back(new RiCache::Color(Cq));
+            m_bytes += sizeof(RiCache::Color);
+            nextFilter().Color(Cq);
+        }
+
+        virtual RtVoid Opacity(RtConstColor Os)
+        {
+            m_stream->push_back(new RiCache::Opacity(Os));
+            m_bytes += sizeof(RiCache::Opacity);
+            nextFilter().Opacity(Os);
+        }
+
+        virtual RtVoid TextureCoordinates(RtFloat s1, RtFloat t1, RtFloat s2,
+                            RtFloat t2, RtFloat s3, RtFloat t3, RtFloat s4,
+                            RtFloat t4)
+        {
+            m_stream->push_back(new RiCache::TextureCoordinates(s1, t1, s2, t2, s3, t3, s4, t4));
+            m_bytes += sizeof(RiCache::TextureCoordinates);
+            nextFilter().TextureCoordinates(s1, t1, s2, t2, s3, t3, s4, t4);
+        }
+
+        virtual RtVoid LightSource(RtConstToken shadername, RtConstToken name,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::LightSource(shadername, name, pList));
+            m_bytes += sizeof(RiCache::LightSource) + argBytes(shadername) + argBytes(name) + argBytes(pList);
+            nextFilter().LightSource(shadername, name, pList);
+        }
+
+        virtual RtVoid AreaLightSource(RtConstToken shadername, RtConstToken name,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::AreaLightSource(shadername, name, pList));
+            m_bytes += sizeof(RiCache::AreaLightSource) + argBytes(shadername) + argBytes(name) + argBytes(pList);
+            nextFilter().AreaLightSource(shadername, name, pList);
+        }
+
+        virtual RtVoid Illuminate(RtConstToken name, RtBoolean onoff)
+        {
+            m_stream->push_back(new RiCache::Illuminate(name, onoff));
+            m_bytes += sizeof(RiCache::Illuminate) + argBytes(name);
+            nextFilter().Illuminate(name, onoff);
+        }
+
+        virtual RtVoid Surface(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Surface(name, pList));
+            m_bytes += sizeof(RiCache::Surface) + argBytes(name) + argBytes(pList);
+            nextFilter().Surface(name, pList);
+        }
+
+        virtual RtVoid Displacement(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Displacement(name, pList));
+            m_bytes += sizeof(RiCache::Displacement) + argBytes(name) + argBytes(pList);
+            nextFilter().Displacement(name, pList);
+        }
+
+        virtual RtVoid Atmosphere(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Atmosphere(name, pList));
+            m_bytes += sizeof(RiCache::Atmosphere) + argBytes(name) + argBytes(pList);
+            nextFilter().Atmosphere(name, pList);
+        }
+
+        virtual RtVoid Interior(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Interior(name, pList));
+            m_bytes += sizeof(RiCache::Interior) + argBytes(name) + argBytes(pList);
+            nextFilter().Interior(name, pList);
+        }
+
+        virtual RtVoid Exterior(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Exterior(name, pList));
+            m_bytes += sizeof(RiCache::Exterior) + argBytes(name) + argBytes(pList);
+            nextFilter().Exterior(name, pList);
+        }
+
+        virtual RtVoid ShaderLayer(RtConstToken type, RtConstToken name,
+                            RtConstToken layername, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::ShaderLayer(type, name, layername, pList));
+            m_bytes += sizeof(RiCache::ShaderLayer) + argBytes(type) + argBytes(name) + argBytes(layername) + argBytes(pList);
+            nextFilter().ShaderLayer(type, name, layername, pList);
+        }
+
+        virtual RtVoid ConnectShaderLayers(RtConstToken type, RtConstToken layer1,
+                            RtConstToken variable1, RtConstToken layer2,
+                            RtConstToken variable2)
+        {
+            m_stream->push_back(new RiCache::ConnectShaderLayers(type, layer1, variable1, layer2, variable2));
+            m_bytes += sizeof(RiCache::ConnectShaderLayers) + argBytes(type) + argBytes(layer1) + argBytes(variable1) + argBytes(layer2) + argBytes(variable2);
+            nextFilter().ConnectShaderLayers(type, layer1, variable1, layer2, variable2);
+        }
+
+        virtual RtVoid ShadingRate(RtFloat size)
+        {
+            m_stream->push_back(new RiCache::ShadingRate(size));
+            m_bytes += sizeof(RiCache::ShadingRate);
+            nextFilter().ShadingRate(size);
+        }
+
+        virtual RtVoid ShadingInterpolation(RtConstToken type)
+        {
+            m_stream->push_back(new RiCache::ShadingInterpolation(type));
+            m_bytes += sizeof(RiCache::ShadingInterpolation) + argBytes(type);
+            nextFilter().ShadingInterpolation(type);
+        }
+
+        virtual RtVoid Matte(RtBoolean onoff)
+        {
+            m_stream->push_back(new RiCache::Matte(onoff));
+            m_bytes += sizeof(RiCache::Matte);
+            nextFilter().Matte(onoff);
+        }
+
+        virtual RtVoid Bound(RtConstBound bound)
+        {
+            m_stream->push_back(new RiCache::Bound(bound));
+            m_bytes += sizeof(RiCache::Bound);
+            nextFilter().Bound(bound);
+        }
+
+        virtual RtVoid Detail(RtConstBound bound)
+        {
+            m_stream->push_back(new RiCache::Detail(bound));
+            m_bytes += sizeof(RiCache::Detail);
+            nextFilter().Detail(bound);
+        }
+
+        virtual RtVoid DetailRange(RtFloat offlow, RtFloat onlow, RtFloat onhigh,
+                            RtFloat offhigh)
+        {
+            m_stream->push_back(new RiCache::DetailRange(offlow, onlow, onhigh, offhigh));
+            m_bytes += sizeof(RiCache::DetailRange);
+            nextFilter().DetailRange(offlow, onlow, onhigh, offhigh);
+        }
+
+        virtual RtVoid GeometricApproximation(RtConstToken type, RtFloat value)
+        {
+            m_stream->push_back(new RiCache::GeometricApproximation(type, value));
+            m_bytes += sizeof(RiCache::GeometricApproximation) + argBytes(type);
+            nextFilter().GeometricApproximation(type, value);
+        }
+
+        virtual RtVoid Orientation(RtConstToken orientation)
+        {
+            m_stream->push_back(new RiCache::Orientation(orientation));
+            m_bytes += sizeof(RiCache::Orientation) + argBytes(orientation);
+            nextFilter().Orientation(orientation);
+        }
+
+        virtual RtVoid ReverseOrientation()
+        {
+            m_stream->push_back(new RiCache::ReverseOrientation());
+            m_bytes += sizeof(RiCache::ReverseOrientation);
+            nextFilter().ReverseOrientation();
+        }
+
+        virtual RtVoid Sides(RtInt nsides)
+        {
+            m_stream->push_back(new RiCache::Sides(nsides));
+            m_bytes += sizeof(RiCache::Sides);
+            nextFilter().Sides(nsides);
+        }
+
+        virtual RtVoid Identity()
+        {
+            m_stream->push_back(new RiCache::Identity());
+            m_bytes += sizeof(RiCache::Identity);
+            nextFilter().Identity();
+        }
+
+        virtual RtVoid Transform(RtConstMatrix transform)
+        {
+            m_stream->push_back(new RiCache::Transform(transform));
+            m_bytes += sizeof(RiCache::Transform);
+            nextFilter().Transform(transform);
+        }
+
+        virtual RtVoid ConcatTransform(RtConstMatrix transform)
+        {
+            m_stream->push_back(new RiCache::ConcatTransform(transform));
+            m_bytes += sizeof(RiCache::ConcatTransform);
+            nextFilter().ConcatTransform(transform);
+        }
+
+        virtual RtVoid Perspective(RtFloat fov)
+        {
+            m_stream->push_back(new RiCache::Perspective(fov));
+            m_bytes += sizeof(RiCache::Perspective);
+            nextFilter().Perspective(fov);
+        }
+
+        virtual RtVoid Translate(RtFloat dx, RtFloat dy, RtFloat dz)
+        {
+            m_stream->push_back(new RiCache::Translate(dx, dy, dz));
+            m_bytes += sizeof(RiCache::Translate);
+            nextFilter().Translate(dx, dy, dz);
+        }
+
+        virtual RtVoid Rotate(RtFloat angle, RtFloat dx, RtFloat dy, RtFloat dz)
+        {
+            m_stream->push_back(new RiCache::Rotate(angle, dx, dy, dz));
+            m_bytes += sizeof(RiCache::Rotate);
+            nextFilter().Rotate(angle, dx, dy, dz);
+        }
+
+        virtual RtVoid Scale(RtFloat sx, RtFloat sy, RtFloat sz)
+        {
+            m_stream->push_back(new RiCache::Scale(sx, sy, sz));
+            m_bytes += sizeof(RiCache::Scale);
+            nextFilter().Scale(sx, sy, sz);
+        }
+
+        virtual RtVoid Skew(RtFloat angle, RtFloat dx1, RtFloat dy1, RtFloat dz1,
+                            RtFloat dx2, RtFloat dy2, RtFloat dz2)
+        {
+            m_stream->push_back(new RiCache::Skew(angle, dx1, dy1, dz1, dx2, dy2, dz2));
+            m_bytes += sizeof(RiCache::Skew);
+            nextFilter().Skew(angle, dx1, dy1, dz1, dx2, dy2, dz2);
+        }
+
+        virtual RtVoid CoordinateSystem(RtConstToken space)
+        {
+            m_stream->push_back(new RiCache::CoordinateSystem(space));
+            m_bytes += sizeof(RiCache::CoordinateSystem) + argBytes(space);
+            nextFilter().CoordinateSystem(space);
+        }
+
+        virtual RtVoid CoordSysTransform(RtConstToken space)
+        {
+            m_stream->push_back(new RiCache::CoordSysTransform(space));
+            m_bytes += sizeof(RiCache::CoordSysTransform) + argBytes(space);
+            nextFilter().CoordSysTransform(space);
+        }
+
+        virtual RtVoid TransformBegin()
+        {
+            m_stream->push_back(new RiCache::TransformBegin());
+            m_bytes += sizeof(RiCache::TransformBegin);
+            nextFilter().TransformBegin();
+        }
+
+        virtual RtVoid TransformEnd()
+        {
+            m_stream->push_back(new RiCache::TransformEnd());
+            m_bytes += sizeof(RiCache::TransformEnd);
+            nextFilter().TransformEnd();
+        }
+
+        virtual RtVoid Resource(RtConstToken handle, RtConstToken type,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Resource(handle, type, pList));
+            m_bytes += sizeof(RiCache::Resource) + argBytes(handle) + argBytes(type) + argBytes(pList);
+            nextFilter().Resource(handle, type, pList);
+        }
+
+        virtual RtVoid ResourceBegin()
+        {
+            m_stream->push_back(new RiCache::ResourceBegin());
+            m_bytes += sizeof(RiCache::ResourceBegin);
+            nextFilter().ResourceBegin();
+        }
+
+        virtual RtVoid ResourceEnd()
+        {
+            m_stream->push_back(new RiCache::ResourceEnd());
+            m_bytes += sizeof(RiCache::ResourceEnd);
+            nextFilter().ResourceEnd();
+        }
+
+        virtual RtVoid Attribute(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Attribute(name, pList));
+            m_bytes += sizeof(RiCache::Attribute) + argBytes(name) + argBytes(pList);
+            nextFilter().Attribute(name, pList);
+        }
+
+        virtual RtVoid Polygon(const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Polygon(pList));
+            m_bytes += sizeof(RiCache::Polygon) + argBytes(pList);
+            nextFilter().Polygon(pList);
+        }
+
+        virtual RtVoid GeneralPolygon(const IntArray& nverts, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::GeneralPolygon(nverts, pList));
+            m_bytes += sizeof(RiCache::GeneralPolygon) + argBytes(nverts) + argBytes(pList);
+            nextFilter().GeneralPolygon(nverts, pList);
+        }
+
+        virtual RtVoid PointsPolygons(const IntArray& nverts, const IntArray& verts,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::PointsPolygons(nverts, verts, pList));
+            m_bytes += sizeof(RiCache::PointsPolygons) + argBytes(nverts) + argBytes(verts) + argBytes(pList);
+            nextFilter().PointsPolygons(nverts, verts, pList);
+        }
+
+        virtual RtVoid PointsGeneralPolygons(const IntArray& nloops,
+                            const IntArray& nverts, const IntArray& verts,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::PointsGeneralPolygons(nloops, nverts, verts, pList));
+            m_bytes += sizeof(RiCache::PointsGeneralPolygons) + argBytes(nloops) + argBytes(nverts) + argBytes(verts) + argBytes(pList);
+            nextFilter().PointsGeneralPolygons(nloops, nverts, verts, pList);
+        }
+
+        virtual RtVoid Basis(RtConstBasis ubasis, RtInt ustep, RtConstBasis vbasis,
+                            RtInt vstep)
+        {
+            m_stream->push_back(new RiCache::Basis(ubasis, ustep, vbasis, vstep));
+            m_bytes += sizeof(RiCache::Basis);
+            nextFilter().Basis(ubasis, ustep, vbasis, vstep);
+        }
+
+        virtual RtVoid Patch(RtConstToken type, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Patch(type, pList));
+            m_bytes += sizeof(RiCache::Patch) + argBytes(type) + argBytes(pList);
+            nextFilter().Patch(type, pList);
+        }
+
+        virtual RtVoid PatchMesh(RtConstToken type, RtInt nu, RtConstToken uwrap,
+                            RtInt nv, RtConstToken vwrap,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::PatchMesh(type, nu, uwrap, nv, vwrap, pList));
+            m_bytes += sizeof(RiCache::PatchMesh) + argBytes(type) + argBytes(uwrap) + argBytes(vwrap) + argBytes(pList);
+            nextFilter().PatchMesh(type, nu, uwrap, nv, vwrap, pList);
+        }
+
+        virtual RtVoid NuPatch(RtInt nu, RtInt uorder, const FloatArray& uknot,
+                            RtFloat umin, RtFloat umax, RtInt nv, RtInt vorder,
+                            const FloatArray& vknot, RtFloat vmin, RtFloat vmax,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::NuPatch(nu, uorder, uknot, umin, umax, nv, vorder, vknot, vmin, vmax, pList));
+            m_bytes += sizeof(RiCache::NuPatch) + argBytes(uknot) + argBytes(vknot) + argBytes(pList);
+            nextFilter().NuPatch(nu, uorder, uknot, umin, umax, nv, vorder, vknot, vmin, vmax, pList);
+        }
+
+        virtual RtVoid TrimCurve(const IntArray& ncurves, const IntArray& order,
+                            const FloatArray& knot, const FloatArray& min,
+                            const FloatArray& max, const IntArray& n,
+                            const FloatArray& u, const FloatArray& v,
+                            const FloatArray& w)
+        {
+            m_stream->push_back(new RiCache::TrimCurve(ncurves, order, knot, min, max, n, u, v, w));
+            m_bytes += sizeof(RiCache::TrimCurve) + argBytes(ncurves) + argBytes(order) + argBytes(knot) + argBytes(min) + argBytes(max) + argBytes(n) + argBytes(u) + argBytes(v) + argBytes(w);
+            nextFilter().TrimCurve(ncurves, order, knot, min, max, n, u, v, w);
+        }
+
+        virtual RtVoid SubdivisionMesh(RtConstToken scheme, const IntArray& nvertices,
+                            const IntArray& vertices, const TokenArray& tags,
+                            const IntArray& nargs, const IntArray& intargs,
+                            const FloatArray& floatargs,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::SubdivisionMesh(scheme, nvertices, vertices, tags, nargs, intargs, floatargs, pList));
+            m_bytes += sizeof(RiCache::SubdivisionMesh) + argBytes(scheme) + argBytes(nvertices) + argBytes(vertices) + argBytes(tags) + argBytes(nargs) + argBytes(intargs) + argBytes(floatargs) + argBytes(pList);
+            nextFilter().SubdivisionMesh(scheme, nvertices, vertices, tags, nargs, intargs, floatargs, pList);
+        }
+
+        virtual RtVoid Sphere(RtFloat radius, RtFloat zmin, RtFloat zmax,
+                            RtFloat thetamax, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Sphere(radius, zmin, zmax, thetamax, pList));
+            m_bytes += sizeof(RiCache::Sphere) + argBytes(pList);
+            nextFilter().Sphere(radius, zmin, zmax, thetamax, pList);
+        }
+
+        virtual RtVoid Cone(RtFloat height, RtFloat radius, RtFloat thetamax,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Cone(height, radius, thetamax, pList));
+            m_bytes += sizeof(RiCache::Cone) + argBytes(pList);
+            nextFilter().Cone(height, radius, thetamax, pList);
+        }
+
+        virtual RtVoid Cylinder(RtFloat radius, RtFloat zmin, RtFloat zmax,
+                            RtFloat thetamax, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Cylinder(radius, zmin, zmax, thetamax, pList));
+            m_bytes += sizeof(RiCache::Cylinder) + argBytes(pList);
+            nextFilter().Cylinder(radius, zmin, zmax, thetamax, pList);
+        }
+
+        virtual RtVoid Hyperboloid(RtConstPoint point1, RtConstPoint point2,
+                            RtFloat thetamax, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Hyperboloid(point1, point2, thetamax, pList));
+            m_bytes += sizeof(RiCache::Hyperboloid) + argBytes(pList);
+            nextFilter().Hyperboloid(point1, point2, thetamax, pList);
+        }
+
+        virtual RtVoid Paraboloid(RtFloat rmax, RtFloat zmin, RtFloat zmax,
+                            RtFloat thetamax, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Paraboloid(rmax, zmin, zmax, thetamax, pList));
+            m_bytes += sizeof(RiCache::Paraboloid) + argBytes(pList);
+            nextFilter().Paraboloid(rmax, zmin, zmax, thetamax, pList);
+        }
+
+        virtual RtVoid Disk(RtFloat height, RtFloat radius, RtFloat thetamax,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Disk(height, radius, thetamax, pList));
+            m_bytes += sizeof(RiCache::Disk) + argBytes(pList);
+            nextFilter().Disk(height, radius, thetamax, pList);
+        }
+
+        virtual RtVoid Torus(RtFloat majorrad, RtFloat minorrad, RtFloat phimin,
+                            RtFloat phimax, RtFloat thetamax,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Torus(majorrad, minorrad, phimin, phimax, thetamax, pList));
+            m_bytes += sizeof(RiCache::Torus) + argBytes(pList);
+            nextFilter().Torus(majorrad, minorrad, phimin, phimax, thetamax, pList);
+        }
+
+        virtual RtVoid Points(const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Points(pList));
+            m_bytes += sizeof(RiCache::Points) + argBytes(pList);
+            nextFilter().Points(pList);
+        }
+
+        virtual RtVoid Curves(RtConstToken type, const IntArray& nvertices,
+                            RtConstToken wrap, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Curves(type, nvertices, wrap, pList));
+            m_bytes += sizeof(RiCache::Curves) + argBytes(type) + argBytes(nvertices) + argBytes(wrap) + argBytes(pList);
+            nextFilter().Curves(type, nvertices, wrap, pList);
+        }
+
+        virtual RtVoid Blobby(RtInt nleaf, const IntArray& code,
+                            const FloatArray& floats, const TokenArray& strings,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Blobby(nleaf, code, floats, strings, pList));
+            m_bytes += sizeof(RiCache::Blobby) + argBytes(code) + argBytes(floats) + argBytes(strings) + argBytes(pList);
+            nextFilter().Blobby(nleaf, code, floats, strings, pList);
+        }
+
+        virtual RtVoid Geometry(RtConstToken type, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::Geometry(type, pList));
+            m_bytes += sizeof(RiCache::Geometry) + argBytes(type) + argBytes(pList);
+            nextFilter().Geometry(type, pList);
+        }
+
+        virtual RtVoid SolidBegin(RtConstToken type)
+        {
+            m_stream->push_back(new RiCache::SolidBegin(type));
+            m_bytes += sizeof(RiCache::SolidBegin) + argBytes(type);
+            nextFilter().SolidBegin(type);
+        }
+
+        virtual RtVoid SolidEnd()
+        {
+            m_stream->push_back(new RiCache::SolidEnd());
+            m_bytes += sizeof(RiCache::SolidEnd);
+            nextFilter().SolidEnd();
+        }
+
+        virtual RtVoid ObjectBegin(RtConstToken name)
+        {
+            m_stream->push_back(new RiCache::ObjectBegin(name));
+            m_bytes += sizeof(RiCache::ObjectBegin) + argBytes(name);
+            nextFilter().ObjectBegin(name);
+        }
+
+        virtual RtVoid ObjectEnd()
+        {
+            m_stream->push_back(new RiCache::ObjectEnd());
+            m_bytes += sizeof(RiCache::ObjectEnd);
+            nextFilter().ObjectEnd();
+        }
+
+        virtual RtVoid ObjectInstance(RtConstToken name)
+        {
+            m_stream->push_back(new RiCache::ObjectInstance(name));
+            m_bytes += sizeof(RiCache::ObjectInstance) + argBytes(name);
+            nextFilter().ObjectInstance(name);
+        }
+
+        virtual RtVoid MotionBegin(const FloatArray& times)
+        {
+            m_stream->push_back(new RiCache::MotionBegin(times));
+            m_bytes += sizeof(RiCache::MotionBegin) + argBytes(times);
+            nextFilter().MotionBegin(times);
+        }
+
+        virtual RtVoid MotionEnd()
+        {
+            m_stream->push_back(new RiCache::MotionEnd());
+            m_bytes += sizeof(RiCache::MotionEnd);
+            nextFilter().MotionEnd();
+        }
+
+        virtual RtVoid MakeTexture(RtConstString imagefile, RtConstString texturefile,
+                            RtConstToken swrap, RtConstToken twrap,
+                            RtFilterFunc filterfunc, RtFloat swidth,
+                            RtFloat twidth, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::MakeTexture(imagefile, texturefile, swrap, twrap, filterfunc, swidth, twidth, pList));
+            m_bytes += sizeof(RiCache::MakeTexture) + argBytes(imagefile) + argBytes(texturefile) + argBytes(swrap) + argBytes(twrap) + argBytes(pList);
+            nextFilter().MakeTexture(imagefile, texturefile, swrap, twrap, filterfunc, swidth, twidth, pList);
+        }
+
+        virtual RtVoid MakeLatLongEnvironment(RtConstString imagefile,
+                            RtConstString reflfile, RtFilterFunc filterfunc,
+                            RtFloat swidth, RtFloat twidth,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::MakeLatLongEnvironment(imagefile, reflfile, filterfunc, swidth, twidth, pList));
+            m_bytes += sizeof(RiCache::MakeLatLongEnvironment) + argBytes(imagefile) + argBytes(reflfile) + argBytes(pList);
+            nextFilter().MakeLatLongEnvironment(imagefile, reflfile, filterfunc, swidth, twidth, pList);
+        }
+
+        virtual RtVoid MakeCubeFaceEnvironment(RtConstString px, RtConstString nx,
+                            RtConstString py, RtConstString ny,
+                            RtConstString pz, RtConstString nz,
+                            RtConstString reflfile, RtFloat fov,
+                            RtFilterFunc filterfunc, RtFloat swidth,
+                            RtFloat twidth, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::MakeCubeFaceEnvironment(px, nx, py, ny, pz, nz, reflfile, fov, filterfunc, swidth, twidth, pList));
+            m_bytes += sizeof(RiCache::MakeCubeFaceEnvironment) + argBytes(px) + argBytes(nx) + argBytes(py) + argBytes(ny) + argBytes(pz) + argBytes(nz) + argBytes(reflfile) + argBytes(pList);
+            nextFilter().MakeCubeFaceEnvironment(px, nx, py, ny, pz, nz, reflfile, fov, filterfunc, swidth, twidth, pList);
+        }
+
+        virtual RtVoid MakeShadow(RtConstString picfile, RtConstString shadowfile,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::MakeShadow(picfile, shadowfile, pList));
+            m_bytes += sizeof(RiCache::MakeShadow) + argBytes(picfile) + argBytes(shadowfile) + argBytes(pList);
+            nextFilter().MakeShadow(picfile, shadowfile, pList);
+        }
+
+        virtual RtVoid MakeOcclusion(const StringArray& picfiles,
+                            RtConstString shadowfile, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::MakeOcclusion(picfiles, shadowfile, pList));
+            m_bytes += sizeof(RiCache::MakeOcclusion) + argBytes(picfiles) + argBytes(shadowfile) + argBytes(pList);
+            nextFilter().MakeOcclusion(picfiles, shadowfile, pList);
+        }
+
+        virtual RtVoid ErrorHandler(RtErrorFunc handler)
+        {
+            m_stream->push_back(new RiCache::ErrorHandler(handler));
+            m_bytes += sizeof(RiCache::ErrorHandler);
+            nextFilter().ErrorHandler(handler);
+        }
+
+        virtual RtVoid ReadArchive(RtConstToken name, RtArchiveCallback callback,
+                            const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::ReadArchive(name, callback, pList));
+            m_bytes += sizeof(RiCache::ReadArchive) + argBytes(name) + argBytes(pList);
+            nextFilter().ReadArchive(name, callback, pList);
+        }
+
+        virtual RtVoid ArchiveBegin(RtConstToken name, const ParamList& pList)
+        {
+            m_stream->push_back(new RiCache::ArchiveBegin(name, pList));
+            m_bytes += sizeof(RiCache::ArchiveBegin) + argBytes(name) + argBytes(pList);
+            nextFilter().ArchiveBegin(name, pList);
+        }
+
+        virtual RtVoid ArchiveEnd()
+        {
+            m_stream->push_back(new RiCache::ArchiveEnd());
+            m_bytes += sizeof(RiCache::ArchiveEnd);
+            nextFilter().ArchiveEnd();
+        }
+        ///[[[end]]]
+};
+
+
+/// An archive recorded into memory, along with the file state it was parsed
+/// from.
+class ParsedRibArchiveImpl : public ParsedRibArchive
+{
+    public:
+        ParsedRibArchiveImpl(const char* name)
+            : stream(name),
+            recordedBytes(0),
+            modTime(0),
+            fileSize(0),
+            cacheable(false)
+        { }
+
+        virtual void replay(Ri::Renderer& context) const
+        {
+            stream.replay(context);
+        }
+        virtual size_t bytes() const { return recordedBytes; }
+
+        CachedRiStream stream;
+        size_t recordedBytes;
+        std::time_t modTime;
+        boost::uintmax_t fileSize;
+        /// False if the file state couldn't be determined.
+        bool cacheable;
+};
+
+/// Get the modification time and size of a file.
+///
+/// \return false if path isn't a regular file.
+bool fileState(const std::string& path, std::time_t& modTime,
+               boost::uintmax_t& fileSize)
+{
+    try
+    {
+        modTime = boost::filesystem::last_write_time(path);
+        fileSize = boost::filesystem::file_size(path);
+        return true;
+    }
+    catch(boost::filesystem::filesystem_error& /*e*/)
+    {
+        return false;
+    }
+}
+
+/// Parse an archive, recording the calls as they go through to the context.
+boost::shared_ptr<ParsedRibArchiveImpl> parseArchive(const std::string& path,
+        const char* name, Ri::RendererServices& services,
+        Ri::Renderer& context)
+{
+    boost::shared_ptr<ParsedRibArchiveImpl> archive(
+            new ParsedRibArchiveImpl(name));
+    archive->cacheable = fileState(path, archive->modTime, archive->fileSize);
+    CachingFilter recorder(archive->stream);
+    recorder.setNextFilter(context);
+    recorder.setRendererServices(services);
+    if(!services.parseRibFile(path.c_str(), name, recorder))
+        return boost::shared_ptr<ParsedRibArchiveImpl>();
+    archive->recordedBytes = recorder.bytes();
+    return archive;
+}
+
+} // anon. namespace
+
+
+boost::shared_ptr<ParsedRibArchive> ParsedRibArchive::parse(
+        const std::string& path, const char* name,
+        Ri::RendererServices& services, Ri::Renderer& context)
+{
+    return parseArchive(path, name, services, context);
+}
+
+boost::shared_ptr<ParsedRibArchive> ParsedRibArchive::parse(
+        std::istream& stream, const char* name,
+        Ri::RendererServices& services, Ri::Renderer& context)
+{
+    boost::shared_ptr<ParsedRibArchiveImpl> archive(
+            new ParsedRibArchiveImpl(name));
+    CachingFilter recorder(archive->stream);
+    recorder.setNextFilter(context);
+    recorder.setRendererServices(services);
+    services.parseRib(stream, name, recorder);
+    archive->recordedBytes = recorder.bytes();
+    return archive;
+}
+
+
+//------------------------------------------------------------------------------
+/// Implementation of RibArchiveCache with LRU eviction.
+class RibArchiveCacheImpl : public RibArchiveCache
+{
+    public:
+        RibArchiveCacheImpl(size_t maxBytes)
+            : m_entries(),
+            m_index(),
+            m_maxBytes(maxBytes),
+            m_bytes(0),
+            m_replayed()
+        { }
+
+        virtual bool readArchive(const std::string& path, const char* name,
+                                 Ri::RendererServices& services,
+                                 Ri::Renderer& context);
+        virtual void readArchive(const std::string& path,
+                            const boost::shared_ptr<ParsedRibArchive>& archive,
+                            Ri::Renderer& context);
+
+        virtual void setMaxBytes(size_t maxBytes)
+        {
+            m_maxBytes = maxBytes;
+            trim(m_maxBytes);
+        }
+        virtual size_t maxBytes() const { return m_maxBytes; }
+        virtual size_t bytes() const { return m_bytes; }
+        virtual void clear() { trim(0); }
+        virtual void releaseReplayed() { m_replayed.clear(); }
+
+    private:
+        typedef boost::shared_ptr<ParsedRibArchiveImpl> ArchivePtr;
+        /// A cached archive.
+        struct Entry
+        {
+            std::string path;
+            ArchivePtr archive;
+        };
+        typedef std::list<Entry> EntryList;
+        typedef std::map<std::string, EntryList::iterator> EntryIndex;
+
+        void evict(EntryList::iterator entry)
+        {
+            m_bytes -= entry->archive->recordedBytes;
+            m_index.erase(entry->path);
+            m_entries.erase(entry);
+        }
+        /// Evict least recently used archives until at most maxBytes are held.
+        void trim(size_t maxBytes)
+        {
+            while(m_bytes > maxBytes && !m_entries.empty())
+                evict(--m_entries.end());
+        }
+        /// Add an archive to the cache if it fits into the budget.
+        void insert(const std::string& path, const ArchivePtr& archive);
+
+        /// Cached archives, most recently used first.
+        EntryList m_entries;
+        /// Lookup from path into m_entries.
+        EntryIndex m_index;
+        size_t m_maxBytes;
+        size_t m_bytes;
+        /// Archives replayed since the last releaseReplayed().
+        std::vector<ArchivePtr> m_replayed;
+};
+
+bool RibArchiveCacheImpl::readArchive(const std::string& path,
+                                      const char* name,
+                                      Ri::RendererServices& services,
+                                      Ri::Renderer& context)
+{
+    if(m_maxBytes == 0)
+        return services.parseRibFile(path.c_str(), name, context);
+    std::time_t modTime = 0;
+    boost::uintmax_t fileSize = 0;
+    if(!fileState(path, modTime, fileSize))
+    {
+        // Not a regular file; leave it to the parser to deal with.
+        return services.parseRibFile(path.c_str(), name, context);
+    }
+    EntryIndex::iterator i = m_index.find(path);
+    if(i != m_index.end())
+    {
+        EntryList::iterator entry = i->second;
+        if(entry->archive->modTime == modTime &&
+           entry->archive->fileSize == fileSize)
+        {
+            m_entries.splice(m_entries.begin(), m_entries, entry);
+            // Hold a reference, since nested archives read during the replay
+            // may evict this one.
+            ArchivePtr archive = entry->archive;
+            m_replayed.push_back(archive);
+            archive->replay(context);
+            return true;
+        }
+        // The file has changed on disk.
+        evict(entry);
+    }
+    ArchivePtr archive = parseArchive(path, name, services, context);
+    if(!archive)
+        return false;
+    m_replayed.push_back(archive);
+    insert(path, archive);
+    return true;
+}
+
+void RibArchiveCacheImpl::readArchive(const std::string& path,
+                            const boost::shared_ptr<ParsedRibArchive>& archive,
+                            Ri::Renderer& context)
+{
+    // All parsed archives come from ParsedRibArchive::parse()
+    ArchivePtr archiveImpl =
+        boost::static_pointer_cast<ParsedRibArchiveImpl>(archive);
+    m_replayed.push_back(archiveImpl);
+    archiveImpl->replay(context);
+    insert(path, archiveImpl);
+}
+
+void RibArchiveCacheImpl::insert(const std::string& path,
+                                 const ArchivePtr& archive)
+{
+    size_t bytes = archive->recordedBytes;
+    if(!archive->cacheable || bytes > m_maxBytes)
+        return;
+    // A recursive reference may have cached the same file while parsing.
+    EntryIndex::iterator i = m_index.find(path);
+    if(i != m_index.end())
+        evict(i->second);
+    trim(m_maxBytes - bytes);
+    Entry entry;
+    entry.path = path;
+    entry.archive = archive;
+    m_entries.push_front(entry);
+    m_index[path] = m_entries.begin();
+    m_bytes += bytes;
+}
+
+RibArchiveCache* RibArchiveCache::create(size_t maxBytes)
+{
+    return new RibArchiveCacheImpl(maxBytes);
+}
+
+} // namespace Aqsis
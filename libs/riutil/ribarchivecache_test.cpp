@@ -0,0 +1,307 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/// \file
+///
+/// \brief RIB archive cache tests
+///
+
+#include <aqsis/aqsis.h>
+
+#define BOOST_TEST_DYN_LINK
+
+#include <aqsis/riutil/ribarchivecache.h>
+
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <aqsis/riutil/errorhandler.h>
+#include <aqsis/riutil/ricxxutil.h>
+
+using namespace Aqsis;
+
+namespace {
+
+class NullErrorHandler : public Ri::ErrorHandler
+{
+    public:
+        NullErrorHandler() : ErrorHandler(Warning) {}
+    protected:
+        virtual void dispatch(int code, const std::string& message) {}
+};
+
+/// Procedural data which hasn't yet been freed.
+std::set<RtPointer> g_liveProcData;
+/// Number of calls to freeProcData().
+int g_procFrees = 0;
+
+RtVoid refineProcData(RtPointer data, RtFloat detail)
+{ }
+
+RtVoid freeProcData(RtPointer data)
+{
+    ++g_procFrees;
+    g_liveProcData.erase(data);
+    delete static_cast<int*>(data);
+}
+
+/// Renderer recording the radii of the spheres it receives.
+class SphereRecorder : public StubRenderer
+{
+    public:
+        std::string radii;
+
+        virtual RtVoid Sphere(RtFloat radius, RtFloat zmin, RtFloat zmax,
+                              RtFloat thetamax, const ParamList& pList)
+        {
+            radii += char('0' + static_cast<int>(radius));
+        }
+        /// Record 'p' for procedurals with valid data, then free the data as
+        /// the renderer does once the procedural is done with.
+        virtual RtVoid Procedural(RtPointer data, RtConstBound bound,
+                                  RtProcSubdivFunc refineproc,
+                                  RtProcFreeFunc freeproc)
+        {
+            radii += g_liveProcData.count(data) ? 'p' : 'x';
+            freeproc(data);
+        }
+};
+
+/// Services with a toy parser: each digit in the stream becomes a Sphere
+/// of that radius.
+class CountingServices : public StubRendererServices
+{
+    public:
+        int parseCount;
+
+        CountingServices() : parseCount(0) {}
+
+        virtual Ri::ErrorHandler& errorHandler() { return m_errHandler; }
+        virtual Ri::TypeSpec getDeclaration(RtConstToken token,
+                                            const char** nameBegin = 0,
+                                            const char** nameEnd = 0) const
+        {
+            return Ri::TypeSpec();
+        }
+        virtual Ri::Renderer& firstFilter() { return m_renderer; }
+
+        virtual bool parseRibFile(const char* fileName, const char* name,
+                                  Ri::Renderer& context)
+        {
+            ++parseCount;
+            return StubRendererServices::parseRibFile(fileName, name, context);
+        }
+        virtual void parseRib(std::istream& ribStream, const char* name,
+                              Ri::Renderer& context)
+        {
+            char c = 0;
+            while(ribStream.get(c))
+            {
+                if(c >= '0' && c <= '9')
+                    context.Sphere(c - '0', 0, 0, 360, Ri::ParamList());
+                else if(c == 'p')
+                {
+                    RtPointer data = new int(0);
+                    g_liveProcData.insert(data);
+                    RtBound bound = {0, 1, 0, 1, 0, 1};
+                    context.Procedural(data, bound, refineProcData,
+                                       freeProcData);
+                }
+            }
+        }
+        using StubRendererServices::parseRibFile;
+        using StubRendererServices::parseRib;
+
+    private:
+        NullErrorHandler m_errHandler;
+        SphereRecorder m_renderer;
+};
+
+struct ArchiveFile
+{
+    std::string path;
+
+    ArchiveFile(const char* name, const char* contents)
+        : path(name)
+    {
+        write(contents);
+    }
+    void write(const char* contents)
+    {
+        std::ofstream out(path.c_str());
+        out << contents;
+    }
+    ~ArchiveFile()
+    {
+        std::remove(path.c_str());
+    }
+};
+
+} // anon. namespace
+
+
+BOOST_AUTO_TEST_CASE(RibArchiveCache_replay_test)
+{
+    ArchiveFile archive("ribarchivecache_test_a.rib", "1 2 3");
+    CountingServices services;
+    SphereRecorder renderer;
+    boost::scoped_ptr<RibArchiveCache> cache(RibArchiveCache::create(1000000));
+
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(renderer.radii, "123123");
+    BOOST_CHECK_EQUAL(services.parseCount, 1);
+    BOOST_CHECK(cache->bytes() > 0);
+
+    cache->clear();
+    BOOST_CHECK_EQUAL(cache->bytes(), 0U);
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(services.parseCount, 2);
+}
+
+BOOST_AUTO_TEST_CASE(RibArchiveCache_disabled_test)
+{
+    ArchiveFile archive("ribarchivecache_test_a.rib", "1 2 3");
+    CountingServices services;
+    SphereRecorder renderer;
+    boost::scoped_ptr<RibArchiveCache> cache(RibArchiveCache::create());
+
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(renderer.radii, "123123");
+    BOOST_CHECK_EQUAL(services.parseCount, 2);
+    BOOST_CHECK_EQUAL(cache->bytes(), 0U);
+
+    BOOST_CHECK(!cache->readArchive("ribarchivecache_test_missing.rib", "m",
+                                    services, renderer));
+}
+
+BOOST_AUTO_TEST_CASE(RibArchiveCache_invalidate_test)
+{
+    ArchiveFile archive("ribarchivecache_test_a.rib", "1 2 3");
+    CountingServices services;
+    SphereRecorder renderer;
+    boost::scoped_ptr<RibArchiveCache> cache(RibArchiveCache::create(1000000));
+
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    // Changing the file size invalidates the cached archive.
+    archive.write("4 5 6 7");
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(renderer.radii, "12345674567");
+    BOOST_CHECK_EQUAL(services.parseCount, 2);
+}
+
+BOOST_AUTO_TEST_CASE(RibArchiveCache_evict_test)
+{
+    ArchiveFile archiveA("ribarchivecache_test_a.rib", "1 2 3");
+    ArchiveFile archiveB("ribarchivecache_test_b.rib", "4 5 6");
+    CountingServices services;
+    SphereRecorder renderer;
+    boost::scoped_ptr<RibArchiveCache> cache(RibArchiveCache::create(1000000));
+
+    BOOST_CHECK(cache->readArchive(archiveA.path, "a", services, renderer));
+    size_t archiveBytes = cache->bytes();
+    // Room for only one of the two archives.
+    cache->setMaxBytes(archiveBytes + archiveBytes/2);
+    BOOST_CHECK(cache->readArchive(archiveB.path, "b", services, renderer));
+    BOOST_CHECK_EQUAL(services.parseCount, 2);
+    BOOST_CHECK_EQUAL(cache->bytes(), archiveBytes);
+    // b is cached, a was evicted.
+    BOOST_CHECK(cache->readArchive(archiveB.path, "b", services, renderer));
+    BOOST_CHECK_EQUAL(services.parseCount, 2);
+    BOOST_CHECK(cache->readArchive(archiveA.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(services.parseCount, 3);
+    BOOST_CHECK_EQUAL(renderer.radii, "123456456123");
+
+    // Archives larger than the budget are never cached.
+    cache->setMaxBytes(archiveBytes/2);
+    BOOST_CHECK_EQUAL(cache->bytes(), 0U);
+    BOOST_CHECK(cache->readArchive(archiveA.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(cache->bytes(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(RibArchiveCache_parsed_test)
+{
+    ArchiveFile archive("ribarchivecache_test_a.rib", "1 2 3");
+    CountingServices services;
+    SphereRecorder parseRenderer;
+    boost::shared_ptr<ParsedRibArchive> parsed =
+        ParsedRibArchive::parse(archive.path, "a", services, parseRenderer);
+    BOOST_REQUIRE(parsed);
+    BOOST_CHECK_EQUAL(parseRenderer.radii, "123");
+    BOOST_CHECK(parsed->bytes() > 0);
+    BOOST_CHECK(!ParsedRibArchive::parse("ribarchivecache_test_missing.rib",
+                                         "m", services, parseRenderer));
+
+    // Replaying an archive parsed ahead of time caches it as if it had been
+    // read directly.
+    SphereRecorder renderer;
+    boost::scoped_ptr<RibArchiveCache> cache(RibArchiveCache::create(1000000));
+    cache->readArchive(archive.path, parsed, renderer);
+    BOOST_CHECK_EQUAL(cache->bytes(), parsed->bytes());
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(renderer.radii, "123123");
+    BOOST_CHECK_EQUAL(services.parseCount, 2);
+}
+
+BOOST_AUTO_TEST_CASE(RibArchiveCache_procedural_test)
+{
+    ArchiveFile archive("ribarchivecache_test_a.rib", "1 p");
+    CountingServices services;
+    SphereRecorder renderer;
+    g_procFrees = 0;
+
+    // Without caching, the renderer owns the procedural data.
+    boost::scoped_ptr<RibArchiveCache> cache(RibArchiveCache::create());
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(g_procFrees, 1);
+
+    // Once cached, the data is only freed when the archive is evicted, so
+    // replays still get valid data.
+    g_procFrees = 0;
+    cache->setMaxBytes(1000000);
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(g_procFrees, 0);
+    cache->releaseReplayed();
+    BOOST_CHECK(cache->readArchive(archive.path, "a", services, renderer));
+    BOOST_CHECK_EQUAL(g_procFrees, 0);
+    cache->releaseReplayed();
+    cache->clear();
+    BOOST_CHECK_EQUAL(g_procFrees, 1);
+    BOOST_CHECK_EQUAL(renderer.radii, "1p1p1p1p");
+    BOOST_CHECK(g_liveProcData.empty());
+}
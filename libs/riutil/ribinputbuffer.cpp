@@ -35,80 +35,198 @@
 
 #include "ribinputbuffer.h"
 
-#ifdef USE_GZIPPED_RIB
-#	include <boost/iostreams/filtering_stream.hpp>
-#	include <boost/iostreams/filter/gzip.hpp>
-#endif
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
 
 #include <aqsis/util/exception.h>
+#ifdef USE_GZIPPED_RIB
+#	include "gzipblocks.h"
+#endif
 
 namespace Aqsis {
 
 RibInputBuffer::RibInputBuffer(std::istream& inStream, const std::string& streamName)
 	: m_inStream(&inStream),
 	m_streamName(streamName),
+	m_memStream(),
 	m_gzipStream(),
-	m_bufPos(1),
-	m_bufEnd(2),
-	m_currPos(1,0),
-	m_prevPos(-1,-1)
+	m_memBegin(0),
+	m_memEnd(0),
+	m_pos(m_buffer),
+	m_end(m_buffer + 1),
+	m_countPos(m_buffer + 1),
+	m_countedPos(1,0),
+	m_countedChar(0)
 {
-	// Zero the putback chars
+	// Zero the putback char
 	m_buffer[0] = 0;
-	m_buffer[1] = 0;
 	if(isGzippedStream(inStream))
+		initGzip(inStream);
+}
+
+RibInputBuffer::RibInputBuffer(const char* begin, const char* end,
+		const std::string& streamName)
+	: m_inStream(0),
+	m_streamName(streamName),
+	m_memStream(),
+	m_gzipStream(),
+	m_memBegin(reinterpret_cast<const CharType*>(begin)),
+	m_memEnd(reinterpret_cast<const CharType*>(end)),
+	m_pos(m_buffer),
+	m_end(m_buffer + 1),
+	m_countPos(m_buffer + 1),
+	m_countedPos(1,0),
+	m_countedChar(0)
+{
+	m_buffer[0] = 0;
+	const CharType gzipMagic[] = {0x1f, 0x8b};
+	if(m_memEnd - m_memBegin >= 2 && m_memBegin[0] == gzipMagic[0]
+			&& m_memBegin[1] == gzipMagic[1])
 	{
-#		ifdef USE_GZIPPED_RIB
-		// Initialise gzip decompressor
+		// Compressed input can't be scanned in place, so fall back to
+		// reading through a decompressing stream.
 		namespace io = boost::iostreams;
-		io::filtering_stream<io::input>* zipStream = 0;
-		m_gzipStream.reset(zipStream = new io::filtering_stream<io::input>());
-		zipStream->push(io::gzip_decompressor());
-		zipStream->push(inStream);
-		m_inStream = m_gzipStream.get();
-#		else
-		AQSIS_THROW_XQERROR(XqParseError, EqE_Unimplement,
-			"gzipped RIB detected, but aqsis compiled without gzip support.");
-#		endif // USE_GZIPPED_RIB
+		m_memStream.reset(new io::stream<io::array_source>(begin, end));
+		m_memBegin = m_memEnd = 0;
+		m_inStream = m_memStream.get();
+		initGzip(*m_inStream);
+	}
+}
+
+void RibInputBuffer::initGzip(std::istream& inStream)
+{
+#	ifdef USE_GZIPPED_RIB
+	// Initialise gzip decompressor.  Block compressed streams are inflated
+	// in parallel.
+	m_gzipStream.reset(createGunzipStream(inStream));
+	m_inStream = m_gzipStream.get();
+#	else
+	AQSIS_THROW_XQERROR(XqParseError, EqE_Unimplement,
+		"gzipped RIB detected, but aqsis compiled without gzip support.");
+#	endif // USE_GZIPPED_RIB
+}
+
+/** \brief Compute the source position of the current character.
+ *
+ * Line endings are counted in bulk over the characters read since the
+ * previous call, so the cost is proportional to the amount of input read
+ * rather than to the number of calls.
+ */
+SourcePos RibInputBuffer::pos() const
+{
+	// After an unget() the current character may already have been counted.
+	if(m_pos < m_countPos)
+		return m_countedPos;
+	countLinesTo(m_pos);
+	SourcePos currPos = m_countedPos;
+	++currPos.col;
+	CharType c = *m_pos;
+	if(c == '\r' || (c == '\n' && m_countedChar != '\r'))
+	{
+		++currPos.line;
+		currPos.col = 0;
 	}
+	else if(c == '\n')
+		currPos.col = 0;
+	return currPos;
 }
 
-/** \brief Fill the internal buffer with as many characters as possible
- * (guarenteed >= 1)
+/// Account for the line endings of all characters in [m_countPos, end)
+void RibInputBuffer::countLinesTo(const CharType* end) const
+{
+	int line = m_countedPos.line;
+	int col = m_countedPos.col;
+	CharType prev = m_countedChar;
+	for(const CharType* p = m_countPos; p < end; ++p)
+	{
+		CharType c = *p;
+		++col;
+		if(c == '\r' || (c == '\n' && prev != '\r'))
+		{
+			++line;
+			col = 0;
+		}
+		else if(c == '\n')
+			col = 0;
+		prev = c;
+	}
+	if(end > m_countPos)
+	{
+		m_countedPos = SourcePos(line, col);
+		m_countedChar = prev;
+		m_countPos = end;
+	}
+}
+
+/** \brief Move on to the next window of characters (guarenteed >= 1 char)
  *
- * This function reads in as many characters as possible using a non-blocking
- * read on the istream.  If no characters are returned from the non-blocking
- * read, a single character is read using the blocking std::istream::get()
- * function.
+ * For stream input, this reads in as many characters as possible using a
+ * non-blocking read on the istream.  If no characters are returned from the
+ * non-blocking read, a single character is read using the blocking
+ * std::istream::get() function.
  *
- * Postconditions: The m_bufPos index is one before the next character in the
- * input stream.  The m_bufEnd index points to one after the last valid
- * character.  m_bufPos < m_bufEnd
+ * For memory input, the window is moved onto the memory itself, or onto a
+ * single eof character once the memory is exhausted.
+ *
+ * Postconditions: m_pos points to the next character in the input and
+ * m_end points to one after the last valid character.  The character
+ * before m_pos is valid so that unget() works.
  */
 void RibInputBuffer::bufferNextChars()
 {
-	// Precondition: m_bufPos is pointing to a one off the end of the valid
-	// characters in the buffer.
-	assert(m_bufPos == m_bufEnd);
+	// Precondition: m_pos is pointing to one off the end of the valid
+	// characters in the window.
+	assert(m_pos == m_end);
+	if(!m_inStream)
+	{
+		// Account for any line endings before moving away from the window.
+		countLinesTo(m_end);
+		m_buffer[0] = m_end[-1];
+		if(m_memBegin != m_memEnd)
+		{
+			if(m_end == m_buffer + 1)
+			{
+				// The first character is served from the buffer so that the
+				// memory window always has a valid character for unget().
+				m_buffer[1] = *m_memBegin++;
+				m_end = m_buffer + 2;
+			}
+			else
+			{
+				m_pos = m_memBegin;
+				m_end = m_memEnd;
+				m_memBegin = m_memEnd;
+				m_countPos = m_pos;
+				return;
+			}
+		}
+		else
+		{
+			m_buffer[1] = eof;
+			m_end = m_buffer + 2;
+		}
+		m_pos = m_buffer + 1;
+		m_countPos = m_pos;
+		return;
+	}
 	// first make sure that we're not at the maximum extent of the buffer; if
 	// so we need to wrap around to the beginning.
-	if(m_bufEnd == m_bufSize)
+	if(m_end == m_buffer + m_bufSize)
 	{
-		// Copy over some chars so that we can always unget() at least one and
-		// still look back into the buffer an additional char for line ending
-		// detection.
-		m_buffer[0] = m_buffer[m_bufSize-2];
-		m_buffer[1] = m_buffer[m_bufSize-1];
-		// Reset buffer position
-		m_bufPos = 1;
+		countLinesTo(m_end);
+		// Copy over the last char so that we can always unget() at least one.
+		m_buffer[0] = m_end[-1];
+		m_pos = m_buffer + 1;
+		m_countPos = m_pos;
 	}
+	CharType* readPos = m_buffer + (m_pos - m_buffer);
 	// Now fill the buffer with as many characters as possible using a
 	// non-blocking read with readsome().
-	int numRead = m_inStream->readsome((char*)m_buffer + m_bufPos,
-									   m_bufSize - m_bufPos);
+	int numRead = m_inStream->readsome(reinterpret_cast<char*>(readPos),
+									   m_buffer + m_bufSize - readPos);
 	if(numRead > 0)
 	{
-		m_bufEnd = m_bufPos + numRead;
+		m_end = readPos + numRead;
 	}
 	else
 	{
@@ -117,8 +235,8 @@ void RibInputBuffer::bufferNextChars()
 		// charater.  (Reading a single char may block, but that's acceptable.)
 		std::istream::int_type c = m_inStream->get();
 		// translate EOFs
-		m_buffer[m_bufPos] = (c == EOF) ? eof : c;
-		m_bufEnd = m_bufPos + 1;
+		*readPos = (c == EOF) ? eof : c;
+		m_end = readPos + 1;
 	}
 }
 
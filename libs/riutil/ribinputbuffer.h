@@ -61,6 +61,7 @@ struct SourcePos
  * The buffer supports three main actions:
  *   * get a single character
  *   * put back the last character read (unget)
+ *   * scan directly over the characters which are already buffered
  *
  * These actions are sufficient for correctly constructing tokens from the RIB
  * stream.  The RISpec explicitly states that RIB should be thought of as a
@@ -68,6 +69,15 @@ struct SourcePos
  * stdin, the "end" of the rib stream may be encountered at any time.  This
  * class therefore makes sure that any input buffering of a requested number of
  * characters is non-blocking.
+ *
+ * Alternatively, the buffer may be constructed over a range of memory such as
+ * a memory-mapped file.  In this case characters are read in place without
+ * any copying, and the whole of the remaining input is available for bulk
+ * scanning.
+ *
+ * Line and column numbers are not tracked as characters are read; they're
+ * computed on demand by pos() which counts line endings over the characters
+ * read since the last call.
  */
 class RibInputBuffer : boost::noncopyable
 {
@@ -85,12 +95,40 @@ class RibInputBuffer : boost::noncopyable
 		 */
 		RibInputBuffer(std::istream& inStream,
 				const std::string& streamName = "unknown");
+		/** \brief Construct an input buffer reading directly from memory.
+		 *
+		 * The characters are scanned in place, so the memory must remain
+		 * valid for the lifetime of the buffer.
+		 *
+		 * \param begin - start of the input characters
+		 * \param end - one past the last input character
+		 * \param streamName - name of the stream used in error messages.
+		 */
+		RibInputBuffer(const char* begin, const char* end,
+				const std::string& streamName = "unknown");
 
 		/// Get the next character from the input stream
 		CharType get();
 		/// Put the last character back into the input stream
 		void unget();
 
+		/** \brief Get the range of characters following the current one
+		 * which are available without further reads.
+		 *
+		 * The range [bufBegin(), bufEnd()) may be empty.  Characters in the
+		 * range may be examined directly and then consumed with skipTo().
+		 */
+		const CharType* bufBegin() const;
+		/// End of the range of buffered characters; see bufBegin().
+		const CharType* bufEnd() const;
+		/** \brief Consume all buffered characters before the given position
+		 *
+		 * After the call, the last character obtained is newPos[-1].
+		 *
+		 * \param newPos - position in the range [bufBegin(), bufEnd()]
+		 */
+		void skipTo(const CharType* newPos);
+
 		/// Return the position of the previous character obtained with get()
 		SourcePos pos() const;
 		/// Return the name of the input stream
@@ -98,28 +136,40 @@ class RibInputBuffer : boost::noncopyable
 
 	private:
 		static bool isGzippedStream(std::istream& in);
+		void initGzip(std::istream& inStream);
 		void bufferNextChars();
+		void countLinesTo(const CharType* end) const;
 
-		/// Stream we are reading from.
+		/// Stream we are reading from, or null when reading from memory.
 		std::istream* m_inStream;
 		/// Stream name
 		const std::string m_streamName;
+		/// Stream wrapping the memory input when it needs to be decompressed
+		boost::scoped_ptr<std::istream> m_memStream;
 		/// gzip decompressor for compressed input
 		boost::scoped_ptr<std::istream> m_gzipStream;
 
+		/// Start of memory input not yet handed over to the buffer window.
+		const CharType* m_memBegin;
+		/// End of memory input.
+		const CharType* m_memEnd;
+
 		/// Internal buffer size.
 		static const int m_bufSize = 256;
 		/// Internal buffer of characters.
 		CharType m_buffer[m_bufSize];
-		/// Position of current character [ie, last char returned with get() ]
-		int m_bufPos;
-		/// Position of last valid character in input buffer.
-		int m_bufEnd;
-
-		/// Current source location
-		SourcePos m_currPos;
-		/// Previous source location
-		SourcePos m_prevPos;
+		/// Current character [ie, last char returned with get() ]
+		const CharType* m_pos;
+		/// One past the last valid character in the current window; the
+		/// window is either m_buffer or the memory input.
+		const CharType* m_end;
+
+		/// Characters before this have been accounted for in m_countedPos.
+		mutable const CharType* m_countPos;
+		/// Source location of the character before m_countPos.
+		mutable SourcePos m_countedPos;
+		/// Character before m_countPos, for CRLF detection.
+		mutable CharType m_countedChar;
 };
 
 
@@ -129,37 +179,34 @@ class RibInputBuffer : boost::noncopyable
 // RibInputBuffer implementation
 inline RibInputBuffer::CharType RibInputBuffer::get()
 {
-	// Get next character.
-	++m_bufPos;
-	if(m_bufPos >= m_bufEnd)
+	++m_pos;
+	if(m_pos >= m_end)
 		bufferNextChars();
-	CharType c = m_buffer[m_bufPos];
-
-	// Keep line and column numbers up to date.
-	m_prevPos = m_currPos;
-	++m_currPos.col;
-	if(c == '\r' || (c == '\n' && m_buffer[m_bufPos-1] != '\r'))
-	{
-		++m_currPos.line;
-		m_currPos.col = 0;
-	}
-	else if(c == '\n')
-		m_currPos.col = 0;
-	return c;
+	return *m_pos;
 }
 
 inline void RibInputBuffer::unget()
 {
-	// Precondition: current buffer position is at least two chars into the
-	// buffer so that lookback can work.
-	assert(m_bufPos >= 1);
-	--m_bufPos;
-	m_currPos = m_prevPos;
+	// Precondition: at least one character has been read with get() since
+	// the last unget(), so that the previous character is still in the
+	// current window.
+	--m_pos;
+}
+
+inline const RibInputBuffer::CharType* RibInputBuffer::bufBegin() const
+{
+	return m_pos + 1;
+}
+
+inline const RibInputBuffer::CharType* RibInputBuffer::bufEnd() const
+{
+	return m_end;
 }
 
-inline SourcePos RibInputBuffer::pos() const
+inline void RibInputBuffer::skipTo(const CharType* newPos)
 {
-	return m_currPos;
+	assert(newPos > m_pos && newPos <= m_end);
+	m_pos = newPos - 1;
 }
 
 inline const std::string& RibInputBuffer::streamName() const
@@ -119,4 +119,45 @@ BOOST_AUTO_TEST_CASE(RibInputBuffer_bufwrap_test)
 	BOOST_CHECK_EQUAL(extractedStr, inStr);
 }
 
+BOOST_AUTO_TEST_CASE(RibInputBuffer_memory_test)
+{
+	// Test reading directly from a memory range.
+	const std::string inStr("some rib\ncharacters\r\nhere");
+	RibInputBuffer inBuf(inStr.data(), inStr.data() + inStr.size());
+
+	BOOST_CHECK_EQUAL(inBuf.get(), 's');
+	inBuf.unget();
+	BOOST_CHECK_EQUAL(inBuf.get(), 's');
+	// The rest of the input should be available for bulk scanning.
+	BOOST_CHECK_EQUAL(inBuf.get(), 'o');
+	BOOST_CHECK_EQUAL(inBuf.bufEnd() - inBuf.bufBegin(),
+			static_cast<int>(inStr.size()) - 2);
+	inBuf.skipTo(inBuf.bufBegin() + 5);
+	BOOST_CHECK_EQUAL(inBuf.get(), 'b');
+	SourcePos pos = inBuf.pos();
+	BOOST_CHECK_EQUAL(pos.line, 1);
+	BOOST_CHECK_EQUAL(pos.col, 8);
+
+	inBuf.skipTo(inBuf.bufBegin() + 11);
+	BOOST_CHECK_EQUAL(inBuf.get(), '\r');
+	BOOST_CHECK_EQUAL(inBuf.get(), '\n');
+	pos = inBuf.pos();
+	BOOST_CHECK_EQUAL(pos.line, 3);
+	BOOST_CHECK_EQUAL(pos.col, 0);
+	inBuf.unget();
+	pos = inBuf.pos();
+	BOOST_CHECK_EQUAL(pos.line, 3);
+	BOOST_CHECK_EQUAL(pos.col, 0);
+	BOOST_CHECK_EQUAL(inBuf.get(), '\n');
+
+	std::string extractedStr;
+	RibInputBuffer::CharType c = 0;
+	while((c = inBuf.get()) != RibInputBuffer::eof)
+		extractedStr += c;
+	BOOST_CHECK_EQUAL(extractedStr, "here");
+	inBuf.unget();
+	BOOST_CHECK(inBuf.get() == RibInputBuffer::eof);
+	BOOST_CHECK(inBuf.get() == RibInputBuffer::eof);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -41,23 +41,6 @@
 
 namespace Aqsis {
 
-namespace {
-
-template<typename T>
-Ri::Array<T> toRiArray(const std::vector<T>& v)
-{
-    if(v.empty())
-        return Ri::Array<T>();
-    return Ri::Array<T>(&v[0], v.size());
-}
-
-Ri::StringArray toRiArray(MultiStringBuffer& buf)
-{
-    return toRiArray(buf.toCstringVec());
-}
-
-}
-
 
 // RibLexerImpl implementation
 RibLexerImpl::RibLexerImpl()
@@ -65,7 +48,8 @@ RibLexerImpl::RibLexerImpl()
     m_stringPool(),
     m_floatArrayPool(),
     m_intArrayPool(),
-    m_stringArrayPool()
+    m_stringArrayPool(),
+    m_arrayBytes(0)
 { }
 
 void RibLexerImpl::discardUntilRequest()
@@ -89,6 +73,13 @@ void RibLexerImpl::pushInput(std::istream& inStream, const std::string& streamNa
     m_tokenizer.pushInput(inStream, streamName, callback);
 }
 
+void RibLexerImpl::pushInput(const char* begin, const char* end,
+                             const std::string& streamName,
+                             const CommentCallback& callback)
+{
+    m_tokenizer.pushInput(begin, end, streamName, callback);
+}
+
 void RibLexerImpl::popInput()
 {
     m_tokenizer.popInput();
@@ -151,6 +142,21 @@ const char* RibLexerImpl::getString()
     return storage.c_str();
 }
 
+/// Wrap an array buffer as an Ri::Array, counting its size.
+template<typename T>
+Ri::Array<T> RibLexerImpl::toRiArray(const std::vector<T>& v)
+{
+    if(v.empty())
+        return Ri::Array<T>();
+    m_arrayBytes += v.size()*sizeof(T);
+    return Ri::Array<T>(&v[0], v.size());
+}
+
+Ri::StringArray RibLexerImpl::toRiArray(MultiStringBuffer& buf)
+{
+    return toRiArray(buf.toCstringVec());
+}
+
 /* Functions for reading arrays.
  *
  * The code duplication between the get*Array() functions here is somewhat
@@ -267,6 +273,17 @@ RibLexer::StringArray RibLexerImpl::getStringArray()
     return toRiArray(buf);
 }
 
+boost::uint64_t RibLexerImpl::arrayBytes() const
+{
+    return m_arrayBytes;
+}
+
+bool RibLexerImpl::releaseFloatArray(const float* data, size_t size,
+                                     std::vector<float>& dest)
+{
+    return m_floatArrayPool.release(data, size, dest);
+}
+
 RibLexer::TokenType RibLexerImpl::peekNextType()
 {
     switch(m_tokenizer.peek().type())
@@ -39,7 +39,9 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
+#include <boost/cstdint.hpp>
 #include <boost/function.hpp>
 
 #include <aqsis/riutil/ricxx.h> // for array types.
@@ -182,6 +184,20 @@ class RibLexer
         virtual void pushInput(std::istream& inStream,
                 const std::string& streamName,
                 const CommentCallback& callback = CommentCallback()) = 0;
+        /** \brief Push a range of memory onto the input stack
+         *
+         * As above, but the RIB is scanned directly from memory, for
+         * instance from a memory-mapped file.  The memory must remain valid
+         * until the corresponding call to popInput().
+         *
+         * \param begin - start of the RIB characters
+         * \param end - one past the last RIB character
+         * \param streamName - name of the input stream
+         * \param commentCallback - callback function for handling comments
+         */
+        virtual void pushInput(const char* begin, const char* end,
+                const std::string& streamName,
+                const CommentCallback& callback = CommentCallback()) = 0;
         /** \brief Pop a stream off the input stack
          *
          * If the stream is the last on the input stack, the lexer reverts to
@@ -264,6 +280,18 @@ class RibLexer
         virtual StringArray getStringParam() = 0;
         //@}
 
+        /// Return the total size in bytes of all arrays read so far.
+        virtual boost::uint64_t arrayBytes() const = 0;
+
+        /// Transfer a float array of the current request to the caller.
+        ///
+        /// If data is the start of a float array of length size returned
+        /// since the last call to nextRequest(), the array storage is swapped
+        /// into dest and true is returned.  The lexer won't touch the data
+        /// again.
+        virtual bool releaseFloatArray(const float* data, size_t size,
+                                       std::vector<float>& dest) = 0;
+
         virtual ~RibLexer() {}
 };
 
@@ -64,6 +64,9 @@ class RibLexerImpl : public RibLexer
         virtual void pushInput(std::istream& inStream,
                                const std::string& streamName,
                                const CommentCallback& callback = CommentCallback());
+        virtual void pushInput(const char* begin, const char* end,
+                               const std::string& streamName,
+                               const CommentCallback& callback = CommentCallback());
         virtual void popInput();
 
         virtual const char* nextRequest();
@@ -80,6 +83,10 @@ class RibLexerImpl : public RibLexer
         virtual FloatArray getFloatParam();
         virtual StringArray getStringParam();
 
+        virtual boost::uint64_t arrayBytes() const;
+        virtual bool releaseFloatArray(const float* data, size_t size,
+                                       std::vector<float>& dest);
+
     private:
         /// \brief A pool of buffers into which RIB arrays will be read.
         ///
@@ -113,10 +120,34 @@ class RibLexerImpl : public RibLexer
                 }
                 /// Mark all buffers in the pool as unused.
                 void markUnused() { m_next = 0; }
+                /// Swap the storage of a buffer in use into dest.
+                ///
+                /// The buffer is found from the address and length of its
+                /// data.  It's left holding the previous contents of dest,
+                /// which will be cleared before the buffer is reused.
+                template<typename T>
+                bool release(const T* data, size_t size, BufferT& dest)
+                {
+                    for(size_t i = 0; i < m_next; ++i)
+                    {
+                        BufferT& buf = m_buffers[i];
+                        if(!buf.empty() && &buf[0] == data
+                           && buf.size() == size)
+                        {
+                            dest.swap(buf);
+                            return true;
+                        }
+                    }
+                    return false;
+                }
         };
 
         void tokenError(const char* expected, const RibToken& badTok);
 
+        template<typename T>
+        Ri::Array<T> toRiArray(const std::vector<T>& v);
+        Ri::StringArray toRiArray(MultiStringBuffer& buf);
+
         // Tokenizer object (a lower level lexer of sorts)
         RibTokenizer m_tokenizer;
 
@@ -125,6 +156,9 @@ class RibLexerImpl : public RibLexer
         BufferPool<std::vector<float> > m_floatArrayPool;
         BufferPool<std::vector<int> >   m_intArrayPool;
         BufferPool<MultiStringBuffer>   m_stringArrayPool;
+
+        /// Total size of the arrays returned from the lexer.
+        boost::uint64_t m_arrayBytes;
 };
 
 
@@ -134,6 +134,41 @@ BOOST_AUTO_TEST_CASE(RibLexerImpl_getFloatArray_test)
     BOOST_CHECK_THROW(f.lex.getFloatArray(), XqParseError);
 }
 
+BOOST_AUTO_TEST_CASE(RibLexerImpl_releaseFloatArray_test)
+{
+    Fixture f("Req [1 2 3] [4 5] Req [6]");
+
+    const float eps = 0.0001;
+
+    BOOST_CHECK_EQUAL(f.lex.nextRequest(), "Req");
+    RibLexer::FloatArray a1 = f.lex.getFloatArray();
+    RibLexer::FloatArray a2 = f.lex.getFloatArray();
+
+    // Arrays are only released when the address and length match.
+    std::vector<float> dest;
+    BOOST_CHECK(!f.lex.releaseFloatArray(a1.begin() + 1, 2, dest));
+    BOOST_CHECK(!f.lex.releaseFloatArray(a1.begin(), 2, dest));
+    BOOST_CHECK(dest.empty());
+
+    BOOST_REQUIRE(f.lex.releaseFloatArray(a2.begin(), a2.size(), dest));
+    BOOST_REQUIRE_EQUAL(dest.size(), 2U);
+    BOOST_CHECK_EQUAL(&dest[0], a2.begin());
+    BOOST_CHECK_CLOSE(dest[0], 4.0f, eps);
+    BOOST_CHECK_CLOSE(dest[1], 5.0f, eps);
+    // A released array can't be released a second time.
+    std::vector<float> dest2;
+    BOOST_CHECK(!f.lex.releaseFloatArray(a2.begin(), a2.size(), dest2));
+
+    // Arrays of previous requests can't be released, and reading the next
+    // request doesn't disturb the released data.
+    BOOST_CHECK_EQUAL(f.lex.nextRequest(), "Req");
+    RibLexer::FloatArray a3 = f.lex.getFloatArray();
+    BOOST_CHECK(!f.lex.releaseFloatArray(a1.begin(), a1.size(), dest2));
+    BOOST_CHECK_CLOSE(a3[0], 6.0f, eps);
+    BOOST_CHECK_CLOSE(dest[0], 4.0f, eps);
+    BOOST_CHECK_CLOSE(dest[1], 5.0f, eps);
+}
+
 BOOST_AUTO_TEST_CASE(RibLexerImpl_getStringArray_test)
 {
     Fixture f("[\"asdf\" \"1234\" \"!@#$\"] 123");
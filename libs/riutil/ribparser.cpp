@@ -38,6 +38,10 @@
 
 #include <cfloat>
 #include <cstring>  // for strcpy
+#include <fstream>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include "riblexer.h"
 #include <aqsis/riutil/errorhandler.h>
@@ -50,6 +54,23 @@ RibParser* RibParser::create(Ri::RendererServices& services)
     return new RibParserImpl(services);
 }
 
+//------------------------------------------------------------------------------
+// RibParserStats implementation
+
+RibParserStats::RibParserStats()
+    : requests(0),
+    arrayBytes(0),
+    timeRequests(false),
+    requestStats()
+{ }
+
+void RibParserStats::reset()
+{
+    requests = 0;
+    arrayBytes = 0;
+    requestStats.clear();
+}
+
 //------------------------------------------------------------------------------
 // RibParserImpl implementation
 
@@ -58,7 +79,9 @@ RibParserImpl::RibParserImpl(Ri::RendererServices& rendererServices)
     m_lex(RibLexer::create(), &RibLexer::destroy),
     m_requestHandlerMap(),
     m_paramListStorage(),
-    m_numColorComps(3)
+    m_numColorComps(3),
+    m_stats(0),
+    m_arrayBytesMark(0)
 {
     typedef HandlerMap::value_type MapValueType;
     MapValueType handlerMapInit[] = {
@@ -212,6 +235,66 @@ void RibParserImpl::parseStream(std::istream& ribStream,
                             Ri::Renderer& renderer)
 {
     m_lex->pushInput(ribStream, streamName, CommentCallback(renderer));
+    parseInput(renderer);
+}
+
+bool RibParserImpl::parseFile(const std::string& fileName,
+                              const std::string& streamName,
+                              Ri::Renderer& renderer)
+{
+    // Map the file into memory so that the lexer can scan it in place.
+    // Mapping fails for empty files and for special files like pipes; these
+    // are read through an ordinary stream instead.
+    boost::iostreams::mapped_file_source mappedFile;
+    try
+    {
+        mappedFile.open(fileName);
+    }
+    catch(std::exception& /*e*/)
+    { }
+    if(mappedFile.is_open())
+    {
+        m_lex->pushInput(mappedFile.data(),
+                         mappedFile.data() + mappedFile.size(),
+                         streamName, CommentCallback(renderer));
+        parseInput(renderer);
+        return true;
+    }
+    std::ifstream ribFile(fileName.c_str(), std::ios::binary);
+    if(!ribFile)
+        return false;
+    parseStream(ribFile, streamName, renderer);
+    return true;
+}
+
+/// Default implementation of RendererServices::parseRibFile(), for services
+/// which don't have a RibParser of their own to read the file with.
+bool Ri::RendererServices::parseRibFile(const char* fileName, const char* name,
+                                        Renderer& context)
+{
+    std::ifstream ribFile(fileName, std::ios::binary);
+    if(!ribFile)
+        return false;
+    parseRib(ribFile, name, context);
+    return true;
+}
+
+void RibParserImpl::setStats(RibParserStats* stats)
+{
+    m_stats = stats;
+    m_arrayBytesMark = m_lex->arrayBytes();
+}
+
+bool RibParserImpl::releaseFloatArray(const float* data, size_t size,
+                                      std::vector<float>& dest)
+{
+    return m_lex->releaseFloatArray(data, size, dest);
+}
+
+/// Parse requests from the top of the lexer input stack until it's exhausted,
+/// then pop the input.
+void RibParserImpl::parseInput(Ri::Renderer& renderer)
+{
     while(true)
     {
         const char* requestName = 0;
@@ -226,7 +309,31 @@ void RibParserImpl::parseStream(std::istream& ribStream,
                 AQSIS_THROW_XQERROR(XqParseError, EqE_BadToken,
                                     "unrecognized request");
             RequestHandlerType handler = pos->second;
-            (this->*handler)(renderer);
+            if(m_stats)
+            {
+                ++m_stats->requests;
+                if(m_stats->timeRequests)
+                {
+                    RibParserStats::Request& reqStats =
+                        m_stats->requestStats[pos->first];
+                    ++reqStats.count;
+                    boost::posix_time::ptime startTime =
+                        boost::posix_time::microsec_clock::universal_time();
+                    (this->*handler)(renderer);
+                    reqStats.time += 1e-6*(
+                        boost::posix_time::microsec_clock::universal_time()
+                        - startTime).total_microseconds();
+                }
+                else
+                    (this->*handler)(renderer);
+                // Use a running mark so that arrays read by nested parsing
+                // of archives aren't counted twice.
+                boost::uint64_t arrayBytes = m_lex->arrayBytes();
+                m_stats->arrayBytes += arrayBytes - m_arrayBytesMark;
+                m_arrayBytesMark = arrayBytes;
+            }
+            else
+                (this->*handler)(renderer);
         }
         catch(XqException& e)
         {
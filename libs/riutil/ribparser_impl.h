@@ -62,6 +62,12 @@ class RibParserImpl : public RibParser
         virtual void parseStream(std::istream& ribStream,
                                  const std::string& streamName,
                                  Ri::Renderer& context);
+        virtual bool parseFile(const std::string& fileName,
+                               const std::string& streamName,
+                               Ri::Renderer& context);
+        virtual void setStats(RibParserStats* stats);
+        virtual bool releaseFloatArray(const float* data, size_t size,
+                                       std::vector<float>& dest);
 
     private:
         /// Request handler function type
@@ -69,6 +75,8 @@ class RibParserImpl : public RibParser
         /// Request -> handler mapping type
         typedef std::map<std::string, RequestHandlerType> HandlerMap;
 
+        void parseInput(Ri::Renderer& renderer);
+
         Ri::ParamList readParamList();
         RtConstBasis& getBasis();
 
@@ -209,6 +217,11 @@ class RibParserImpl : public RibParser
 
         /// Number of color components
         int m_numColorComps;
+
+        /// Statistics counters, or null if statistics aren't collected.
+        RibParserStats* m_stats;
+        /// Array bytes read by the lexer when m_stats was last updated.
+        boost::uint64_t m_arrayBytesMark;
 };
 
 } // namespace Aqsis
@@ -1151,6 +1151,28 @@ BOOST_AUTO_TEST_CASE(invalid_paramlist_missing_token)
     );
 }
 
+BOOST_AUTO_TEST_CASE(parser_stats_test)
+{
+    RibParserStats stats;
+    stats.timeRequests = true;
+    {
+        Fixture f;
+        f.parser.setStats(&stats);
+        f << Req("Option") << "some_option_name"
+            << "uniform int asdf" << std::vector<int>(10, 42)
+            << "uniform float user_f" << std::vector<float>(3, 2.5f);
+    }
+    BOOST_CHECK_EQUAL(stats.requests, 1);
+    BOOST_CHECK_EQUAL(stats.arrayBytes, 10*sizeof(int) + 3*sizeof(float));
+    BOOST_REQUIRE_EQUAL(stats.requestStats.size(), 1U);
+    BOOST_CHECK_EQUAL(stats.requestStats["Option"].count, 1);
+    BOOST_CHECK_GE(stats.requestStats["Option"].time, 0);
+    stats.reset();
+    BOOST_CHECK_EQUAL(stats.requests, 0);
+    BOOST_CHECK(stats.requestStats.empty());
+    BOOST_CHECK(stats.timeRequests);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 // vi: set et:
@@ -71,8 +71,240 @@ struct RibTokenizer::InputState
 		haveNext(haveNext),
 		commentCallback(callback)
 	{ }
+
+	InputState(const char* begin, const char* end,
+			const std::string& streamName,
+			const SourcePos& currPos, const SourcePos& nextPos,
+			const RibToken& nextTok, bool haveNext,
+			const CommentCallback& callback)
+		: inBuf(begin, end, streamName),
+		currPos(currPos),
+		nextPos(nextPos),
+		nextTok(nextTok),
+		haveNext(haveNext),
+		commentCallback(callback)
+	{ }
 };
 
+namespace {
+
+typedef RibInputBuffer::CharType CharType;
+
+inline bool isDigit(CharType c)
+{
+	return c >= '0' && c <= '9';
+}
+
+inline bool isWhitespace(CharType c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/// Return true if c may appear as part of a request name.
+inline bool isRequestChar(CharType c)
+{
+	// c must be in the 7-bit ASCII character set, and not be whitespace or a
+	// special char.
+	if(c >= 0200)
+		return false;
+	switch(c)
+	{
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case '#':
+		case '"':
+		case '[':
+		case ']':
+			return false;
+		default:
+			return true;
+	}
+}
+
+/// Return true if c may be copied into a string token without translation.
+inline bool isPlainStringChar(CharType c)
+{
+	return c != '"' && c != '\\' && c != '\r' && c != RibInputBuffer::eof;
+}
+
+/** \brief Character source scanning directly over a range of buffered chars.
+ *
+ * Has the same get()/unget() interface as RibInputBuffer, but records
+ * whether the end of the range was reached, in which case whatever was being
+ * scanned may continue beyond the buffered characters.
+ */
+struct BufferedChars
+{
+	const CharType* pos;
+	const CharType* end;
+	bool hitEnd;
+
+	BufferedChars(const CharType* begin, const CharType* end)
+		: pos(begin), end(end), hitEnd(false) {}
+	CharType get()
+	{
+		if(pos < end)
+			return *pos++;
+		hitEnd = true;
+		return RibInputBuffer::eof;
+	}
+	void unget()
+	{
+		if(!hitEnd)
+			--pos;
+	}
+};
+
+/** \brief Convert a decimal mantissa and exponent into the nearest float.
+ *
+ * When both the mantissa and the power of ten are exactly representable the
+ * result is computed with a single correctly rounded multiply or divide.
+ * Only very long mantissas or large exponents need the inexact fallback.
+ */
+float decimalToFloat(boost::uint64_t mantissa, int exponent)
+{
+	static const float floatPow10[] = {
+		1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+	};
+	static const double doublePow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	if(mantissa <= (boost::uint64_t(1) << 24) && exponent >= -10 && exponent <= 10)
+	{
+		float m = static_cast<float>(mantissa);
+		return exponent < 0 ? m / floatPow10[-exponent] : m * floatPow10[exponent];
+	}
+	if(mantissa <= (boost::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double m = static_cast<double>(mantissa);
+		return static_cast<float>(exponent < 0 ? m / doublePow10[-exponent]
+		                                       : m * doublePow10[exponent]);
+	}
+	return static_cast<float>(mantissa * std::pow(10.0, exponent));
+}
+
+/** \brief Read in an ASCII number (integer or real)
+ *
+ * The decimal digits are accumulated exactly into an integer mantissa and
+ * converted with decimalToFloat() at the end.
+ */
+template<typename CharSourceT>
+void scanNumber(CharSourceT& in, RibToken& tok)
+{
+	// Mantissa digits beyond this are dropped, since they can't affect the
+	// float result.
+	const boost::uint64_t maxMantissa = boost::uint64_t(1000000000)*100000000;
+	CharType c = 0;
+	bool negative = false;
+	int intResult = 0;
+	boost::uint64_t mantissa = 0;
+	int exponent = 0;
+	bool haveReadDigit = false;
+	c = in.get();
+	// deal with optional sign
+	switch(c)
+	{
+		case '+':
+			c = in.get();
+			break;
+		case '-':
+			negative = true;
+			c = in.get();
+			break;
+	}
+	// deal with digits before decimal point
+	if(isDigit(c))
+		haveReadDigit = true;
+	while(isDigit(c))
+	{
+		// The int result is allowed to overflow; the mantissa is robust
+		// against it.
+		intResult = 10*intResult + (c - '0');
+		if(mantissa < maxMantissa)
+			mantissa = 10*mantissa + (c - '0');
+		else
+			++exponent;
+		c = in.get();
+	}
+	switch(c)
+	{
+		case '.':
+			{
+				// deal with digits to right of decimal point
+				c = in.get();
+				if(!haveReadDigit && !isDigit(c))
+				{
+					tok.error("Expected at least one digit in float");
+					return;
+				}
+				while(isDigit(c))
+				{
+					if(mantissa < maxMantissa)
+					{
+						mantissa = 10*mantissa + (c - '0');
+						--exponent;
+					}
+					c = in.get();
+				}
+				if(c != 'e' && c != 'E')
+				{
+					in.unget();
+					float result = decimalToFloat(mantissa, exponent);
+					tok = negative ? -result : result;
+					return;
+				}
+			}
+			break;
+		case 'e':
+		case 'E':
+			break;
+		default:
+			// Number is an integer
+			if(!haveReadDigit)
+			{
+				tok.error("Expected a digit");
+				return;
+			}
+			in.unget();
+			tok = negative ? -intResult : intResult;
+			return;
+	}
+	// deal with the exponent
+	c = in.get();
+	bool negativeExp = false;
+	switch(c)
+	{
+		case '+':
+			c = in.get();
+			break;
+		case '-':
+			negativeExp = true;
+			c = in.get();
+			break;
+	}
+	if(!isDigit(c))
+	{
+		tok.error("Expected digits in float exponent");
+		return;
+	}
+	int explicitExp = 0;
+	while(isDigit(c))
+	{
+		if(explicitExp < 100000)
+			explicitExp = 10*explicitExp + (c - '0');
+		c = in.get();
+	}
+	in.unget();
+	exponent += negativeExp ? -explicitExp : explicitExp;
+	float result = decimalToFloat(mantissa, exponent);
+	tok = negative ? -result : result;
+}
+
+} // anon. namespace
+
 //-------------------------------------------------------------------------------
 // RibTokenizer implementation
 
@@ -102,6 +334,19 @@ void RibTokenizer::pushInput(std::istream& inStream, const std::string& streamNa
 	m_commentCallback = callback;
 }
 
+void RibTokenizer::pushInput(const char* begin, const char* end,
+		const std::string& streamName, const CommentCallback& callback)
+{
+	m_inputStack.push( boost::shared_ptr<InputState>(
+				new InputState(begin, end, streamName, m_currPos, m_nextPos,
+					m_nextTok, m_haveNext, m_commentCallback)) );
+	m_inBuf = &m_inputStack.top()->inBuf;
+	m_currPos = SourcePos(1,1);
+	m_nextPos = SourcePos(1,1);
+	m_haveNext = false;
+	m_commentCallback = callback;
+}
+
 void RibTokenizer::popInput()
 {
 	assert(!m_inputStack.empty());
@@ -162,8 +407,16 @@ void RibTokenizer::scanNext(RibToken& tok)
 	// and comments.
 	while(true)
 	{
+		// Skip over buffered whitespace in bulk.
+		const CharType* p = m_inBuf->bufBegin();
+		const CharType* end = m_inBuf->bufEnd();
+		while(p < end && isWhitespace(*p))
+			++p;
+		m_inBuf->skipTo(p);
 		RibInputBuffer::CharType c = m_inBuf->get();
-		m_nextPos = m_inBuf->pos();
+		// The source position is only needed where a token starts.
+		if(!isWhitespace(c))
+			m_nextPos = m_inBuf->pos();
 		switch(c)
 		{
 			//------------------------------------------------------------
@@ -354,111 +607,24 @@ void RibTokenizer::scanNext(RibToken& tok)
 	}
 }
 
-/// Read in an ASCII number (integer or real)
+/** \brief Read in an ASCII number (integer or real)
+ *
+ * Numbers lying entirely within the buffered characters are scanned directly
+ * from the buffer, which is the usual case for all but the last few
+ * characters of a stream.
+ */
 void RibTokenizer::readNumber(RibInputBuffer& inBuf, RibToken& tok)
 {
-	RibInputBuffer::CharType c = 0;
-	int sign = 1;
-	int intResult = 0;
-	float floatResult = 0;
-	bool haveReadDigit = false;
-	c = inBuf.get();
-	// deal with optional sign
-	switch(c)
-	{
-		case '+':
-			c = inBuf.get();
-			break;
-		case '-':
-			sign = -1;
-			c = inBuf.get();
-			break;
-	}
-	// deal with digits before decimal point
-	if(std::isdigit(c))
-		haveReadDigit = true;
-	// \todo: Think of a better way to handle the overflow below robustly?
-	while(std::isdigit(c))
-	{
-		intResult *= 10;
-		intResult += c - '0';
-		// this duplication seems like a waste, but it's robust against overflow...
-		floatResult *= 10;
-		floatResult += c - '0';
-		c = inBuf.get();
-	}
-	switch(c)
-	{
-		case '.':
-			{
-				// deal with digits to right of decimal point
-				c = inBuf.get();
-				if(!haveReadDigit && !std::isdigit(c))
-				{
-					tok.error("Expected at least one digit in float");
-					return;
-				}
-				float thisPlaceVal = 0.1;
-				while(std::isdigit(c))
-				{
-					floatResult += (c - '0') * thisPlaceVal;
-					thisPlaceVal *= 0.1;
-					c = inBuf.get();
-				}
-				floatResult *= sign;
-				if(c != 'e' && c != 'E')
-				{
-					inBuf.unget();
-					tok = floatResult;
-					return;
-				}
-			}
-			break;
-		case 'e':
-		case 'E':
-			floatResult *= sign;
-			break;
-		default:
-			// Number is an integer
-			intResult *= sign;
-			if(!haveReadDigit)
-			{
-				tok.error("Expected a digit");
-				return;
-			}
-			inBuf.unget();
-			tok = intResult;
-			return;
-	}
-	// deal with the exponent
-	c = inBuf.get();
-	sign = 1;
-	switch(c)
-	{
-		case '+':
-			c = inBuf.get();
-			break;
-		case '-':
-			sign = -1;
-			c = inBuf.get();
-			break;
-	}
-	if(!std::isdigit(c))
+	BufferedChars bufChars(inBuf.bufBegin(), inBuf.bufEnd());
+	scanNumber(bufChars, tok);
+	if(!bufChars.hitEnd)
 	{
-		tok.error("Expected digits in float exponent");
+		inBuf.skipTo(bufChars.pos);
 		return;
 	}
-	int exponent = 0;
-	while(std::isdigit(c))
-	{
-		exponent *= 10;
-		exponent += c - '0';
-		c = inBuf.get();
-	}
-	exponent *= sign;
-	inBuf.unget();
-	floatResult *= std::pow(10.0,exponent);
-	tok = floatResult;
+	// The number may continue past the buffered characters; rescan it one
+	// character at a time.
+	scanNumber(inBuf, tok);
 }
 
 /** \brief Read in a string
@@ -474,6 +640,14 @@ void RibTokenizer::readString(RibInputBuffer& inBuf, RibToken& tok)
 	bool stringFinished = false;
 	while(!stringFinished)
 	{
+		// Copy runs of ordinary characters straight from the buffer.
+		const CharType* begin = inBuf.bufBegin();
+		const CharType* end = inBuf.bufEnd();
+		const CharType* p = begin;
+		while(p < end && isPlainStringChar(*p))
+			++p;
+		outString.append(begin, p);
+		inBuf.skipTo(p);
 		RibInputBuffer::CharType c = inBuf.get();
 		switch(c)
 		{
@@ -519,32 +693,20 @@ void RibTokenizer::readRequest(RibInputBuffer& inBuf, RibToken& tok)
 	tok = RibToken::REQUEST;
 	std::string& name = tok.m_strVal;
 	name.clear();
+	// Take the request name straight from the buffer where possible.
+	const CharType* begin = inBuf.bufBegin();
+	const CharType* end = inBuf.bufEnd();
+	const CharType* p = begin;
+	while(p < end && isRequestChar(*p))
+		++p;
+	name.append(begin, p);
+	inBuf.skipTo(p);
+	if(p < end)
+		return;
 	while(true)
 	{
 		RibInputBuffer::CharType c = inBuf.get();
-		bool acceptChar = false;
-		// Check that
-		// 1. c is in the 7-bit ASCII character set.
-		if(c >= 0 && c < 0200)
-		{
-			// 2. c is not whitespace or a special char
-			switch(c)
-			{
-				case ' ':
-				case '\t':
-				case '\n':
-				case '\r':
-				case '#':
-				case '"':
-				case '[':
-				case ']':
-					break;
-				default:
-					acceptChar = true;
-			}
-		}
-		// if it's anything else, c continues the request.
-		if(acceptChar)
+		if(isRequestChar(c))
 			name += c;
 		else
 		{
@@ -93,6 +93,21 @@ class RibTokenizer : boost::noncopyable
 		 */
 		void pushInput(std::istream& inStream, const std::string& streamName,
 				const CommentCallback& callback = CommentCallback());
+		/** \brief Push a range of memory onto the input stack
+		 *
+		 * The characters are scanned in place, so they must remain valid
+		 * until the corresponding popInput().  This is the fast path for
+		 * memory-mapped RIB files.
+		 *
+		 * \param begin - start of the RIB characters
+		 * \param end - one past the last RIB character
+		 * \param streamName - Name of the stream, used for error messages.
+		 * \param callback - Callback function used when the lexer encounters a
+		 *                   comment token.
+		 */
+		void pushInput(const char* begin, const char* end,
+				const std::string& streamName,
+				const CommentCallback& callback = CommentCallback());
 		/** \brief Pop a stream off the input stack
 		 *
 		 * If the stream is the last on the input stack, the lexer reverts to
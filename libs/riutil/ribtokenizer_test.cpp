@@ -153,6 +153,21 @@ BOOST_AUTO_TEST_CASE(RibTokenizer_float_test)
 	CHECK_EOF(f.t);
 }
 
+BOOST_AUTO_TEST_CASE(RibTokenizer_float_rounding_test)
+{
+	// Floats should be the nearest representable value to the decimal
+	// string.
+	TokenizerFixture f("0.3 0.1234567 16777217.0 3.4028234e38 1.17549435e-38 "
+			"0.000000000000000000001 12345678901234567890.5");
+	float floats[] = {
+		0.3f, 0.1234567f, 16777217.0f, 3.4028234e38f, 1.17549435e-38f,
+		0.000000000000000000001f, 12345678901234567890.5f
+	};
+	for(int i = 0; i < static_cast<int>(sizeof(floats)/sizeof(floats[0])); ++i)
+		BOOST_CHECK_EQUAL(f.t.get(), RibToken(floats[i]));
+	CHECK_EOF(f.t);
+}
+
 BOOST_AUTO_TEST_CASE(RibTokenizer_array_test)
 {
 	TokenizerFixture f("[ 1.0 -1 ]");
@@ -397,6 +412,29 @@ BOOST_AUTO_TEST_CASE(RibTokenizer_streamstack_test)
 	CHECK_EOF(lex);
 }
 
+BOOST_AUTO_TEST_CASE(RibTokenizer_memory_input_test)
+{
+	// Tokens read directly from memory should match those read from a
+	// stream, including at the very end of the input.
+	const std::string inStr("Rqst [1.0\n 1] \"asdf\" -2.5e3 Rq2 42");
+	RibTokenizer lex;
+	lex.pushInput(inStr.data(), inStr.data() + inStr.size(), "memory");
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(RibToken::REQUEST, "Rqst"));
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(RibToken::ARRAY_BEGIN));
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(1.0f));
+	BOOST_CHECK_EQUAL(lex.streamPos(), "memory:1 (col 7)");
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(1));
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(RibToken::ARRAY_END));
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(RibToken::STRING, "asdf"));
+	BOOST_CHECK_EQUAL(lex.streamPos(), "memory:2 (col 5)");
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(-2.5e3f));
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(RibToken::REQUEST, "Rq2"));
+	BOOST_CHECK_EQUAL(lex.get(), RibToken(42));
+	CHECK_EOF(lex);
+	lex.popInput();
+	CHECK_EOF(lex);
+}
+
 struct MockCommentCallback
 {
 	std::string str;
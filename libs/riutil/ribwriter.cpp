@@ -42,10 +42,12 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 
 #ifdef USE_GZIPPED_RIB
 #   include <boost/iostreams/filtering_stream.hpp>
 #   include <boost/iostreams/filter/gzip.hpp>
+#   include "gzipblocks.h"
 #endif
 #include <boost/cstdint.hpp>
 
@@ -208,6 +210,10 @@ class BinaryFormatter
         typedef std::map<std::string, TqUint8> EncodedRequestMap;
         EncodedRequestMap m_encodedRequests;
         TqUint8 m_currRequestCode;
+        /// Buffer for encoding arrays before they're written.
+        std::vector<char> m_arrayBuf;
+        /// Flag indicating that primvars should be quantised.
+        bool m_quantiseFloats;
 
         // Unpack MSB into c[0], down to LSB into c[3]
         //
@@ -231,21 +237,66 @@ class BinaryFormatter
             return 0;
         }
 
-        // Encode an unsigned int32, i to the stream
+        // Encode an unsigned int32, i into dest, returning the end of the
+        // encoded bytes.
         //
         // baseCode is the binary RIB prefix code to use.
-        void encodeInt32(TqUint32 i, TqUint8 baseCode)
+        static inline char* encodeInt32(TqUint32 i, TqUint8 baseCode,
+                                        char* dest)
         {
             char c[4];
             unpack(i, c);
             int high = highestByteNonzero(c);
-            m_out.put(baseCode + high);
-            m_out.write(c+3-high, high+1);
+            *dest++ = baseCode + high;
+            for(int j = 3-high; j < 4; ++j)
+                *dest++ = c[j];
+            return dest;
+        }
+
+        // Encode an unsigned int32, i to the stream
+        void encodeInt32(TqUint32 i, TqUint8 baseCode)
+        {
+            char c[5];
+            m_out.write(c, encodeInt32(i, baseCode, c) - c);
+        }
+
+        // Round the bits of a float to the nearest value with the 11 bit
+        // significand of a half precision float.
+        //
+        // The exponent range is left alone, so values are still transmitted
+        // as 32-bit floats which any RIB reader understands, but the zeroed
+        // low bits compress much better.
+        static inline TqUint32 quantiseFloatBits(TqUint32 bits)
+        {
+            const TqUint32 expMask = 0x7F800000;
+            if((bits & expMask) == expMask)
+                return bits; // inf or nan
+            // Round to nearest, ties to even.
+            TqUint32 q = (bits + 0x0FFF + ((bits >> 13) & 1)) & ~TqUint32(0x1FFF);
+            return (q & expMask) == expMask ? bits : q;
+        }
+
+        // Encode a float array with the binary array prefix, writing it to
+        // the stream in one go.
+        void encodeFloatArray(const Ri::FloatArray& a, bool quantise)
+        {
+            encodeInt32(a.size(), 0310);
+            if(a.size() == 0)
+                return;
+            m_arrayBuf.resize(4*a.size());
+            char* c = &m_arrayBuf[0];
+            for(size_t i = 0; i < a.size(); ++i, c += 4)
+            {
+                TqUint32 bits = union_cast<TqUint32>(a[i]);
+                unpack(quantise ? quantiseFloatBits(bits) : bits, c);
+            }
+            m_out.write(&m_arrayBuf[0], m_arrayBuf.size());
         }
 
     public:
         BinaryFormatter(std::ostream& out, const RibWriterOptions& opts)
-            : m_out(out), m_encodedRequests(), m_currRequestCode(0) { }
+            : m_out(out), m_encodedRequests(), m_currRequestCode(0),
+            m_arrayBuf(), m_quantiseFloats(opts.quantiseFloats) { }
 
         void increaseIndent() { }
         void decreaseIndent() { }
@@ -320,13 +371,21 @@ class BinaryFormatter
 
         void print(const Ri::FloatArray& a)
         {
-            encodeInt32(a.size(), 0310);
+            encodeFloatArray(a, false);
+        }
+
+        void print(const Ri::IntArray& a)
+        {
+            // There's no array encoding for integers, so the elements are
+            // written as individual tokens, but buffered to save the
+            // per-token stream overhead.
+            m_arrayBuf.resize(2 + 5*a.size());
+            char* c = &m_arrayBuf[0];
+            *c++ = '[';
             for(size_t i = 0; i < a.size(); ++i)
-            {
-                char c[4];
-                unpack(union_cast<TqUint32>(a[i]), c);
-                m_out.write(c, 4);
-            }
+                c = encodeInt32(a[i], 0200, c);
+            *c++ = ']';
+            m_out.write(&m_arrayBuf[0], c - &m_arrayBuf[0]);
         }
 
         void printTriple(const float* f)
@@ -340,6 +399,14 @@ class BinaryFormatter
             print(token);
             print(a);
         }
+
+        void printParam(const char* token, const Ri::FloatArray& a)
+        {
+            // Only primitive variables are quantised; matrices and the like
+            // are always written at full precision.
+            print(token);
+            encodeFloatArray(a, m_quantiseFloats);
+        }
 };
 
 
@@ -586,6 +653,14 @@ class RibWriterServicesImpl : public RibWriterServices
                 m_parser.reset(RibParser::create(*this));
             m_parser->parseStream(ribStream, name, context);
         }
+
+        virtual bool parseRibFile(const char* fileName, const char* name,
+                                  Ri::Renderer& context)
+        {
+            if(!m_parser)
+                m_parser.reset(RibParser::create(*this));
+            return m_parser->parseFile(fileName, name, context);
+        }
 };
 
 
@@ -631,12 +706,14 @@ class RibWriter : public Ri::Renderer
                 catch(XqValidation&)
                 { }
                 const char* token = param.name();
-                std::ostringstream fmt;
+                std::string inlineDecl;
                 if(useInlineDecl)
                 {
                     // Format inline declarations.
+                    std::ostringstream fmt;
                     fmt << CqPrimvarToken(param.spec(), param.name());
-                    token = fmt.str().c_str();
+                    inlineDecl = fmt.str();
+                    token = inlineDecl.c_str();
                 }
                 switch(param.spec().storageType())
                 {
@@ -672,11 +749,17 @@ class RibWriter : public Ri::Renderer
         }
 
         /// Allocate a gzip stream filter, if desired.
-        static boost::shared_ptr<std::ostream> setupGzipStream(std::ostream& out, bool useGzip)
+        static boost::shared_ptr<std::ostream> setupGzipStream(std::ostream& out,
+                const RibWriterOptions& opts)
         {
-            if(!useGzip)
+            if(!opts.useGzip)
                 return boost::shared_ptr<std::ostream>();
 #           ifdef USE_GZIPPED_RIB
+            if(opts.useGzipBlocks)
+            {
+                return boost::shared_ptr<std::ostream>(
+                    createGzipBlockStream(out, opts.compressionThreads));
+            }
             namespace io = boost::iostreams;
             boost::shared_ptr<io::filtering_stream<io::output> > gzipStream(
                 new io::filtering_stream<io::output>());
@@ -693,7 +776,7 @@ class RibWriter : public Ri::Renderer
     public:
         RibWriter(RibWriterServicesImpl& services, std::ostream& out,
                   const RibWriterOptions& opts)
-            : m_gzipStream(setupGzipStream(out, opts.useGzip)),
+            : m_gzipStream(setupGzipStream(out, opts)),
             m_formatter(opts.useGzip ? *m_gzipStream : out, opts),
             m_interpolateArchives(opts.interpolateArchives),
             m_handleProcedurals(opts.handleProcedurals),
@@ -976,14 +1059,8 @@ RtVoid RibWriter<Formatter>::ReadArchive(RtConstToken name,
         // message and fall back to emitting the ReadArchive call.
         boostfs::path path = findFileNothrow(name, m_archiveSearchPath);
         if(!path.empty())
-        {
-            std::ifstream inputFile(native(path).c_str());
-            if(inputFile)
-            {
-                m_services.parseRib(inputFile, name, m_services.firstFilter());
-                didRead = true;
-            }
-        }
+            didRead = m_services.parseRibFile(native(path).c_str(), name,
+                                              m_services.firstFilter());
         if(!didRead)
         {
             Aqsis::log() << Aqsis::error << "could not ReadArchive file \""
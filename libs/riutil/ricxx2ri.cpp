@@ -1578,6 +1578,14 @@ void RiCxxToRiServices::parseRib(std::istream& ribStream, const char* name,
     m_parser->parseStream(ribStream, name, context);
 }
 
+bool RiCxxToRiServices::parseRibFile(const char* fileName, const char* name,
+                                     Ri::Renderer& context)
+{
+    if(!m_parser)
+        m_parser.reset(RibParser::create(*this));
+    return m_parser->parseFile(fileName, name, context);
+}
+
 
 } // namespace Aqsis
 // vi: set et:
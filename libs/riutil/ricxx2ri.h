@@ -84,6 +84,8 @@ class RiCxxToRiServices : public Ri::RendererServices
 
         virtual void parseRib(std::istream& ribStream, const char* name,
                               Ri::Renderer& context);
+        virtual bool parseRibFile(const char* fileName, const char* name,
+                                  Ri::Renderer& context);
 
     private:
         /// Converter from Ri::Renderer to the C API
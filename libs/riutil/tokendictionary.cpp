@@ -146,6 +146,9 @@ const CqPrimvarToken standardVarsInit[] = {
 	// Option "limits"
 	CqPrimvarToken(class_uniform,  type_integer, 1, "gridsize"),
 	CqPrimvarToken(class_uniform,  type_integer, 1, "texturememory"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "archivememory"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "archivethreads"),
+	CqPrimvarToken(class_uniform,  type_integer, 1, "runprogramprocesses"),
 	CqPrimvarToken(class_uniform,  type_integer, 2, "bucketsize"),
 	CqPrimvarToken(class_uniform,  type_integer, 1, "eyesplits"),
 	CqPrimvarToken(class_uniform,  type_color,   1, "zthreshold"),
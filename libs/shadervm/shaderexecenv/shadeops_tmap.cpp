@@ -376,6 +376,7 @@ void CqShaderExecEnv::SO_ftexture2(IqShaderData* name, IqShaderData* s, IqShader
 	name->GetString(mapName, gridIdx);
 	const IqTextureSampler& texSampler
 		= getRenderContext()->textureCache().findTextureSampler(mapName.c_str());
+	getRenderContext()->textureCache().recordTextureUse(pShader, texSampler);
 
 	// Create new sample options to sample the texture with.
 	CqTextureSampleOptions sampleOpts = texSampler.defaultSampleOptions();
@@ -428,6 +429,7 @@ void CqShaderExecEnv::SO_ftexture3( IqShaderData* name, IqShaderData* s1, IqShad
 	name->GetString(mapName, gridIdx);
 	const IqTextureSampler& texSampler
 		= getRenderContext()->textureCache().findTextureSampler(mapName.c_str());
+	getRenderContext()->textureCache().recordTextureUse(pShader, texSampler);
 
 	// Create new sample options to sample the texture with.
 	CqTextureSampleOptions sampleOpts = texSampler.defaultSampleOptions();
@@ -491,6 +493,7 @@ void CqShaderExecEnv::SO_ctexture2( IqShaderData* name, IqShaderData* s, IqShade
 	name->GetString(mapName, gridIdx);
 	const IqTextureSampler& texSampler
 		= getRenderContext()->textureCache().findTextureSampler(mapName.c_str());
+	getRenderContext()->textureCache().recordTextureUse(pShader, texSampler);
 
 	// Create new sample options to sample the texture with.
 	CqTextureSampleOptions sampleOpts = texSampler.defaultSampleOptions();
@@ -544,6 +547,7 @@ void CqShaderExecEnv::SO_ctexture3( IqShaderData* name, IqShaderData* s1, IqShad
 	name->GetString(mapName, gridIdx);
 	const IqTextureSampler& texSampler
 		= getRenderContext()->textureCache().findTextureSampler(mapName.c_str());
+	getRenderContext()->textureCache().recordTextureUse(pShader, texSampler);
 
 	// Create new sample options to sample the texture with.
 	CqTextureSampleOptions sampleOpts = texSampler.defaultSampleOptions();
@@ -103,6 +103,10 @@ class AQSIS_SHADERVM_SHARE CqShaderExecEnv : public IqShaderExecEnv, boost::nonc
 		{
 			return m_diff;
 		}
+		virtual void SetVStripRes( TqInt vStripRes )
+		{
+			m_diff.setVStripRes( vStripRes );
+		}
 		virtual void SetCurrentSurface(IqSurface* pEnv)
 		{
 			m_pCurrentSurface = pEnv;
@@ -1,6 +1,8 @@
 set(buffers_srcs
 	imagechannel.cpp
 	mixedimagebuffer.cpp
+	tileprefetcher.cpp
+	visibilityfunction.cpp
 )
 make_absolute(buffers_srcs ${buffers_SOURCE_DIR})
 
@@ -8,5 +10,7 @@ set(buffers_test_srcs
 	channellist_test.cpp
 	imagechannel_test.cpp
 	mixedimagebuffer_test.cpp
+	tileprefetcher_test.cpp
+	visibilityfunction_test.cpp
 )
 make_absolute(buffers_test_srcs ${buffers_SOURCE_DIR})
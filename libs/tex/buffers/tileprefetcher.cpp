@@ -0,0 +1,264 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Background reading of texture tiles - implementation.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#include <aqsis/tex/buffers/tileprefetcher.h>
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+/// State for a submitted read.
+class CqTilePrefetcher::CqRequest
+{
+	public:
+		enum EqState
+		{
+			State_Queued,
+			State_Running,
+			State_Done
+		};
+
+		CqRequest(const TqReadFunc& read)
+			: m_read(read),
+			m_state(State_Queued),
+			m_succeeded(false)
+		{ }
+
+		/// Run the read function, noting whether it succeeded.
+		void run()
+		{
+			try
+			{
+				m_read();
+				m_succeeded = true;
+			}
+			catch(...)
+			{
+				// The error will be reported when the tile is read again by
+				// the thread which needs it.
+				m_succeeded = false;
+			}
+			m_read.clear();
+		}
+
+		TqReadFunc m_read;
+		EqState m_state;
+		bool m_succeeded;
+};
+
+namespace {
+
+/// Number of mutexes used to serialize access to texture files.
+const TqInt numFileMutexes = 16;
+boost::mutex g_fileMutexes[numFileMutexes];
+
+/// The pool of I/O threads behind CqTilePrefetcher.
+class CqIoThreadPool : private boost::noncopyable
+{
+	public:
+		CqIoThreadPool()
+			: m_threads(),
+			m_queue(),
+			m_numThreads(0),
+			m_stopping(false)
+		{ }
+
+		~CqIoThreadPool()
+		{
+			setNumThreads(0);
+		}
+
+		void setNumThreads(TqInt numThreads)
+		{
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+				if(numThreads == m_numThreads)
+					return;
+				m_stopping = true;
+			}
+			// Let the current threads drain the queue and exit.
+			m_workAvailable.notify_all();
+			if(m_threads)
+				m_threads->join_all();
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_stopping = false;
+			m_numThreads = numThreads;
+			m_threads.reset(new boost::thread_group());
+			for(TqInt i = 0; i < numThreads; ++i)
+				m_threads->create_thread(boost::bind(&CqIoThreadPool::work, this));
+		}
+
+		bool enabled()
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			return m_numThreads > 0;
+		}
+
+		void submit(const CqTilePrefetcher::TqRequestPtr& request)
+		{
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+				if(m_numThreads > 0)
+				{
+					m_queue.push_back(request);
+					m_workAvailable.notify_one();
+					return;
+				}
+			}
+			request->run();
+			request->m_state = CqTilePrefetcher::CqRequest::State_Done;
+		}
+
+		bool wait(const CqTilePrefetcher::TqRequestPtr& request)
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			if(request->m_state == CqTilePrefetcher::CqRequest::State_Queued)
+			{
+				// Not started yet; take it over rather than waiting for an
+				// I/O thread to get to it.  The I/O threads skip requests
+				// which aren't queued any more.
+				request->m_state = CqTilePrefetcher::CqRequest::State_Running;
+				lock.unlock();
+				request->run();
+				lock.lock();
+				request->m_state = CqTilePrefetcher::CqRequest::State_Done;
+			}
+			while(request->m_state != CqTilePrefetcher::CqRequest::State_Done)
+				m_requestDone.wait(lock);
+			return request->m_succeeded;
+		}
+
+		bool finished(const CqTilePrefetcher::TqRequestPtr& request)
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			return request->m_state == CqTilePrefetcher::CqRequest::State_Done;
+		}
+
+	private:
+		/// Main loop for the I/O threads.
+		void work()
+		{
+			while(true)
+			{
+				CqTilePrefetcher::TqRequestPtr request;
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+					while(m_queue.empty() && !m_stopping)
+						m_workAvailable.wait(lock);
+					if(m_queue.empty())
+						return;
+					request = m_queue.front();
+					m_queue.pop_front();
+					if(request->m_state != CqTilePrefetcher::CqRequest::State_Queued)
+						continue;
+					request->m_state = CqTilePrefetcher::CqRequest::State_Running;
+				}
+				request->run();
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+					request->m_state = CqTilePrefetcher::CqRequest::State_Done;
+				}
+				m_requestDone.notify_all();
+			}
+		}
+
+		boost::scoped_ptr<boost::thread_group> m_threads;
+		std::deque<CqTilePrefetcher::TqRequestPtr> m_queue;
+		TqInt m_numThreads;
+		/// Set while the current threads are being asked to exit.
+		bool m_stopping;
+		/// Protects all the state above, along with request states.
+		boost::mutex m_mutex;
+		boost::condition m_workAvailable;
+		boost::condition m_requestDone;
+};
+
+CqIoThreadPool& ioThreadPool()
+{
+	static CqIoThreadPool pool;
+	return pool;
+}
+
+} // unnamed namespace
+
+void CqTilePrefetcher::setNumThreads(TqInt numThreads)
+{
+	ioThreadPool().setNumThreads(numThreads);
+}
+
+bool CqTilePrefetcher::enabled()
+{
+	return ioThreadPool().enabled();
+}
+
+CqTilePrefetcher::TqRequestPtr CqTilePrefetcher::submit(const TqReadFunc& read)
+{
+	TqRequestPtr request(new CqRequest(read));
+	ioThreadPool().submit(request);
+	return request;
+}
+
+bool CqTilePrefetcher::wait(const TqRequestPtr& request)
+{
+	return ioThreadPool().wait(request);
+}
+
+bool CqTilePrefetcher::finished(const TqRequestPtr& request)
+{
+	return ioThreadPool().finished(request);
+}
+
+CqTilePrefetcher::CqFileLock::CqFileLock(const IqTiledTexInputFile& file)
+	: m_mutexIndex(static_cast<TqInt>(
+			reinterpret_cast<size_t>(&file)/sizeof(void*) % numFileMutexes))
+{
+	g_fileMutexes[m_mutexIndex].lock();
+}
+
+CqTilePrefetcher::CqFileLock::~CqFileLock()
+{
+	g_fileMutexes[m_mutexIndex].unlock();
+}
+
+} // namespace Aqsis
@@ -0,0 +1,94 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Unit tests for background tile reading.
+ */
+
+#include <aqsis/tex/buffers/tileprefetcher.h>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+namespace {
+
+void setValue(TqInt* dest, TqInt value)
+{
+	*dest = value;
+}
+
+void throwError()
+{
+	throw 42;
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_SUITE(tileprefetcher_tests)
+
+BOOST_AUTO_TEST_CASE(CqTilePrefetcher_wait_test)
+{
+	Aqsis::CqTilePrefetcher::setNumThreads(2);
+	BOOST_CHECK(Aqsis::CqTilePrefetcher::enabled());
+	const TqInt numRequests = 100;
+	std::vector<TqInt> values(numRequests, 0);
+	std::vector<Aqsis::CqTilePrefetcher::TqRequestPtr> requests;
+	for(TqInt i = 0; i < numRequests; ++i)
+	{
+		requests.push_back(Aqsis::CqTilePrefetcher::submit(
+					boost::bind(setValue, &values[i], i+1)));
+	}
+	// Whether or not the requests were run in the background, waiting must
+	// leave them complete.
+	for(TqInt i = numRequests-1; i >= 0; --i)
+	{
+		BOOST_CHECK(Aqsis::CqTilePrefetcher::wait(requests[i]));
+		BOOST_CHECK(Aqsis::CqTilePrefetcher::finished(requests[i]));
+		BOOST_CHECK_EQUAL(values[i], i+1);
+	}
+	Aqsis::CqTilePrefetcher::setNumThreads(0);
+	BOOST_CHECK(!Aqsis::CqTilePrefetcher::enabled());
+}
+
+BOOST_AUTO_TEST_CASE(CqTilePrefetcher_failure_test)
+{
+	Aqsis::CqTilePrefetcher::setNumThreads(1);
+	Aqsis::CqTilePrefetcher::TqRequestPtr request
+		= Aqsis::CqTilePrefetcher::submit(throwError);
+	BOOST_CHECK(!Aqsis::CqTilePrefetcher::wait(request));
+	Aqsis::CqTilePrefetcher::setNumThreads(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,224 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Visibility function construction, compression and evaluation.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#include <aqsis/tex/buffers/visibilityfunction.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <aqsis/math/math.h>
+
+namespace Aqsis {
+
+namespace {
+
+/// Comparison of a depth against a node, for use with std::upper_bound
+inline bool depthLess(TqFloat depth, const SqVisibilityNode& node)
+{
+	return depth < node.depth;
+}
+
+/// Comparison of a node against a depth, for use with std::lower_bound
+inline bool nodeLess(const SqVisibilityNode& node, TqFloat depth)
+{
+	return node.depth < depth;
+}
+
+/** Evaluate the visibility just in front of the given depth.
+ *
+ * This differs from CqVisibilityFunction::visibility() only at a
+ * discontinuity, where it gives the visibility in front of the step rather
+ * than behind it.
+ */
+TqFloat visibilityBefore(const std::vector<SqVisibilityNode>& nodes,
+		TqFloat depth)
+{
+	std::vector<SqVisibilityNode>::const_iterator next
+		= std::lower_bound(nodes.begin(), nodes.end(), depth, nodeLess);
+	if(next == nodes.begin())
+		return 1;
+	if(next == nodes.end())
+		return nodes.back().visibility;
+	std::vector<SqVisibilityNode>::const_iterator prev = next - 1;
+	return lerp((depth - prev->depth)/(next->depth - prev->depth),
+			prev->visibility, next->visibility);
+}
+
+} // unnamed namespace
+
+//------------------------------------------------------------------------------
+// CqVisibilityFunction implementation
+
+void CqVisibilityFunction::setSteps(std::vector<SqVisibilityStep>& steps)
+{
+	m_nodes.clear();
+	std::sort(steps.begin(), steps.end());
+	TqFloat vis = 1;
+	for(std::vector<SqVisibilityStep>::const_iterator step = steps.begin(),
+			end = steps.end(); step != end;)
+	{
+		// Accumulate all the steps at this depth, and record the visibility
+		// on either side of the resulting discontinuity.
+		const TqFloat depth = step->depth;
+		const TqFloat visBefore = vis;
+		for(; step != end && step->depth == depth; ++step)
+			vis = clamp(vis + step->deltaVisibility, 0.0f, 1.0f);
+		if(vis == visBefore)
+			continue;
+		m_nodes.push_back(SqVisibilityNode(depth, visBefore));
+		m_nodes.push_back(SqVisibilityNode(depth, vis));
+		// Nothing behind a fully opaque layer can change the visibility.
+		if(vis <= 0)
+			break;
+	}
+}
+
+void CqVisibilityFunction::setAverage(const CqVisibilityFunction* const* funcs,
+		const TqFloat* weights, TqInt numFuncs)
+{
+	std::vector<TqFloat> depths;
+	for(TqInt i = 0; i < numFuncs; ++i)
+	{
+		const std::vector<SqVisibilityNode>& nodes = funcs[i]->m_nodes;
+		for(TqInt j = 0, nNodes = nodes.size(); j < nNodes; ++j)
+			depths.push_back(nodes[j].depth);
+	}
+	std::sort(depths.begin(), depths.end());
+	depths.erase(std::unique(depths.begin(), depths.end()), depths.end());
+
+	m_nodes.clear();
+	m_nodes.reserve(depths.size());
+	for(TqInt j = 0, nDepths = depths.size(); j < nDepths; ++j)
+	{
+		// Average the visibility on both sides of the depth, so that steps
+		// in the inputs remain steps in the result.
+		TqFloat visBefore = 0;
+		TqFloat visAfter = 0;
+		for(TqInt i = 0; i < numFuncs; ++i)
+		{
+			visBefore += weights[i]*visibilityBefore(funcs[i]->m_nodes, depths[j]);
+			visAfter += weights[i]*funcs[i]->visibility(depths[j]);
+		}
+		visBefore = clamp(visBefore, 0.0f, 1.0f);
+		visAfter = clamp(visAfter, 0.0f, 1.0f);
+		if(visBefore != visAfter)
+			m_nodes.push_back(SqVisibilityNode(depths[j], visBefore));
+		m_nodes.push_back(SqVisibilityNode(depths[j], visAfter));
+	}
+}
+
+void CqVisibilityFunction::compress(TqFloat tolerance)
+{
+	const TqInt numNodes = m_nodes.size();
+	if(numNodes <= 2)
+		return;
+	std::vector<SqVisibilityNode> newNodes;
+	newNodes.push_back(m_nodes[0]);
+	SqVisibilityNode anchor = m_nodes[0];
+	// Range of segment slopes starting at the anchor which pass within
+	// tolerance of every node considered so far.
+	const TqFloat inf = std::numeric_limits<TqFloat>::infinity();
+	TqFloat minSlope = -inf;
+	TqFloat maxSlope = inf;
+	for(TqInt i = 1; i < numNodes;)
+	{
+		const SqVisibilityNode& node = m_nodes[i];
+		TqFloat dz = node.depth - anchor.depth;
+		if(dz == 0)
+		{
+			// The far side of a discontinuity at the anchor.  Small steps
+			// are absorbed into the segment; larger ones are kept exactly.
+			if(std::fabs(node.visibility - anchor.visibility) > tolerance)
+			{
+				anchor = SqVisibilityNode(node.depth,
+						min(node.visibility, newNodes.back().visibility));
+				newNodes.push_back(anchor);
+			}
+			++i;
+			continue;
+		}
+		TqFloat newMinSlope = max(minSlope,
+				(node.visibility - tolerance - anchor.visibility)/dz);
+		TqFloat newMaxSlope = min(maxSlope,
+				(node.visibility + tolerance - anchor.visibility)/dz);
+		if(newMinSlope <= newMaxSlope)
+		{
+			minSlope = newMinSlope;
+			maxSlope = newMaxSlope;
+			++i;
+			continue;
+		}
+		// The segment can't be extended as far as node, so end it at the
+		// previous node and start a new segment there.  The first node
+		// after the anchor always fits, so this can't loop forever.
+		TqFloat endDepth = m_nodes[i-1].depth;
+		TqFloat vis = anchor.visibility
+			+ 0.5f*(minSlope + maxSlope)*(endDepth - anchor.depth);
+		anchor = SqVisibilityNode(endDepth,
+				clamp(vis, 0.0f, newNodes.back().visibility));
+		newNodes.push_back(anchor);
+		minSlope = -inf;
+		maxSlope = inf;
+	}
+	// Finish the final segment, unless the function ends in a step which was
+	// kept above.
+	TqFloat endDepth = m_nodes.back().depth;
+	if(endDepth > anchor.depth)
+	{
+		TqFloat vis = anchor.visibility
+			+ 0.5f*(minSlope + maxSlope)*(endDepth - anchor.depth);
+		newNodes.push_back(SqVisibilityNode(endDepth,
+					clamp(vis, 0.0f, newNodes.back().visibility)));
+	}
+	m_nodes.swap(newNodes);
+}
+
+TqFloat CqVisibilityFunction::visibility(TqFloat depth) const
+{
+	std::vector<SqVisibilityNode>::const_iterator next
+		= std::upper_bound(m_nodes.begin(), m_nodes.end(), depth, depthLess);
+	if(next == m_nodes.begin())
+		return 1;
+	if(next == m_nodes.end())
+		return m_nodes.back().visibility;
+	std::vector<SqVisibilityNode>::const_iterator prev = next - 1;
+	return lerp((depth - prev->depth)/(next->depth - prev->depth),
+			prev->visibility, next->visibility);
+}
+
+} // namespace Aqsis
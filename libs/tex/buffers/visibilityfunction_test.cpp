@@ -0,0 +1,144 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Unit tests for visibility functions.
+ */
+
+#include <aqsis/tex/buffers/visibilityfunction.h>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <cmath>
+
+BOOST_AUTO_TEST_SUITE(visibilityfunction_tests)
+
+using Aqsis::SqVisibilityStep;
+using Aqsis::CqVisibilityFunction;
+
+BOOST_AUTO_TEST_CASE(CqVisibilityFunction_setSteps_test)
+{
+	std::vector<SqVisibilityStep> steps;
+	steps.push_back(SqVisibilityStep(3, -0.25f));
+	steps.push_back(SqVisibilityStep(1, -0.5f));
+	steps.push_back(SqVisibilityStep(3, -0.125f));
+	steps.push_back(SqVisibilityStep(5, -1));
+	steps.push_back(SqVisibilityStep(6, -0.1f));
+
+	CqVisibilityFunction func;
+	func.setSteps(steps);
+
+	// Steps at the same depth are merged into one discontinuity, and
+	// nothing is kept behind the point where the visibility reaches zero.
+	BOOST_REQUIRE_EQUAL(func.nodes().size(), 6U);
+	BOOST_CHECK_EQUAL(func.visibility(0), 1);
+	BOOST_CHECK_EQUAL(func.visibility(0.999f), 1);
+	BOOST_CHECK_CLOSE(func.visibility(1), 0.5f, 1e-4);
+	// The visibility is constant between hits, rather than ramping.
+	BOOST_CHECK_CLOSE(func.visibility(2), 0.5f, 1e-4);
+	BOOST_CHECK_CLOSE(func.visibility(2.999f), 0.5f, 1e-4);
+	BOOST_CHECK_CLOSE(func.visibility(3), 0.125f, 1e-4);
+	BOOST_CHECK_CLOSE(func.visibility(4.5f), 0.125f, 1e-4);
+	BOOST_CHECK_EQUAL(func.visibility(5), 0);
+	BOOST_CHECK_EQUAL(func.visibility(100), 0);
+
+	BOOST_CHECK_EQUAL(CqVisibilityFunction().visibility(1), 1);
+}
+
+BOOST_AUTO_TEST_CASE(CqVisibilityFunction_compress_test)
+{
+	// A smooth falloff, as from a large number of semitransparent hairs.
+	std::vector<SqVisibilityStep> steps;
+	for(TqInt i = 0; i < 1000; ++i)
+		steps.push_back(SqVisibilityStep(1 + i*0.01f, -0.002f*std::exp(-i*0.002f)));
+	CqVisibilityFunction func;
+	func.setSteps(steps);
+	CqVisibilityFunction exact = func;
+
+	const TqFloat tol = 0.01f;
+	func.compress(tol);
+	BOOST_CHECK_LT(func.nodes().size(), 20U);
+	BOOST_CHECK_EQUAL(func.nodes().front().depth, exact.nodes().front().depth);
+	BOOST_CHECK_EQUAL(func.nodes().back().depth, exact.nodes().back().depth);
+	for(TqInt i = 0; i < 1200; ++i)
+	{
+		TqFloat z = i*0.01f;
+		BOOST_CHECK_SMALL(func.visibility(z) - exact.visibility(z), 1.001f*tol);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CqVisibilityFunction_compress_steps_test)
+{
+	// A few large steps, as from solid or nearly opaque surfaces.
+	std::vector<SqVisibilityStep> steps;
+	steps.push_back(SqVisibilityStep(1, -0.5f));
+	steps.push_back(SqVisibilityStep(2, -0.25f));
+	steps.push_back(SqVisibilityStep(4, -0.125f));
+	CqVisibilityFunction func;
+	func.setSteps(steps);
+	CqVisibilityFunction exact = func;
+
+	const TqFloat tol = 0.01f;
+	func.compress(tol);
+	for(TqInt i = 0; i < 600; ++i)
+	{
+		TqFloat z = i*0.01f;
+		BOOST_CHECK_SMALL(func.visibility(z) - exact.visibility(z), 1.001f*tol);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CqVisibilityFunction_setAverage_test)
+{
+	std::vector<SqVisibilityStep> steps;
+	steps.push_back(SqVisibilityStep(1, -1));
+	CqVisibilityFunction f1;
+	f1.setSteps(steps);
+	steps.clear();
+	steps.push_back(SqVisibilityStep(2, -0.5f));
+	CqVisibilityFunction f2;
+	f2.setSteps(steps);
+
+	const CqVisibilityFunction* funcs[] = {&f1, &f2};
+	const TqFloat weights[] = {0.5f, 0.5f};
+	CqVisibilityFunction avg;
+	avg.setAverage(funcs, weights, 2);
+
+	BOOST_REQUIRE_EQUAL(avg.nodes().size(), 4U);
+	BOOST_CHECK_EQUAL(avg.visibility(0.5f), 1);
+	BOOST_CHECK_CLOSE(avg.visibility(1), 0.5f, 1e-4);
+	BOOST_CHECK_CLOSE(avg.visibility(1.5f), 0.5f, 1e-4);
+	BOOST_CHECK_CLOSE(avg.visibility(2), 0.25f, 1e-4);
+	BOOST_CHECK_CLOSE(avg.visibility(3), 0.25f, 1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
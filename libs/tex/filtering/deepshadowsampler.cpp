@@ -0,0 +1,125 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Deep shadow map sampler implementation.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#include "deepshadowsampler.h"
+
+#include <aqsis/math/math.h>
+#include <aqsis/tex/io/deepshadowfile.h>
+
+#include "ewafilter.h"
+
+namespace Aqsis {
+
+CqDeepShadowSampler::CqDeepShadowSampler(
+		const boost::shared_ptr<CqDeepShadowInputFile>& file,
+		const CqMatrix& currToWorld)
+	: m_file(file),
+	m_currToLight(file->worldToCamera() * currToWorld),
+	m_currToTexture(file->worldToScreen() * currToWorld),
+	m_defaultSampleOptions()
+{
+	// Map light screen coordinates on [-1,1]x[-1,1] onto texture coordinates
+	// [0,1]x[0,1] with the y-axis pointing down; see CqShadowSampler.
+	m_currToTexture.Translate(CqVector3D(1,-1,0));
+	m_currToTexture.Scale(0.5f, -0.5f, 1);
+}
+
+void CqDeepShadowSampler::sample(const Sq3DSampleQuad& sampleQuad,
+		const CqShadowSampleOptions& sampleOpts, TqFloat* outSamps) const
+{
+	// Get depths of sample positions.
+	Sq3DSampleQuad quadLightCoord = sampleQuad;
+	quadLightCoord.transform(m_currToLight);
+
+	// Get texture coordinates of sample positions.
+	Sq3DSampleQuad texQuad3D = sampleQuad;
+	texQuad3D.transform(m_currToTexture);
+	SqSampleQuad texQuad = texQuad3D;
+	texQuad.scaleWidth(sampleOpts.sWidth(), sampleOpts.tWidth());
+
+	CqEwaFilterFactory ewaFactory(texQuad, m_file->width(), m_file->height(),
+			sampleOpts.sBlur(), sampleOpts.tBlur(), 2);
+
+	// The visibility functions are prefiltered, so we can use the coarsest
+	// mipmap level which still has minWidth pixels across the filter.
+	TqFloat levelCts = log2(ewaFactory.minorAxisWidth()/sampleOpts.minWidth());
+	TqInt level = clamp<TqInt>(lfloor(levelCts), 0, m_file->numLevels()-1);
+	// Level pixels are box averages of 2^level level 0 pixels.  Adjust the
+	// filter to level raster coordinates, remembering that the filter works
+	// with pixel centres at integer positions.
+	TqFloat scale = 1.0f/(1 << level);
+	TqFloat offset = 0.5f*(1 - (1 << level));
+	CqEwaFilter ewaWeights = ewaFactory.createFilter(scale, offset, scale, offset);
+
+	const TqInt width = m_file->width(level);
+	const TqInt height = m_file->height(level);
+	SqFilterSupport support = ewaWeights.support();
+	if(!support.intersectsRange(0, width, 0, height))
+	{
+		// If the filter support lies wholly outside the texture, return
+		// fully visible == 0.
+		*outSamps = 0;
+		return;
+	}
+	support.sx.truncate(0, width);
+	support.sy.truncate(0, height);
+
+	TqFloat depth = quadLightCoord.center().z()
+		- 0.5f*(sampleOpts.biasLow() + sampleOpts.biasHigh());
+	TqFloat totVis = 0;
+	TqFloat totWeight = 0;
+	for(TqInt y = support.sy.start; y < support.sy.end; ++y)
+	{
+		for(TqInt x = support.sx.start; x < support.sx.end; ++x)
+		{
+			TqFloat weight = ewaWeights(x, y);
+			if(weight > 0)
+			{
+				totVis += weight*m_file->pixel(x, y, level).visibility(depth);
+				totWeight += weight;
+			}
+		}
+	}
+	*outSamps = totWeight > 0 ? 1 - totVis/totWeight : 0;
+}
+
+const CqShadowSampleOptions& CqDeepShadowSampler::defaultSampleOptions() const
+{
+	return m_defaultSampleOptions;
+}
+
+} // namespace Aqsis
@@ -0,0 +1,93 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Deep shadow map sampling.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#ifndef DEEPSHADOWSAMPLER_H_INCLUDED
+#define DEEPSHADOWSAMPLER_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/tex/filtering/ishadowsampler.h>
+#include <aqsis/math/matrix.h>
+#include <aqsis/tex/filtering/texturesampleoptions.h>
+
+namespace Aqsis
+{
+
+class CqDeepShadowInputFile;
+
+//------------------------------------------------------------------------------
+/** \brief A sampler for deep shadow maps.
+ *
+ * Deep shadow maps store prefiltered visibility as a function of depth for
+ * each pixel, so there's no need for percentage closer filtering: the
+ * visibility functions under the filter are simply evaluated at the depth of
+ * the surface and averaged.  This makes the cost independent of the amount
+ * of supersampling used when rendering the map, and allows the filter to be
+ * applied on a coarse mipmap level when the filter region is large.
+ */
+class AQSIS_TEX_SHARE CqDeepShadowSampler : public IqShadowSampler
+{
+	public:
+		/** \brief Construct a deep shadow sampler for the given file.
+		 *
+		 * \param file - deep shadow map to sample.
+		 * \param currToWorld - a matrix transforming the "current" coordinate
+		 *                      system to the world coordinate system.
+		 */
+		CqDeepShadowSampler(const boost::shared_ptr<CqDeepShadowInputFile>& file,
+				const CqMatrix& currToWorld);
+
+		// inherited
+		virtual void sample(const Sq3DSampleQuad& sampleQuad,
+				const CqShadowSampleOptions& sampleOpts, TqFloat* outSamps) const;
+		virtual const CqShadowSampleOptions& defaultSampleOptions() const;
+	private:
+		/// Deep shadow data
+		boost::shared_ptr<CqDeepShadowInputFile> m_file;
+		/// transformation: current -> light coordinates
+		CqMatrix m_currToLight;
+		/// transformation: current -> texture coordinates ( [0,1]x[0,1] )
+		CqMatrix m_currToTexture;
+		/// Default sampling options.
+		CqShadowSampleOptions m_defaultSampleOptions;
+};
+
+} // namespace Aqsis
+
+#endif // DEEPSHADOWSAMPLER_H_INCLUDED
@@ -42,6 +42,11 @@
 
 #include <vector>
 
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#	define AQSIS_EWA_USE_SSE
+#endif
+
 #include <aqsis/math/math.h>
 #include <aqsis/tex/buffers/filtersupport.h>
 #include <aqsis/math/matrix2d.h>
@@ -93,6 +98,20 @@ class CqEwaFilter
 		 *            don't have to)
 		 */
 		TqFloat operator()(TqFloat x, TqFloat y) const;
+		/** \brief Evaluate the filter weights for a horizontal row of pixels.
+		 *
+		 * The result is equivalent to setting weights[i] = (*this)(x0+i, y)
+		 * for each i in [0,numPixels), but the quadratic form and the weight
+		 * lookup are evaluated for several pixels at once using SSE where
+		 * available.
+		 *
+		 * \param x0 - x-position of the first pixel in the row
+		 * \param y - y-position of the row
+		 * \param numPixels - length of the row
+		 * \param weights - output array of length numPixels.
+		 */
+		void rowWeights(TqInt x0, TqInt y, TqInt numPixels,
+				TqFloat* weights) const;
 		/// Get the extent of the filter in integer raster coordinates.
 		SqFilterSupport support() const;
 
@@ -410,6 +429,38 @@ class CqNegExpTable
 			TqFloat interp = xRescaled - index;
 			return (1-interp)*m_values[index] + interp*m_values[index+1];
 		}
+
+#ifdef AQSIS_EWA_USE_SSE
+		/** \brief Look up an approximate exp(-x) for four values at once.
+		 *
+		 * This gives the same result as operator() for each element, except
+		 * that elements for which x is not less than cutoff are also set to
+		 * zero.
+		 *
+		 * \param x - values to look up; must be positive.
+		 * \param cutoff - values larger than or equal to this return zero.
+		 */
+		__m128 lookup4(__m128 x, TqFloat cutoff) const
+		{
+			__m128 inRange = _mm_cmplt_ps(x,
+					_mm_set1_ps(min(cutoff, m_rangeMax)));
+			// Zero out-of-range inputs so that the table indices stay valid;
+			// the mask removes their contribution at the end.
+			__m128 xRescaled = _mm_mul_ps(_mm_and_ps(inRange, x),
+					_mm_set1_ps(m_invRes));
+			__m128i index = _mm_cvttps_epi32(xRescaled);
+			__m128 interp = _mm_sub_ps(xRescaled, _mm_cvtepi32_ps(index));
+			TqInt idx[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(idx), index);
+			const TqFloat* v = &m_values[0];
+			__m128 v0 = _mm_setr_ps(v[idx[0]], v[idx[1]], v[idx[2]], v[idx[3]]);
+			__m128 v1 = _mm_setr_ps(v[idx[0]+1], v[idx[1]+1], v[idx[2]+1],
+					v[idx[3]+1]);
+			__m128 result = _mm_add_ps(v0,
+					_mm_mul_ps(interp, _mm_sub_ps(v1, v0)));
+			return _mm_and_ps(inRange, result);
+		}
+#endif
 };
 extern CqNegExpTable negExpTable;
 
@@ -441,6 +492,42 @@ inline TqFloat CqEwaFilter::operator()(TqFloat x, TqFloat y) const
 	return 0;
 }
 
+inline void CqEwaFilter::rowWeights(TqInt x0, TqInt y, TqInt numPixels,
+		TqFloat* weights) const
+{
+	// The quadratic form along the row is
+	//   q(x) = a*x^2 + bc*x*y + d*y^2
+	// with the constant parts computed once per row.
+	const TqFloat yOff = y - m_filterCenter.y();
+	const TqFloat a = m_quadForm.a;
+	const TqFloat bcy = (m_quadForm.b + m_quadForm.c)*yOff;
+	const TqFloat dyy = m_quadForm.d*yOff*yOff;
+	TqFloat xOff = x0 - m_filterCenter.x();
+	TqInt i = 0;
+#	ifdef AQSIS_EWA_USE_SSE
+	const __m128 a4 = _mm_set1_ps(a);
+	const __m128 bcy4 = _mm_set1_ps(bcy);
+	const __m128 dyy4 = _mm_set1_ps(dyy);
+	__m128 x4 = _mm_add_ps(_mm_set1_ps(xOff), _mm_setr_ps(0, 1, 2, 3));
+	const __m128 step4 = _mm_set1_ps(4);
+	for(; i + 4 <= numPixels; i += 4)
+	{
+		__m128 q = _mm_add_ps(_mm_mul_ps(x4, _mm_add_ps(_mm_mul_ps(a4, x4),
+						bcy4)), dyy4);
+		_mm_storeu_ps(weights + i, detail::negExpTable.lookup4(q,
+					m_logEdgeWeight));
+		x4 = _mm_add_ps(x4, step4);
+	}
+	xOff += i;
+#	endif
+	// Scalar fallback, also used for the last few pixels of the row.
+	for(; i < numPixels; ++i, xOff += 1)
+	{
+		TqFloat q = xOff*(a*xOff + bcy) + dyy;
+		weights[i] = q < m_logEdgeWeight ? detail::negExpTable(q) : 0;
+	}
+}
+
 inline SqFilterSupport CqEwaFilter::support() const
 {
 	TqFloat detQ = m_quadForm.det();
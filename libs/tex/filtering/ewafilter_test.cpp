@@ -0,0 +1,218 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Unit tests for EWA filter weights and row-wise filtering.
+ */
+
+#include "ewafilter.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <aqsis/tex/buffers/texturebuffer.h>
+#include <aqsis/tex/buffers/tilearray.h>
+#include <aqsis/tex/filtering/filtertexture.h>
+#include <aqsis/tex/filtering/sampleaccum.h>
+#include <aqsis/tex/io/itiledtexinputfile.h>
+
+namespace {
+
+// Pixel value of the test images
+TqUint8 testPixel(TqInt x, TqInt y, TqInt c)
+{
+	return (13*x + 7*y + 51*c) % 256;
+}
+
+// Tiled input file holding the test image in memory.
+class TestTiledFile : public Aqsis::IqTiledTexInputFile
+{
+	public:
+		TestTiledFile(TqInt width, TqInt height, TqInt numChans,
+				TqInt tileWidth, TqInt tileHeight)
+			: m_header(),
+			m_tileInfo(tileWidth, tileHeight)
+		{
+			m_header.setWidth(width);
+			m_header.setHeight(height);
+			m_header.channelList().addUnnamedChannels(
+					Aqsis::Channel_Unsigned8, numChans);
+		}
+		virtual Aqsis::boostfs::path fileName() const
+		{
+			return "test_tiled_file";
+		}
+		virtual Aqsis::EqImageFileType fileType() const
+		{
+			return Aqsis::ImageFile_Unknown;
+		}
+		virtual const Aqsis::CqTexFileHeader& header(TqInt index = 0) const
+		{
+			return m_header;
+		}
+		virtual Aqsis::SqTileInfo tileInfo() const
+		{
+			return m_tileInfo;
+		}
+		virtual TqInt numSubImages() const
+		{
+			return 1;
+		}
+		virtual TqInt width(TqInt index) const
+		{
+			return m_header.width();
+		}
+		virtual TqInt height(TqInt index) const
+		{
+			return m_header.height();
+		}
+	protected:
+		virtual void readTileImpl(TqUint8* buffer, TqInt tileX, TqInt tileY,
+				TqInt subImageIdx, const Aqsis::SqTileInfo tileSize) const
+		{
+			TqInt numChans = m_header.channelList().numChannels();
+			for(TqInt y = 0; y < tileSize.height; ++y)
+				for(TqInt x = 0; x < tileSize.width; ++x)
+					for(TqInt c = 0; c < numChans; ++c)
+						*buffer++ = testPixel(tileX*m_tileInfo.width + x,
+								tileY*m_tileInfo.height + y, c);
+		}
+	private:
+		Aqsis::CqTexFileHeader m_header;
+		Aqsis::SqTileInfo m_tileInfo;
+};
+
+// Construct an anisotropic EWA filter centered at (cx,cy)
+Aqsis::CqEwaFilter testFilter(TqFloat cx, TqFloat cy)
+{
+	Aqsis::SqSamplePllgram pllgram(Aqsis::CqVector2D(cx/64, cy/64),
+			Aqsis::CqVector2D(0.1, 0.03), Aqsis::CqVector2D(-0.02, 0.05));
+	Aqsis::CqEwaFilterFactory factory(pllgram, 64, 64, Aqsis::SqMatrix2D(0));
+	return factory.createFilter();
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_SUITE(ewafilter_tests)
+
+BOOST_AUTO_TEST_CASE(CqEwaFilter_rowWeights_test)
+{
+	Aqsis::CqEwaFilter filter = testFilter(20.3, 30.6);
+	Aqsis::SqFilterSupport support = filter.support();
+	TqInt len = support.sx.range() + 3;
+	std::vector<TqFloat> weights(len);
+	for(TqInt y = support.sy.start; y < support.sy.end; ++y)
+	{
+		// Start one pixel outside the support to check the cutoff.
+		filter.rowWeights(support.sx.start-1, y, len, &weights[0]);
+		for(TqInt i = 0; i < len; ++i)
+		{
+			TqFloat expected = filter(support.sx.start-1+i, y);
+			BOOST_CHECK_SMALL(weights[i] - expected, 1e-5f);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(filterTextureRows_test)
+{
+	const TqInt width = 40;
+	const TqInt height = 50;
+	const TqInt numChans = 3;
+	Aqsis::CqTextureBuffer<TqUint8> buf(width, height, numChans);
+	for(TqInt y = 0; y < height; ++y)
+		for(TqInt x = 0; x < width; ++x)
+			for(TqInt c = 0; c < numChans; ++c)
+				buf.value(x,y)[c] = testPixel(x, y, c);
+
+	// Include a filter which crosses the edge of the buffer so that the
+	// wrapped parts are tested as well.
+	TqFloat centers[] = {20.3, 30.6,  1.5, 47.2};
+	for(TqInt j = 0; j < 2; ++j)
+	{
+		Aqsis::CqEwaFilter filter = testFilter(centers[2*j], centers[2*j+1]);
+		Aqsis::SqWrapModes wrapModes(Aqsis::WrapMode_Periodic,
+				Aqsis::WrapMode_Clamp);
+		TqFloat pixelResult[numChans];
+		TqFloat rowResult[numChans];
+		{
+			Aqsis::CqSampleAccum<Aqsis::CqEwaFilter> accum(filter, 0,
+					numChans, pixelResult);
+			Aqsis::filterTexture(accum, buf, filter.support(), wrapModes);
+		}
+		{
+			Aqsis::CqSampleAccum<Aqsis::CqEwaFilter> accum(filter, 0,
+					numChans, rowResult);
+			Aqsis::filterTextureRows(accum, buf, filter.support(), wrapModes);
+		}
+		for(TqInt c = 0; c < numChans; ++c)
+			BOOST_CHECK_CLOSE(rowResult[c], pixelResult[c], 1e-3f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(filterTextureRows_tileArray_test)
+{
+	const TqInt width = 40;
+	const TqInt height = 50;
+	const TqInt numChans = 3;
+	Aqsis::CqTextureBuffer<TqUint8> buf(width, height, numChans);
+	for(TqInt y = 0; y < height; ++y)
+		for(TqInt x = 0; x < width; ++x)
+			for(TqInt c = 0; c < numChans; ++c)
+				buf.value(x,y)[c] = testPixel(x, y, c);
+	Aqsis::CqTileArray<TqUint8> tiles(boost::shared_ptr<TestTiledFile>(
+				new TestTiledFile(width, height, numChans, 16, 16)), 0);
+
+	// The filter support crosses the tile boundaries at x = 16 and y = 32,
+	// so that the rows are assembled from four tiles.
+	Aqsis::CqEwaFilter filter = testFilter(16.2, 31.7);
+	Aqsis::SqFilterSupport support = filter.support();
+	BOOST_REQUIRE(support.sx.start < 16 && support.sx.end > 16);
+	BOOST_REQUIRE(support.sy.start < 32 && support.sy.end > 32);
+	Aqsis::SqWrapModes wrapModes(Aqsis::WrapMode_Periodic,
+			Aqsis::WrapMode_Clamp);
+	TqFloat bufResult[numChans];
+	TqFloat tileResult[numChans];
+	{
+		Aqsis::CqSampleAccum<Aqsis::CqEwaFilter> accum(filter, 0,
+				numChans, bufResult);
+		Aqsis::filterTexture(accum, buf, support, wrapModes);
+	}
+	{
+		Aqsis::CqSampleAccum<Aqsis::CqEwaFilter> accum(filter, 0,
+				numChans, tileResult);
+		Aqsis::filterTextureRows(accum, tiles, support, wrapModes);
+	}
+	for(TqInt c = 0; c < numChans; ++c)
+		BOOST_CHECK_CLOSE(tileResult[c], bufResult[c], 1e-3f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -86,6 +86,10 @@ const CqTextureSampleOptions& IqTextureSampler::defaultSampleOptions() const
 	return defaultOptions;
 }
 
+void IqTextureSampler::prefetch(TqFloat /*sMin*/, TqFloat /*sMax*/,
+		TqFloat /*tMin*/, TqFloat /*tMax*/, TqFloat /*filterWidth*/) const
+{ }
+
 boost::shared_ptr<IqTextureSampler> IqTextureSampler::create(
 		const boost::shared_ptr<IqTiledTexInputFile>& file)
 {
@@ -0,0 +1,107 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief A min/max depth pyramid for conservative shadow map culling.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#include "minmaxdepth.h"
+
+namespace Aqsis {
+
+// Out-of-class definition for the static integral constant.
+const TqInt CqMinMaxDepthPyramid::baseBlockSize;
+
+bool CqMinMaxDepthPyramid::depthRange(const SqFilterSupport& support,
+		TqFloat& minDepth, TqFloat& maxDepth) const
+{
+	SqFilterSupport s = intersect(support,
+			SqFilterSupport(0, m_mapWidth, 0, m_mapHeight));
+	if(s.isEmpty())
+		return false;
+	// Choose the finest level for which the support covers at most 2x2
+	// blocks.  Coarser levels are cheaper to look up but give looser bounds.
+	TqInt levelNum = 0;
+	TqInt blockSize = baseBlockSize;
+	TqInt bx0 = 0, bx1 = 0, by0 = 0, by1 = 0;
+	while(true)
+	{
+		bx0 = s.sx.start/blockSize;
+		bx1 = (s.sx.end-1)/blockSize;
+		by0 = s.sy.start/blockSize;
+		by1 = (s.sy.end-1)/blockSize;
+		if((bx1 - bx0 < 2 && by1 - by0 < 2)
+				|| levelNum == static_cast<TqInt>(m_levels.size()) - 1)
+			break;
+		++levelNum;
+		blockSize *= 2;
+	}
+	const SqLevel& level = m_levels[levelNum];
+	minDepth = std::numeric_limits<TqFloat>::max();
+	maxDepth = -std::numeric_limits<TqFloat>::max();
+	for(TqInt by = by0; by <= by1; ++by)
+	{
+		for(TqInt bx = bx0; bx <= bx1; ++bx)
+		{
+			TqInt block = by*level.width + bx;
+			minDepth = min(minDepth, level.minDepth[block]);
+			maxDepth = max(maxDepth, level.maxDepth[block]);
+		}
+	}
+	return true;
+}
+
+void CqMinMaxDepthPyramid::buildCoarseLevels()
+{
+	while(m_levels.back().width > 1 || m_levels.back().height > 1)
+	{
+		const SqLevel& fine = m_levels.back();
+		SqLevel coarse((fine.width+1)/2, (fine.height+1)/2);
+		// Each coarse block covers up to 2x2 fine blocks.
+		for(TqInt y = 0; y < fine.height; ++y)
+		{
+			for(TqInt x = 0; x < fine.width; ++x)
+			{
+				TqInt fineIdx = y*fine.width + x;
+				TqInt coarseIdx = (y/2)*coarse.width + x/2;
+				coarse.minDepth[coarseIdx] = min(coarse.minDepth[coarseIdx],
+						fine.minDepth[fineIdx]);
+				coarse.maxDepth[coarseIdx] = max(coarse.maxDepth[coarseIdx],
+						fine.maxDepth[fineIdx]);
+			}
+		}
+		m_levels.push_back(coarse);
+	}
+}
+
+} // namespace Aqsis
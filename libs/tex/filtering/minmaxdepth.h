@@ -0,0 +1,182 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief A min/max depth pyramid for conservative shadow map culling.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#ifndef MINMAXDEPTH_H_INCLUDED
+#define MINMAXDEPTH_H_INCLUDED
+
+#include <aqsis/aqsis.h>
+
+#include <limits>
+#include <vector>
+
+#include <aqsis/math/math.h>
+#include <aqsis/tex/buffers/filtersupport.h>
+
+namespace Aqsis {
+
+/** \brief Pyramid of depth bounds over square blocks of a depth map.
+ *
+ * Each level of the pyramid holds the minimum and maximum depth over square
+ * blocks of texels in the depth map; the block size doubles with each level
+ * until a single block covers the whole map.  This allows the range of depths
+ * under an arbitrary filter support to be bounded by looking at only a few
+ * blocks, so that percentage closer filtering can be skipped when the support
+ * is wholly in front of or wholly behind the surface being shadowed.
+ */
+class AQSIS_TEX_SHARE CqMinMaxDepthPyramid
+{
+	public:
+		/** \brief Build the pyramid from the given depth map.
+		 *
+		 * All texels of depthMap are visited once; depths are taken from the
+		 * first channel.
+		 *
+		 * \param depthMap - depth data; ArrayT should provide row access via
+		 *                   beginRows(), as for CqTileArray.
+		 */
+		template<typename ArrayT>
+		CqMinMaxDepthPyramid(const ArrayT& depthMap);
+
+		/** \brief Get conservative bounds for the depths inside a support.
+		 *
+		 * The returned range contains the depths of all texels in the part
+		 * of the support inside the depth map, though it may be larger.
+		 *
+		 * \param support - support region in raster coordinates.
+		 * \param minDepth - returns the lower bound on the depth.
+		 * \param maxDepth - returns the upper bound on the depth.
+		 * \return false if the support doesn't intersect the depth map.
+		 */
+		bool depthRange(const SqFilterSupport& support, TqFloat& minDepth,
+				TqFloat& maxDepth) const;
+
+		/// Texel width of the blocks in the finest level of the pyramid.
+		static const TqInt baseBlockSize = 8;
+
+	private:
+		/// Depth bounds for the blocks of one pyramid level.
+		struct SqLevel
+		{
+			/// Number of blocks in the x and y directions
+			TqInt width;
+			TqInt height;
+			/// Minimum and maximum depths for each block, in row-major order.
+			std::vector<TqFloat> minDepth;
+			std::vector<TqFloat> maxDepth;
+
+			SqLevel(TqInt width, TqInt height);
+		};
+
+		/// Fill in the coarser levels from the finest one.
+		void buildCoarseLevels();
+
+		/// Pyramid levels, with the finest level first.
+		std::vector<SqLevel> m_levels;
+		/// Dimensions of the underlying depth map.
+		TqInt m_mapWidth;
+		TqInt m_mapHeight;
+};
+
+
+/** \brief Compute the range of a linear depth approximation over a support.
+ *
+ * DepthFuncT is a depth functor such as CqSampleQuadDepthApprox which is
+ * linear in the raster coordinates, so that the extreme values lie at the
+ * corners of the support.
+ */
+template<typename DepthFuncT>
+void surfaceDepthRange(const DepthFuncT& depthFunc,
+		const SqFilterSupport& support, TqFloat& minDepth, TqFloat& maxDepth);
+
+
+//==============================================================================
+// Implementation details
+//==============================================================================
+
+inline CqMinMaxDepthPyramid::SqLevel::SqLevel(TqInt width, TqInt height)
+	: width(width),
+	height(height),
+	minDepth(width*height, std::numeric_limits<TqFloat>::max()),
+	maxDepth(width*height, -std::numeric_limits<TqFloat>::max())
+{ }
+
+template<typename ArrayT>
+CqMinMaxDepthPyramid::CqMinMaxDepthPyramid(const ArrayT& depthMap)
+	: m_levels(),
+	m_mapWidth(depthMap.width()),
+	m_mapHeight(depthMap.height())
+{
+	m_levels.push_back(SqLevel((m_mapWidth-1)/baseBlockSize + 1,
+				(m_mapHeight-1)/baseBlockSize + 1));
+	SqLevel& base = m_levels.back();
+	const TqInt stride = depthMap.numChannels();
+	for(typename ArrayT::TqRowIterator row = depthMap.beginRows(
+				SqFilterSupport(0, m_mapWidth, 0, m_mapHeight));
+			row.inSupport(); ++row)
+	{
+		const TqInt blockRowOffset = (row.y()/baseBlockSize)*base.width;
+		const TqFloat* depth = row.data();
+		const TqInt xEnd = row.x() + row.length();
+		for(TqInt x = row.x(); x < xEnd; ++x, depth += stride)
+		{
+			TqInt block = blockRowOffset + x/baseBlockSize;
+			base.minDepth[block] = min(base.minDepth[block], *depth);
+			base.maxDepth[block] = max(base.maxDepth[block], *depth);
+		}
+	}
+	buildCoarseLevels();
+}
+
+template<typename DepthFuncT>
+void surfaceDepthRange(const DepthFuncT& depthFunc,
+		const SqFilterSupport& support, TqFloat& minDepth, TqFloat& maxDepth)
+{
+	const TqFloat x0 = support.sx.start;
+	const TqFloat x1 = support.sx.end - 1;
+	const TqFloat y0 = support.sy.start;
+	const TqFloat y1 = support.sy.end - 1;
+	TqFloat z00 = depthFunc(x0, y0);
+	TqFloat z10 = depthFunc(x1, y0);
+	TqFloat z01 = depthFunc(x0, y1);
+	TqFloat z11 = depthFunc(x1, y1);
+	minDepth = min(min(z00, z10), min(z01, z11));
+	maxDepth = max(max(z00, z10), max(z01, z11));
+}
+
+} // namespace Aqsis
+
+#endif // MINMAXDEPTH_H_INCLUDED
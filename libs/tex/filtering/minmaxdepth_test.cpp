@@ -0,0 +1,101 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Unit tests for the min/max depth pyramid.
+ */
+
+#include "minmaxdepth.h"
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+#include <aqsis/tex/buffers/texturebuffer.h>
+
+#include "depthapprox.h"
+
+BOOST_AUTO_TEST_SUITE(minmaxdepth_tests)
+
+BOOST_AUTO_TEST_CASE(CqMinMaxDepthPyramid_depthRange_test)
+{
+	const TqInt width = 37;
+	const TqInt height = 53;
+	Aqsis::CqTextureBuffer<TqFloat> depthMap(width, height, 1);
+	for(TqInt y = 0; y < height; ++y)
+		for(TqInt x = 0; x < width; ++x)
+			depthMap.value(x,y)[0] = ((7*x + 13*y) % 29) + 0.5f*x;
+
+	Aqsis::CqMinMaxDepthPyramid pyramid(depthMap);
+
+	Aqsis::SqFilterSupport supports[] = {
+		Aqsis::SqFilterSupport(3, 4, 5, 6),
+		Aqsis::SqFilterSupport(0, 8, 0, 8),
+		Aqsis::SqFilterSupport(10, 30, 2, 41),
+		Aqsis::SqFilterSupport(-5, 12, 40, 60),
+		Aqsis::SqFilterSupport(0, width, 0, height)
+	};
+	for(TqInt i = 0; i < 5; ++i)
+	{
+		const Aqsis::SqFilterSupport& s = supports[i];
+		TqFloat minDepth = 0;
+		TqFloat maxDepth = 0;
+		BOOST_REQUIRE(pyramid.depthRange(s, minDepth, maxDepth));
+		// The bounds must be conservative.
+		for(Aqsis::CqTextureBuffer<TqFloat>::TqIterator p = depthMap.begin(s);
+				p.inSupport(); ++p)
+		{
+			BOOST_CHECK_LE(minDepth, (*p)[0]);
+			BOOST_CHECK_GE(maxDepth, (*p)[0]);
+		}
+	}
+	// A single texel maps to a single block of the finest level.
+	TqFloat minDepth = 0;
+	TqFloat maxDepth = 0;
+	pyramid.depthRange(Aqsis::SqFilterSupport(0, 1, 0, 1), minDepth, maxDepth);
+	BOOST_CHECK_EQUAL(minDepth, 0);
+
+	// Supports outside the map give no range.
+	BOOST_CHECK(!pyramid.depthRange(Aqsis::SqFilterSupport(width, width+5, 0, 5),
+				minDepth, maxDepth));
+}
+
+BOOST_AUTO_TEST_CASE(surfaceDepthRange_test)
+{
+	Aqsis::CqConstDepthApprox constDepth(2.5);
+	TqFloat minDepth = 0;
+	TqFloat maxDepth = 0;
+	Aqsis::surfaceDepthRange(constDepth, Aqsis::SqFilterSupport(0, 10, 0, 10),
+			minDepth, maxDepth);
+	BOOST_CHECK_EQUAL(minDepth, 2.5f);
+	BOOST_CHECK_EQUAL(maxDepth, 2.5f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -119,6 +119,17 @@ class CqMipmap
 		void applyFilter(const FilterFactoryT& filterFactory,
 				const CqTextureSampleOptions& sampleOpts, TqFloat* outSamps);
 
+		/** \brief Start reading the data for a region in the background.
+		 *
+		 * The mipmap level is chosen in the same way as applyFilter() does
+		 * for a filter of the given width with the default sample options.
+		 *
+		 * \param sMin, sMax, tMin, tMax - region bounds in texture coordinates
+		 * \param filterWidth - expected filter width in texture coordinates
+		 */
+		void prefetch(TqFloat sMin, TqFloat sMax, TqFloat tMin, TqFloat tMax,
+				TqFloat filterWidth) const;
+
 	private:
 		/// Initialize all mipmap levels
 		void initLevels();
@@ -328,6 +339,29 @@ void CqMipmap<TextureBufferT>::applyFilter(const FilterFactoryT& filterFactory,
 	// outSamps[level%sampleOpts.numCahnnels()] += 0.1;
 }
 
+template<typename TextureBufferT>
+void CqMipmap<TextureBufferT>::prefetch(TqFloat sMin, TqFloat sMax,
+		TqFloat tMin, TqFloat tMax, TqFloat filterWidth) const
+{
+	TqFloat minorAxisWidth = filterWidth*min(m_width0, m_height0);
+	TqInt level = 0;
+	if(minorAxisWidth > 0)
+	{
+		level = clamp<TqInt>(lfloor(log2(minorAxisWidth
+					/ m_defaultSampleOptions.minWidth())), 0, numLevels()-1);
+	}
+	// Convert the region into raster coordinates for the chosen level,
+	// padding by the filter width on each side.
+	const SqLevelTrans& trans = levelTrans(level);
+	TqFloat pad = filterWidth;
+	TqFloat x0 = trans.xScale*((sMin - pad)*m_width0 + trans.xOffset);
+	TqFloat x1 = trans.xScale*((sMax + pad)*m_width0 + trans.xOffset);
+	TqFloat y0 = trans.yScale*((tMin - pad)*m_height0 + trans.yOffset);
+	TqFloat y1 = trans.yScale*((tMax + pad)*m_height0 + trans.yOffset);
+	getLevel(level).prefetch(SqFilterSupport(lfloor(x0), lceil(x1) + 1,
+				lfloor(y0), lceil(y1) + 1));
+}
+
 template<typename TextureBufferT>
 const TextureBufferT& CqMipmap<TextureBufferT>::getLevel(TqInt levelNum) const
 {
@@ -447,8 +481,8 @@ void CqMipmap<TextureBufferT>::filterLevel(
 		TqInt cy = (support.sy.start + support.sy.end)/2;
 		support = intersect(support, SqFilterSupport(cx-10, cx+11, cy-10, cy+11));
 	}
-	// filter the texture
-	filterTexture(
+	// filter the texture, a row of texels at a time.
+	filterTextureRows(
 		accumulator,
 		getLevel(level),
 		support,
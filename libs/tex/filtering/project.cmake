@@ -1,5 +1,6 @@
 set(filtering_srcs
 	cachedfilter.cpp
+	deepshadowsampler.cpp
 	dummyenvironmentsampler.cpp
 	dummytexturesampler.cpp
 	ewafilter.cpp
@@ -7,21 +8,25 @@ set(filtering_srcs
 	iocclusionsampler.cpp
 	ishadowsampler.cpp
 	itexturesampler.cpp
+	minmaxdepth.cpp
 	occlusionsampler.cpp
 	randomtable.cpp
 	shadowsampler.cpp
 	texturecache.cpp
+	texturecachestats.cpp
 )
 make_absolute(filtering_srcs ${filtering_SOURCE_DIR})
 
 set(filtering_hdrs
 	cubeenvironmentsampler.h
+	deepshadowsampler.h
 	dummyenvironmentsampler.h
 	dummyocclusionsampler.h
 	dummyshadowsampler.h
 	dummytexturesampler.h
 	ewafilter.h
 	latlongenvironmentsampler.h
+	minmaxdepth.h
 	mipmap.h
 	occlusionsampler.h
 	randomtable.h
@@ -34,6 +39,9 @@ make_absolute(filtering_hdrs ${filtering_SOURCE_DIR})
 include_directories(${filtering_SOURCE_DIR})
 
 set(filtering_test_srcs
+	ewafilter_test.cpp
+	minmaxdepth_test.cpp
 	samplequad_test.cpp
+	texturecachestats_test.cpp
 )
 make_absolute(filtering_test_srcs ${filtering_SOURCE_DIR})
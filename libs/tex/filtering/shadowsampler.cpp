@@ -37,6 +37,9 @@
 
 #include "shadowsampler.h"
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <aqsis/tex/io/itexinputfile.h>
 #include <aqsis/tex/filtering/sampleaccum.h>
 #include <aqsis/tex/filtering/filtertexture.h>
@@ -45,6 +48,7 @@
 
 #include "depthapprox.h"
 #include "ewafilter.h"
+#include "minmaxdepth.h"
 
 namespace Aqsis {
 
@@ -82,6 +86,39 @@ inline void applyPCF(const CqTileArray<TqFloat>& pixelBuf,
 	}
 }
 
+/** \brief Try to determine the PCF result from depth bounds alone.
+ *
+ * If the surface depth over the whole support is in front of every depth in
+ * the map, the result is fully visible; if it's behind every depth (including
+ * the bias), the result is fully shadowed.
+ *
+ * \return true if the result was determined and placed in outSamps[0].
+ */
+template<typename DApprox>
+inline bool pcfEarlyOut(const CqMinMaxDepthPyramid& depthPyramid,
+		const CqShadowSampleOptions& sampleOpts, const SqFilterSupport& support,
+		const DApprox& depthFunc, TqFloat* outSamps)
+{
+	TqFloat mapMin = 0;
+	TqFloat mapMax = 0;
+	if(!depthPyramid.depthRange(support, mapMin, mapMax))
+		return false;
+	TqFloat surfMin = 0;
+	TqFloat surfMax = 0;
+	surfaceDepthRange(depthFunc, support, surfMin, surfMax);
+	if(surfMax <= mapMin + min(sampleOpts.biasLow(), sampleOpts.biasHigh()))
+	{
+		*outSamps = 0;
+		return true;
+	}
+	if(surfMin > mapMax + max(sampleOpts.biasLow(), sampleOpts.biasHigh()))
+	{
+		*outSamps = 1;
+		return true;
+	}
+	return false;
+}
+
 } // anon namespace
 
 /** \brief Class representing a single view out of the shadow map.
@@ -118,6 +155,38 @@ class CqShadowSampler::CqShadowView
 		CqVector3D m_lightPos;
 		/// Pixel data for shadow map.
 		CqTileArray<TqFloat> m_pixels;
+		/** \brief Depth bounds for blocks of the shadow map.
+		 *
+		 * Built on demand the first time a large filter support is sampled,
+		 * since building it touches every tile of the map.
+		 */
+		mutable boost::scoped_ptr<CqMinMaxDepthPyramid> m_depthPyramid;
+		/// Mutex protecting the construction of m_depthPyramid.
+		mutable boost::mutex m_depthPyramidMutex;
+
+		/** \brief Minimum support area for which to use m_depthPyramid.
+		 *
+		 * For small supports direct filtering is cheap enough that the
+		 * cost of building the pyramid isn't justified.
+		 */
+		static const TqInt m_minPyramidSupportArea = 64;
+
+		/** \brief Get the depth pyramid if it's worth using for a support.
+		 *
+		 * \return The pyramid, or 0 if the support is too small or the
+		 * depth channel isn't the first one.
+		 */
+		const CqMinMaxDepthPyramid* depthPyramid(const SqFilterSupport& support,
+				const CqShadowSampleOptions& sampleOpts) const
+		{
+			if(support.area() < m_minPyramidSupportArea
+					|| sampleOpts.startChannel() != 0)
+				return 0;
+			boost::mutex::scoped_lock lock(m_depthPyramidMutex);
+			if(!m_depthPyramid)
+				m_depthPyramid.reset(new CqMinMaxDepthPyramid(m_pixels));
+			return m_depthPyramid.get();
+		}
 
 	public:
 		/** \brief Create a view from imageNum of the provided file.
@@ -132,7 +201,9 @@ class CqShadowSampler::CqShadowView
 			m_currToRaster(),
 			m_currToRasterVec(),
 			m_viewDirec(),
-			m_pixels(file, imageNum)
+			m_pixels(file, imageNum),
+			m_depthPyramid(),
+			m_depthPyramidMutex()
 		{
 			// TODO refactor with CqShadowSampler, also refactor this function,
 			// since it's a bit unweildly...
@@ -240,19 +311,19 @@ class CqShadowSampler::CqShadowView
 					m_pixels.height(), sampleOpts.sBlur(), sampleOpts.tBlur(), 2);
 			CqEwaFilter ewaWeights = ewaFactory.createFilter();
 
-			/** \todo Optimization: Cull the query if it's outside the [min,max] depth
-			 * range of the support.  Being able to determine the range from the tiles
-			 * covered by the filter support will be a big advantage.
-			 */
-
 			SqFilterSupport support = ewaWeights.support();
 			if(support.intersectsRange(0, m_pixels.width(), 0, m_pixels.height()))
 			{
+				// For large supports, cull the query if it's wholly outside
+				// the [min,max] depth range of the map under the support.
+				const CqMinMaxDepthPyramid* pyramid = depthPyramid(support, sampleOpts);
 				if(sampleOpts.depthApprox() == DApprox_Constant)
 				{
 					// Functor which approximates the surface depth using a constant.
 					CqConstDepthApprox depthFunc(quadLightCoord.center().z());
-					applyPCF(m_pixels, sampleOpts, support, ewaWeights, depthFunc, outSamps);
+					if(!pyramid || !pcfEarlyOut(*pyramid, sampleOpts, support,
+								depthFunc, outSamps))
+						applyPCF(m_pixels, sampleOpts, support, ewaWeights, depthFunc, outSamps);
 				}
 				else
 				{
@@ -262,7 +333,9 @@ class CqShadowSampler::CqShadowView
 					quadLightCoord.copy2DCoords(texQuad);
 					CqSampleQuadDepthApprox depthFunc(quadLightCoord, m_pixels.width(),
 							m_pixels.height());
-					applyPCF(m_pixels, sampleOpts, support, ewaWeights, depthFunc, outSamps);
+					if(!pyramid || !pcfEarlyOut(*pyramid, sampleOpts, support,
+								depthFunc, outSamps))
+						applyPCF(m_pixels, sampleOpts, support, ewaWeights, depthFunc, outSamps);
 				}
 			}
 			else
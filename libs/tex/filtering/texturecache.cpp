@@ -37,17 +37,26 @@
 
 #include "texturecache.h"
 
+#include <algorithm>
+
+#include <boost/filesystem/operations.hpp>
+
 #include <aqsis/util/exception.h>
 #include <aqsis/util/file.h>
 #include <aqsis/tex/filtering/ienvironmentsampler.h>
 #include <aqsis/tex/filtering/iocclusionsampler.h>
 #include <aqsis/tex/filtering/ishadowsampler.h>
+#include <aqsis/tex/io/deepshadowfile.h>
+#include <aqsis/tex/buffers/tileprefetcher.h>
 #include <aqsis/tex/io/itiledtexinputfile.h>
 #include <aqsis/tex/filtering/itexturesampler.h>
 #include <aqsis/util/logging.h>
 #include <aqsis/util/sstring.h>
 #include <aqsis/tex/texexception.h>
 
+#include "deepshadowsampler.h"
+#include "magicnumber.h"
+
 namespace Aqsis {
 
 //------------------------------------------------------------------------------
@@ -60,15 +69,38 @@ boost::shared_ptr<IqTextureCache> IqTextureCache::create(
 			new CqTextureCache(searchPathCallback));
 }
 
+namespace {
+
+/// Erase the samplers which have no file in the file cache.
+template<typename SamplerT, typename FileT>
+void eraseUnbacked(std::map<TqUlong, boost::shared_ptr<SamplerT> >& samplerMap,
+		const std::map<TqUlong, FileT>& fileMap)
+{
+	typename std::map<TqUlong, boost::shared_ptr<SamplerT> >::iterator
+		sampler = samplerMap.begin();
+	while(sampler != samplerMap.end())
+	{
+		if(fileMap.count(sampler->first))
+			++sampler;
+		else
+			samplerMap.erase(sampler++);
+	}
+}
+
+} // anon. namespace
+
 //------------------------------------------------------------------------------
 // CqTextureCache
 
 CqTextureCache::CqTextureCache(TqSearchPathCallback searchPathCallback)
-	: m_textureCache(),
+	: m_stats(),
+	m_textureCache(),
 	m_environmentCache(),
 	m_shadowCache(),
 	m_occlusionCache(),
 	m_texFileCache(),
+	m_fileStates(),
+	m_clientTextures(),
 	m_currToWorld(),
 	m_searchPathCallback(searchPathCallback)
 { }
@@ -85,6 +117,46 @@ IqEnvironmentSampler& CqTextureCache::findEnvironmentSampler(const char* name)
 
 IqShadowSampler& CqTextureCache::findShadowSampler(const char* name)
 {
+	TqUlong hash = CqString::hash(name);
+	std::map<TqUlong, boost::shared_ptr<IqShadowSampler> >::const_iterator
+		texIter = m_shadowCache.find(hash);
+	if(texIter != m_shadowCache.end())
+		return *(texIter->second);
+	// Deep shadow maps aren't tiled textures, so they need to be picked out
+	// before falling back to the generic sampler creation.  Failure to find
+	// the file is left for findSampler() to report.
+	boostfs::path fullName = findFileNothrow(name, m_searchPathCallback());
+	if(!fullName.empty())
+	{
+		boost::shared_ptr<IqShadowSampler> newTex;
+		try
+		{
+			if(guessFileType(fullName) == ImageFile_AqsisDeepShadow)
+			{
+				m_stats.fileOpened(fullName.string());
+				boost::shared_ptr<CqDeepShadowInputFile> file(
+						new CqDeepShadowInputFile(fullName));
+				newTex.reset(new CqDeepShadowSampler(file, m_currToWorld));
+			}
+		}
+		catch(XqInvalidFile& e)
+		{
+			Aqsis::log() << error
+				<< "Invalid deep shadow file - " << e.what() << "\n";
+			newTex = IqShadowSampler::createDummy();
+		}
+		catch(XqBadTexture& e)
+		{
+			Aqsis::log() << error
+				<< "Bad deep shadow file - " << e.what() << "\n";
+			newTex = IqShadowSampler::createDummy();
+		}
+		if(newTex)
+		{
+			m_shadowCache[hash] = newTex;
+			return *newTex;
+		}
+	}
 	return findSampler(m_shadowCache, name);
 }
 
@@ -100,6 +172,50 @@ void CqTextureCache::flush()
 	m_shadowCache.clear();
 	m_occlusionCache.clear();
 	m_texFileCache.clear();
+	m_fileStates.clear();
+	m_clientTextures.clear();
+}
+
+void CqTextureCache::flushStale()
+{
+	m_shadowCache.clear();
+	m_occlusionCache.clear();
+	m_clientTextures.clear();
+	std::map<TqUlong, boost::shared_ptr<IqTiledTexInputFile> >::iterator
+		file = m_texFileCache.begin();
+	while(file != m_texFileCache.end())
+	{
+		TqUlong hash = file->first;
+		bool stale = true;
+		std::map<TqUlong, SqFileState>::const_iterator state
+			= m_fileStates.find(hash);
+		// Files only opened for shadow maps or textureInfo() aren't kept.
+		if(state != m_fileStates.end() && (m_textureCache.count(hash)
+				|| m_environmentCache.count(hash)))
+		{
+			try
+			{
+				const SqFileState& s = state->second;
+				stale = findFileNothrow(s.name, m_searchPathCallback()) != s.fullName
+					|| boostfs::last_write_time(s.fullName) != s.modTime
+					|| boostfs::file_size(s.fullName) != s.size;
+			}
+			catch(boostfs::filesystem_error& /*e*/)
+			{ }
+		}
+		if(stale)
+		{
+			m_textureCache.erase(hash);
+			m_environmentCache.erase(hash);
+			m_fileStates.erase(hash);
+			m_texFileCache.erase(file++);
+		}
+		else
+			++file;
+	}
+	// Dummy samplers for files which couldn't be opened are retried.
+	eraseUnbacked(m_textureCache, m_texFileCache);
+	eraseUnbacked(m_environmentCache, m_texFileCache);
 }
 
 const CqTexFileHeader* CqTextureCache::textureInfo(const char* name)
@@ -121,6 +237,43 @@ void CqTextureCache::setCurrToWorldMatrix(const CqMatrix& currToWorld)
 	m_currToWorld = currToWorld;
 }
 
+CqTextureCacheStats& CqTextureCache::stats()
+{
+	return m_stats;
+}
+
+void CqTextureCache::recordTextureUse(const void* client,
+		const IqTextureSampler& sampler)
+{
+	// Clients usually only use a handful of textures, so a short list is
+	// fine.  Limit the length so that a client which uses many textures
+	// doesn't make prefetching expensive.
+	const TqInt maxTexturesPerClient = 16;
+	std::vector<const IqTextureSampler*>& textures = m_clientTextures[client];
+	if(static_cast<TqInt>(textures.size()) < maxTexturesPerClient
+			&& std::find(textures.begin(), textures.end(), &sampler)
+				== textures.end())
+		textures.push_back(&sampler);
+}
+
+void CqTextureCache::prefetchTextures(const void* client, TqFloat sMin,
+		TqFloat sMax, TqFloat tMin, TqFloat tMax, TqFloat filterWidth)
+{
+	if(!CqTilePrefetcher::enabled())
+		return;
+	TqClientTextureMap::const_iterator i = m_clientTextures.find(client);
+	if(i == m_clientTextures.end())
+		return;
+	for(std::vector<const IqTextureSampler*>::const_iterator
+			sampler = i->second.begin(); sampler != i->second.end(); ++sampler)
+		(*sampler)->prefetch(sMin, sMax, tMin, tMax, filterWidth);
+}
+
+void CqTextureCache::setPrefetchThreads(TqInt numThreads)
+{
+	CqTilePrefetcher::setNumThreads(numThreads);
+}
+
 //--------------------------------------------------
 // Private methods
 template<typename SamplerT>
@@ -187,7 +340,21 @@ boost::shared_ptr<IqTiledTexInputFile> CqTextureCache::getTextureFile(
 		Aqsis::log() << warning << "Could not open file as a tiled texture: "
 			<< e.what() << ".  Rendering will continue, but may be slower.\n";
 	}
+	file->setStats(m_stats.fileOpened(fullName.string()));
 	m_texFileCache[hash] = file;
+	SqFileState& state = m_fileStates[hash];
+	state.name = name;
+	state.fullName = fullName;
+	try
+	{
+		state.modTime = boostfs::last_write_time(fullName);
+		state.size = boostfs::file_size(fullName);
+	}
+	catch(boostfs::filesystem_error& /*e*/)
+	{
+		// Never kept by flushStale().
+		m_fileStates.erase(hash);
+	}
 	return file;
 }
 
@@ -40,12 +40,18 @@
 
 #include <aqsis/aqsis.h>
 
+#include <ctime>
 #include <map>
+#include <string>
+#include <vector>
 
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
 
 #include <aqsis/tex/filtering/itexturecache.h>
+#include <aqsis/tex/filtering/texturecachestats.h>
 #include <aqsis/math/matrix.h>
+#include <aqsis/util/file.h>
 
 namespace Aqsis {
 
@@ -77,8 +83,15 @@ class AQSIS_TEX_SHARE CqTextureCache : public IqTextureCache, private boost::non
 		virtual IqShadowSampler& findShadowSampler(const char* name);
 		virtual IqOcclusionSampler& findOcclusionSampler(const char* name);
 		virtual void flush();
+		virtual void flushStale();
 		virtual const CqTexFileHeader* textureInfo(const char* name);
 		virtual void setCurrToWorldMatrix(const CqMatrix& currToWorld);
+		virtual CqTextureCacheStats& stats();
+		virtual void recordTextureUse(const void* client,
+				const IqTextureSampler& sampler);
+		virtual void prefetchTextures(const void* client, TqFloat sMin,
+				TqFloat sMax, TqFloat tMin, TqFloat tMax, TqFloat filterWidth);
+		virtual void setPrefetchThreads(TqInt numThreads);
 
 	private:
 		/** \brief Find a sampler in the given map, or create one from file if needed.
@@ -111,6 +124,9 @@ class AQSIS_TEX_SHARE CqTextureCache : public IqTextureCache, private boost::non
 		boost::shared_ptr<SamplerT> newSamplerFromFile(
 				const boost::shared_ptr<IqTiledTexInputFile>& file);
 
+		/// Texture statistics.  This must outlive the cached files, which
+		/// report back to it as their tiles are released.
+		CqTextureCacheStats m_stats;
 		/// Cached textures live in here
 		std::map<TqUlong, boost::shared_ptr<IqTextureSampler> > m_textureCache;
 		std::map<TqUlong, boost::shared_ptr<IqEnvironmentSampler> > m_environmentCache;
@@ -118,6 +134,20 @@ class AQSIS_TEX_SHARE CqTextureCache : public IqTextureCache, private boost::non
 		std::map<TqUlong, boost::shared_ptr<IqOcclusionSampler> > m_occlusionCache;
 		/// Cached texture files live in here:
 		std::map<TqUlong, boost::shared_ptr<IqTiledTexInputFile> > m_texFileCache;
+		/// State of a cached file when it was opened.
+		struct SqFileState
+		{
+			std::string name;
+			boostfs::path fullName;
+			std::time_t modTime;
+			boost::uintmax_t size;
+		};
+		/// State of the cached texture files, used by flushStale().
+		std::map<TqUlong, SqFileState> m_fileStates;
+		/// Textures sampled by each client, for prefetching.
+		typedef std::map<const void*, std::vector<const IqTextureSampler*> >
+			TqClientTextureMap;
+		TqClientTextureMap m_clientTextures;
 		/// Camera -> world transformation - used for creating shadow maps.
 		CqMatrix m_currToWorld;
 		/// Callback function to obtain the current texture search path.
@@ -0,0 +1,310 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Texture cache statistics implementation.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#include <aqsis/tex/filtering/texturecachestats.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace Aqsis {
+
+//------------------------------------------------------------------------------
+// CqTextureFileStats
+
+CqTextureFileStats::CqTextureFileStats(const std::string& fileName,
+		CqTextureCacheStats* cacheStats)
+	: m_fileName(fileName),
+	m_cacheStats(cacheStats),
+	m_tileHits(0),
+	m_tileMisses(0),
+	m_tilesPrefetched(0),
+	m_bytesRead(0),
+	m_residentBytes(0),
+	m_ioTimer(),
+	m_ioTimeOffset(0)
+{ }
+
+void CqTextureFileStats::tileRead(TqUlong bytes)
+{
+	++m_tileMisses;
+	m_bytesRead += bytes;
+	m_residentBytes += bytes;
+	if(m_cacheStats)
+		m_cacheStats->adjustResident(bytes, 0);
+}
+
+void CqTextureFileStats::tilePrefetched(TqUlong bytes)
+{
+	++m_tilesPrefetched;
+	m_bytesRead += bytes;
+	m_residentBytes += bytes;
+	if(m_cacheStats)
+		m_cacheStats->adjustResident(bytes, 0);
+}
+
+void CqTextureFileStats::tilesReleased(TqUlong bytes)
+{
+	assert(bytes <= m_residentBytes);
+	m_residentBytes -= bytes;
+	if(m_cacheStats)
+		m_cacheStats->adjustResident(0, bytes);
+}
+
+void CqTextureFileStats::reset()
+{
+	m_tileHits = 0;
+	m_tileMisses = 0;
+	m_tilesPrefetched = 0;
+	m_bytesRead = 0;
+	m_ioTimeOffset = m_ioTimer.totalTime();
+}
+
+//------------------------------------------------------------------------------
+// CqTextureCacheStats
+
+namespace {
+
+typedef std::vector<const CqTextureFileStats*> TqFileStatsVec;
+
+bool moreBytesRead(const CqTextureFileStats* a, const CqTextureFileStats* b)
+{
+	if(a->bytesRead() != b->bytesRead())
+		return a->bytesRead() > b->bytesRead();
+	return a->fileName() < b->fileName();
+}
+
+/// Write a string as a JSON string literal.
+void writeJsonString(std::ostream& out, const std::string& str)
+{
+	out << '"';
+	for(std::string::const_iterator c = str.begin(); c != str.end(); ++c)
+	{
+		switch(*c)
+		{
+			case '"':  out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if(static_cast<unsigned char>(*c) < 0x20)
+				{
+					out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+						<< static_cast<int>(*c) << std::dec << std::setfill(' ');
+				}
+				else
+					out << *c;
+				break;
+		}
+	}
+	out << '"';
+}
+
+double toMiB(TqUlong bytes)
+{
+	return bytes / (1024.0*1024.0);
+}
+
+} // unnamed namespace
+
+CqTextureCacheStats::CqTextureCacheStats()
+	: m_fileStats(),
+	m_filesOpened(0),
+	m_residentBytes(0),
+	m_peakResidentBytes(0)
+{ }
+
+boost::shared_ptr<CqTextureFileStats> CqTextureCacheStats::fileOpened(
+		const std::string& fileName)
+{
+	++m_filesOpened;
+	boost::shared_ptr<CqTextureFileStats>& stats = m_fileStats[fileName];
+	if(!stats)
+		stats.reset(new CqTextureFileStats(fileName, this));
+	return stats;
+}
+
+void CqTextureCacheStats::reset()
+{
+	for(TqFileStatsMap::iterator i = m_fileStats.begin(); i != m_fileStats.end();)
+	{
+		// Only the map holds a reference once the file has been closed.
+		if(i->second.unique())
+			m_fileStats.erase(i++);
+		else
+		{
+			i->second->reset();
+			++i;
+		}
+	}
+	m_filesOpened = 0;
+	m_peakResidentBytes = m_residentBytes;
+}
+
+TqUlong CqTextureCacheStats::tileHits() const
+{
+	TqUlong total = 0;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		total += i->second->tileHits();
+	return total;
+}
+
+TqUlong CqTextureCacheStats::tileMisses() const
+{
+	TqUlong total = 0;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		total += i->second->tileMisses();
+	return total;
+}
+
+TqUlong CqTextureCacheStats::tilesPrefetched() const
+{
+	TqUlong total = 0;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		total += i->second->tilesPrefetched();
+	return total;
+}
+
+TqUlong CqTextureCacheStats::bytesRead() const
+{
+	TqUlong total = 0;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		total += i->second->bytesRead();
+	return total;
+}
+
+double CqTextureCacheStats::ioTime() const
+{
+	double total = 0;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		total += i->second->ioTime();
+	return total;
+}
+
+double CqTextureCacheStats::hitRate() const
+{
+	TqUlong hits = tileHits();
+	TqUlong lookups = hits + tileMisses();
+	if(lookups == 0)
+		return 1;
+	return static_cast<double>(hits)/lookups;
+}
+
+void CqTextureCacheStats::printReport(std::ostream& out, TqInt topN) const
+{
+	TqFileStatsVec files;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		files.push_back(i->second.get());
+	std::sort(files.begin(), files.end(), moreBytesRead);
+
+	out << std::setiosflags(std::ios::fixed)
+		<< "Textures:\n\t"
+		<< m_filesOpened << " files opened, "
+		<< tileHits() + tileMisses() << " tile lookups, "
+		<< std::setprecision(2) << 100*hitRate() << "% hits\n\t"
+		<< toMiB(bytesRead()) << " MiB read in " << tileMisses() << " tiles, "
+		<< tilesPrefetched() << " tiles prefetched, "
+		<< ioTime() << " secs I/O\n\t"
+		<< toMiB(m_peakResidentBytes) << " MiB peak resident\n";
+	TqInt numListed = std::min<TqInt>(topN, files.size());
+	if(numListed > 0)
+	{
+		out << "\n\tTop " << numListed << " textures by data read:\n";
+		for(TqInt i = 0; i < numListed; ++i)
+		{
+			const CqTextureFileStats& f = *files[i];
+			TqUlong lookups = f.tileHits() + f.tileMisses();
+			out << "\t" << std::setw(10) << std::setprecision(2)
+				<< toMiB(f.bytesRead()) << " MiB  "
+				<< std::setw(6) << std::setprecision(2)
+				<< (lookups ? 100.0*f.tileHits()/lookups : 100.0) << "% hits  "
+				<< f.fileName() << "\n";
+		}
+	}
+	out << std::endl;
+}
+
+void CqTextureCacheStats::writeJson(std::ostream& out) const
+{
+	TqFileStatsVec files;
+	for(TqFileStatsMap::const_iterator i = m_fileStats.begin();
+			i != m_fileStats.end(); ++i)
+		files.push_back(i->second.get());
+	std::sort(files.begin(), files.end(), moreBytesRead);
+
+	out << "{\n"
+		<< "  \"filesOpened\": " << m_filesOpened << ",\n"
+		<< "  \"tileHits\": " << tileHits() << ",\n"
+		<< "  \"tileMisses\": " << tileMisses() << ",\n"
+		<< "  \"tilesPrefetched\": " << tilesPrefetched() << ",\n"
+		<< "  \"hitRate\": " << hitRate() << ",\n"
+		<< "  \"bytesRead\": " << bytesRead() << ",\n"
+		<< "  \"ioTime\": " << ioTime() << ",\n"
+		<< "  \"peakResidentBytes\": " << m_peakResidentBytes << ",\n"
+		<< "  \"files\": [";
+	for(TqFileStatsVec::const_iterator i = files.begin(); i != files.end(); ++i)
+	{
+		const CqTextureFileStats& f = **i;
+		out << (i == files.begin() ? "\n" : ",\n")
+			<< "    {\"name\": ";
+		writeJsonString(out, f.fileName());
+		out << ", \"tileHits\": " << f.tileHits()
+			<< ", \"tileMisses\": " << f.tileMisses()
+			<< ", \"tilesPrefetched\": " << f.tilesPrefetched()
+			<< ", \"bytesRead\": " << f.bytesRead()
+			<< ", \"residentBytes\": " << f.residentBytes()
+			<< ", \"ioTime\": " << f.ioTime() << "}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+void CqTextureCacheStats::adjustResident(TqUlong added, TqUlong removed)
+{
+	m_residentBytes += added;
+	m_residentBytes -= removed;
+	if(m_residentBytes > m_peakResidentBytes)
+		m_peakResidentBytes = m_residentBytes;
+}
+
+} // namespace Aqsis
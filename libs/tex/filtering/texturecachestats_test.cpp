@@ -0,0 +1,107 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Unit tests for the texture cache statistics.
+ */
+
+#include <aqsis/tex/filtering/texturecachestats.h>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+
+#include <sstream>
+
+BOOST_AUTO_TEST_SUITE(texturecachestats_tests)
+
+BOOST_AUTO_TEST_CASE(CqTextureCacheStats_totals_test)
+{
+	Aqsis::CqTextureCacheStats cacheStats;
+	boost::shared_ptr<Aqsis::CqTextureFileStats> a = cacheStats.fileOpened("a.tex");
+	boost::shared_ptr<Aqsis::CqTextureFileStats> b = cacheStats.fileOpened("b.tex");
+	BOOST_CHECK_EQUAL(cacheStats.fileOpened("a.tex"), a);
+	BOOST_CHECK_EQUAL(cacheStats.filesOpened(), 3);
+
+	a->tileRead(100);
+	a->tileHit();
+	a->tileHit();
+	b->tileRead(300);
+	b->tileRead(300);
+	b->tileHit();
+
+	BOOST_CHECK_EQUAL(cacheStats.tileHits(), 3UL);
+	BOOST_CHECK_EQUAL(cacheStats.tileMisses(), 3UL);
+	BOOST_CHECK_EQUAL(cacheStats.bytesRead(), 700UL);
+	BOOST_CHECK_CLOSE(cacheStats.hitRate(), 0.5, 1e-5);
+	BOOST_CHECK_EQUAL(cacheStats.residentBytes(), 700UL);
+
+	b->tilesReleased(600);
+	BOOST_CHECK_EQUAL(cacheStats.residentBytes(), 100UL);
+	BOOST_CHECK_EQUAL(cacheStats.peakResidentBytes(), 700UL);
+}
+
+BOOST_AUTO_TEST_CASE(CqTextureCacheStats_reset_test)
+{
+	Aqsis::CqTextureCacheStats cacheStats;
+	boost::shared_ptr<Aqsis::CqTextureFileStats> a = cacheStats.fileOpened("a.tex");
+	cacheStats.fileOpened("closed.tex")->tileRead(50);
+	a->tileRead(100);
+	a->tileHit();
+
+	cacheStats.reset();
+	// Counters for closed files are dropped; resident memory is kept.
+	BOOST_CHECK_EQUAL(cacheStats.filesOpened(), 0);
+	BOOST_CHECK_EQUAL(cacheStats.tileHits(), 0UL);
+	BOOST_CHECK_EQUAL(cacheStats.bytesRead(), 0UL);
+	BOOST_CHECK_EQUAL(cacheStats.residentBytes(), 150UL);
+	BOOST_CHECK_EQUAL(cacheStats.peakResidentBytes(), 150UL);
+	BOOST_CHECK_EQUAL(a->residentBytes(), 100UL);
+}
+
+BOOST_AUTO_TEST_CASE(CqTextureCacheStats_writeJson_test)
+{
+	Aqsis::CqTextureCacheStats cacheStats;
+	cacheStats.fileOpened("small.tex")->tileRead(10);
+	cacheStats.fileOpened("big \"quoted\".tex")->tileRead(1000);
+
+	std::ostringstream out;
+	cacheStats.writeJson(out);
+	std::string json = out.str();
+	BOOST_CHECK(json.find("\"bytesRead\": 1010") != std::string::npos);
+	// Files are listed in order of bytes read, with names escaped.
+	std::string::size_type bigPos = json.find("\"big \\\"quoted\\\".tex\"");
+	std::string::size_type smallPos = json.find("\"small.tex\"");
+	BOOST_REQUIRE(bigPos != std::string::npos);
+	BOOST_REQUIRE(smallPos != std::string::npos);
+	BOOST_CHECK(bigPos < smallPos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
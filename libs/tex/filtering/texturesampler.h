@@ -66,6 +66,8 @@ class AQSIS_TEX_SHARE CqTextureSampler : public IqTextureSampler
 		virtual void sample(const SqSamplePllgram& samplePllgram,
 				const CqTextureSampleOptions& sampleOpts, TqFloat* outSamps) const;
 		virtual const CqTextureSampleOptions& defaultSampleOptions() const;
+		virtual void prefetch(TqFloat sMin, TqFloat sMax, TqFloat tMin,
+				TqFloat tMax, TqFloat filterWidth) const;
 	private:
 		boost::shared_ptr<LevelCacheT> m_levels;
 };
@@ -108,6 +110,13 @@ CqTextureSampler<LevelCacheT>::defaultSampleOptions() const
 	return m_levels->defaultSampleOptions();
 }
 
+template<typename LevelCacheT>
+void CqTextureSampler<LevelCacheT>::prefetch(TqFloat sMin, TqFloat sMax,
+		TqFloat tMin, TqFloat tMax, TqFloat filterWidth) const
+{
+	m_levels->prefetch(sMin, sMax, tMin, tMax, filterWidth);
+}
+
 } // namespace Aqsis
 
 #endif // TEXTURESAMPLER_H_INCLUDED
@@ -0,0 +1,433 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Deep shadow map file reading and writing.
+ *
+ * \author Chris Foster [ chris42f (at) gmail (dot) com ]
+ */
+
+#include <aqsis/tex/io/deepshadowfile.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+#include <aqsis/math/math.h>
+#include <aqsis/tex/texexception.h>
+#include <aqsis/util/logging.h>
+
+namespace Aqsis {
+
+namespace deepshadow {
+	const char magicNumber[] = "Aqsis deep shadow";
+}
+
+namespace {
+
+/// Size of a tile table entry in the file.
+const TqInt tileEntrySize = sizeof(boost::uint64_t) + 2*sizeof(TqUint32);
+
+template<typename T>
+inline void writeRaw(std::ostream& out, const T& value)
+{
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+inline void readRaw(std::istream& in, T& value, const char* what)
+{
+	in.read(reinterpret_cast<char*>(&value), sizeof(T));
+	if(in.gcount() != sizeof(T))
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_BadFile,
+			"cannot read " << what << " from deep shadow file");
+}
+
+/// Number of mipmap levels for a map of the given size.
+TqInt numMipLevels(TqInt width, TqInt height)
+{
+	TqInt numLevels = 1;
+	while(width > 1 || height > 1)
+	{
+		width = (width+1)/2;
+		height = (height+1)/2;
+		++numLevels;
+	}
+	return numLevels;
+}
+
+/// Number of tiles needed to cover a level
+inline TqInt numTiles(TqInt width, TqInt height, TqInt tileSize)
+{
+	return ((width + tileSize - 1)/tileSize) * ((height + tileSize - 1)/tileSize);
+}
+
+} // unnamed namespace
+
+//------------------------------------------------------------------------------
+// CqDeepShadowOutputFile implementation
+
+CqDeepShadowOutputFile::CqDeepShadowOutputFile(const boostfs::path& fileName,
+		TqInt width, TqInt height, const CqMatrix& worldToScreen,
+		const CqMatrix& worldToCamera, TqFloat tolerance, TqInt tileSize)
+	: m_fileName(fileName),
+	m_width(width),
+	m_height(height),
+	m_worldToScreen(worldToScreen),
+	m_worldToCamera(worldToCamera),
+	m_tolerance(tolerance),
+	m_tileSize(tileSize),
+	m_pixels(width*height),
+	m_closed(false)
+{
+	assert(width > 0 && height > 0 && tileSize > 0);
+}
+
+CqDeepShadowOutputFile::~CqDeepShadowOutputFile()
+{
+	try
+	{
+		close();
+	}
+	catch(XqException& e)
+	{
+		Aqsis::log() << error << e.what() << "\n";
+	}
+}
+
+void CqDeepShadowOutputFile::setPixel(TqInt x, TqInt y,
+		CqVisibilityFunction& func)
+{
+	assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+	func.compress(m_tolerance);
+	m_pixels[y*m_width + x].swap(func);
+}
+
+void CqDeepShadowOutputFile::close()
+{
+	if(m_closed)
+		return;
+	m_closed = true;
+
+	std::ofstream out(native(m_fileName).c_str(),
+			std::ios::out | std::ios::binary);
+	if(!out)
+	{
+		AQSIS_THROW_XQERROR(XqInvalidFile, EqE_System,
+			"Could not open deep shadow file \"" << m_fileName
+			<< "\" for writing");
+	}
+
+	// Header
+	const TqInt numLevels = numMipLevels(m_width, m_height);
+	out.write(deepshadow::magicNumber, deepshadow::magicNumberSize);
+	writeRaw(out, deepshadow::version);
+	writeRaw(out, TqInt32(m_width));
+	writeRaw(out, TqInt32(m_height));
+	writeRaw(out, TqInt32(m_tileSize));
+	writeRaw(out, TqInt32(numLevels));
+	out.write(reinterpret_cast<const char*>(m_worldToScreen.pElements()),
+			16*sizeof(TqFloat));
+	out.write(reinterpret_cast<const char*>(m_worldToCamera.pElements()),
+			16*sizeof(TqFloat));
+
+	// Reserve space for the tile table; it's filled in once the tile sizes
+	// are known.
+	TqInt totTiles = 0;
+	for(TqInt w = m_width, h = m_height, l = 0; l < numLevels;
+			++l, w = (w+1)/2, h = (h+1)/2)
+		totTiles += numTiles(w, h, m_tileSize);
+	std::ostream::pos_type tableStart = out.tellp();
+	std::vector<char> emptyTable(totTiles*tileEntrySize, 0);
+	out.write(&emptyTable[0], emptyTable.size());
+
+	// Write each level in turn, building the next level from the previous
+	// one by averaging 2x2 blocks of pixels.
+	std::vector<SqTileEntry> entries;
+	entries.reserve(totTiles);
+	TqLevel level;
+	level.swap(m_pixels);
+	TqInt width = m_width;
+	TqInt height = m_height;
+	for(TqInt l = 0; l < numLevels; ++l)
+	{
+		writeLevel(out, level, width, height, entries);
+		if(l == numLevels-1)
+			break;
+		TqInt newWidth = (width+1)/2;
+		TqInt newHeight = (height+1)/2;
+		TqLevel newLevel(newWidth*newHeight);
+		for(TqInt y = 0; y < newHeight; ++y)
+		{
+			for(TqInt x = 0; x < newWidth; ++x)
+			{
+				const CqVisibilityFunction* children[4];
+				TqInt numChildren = 0;
+				for(TqInt j = 2*y; j < min(2*y+2, height); ++j)
+					for(TqInt i = 2*x; i < min(2*x+2, width); ++i)
+						children[numChildren++] = &level[j*width + i];
+				TqFloat weights[4];
+				std::fill(weights, weights+4, 1.0f/numChildren);
+				CqVisibilityFunction& func = newLevel[y*newWidth + x];
+				func.setAverage(children, weights, numChildren);
+				func.compress(m_tolerance);
+			}
+		}
+		level.swap(newLevel);
+		width = newWidth;
+		height = newHeight;
+	}
+
+	// Go back and fill in the tile table.
+	out.seekp(tableStart);
+	for(std::vector<SqTileEntry>::const_iterator entry = entries.begin(),
+			end = entries.end(); entry != end; ++entry)
+	{
+		writeRaw(out, entry->offset);
+		writeRaw(out, entry->compressedSize);
+		writeRaw(out, entry->rawSize);
+	}
+	if(!out)
+	{
+		AQSIS_THROW_XQERROR(XqInvalidFile, EqE_System,
+			"Error writing deep shadow file \"" << m_fileName << "\"");
+	}
+}
+
+void CqDeepShadowOutputFile::writeLevel(std::ostream& out,
+		const TqLevel& level, TqInt width, TqInt height,
+		std::vector<SqTileEntry>& entries) const
+{
+	std::vector<char> rawTile;
+	std::vector<Bytef> compressedTile;
+	for(TqInt ty = 0; ty < height; ty += m_tileSize)
+	{
+		for(TqInt tx = 0; tx < width; tx += m_tileSize)
+		{
+			// Serialize the tile.
+			rawTile.clear();
+			for(TqInt y = ty, yEnd = min(ty + m_tileSize, height); y < yEnd; ++y)
+			{
+				for(TqInt x = tx, xEnd = min(tx + m_tileSize, width); x < xEnd; ++x)
+				{
+					const std::vector<SqVisibilityNode>& nodes
+						= level[y*width + x].nodes();
+					TqUint32 numNodes = nodes.size();
+					const char* countBytes = reinterpret_cast<const char*>(&numNodes);
+					rawTile.insert(rawTile.end(), countBytes,
+							countBytes + sizeof(numNodes));
+					for(TqUint32 i = 0; i < numNodes; ++i)
+					{
+						TqFloat node[2] = {nodes[i].depth, nodes[i].visibility};
+						const char* nodeBytes = reinterpret_cast<const char*>(node);
+						rawTile.insert(rawTile.end(), nodeBytes,
+								nodeBytes + sizeof(node));
+					}
+				}
+			}
+			// Compress and write it.
+			uLongf compressedSize = compressBound(rawTile.size());
+			compressedTile.resize(compressedSize);
+			if(compress2(&compressedTile[0], &compressedSize,
+						reinterpret_cast<const Bytef*>(&rawTile[0]),
+						rawTile.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+			{
+				AQSIS_THROW_XQERROR(XqInternal, EqE_Bug,
+					"Could not compress deep shadow tile");
+			}
+			SqTileEntry entry;
+			entry.offset = out.tellp();
+			entry.compressedSize = compressedSize;
+			entry.rawSize = rawTile.size();
+			entries.push_back(entry);
+			out.write(reinterpret_cast<const char*>(&compressedTile[0]),
+					compressedSize);
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------
+// CqDeepShadowInputFile implementation
+
+CqDeepShadowInputFile::CqDeepShadowInputFile(const boostfs::path& fileName)
+	: m_fileName(fileName),
+	m_fileStream(native(fileName).c_str(), std::ios::in | std::ios::binary),
+	m_tileSize(0),
+	m_worldToScreen(),
+	m_worldToCamera(),
+	m_levels()
+{
+	if(!m_fileStream.is_open())
+	{
+		AQSIS_THROW_XQERROR(XqInvalidFile, EqE_NoFile,
+				"Could not open deep shadow file \"" << fileName
+				<< "\" for reading");
+	}
+
+	// Magic number and version
+	char magicNum[deepshadow::magicNumberSize];
+	m_fileStream.read(magicNum, deepshadow::magicNumberSize);
+	if(m_fileStream.gcount() != deepshadow::magicNumberSize
+		|| !std::equal(magicNum, magicNum + deepshadow::magicNumberSize,
+			deepshadow::magicNumber))
+	{
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_BadFile,
+				"Magic number mismatch in deep shadow file \"" << fileName << "\"");
+	}
+	TqUint32 version = 0;
+	readRaw(m_fileStream, version, "version");
+	if(version != deepshadow::version)
+	{
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_Version,
+				"Unsupported deep shadow file version " << version
+				<< " in \"" << fileName << "\"");
+	}
+
+	// Dimensions
+	TqInt32 width = 0;
+	TqInt32 height = 0;
+	TqInt32 tileSize = 0;
+	TqInt32 numLevels = 0;
+	readRaw(m_fileStream, width, "width");
+	readRaw(m_fileStream, height, "height");
+	readRaw(m_fileStream, tileSize, "tile size");
+	readRaw(m_fileStream, numLevels, "number of levels");
+	if(width <= 0 || height <= 0 || tileSize <= 0
+			|| numLevels != numMipLevels(width, height))
+	{
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_BadFile,
+				"Invalid dimensions in deep shadow file \"" << fileName << "\"");
+	}
+	m_tileSize = tileSize;
+
+	// Light transformations
+	m_worldToScreen.SetfIdentity(false);
+	m_fileStream.read(reinterpret_cast<char*>(m_worldToScreen.pElements()),
+			16*sizeof(TqFloat));
+	m_worldToCamera.SetfIdentity(false);
+	m_fileStream.read(reinterpret_cast<char*>(m_worldToCamera.pElements()),
+			16*sizeof(TqFloat));
+	if(m_fileStream.gcount() != 16*sizeof(TqFloat))
+	{
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_BadFile,
+				"could not read matrices from deep shadow file \""
+				<< fileName << "\"");
+	}
+
+	// Tile table
+	m_levels.resize(numLevels);
+	for(TqInt l = 0; l < numLevels; ++l)
+	{
+		SqLevel& level = m_levels[l];
+		level.width = width;
+		level.height = height;
+		level.tilesPerRow = (width + tileSize - 1)/tileSize;
+		level.tiles.resize(numTiles(width, height, tileSize));
+		for(std::vector<SqTileEntry>::iterator entry = level.tiles.begin(),
+				end = level.tiles.end(); entry != end; ++entry)
+		{
+			readRaw(m_fileStream, entry->offset, "tile offset");
+			readRaw(m_fileStream, entry->compressedSize, "tile size");
+			readRaw(m_fileStream, entry->rawSize, "tile size");
+		}
+		width = (width+1)/2;
+		height = (height+1)/2;
+	}
+}
+
+const CqVisibilityFunction& CqDeepShadowInputFile::pixel(TqInt x, TqInt y,
+		TqInt level) const
+{
+	assert(level >= 0 && level < numLevels());
+	SqLevel& lev = m_levels[level];
+	assert(x >= 0 && x < lev.width && y >= 0 && y < lev.height);
+	TqInt tx = x/m_tileSize;
+	TqInt ty = y/m_tileSize;
+	TqInt tileWidth = min(m_tileSize, lev.width - tx*m_tileSize);
+	SqTileEntry& entry = lev.tiles[ty*lev.tilesPerRow + tx];
+	if(!entry.tile)
+		readTile(entry, tileWidth, min(m_tileSize, lev.height - ty*m_tileSize));
+	return (*entry.tile)[(y - ty*m_tileSize)*tileWidth + x - tx*m_tileSize];
+}
+
+void CqDeepShadowInputFile::readTile(SqTileEntry& entry, TqInt tileWidth,
+		TqInt tileHeight) const
+{
+	// Read and decompress the raw tile data.
+	std::vector<Bytef> compressedTile(entry.compressedSize);
+	m_fileStream.seekg(entry.offset);
+	m_fileStream.read(reinterpret_cast<char*>(&compressedTile[0]),
+			entry.compressedSize);
+	std::vector<char> rawTile(entry.rawSize);
+	uLongf rawSize = entry.rawSize;
+	if(m_fileStream.gcount() != std::streamsize(entry.compressedSize)
+		|| uncompress(reinterpret_cast<Bytef*>(&rawTile[0]), &rawSize,
+			&compressedTile[0], entry.compressedSize) != Z_OK
+		|| rawSize != entry.rawSize)
+	{
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_BadFile,
+				"Corrupt tile in deep shadow file \"" << m_fileName << "\"");
+	}
+
+	// Unpack the visibility functions.
+	boost::shared_ptr<TqTile> tile(new TqTile(tileWidth*tileHeight));
+	const char* data = &rawTile[0];
+	const char* dataEnd = data + rawSize;
+	for(TqTile::iterator func = tile->begin(), end = tile->end();
+			func != end; ++func)
+	{
+		TqUint32 numNodes = 0;
+		if(dataEnd - data < TqInt(sizeof(numNodes)))
+			break;
+		std::memcpy(&numNodes, data, sizeof(numNodes));
+		data += sizeof(numNodes);
+		if(TqUint32(dataEnd - data)/(2*sizeof(TqFloat)) < numNodes)
+			break;
+		std::vector<SqVisibilityNode>& nodes = func->nodes();
+		nodes.resize(numNodes);
+		for(TqUint32 i = 0; i < numNodes; ++i)
+		{
+			std::memcpy(&nodes[i].depth, data, sizeof(TqFloat));
+			std::memcpy(&nodes[i].visibility, data + sizeof(TqFloat), sizeof(TqFloat));
+			data += 2*sizeof(TqFloat);
+		}
+	}
+	if(data != dataEnd)
+	{
+		AQSIS_THROW_XQERROR(XqBadTexture, EqE_BadFile,
+				"Corrupt tile in deep shadow file \"" << m_fileName << "\"");
+	}
+	entry.tile = tile;
+}
+
+} // namespace Aqsis
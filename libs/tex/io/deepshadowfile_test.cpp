@@ -0,0 +1,118 @@
+// Aqsis
+// Copyright (C) 2001, Paul C. Gregory and the other authors and contributors
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of the software's owners nor the names of its
+//   contributors may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// (This is the New BSD license)
+
+/** \file
+ *
+ * \brief Unit tests for deep shadow file reading and writing.
+ */
+
+#include <aqsis/tex/io/deepshadowfile.h>
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <cstdio>
+
+#include "magicnumber.h"
+
+BOOST_AUTO_TEST_SUITE(deepshadowfile_tests)
+
+using Aqsis::SqVisibilityStep;
+using Aqsis::CqVisibilityFunction;
+
+BOOST_AUTO_TEST_CASE(deepshadowfile_roundtrip_test)
+{
+	const char* fileName = "deepshadowfile_test.dsm";
+	// Use a width which isn't a multiple of the tile size or a power of two
+	// to check the edge handling.
+	const TqInt width = 11;
+	const TqInt height = 6;
+	const TqInt tileSize = 4;
+	Aqsis::CqMatrix worldToScreen(2, 3, 4);
+	Aqsis::CqMatrix worldToCamera;
+	worldToCamera.Translate(Aqsis::CqVector3D(1, 2, 3));
+	{
+		Aqsis::CqDeepShadowOutputFile outFile(fileName, width, height,
+				worldToScreen, worldToCamera, 0.001f, tileSize);
+		for(TqInt y = 0; y < height; ++y)
+		{
+			for(TqInt x = 0; x < width; ++x)
+			{
+				// Pixel (x,y) has a layer of opacity 0.5 at depth x+1, and
+				// every other pixel is opaque at depth 20.
+				std::vector<SqVisibilityStep> steps;
+				steps.push_back(SqVisibilityStep(x + 1, -0.5f));
+				if((x + y) % 2 == 0)
+					steps.push_back(SqVisibilityStep(20, -0.5f));
+				CqVisibilityFunction func;
+				func.setSteps(steps);
+				outFile.setPixel(x, y, func);
+			}
+		}
+		outFile.close();
+	}
+
+	BOOST_CHECK_EQUAL(Aqsis::guessFileType(fileName),
+			Aqsis::ImageFile_AqsisDeepShadow);
+
+	Aqsis::CqDeepShadowInputFile inFile(fileName);
+	BOOST_REQUIRE_EQUAL(inFile.numLevels(), 5);
+	BOOST_CHECK_EQUAL(inFile.width(0), width);
+	BOOST_CHECK_EQUAL(inFile.height(0), height);
+	BOOST_CHECK_EQUAL(inFile.width(1), 6);
+	BOOST_CHECK_EQUAL(inFile.height(1), 3);
+	BOOST_CHECK_EQUAL(inFile.width(4), 1);
+	BOOST_CHECK_EQUAL(inFile.height(4), 1);
+	BOOST_CHECK(inFile.worldToScreen() == worldToScreen);
+	BOOST_CHECK(inFile.worldToCamera() == worldToCamera);
+
+	for(TqInt y = 0; y < height; ++y)
+	{
+		for(TqInt x = 0; x < width; ++x)
+		{
+			const CqVisibilityFunction& func = inFile.pixel(x, y);
+			BOOST_CHECK_EQUAL(func.visibility(x + 0.5f), 1);
+			BOOST_CHECK_CLOSE(func.visibility(x + 1), 0.5f, 1e-4);
+			BOOST_CHECK_EQUAL(func.visibility(30), (x + y) % 2 == 0 ? 0 : 0.5f);
+		}
+	}
+
+	// Level 1 pixels are averages of 2x2 blocks; the last column only
+	// averages a single column of level 0.
+	BOOST_CHECK_CLOSE(inFile.pixel(0, 0, 1).visibility(30), 0.25f, 1e-3);
+	BOOST_CHECK_CLOSE(inFile.pixel(5, 0, 1).visibility(30), 0.25f, 1e-3);
+	BOOST_CHECK_CLOSE(inFile.pixel(5, 2, 1).visibility(11), 0.5f, 1e-3);
+	BOOST_CHECK_CLOSE(inFile.pixel(0, 0, 4).visibility(30), 0.25f, 1);
+
+	std::remove(fileName);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
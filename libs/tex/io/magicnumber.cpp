@@ -113,6 +113,11 @@ EqImageFileType guessFileType(std::istream& inStream)
 	{
 		return ImageFile_AqsisZfile;
 	}
+	else if( magicNum.size() >= 17
+		&& std::equal(magicNum.begin(), magicNum.begin()+17, "Aqsis deep shadow") )
+	{
+		return ImageFile_AqsisDeepShadow;
+	}
 	// Add further magic number matches here
 	else
 	{
@@ -33,6 +33,10 @@
 #else
 #	include <sys/types.h>
 #	include <sys/resource.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <sys/un.h>
+#	include <sys/wait.h>
 #	include <unistd.h>
 #endif
 
@@ -42,10 +46,12 @@
 
 #include <fcntl.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>  // for memset
+#include <fstream>
 #include <iostream>
 #include <iomanip>
-#include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -145,8 +151,17 @@ ArgParse::apflag g_cl_mpdump = 0;
 
 #ifdef	AQSIS_SYSTEM_POSIX
 ArgParse::apflag g_cl_syslog = 0;
+ArgParse::apstring g_cl_server = "";
+ArgParse::apstring g_cl_submit = "";
+ArgParse::apint g_cl_framejobs = 1;
+ArgParse::apint g_cl_framejobmemory = 0;
 #endif	// AQSIS_SYSTEM_POSIX
 
+/// Number of processes sharing the frames of the RIB, and the index of the
+/// one running; see runFrameJobs().
+int g_numFrameJobs = 1;
+int g_frameJob = 0;
+
 
 //------------------------------------------------------------------------------
 /// Function to print the progress of the render.  Used as the callback function to a RiProgressHandler call.
@@ -455,21 +470,35 @@ static void setPriority(int priority)
 #endif // AQSIS_SYSTEM_WIN32
 
 
-/** \brief Feed command line options to the renderer.
- *
- * This function sends all command line options to the renderer, except those
- * which are set directly before the world block.
+/** \brief Add the filters requested on the command line to the renderer.
  */
-void setupOptions()
+void setupFilters()
 {
 	if ( g_cl_echoapi )
 		Aqsis::cxxRenderContext()->addFilter("echorib");
 
 	std::string frameList = getFrameList();
-	if(!frameList.empty())
-		Aqsis::cxxRenderContext()->addFilter("framedrop",
-				Aqsis::ParamListBuilder()("frames", frameList.c_str()) );
+	if(!frameList.empty() || g_numFrameJobs > 1)
+	{
+		// Only the frames left by the frame list are shared between frame
+		// jobs.
+		Aqsis::ParamListBuilder params;
+		if(!frameList.empty())
+			params("frames", frameList.c_str());
+		if(g_numFrameJobs > 1)
+			params("jobs", g_numFrameJobs)("job", g_frameJob);
+		Aqsis::cxxRenderContext()->addFilter("framedrop", params);
+	}
+}
+
 
+/** \brief Feed command line options to the renderer.
+ *
+ * This function sends all command line options to the renderer, except those
+ * which are set directly before the world block.
+ */
+void setupOptions()
+{
 	// Allow any command line arguments to override system/env settings
 	Aqsis::log() << Aqsis::info
 		<< "Applying search paths provided at the command line\n";
@@ -504,6 +533,404 @@ void setupOptions()
 }
 
 
+/** \brief Render RIB files, or stdin if there are none.
+ *
+ * \return The RI error code.
+ */
+RtInt renderFiles(const ArgParse::apstringvec& fileNames, std::istream& stdinStream)
+{
+	RtInt returnCode = 0;
+	RiBegin(RI_NULL);
+	setupFilters();
+	setupOptions();
+	PreWorldFilter preWorldFilter;
+	Aqsis::cxxRenderContext()->addFilter(preWorldFilter);
+	try
+	{
+		if ( fileNames.empty() )
+		{
+			// If no files specified, take input from stdin.
+			//
+			// TODO: We'd like to turn off stdio synchronisation to allow fast
+			// buffering... unfortunately this causes very odd problems with
+			// the aqsis logging facility as of svn r2804
+			//
+			//std::ios_base::sync_with_stdio(false);
+			Aqsis::cxxRenderContext()->parseRib(stdinStream, "stdin");
+		}
+		else
+		{
+			for(ArgParse::apstringvec::const_iterator fileName = fileNames.begin();
+					fileName != fileNames.end(); fileName++)
+			{
+				if(Aqsis::cxxRenderContext()->parseRibFile(fileName->c_str(),
+											fileName->c_str()))
+				{
+					returnCode = RiLastError;
+				}
+				else
+				{
+					Aqsis::log() << Aqsis::error
+						<< "Cannot open file \"" << *fileName << "\"\n";
+					returnCode = RIE_NOFILE;
+				}
+			}
+		}
+	}
+	catch(const std::exception& e)
+	{
+		Aqsis::log() << Aqsis::error << e.what() << std::endl;
+		returnCode = RIE_BUG;
+	}
+	catch(...)
+	{
+		Aqsis::log() << Aqsis::error
+			<< "unknown exception has been encountered\n";
+		returnCode = RIE_BUG;
+	}
+	RiEnd();
+	return returnCode;
+}
+
+
+#ifdef AQSIS_SYSTEM_POSIX
+namespace {
+
+/** \brief Render RIB from a stream, returning the RI error code.
+ */
+RtInt renderRib(std::istream& ribStream, const char* name)
+{
+	try
+	{
+		Aqsis::cxxRenderContext()->parseRib(ribStream, name);
+		return RiLastError;
+	}
+	catch(const std::exception& e)
+	{
+		Aqsis::log() << Aqsis::error << e.what() << std::endl;
+	}
+	catch(...)
+	{
+		Aqsis::log() << Aqsis::error
+			<< "unknown exception has been encountered\n";
+	}
+	return RIE_BUG;
+}
+
+
+/** \brief Stream buffer reading from a file descriptor.
+ *
+ * The buffer is large so that the RIB parser can read ahead from it without
+ * blocking.
+ */
+class FdInputBuf : public std::streambuf
+{
+	public:
+		FdInputBuf(int fd) : m_fd(fd) {}
+	protected:
+		virtual int_type underflow()
+		{
+			ssize_t numRead = 0;
+			do
+				numRead = read(m_fd, m_buffer, sizeof(m_buffer));
+			while(numRead < 0 && errno == EINTR);
+			if(numRead <= 0)
+				return traits_type::eof();
+			setg(m_buffer, m_buffer, m_buffer + numRead);
+			return traits_type::to_int_type(m_buffer[0]);
+		}
+	private:
+		int m_fd;
+		char m_buffer[65536];
+};
+
+/// Write a whole buffer to a file descriptor.
+bool writeAll(int fd, const char* data, size_t size)
+{
+	while(size > 0)
+	{
+		ssize_t numWritten = write(fd, data, size);
+		if(numWritten < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		data += numWritten;
+		size -= numWritten;
+	}
+	return true;
+}
+
+/// Fill in the address of a UNIX domain socket.
+bool socketAddress(const std::string& path, sockaddr_un& addr)
+{
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path))
+	{
+		Aqsis::log() << Aqsis::error << "Socket path \"" << path
+			<< "\" is too long\n";
+		return false;
+	}
+	std::strcpy(addr.sun_path, path.c_str());
+	return true;
+}
+
+/** \brief Begin a context for the render server.
+ *
+ * Shaders and textures are kept loaded in the context between jobs.
+ */
+void beginServerContext(PreWorldFilter& preWorldFilter)
+{
+	RiBegin(RI_NULL);
+	Aqsis::setResidentCaches(true);
+	setupFilters();
+	setupOptions();
+	Aqsis::cxxRenderContext()->addFilter(preWorldFilter);
+}
+
+/** \brief Prepare the server context for the next job.
+ *
+ * The context is reset if the last job left it at the top level, otherwise
+ * it's ended and a new one begun.  Either way the next job starts without
+ * the errors of the last.
+ */
+void resetServerContext(PreWorldFilter& preWorldFilter, const std::string& jobName)
+{
+	if(Aqsis::resetRenderContext())
+		setupOptions();
+	else
+	{
+		Aqsis::log() << Aqsis::warning << jobName
+			<< " ended inside a block; restarting the renderer\n";
+		RiEnd();
+		beginServerContext(preWorldFilter);
+	}
+	RiLastError = RIE_NOERROR;
+}
+
+/** \brief Render jobs sent to a UNIX domain socket, one after another.
+ *
+ * Each connection carries one job: the client sends RIB and shuts down its
+ * side of the connection, then reads back the RI error code for the job as a
+ * decimal number on a line of its own.  The renderer is kept between jobs,
+ * so shaders, textures and archives loaded for one job don't need to be
+ * loaded again for the next unless their files have changed.
+ */
+int runServer(const std::string& socketPath)
+{
+	sockaddr_un addr;
+	if(!socketAddress(socketPath, addr))
+		return RIE_SYSTEM;
+	// A socket left behind by an earlier server is replaced, but anything
+	// else at the path is left alone.
+	struct stat pathStat;
+	if(lstat(socketPath.c_str(), &pathStat) == 0)
+	{
+		if(!S_ISSOCK(pathStat.st_mode))
+		{
+			Aqsis::log() << Aqsis::error << "Could not listen on \"" << socketPath
+				<< "\": file exists and is not a socket\n";
+			return RIE_SYSTEM;
+		}
+		unlink(socketPath.c_str());
+	}
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd < 0)
+	{
+		Aqsis::log() << Aqsis::error << "Could not create socket: "
+			<< std::strerror(errno) << "\n";
+		return RIE_SYSTEM;
+	}
+	if(bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+		|| listen(listenFd, 8) < 0)
+	{
+		Aqsis::log() << Aqsis::error << "Could not listen on \"" << socketPath
+			<< "\": " << std::strerror(errno) << "\n";
+		close(listenFd);
+		return RIE_SYSTEM;
+	}
+	// Clients which go away before reading their result shouldn't take the
+	// server with them.
+	std::signal(SIGPIPE, SIG_IGN);
+	Aqsis::log() << Aqsis::info << "Waiting for jobs on \"" << socketPath
+		<< "\"\n";
+
+	PreWorldFilter preWorldFilter;
+	beginServerContext(preWorldFilter);
+	for(TqInt jobNumber = 1; ; ++jobNumber)
+	{
+		int jobFd = accept(listenFd, 0, 0);
+		if(jobFd < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			Aqsis::log() << Aqsis::error << "Could not accept job: "
+				<< std::strerror(errno) << "\n";
+			break;
+		}
+		std::ostringstream jobName;
+		jobName << "job " << jobNumber;
+		Aqsis::log() << Aqsis::info << "Starting " << jobName.str() << "\n";
+		RtInt returnCode = 0;
+		{
+			FdInputBuf jobBuf(jobFd);
+			std::istream jobStream(&jobBuf);
+			returnCode = renderRib(jobStream, jobName.str().c_str());
+		}
+		std::ostringstream reply;
+		reply << returnCode << "\n";
+		writeAll(jobFd, reply.str().data(), reply.str().size());
+		close(jobFd);
+
+		resetServerContext(preWorldFilter, jobName.str());
+	}
+	RiEnd();
+	close(listenFd);
+	return RIE_SYSTEM;
+}
+
+/** \brief Send RIB files to a render server as a single job.
+ *
+ * \return The RI error code reported by the server for the job.
+ */
+int submitJob(const std::string& socketPath,
+		const ArgParse::apstringvec& fileNames)
+{
+	sockaddr_un addr;
+	if(!socketAddress(socketPath, addr))
+		return RIE_SYSTEM;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+	{
+		Aqsis::log() << Aqsis::error << "Could not connect to render server at \""
+			<< socketPath << "\": " << std::strerror(errno) << "\n";
+		if(fd >= 0)
+			close(fd);
+		return RIE_SYSTEM;
+	}
+	std::signal(SIGPIPE, SIG_IGN);
+	std::vector<char> buffer(65536);
+	bool sent = true;
+	for(size_t i = 0; sent && i < std::max<size_t>(fileNames.size(), 1); ++i)
+	{
+		std::ifstream file;
+		std::istream* in = &std::cin;
+		if(!fileNames.empty())
+		{
+			file.open(fileNames[i].c_str(), std::ios::binary);
+			if(!file)
+			{
+				Aqsis::log() << Aqsis::error
+					<< "Cannot open file \"" << fileNames[i] << "\"\n";
+				close(fd);
+				return RIE_NOFILE;
+			}
+			in = &file;
+		}
+		while(sent && *in)
+		{
+			in->read(&buffer[0], buffer.size());
+			sent = writeAll(fd, &buffer[0], in->gcount());
+		}
+	}
+	shutdown(fd, SHUT_WR);
+	std::string reply;
+	ssize_t numRead = 0;
+	while((numRead = read(fd, &buffer[0], buffer.size())) > 0
+			|| (numRead < 0 && errno == EINTR))
+	{
+		if(numRead > 0)
+			reply.append(&buffer[0], numRead);
+	}
+	close(fd);
+	std::istringstream replyStream(reply);
+	int returnCode = RIE_SYSTEM;
+	if(!(replyStream >> returnCode))
+		Aqsis::log() << Aqsis::error << "No result from render server\n";
+	return returnCode;
+}
+
+/** \brief Render the frames of the RIB files on several processes at once.
+ *
+ * The worker processes are forked before anything is parsed, so each has a
+ * renderer of its own.  Each worker parses the whole of the input, but the
+ * frame dropping filter passes only every numJobs'th frame on to its
+ * renderer; parsing the frames of the other workers costs little compared
+ * to rendering them.
+ *
+ * \param memoryMB - if positive, the total address space in megabytes
+ * allowed to the workers, which is divided evenly between them.
+ * \return The first non-zero RI error code of the workers.
+ */
+RtInt runFrameJobs(const ArgParse::apstringvec& fileNames, int numJobs,
+		int memoryMB)
+{
+	// The workers can't share stdin, so it's read in full before they start.
+	std::string stdinRib;
+	if(fileNames.empty())
+	{
+		std::ostringstream contents;
+		contents << std::cin.rdbuf();
+		stdinRib = contents.str();
+	}
+	// Make sure output buffered so far isn't repeated by each worker.
+	std::cout.flush();
+	Aqsis::log().flush();
+
+	std::vector<pid_t> workers;
+	for(int job = 0; job < numJobs; ++job)
+	{
+		pid_t pid = fork();
+		if(pid == 0)
+		{
+			g_numFrameJobs = numJobs;
+			g_frameJob = job;
+			if(memoryMB > 0)
+			{
+				rlimit limit;
+				limit.rlim_cur = limit.rlim_max =
+					static_cast<rlim_t>(memoryMB)*1024*1024/numJobs;
+				if(setrlimit(RLIMIT_AS, &limit) < 0)
+					Aqsis::log() << Aqsis::warning
+						<< "Could not limit the memory of frame job " << job
+						<< ": " << std::strerror(errno) << "\n";
+			}
+			std::istringstream stdinStream(stdinRib);
+			std::exit(renderFiles(fileNames, stdinStream));
+		}
+		if(pid < 0)
+		{
+			Aqsis::log() << Aqsis::error << "Could not start frame job "
+				<< job << ": " << std::strerror(errno) << "\n";
+			break;
+		}
+		workers.push_back(pid);
+	}
+
+	RtInt returnCode = static_cast<int>(workers.size()) < numJobs ? RIE_SYSTEM : 0;
+	for(int job = 0, end = workers.size(); job < end; ++job)
+	{
+		int status = 0;
+		while(waitpid(workers[job], &status, 0) < 0 && errno == EINTR)
+		{ }
+		RtInt jobCode = RIE_SYSTEM;
+		if(WIFEXITED(status))
+			jobCode = WEXITSTATUS(status);
+		else
+			Aqsis::log() << Aqsis::error << "Frame job " << job
+				<< " was terminated by signal " << WTERMSIG(status) << "\n";
+		if(returnCode == 0)
+			returnCode = jobCode;
+	}
+	return returnCode;
+}
+
+} // anon namespace
+#endif // AQSIS_SYSTEM_POSIX
+
+
 int main( int argc, const char** argv )
 {
 	std::signal(SIGINT, aqsisSignalHandler);
@@ -552,6 +979,10 @@ int main( int argc, const char** argv )
 		ap.argStrings( "option", "=string\aA valid RIB Option string, can be specified multiple times.", &g_cl_options);
 #		ifdef AQSIS_SYSTEM_POSIX
 		ap.argFlag( "syslog", "\aLog messages to syslog", &g_cl_syslog );
+		ap.argString( "server", "=string\aRender jobs sent to the given UNIX socket one after another, keeping shaders and textures loaded between them", &g_cl_server );
+		ap.argString( "submit", "=string\aSend the RIB files (or stdin) as one job to the render server at the given UNIX socket", &g_cl_submit );
+		ap.argInt( "framejobs", "=integer\aRender the frames of the RIB files on this many processes at once (default %default)", &g_cl_framejobs );
+		ap.argInt( "framejobmemory", "=integer\aLimit the total address space of the -framejobs processes to this many megabytes", &g_cl_framejobmemory );
 #		endif // AQSIS_SYSTEM_POSIX
 #		if ENABLE_MPDUMP
 		ap.argFlag( "mpdump", "\aOutput MP list to a custom 'dump' file", &g_cl_mpdump );
@@ -627,55 +1058,17 @@ int main( int argc, const char** argv )
 			setPriority(g_cl_priority);
 		}
 
-		RiBegin(RI_NULL);
-		setupOptions();
-		PreWorldFilter preWorldFilter;
-		Aqsis::cxxRenderContext()->addFilter(preWorldFilter);
-		try
-		{
-			if ( ap.leftovers().size() == 0 )
-			{
-				// If no files specified, take input from stdin.
-				//
-				// TODO: We'd like to turn off stdio synchronisation to allow fast
-				// buffering... unfortunately this causes very odd problems with
-				// the aqsis logging facility as of svn r2804
-				//
-				//std::ios_base::sync_with_stdio(false);
-				Aqsis::cxxRenderContext()->parseRib(std::cin, "stdin");
-			}
-			else
-			{
-				for(ArgParse::apstringvec::const_iterator fileName = ap.leftovers().begin();
-						fileName != ap.leftovers().end(); fileName++)
-				{
-					std::ifstream inFile(fileName->c_str());
-					if(inFile)
-					{
-						Aqsis::cxxRenderContext()->parseRib(inFile, fileName->c_str());
-						returnCode = RiLastError;
-					}
-					else
-					{
-						Aqsis::log() << Aqsis::error
-							<< "Cannot open file \"" << *fileName << "\"\n";
-						returnCode = RIE_NOFILE;
-					}
-				}
-			}
-		}
-		catch(const std::exception& e)
-		{
-			Aqsis::log() << Aqsis::error << e.what() << std::endl;
-			returnCode = RIE_BUG;
-		}
-		catch(...)
-		{
-			Aqsis::log() << Aqsis::error
-				<< "unknown exception has been encountered\n";
-			returnCode = RIE_BUG;
-		}
-		RiEnd();
+#		ifdef AQSIS_SYSTEM_POSIX
+		if( !g_cl_submit.empty() )
+			return submitJob(g_cl_submit, ap.leftovers());
+		if( !g_cl_server.empty() )
+			return runServer(g_cl_server);
+		if( g_cl_framejobs > 1 )
+			returnCode = runFrameJobs(ap.leftovers(), g_cl_framejobs,
+					g_cl_framejobmemory);
+		else
+#		endif // AQSIS_SYSTEM_POSIX
+			returnCode = renderFiles(ap.leftovers(), std::cin);
 	}
 
 	StopMemoryDebugging();
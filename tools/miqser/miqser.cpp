@@ -120,9 +120,13 @@ int main( int argc, const char** argv )
 	ap.alias( "indentlevel", "l" );
 	ap.argInt( "compression", "=integer\aSet output compression type\n"
 	           "\a0 = none (default)\n"
-	           "\a1 = gzip", &g_cl_compression );
+	           "\a1 = gzip\n"
+	           "\a2 = gzip in independent blocks, for parallel decompression", &g_cl_compression );
+	ap.argInt( "threads", "=integer\aSet the number of threads for block compression\n"
+	           "\a(default 0, one per processor)", &g_writerOpts.compressionThreads );
 	ap.argFlag( "binary", "\aOutput a binary encoded RIB file", &g_writerOpts.useBinary );
 	ap.alias( "binary", "b" );
+	ap.argFlag( "quantise", "\aRound primitive variables of binary RIB to half precision", &g_writerOpts.quantiseFloats );
 	ap.argInts( "frames", " f1 f2\aSpecify a starting/ending frame to render (inclusive).", &g_cl_frames, ArgParse::SEP_ARGV, 2);
 	ap.argString( "framelist", "=string\aSpecify a range of frames to render, ',' separated with '-' to indicate ranges.", &g_cl_frameList);
 	ap.argFlag( "nocolor", "\aDisable colored output", &g_cl_no_color );
@@ -194,7 +198,8 @@ int main( int argc, const char** argv )
 		g_writerOpts.indentStep = 0;
 	else
 		Aqsis::log() << Aqsis::warning << "unknown indent character";
-	g_writerOpts.useGzip = g_cl_compression;
+	g_writerOpts.useGzip = g_cl_compression > 0;
+	g_writerOpts.useGzipBlocks = g_cl_compression > 1;
 
 	// Get output stream
 	std::ostream* outStream = &std::cout;
@@ -0,0 +1,442 @@
+// Aqsis
+// Copyright 1997 - 2001, Paul C. Gregory
+//
+// Contact: pgregory@aqsis.org
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+/** \file
+		\brief Benchmark for RIB parsing and scene loading.
+
+		Synthetic and recorded RIB streams are held in memory and parsed
+		repeatedly, both into a renderer which ignores all requests and into
+		the core renderer.  The throughput and the number of heap allocations
+		made while parsing are reported, so that regressions in the parser
+		and the core API can be caught by automated benchmark runs.
+*/
+
+#include <aqsis/aqsis.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <aqsis/core/corecontext.h>
+#include <aqsis/ri/ri.h>
+#include <aqsis/riutil/errorhandler.h>
+#include <aqsis/riutil/ribparser.h>
+#include <aqsis/riutil/ribwriter.h>
+#include <aqsis/riutil/ricxx_filter.h>
+#include <aqsis/riutil/ricxxutil.h>
+#include <aqsis/riutil/tokendictionary.h>
+#include <aqsis/util/argparse.h>
+#include <aqsis/version.h>
+
+
+// Command-line arguments
+ArgParse::apflag g_cl_help = false;
+ArgParse::apflag g_cl_version = false;
+ArgParse::apint g_cl_iterations = 5;
+ArgParse::apint g_cl_requests = 100000;
+ArgParse::apint g_cl_meshsize = 256;
+ArgParse::apstring g_cl_mode = "all";
+
+
+//------------------------------------------------------------------------------
+// Heap allocation counting.
+//
+// Every allocation made through operator new is counted, including those made
+// inside the aqsis libraries.  The counts aren't synchronised, so are only
+// approximate when the core renderer runs threads of its own.
+
+namespace {
+
+long g_allocCount = 0;
+long g_allocBytes = 0;
+
+void* countedAlloc(std::size_t size)
+{
+	++g_allocCount;
+	g_allocBytes += size;
+	void* p = std::malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+} // unnamed namespace
+
+void* operator new(std::size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* p)
+{
+	std::free(p);
+}
+
+void operator delete[](void* p)
+{
+	std::free(p);
+}
+
+
+namespace {
+
+namespace Ri = Aqsis::Ri;
+
+//------------------------------------------------------------------------------
+/// A RIB stream held in memory.
+struct BenchStream
+{
+	std::string name;
+	std::string data;
+};
+
+/// Generate a stream of many small requests, typical of scenes made of lots
+/// of small objects.
+void writeSmallRequests(Ri::Renderer& ri, int nObjects)
+{
+	ri.WorldBegin();
+	for(int i = 0; i < nObjects; ++i)
+	{
+		ri.AttributeBegin();
+		ri.Translate(i % 100, (i / 100) % 100, i / 10000);
+		RtColor col = {(i % 7) / 7.0f, (i % 11) / 11.0f, (i % 13) / 13.0f};
+		ri.Color(col);
+		ri.Sphere(0.5f, -0.5f, 0.5f, 360.0f, Aqsis::ParamListBuilder());
+		ri.AttributeEnd();
+	}
+	ri.WorldEnd();
+}
+
+/// Generate a stream holding a single large quad mesh with positions,
+/// normals and texture coordinates, typical of scenes exported from
+/// modelling packages.
+void writeLargeMesh(Ri::Renderer& ri, int size)
+{
+	std::vector<RtInt> nverts(size*size, 4);
+	std::vector<RtInt> verts;
+	verts.reserve(4*size*size);
+	for(int j = 0; j < size; ++j)
+	{
+		for(int i = 0; i < size; ++i)
+		{
+			int v = j*(size+1) + i;
+			verts.push_back(v);
+			verts.push_back(v + 1);
+			verts.push_back(v + size + 2);
+			verts.push_back(v + size + 1);
+		}
+	}
+	std::vector<RtFloat> P, N, st;
+	P.reserve(3*(size+1)*(size+1));
+	N.reserve(3*(size+1)*(size+1));
+	st.reserve(2*(size+1)*(size+1));
+	for(int j = 0; j <= size; ++j)
+	{
+		for(int i = 0; i <= size; ++i)
+		{
+			float s = float(i)/size;
+			float t = float(j)/size;
+			P.push_back(s);
+			P.push_back(t);
+			P.push_back(0.1f*s*t);
+			N.push_back(-0.1f*t);
+			N.push_back(-0.1f*s);
+			N.push_back(1);
+			st.push_back(s);
+			st.push_back(t);
+		}
+	}
+	ri.WorldBegin();
+	ri.PointsPolygons(Ri::IntArray(&nverts[0], nverts.size()),
+					  Ri::IntArray(&verts[0], verts.size()),
+					  Aqsis::ParamListBuilder()
+					  ("vertex point P", P)
+					  ("vertex normal N", N)
+					  ("vertex float[2] st", st));
+	ri.WorldEnd();
+}
+
+/// Serialize the output of a generator to a RIB stream in memory.
+BenchStream makeStream(const char* name, bool binary,
+					   void (*generate)(Ri::Renderer&, int), int size)
+{
+	std::ostringstream out;
+	{
+		Aqsis::RibWriterOptions opts;
+		opts.useBinary = binary;
+		boost::shared_ptr<Ri::RendererServices> writer(
+			Aqsis::createRibWriter(out, opts));
+		generate(writer->firstFilter(), size);
+	}
+	BenchStream stream;
+	stream.name = std::string(name) + (binary ? "_binary" : "_ascii");
+	stream.data = out.str();
+	return stream;
+}
+
+
+//------------------------------------------------------------------------------
+/// Services for parsing into a renderer which ignores all requests.
+///
+/// This measures the lexer and parser alone.
+class NullServices : public Aqsis::StubRendererServices
+{
+	public:
+		NullServices()
+			: m_tokenDict(),
+			m_errHandler(),
+			m_renderer(),
+			m_parser()
+		{
+			m_parser.reset(Aqsis::RibParser::create(*this));
+		}
+
+		Aqsis::RibParser& parser()
+		{
+			return *m_parser;
+		}
+
+		virtual Ri::ErrorHandler& errorHandler()
+		{
+			return m_errHandler;
+		}
+
+		virtual Ri::TypeSpec getDeclaration(RtConstToken token,
+						const char** nameBegin = 0,
+						const char** nameEnd = 0) const
+		{
+			return m_tokenDict.lookup(token, nameBegin, nameEnd);
+		}
+
+		virtual Ri::Renderer& firstFilter()
+		{
+			return m_renderer;
+		}
+
+		virtual void parseRib(std::istream& ribStream, const char* name,
+							  Ri::Renderer& context)
+		{
+			m_parser->parseStream(ribStream, name, context);
+		}
+		using Ri::RendererServices::parseRib;
+
+	private:
+		class ErrorHandler : public Ri::ErrorHandler
+		{
+			public:
+				ErrorHandler() : Ri::ErrorHandler(Error) {}
+			protected:
+				virtual void dispatch(int code, const std::string& message)
+				{
+					std::cerr << "ERROR: " << message << std::endl;
+				}
+		};
+
+		Aqsis::TokenDict m_tokenDict;
+		ErrorHandler m_errHandler;
+		Aqsis::StubRenderer m_renderer;
+		boost::shared_ptr<Aqsis::RibParser> m_parser;
+};
+
+
+/// Filter which stops the core at the end of the world block.
+///
+/// Only the cost of loading the scene into the core is of interest, so the
+/// world is discarded with the context rather than rendered.
+class DropWorldEndFilter : public Aqsis::PassthroughFilter
+{
+	public:
+		virtual RtVoid WorldEnd() {}
+};
+
+
+/// Results of one benchmark case, totalled over all iterations.
+struct BenchResult
+{
+	double seconds;
+	long allocCount;
+	long allocBytes;
+
+	BenchResult() : seconds(0), allocCount(0), allocBytes(0) {}
+};
+
+/// Parse a stream into the null renderer.
+void benchNull(const BenchStream& stream, int iterations,
+			   BenchResult& result, Aqsis::RibParserStats& stats)
+{
+	NullServices services;
+	services.parser().setStats(&stats);
+	for(int i = 0; i < iterations; ++i)
+	{
+		std::istringstream in(stream.data);
+		long allocCount = g_allocCount;
+		long allocBytes = g_allocBytes;
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		services.parseRib(in, stream.name.c_str());
+		result.seconds += (boost::posix_time::microsec_clock::universal_time()
+						   - start).total_microseconds()*1e-6;
+		result.allocCount += g_allocCount - allocCount;
+		result.allocBytes += g_allocBytes - allocBytes;
+	}
+}
+
+/// Parse a stream into a fresh core renderer context.
+void benchCore(const BenchStream& stream, int iterations, BenchResult& result)
+{
+	for(int i = 0; i < iterations; ++i)
+	{
+		RiBegin(RI_NULL);
+		DropWorldEndFilter dropWorldEnd;
+		Aqsis::cxxRenderContext()->addFilter(dropWorldEnd);
+		std::istringstream in(stream.data);
+		long allocCount = g_allocCount;
+		long allocBytes = g_allocBytes;
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		Aqsis::cxxRenderContext()->parseRib(in, stream.name.c_str());
+		result.seconds += (boost::posix_time::microsec_clock::universal_time()
+						   - start).total_microseconds()*1e-6;
+		result.allocCount += g_allocCount - allocCount;
+		result.allocBytes += g_allocBytes - allocBytes;
+		RiEnd();
+	}
+}
+
+/// Print one result line.
+void printResult(const BenchStream& stream, const char* mode, int iterations,
+				 long requests, const BenchResult& result)
+{
+	double megabytes = double(stream.data.size())*iterations/(1024*1024);
+	double seconds = std::max(result.seconds, 1e-9);
+	std::cout << std::left << std::setw(20) << stream.name
+		<< std::setw(6) << mode << std::right << std::fixed
+		<< std::setprecision(1)
+		<< std::setw(10) << megabytes/seconds << " MB/s"
+		<< std::setw(12) << requests*double(iterations)/seconds << " req/s"
+		<< std::setw(10) << result.allocCount/iterations << " allocs"
+		<< std::setw(12) << result.allocBytes/iterations << " bytes\n";
+}
+
+} // unnamed namespace
+
+
+int main(int argc, const char** argv)
+{
+	ArgParse ap;
+	ap.usageHeader(ArgParse::apstring("Usage: ") + argv[0]
+				   + " [options] [RIB file...]");
+	ap.argFlag("help", "\aPrint this help and exit", &g_cl_help);
+	ap.alias("help" , "h");
+	ap.argFlag("version", "\aPrint version information and exit", &g_cl_version);
+	ap.argInt("iterations", "=integer\aNumber of times to parse each stream "
+			  "(default %default)", &g_cl_iterations);
+	ap.argInt("requests", "=integer\aNumber of objects in the synthetic "
+			  "stream of small requests (default %default)", &g_cl_requests);
+	ap.argInt("meshsize", "=integer\aNumber of faces along each side of the "
+			  "synthetic mesh (default %default)", &g_cl_meshsize);
+	ap.argString("mode", "=string\aRenderer to parse into\n"
+				 "\anull = a renderer which ignores all requests\n"
+				 "\acore = the core renderer, without rendering\n"
+				 "\aall = both (default)", &g_cl_mode);
+
+	if(argc > 1 && !ap.parse(argc - 1, argv + 1))
+	{
+		std::cerr << ap.errmsg() << std::endl << ap.usagemsg();
+		return EXIT_FAILURE;
+	}
+	if(g_cl_help)
+	{
+		std::cerr << ap.usagemsg();
+		return EXIT_SUCCESS;
+	}
+	if(g_cl_version)
+	{
+		std::cerr << "ribbench version " << AQSIS_VERSION_STR_FULL << "\n";
+		return EXIT_SUCCESS;
+	}
+	bool doNull = g_cl_mode == "null" || g_cl_mode == "all";
+	bool doCore = g_cl_mode == "core" || g_cl_mode == "all";
+	if(!doNull && !doCore)
+	{
+		std::cerr << "Unknown mode \"" << g_cl_mode << "\"\n";
+		return EXIT_FAILURE;
+	}
+	int iterations = std::max(1, g_cl_iterations);
+
+	std::vector<BenchStream> streams;
+	for(int binary = 0; binary < 2; ++binary)
+	{
+		streams.push_back(makeStream("small", binary, writeSmallRequests,
+									 g_cl_requests));
+		streams.push_back(makeStream("mesh", binary, writeLargeMesh,
+									 g_cl_meshsize));
+	}
+	const ArgParse::apstringvec& fileNames = ap.leftovers();
+	for(ArgParse::apstringvec::const_iterator fileName = fileNames.begin();
+		fileName != fileNames.end(); ++fileName)
+	{
+		std::ifstream file(fileName->c_str(), std::ios::binary);
+		if(!file)
+		{
+			std::cerr << "Cannot open file \"" << *fileName << "\"\n";
+			return EXIT_FAILURE;
+		}
+		BenchStream stream;
+		stream.name = *fileName;
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		stream.data = contents.str();
+		streams.push_back(stream);
+	}
+
+	for(int i = 0, end = streams.size(); i < end; ++i)
+	{
+		// The request count comes from the null renderer, which is always
+		// run; parsing into the core gives the same count.
+		Aqsis::RibParserStats stats;
+		BenchResult nullResult;
+		benchNull(streams[i], iterations, nullResult, stats);
+		long requests = stats.requests/iterations;
+		if(doNull)
+			printResult(streams[i], "null", iterations, requests, nullResult);
+		if(doCore)
+		{
+			BenchResult coreResult;
+			benchCore(streams[i], iterations, coreResult);
+			printResult(streams[i], "core", iterations, requests, coreResult);
+		}
+	}
+	return EXIT_SUCCESS;
+}